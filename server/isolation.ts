@@ -0,0 +1,21 @@
+/**
+ * Cross-origin isolation headers for Co-do.
+ *
+ * Shared by:
+ * - server/main.ts  (Deno Deploy production server)
+ * - vite.config.ts   (Vite development and preview servers)
+ *
+ * Browsers only expose SharedArrayBuffer to cross-origin isolated pages.
+ * WASM tool pipelines connect their Workers with SharedArrayBuffer ring
+ * buffers (src/wasm-tools/byte-channel.ts); without isolation, pipe chains
+ * fall back to running one stage at a time with fully buffered output.
+ *
+ * COEP is `credentialless` rather than `require-corp` so that cross-origin
+ * subresources without a Cross-Origin-Resource-Policy header still load
+ * (without cookies). Browsers that do not support `credentialless` (Safari)
+ * are simply not isolated and take the buffered path.
+ */
+export const crossOriginIsolationHeaders: Record<string, string> = {
+  'Cross-Origin-Opener-Policy': 'same-origin',
+  'Cross-Origin-Embedder-Policy': 'credentialless',
+};
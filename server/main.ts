@@ -2,7 +2,8 @@
  * Co-do production server for Deno Deploy.
  *
  * Serves the pre-built static site from `dist/` and attaches security
- * headers (including CSP) to every response.
+ * headers (including CSP) and cross-origin isolation headers to every
+ * response.
  *
  * ## Dynamic Per-Provider CSP
  *
@@ -19,6 +20,7 @@
  */
 
 import { buildCspHeaderForProvider, isWasmWorkerRequest } from './csp.ts';
+import { crossOriginIsolationHeaders } from './isolation.ts';
 import { parseCookies, PROVIDER_COOKIE_NAME } from './providers.ts';
 
 const DIST = 'dist';
@@ -29,6 +31,7 @@ const staticSecurityHeaders: Record<string, string> = {
   'X-Frame-Options': 'DENY',
   'Referrer-Policy': 'strict-origin-when-cross-origin',
   'Permissions-Policy': 'camera=(), microphone=(), geolocation=()',
+  ...crossOriginIsolationHeaders,
 };
 
 /**
@@ -10,6 +10,10 @@
  *   1. Import { registerPipeable } from './pipeable'
  *   2. Call registerPipeable('name', { execute, permissionName, description, argsDescription })
  *   3. That's it — the pipe tool picks it up automatically
+ *
+ * A module may also register a PipelineExecutor that runs runs of
+ * consecutive commands concurrently, streaming bytes between them
+ * instead of passing whole strings from one command to the next.
  */
 
 import type { ToolName } from './preferences';
@@ -38,6 +42,34 @@ export interface PipeableCommand {
   argsDescription: string;
 }
 
+/**
+ * One command of a pipe chain.
+ */
+export interface PipelineStage {
+  tool: string;
+  args: Record<string, unknown>;
+}
+
+/**
+ * Runs consecutive pipeable commands as one streaming pipeline: all stages
+ * start together, connected by bounded byte channels, and a stage that
+ * stops reading early (e.g. head) stops the stages before it.
+ */
+export interface PipelineExecutor {
+  /** Whether this command, with these args, can be a streaming stage */
+  canStream: (stage: PipelineStage) => boolean;
+  /** Run the stages; `stdin` feeds the first one. Output is the last stage's. */
+  execute: (stages: PipelineStage[], stdin?: string) => Promise<PipeableResult>;
+}
+
+/**
+ * A planned part of a pipe chain: either a single command run on its own,
+ * or a run of commands handed to the pipeline executor.
+ */
+export type PipelineSegment =
+  | { kind: 'single'; stage: PipelineStage; index: number }
+  | { kind: 'stream'; stages: PipelineStage[]; index: number };
+
 // ---------------------------------------------------------------------------
 // Registry
 // ---------------------------------------------------------------------------
@@ -73,6 +105,53 @@ export function getAllPipeables(): ReadonlyMap<string, PipeableCommand> {
   return registry;
 }
 
+let pipelineExecutor: PipelineExecutor | null = null;
+
+/**
+ * Register the executor used for streaming runs of commands. Replaces any
+ * previously registered executor.
+ */
+export function registerPipelineExecutor(executor: PipelineExecutor | null): void {
+  pipelineExecutor = executor;
+}
+
+/**
+ * Split a pipe chain into segments. Runs of two or more consecutive
+ * commands the executor can stream become one 'stream' segment; everything
+ * else runs one command at a time.
+ */
+export function planPipeline(stages: PipelineStage[]): PipelineSegment[] {
+  const segments: PipelineSegment[] = [];
+  let i = 0;
+
+  while (i < stages.length) {
+    let end = i;
+    if (pipelineExecutor) {
+      while (end < stages.length && pipelineExecutor.canStream(stages[end]!)) end++;
+    }
+
+    if (end - i >= 2) {
+      segments.push({ kind: 'stream', stages: stages.slice(i, end), index: i });
+      i = end;
+    } else {
+      segments.push({ kind: 'single', stage: stages[i]!, index: i });
+      i++;
+    }
+  }
+
+  return segments;
+}
+
+/**
+ * Run a planned 'stream' segment.
+ */
+export function executeStreamSegment(stages: PipelineStage[], stdin?: string): Promise<PipeableResult> {
+  if (!pipelineExecutor) {
+    return Promise.resolve({ success: false, error: 'No pipeline executor registered' });
+  }
+  return pipelineExecutor.execute(stages, stdin);
+}
+
 /**
  * Auto-generate the pipe tool's description from the registry.
  * Call this after all commands have been registered.
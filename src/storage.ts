@@ -17,7 +17,7 @@ export interface ProviderConfig {
 import type { StoredWasmTool } from './wasm-tools/types';
 
 const DB_NAME = 'co-do-db';
-const DB_VERSION = 6;
+const DB_VERSION = 9;
 const STORE_NAME = 'provider-configs';
 const DIRECTORY_STORE_NAME = 'directory-handles';
 const DIRECTORY_HANDLE_KEY = 'current-directory';
@@ -25,6 +25,9 @@ const CONVERSATIONS_STORE_NAME = 'conversations';
 const WASM_TOOLS_STORE_NAME = 'wasm-tools';
 const WORKSPACES_STORE_NAME = 'workspaces';
 const SKILLS_STORE_NAME = 'skills';
+const WASM_MODULES_STORE_NAME = 'wasm-modules';
+const WASM_BUNDLES_STORE_NAME = 'wasm-bundles';
+const WASM_RESULTS_STORE_NAME = 'wasm-results';
 
 /**
  * Skill metadata stored in IndexedDB for fast discovery.
@@ -45,6 +48,44 @@ export interface SkillMetadata {
   indexedAt: number;
 }
 
+/**
+ * Compiled WebAssembly module cached by content hash of its binary.
+ * Only persisted in browsers that can structured-clone WebAssembly.Module
+ * into IndexedDB.
+ */
+export interface StoredCompiledModule {
+  /** SHA-256 of the WASM binary (hex) */
+  key: string;
+  module: WebAssembly.Module;
+  createdAt: number;
+}
+
+/**
+ * Output of a deterministic WASM tool execution, keyed by the hash of
+ * the tool and its inputs (see executionCache in toolResultCache.ts).
+ */
+export interface StoredExecutionResult {
+  key: string;
+  toolName: string;
+  execution: {
+    exitCode: number;
+    stdout: string;
+    stderr: string;
+    stdoutBinary?: Uint8Array;
+  };
+  byteSize: number;
+  usedAt: number;
+}
+
+/**
+ * Binary of a multicall bundle, stored once for all of its tools. Their
+ * StoredWasmTool records keep an empty wasmBinary and the bundle's ID.
+ */
+interface StoredBundleBinary {
+  id: string;
+  wasmBinary: ArrayBuffer;
+}
+
 /**
  * Tool activity record for storage
  */
@@ -94,6 +135,13 @@ export interface Workspace {
 export class StorageManager {
   private db: IDBDatabase | null = null;
 
+  /**
+   * Bundle binaries read or written this session: every tool of a bundle
+   * gets the same ArrayBuffer, and saving a tool only writes its bundle's
+   * binary when it has changed.
+   */
+  private bundleBinaries: Map<string, ArrayBuffer> = new Map();
+
   /**
    * Initialize the database
    */
@@ -152,6 +200,22 @@ export class StorageManager {
           store.createIndex('indexedAt', 'indexedAt', { unique: false });
         }
 
+        // v7: Compiled WASM modules
+        if (!db.objectStoreNames.contains(WASM_MODULES_STORE_NAME)) {
+          db.createObjectStore(WASM_MODULES_STORE_NAME, { keyPath: 'key' });
+        }
+
+        // v8: Multicall bundle binaries
+        if (!db.objectStoreNames.contains(WASM_BUNDLES_STORE_NAME)) {
+          db.createObjectStore(WASM_BUNDLES_STORE_NAME, { keyPath: 'id' });
+        }
+
+        // v9: Cached results of deterministic WASM tools
+        if (!db.objectStoreNames.contains(WASM_RESULTS_STORE_NAME)) {
+          const store = db.createObjectStore(WASM_RESULTS_STORE_NAME, { keyPath: 'key' });
+          store.createIndex('usedAt', 'usedAt', { unique: false });
+        }
+
         // Add workspaceId index to conversations (fresh install and upgrade)
         const convStore = transaction.objectStore(CONVERSATIONS_STORE_NAME);
         if (!convStore.indexNames.contains('workspaceId')) {
@@ -784,13 +848,67 @@ export class StorageManager {
   async saveWasmTool(tool: StoredWasmTool): Promise<void> {
     const db = this.ensureDB();
 
+    if (tool.bundle === undefined) {
+      return new Promise((resolve, reject) => {
+        const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readwrite');
+        const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
+        const request = store.put(tool);
+
+        request.onsuccess = () => resolve();
+        request.onerror = () => reject(new Error('Failed to save WASM tool'));
+      });
+    }
+
+    // Tools of a multicall bundle reference the bundle's binary
+    const bundle = tool.bundle;
+    const writeBinary = this.bundleBinaries.get(bundle) !== tool.wasmBinary;
     return new Promise((resolve, reject) => {
-      const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readwrite');
-      const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
-      const request = store.put(tool);
+      const transaction = db.transaction(
+        writeBinary ? [WASM_TOOLS_STORE_NAME, WASM_BUNDLES_STORE_NAME] : [WASM_TOOLS_STORE_NAME],
+        'readwrite'
+      );
+      if (writeBinary) {
+        const entry: StoredBundleBinary = { id: bundle, wasmBinary: tool.wasmBinary };
+        transaction.objectStore(WASM_BUNDLES_STORE_NAME).put(entry);
+      }
+      transaction.objectStore(WASM_TOOLS_STORE_NAME).put({ ...tool, wasmBinary: new ArrayBuffer(0) });
 
-      request.onsuccess = () => resolve();
-      request.onerror = () => reject(new Error('Failed to save WASM tool'));
+      transaction.oncomplete = () => {
+        if (writeBinary) this.bundleBinaries.set(bundle, tool.wasmBinary);
+        resolve();
+      };
+      transaction.onerror = () => reject(new Error('Failed to save WASM tool'));
+    });
+  }
+
+  /**
+   * Replace the empty wasmBinary of stored bundle tools with their
+   * bundle's binary. A bundle whose binary is missing leaves the tool
+   * without one, as for a lazy tool that was never downloaded.
+   */
+  private async attachBundleBinaries(tools: StoredWasmTool[]): Promise<StoredWasmTool[]> {
+    for (const tool of tools) {
+      if (tool.bundle === undefined) continue;
+      let binary = this.bundleBinaries.get(tool.bundle);
+      if (!binary) {
+        binary = await this.getBundleBinary(tool.bundle);
+        if (binary) this.bundleBinaries.set(tool.bundle, binary);
+      }
+      if (binary) tool.wasmBinary = binary;
+    }
+    return tools;
+  }
+
+  private async getBundleBinary(id: string): Promise<ArrayBuffer | undefined> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_BUNDLES_STORE_NAME], 'readonly');
+      const store = transaction.objectStore(WASM_BUNDLES_STORE_NAME);
+      const request = store.get(id);
+
+      request.onsuccess = () => resolve((request.result as StoredBundleBinary | undefined)?.wasmBinary);
+      request.onerror = () => reject(new Error('Failed to get WASM bundle binary'));
     });
   }
 
@@ -800,7 +918,7 @@ export class StorageManager {
   async getWasmTool(id: string): Promise<StoredWasmTool | null> {
     const db = this.ensureDB();
 
-    return new Promise((resolve, reject) => {
+    const tool = await new Promise<StoredWasmTool | null>((resolve, reject) => {
       const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readonly');
       const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
       const request = store.get(id);
@@ -808,6 +926,8 @@ export class StorageManager {
       request.onsuccess = () => resolve(request.result || null);
       request.onerror = () => reject(new Error('Failed to get WASM tool'));
     });
+
+    return tool && (await this.attachBundleBinaries([tool]))[0]!;
   }
 
   /**
@@ -816,7 +936,7 @@ export class StorageManager {
   async getWasmToolByName(name: string): Promise<StoredWasmTool | null> {
     const db = this.ensureDB();
 
-    return new Promise((resolve, reject) => {
+    const tool = await new Promise<StoredWasmTool | null>((resolve, reject) => {
       const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readonly');
       const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
       const index = store.index('name');
@@ -825,6 +945,8 @@ export class StorageManager {
       request.onsuccess = () => resolve(request.result || null);
       request.onerror = () => reject(new Error('Failed to get WASM tool by name'));
     });
+
+    return tool && (await this.attachBundleBinaries([tool]))[0]!;
   }
 
   /**
@@ -833,7 +955,7 @@ export class StorageManager {
   async getAllWasmTools(): Promise<StoredWasmTool[]> {
     const db = this.ensureDB();
 
-    return new Promise((resolve, reject) => {
+    const tools = await new Promise<StoredWasmTool[]>((resolve, reject) => {
       const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readonly');
       const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
       const request = store.getAll();
@@ -846,6 +968,8 @@ export class StorageManager {
       };
       request.onerror = () => reject(new Error('Failed to get all WASM tools'));
     });
+
+    return this.attachBundleBinaries(tools);
   }
 
   /**
@@ -894,12 +1018,153 @@ export class StorageManager {
     const db = this.ensureDB();
 
     return new Promise((resolve, reject) => {
-      const transaction = db.transaction([WASM_TOOLS_STORE_NAME], 'readwrite');
-      const store = transaction.objectStore(WASM_TOOLS_STORE_NAME);
+      const transaction = db.transaction([WASM_TOOLS_STORE_NAME, WASM_BUNDLES_STORE_NAME], 'readwrite');
+      transaction.objectStore(WASM_TOOLS_STORE_NAME).clear();
+      transaction.objectStore(WASM_BUNDLES_STORE_NAME).clear();
+
+      transaction.oncomplete = () => {
+        this.bundleBinaries.clear();
+        resolve();
+      };
+      transaction.onerror = () => reject(new Error('Failed to clear WASM tools'));
+    });
+  }
+
+  // ==========================================================================
+  // Compiled WASM Module Cache
+  // ==========================================================================
+
+  /**
+   * Save a compiled module. Rejects (typically with a DataCloneError) in
+   * browsers that cannot store WebAssembly.Module in IndexedDB.
+   */
+  async saveCompiledModule(entry: StoredCompiledModule): Promise<void> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      let request: IDBRequest;
+      try {
+        const transaction = db.transaction([WASM_MODULES_STORE_NAME], 'readwrite');
+        request = transaction.objectStore(WASM_MODULES_STORE_NAME).put(entry);
+      } catch (error) {
+        reject(error);
+        return;
+      }
+
+      request.onsuccess = () => resolve();
+      request.onerror = () => reject(new Error('Failed to save compiled WASM module'));
+    });
+  }
+
+  /**
+   * Get a compiled module by the hash of its binary
+   */
+  async getCompiledModule(key: string): Promise<StoredCompiledModule | null> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_MODULES_STORE_NAME], 'readonly');
+      const store = transaction.objectStore(WASM_MODULES_STORE_NAME);
+      const request = store.get(key);
+
+      request.onsuccess = () => resolve(request.result || null);
+      request.onerror = () => reject(new Error('Failed to get compiled WASM module'));
+    });
+  }
+
+  /**
+   * Clear all cached compiled modules
+   */
+  async clearCompiledModules(): Promise<void> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_MODULES_STORE_NAME], 'readwrite');
+      const store = transaction.objectStore(WASM_MODULES_STORE_NAME);
       const request = store.clear();
 
       request.onsuccess = () => resolve();
-      request.onerror = () => reject(new Error('Failed to clear WASM tools'));
+      request.onerror = () => reject(new Error('Failed to clear compiled WASM modules'));
+    });
+  }
+
+  // ==========================================================================
+  // WASM Execution Result Cache
+  // ==========================================================================
+
+  /**
+   * Save a tool execution result
+   */
+  async saveExecutionResult(entry: StoredExecutionResult): Promise<void> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_RESULTS_STORE_NAME], 'readwrite');
+      const request = transaction.objectStore(WASM_RESULTS_STORE_NAME).put(entry);
+
+      request.onsuccess = () => resolve();
+      request.onerror = () => reject(new Error('Failed to save WASM execution result'));
+    });
+  }
+
+  /**
+   * Get a tool execution result by the hash of the tool and its inputs
+   */
+  async getExecutionResult(key: string): Promise<StoredExecutionResult | null> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_RESULTS_STORE_NAME], 'readonly');
+      const request = transaction.objectStore(WASM_RESULTS_STORE_NAME).get(key);
+
+      request.onsuccess = () => resolve(request.result || null);
+      request.onerror = () => reject(new Error('Failed to get WASM execution result'));
+    });
+  }
+
+  /**
+   * Delete the least recently used execution results until the rest
+   * hold at most maxBytes of output.
+   */
+  async pruneExecutionResults(maxBytes: number): Promise<void> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_RESULTS_STORE_NAME], 'readwrite');
+      const index = transaction.objectStore(WASM_RESULTS_STORE_NAME).index('usedAt');
+
+      // Walk from the most recently used, deleting whatever doesn't fit
+      let keptBytes = 0;
+      const cursorReq = index.openCursor(null, 'prev');
+      cursorReq.onsuccess = () => {
+        const cursor = cursorReq.result;
+        if (!cursor) return;
+        const entry = cursor.value as StoredExecutionResult;
+        if (keptBytes + entry.byteSize <= maxBytes) {
+          keptBytes += entry.byteSize;
+        } else {
+          cursor.delete();
+        }
+        cursor.continue();
+      };
+
+      transaction.oncomplete = () => resolve();
+      transaction.onerror = () => reject(new Error('Failed to prune WASM execution results'));
+    });
+  }
+
+  /**
+   * Clear all cached execution results
+   */
+  async clearExecutionResults(): Promise<void> {
+    const db = this.ensureDB();
+
+    return new Promise((resolve, reject) => {
+      const transaction = db.transaction([WASM_RESULTS_STORE_NAME], 'readwrite');
+      const request = transaction.objectStore(WASM_RESULTS_STORE_NAME).clear();
+
+      request.onsuccess = () => resolve();
+      request.onerror = () => reject(new Error('Failed to clear WASM execution results'));
     });
   }
 
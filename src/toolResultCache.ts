@@ -4,8 +4,15 @@
  * Stores full tool results separately from what gets sent to the LLM.
  * This reduces context bloat by allowing tools to return summaries to the LLM
  * while the UI can retrieve full content from this cache for display.
+ *
+ * Also holds the execution cache: outputs of deterministic WASM tools keyed
+ * by a hash of the tool and its inputs, so the tool manager can answer a
+ * repeated execution without running the tool again.
  */
 
+import { storageManager } from './storage';
+import type { StoredExecutionResult } from './storage';
+
 export interface CachedResult {
   id: string;
   toolName: string;
@@ -198,3 +205,164 @@ class ToolResultCache {
 
 // Export singleton instance
 export const toolResultCache = new ToolResultCache();
+
+// =============================================================================
+// Execution cache
+// =============================================================================
+
+/**
+ * Output of a tool execution, as the execution cache keeps it.
+ */
+export type CachedExecution = StoredExecutionResult['execution'];
+
+/** Execution outputs kept in memory, in bytes of output */
+const MAX_EXECUTION_BYTES = 32 * 1024 * 1024;
+
+/** Execution outputs kept in IndexedDB when persistence is on */
+const MAX_PERSISTED_EXECUTION_BYTES = 64 * 1024 * 1024;
+
+/** Larger outputs are not cached; they would evict everything else */
+const MAX_EXECUTION_ENTRY_BYTES = 4 * 1024 * 1024;
+
+const textEncoder = new TextEncoder();
+
+function toHex(digest: ArrayBuffer): string {
+  return Array.from(new Uint8Array(digest), (b) => b.toString(16).padStart(2, '0')).join('');
+}
+
+/**
+ * SHA-256 over a list of inputs (args, stdin, file contents). Each input is
+ * digested on its own and the key is the digest of those digests, so large
+ * inputs are hashed in place instead of being copied into one buffer, and
+ * moving bytes between inputs changes the key. Missing inputs count as an
+ * input of their own.
+ */
+export async function hashExecutionInputs(
+  inputs: ReadonlyArray<string | ArrayBuffer | ArrayBufferView | undefined>
+): Promise<string> {
+  const digests = new Uint8Array(inputs.length * 33);
+  await Promise.all(inputs.map(async (input, i) => {
+    digests[i * 33] = input === undefined ? 0 : typeof input === 'string' ? 1 : 2;
+    if (input === undefined) return;
+    const bytes = typeof input === 'string' ? textEncoder.encode(input) : input;
+    digests.set(new Uint8Array(await crypto.subtle.digest('SHA-256', bytes)), i * 33 + 1);
+  }));
+  return toHex(await crypto.subtle.digest('SHA-256', digests));
+}
+
+/** Bytes an execution's output takes up, for eviction */
+function executionBytes(execution: CachedExecution): number {
+  // UTF-16 strings
+  return (execution.stdout.length + execution.stderr.length) * 2 + (execution.stdoutBinary?.byteLength ?? 0);
+}
+
+/**
+ * Outputs of deterministic tool executions. In memory, the least recently
+ * used outputs are evicted once their total size passes a limit. Outputs
+ * can also be persisted to IndexedDB, pruned the same way, so they survive
+ * reloads.
+ */
+export class ExecutionCache {
+  private entries: Map<string, StoredExecutionResult> = new Map();
+  private totalBytes = 0;
+  private hits = 0;
+  private misses = 0;
+  private readonly maxBytes: number;
+  private readonly maxPersistedBytes: number;
+
+  constructor(maxBytes = MAX_EXECUTION_BYTES, maxPersistedBytes = MAX_PERSISTED_EXECUTION_BYTES) {
+    this.maxBytes = maxBytes;
+    this.maxPersistedBytes = maxPersistedBytes;
+  }
+
+  /**
+   * Look up an execution, in memory and then (with `persist`) in IndexedDB.
+   */
+  async get(key: string, { persist = false }: { persist?: boolean } = {}): Promise<CachedExecution | undefined> {
+    const entry = this.entries.get(key);
+    if (entry) {
+      // Refresh LRU position
+      this.entries.delete(key);
+      this.entries.set(key, entry);
+      entry.usedAt = Date.now();
+      this.hits++;
+      return entry.execution;
+    }
+
+    if (persist) {
+      try {
+        const persisted = await storageManager.getExecutionResult(key);
+        if (persisted) {
+          persisted.usedAt = Date.now();
+          this.remember(persisted);
+          void storageManager.saveExecutionResult(persisted).catch(() => {});
+          this.hits++;
+          return persisted.execution;
+        }
+      } catch {
+        // Memory only
+      }
+    }
+
+    this.misses++;
+    return undefined;
+  }
+
+  /**
+   * Store an execution's output. Outputs over MAX_EXECUTION_ENTRY_BYTES
+   * are not cached.
+   */
+  set(key: string, toolName: string, execution: CachedExecution, { persist = false }: { persist?: boolean } = {}): void {
+    const byteSize = executionBytes(execution);
+    if (byteSize > MAX_EXECUTION_ENTRY_BYTES || byteSize > this.maxBytes) return;
+
+    const entry: StoredExecutionResult = { key, toolName, execution, byteSize, usedAt: Date.now() };
+    this.remember(entry);
+
+    if (persist) {
+      void storageManager.saveExecutionResult(entry)
+        .then(() => storageManager.pruneExecutionResults(this.maxPersistedBytes))
+        .catch((error) => console.warn('[ExecutionCache] Failed to persist result:', error));
+    }
+  }
+
+  /**
+   * Drop all cached executions, in memory and in IndexedDB.
+   */
+  async clear(): Promise<void> {
+    this.entries.clear();
+    this.totalBytes = 0;
+    try {
+      await storageManager.clearExecutionResults();
+    } catch (error) {
+      console.warn('[ExecutionCache] Failed to clear persisted results:', error);
+    }
+  }
+
+  /**
+   * Get cache statistics
+   */
+  getStats(): { size: number; bytes: number; hits: number; misses: number } {
+    return { size: this.entries.size, bytes: this.totalBytes, hits: this.hits, misses: this.misses };
+  }
+
+  private remember(entry: StoredExecutionResult): void {
+    const existing = this.entries.get(entry.key);
+    if (existing) {
+      this.entries.delete(entry.key);
+      this.totalBytes -= existing.byteSize;
+    }
+    this.entries.set(entry.key, entry);
+    this.totalBytes += entry.byteSize;
+
+    // Evict least recently used until the outputs fit
+    for (const [key, oldest] of this.entries) {
+      if (this.totalBytes <= this.maxBytes) break;
+      this.entries.delete(key);
+      this.totalBytes -= oldest.byteSize;
+    }
+  }
+}
+
+// Export singleton instance
+export const executionCache = new ExecutionCache();
@@ -13,9 +13,11 @@ import {
   registerPipeable,
   getPipeable,
   getPipeableNames,
+  planPipeline,
+  executeStreamSegment,
   buildPipeDescription,
 } from './pipeable';
-import type { PipeableResult } from './pipeable';
+import type { PipeableResult, PipelineSegment } from './pipeable';
 import {
   skillsManager,
   generateSkillMd,
@@ -918,15 +920,34 @@ export const pipeTool = tool({
       };
     }
 
-    // Execute commands in sequence, piping output → stdin
+    // Execute commands in sequence, piping output → stdin. Runs of
+    // streamable commands execute concurrently as one segment; debug mode
+    // needs every intermediate output, so it always runs one at a time.
     let currentOutput: string | undefined;
     const intermediateResults: Array<{ tool: string; output?: string; error?: string }> = [];
+    const stages = commands.map((cmd) => ({ tool: cmd.tool, args: cmd.args || {} }));
+    const segments: PipelineSegment[] = debug
+      ? stages.map((stage, index) => ({ kind: 'single', stage, index }))
+      : planPipeline(stages);
+
+    for (const segment of segments) {
+      if (segment.kind === 'stream') {
+        const result = await executeStreamSegment(segment.stages, currentOutput);
+        if (!result.success) {
+          const first = segment.index + 1;
+          const last = segment.index + segment.stages.length;
+          const names = segment.stages.map((stage) => stage.tool).join(' | ');
+          return { error: `Commands ${first}-${last} (${names}) failed: ${result.error}` };
+        }
+        currentOutput = result.output;
+        continue;
+      }
 
-    for (let i = 0; i < commands.length; i++) {
-      const cmd = commands[i]!;
+      const i = segment.index;
+      const cmd = segment.stage;
       const pipeable = getPipeable(cmd.tool)!; // validated above
 
-      const result = await pipeable.execute(cmd.args || {}, currentOutput);
+      const result = await pipeable.execute(cmd.args, currentOutput);
 
       if (debug) {
         intermediateResults.push({
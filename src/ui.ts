@@ -11,7 +11,7 @@ import { preferencesManager, ToolName } from './preferences';
 import { aiManager, AVAILABLE_MODELS } from './ai';
 import { fileTools, setPermissionCallback } from './tools';
 import { toolResultCache } from './toolResultCache';
-import { wasmToolManager, setWasmPermissionCallback } from './wasm-tools';
+import { wasmToolManager, setWasmPermissionCallback, isWasmTracingEnabled, setWasmTracingEnabled, isWasmResultPersistenceEnabled, setWasmResultPersistenceEnabled, traceStore, toTraceEvents } from './wasm-tools';
 import type { StoredWasmTool } from './wasm-tools/types';
 import { BUILTIN_TOOLS, getCategoryDisplayName, CATEGORY_DISPLAY_ORDER } from './wasm-tools/registry';
 import { toastManager, showToast } from './toasts';
@@ -1049,6 +1049,24 @@ export class UIManager {
       });
     }
 
+    // WASM tool execution tracing
+    const tracingCheckbox = document.getElementById('wasm-tracing-enabled') as HTMLInputElement;
+    if (tracingCheckbox) {
+      tracingCheckbox.checked = isWasmTracingEnabled();
+      tracingCheckbox.addEventListener('change', () => {
+        setWasmTracingEnabled(tracingCheckbox.checked);
+      });
+    }
+
+    // Persisted results of deterministic WASM tools
+    const resultPersistenceCheckbox = document.getElementById('wasm-result-persistence') as HTMLInputElement;
+    if (resultPersistenceCheckbox) {
+      resultPersistenceCheckbox.checked = isWasmResultPersistenceEnabled();
+      resultPersistenceCheckbox.addEventListener('change', () => {
+        setWasmResultPersistenceEnabled(resultPersistenceCheckbox.checked);
+      });
+    }
+
     // Conversation tabs
     this.elements.newConversationBtn.addEventListener('click', () => this.createNewConversation());
   }
@@ -3087,11 +3105,71 @@ export class UIManager {
 
         toolItem.appendChild(resultDetails);
       }
+
+      if (typeof resultObj?.traceId === 'string') {
+        this.addToolTrace(toolItem, resultObj.traceId);
+      }
     }
 
     this.scrollToBottom();
   }
 
+  /**
+   * Add a collapsible execution trace (phase timings, memory, WASI calls)
+   * to a tool call item, with a button to export it as a trace file.
+   */
+  private addToolTrace(toolItem: Element, traceId: string): void {
+    const stored = traceStore.get(traceId);
+    if (!stored) return;
+    const { trace } = stored;
+    const ms = (value: number) => `${value.toFixed(1)}ms`;
+
+    const details = document.createElement('details');
+    details.className = 'tool-item-details tool-trace-details';
+
+    const summaryEl = document.createElement('summary');
+    summaryEl.textContent = `Trace: ${ms(trace.compileMs + trace.instantiateMs + trace.runMs)}, ` +
+      `peak memory ${this.formatBytes(trace.peakMemoryBytes)}`;
+    details.appendChild(summaryEl);
+
+    const rows = Object.entries(trace.syscalls)
+      .sort((a, b) => b[1].ms - a[1].ms)
+      .map(([name, stats]) =>
+        `${name.padEnd(22)}${String(stats.calls).padStart(8)}` +
+        `${this.formatBytes(stats.bytes).padStart(10)}${ms(stats.ms).padStart(10)}`
+      );
+    const tracePre = document.createElement('pre');
+    tracePre.className = 'tool-item-result';
+    tracePre.textContent = [
+      `compile ${ms(trace.compileMs)}, instantiate ${ms(trace.instantiateMs)}, ` +
+        `run ${ms(trace.runMs)} (host calls ${ms(trace.hostMs)})`,
+      `memory ${this.formatBytes(trace.initialMemoryBytes)} -> ${this.formatBytes(trace.peakMemoryBytes)}, ` +
+        `${trace.memoryGrowth.length} growth events`,
+      '',
+      `${'call'.padEnd(22)}${'count'.padStart(8)}${'bytes'.padStart(10)}${'time'.padStart(10)}`,
+      ...rows,
+    ].join('\n');
+    details.appendChild(tracePre);
+
+    const exportBtn = document.createElement('button');
+    exportBtn.type = 'button';
+    exportBtn.className = 'tool-trace-export';
+    exportBtn.textContent = 'Export trace';
+    exportBtn.title = 'Download in Trace Event Format, for chrome://tracing or Perfetto';
+    exportBtn.addEventListener('click', () => {
+      const json = JSON.stringify(toTraceEvents([stored]));
+      const url = URL.createObjectURL(new Blob([json], { type: 'application/json' }));
+      const link = document.createElement('a');
+      link.href = url;
+      link.download = `${stored.toolName}-${stored.id}.json`;
+      link.click();
+      URL.revokeObjectURL(url);
+    });
+    details.appendChild(exportBtn);
+
+    toolItem.appendChild(details);
+  }
+
   /**
    * Create a prominent inline tool output block at the message level.
    *
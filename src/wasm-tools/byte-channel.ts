@@ -0,0 +1,246 @@
+/**
+ * Byte Channel
+ *
+ * A single-producer, single-consumer ring buffer over a SharedArrayBuffer.
+ * It lets stdin/stdout bytes flow between the main thread and a WASM
+ * Worker (or between two Workers) without postMessage copies: fd_read and
+ * fd_write in the Worker copy straight between the ring and WASM linear
+ * memory.
+ *
+ * Only available when the page is cross-origin isolated
+ * (see isByteChannelSupported()); otherwise callers transfer whole
+ * ArrayBuffers instead.
+ *
+ * The ring is bounded, so a fast producer blocks (Worker side) or awaits
+ * (main thread side) until the consumer catches up. The consumer may
+ * cancel the channel to tell the producer to stop early.
+ *
+ * Layout: a small Int32 control block followed by the data region.
+ * Positions are free-running 32-bit counters; the capacity is a power of
+ * two so a position maps to `pos & (capacity - 1)`.
+ */
+
+const READ = 0;         // Bytes consumed so far
+const WRITE = 1;        // Bytes produced so far
+const STATE = 2;        // STATE_* flags
+const WRITE_SEQ = 3;    // Bumped on every write/close (consumer waits on it)
+const READ_SEQ = 4;     // Bumped on every read/cancel (producer waits on it)
+const CONTROL_INTS = 8;
+const CONTROL_BYTES = CONTROL_INTS * 4;
+
+const STATE_CLOSED = 1;     // Producer is done
+const STATE_CANCELLED = 2;  // Consumer no longer wants data
+
+/** Default ring size: 1 MB */
+export const DEFAULT_CHANNEL_CAPACITY = 1 << 20;
+
+/**
+ * Whether SharedArrayBuffer channels can be used in this context.
+ */
+export function isByteChannelSupported(): boolean {
+  return typeof SharedArrayBuffer !== 'undefined' &&
+    (globalThis as { crossOriginIsolated?: boolean }).crossOriginIsolated === true;
+}
+
+export class ByteChannel {
+  readonly buffer: SharedArrayBuffer;
+  private control: Int32Array;
+  private data: Uint8Array;
+  private mask: number;
+
+  /**
+   * Wrap an existing channel buffer (e.g. one received by a Worker), or
+   * create a new one with at least `capacity` bytes.
+   */
+  constructor(bufferOrCapacity: SharedArrayBuffer | number = DEFAULT_CHANNEL_CAPACITY) {
+    if (typeof bufferOrCapacity === 'number') {
+      let capacity = 1024;
+      while (capacity < bufferOrCapacity) capacity *= 2;
+      this.buffer = new SharedArrayBuffer(CONTROL_BYTES + capacity);
+    } else {
+      this.buffer = bufferOrCapacity;
+    }
+    this.control = new Int32Array(this.buffer, 0, CONTROL_INTS);
+    this.data = new Uint8Array(this.buffer, CONTROL_BYTES);
+    this.mask = this.data.length - 1;
+  }
+
+  get capacity(): number {
+    return this.data.length;
+  }
+
+  get closed(): boolean {
+    return (Atomics.load(this.control, STATE) & STATE_CLOSED) !== 0;
+  }
+
+  get cancelled(): boolean {
+    return (Atomics.load(this.control, STATE) & STATE_CANCELLED) !== 0;
+  }
+
+  // ==========================================================================
+  // Producer side
+  // ==========================================================================
+
+  /**
+   * Copy as much of `src` as fits without waiting.
+   * @returns bytes written (0 when full or cancelled)
+   */
+  tryWrite(src: Uint8Array): number {
+    if (this.cancelled) return 0;
+    const read = Atomics.load(this.control, READ);
+    const write = Atomics.load(this.control, WRITE);
+    const free = this.capacity - ((write - read) >>> 0);
+    const n = Math.min(free, src.length);
+    if (n === 0) return 0;
+
+    const start = write & this.mask;
+    const first = Math.min(n, this.capacity - start);
+    this.data.set(src.subarray(0, first), start);
+    if (first < n) {
+      this.data.set(src.subarray(first, n), 0);
+    }
+
+    Atomics.store(this.control, WRITE, (write + n) | 0);
+    Atomics.add(this.control, WRITE_SEQ, 1);
+    Atomics.notify(this.control, WRITE_SEQ);
+    return n;
+  }
+
+  /**
+   * Write all of `src`, blocking while the ring is full. Worker-side only
+   * (Atomics.wait is not allowed on the main thread).
+   * @returns false if the consumer cancelled before everything was written
+   */
+  writeBlocking(src: Uint8Array): boolean {
+    let offset = 0;
+    while (offset < src.length) {
+      const seq = Atomics.load(this.control, READ_SEQ);
+      const n = this.tryWrite(src.subarray(offset));
+      if (this.cancelled) return false;
+      if (n === 0) {
+        Atomics.wait(this.control, READ_SEQ, seq);
+      }
+      offset += n;
+    }
+    return true;
+  }
+
+  /**
+   * Write all of `src`, yielding while the ring is full. Safe on the main
+   * thread.
+   * @returns false if the consumer cancelled before everything was written
+   */
+  async write(src: Uint8Array): Promise<boolean> {
+    let offset = 0;
+    while (offset < src.length) {
+      const seq = Atomics.load(this.control, READ_SEQ);
+      const n = this.tryWrite(src.subarray(offset));
+      if (this.cancelled) return false;
+      if (n === 0) {
+        await this.waitAsync(READ_SEQ, seq);
+      }
+      offset += n;
+    }
+    return true;
+  }
+
+  /**
+   * Signal end of data. The consumer drains what is buffered, then sees EOF.
+   */
+  close(): void {
+    Atomics.or(this.control, STATE, STATE_CLOSED);
+    Atomics.add(this.control, WRITE_SEQ, 1);
+    Atomics.notify(this.control, WRITE_SEQ);
+  }
+
+  // ==========================================================================
+  // Consumer side
+  // ==========================================================================
+
+  /**
+   * Copy buffered bytes into `target` without waiting.
+   * @returns bytes read; 0 if nothing is buffered right now
+   */
+  tryRead(target: Uint8Array): number {
+    const read = Atomics.load(this.control, READ);
+    const write = Atomics.load(this.control, WRITE);
+    const available = (write - read) >>> 0;
+    const n = Math.min(available, target.length);
+    if (n === 0) return 0;
+
+    const start = read & this.mask;
+    const first = Math.min(n, this.capacity - start);
+    target.set(this.data.subarray(start, start + first), 0);
+    if (first < n) {
+      target.set(this.data.subarray(0, n - first), first);
+    }
+
+    Atomics.store(this.control, READ, (read + n) | 0);
+    Atomics.add(this.control, READ_SEQ, 1);
+    Atomics.notify(this.control, READ_SEQ);
+    return n;
+  }
+
+  /**
+   * Read into `target`, blocking until at least one byte is available.
+   * Worker-side only.
+   * @returns bytes read; 0 means end of data
+   */
+  readBlocking(target: Uint8Array): number {
+    if (target.length === 0) return 0;
+    for (;;) {
+      const seq = Atomics.load(this.control, WRITE_SEQ);
+      const n = this.tryRead(target);
+      if (n > 0) return n;
+      if (this.closed) {
+        // Bytes written just before close() are still readable
+        return this.tryRead(target);
+      }
+      Atomics.wait(this.control, WRITE_SEQ, seq);
+    }
+  }
+
+  /**
+   * Read into `target`, yielding until at least one byte is available.
+   * Safe on the main thread.
+   * @returns bytes read; 0 means end of data
+   */
+  async read(target: Uint8Array): Promise<number> {
+    if (target.length === 0) return 0;
+    for (;;) {
+      const seq = Atomics.load(this.control, WRITE_SEQ);
+      const n = this.tryRead(target);
+      if (n > 0) return n;
+      if (this.closed) return this.tryRead(target);
+      await this.waitAsync(WRITE_SEQ, seq);
+    }
+  }
+
+  /**
+   * Tell the producer no more data is wanted (e.g. `head` has enough).
+   */
+  cancel(): void {
+    Atomics.or(this.control, STATE, STATE_CANCELLED);
+    Atomics.add(this.control, READ_SEQ, 1);
+    Atomics.notify(this.control, READ_SEQ);
+  }
+
+  /**
+   * Wait until control[index] changes from `value`, without blocking the
+   * thread. Uses Atomics.waitAsync where available, otherwise polls.
+   */
+  private async waitAsync(index: number, value: number): Promise<void> {
+    const atomics = Atomics as typeof Atomics & {
+      waitAsync?: (array: Int32Array, index: number, value: number, timeout?: number) =>
+        { async: boolean; value: Promise<string> | string };
+    };
+    if (atomics.waitAsync) {
+      const result = atomics.waitAsync(this.control, index, value, 100);
+      if (result.async) await result.value;
+      return;
+    }
+    while (Atomics.load(this.control, index) === value) {
+      await new Promise((resolve) => setTimeout(resolve, 1));
+    }
+  }
+}
@@ -25,7 +25,12 @@ export { WasmRuntime, wasmRuntime } from './runtime';
 export { WasmWorkerManager, wasmWorkerManager } from './worker-manager';
 
 // Loader
-export { WasmToolLoader, wasmToolLoader } from './loader';
+export { WasmToolLoader, wasmToolLoader, isWasmSimdSupported } from './loader';
+
+// Execution traces
+export { ExecutionRecorder } from './instrumentation';
+export { traceStore, toTraceEvents } from './trace-store';
+export type { StoredTrace, TraceEvent } from './trace-store';
 
 // Manager (main entry point)
 export {
@@ -34,6 +39,10 @@ export {
   setWasmPermissionCallback,
   getWasmToolPermission,
   setWasmToolPermission,
+  isWasmTracingEnabled,
+  setWasmTracingEnabled,
+  isWasmResultPersistenceEnabled,
+  setWasmResultPersistenceEnabled,
   convertArgsToCliFormat,
   findBinaryParam,
 } from './manager';
@@ -0,0 +1,137 @@
+/**
+ * WASI Execution Instrumentation
+ *
+ * Opt-in recording of what a module did during one execution, shared by
+ * the Worker (wasm-worker.ts) and main-thread (runtime.ts) runtimes:
+ *
+ * - calls, payload bytes and host time per WASI import
+ * - linear memory growth and peak size
+ * - compile, instantiate and run wall time
+ *
+ * The recorder wraps the WASI import object, so executions without the
+ * `trace` option run the unwrapped imports at no cost.
+ */
+
+import type { ExecutionTrace, MemoryGrowth, SyscallStats } from './worker-types';
+import { MAX_TRACE_GROWTH_EVENTS } from './worker-types';
+
+type HostFunction = (...args: never[]) => unknown;
+
+/**
+ * Payload size of a successful call, by import name. Out-parameters are
+ * read from linear memory after the call has filled them in.
+ */
+const PAYLOAD_BYTES: Record<string, (args: unknown[], memory: WebAssembly.Memory) => number> = {
+  // (fd, iovs, iovs_len, nread | nwritten)
+  fd_read: (args, memory) => new DataView(memory.buffer).getUint32(args[3] as number, true),
+  fd_write: (args, memory) => new DataView(memory.buffer).getUint32(args[3] as number, true),
+  // (fd, iovs, iovs_len, offset, nread | nwritten)
+  fd_pread: (args, memory) => new DataView(memory.buffer).getUint32(args[4] as number, true),
+  fd_pwrite: (args, memory) => new DataView(memory.buffer).getUint32(args[4] as number, true),
+  // (buf, buf_len)
+  random_get: (args) => args[1] as number,
+  // (fd, dirflags | flags, path, path_len, ...)
+  path_open: (args) => args[3] as number,
+  path_filestat_get: (args) => args[3] as number,
+  // (fd, path, path_len)
+  path_create_directory: (args) => args[2] as number,
+  path_remove_directory: (args) => args[2] as number,
+  path_unlink_file: (args) => args[2] as number,
+};
+
+/**
+ * Records one execution. Create one per execution, pass the WASI imports
+ * through instrument() before instantiating, call attach() with the
+ * module's memory just before _start, and finish() once it has returned.
+ */
+export class ExecutionRecorder {
+  private readonly syscalls: Record<string, SyscallStats> = {};
+  private readonly memoryGrowth: MemoryGrowth[] = [];
+  private memory: WebAssembly.Memory | null = null;
+  private memoryBytes = 0;
+  private initialMemoryBytes = 0;
+  private compileMs = 0;
+  private instantiateMs = 0;
+  private runStart = 0;
+  private hostMs = 0;
+
+  /**
+   * Wrap every function in the import object to record its calls.
+   */
+  instrument(imports: WebAssembly.Imports): WebAssembly.Imports {
+    const instrumented: WebAssembly.Imports = {};
+    for (const [namespace, members] of Object.entries(imports)) {
+      const wrapped: Record<string, WebAssembly.ImportValue> = {};
+      for (const [name, value] of Object.entries(members)) {
+        wrapped[name] = typeof value === 'function' ? this.wrap(name, value as HostFunction) : value;
+      }
+      instrumented[namespace] = wrapped;
+    }
+    return instrumented;
+  }
+
+  /**
+   * Start the run clock. Timings are those of the phases before it.
+   */
+  attach(memory: WebAssembly.Memory, compileMs: number, instantiateMs: number): void {
+    this.memory = memory;
+    this.memoryBytes = this.initialMemoryBytes = memory.buffer.byteLength;
+    this.compileMs = compileMs;
+    this.instantiateMs = instantiateMs;
+    this.runStart = performance.now();
+  }
+
+  /**
+   * Stop the run clock and return the trace. Also valid when the module
+   * trapped or never started, in which case the missing phases are zero.
+   */
+  finish(): ExecutionTrace {
+    const now = performance.now();
+    this.observeMemory(now);
+    return {
+      compileMs: this.compileMs,
+      instantiateMs: this.instantiateMs,
+      runMs: this.memory ? now - this.runStart : 0,
+      hostMs: this.hostMs,
+      syscalls: this.syscalls,
+      initialMemoryBytes: this.initialMemoryBytes,
+      // Linear memory never shrinks
+      peakMemoryBytes: this.memoryBytes,
+      memoryGrowth: this.memoryGrowth,
+    };
+  }
+
+  private wrap(name: string, fn: HostFunction): HostFunction {
+    const payloadBytes = PAYLOAD_BYTES[name];
+    return (...args: never[]) => {
+      const stats = (this.syscalls[name] ??= { calls: 0, bytes: 0, ms: 0 });
+      const start = performance.now();
+      // Growth since the previous host call happened before this one
+      this.observeMemory(start);
+      let result: unknown;
+      try {
+        result = fn(...args);
+        return result;
+      } finally {
+        // Also reached when proc_exit unwinds the module
+        const ms = performance.now() - start;
+        stats.calls++;
+        stats.ms += ms;
+        this.hostMs += ms;
+        if (payloadBytes && result === 0 && this.memory) {
+          stats.bytes += payloadBytes(args, this.memory);
+        }
+      }
+    };
+  }
+
+  private observeMemory(now: number): void {
+    if (!this.memory) return;
+    const bytes = this.memory.buffer.byteLength;
+    if (bytes === this.memoryBytes) return;
+    this.memoryBytes = bytes;
+    if (this.memoryGrowth.length < MAX_TRACE_GROWTH_EVENTS) {
+      this.memoryGrowth.push({ atMs: now - this.runStart, bytes });
+    }
+  }
+}
@@ -9,11 +9,18 @@
  * mapping original URLs → hashed URLs. The loader fetches this manifest
  * once and resolves every tool URL through it so CDN caches (Cloudflare
  * etc.) are properly busted on each deploy.
+ *
+ * Tools that have a `simdWasmUrl` are fetched in their simd128 build when
+ * the engine supports WebAssembly SIMD, and in the plain build otherwise.
+ * Tools whose manifest names a `buildProfile` are fetched in that build
+ * (`<tool>.<profile>.wasm`, see wasm-tools/build.sh) when it exists.
+ * Tools in a multicall `bundle` share that bundle's binary when the build
+ * provides it; it is fetched once for all of them.
  */
 
 import JSZip from 'jszip';
 import { WasmToolManifestSchema } from './types';
-import type { WasmToolManifest, StoredWasmTool, BuiltinToolConfig } from './types';
+import type { WasmToolManifest, StoredWasmTool, BuiltinToolConfig, BuildProfile, MulticallBundle } from './types';
 import { BUILTIN_TOOLS } from './registry';
 
 // Security limits for ZIP validation
@@ -25,6 +32,48 @@ const MAX_LAZY_WASM_SIZE = 50 * 1024 * 1024; // 50 MB (for large lazy-loaded too
 /** URL of the manifest generated by the Vite wasmHashPlugin. */
 const WASM_MANIFEST_URL = 'wasm-tools/wasm-manifest.json';
 
+/**
+ * Smallest module using a simd128 instruction (i8x16.splat, i8x16.popcnt).
+ * `WebAssembly.validate` only accepts it on engines with SIMD support.
+ */
+const SIMD_PROBE_MODULE = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01, 0x60,
+  0x00, 0x01, 0x7b, 0x03, 0x02, 0x01, 0x00, 0x0a, 0x0a, 0x01, 0x08, 0x00,
+  0x41, 0x00, 0xfd, 0x0f, 0xfd, 0x62, 0x0b,
+]);
+
+let simdSupported: boolean | null = null;
+
+/**
+ * Whether the engine can run binaries built with `-msimd128`.
+ * The result is cached after the first call.
+ */
+export function isWasmSimdSupported(): boolean {
+  if (simdSupported === null) {
+    try {
+      simdSupported = typeof WebAssembly !== 'undefined' &&
+                      WebAssembly.validate(SIMD_PROBE_MODULE);
+    } catch {
+      simdSupported = false;
+    }
+  }
+  return simdSupported;
+}
+
+/** Check for the WASM magic number (`\0asm`). */
+function hasWasmMagic(binary: ArrayBuffer): boolean {
+  const magic = new Uint8Array(binary.slice(0, 4));
+  return magic[0] === 0x00 && magic[1] === 0x61 && magic[2] === 0x73 && magic[3] === 0x6d;
+}
+
+/**
+ * URL of a binary's build in the given profile:
+ * `wc.wasm` -> `wc.speed.wasm`, `wc.simd.wasm` -> `wc.speed.simd.wasm`.
+ */
+export function profileWasmUrl(wasmUrl: string, profile: BuildProfile): string {
+  return wasmUrl.replace(/(\.simd)?\.wasm$/, `.${profile}$1.wasm`);
+}
+
 /**
  * WASM Tool Loader that handles loading tools from ZIP packages
  * and from the built-in registry.
@@ -33,12 +82,21 @@ export class WasmToolLoader {
   /** Cached hash manifest. `null` means not yet fetched. */
   private wasmManifest: Record<string, string> | null = null;
 
+  /** Whether `wasmManifest` came from the build, rather than the `{}` fallback */
+  private manifestFromBuild = false;
+
   /**
    * In-flight manifest fetch promise.  Stored so concurrent callers of
    * `resolveWasmUrl` share the same request instead of firing duplicates.
    */
   private manifestPromise: Promise<void> | null = null;
 
+  /**
+   * Multicall bundle binaries by bundle ID, fetched once per session and
+   * shared by every tool in the bundle; `null` when the build lacks one.
+   */
+  private bundleBinaries: Map<string, Promise<ArrayBuffer | null>> = new Map();
+
   /**
    * Resolve a raw WASM URL (e.g. `wasm-tools/binaries/base64.wasm`) to
    * its content-hashed equivalent if a manifest is available.
@@ -72,6 +130,7 @@ export class WasmToolLoader {
         const res = await fetch(WASM_MANIFEST_URL);
         if (res.ok) {
           this.wasmManifest = await res.json();
+          this.manifestFromBuild = true;
           this.manifestPromise = null;
           return;
         }
@@ -197,6 +256,84 @@ export class WasmToolLoader {
       return this.createLazyBuiltinTool(config);
     }
 
+    const bundleBinary = config.bundle ? await this.fetchBundleBinary(config.bundle) : null;
+    const wasmBinary = bundleBinary ?? (await this.fetchBuiltinBinary(config));
+
+    const now = Date.now();
+    return {
+      id: `builtin-${config.name}`,
+      manifest: config.manifest,
+      wasmBinary,
+      source: 'builtin',
+      enabled: true,
+      installedAt: now,
+      updatedAt: now,
+      ...(bundleBinary && { bundle: config.bundle!.id }),
+    };
+  }
+
+  /**
+   * Fetch a multicall bundle's binary, preferring its simd128 build.
+   * Every tool in the bundle gets the same ArrayBuffer, so the module
+   * cache hashes and compiles it once. Resolves to null when the build
+   * has no bundle, in which case tools use their own binaries.
+   */
+  fetchBundleBinary(bundle: MulticallBundle): Promise<ArrayBuffer | null> {
+    let binary = this.bundleBinaries.get(bundle.id);
+    if (!binary) {
+      const urls = bundle.simdWasmUrl && isWasmSimdSupported()
+        ? [bundle.simdWasmUrl, bundle.wasmUrl]
+        : [bundle.wasmUrl];
+      binary = this.fetchFirstBinary(urls);
+      this.bundleBinaries.set(bundle.id, binary);
+    }
+    return binary;
+  }
+
+  /**
+   * Fetch the first of the URLs that serves a WASM binary. Returns null
+   * when none does, without throwing.
+   */
+  private async fetchFirstBinary(urls: string[]): Promise<ArrayBuffer | null> {
+    for (const url of urls) {
+      const resolved = await this.resolveWasmUrl(url);
+      // A deployed build lists every binary it has; skip variants it lacks
+      if (this.manifestFromBuild && resolved === url) continue;
+      try {
+        const response = await fetch(resolved);
+        if (response.ok) {
+          const wasmBinary = await response.arrayBuffer();
+          if (hasWasmMagic(wasmBinary)) {
+            return wasmBinary;
+          }
+        }
+      } catch {
+        // Try the next URL
+      }
+    }
+    return null;
+  }
+
+  /**
+   * Fetch the binary for a built-in tool, preferring its simd128 build and
+   * the build profile named in its manifest, in that order. A missing or
+   * invalid variant falls back to the next, down to the plain -O2 binary,
+   * so a build without `-msimd128` or profile output keeps working.
+   */
+  private async fetchBuiltinBinary(config: BuiltinToolConfig): Promise<ArrayBuffer> {
+    const profile = config.manifest.execution.buildProfile;
+    const preferred: string[] = [];
+    if (config.simdWasmUrl && isWasmSimdSupported()) {
+      if (profile) preferred.push(profileWasmUrl(config.simdWasmUrl, profile));
+      preferred.push(config.simdWasmUrl);
+    }
+    if (profile) preferred.push(profileWasmUrl(config.wasmUrl, profile));
+
+    const variant = await this.fetchFirstBinary(preferred);
+    if (variant) {
+      return variant;
+    }
+
     // Resolve to a content-hashed URL when available (cache busting)
     const resolvedUrl = await this.resolveWasmUrl(config.wasmUrl);
     const response = await fetch(resolvedUrl);
@@ -207,21 +344,11 @@ export class WasmToolLoader {
     const wasmBinary = await response.arrayBuffer();
 
     // Validate WASM magic number
-    const magic = new Uint8Array(wasmBinary.slice(0, 4));
-    if (magic[0] !== 0x00 || magic[1] !== 0x61 || magic[2] !== 0x73 || magic[3] !== 0x6d) {
+    if (!hasWasmMagic(wasmBinary)) {
       throw new Error(`Invalid WASM binary for built-in tool: ${config.name}`);
     }
 
-    const now = Date.now();
-    return {
-      id: `builtin-${config.name}`,
-      manifest: config.manifest,
-      wasmBinary,
-      source: 'builtin',
-      enabled: true,
-      installedAt: now,
-      updatedAt: now,
-    };
+    return wasmBinary;
   }
 
   /**
@@ -272,8 +399,7 @@ export class WasmToolLoader {
 
     // Validate WASM magic number (\0asm) to avoid caching corrupt payloads
     // (e.g. HTML error pages or proxy splashes returned with HTTP 200)
-    const magic = new Uint8Array(wasmBinary.slice(0, 4));
-    if (magic[0] !== 0x00 || magic[1] !== 0x61 || magic[2] !== 0x73 || magic[3] !== 0x6d) {
+    if (!hasWasmMagic(wasmBinary)) {
       throw new Error(
         `Downloaded binary for ${toolName} is not a valid WASM file (bad magic number)`
       );
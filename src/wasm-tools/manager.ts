@@ -16,13 +16,22 @@ import { tool, type Tool } from 'ai';
 import { z } from 'zod';
 import { storageManager } from '../storage';
 import { fileSystemManager } from '../fileSystem';
-import { toolResultCache } from '../toolResultCache';
-import { registerPipeable } from '../pipeable';
+import { executionCache, hashExecutionInputs, toolResultCache } from '../toolResultCache';
+import { registerPipeable, registerPipelineExecutor } from '../pipeable';
+import type { PipeableResult, PipelineStage } from '../pipeable';
 import { WasmRuntime } from './runtime';
 import { VirtualFileSystem } from './vfs';
 import { WasmToolLoader } from './loader';
 import { BUILTIN_TOOLS, getWasmToolName } from './registry';
 import { wasmWorkerManager } from './worker-manager';
+import type { WorkerProgress } from './worker-manager';
+import { wasmModuleCache } from './module-cache';
+import type { CachedModule } from './module-cache';
+import { isByteChannelSupported } from './byte-channel';
+import { runStreamingPipeline } from './pipeline';
+import type { PreparedStage } from './pipeline';
+import { expandSearchPaths, runParallelSearch } from './parallel-grep';
+import { traceStore } from './trace-store';
 import type {
   StoredWasmTool,
   BuiltinToolConfig,
@@ -40,6 +49,12 @@ const TOOL_ADAPTERS: Record<string, () => Promise<{ execute: (wasmBinary: ArrayB
   ffmpeg: () => import('./adapters/ffmpeg-adapter'),
 };
 
+/**
+ * Tools whose `paths` (and `recursive`) searches are split across parallel
+ * Workers by parallel-grep.ts instead of running as one execution.
+ */
+const PARALLEL_SEARCH_TOOLS = new Set(['grep']);
+
 /**
  * JSON.stringify with sorted keys so property insertion order doesn't
  * cause spurious manifest-comparison mismatches.
@@ -96,6 +111,38 @@ export function setWasmToolPermission(toolName: string, level: 'always' | 'ask'
   localStorage.setItem(`wasm_tool_permission_${toolName}`, level);
 }
 
+/**
+ * Whether executions record an ExecutionTrace (WASI calls, memory growth,
+ * phase timings) for display in the UI. Stored in localStorage; off by
+ * default.
+ */
+export function isWasmTracingEnabled(): boolean {
+  return localStorage.getItem('wasm_tool_tracing') === 'true';
+}
+
+/**
+ * Enable or disable execution tracing.
+ */
+export function setWasmTracingEnabled(enabled: boolean): void {
+  localStorage.setItem('wasm_tool_tracing', String(enabled));
+}
+
+/**
+ * Whether results of deterministic tools are also kept in IndexedDB, so
+ * they are reused after a reload. Stored in localStorage; off by default.
+ */
+export function isWasmResultPersistenceEnabled(): boolean {
+  return localStorage.getItem('wasm_tool_result_persistence') === 'true';
+}
+
+/**
+ * Enable or disable persisting deterministic tool results.
+ */
+export function setWasmResultPersistenceEnabled(enabled: boolean): void {
+  localStorage.setItem('wasm_tool_result_persistence', String(enabled));
+  if (!enabled) void executionCache.clear();
+}
+
 /**
  * Check if a WASM tool has permission to execute.
  */
@@ -146,6 +193,9 @@ export class WasmToolManager {
           'Web Workers not supported. WASM tools will run on main thread (may cause UI freezing).'
         );
         this.useWorker = false;
+      } else {
+        // Have a Worker started before the first tool call
+        wasmWorkerManager.prewarm();
       }
 
       // Load all tools from storage
@@ -382,6 +432,14 @@ export class WasmToolManager {
       execute: async (input: Record<string, unknown>) => {
         const result = await this.executeTool(toolName, input);
 
+        // Keep the trace for the UI; the LLM only sees its ID
+        let traceId: string | undefined;
+        if (result.trace) {
+          const { compileMs, instantiateMs, runMs } = result.trace;
+          const startedAt = Date.now() - (compileMs + instantiateMs + runMs);
+          traceId = traceStore.store(toolDisplayName, input, startedAt, result.trace);
+        }
+
         // If the tool produced binary output, base64-encode it for the AI
         // and store the raw bytes in the cache for the UI to retrieve.
         if (result.stdoutBinary && result.stdoutBinary.length > 0) {
@@ -415,6 +473,7 @@ export class WasmToolManager {
             exitCode: result.exitCode,
             stderr: result.stderr || undefined,
             error: result.error || undefined,
+            traceId,
           };
         }
 
@@ -456,6 +515,7 @@ export class WasmToolManager {
           exitCode: result.exitCode,
           stderr: result.stderr || undefined,
           error: result.error || undefined,
+          traceId,
         };
       },
     });
@@ -534,18 +594,74 @@ export class WasmToolManager {
     }
 
     // 4. Determine execution mode
-    // Worker mode currently only supports stdin/stdout tools (no file access)
-    // Tools requiring file access must run on the main thread until
-    // Worker file support is implemented
+    // Worker mode supports stdin/stdout tools, plus read-only tools whose
+    // files are named by fileParams and can be pre-loaded into its VFS.
+    // Other tools requiring file access run on the main thread.
     const fileAccess = manifest.execution?.fileAccess ?? 'none';
+    const preloadable = fileAccess === 'read' && (manifest.execution.fileParams?.length ?? 0) > 0;
     const canUseWorker = this.useWorker &&
                          wasmWorkerManager.supported &&
-                         fileAccess === 'none';
+                         (fileAccess === 'none' || preloadable);
+
+    if (PARALLEL_SEARCH_TOOLS.has(manifest.name) && args.paths !== undefined) {
+      return this.executeSearch(storedTool, args, canUseWorker);
+    }
+
+    // 5. Deterministic tools reuse the output of an identical earlier run
+    // (same binary, argv, stdin and file contents) without instantiating
+    // anything. Traced executions always run, to produce their trace.
+    const cacheable = manifest.execution.deterministic === true && !isWasmTracingEnabled();
+    const filesBinary = preloadable && (canUseWorker || cacheable)
+      ? await readProjectFiles(collectFileParamPaths(manifest, args))
+      : {};
+    const cacheKey = cacheable
+      ? await this.getExecutionKey(storedTool, cliArgs, stdin, stdinBinary, filesBinary)
+      : null;
+    const persist = isWasmResultPersistenceEnabled();
+    if (cacheKey) {
+      const cached = await executionCache.get(cacheKey, { persist });
+      if (cached) {
+        return { success: cached.exitCode === 0, ...cached };
+      }
+    }
+
+    const result = canUseWorker
+      ? await this.executeInWorker(storedTool, cliArgs, stdin, stdinBinary, filesBinary)
+      : await this.executeOnMainThread(storedTool, cliArgs, stdin, stdinBinary);
 
-    if (canUseWorker) {
-      return this.executeInWorker(storedTool, cliArgs, stdin, stdinBinary);
-    } else {
-      return this.executeOnMainThread(storedTool, cliArgs, stdin, stdinBinary);
+    // Failures to run (timeouts, crashes) are not a property of the inputs
+    if (cacheKey && result.error === undefined) {
+      const { exitCode, stdout, stderr, stdoutBinary } = result;
+      executionCache.set(cacheKey, manifest.name, { exitCode, stdout, stderr, stdoutBinary }, { persist });
+    }
+    return result;
+  }
+
+  /**
+   * Execution cache key: hash of the tool's binary and version, its argv,
+   * stdin, and the files it reads in path order. Null when hashing is
+   * unavailable (no crypto.subtle outside secure contexts).
+   */
+  private async getExecutionKey(
+    storedTool: StoredWasmTool,
+    cliArgs: string[],
+    stdin: string | undefined,
+    stdinBinary: Uint8Array | undefined,
+    filesBinary: Record<string, ArrayBuffer>
+  ): Promise<string | null> {
+    try {
+      const toolHash = await wasmModuleCache.keyFor(storedTool.wasmBinary);
+      const paths = Object.keys(filesBinary).sort();
+      return await hashExecutionInputs([
+        `${toolHash}:${storedTool.manifest.version}`,
+        JSON.stringify(cliArgs),
+        stdin,
+        stdinBinary,
+        JSON.stringify(paths),
+        ...paths.map((path) => filesBinary[path]),
+      ]);
+    } catch {
+      return null;
     }
   }
 
@@ -700,19 +816,18 @@ export class WasmToolManager {
     storedTool: StoredWasmTool,
     cliArgs: string[],
     stdin?: string,
-    stdinBinary?: Uint8Array
+    stdinBinary?: Uint8Array,
+    filesBinary: Record<string, ArrayBuffer> = {}
   ): Promise<ToolExecutionResult> {
     const { manifest } = storedTool;
 
     try {
-      // Pre-load files if the tool needs file access
-      // TODO: Implement file pre-loading for tools that need it
-      // For now, we only support stdin/stdout tools in Worker mode
-      const files: Record<string, string> = {};
+      // Prefer a cached compiled module; the Worker then only instantiates
+      const cached = await this.getCompiledModule(storedTool);
 
       // Execute in Worker
       const result = await wasmWorkerManager.execute(
-        storedTool.wasmBinary.slice(0), // Copy buffer (will be transferred)
+        cached?.module ?? storedTool.wasmBinary.slice(0), // Binary copy is transferred
         cliArgs,
         {
           timeout: manifest.execution.timeout ?? 30000,
@@ -724,7 +839,9 @@ export class WasmToolManager {
                 stdinBinary.byteOffset + stdinBinary.byteLength
               ) as ArrayBuffer
             : undefined,
-          files,
+          filesBinary,
+          onProgress: (progress) => this.reportStartup(manifest.name, cached, progress),
+          trace: isWasmTracingEnabled(),
         }
       );
 
@@ -734,6 +851,9 @@ export class WasmToolManager {
         stderr: result.stderr,
         exitCode: result.exitCode,
         stdoutBinary: result.stdoutBinary,
+        // The Worker only instantiates a cached module; report the cache's
+        // compile (or load) time instead, as reportStartup() does
+        trace: result.trace && cached ? { ...result.trace, compileMs: cached.loadMs } : result.trace,
       };
     } catch (error) {
       const errorMessage = error instanceof Error ? error.message : String(error);
@@ -747,6 +867,93 @@ export class WasmToolManager {
     }
   }
 
+  /**
+   * Search the project files named by `paths` (directories expanded with
+   * `recursive`). In Workers the files are sharded across one Worker per
+   * core; on the main thread grep searches them in one run.
+   */
+  private async executeSearch(
+    storedTool: StoredWasmTool,
+    args: Record<string, unknown>,
+    useWorker: boolean
+  ): Promise<ToolExecutionResult> {
+    const { manifest } = storedTool;
+    const { paths, recursive, ...searchArgs } = args;
+    const files = expandSearchPaths(
+      (Array.isArray(paths) ? paths : [paths]).filter((p): p is string => typeof p === 'string'),
+      recursive === true,
+      fileSystemManager.getAllEntries()
+    );
+    const output = {
+      count: searchArgs.count === true,
+      filesWithMatches: searchArgs.filesWithMatches === true,
+      onlyMatching: searchArgs.onlyMatching === true,
+      lineNumbers: searchArgs.lineNumbers === true,
+      maxCount: typeof searchArgs.maxCount === 'number' ? searchArgs.maxCount : undefined,
+      withFilename: recursive === true || files.length > 1,
+    };
+
+    let cliArgs: string[];
+    try {
+      ({ cliArgs } = this.convertArgsToCliFormat(manifest, searchArgs));
+    } catch (error) {
+      const message = error instanceof Error ? error.message : String(error);
+      return { success: false, stdout: '', stderr: message, exitCode: 2, error: message };
+    }
+
+    if (files.length === 0) {
+      return { success: false, stdout: '', stderr: '', exitCode: 1 };
+    }
+
+    if (!useWorker) {
+      return this.executeOnMainThread(storedTool, [
+        ...cliArgs,
+        ...(output.withFilename ? ['--withFilename'] : []),
+        ...files.flatMap((path) => ['--paths', path]),
+      ]);
+    }
+
+    try {
+      // Unreadable files are still searched so grep reports them
+      const searchFiles = await Promise.all(
+        files.map(async (path) => ({
+          path,
+          data: await fileSystemManager.readFileBinary(path).catch(() => undefined),
+        }))
+      );
+      const sharedFiles = await readProjectFiles(collectFileParamPaths(manifest, searchArgs));
+
+      const cached = await this.getCompiledModule(storedTool);
+      const result = await runParallelSearch(
+        {
+          wasm: cached?.module ?? storedTool.wasmBinary,
+          args: cliArgs,
+          sharedFiles,
+          timeout: manifest.execution.timeout ?? 30000,
+          memoryPages: manifest.execution.memoryLimit,
+          output,
+        },
+        searchFiles
+      );
+
+      return {
+        success: result.exitCode === 0,
+        stdout: result.stdout,
+        stderr: result.stderr,
+        exitCode: result.exitCode,
+      };
+    } catch (error) {
+      const errorMessage = error instanceof Error ? error.message : String(error);
+      return {
+        success: false,
+        stdout: '',
+        stderr: errorMessage,
+        exitCode: 2,
+        error: errorMessage,
+      };
+    }
+  }
+
   /**
    * Execute WASM on the main thread (fallback).
    *
@@ -776,13 +983,15 @@ export class WasmToolManager {
     }
 
     try {
+      const cached = await this.getCompiledModule(storedTool);
       const result = await this.runtime.execute(
-        storedTool.wasmBinary,
+        cached?.module ?? storedTool.wasmBinary,
         cliArgs,
         {
           timeout: manifest.execution.timeout ?? 30000,
           memoryLimit: manifest.execution.memoryLimit,
           fileAccess: manifest.execution.fileAccess,
+          trace: isWasmTracingEnabled(),
         },
         vfs
       );
@@ -793,6 +1002,7 @@ export class WasmToolManager {
         stderr: result.stderr,
         exitCode: result.exitCode,
         stdoutBinary: result.stdoutBinary,
+        trace: result.trace && cached ? { ...result.trace, compileMs: cached.loadMs } : result.trace,
       };
     } catch (error) {
       const errorMessage = error instanceof Error ? error.message : String(error);
@@ -806,6 +1016,38 @@ export class WasmToolManager {
     }
   }
 
+  /**
+   * Get the tool's compiled module from the module cache. Returns null if
+   * caching is unavailable (e.g. no crypto.subtle outside secure contexts),
+   * in which case the binary is compiled per execution as before.
+   */
+  private async getCompiledModule(storedTool: StoredWasmTool): Promise<CachedModule | null> {
+    try {
+      return await wasmModuleCache.get(storedTool.wasmBinary);
+    } catch (error) {
+      console.warn(`[WasmToolManager] Module cache unavailable for ${storedTool.manifest.name}:`, error);
+      return null;
+    }
+  }
+
+  /**
+   * Log cold vs warm start-up cost from a Worker's timing progress message.
+   */
+  private reportStartup(toolName: string, cached: CachedModule | null, progress: WorkerProgress): void {
+    const timing = progress.timing;
+    if (!timing) return;
+
+    const compiled = cached ? cached.source === 'compiled' : timing.compiled;
+    const compileMs = cached ? cached.loadMs : timing.compileMs;
+    const warm = !compiled && timing.pooledWorker;
+    console.log(
+      `[WasmToolManager] ${toolName}: ${warm ? 'warm' : 'cold'} start ` +
+        `(module: ${cached?.source ?? 'compiled in worker'}, ` +
+        `worker: ${timing.pooledWorker ? 'pooled' : 'new'}, ` +
+        `compile ${compileMs.toFixed(1)}ms, instantiate ${timing.instantiateMs.toFixed(1)}ms)`
+    );
+  }
+
   /**
    * Convert arguments to CLI format based on the manifest's argStyle.
    * Delegates to the standalone `convertArgsToCliFormat` function.
@@ -901,7 +1143,8 @@ export class WasmToolManager {
   /**
    * Load built-in tools into IndexedDB if they don't exist, and update
    * existing built-in tools whose manifests have changed (e.g. after a
-   * release that adds stdinParam, changes argStyle, etc.).
+   * release that adds stdinParam, changes argStyle, etc.) or that can move
+   * onto a multicall bundle the build now provides.
    */
   async loadBuiltinTools(): Promise<number> {
     const builtinConfigs = this.loader.getBuiltinToolConfigs();
@@ -913,7 +1156,11 @@ export class WasmToolManager {
       if (existing && existing.source === 'builtin') {
         // Sync manifest with registry so stale IndexedDB entries
         // pick up new fields (stdinParam, argStyle, etc.).
-        if (stableStringify(existing.manifest) !== stableStringify(config.manifest)) {
+        const manifestChanged = stableStringify(existing.manifest) !== stableStringify(config.manifest);
+        // The bundle is fetched at most once per session for all its tools
+        const bundleAvailable = !!config.bundle && existing.bundle !== config.bundle.id &&
+          (await this.loader.fetchBundleBinary(config.bundle)) !== null;
+        if (manifestChanged || bundleAvailable) {
           try {
             // For lazy-loaded tools that already have a downloaded binary,
             // preserve it and only update the manifest. This intentionally
@@ -937,13 +1184,14 @@ export class WasmToolManager {
                 ...existing,
                 manifest: reloaded.manifest,
                 wasmBinary: reloaded.wasmBinary,
+                bundle: reloaded.bundle,
                 updatedAt: Date.now(),
               };
               await storageManager.saveWasmTool(updated);
               this.tools.set(updated.manifest.name, updated);
             }
             loadedCount++;
-            console.log(`Updated built-in tool manifest: ${config.name}`);
+            console.log(`Updated built-in tool ${manifestChanged ? 'manifest' : 'binary'}: ${config.name}`);
           } catch (error) {
             console.warn(`Failed to refresh built-in tool ${config.name}:`, error);
           }
@@ -1032,18 +1280,142 @@ export class WasmToolManager {
       console.log(`Registered ${count} WASM tools as pipeable commands`);
     }
 
+    registerPipelineExecutor({
+      canStream: (stage) => this.canStream(stage),
+      execute: (stages, stdin) => this.executePipeline(stages, stdin),
+    });
+
     return count;
   }
 
+  /**
+   * Whether a pipe stage can run as part of a streaming pipeline: a
+   * Worker-compatible WASI tool that takes its piped input on stdin, with
+   * the input left for the previous stage to provide.
+   */
+  private canStream(stage: PipelineStage): boolean {
+    if (!this.useWorker || !wasmWorkerManager.supported || !isByteChannelSupported()) {
+      return false;
+    }
+
+    const storedTool = this.tools.get(stage.tool);
+    if (!storedTool?.enabled || !storedTool.manifest.pipeable) return false;
+    if (TOOL_ADAPTERS[stage.tool]) return false;
+
+    const { manifest } = storedTool;
+    const { stdinParam, argStyle, fileAccess } = manifest.execution;
+    if (!stdinParam || stdinParam !== this.findInputParam(manifest)) return false;
+    if (argStyle === 'json') return false;
+    if (stage.args[stdinParam] !== undefined) return false;
+
+    // Read-only file tools stream only when they were given no files
+    const { fileParams } = manifest.execution;
+    if ((fileAccess ?? 'none') !== 'none') {
+      if (fileAccess !== 'read' || !fileParams?.length) return false;
+      if (collectFileParamPaths(manifest, stage.args).length > 0) return false;
+    }
+
+    // Binary parameters are delivered on stdin too, which the channel owns
+    try {
+      return findBinaryParam(manifest) === null;
+    } catch {
+      return false;
+    }
+  }
+
+  /**
+   * Run streamable pipe stages concurrently (see pipeline.ts). Permission
+   * is checked for every stage before any of them starts.
+   */
+  private async executePipeline(stages: PipelineStage[], stdin?: string): Promise<PipeableResult> {
+    const prepared: PreparedStage[] = [];
+    // Execution cache inputs, while every stage is deterministic
+    let cacheInputs: string[] | null = isWasmTracingEnabled() ? null : [];
+
+    for (const stage of stages) {
+      const storedTool = this.tools.get(stage.tool);
+      if (!storedTool) {
+        return { success: false, error: `Tool not found: ${stage.tool}` };
+      }
+
+      const { manifest } = storedTool;
+      const allowed = await checkWasmPermission(getWasmToolName(manifest), stage.args);
+      if (!allowed) {
+        return { success: false, error: `${stage.tool}: Permission denied` };
+      }
+
+      let cliArgs: string[];
+      try {
+        ({ cliArgs } = this.convertArgsToCliFormat(manifest, stage.args));
+      } catch (error) {
+        return { success: false, error: `${stage.tool}: ${error instanceof Error ? error.message : String(error)}` };
+      }
+
+      if (cacheInputs && manifest.execution.deterministic) {
+        try {
+          const toolHash = await wasmModuleCache.keyFor(storedTool.wasmBinary);
+          cacheInputs.push(`${toolHash}:${manifest.version}`, JSON.stringify(cliArgs));
+        } catch {
+          cacheInputs = null;
+        }
+      } else {
+        cacheInputs = null;
+      }
+
+      const cached = await this.getCompiledModule(storedTool);
+      prepared.push({
+        name: stage.tool,
+        wasm: cached?.module ?? storedTool.wasmBinary.slice(0), // Binary copy is transferred
+        args: cliArgs,
+        timeout: manifest.execution.timeout ?? 30000,
+        memoryPages: manifest.execution.memoryLimit,
+      });
+    }
+
+    // A pipeline of deterministic stages is cached as a whole; its
+    // intermediate outputs only exist inside the channels
+    const cacheKey = cacheInputs ? await hashExecutionInputs([...cacheInputs, stdin]).catch(() => null) : null;
+    const persist = isWasmResultPersistenceEnabled();
+    if (cacheKey) {
+      const cached = await executionCache.get(cacheKey, { persist });
+      if (cached) {
+        return { success: true, output: cached.stdout };
+      }
+    }
+
+    const result = await runStreamingPipeline(prepared, stdin);
+    if (result.success) {
+      if (cacheKey) {
+        const name = prepared.map((stage) => stage.name).join(' | ');
+        executionCache.set(cacheKey, name, { exitCode: 0, stdout: result.stdout, stderr: '' }, { persist });
+      }
+      return { success: true, output: result.stdout };
+    }
+
+    const index = result.failedStage ?? prepared.length - 1;
+    const stageResult = result.stages[index]!;
+    const name = prepared[index]!.name;
+    const error = 'error' in stageResult
+      ? stageResult.error
+      : stageResult.stderr || `exit ${stageResult.exitCode}`;
+    return { success: false, error: `${name} failed: ${error}` };
+  }
+
   /**
    * Find the first string-typed parameter that serves as the primary
-   * text input for a pipeable tool. Checks `required` list first,
-   * then falls back to well-known names like "input" or "text".
+   * text input for a pipeable tool. Uses the declared stdinParam when
+   * there is one, then checks the `required` list, then falls back to
+   * well-known names like "input" or "text".
    */
   private findInputParam(manifest: WasmToolManifest): string | null {
     const props = manifest.parameters.properties;
     const required = manifest.parameters.required ?? [];
 
+    const { stdinParam } = manifest.execution;
+    if (stdinParam && props[stdinParam]?.type === 'string') {
+      return stdinParam;
+    }
+
     // Prefer the first required string param named "input" or "text"
     for (const name of required) {
       const prop = props[name];
@@ -1125,6 +1497,49 @@ export function findBinaryParam(manifest: WasmToolManifest): string | null {
   return binaryParams[0] ?? null;
 }
 
+/**
+ * Read project files for a Worker's VFS. Unreadable paths are left out so
+ * the tool reports them as it would any missing file.
+ */
+async function readProjectFiles(paths: string[]): Promise<Record<string, ArrayBuffer>> {
+  const files: Record<string, ArrayBuffer> = {};
+  for (const path of paths) {
+    try {
+      files[path] = await fileSystemManager.readFileBinary(path);
+    } catch {
+      // Reported by the tool
+    }
+  }
+  return files;
+}
+
+/**
+ * Collect the project file paths named by a manifest's fileParams, in
+ * argument order and without duplicates. Paths are returned without a
+ * leading '/', which is how the Worker VFS keys its files.
+ */
+export function collectFileParamPaths(
+  manifest: WasmToolManifest,
+  args: Record<string, unknown>
+): string[] {
+  const paths = new Set<string>();
+  for (const param of manifest.execution.fileParams ?? []) {
+    const value = args[param];
+    const values = Array.isArray(value) ? value : value === undefined ? [] : [value];
+    for (const item of values) {
+      if (typeof item === 'string' && item.trim()) {
+        paths.add(item.trim().replace(/^\/+/, ''));
+      }
+    }
+  }
+  return [...paths];
+}
+
+/** Positional argv entries for one value; arrays expand to one entry each. */
+function positionalValues(value: unknown): string[] {
+  return Array.isArray(value) ? value.map(String) : [String(value)];
+}
+
 /**
  * Convert tool arguments to CLI format based on the manifest's argStyle.
  *
@@ -1183,6 +1598,11 @@ export function convertArgsToCliFormat(
           if (value) {
             result.push(`--${key}`);
           }
+        } else if (Array.isArray(value)) {
+          // Repeat the option once per element
+          for (const item of value) {
+            result.push(`--${key}`, String(item));
+          }
         } else {
           result.push(`--${key}`, String(value));
         }
@@ -1200,7 +1620,7 @@ export function convertArgsToCliFormat(
       for (const key of required) {
         if (key === stdinParam) { seen.add(key); continue; }
         if (filteredArgs[key] !== undefined) {
-          result.push(String(filteredArgs[key]));
+          result.push(...positionalValues(filteredArgs[key]));
           seen.add(key);
         }
       }
@@ -1209,7 +1629,7 @@ export function convertArgsToCliFormat(
       for (const key of Object.keys(manifest.parameters.properties)) {
         if (key === stdinParam) continue;
         if (!seen.has(key) && filteredArgs[key] !== undefined) {
-          result.push(String(filteredArgs[key]));
+          result.push(...positionalValues(filteredArgs[key]));
         }
       }
 
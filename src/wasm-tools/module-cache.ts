@@ -0,0 +1,149 @@
+/**
+ * Compiled WASM Module Cache
+ *
+ * Compiling a tool's binary is the most expensive part of a cold start, and
+ * the same handful of tools (grep, wc, sort, ...) run over and over in agent
+ * pipelines. This cache keeps one compiled WebAssembly.Module per distinct
+ * binary, keyed by the SHA-256 of its bytes so an updated tool never reuses
+ * a stale module.
+ *
+ * Lookup order:
+ * 1. In-memory map (same page session)
+ * 2. IndexedDB, in browsers that can structured-clone WebAssembly.Module
+ *    (the first failed write turns persistence off for the session)
+ * 3. WebAssembly.compile()
+ *
+ * Modules can be posted to Workers, so the Worker sandbox only has to
+ * instantiate them.
+ */
+
+import { storageManager } from '../storage';
+
+/**
+ * Where a module came from, for cold/warm start reporting.
+ * - memory: compiled earlier in this session
+ * - persisted: loaded from IndexedDB
+ * - compiled: compiled for this call (cold start)
+ */
+export type ModuleSource = 'memory' | 'persisted' | 'compiled';
+
+export interface CachedModule {
+  module: WebAssembly.Module;
+  source: ModuleSource;
+  /** Time spent hashing, loading and/or compiling, in milliseconds */
+  loadMs: number;
+}
+
+/** Modules kept in memory; the least recently used one is dropped first. */
+const MAX_MEMORY_ENTRIES = 64;
+
+export class WasmModuleCache {
+  private modules: Map<string, WebAssembly.Module> = new Map();
+  private pendingCompiles: Map<string, Promise<WebAssembly.Module>> = new Map();
+  // Hashes are memoized per buffer; StoredWasmTool binaries are long-lived
+  private keys: WeakMap<ArrayBuffer, string> = new WeakMap();
+  private persistenceEnabled = true;
+
+  /**
+   * Get a compiled module for the binary, compiling it at most once.
+   */
+  async get(wasmBinary: ArrayBuffer): Promise<CachedModule> {
+    const startTime = performance.now();
+    const key = await this.keyFor(wasmBinary);
+
+    const cached = this.modules.get(key);
+    if (cached) {
+      // Refresh LRU position
+      this.modules.delete(key);
+      this.modules.set(key, cached);
+      return { module: cached, source: 'memory', loadMs: performance.now() - startTime };
+    }
+
+    const persisted = await this.loadPersisted(key);
+    if (persisted) {
+      this.remember(key, persisted);
+      return { module: persisted, source: 'persisted', loadMs: performance.now() - startTime };
+    }
+
+    // Concurrent cold starts of the same tool share one compilation
+    let compile = this.pendingCompiles.get(key);
+    if (!compile) {
+      compile = WebAssembly.compile(wasmBinary);
+      this.pendingCompiles.set(key, compile);
+    }
+    try {
+      const module = await compile;
+      if (!this.modules.has(key)) {
+        this.remember(key, module);
+        void this.persist(key, module);
+      }
+      return { module, source: 'compiled', loadMs: performance.now() - startTime };
+    } finally {
+      this.pendingCompiles.delete(key);
+    }
+  }
+
+  /**
+   * Drop all cached modules, in memory and in IndexedDB.
+   */
+  async clear(): Promise<void> {
+    this.modules.clear();
+    try {
+      await storageManager.clearCompiledModules();
+    } catch (error) {
+      console.warn('[WasmModuleCache] Failed to clear persisted modules:', error);
+    }
+  }
+
+  /** Number of modules held in memory. */
+  get size(): number {
+    return this.modules.size;
+  }
+
+  /**
+   * SHA-256 of a binary (hex), memoized per buffer. Also identifies the
+   * tool version in execution cache keys.
+   */
+  async keyFor(wasmBinary: ArrayBuffer): Promise<string> {
+    const known = this.keys.get(wasmBinary);
+    if (known) return known;
+
+    const digest = await crypto.subtle.digest('SHA-256', wasmBinary);
+    const key = Array.from(new Uint8Array(digest), (b) => b.toString(16).padStart(2, '0')).join('');
+    this.keys.set(wasmBinary, key);
+    return key;
+  }
+
+  private remember(key: string, module: WebAssembly.Module): void {
+    this.modules.set(key, module);
+    if (this.modules.size > MAX_MEMORY_ENTRIES) {
+      const oldest = this.modules.keys().next().value;
+      if (oldest !== undefined) this.modules.delete(oldest);
+    }
+  }
+
+  private async loadPersisted(key: string): Promise<WebAssembly.Module | null> {
+    if (!this.persistenceEnabled) return null;
+    try {
+      const entry = await storageManager.getCompiledModule(key);
+      return entry?.module instanceof WebAssembly.Module ? entry.module : null;
+    } catch {
+      return null;
+    }
+  }
+
+  private async persist(key: string, module: WebAssembly.Module): Promise<void> {
+    if (!this.persistenceEnabled) return;
+    try {
+      await storageManager.saveCompiledModule({ key, module, createdAt: Date.now() });
+    } catch (error) {
+      // Most browsers no longer allow WebAssembly.Module in IndexedDB;
+      // the in-memory cache still applies
+      this.persistenceEnabled = false;
+      console.log('[WasmModuleCache] Module persistence unavailable:', error instanceof Error ? error.name : error);
+    }
+  }
+}
+
+// Export singleton instance
+export const wasmModuleCache = new WasmModuleCache();
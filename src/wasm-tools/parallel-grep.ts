@@ -0,0 +1,357 @@
+/**
+ * Parallel grep over project files
+ *
+ * grep's `paths` argument can name thousands of files (whole directories
+ * with `recursive`). Instead of one Worker searching them one after the
+ * other, the files are split into shards run by up to one Worker per core
+ * (MAX_PARALLEL_WORKERS):
+ *
+ * - runs of consecutive files are grouped into shards of similar size and
+ *   pre-loaded into the shard's VFS (`--paths`)
+ * - a large file is split into line-aligned chunks, each searched by its
+ *   own Worker on stdin with `--label` and `--lineOffset`, so its output
+ *   lines read as if grep had searched the whole file
+ *
+ * Shards start in file order and their outputs are concatenated in that
+ * order, so the result does not depend on which Worker finishes first.
+ * The chunks of a file are merged back into one file's output: counts
+ * (-c) are summed, -l reports the file once, and --maxCount holds across
+ * chunks. As soon as the chunks merged so far settle the file (the limit
+ * is reached, or -l has a match), its remaining chunks are cancelled or
+ * never started.
+ */
+
+import { MAX_PARALLEL_WORKERS, wasmWorkerManager } from './worker-manager';
+import type { ExecutionResult } from './types';
+
+/**
+ * Files larger than this are split into chunks searched in parallel.
+ */
+export const LARGE_FILE_BYTES = 4 << 20;
+
+/**
+ * Smallest chunk of a large file given to one Worker.
+ */
+export const MIN_CHUNK_BYTES = 1 << 20;
+
+/**
+ * Smallest shard of whole files; smaller searches are not worth the
+ * start-up cost of another Worker.
+ */
+export const MIN_SHARD_BYTES = 256 << 10;
+
+/**
+ * A file to search. Files without data could not be read; they are still
+ * passed to grep, which reports them.
+ */
+export interface SearchFile {
+  path: string;
+  data?: ArrayBuffer;
+}
+
+export type SearchShard =
+  | { kind: 'files'; files: SearchFile[] }
+  | { kind: 'chunk'; path: string; data: Uint8Array; lineOffset: number };
+
+/**
+ * The grep options that change how shard outputs are merged.
+ */
+export interface SearchOutput {
+  count: boolean;
+  filesWithMatches: boolean;
+  onlyMatching: boolean;
+  lineNumbers: boolean;
+  maxCount?: number;
+  /** Prefix lines and counts with the file name (several files, or recursive) */
+  withFilename: boolean;
+}
+
+export interface ParallelSearch {
+  /** Compiled module (preferred) or binary; binaries are copied per shard */
+  wasm: WebAssembly.Module | ArrayBuffer;
+  /** grep's argv, without paths or any per-shard options */
+  args: string[];
+  /** Files every shard needs, such as the pattern file */
+  sharedFiles: Record<string, ArrayBuffer>;
+  timeout: number;
+  memoryPages?: number;
+  output: SearchOutput;
+  /** Workers to run at once (default MAX_PARALLEL_WORKERS) */
+  workers?: number;
+}
+
+/**
+ * Resolve `paths` to the files to search, in order and without duplicates.
+ * With `recursive`, a directory (or '.' or '' for the project root) stands
+ * for every file beneath it, sorted by path. Other paths are kept as they
+ * are, so grep can report the ones that don't name a file.
+ */
+export function expandSearchPaths(
+  paths: string[],
+  recursive: boolean,
+  entries: ReadonlyArray<{ path: string; kind: 'file' | 'directory' }>
+): string[] {
+  const files = new Set<string>();
+  let sortedFiles: string[] | null = null;
+
+  for (const raw of paths) {
+    const path = raw.trim().replace(/^\/+|\/+$/g, '').replace(/^\.(\/|$)/, '');
+    const isRoot = path === '';
+    const isDirectory = isRoot || entries.some((e) => e.kind === 'directory' && e.path === path);
+    if (!recursive || !isDirectory) {
+      files.add(isRoot ? raw.trim() : path);
+      continue;
+    }
+
+    sortedFiles ??= entries.filter((e) => e.kind === 'file').map((e) => e.path).sort();
+    const prefix = isRoot ? '' : `${path}/`;
+    for (const file of sortedFiles) {
+      if (file.startsWith(prefix)) files.add(file);
+    }
+  }
+  return [...files];
+}
+
+/** Newlines in bytes[start, end) */
+function countLines(bytes: Uint8Array, start: number, end: number): number {
+  let lines = 0;
+  for (let i = start; i < end; i++) {
+    if (bytes[i] === 10) lines++;
+  }
+  return lines;
+}
+
+/**
+ * Split files into shards, in file order. Consecutive files are grouped
+ * until a shard holds its share of the total size; a file larger than
+ * LARGE_FILE_BYTES gets up to one line-aligned chunk per Worker, unless
+ * `chunkFiles` is false. Chunk line offsets are only counted when
+ * `lineNumbers` needs them.
+ */
+export function planSearchShards(
+  files: SearchFile[],
+  workers: number,
+  { chunkFiles = true, lineNumbers = false }: { chunkFiles?: boolean; lineNumbers?: boolean } = {}
+): SearchShard[] {
+  const size = (file: SearchFile) => file.data?.byteLength ?? 0;
+  const chunked = (file: SearchFile) => chunkFiles && workers > 1 && size(file) > LARGE_FILE_BYTES;
+
+  const groupedBytes = files.reduce((sum, file) => sum + (chunked(file) ? 0 : size(file)), 0);
+  const target = Math.max(groupedBytes / workers, MIN_SHARD_BYTES);
+
+  const shards: SearchShard[] = [];
+  let group: SearchFile[] = [];
+  let groupBytes = 0;
+  const flush = () => {
+    if (group.length > 0) shards.push({ kind: 'files', files: group });
+    group = [];
+    groupBytes = 0;
+  };
+
+  for (const file of files) {
+    if (!chunked(file)) {
+      group.push(file);
+      groupBytes += size(file);
+      if (groupBytes >= target) flush();
+      continue;
+    }
+
+    flush();
+    const bytes = new Uint8Array(file.data!);
+    const count = Math.min(workers, Math.ceil(bytes.length / MIN_CHUNK_BYTES));
+    let start = 0;
+    let lineOffset = 0;
+    for (let i = 1; i <= count && start < bytes.length; i++) {
+      // End each chunk after the first newline past its share
+      let end = i === count ? bytes.length : bytes.indexOf(10, Math.floor((bytes.length * i) / count)) + 1;
+      if (end <= start) end = bytes.length;
+      shards.push({ kind: 'chunk', path: file.path, data: bytes.subarray(start, end), lineOffset });
+      if (lineNumbers) lineOffset += countLines(bytes, start, end);
+      start = end;
+    }
+  }
+  flush();
+  return shards;
+}
+
+/** Output lines of a chunk, without the final newline's empty entry */
+function outputLines(stdout: string): string[] {
+  return stdout ? stdout.replace(/\n$/, '').split('\n') : [];
+}
+
+type ShardOutcome = ExecutionResult | { error: string } | { skipped: true };
+
+/**
+ * How far the completed chunks of one file settle its output. Chunks are
+ * taken in order up to the first one still running.
+ */
+function settledChunks(
+  outcomes: Array<ShardOutcome | undefined>,
+  output: SearchOutput
+): { matched: number; settled: boolean } {
+  let matched = 0;
+  for (const outcome of outcomes) {
+    if (!outcome || !('exitCode' in outcome)) break;
+    matched += output.count ? parseInt(outcome.stdout, 10) || 0 : outputLines(outcome.stdout).length;
+    if (output.filesWithMatches && matched > 0) return { matched, settled: true };
+    if (output.maxCount !== undefined && matched >= output.maxCount) return { matched, settled: true };
+  }
+  return { matched, settled: false };
+}
+
+/**
+ * Merge the chunks of one file into the output grep would have given for
+ * the whole file.
+ */
+function mergeChunks(path: string, outcomes: ShardOutcome[], output: SearchOutput): { stdout: string; matched: boolean } {
+  const limit = output.maxCount ?? Infinity;
+  const results = outcomes.filter((o): o is ExecutionResult => 'exitCode' in o);
+
+  if (output.filesWithMatches) {
+    const matched = results.some((r) => r.stdout.length > 0);
+    return { stdout: matched ? `${path}\n` : '', matched };
+  }
+
+  if (output.count) {
+    const total = Math.min(results.reduce((sum, r) => sum + (parseInt(r.stdout, 10) || 0), 0), limit);
+    return { stdout: `${output.withFilename ? `${path}:` : ''}${total}\n`, matched: total > 0 };
+  }
+
+  let stdout = '';
+  let remaining = limit;
+  for (const result of results) {
+    if (remaining <= 0) break;
+    const lines = outputLines(result.stdout);
+    const kept = lines.length <= remaining ? lines : lines.slice(0, remaining);
+    if (kept.length > 0) stdout += `${kept.join('\n')}\n`;
+    remaining -= kept.length;
+  }
+  return { stdout, matched: stdout.length > 0 };
+}
+
+/** argv for one shard */
+function shardArgs(search: ParallelSearch, shard: SearchShard): string[] {
+  const { output } = search;
+  if (shard.kind === 'files') {
+    return [
+      ...search.args,
+      ...(output.withFilename ? ['--withFilename'] : []),
+      ...shard.files.flatMap((file) => ['--paths', file.path]),
+    ];
+  }
+  // Chunk counts are merged here, where the file name is added
+  return [
+    ...search.args,
+    '--label', shard.path,
+    ...(output.withFilename && !output.count ? ['--withFilename'] : []),
+    ...(shard.lineOffset > 0 ? ['--lineOffset', String(shard.lineOffset)] : []),
+  ];
+}
+
+/**
+ * Search the files with grep in parallel Workers. The result is what a
+ * single grep over all of them would return.
+ */
+export async function runParallelSearch(search: ParallelSearch, files: SearchFile[]): Promise<ExecutionResult> {
+  const { output } = search;
+  const workers = Math.max(1, search.workers ?? MAX_PARALLEL_WORKERS);
+  // -o lines can't be told apart per matching line, so --maxCount can't be merged across chunks
+  const shards = planSearchShards(files, workers, {
+    chunkFiles: !(output.onlyMatching && output.maxCount !== undefined),
+    lineNumbers: output.lineNumbers,
+  });
+
+  // One controller per chunked file, aborted once its output is settled
+  const controllers = new Map<string, AbortController>();
+  const chunksOf = new Map<string, number[]>();
+  shards.forEach((shard, index) => {
+    if (shard.kind !== 'chunk') return;
+    if (!chunksOf.has(shard.path)) {
+      chunksOf.set(shard.path, []);
+      controllers.set(shard.path, new AbortController());
+    }
+    chunksOf.get(shard.path)!.push(index);
+  });
+
+  const outcomes: Array<ShardOutcome | undefined> = new Array(shards.length);
+
+  const runShard = async (index: number): Promise<ShardOutcome> => {
+    const shard = shards[index]!;
+    const signal = shard.kind === 'chunk' ? controllers.get(shard.path)!.signal : undefined;
+    if (signal?.aborted) return { skipped: true };
+
+    const filesBinary: Record<string, ArrayBuffer> = {};
+    for (const [path, data] of Object.entries(search.sharedFiles)) {
+      filesBinary[path] = data.slice(0);
+    }
+    if (shard.kind === 'files') {
+      // Each file belongs to one shard, so its buffer can be transferred
+      for (const file of shard.files) {
+        if (file.data) filesBinary[file.path] = file.data;
+      }
+    }
+
+    try {
+      return await wasmWorkerManager.execute(
+        search.wasm instanceof WebAssembly.Module ? search.wasm : search.wasm.slice(0),
+        shardArgs(search, shard),
+        {
+          timeout: search.timeout,
+          memoryPages: search.memoryPages,
+          filesBinary,
+          ...(shard.kind === 'chunk' && { stdinBinary: shard.data.slice().buffer as ArrayBuffer }),
+          signal,
+        }
+      );
+    } catch (error) {
+      if (signal?.aborted) return { skipped: true };
+      return { error: error instanceof Error ? error.message : String(error) };
+    }
+  };
+
+  // Start shards in order, at most `workers` at a time
+  let next = 0;
+  const runNext = async (): Promise<void> => {
+    while (next < shards.length) {
+      const index = next++;
+      outcomes[index] = await runShard(index);
+      const shard = shards[index]!;
+      if (shard.kind === 'chunk') {
+        const chunkOutcomes = chunksOf.get(shard.path)!.map((i) => outcomes[i]);
+        if (settledChunks(chunkOutcomes, output).settled) controllers.get(shard.path)!.abort();
+      }
+    }
+  };
+  await Promise.all(Array.from({ length: Math.min(workers, shards.length) }, runNext));
+
+  // Concatenate in file order
+  let stdout = '';
+  let stderr = '';
+  let matched = false;
+  let failed = false;
+  for (let index = 0; index < shards.length; index++) {
+    const shard = shards[index]!;
+    const outcome = outcomes[index]!;
+
+    if ('error' in outcome) {
+      stderr += `grep: ${outcome.error}\n`;
+      failed = true;
+    } else if ('exitCode' in outcome) {
+      stderr += outcome.stderr;
+      if (outcome.exitCode === 0) matched = true;
+      else if (outcome.exitCode !== 1) failed = true;
+    }
+
+    if (shard.kind === 'files') {
+      if ('exitCode' in outcome) stdout += outcome.stdout;
+      continue;
+    }
+    // A file's chunks are merged at its first chunk
+    const indices = chunksOf.get(shard.path)!;
+    if (indices[0] !== index) continue;
+    const merged = mergeChunks(shard.path, indices.map((i) => outcomes[i]!), output);
+    stdout += merged.stdout;
+  }
+
+  return { exitCode: failed ? 2 : matched ? 0 : 1, stdout, stderr };
+}
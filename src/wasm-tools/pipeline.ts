@@ -0,0 +1,129 @@
+/**
+ * Streaming WASM Pipeline
+ *
+ * Runs a chain like `grep | sort | uniq -c | head` with every stage in its
+ * own Worker, all started together. Adjacent stages are connected by a
+ * bounded ByteChannel, so:
+ * - a stage starts consuming while the one before it is still producing
+ * - a fast producer blocks once the channel is full (backpressure), which
+ *   keeps memory per link bounded by the channel capacity
+ * - a stage that exits early (e.g. `head -n 10`) cancels its input
+ *   channel, and the stage before it ends with EXIT_BROKEN_PIPE the next
+ *   time it writes, and so on upstream
+ *
+ * Bytes never pass through JS strings between stages; only the last
+ * stage's output is decoded.
+ *
+ * Requires cross-origin isolation for SharedArrayBuffer (see
+ * isByteChannelSupported()), which the app gets from the COOP/COEP headers
+ * in server/isolation.ts; callers fall back to running stages one at a
+ * time otherwise.
+ */
+
+import { ByteChannel, DEFAULT_CHANNEL_CAPACITY } from './byte-channel';
+import { wasmWorkerManager } from './worker-manager';
+import { EXIT_BROKEN_PIPE } from './worker-types';
+import type { ExecutionResult } from './types';
+
+/**
+ * A stage ready to run: the module and its argv.
+ */
+export interface PreparedStage {
+  /** Tool name, for error messages */
+  name: string;
+  /** Compiled module (preferred) or binary; binaries are transferred */
+  wasm: ArrayBuffer | WebAssembly.Module;
+  args: string[];
+  timeout: number;
+  memoryPages?: number;
+}
+
+export interface PipelineResult {
+  /** Whether every stage succeeded (broken pipes upstream of an early exit count as success) */
+  success: boolean;
+  /** The last stage's output */
+  stdout: string;
+  stdoutBinary?: Uint8Array;
+  /** Per-stage results; stdout is empty for all but the last stage */
+  stages: Array<ExecutionResult | { error: string }>;
+  /** Index of the first stage that failed */
+  failedStage?: number;
+}
+
+/**
+ * Run the stages concurrently. `stdin` feeds the first stage.
+ */
+export async function runStreamingPipeline(
+  stages: PreparedStage[],
+  stdin?: string | Uint8Array,
+  channelCapacity: number = DEFAULT_CHANNEL_CAPACITY
+): Promise<PipelineResult> {
+  if (stages.length === 0) {
+    return { success: true, stdout: '', stages: [] };
+  }
+
+  // links[i] carries stage i's stdout to stage i + 1's stdin
+  const links: ByteChannel[] = [];
+  for (let i = 0; i < stages.length - 1; i++) {
+    links.push(new ByteChannel(channelCapacity));
+  }
+
+  // Upstream stages are usually still starting when the first one runs;
+  // have Workers ready for them
+  wasmWorkerManager.prewarm(stages.length);
+
+  const executions = stages.map((stage, i) => {
+    const first = i === 0;
+    return wasmWorkerManager.execute(stage.wasm, stage.args, {
+      timeout: stage.timeout,
+      memoryPages: stage.memoryPages,
+      ...(first && typeof stdin === 'string' && { stdin }),
+      ...(first && stdin instanceof Uint8Array && { stdinBinary: copyToBuffer(stdin) }),
+      ...(!first && { stdinChannel: links[i - 1] }),
+      ...(i < links.length && { stdoutChannel: links[i] }),
+    });
+  });
+
+  const settled = await Promise.allSettled(executions);
+  const results: PipelineResult['stages'] = settled.map((outcome) =>
+    outcome.status === 'fulfilled'
+      ? outcome.value
+      : { error: outcome.reason instanceof Error ? outcome.reason.message : String(outcome.reason) }
+  );
+
+  // Report the stage that actually failed, not the broken pipes it caused
+  const succeeded = results.map((result, i) => stageSucceeded(result, i, results));
+  const rootFailure = results.findIndex((result, i) =>
+    !succeeded[i] && ('error' in result || result.exitCode !== EXIT_BROKEN_PIPE));
+  const failedStage = rootFailure >= 0 ? rootFailure : succeeded.indexOf(false);
+  const last = results[results.length - 1]!;
+  const lastOutput = 'error' in last ? null : last;
+
+  return {
+    success: failedStage < 0,
+    stdout: lastOutput?.stdout ?? '',
+    ...(lastOutput?.stdoutBinary && { stdoutBinary: lastOutput.stdoutBinary }),
+    stages: results,
+    ...(failedStage >= 0 && { failedStage }),
+  };
+}
+
+/**
+ * A stage succeeded if it exited 0, or if it was stopped by a broken pipe
+ * because every stage after it (up to one that exited normally) stopped
+ * reading — the shell's behaviour for `yes | head`.
+ */
+function stageSucceeded(
+  result: ExecutionResult | { error: string },
+  index: number,
+  results: PipelineResult['stages']
+): boolean {
+  if ('error' in result) return false;
+  if (result.exitCode === 0) return true;
+  if (result.exitCode !== EXIT_BROKEN_PIPE || index === results.length - 1) return false;
+  return stageSucceeded(results[index + 1]!, index + 1, results);
+}
+
+function copyToBuffer(bytes: Uint8Array): ArrayBuffer {
+  return bytes.buffer.slice(bytes.byteOffset, bytes.byteOffset + bytes.byteLength) as ArrayBuffer;
+}
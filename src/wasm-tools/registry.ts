@@ -6,7 +6,7 @@
  * wasm-tools/ directory.
  */
 
-import type { BuiltinToolConfig, WasmToolManifest } from './types';
+import type { BuildProfile, BuiltinToolConfig, MulticallBundle, WasmToolManifest } from './types';
 
 /**
  * Helper to create a manifest with common defaults.
@@ -22,6 +22,9 @@ function createManifest(
     timeout?: number;
     pipeable?: boolean;
     stdinParam?: string;
+    fileParams?: string[];
+    buildProfile?: BuildProfile;
+    deterministic?: boolean;
   }
 ): WasmToolManifest {
   return {
@@ -38,6 +41,9 @@ function createManifest(
       fileAccess: options.fileAccess ?? 'none',
       timeout: options.timeout ?? 30000,
       stdinParam: options.stdinParam,
+      fileParams: options.fileParams,
+      buildProfile: options.buildProfile,
+      deterministic: options.deterministic,
     },
     pipeable: options.pipeable,
     category: options.category,
@@ -46,6 +52,16 @@ function createManifest(
   };
 }
 
+/**
+ * Every tool built from wasm-tools/src/ linked into one module
+ * (build.sh, src/multicall/main.c), dispatched on argv[0].
+ */
+const MULTICALL_BUNDLE: MulticallBundle = {
+  id: 'multicall',
+  wasmUrl: 'wasm-tools/binaries/multicall.wasm',
+  simdWasmUrl: 'wasm-tools/binaries/multicall.simd.wasm',
+};
+
 /**
  * Built-in tools registry.
  * All 39 tools organized by category.
@@ -58,6 +74,8 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'base64',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/base64.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/base64.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'base64',
       'Encode or decode data using Base64 encoding. Use "encode" to convert text to Base64, or "decode" to convert Base64 back to text.',
@@ -73,101 +91,222 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'The text to encode, or base64 string to decode',
           },
+          url: {
+            type: 'boolean',
+            description: 'Use the URL-safe alphabet (- and _ instead of + and /)',
+          },
+          strict: {
+            type: 'boolean',
+            description: 'When decoding, reject whitespace, missing padding and non-canonical input',
+          },
         },
         required: ['mode', 'input'],
       },
-      { category: 'crypto', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'crypto', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'md5sum',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/md5sum.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/md5sum.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'md5sum',
-      'Calculate MD5 hash of text. Note: MD5 is not cryptographically secure, use for checksums only.',
+      'Calculate MD5 checksums of text or project files, or verify a checksum list. Note: MD5 is not cryptographically secure, use for checksums only.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'Text to hash',
+            description: 'Text to hash, or with check the checksum list to verify',
+          },
+          files: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Project file paths to hash (or, with check, the files the list refers to)',
+          },
+          check: {
+            type: 'boolean',
+            description: 'Verify the checksum list given as input against the listed files',
+          },
+          records: {
+            type: 'boolean',
+            description: 'Treat input as NUL-delimited records and print one checksum per record, named by its number (1, 2, ...)',
+          },
+          tag: {
+            type: 'boolean',
+            description: 'Print BSD-style "MD5 (file) = hash" lines',
           },
         },
-        required: ['input'],
       },
-      { category: 'crypto', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      {
+        category: 'crypto',
+        argStyle: 'cli',
+        fileAccess: 'read',
+        pipeable: true,
+        stdinParam: 'input',
+        fileParams: ['files'],
+        buildProfile: 'speed',
+        deterministic: true,
+      }
     ),
   },
   {
     name: 'sha256sum',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/sha256sum.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/sha256sum.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'sha256sum',
-      'Calculate SHA-256 hash of text.',
+      'Calculate SHA-256 checksums of text or project files, or verify a checksum list. Many files (or NUL-delimited records) are hashed in one call, several at a time.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'Text to hash',
+            description: 'Text to hash, or with check the checksum list to verify',
+          },
+          files: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Project file paths to hash (or, with check, the files the list refers to)',
+          },
+          check: {
+            type: 'boolean',
+            description: 'Verify the checksum list given as input against the listed files',
+          },
+          records: {
+            type: 'boolean',
+            description: 'Treat input as NUL-delimited records and print one checksum per record, named by its number (1, 2, ...)',
+          },
+          tag: {
+            type: 'boolean',
+            description: 'Print BSD-style "SHA256 (file) = hash" lines',
           },
         },
-        required: ['input'],
       },
-      { category: 'crypto', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      {
+        category: 'crypto',
+        argStyle: 'cli',
+        fileAccess: 'read',
+        pipeable: true,
+        stdinParam: 'input',
+        fileParams: ['files'],
+        buildProfile: 'speed',
+        deterministic: true,
+      }
     ),
   },
   {
     name: 'sha512sum',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/sha512sum.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/sha512sum.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'sha512sum',
-      'Calculate SHA-512 hash of text.',
+      'Calculate SHA-512 checksums of text or project files, or verify a checksum list.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'Text to hash',
+            description: 'Text to hash, or with check the checksum list to verify',
+          },
+          files: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Project file paths to hash (or, with check, the files the list refers to)',
+          },
+          check: {
+            type: 'boolean',
+            description: 'Verify the checksum list given as input against the listed files',
+          },
+          records: {
+            type: 'boolean',
+            description: 'Treat input as NUL-delimited records and print one checksum per record, named by its number (1, 2, ...)',
+          },
+          tag: {
+            type: 'boolean',
+            description: 'Print BSD-style "SHA512 (file) = hash" lines',
           },
         },
-        required: ['input'],
       },
-      { category: 'crypto', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      {
+        category: 'crypto',
+        argStyle: 'cli',
+        fileAccess: 'read',
+        pipeable: true,
+        stdinParam: 'input',
+        fileParams: ['files'],
+        buildProfile: 'speed',
+        deterministic: true,
+      }
     ),
   },
   {
     name: 'xxd',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/xxd.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/xxd.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'xxd',
-      'Create a hex dump of text or reverse a hex dump back to text. The input text is sent via stdin.',
+      'Create a hex dump of text or a binary project file, or reverse a hex dump back to bytes. Use seek and length to dump just a byte range of a large file.',
       {
         type: 'object',
         properties: {
           mode: {
             type: 'string',
             enum: ['dump', 'reverse'],
-            description: 'Mode: "dump" for hex dump, "reverse" to convert hex back to text',
+            description: 'Mode: "dump" for hex dump, "reverse" to convert hex back to bytes',
           },
           input: {
             type: 'string',
             description: 'Text to convert to hex, or hex string to reverse',
           },
+          file: {
+            type: 'string',
+            description: 'Project file to read instead of input (binary-safe)',
+          },
+          seek: {
+            type: 'number',
+            description: 'Start at this byte offset; negative counts back from the end of file',
+          },
+          length: {
+            type: 'number',
+            description: 'Stop after this many bytes',
+          },
+          cols: {
+            type: 'number',
+            description: 'Bytes per line (default: 16, or 30 with plain)',
+          },
+          plain: {
+            type: 'boolean',
+            description: 'Plain hex output without offsets or the ASCII column',
+          },
         },
-        required: ['mode', 'input'],
+        required: ['mode'],
       },
-      { category: 'crypto', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      {
+        category: 'crypto',
+        argStyle: 'cli',
+        fileAccess: 'read',
+        pipeable: true,
+        stdinParam: 'input',
+        fileParams: ['file'],
+        buildProfile: 'speed',
+        deterministic: true,
+      }
     ),
   },
   {
     name: 'uuid',
     category: 'crypto',
     wasmUrl: 'wasm-tools/binaries/uuid.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'uuid',
       'Generate a random UUID v4.',
@@ -182,7 +321,7 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: [],
       },
-      { category: 'crypto', argStyle: 'positional' }
+      { category: 'crypto', argStyle: 'positional', buildProfile: 'size' }
     ),
   },
 
@@ -193,9 +332,11 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'wc',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/wc.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/wc.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'wc',
-      'Count lines, words, and characters in text.',
+      'Count lines, words, bytes, UTF-8 characters or the longest line length in text.',
       {
         type: 'object',
         properties: {
@@ -215,19 +356,31 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
           },
           chars: {
             type: 'boolean',
-            description: 'Count only characters (-c)',
+            description: 'Count bytes (-c)',
+            default: false,
+          },
+          characters: {
+            type: 'boolean',
+            description: 'Count UTF-8 characters (-m)',
+            default: false,
+          },
+          maxLineLength: {
+            type: 'boolean',
+            description: 'Print the length of the longest line (-L)',
             default: false,
           },
         },
         required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'head',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/head.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/head.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'head',
       'Output the first N lines of text (default: 10).',
@@ -246,13 +399,15 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'tail',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/tail.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/tail.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'tail',
       'Output the last N lines of text (default: 10).',
@@ -271,16 +426,18 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'cut',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/cut.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/cut.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'cut',
-      'Extract columns/fields from text using a delimiter.',
+      'Extract columns/fields from text using a delimiter, or byte and character ranges. Lists take N, N-M, N- and -M separated by commas.',
       {
         type: 'object',
         properties: {
@@ -295,21 +452,40 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
           },
           fields: {
             type: 'string',
-            description: 'Field numbers to extract (e.g., "1,3" or "1-3")',
+            description: 'Fields to extract (e.g., "1,3", "1-3" or "1,3-5,8-")',
+          },
+          bytes: {
+            type: 'string',
+            description: 'Byte ranges to extract instead of fields (e.g., "1-10")',
+          },
+          characters: {
+            type: 'string',
+            description: 'UTF-8 character ranges to extract instead of fields',
+          },
+          outputDelimiter: {
+            type: 'string',
+            description: 'String placed between the selected fields or ranges',
+          },
+          onlyDelimited: {
+            type: 'boolean',
+            description: 'Skip lines that contain no delimiter (-s)',
+            default: false,
           },
         },
-        required: ['input', 'fields'],
+        required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'sort',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/sort.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/sort.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'sort',
-      'Sort lines of text alphabetically or numerically.',
+      'Sort lines of text alphabetically or numerically, optionally by key fields. Large inputs are sorted in runs and merged, so there is no line limit.',
       {
         type: 'object',
         properties: {
@@ -332,25 +508,35 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             description: 'Output only unique lines (-u)',
             default: false,
           },
+          key: {
+            type: 'string',
+            description: 'Sort key as POS1[,POS2] with fields numbered from 1, e.g. "2,2n" (-k)',
+          },
+          fieldSeparator: {
+            type: 'string',
+            description: 'Single-character field separator for keys (-t)',
+          },
         },
         required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'pgo', deterministic: true }
     ),
   },
   {
     name: 'uniq',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/uniq.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/uniq.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'uniq',
-      'Report or filter out repeated adjacent lines.',
+      'Report or filter out repeated adjacent lines. With global or top, counts duplicates anywhere in one pass, no sort needed.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'Text to process (should be sorted first)',
+            description: 'Text to process (should be sorted first unless global or top is set)',
           },
           count: {
             type: 'boolean',
@@ -367,19 +553,30 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             description: 'Only print unique lines (-u)',
             default: false,
           },
+          global: {
+            type: 'boolean',
+            description: 'Collapse duplicates anywhere in the input, not just adjacent ones, in first-seen order',
+            default: false,
+          },
+          top: {
+            type: 'number',
+            description: 'Print only the N most frequent lines with counts, most frequent first (implies global and count); replaces sort | uniq -c | sort -rn | head -N',
+          },
         },
         required: ['input'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'tr',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/tr.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/tr.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'tr',
-      'Translate or delete characters in text.',
+      'Translate, delete or squeeze characters in text. Sets take ranges (a-z), classes ([:upper:], [:digit:], [:space:], ...) and escapes (\\n, \\t).',
       {
         type: 'object',
         properties: {
@@ -389,35 +586,85 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
           },
           set1: {
             type: 'string',
-            description: 'Characters to translate from',
+            description: 'Characters to translate from, delete or squeeze',
           },
           set2: {
             type: 'string',
-            description: 'Characters to translate to (omit to delete set1 chars)',
+            description: 'Characters to translate to (padded with its last character)',
+          },
+          delete: {
+            type: 'boolean',
+            description: 'Delete characters in set1 instead of translating (-d)',
+            default: false,
+          },
+          squeeze: {
+            type: 'boolean',
+            description: 'Collapse runs of a character from the last set given into one (-s)',
+            default: false,
+          },
+          complement: {
+            type: 'boolean',
+            description: 'Use every character not in set1 (-c)',
+            default: false,
           },
         },
         required: ['input', 'set1'],
       },
-      { category: 'text', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'grep',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/grep.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/grep.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'grep',
-      'Search for patterns in text (simple substring matching).',
+      'Search for patterns in text. Matches plain substrings by default, or POSIX extended regular expressions with extended. Any number of patterns (patterns, patternFile) are searched for in a single pass. Searches project files with paths (directories with recursive), split across parallel workers.',
       {
         type: 'object',
         properties: {
           pattern: {
             type: 'string',
-            description: 'Pattern to search for',
+            description: 'Pattern to search for (may be omitted when patterns or patternFile is given)',
+          },
+          patterns: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Further patterns; a line matches if any pattern matches (-e)',
+          },
+          patternFile: {
+            type: 'string',
+            description: 'File with one pattern per line (-f)',
+          },
+          extended: {
+            type: 'boolean',
+            description: 'Treat patterns as POSIX extended regular expressions (-E)',
+            default: false,
+          },
+          fixed: {
+            type: 'boolean',
+            description: 'Treat patterns as fixed strings (-F, the default unless extended)',
+            default: false,
           },
           input: {
             type: 'string',
-            description: 'Text to search',
+            description: 'Text to search (when no paths are given)',
+          },
+          paths: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Project files to search; lines are prefixed with the file name when there are several',
+          },
+          recursive: {
+            type: 'boolean',
+            description: 'Search every file under directories in paths, "." for the whole project (-r)',
+            default: false,
+          },
+          maxCount: {
+            type: 'number',
+            description: 'Stop after this many matching lines per file (-m)',
           },
           ignoreCase: {
             type: 'boolean',
@@ -439,19 +686,45 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             description: 'Only count matching lines (-c)',
             default: false,
           },
+          onlyMatching: {
+            type: 'boolean',
+            description: 'Print only the matching parts of lines, one per line (-o)',
+            default: false,
+          },
+          wordRegexp: {
+            type: 'boolean',
+            description: 'Only match whole words (-w)',
+            default: false,
+          },
+          filesWithMatches: {
+            type: 'boolean',
+            description: 'Only list the files (or input) that match (-l)',
+            default: false,
+          },
         },
-        required: ['pattern', 'input'],
+        required: [],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      {
+        category: 'text',
+        argStyle: 'cli',
+        fileAccess: 'read',
+        pipeable: true,
+        stdinParam: 'input',
+        fileParams: ['patternFile', 'paths'],
+        buildProfile: 'pgo',
+        deterministic: true,
+      }
     ),
   },
   {
     name: 'sed',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/sed.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/sed.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'sed',
-      'Stream editor for text transformation. Supports s/pattern/replacement/[g] syntax.',
+      'Stream editor for text transformation. Supports s/pattern/replacement/[g][i][N] with POSIX basic regular expressions; the replacement may use & and \\1-\\9.',
       {
         type: 'object',
         properties: {
@@ -466,22 +739,24 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['expression', 'input'],
       },
-      { category: 'text', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'positional', pipeable: true, stdinParam: 'input', buildProfile: 'pgo', deterministic: true }
     ),
   },
   {
     name: 'awk',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/awk.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/awk.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'awk',
-      'Pattern scanning and processing. Simplified awk supporting basic field extraction and printing.',
+      'Pattern scanning and processing. Supports variables, arithmetic, associative arrays, user functions, printf and the standard string built-ins.',
       {
         type: 'object',
         properties: {
           program: {
             type: 'string',
-            description: 'awk program (e.g., "{print $1}" or "/pattern/{print $2}")',
+            description: 'awk program (e.g., "{print $1}" or "/regex/{print $2}")',
           },
           input: {
             type: 'string',
@@ -491,19 +766,26 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'Field separator (-F)',
           },
+          assign: {
+            type: 'array',
+            items: { type: 'string' },
+            description: 'Variable assignments (name=value) made before BEGIN, like -v',
+          },
         },
-        required: ['program', 'input'],
+        required: ['program'],
       },
-      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input' }
+      { category: 'text', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'pgo' }
     ),
   },
   {
     name: 'diff',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/diff.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/diff.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'diff',
-      'Compare two texts and show differences.',
+      'Compare two texts and show differences as a unified diff. Handles large inputs (linear-space Myers diff).',
       {
         type: 'object',
         properties: {
@@ -520,19 +802,26 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             description: 'Output unified diff format (-u)',
             default: true,
           },
+          algorithm: {
+            type: 'string',
+            enum: ['myers', 'minimal', 'patience', 'histogram'],
+            description: 'Diff algorithm: myers (default, fast), minimal (smallest diff), patience or histogram (anchor on unique/rare lines; often more readable for code)',
+          },
         },
         required: ['text1', 'text2'],
       },
-      { category: 'text', argStyle: 'positional' }
+      { category: 'text', argStyle: 'positional', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'patch',
     category: 'text',
     wasmUrl: 'wasm-tools/binaries/patch.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/patch.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'patch',
-      'Apply a diff/patch to text.',
+      'Apply a unified diff/patch to text. Hunks are located even if the text has shifted, with optional fuzz for changed context.',
       {
         type: 'object',
         properties: {
@@ -544,10 +833,14 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'Patch/diff to apply',
           },
+          fuzz: {
+            type: 'number',
+            description: 'Maximum number of context lines to ignore at each end of a hunk that does not match exactly (-F, default: 2)',
+          },
         },
         required: ['original', 'patch'],
       },
-      { category: 'text', argStyle: 'positional' }
+      { category: 'text', argStyle: 'positional', buildProfile: 'speed', deterministic: true }
     ),
   },
 
@@ -558,9 +851,11 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'toml2json',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/toml2json.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/toml2json.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'toml2json',
-      'Convert TOML to JSON format.',
+      'Convert TOML 1.0 to JSON: nested and dotted tables, arrays of tables, inline tables, arrays, all string forms, typed numbers and dates. Keys are hash-indexed, so large lock files (Cargo.lock, poetry.lock) convert in linear time; redefinitions are reported with their line.',
       {
         type: 'object',
         properties: {
@@ -571,23 +866,26 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'csvtool',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/csvtool.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/csvtool.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'csvtool',
-      'Process CSV data: convert to JSON, extract columns, or filter rows.',
+      'Process CSV data (RFC 4180: quoted fields may contain commas, quotes and newlines). Select columns, filter rows, take the first/last rows, count rows or columns, convert to JSON, or aggregate: per-column stats, group-by with count/sum/mean/min/max, and distinct values. Filters and column selection combine with every command.',
       {
         type: 'object',
         properties: {
           command: {
             type: 'string',
-            enum: ['tojson', 'cols', 'head'],
-            description: 'Command: tojson (to JSON), cols (extract columns), head (first N rows)',
+            enum: ['cat', 'select', 'filter', 'head', 'tail', 'count', 'width', 'tojson', 'stats', 'groupby', 'distinct'],
+            description:
+              'Command: cat (rewrite as CSV), select (keep columns), filter (keep matching rows), head/tail (first/last N rows), count (rows), width (columns), tojson (array of objects keyed by the header row), stats (rows, empty, numeric, min, max, sum, mean per column), groupby (one row per distinct "by" key with its aggregates), distinct (first row of each distinct "columns" value)',
           },
           input: {
             type: 'string',
@@ -595,25 +893,51 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
           },
           columns: {
             type: 'string',
-            description: 'Column numbers for "cols" command (e.g., "1,3")',
+            description: 'Columns to keep: 1-based numbers, ranges or header names (e.g., "1,3", "2-4", "name,email")',
+          },
+          where: {
+            type: 'array',
+            items: { type: 'string' },
+            description:
+              'Row conditions that must all hold, as COLUMN OP VALUE with OP one of = != ~ !~ (regex) < <= > >= (numeric when both sides are numbers), e.g. "age>30"',
+          },
+          header: {
+            type: 'boolean',
+            description: 'Treat the first row as a header (kept in the output, not counted; implied by column names)',
+          },
+          delimiter: {
+            type: 'string',
+            description: 'Field delimiter (default ","; use "tab" for TSV)',
           },
           count: {
             type: 'number',
-            description: 'Number of rows for "head" command',
+            description: 'Number of rows for "head" and "tail" (default 10)',
+          },
+          by: {
+            type: 'string',
+            description: 'Grouping columns for "groupby" (e.g., "dept" or "2,3")',
+          },
+          agg: {
+            type: 'array',
+            items: { type: 'string' },
+            description:
+              'Aggregates for "groupby": "count" (rows), or sum/mean/min/max/count of a column as FUNC:COLUMN, e.g. "sum:amount" (default: count)',
           },
         },
         required: ['command', 'input'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'data', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'markdown',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/markdown.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/markdown.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'markdown',
-      'Convert Markdown to HTML.',
+      'Convert CommonMark Markdown (with GFM tables and strikethrough) to HTML. Raw HTML and script links are omitted unless unsafe is set.',
       {
         type: 'object',
         properties: {
@@ -621,16 +945,23 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'Markdown text to convert',
           },
+          unsafe: {
+            type: 'boolean',
+            description: 'Pass raw HTML and javascript:/data: links through (--unsafe)',
+            default: false,
+          },
         },
         required: ['input'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'data', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'jwt',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/jwt.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/jwt.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'jwt',
       'Decode and inspect JWT tokens (does not verify signatures).',
@@ -644,16 +975,18 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['token'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'token' }
+      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'token', buildProfile: 'size', deterministic: true }
     ),
   },
   {
     name: 'xmllint',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/xmllint.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/xmllint.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'xmllint',
-      'Validate and format XML documents.',
+      'Check that XML is well-formed (errors report the line), pretty-print it, or query it with a streaming XPath subset: /a/b, //b, *, [@attr], [@attr=\'v\'], and a trailing /@attr or /text(). Queries and --noout checks stream, so large feeds (sitemaps, JUnit reports) do not need to fit in memory as a tree.',
       {
         type: 'object',
         properties: {
@@ -661,6 +994,14 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'XML text to validate/format',
           },
+          xpath: {
+            type: 'string',
+            description: 'XPath expression to evaluate (e.g., "//testcase[@status=\'failed\']/@name")',
+          },
+          noout: {
+            type: 'boolean',
+            description: 'Only check well-formedness; print nothing on success',
+          },
           format: {
             type: 'boolean',
             description: 'Pretty-print the XML',
@@ -669,31 +1010,47 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'data', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'yq',
     category: 'data',
     wasmUrl: 'wasm-tools/binaries/yq.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/yq.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'yq',
-      'Query and transform YAML data using jq-like syntax.',
+      'Query YAML with jq-like paths (.a.b[3], .items[].name, ."key"). The input is parsed as a stream of events and the path is matched while parsing, so non-matching parts of large manifests or OpenAPI specs are skipped without building a tree. Supports multiple documents, anchors/aliases, flow and block styles; output is YAML or JSON.',
       {
         type: 'object',
         properties: {
           expression: {
             type: 'string',
-            description: 'jq-like expression (e.g., ".key", ".array[]")',
+            description: 'jq-like path (e.g., ".key", ".spec.containers[0].image", ".items[].metadata.name")',
           },
           input: {
             type: 'string',
             description: 'YAML text to process',
           },
+          output: {
+            type: 'string',
+            enum: ['yaml', 'json'],
+            description: 'Output format',
+            default: 'yaml',
+          },
+          raw: {
+            type: 'boolean',
+            description: 'With JSON output, print top-level strings without quotes',
+          },
+          compact: {
+            type: 'boolean',
+            description: 'With JSON output, print each result on one line',
+          },
         },
         required: ['expression', 'input'],
       },
-      { category: 'data', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'data', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
 
@@ -704,6 +1061,7 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'file',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/file.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'file',
       'Determine file type from content using magic numbers.',
@@ -717,13 +1075,14 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['content'],
       },
-      { category: 'file', argStyle: 'positional' }
+      { category: 'file', argStyle: 'positional', buildProfile: 'size' }
     ),
   },
   {
     name: 'du',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/du.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'du',
       'Calculate and format file/data sizes.',
@@ -742,13 +1101,14 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['size'],
       },
-      { category: 'file', argStyle: 'cli' }
+      { category: 'file', argStyle: 'cli', buildProfile: 'size' }
     ),
   },
   {
     name: 'stat',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/stat.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'stat',
       'Display formatted file information.',
@@ -770,38 +1130,60 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['filename'],
       },
-      { category: 'file', argStyle: 'positional' }
+      { category: 'file', argStyle: 'positional', buildProfile: 'size' }
     ),
   },
   {
     name: 'tree',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/tree.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/tree.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'tree',
-      'Display directory structure as a tree.',
+      'Display a list of paths as a directory tree, optionally sorted, depth-limited or with aggregated sizes.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'JSON array of file paths to display as tree',
+            description: 'Newline-separated file paths (or a JSON array of paths); with du, each line is "size path"',
           },
           directoriesOnly: {
             type: 'boolean',
             description: 'Show only directories (-d)',
             default: false,
           },
+          level: {
+            type: 'number',
+            description: 'Maximum display depth (-L)',
+          },
+          sort: {
+            type: 'string',
+            enum: ['name', 'size'],
+            description: 'Sort entries by name, or by size (needs du); default keeps input order',
+          },
+          du: {
+            type: 'boolean',
+            description: 'Input lines start with a size; show sizes with directories totalled (--du)',
+            default: false,
+          },
+          human: {
+            type: 'boolean',
+            description: 'Human-readable sizes (-h)',
+            default: false,
+          },
         },
         required: ['input'],
       },
-      { category: 'file', argStyle: 'positional' }
+      { category: 'file', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'size' }
     ),
   },
   {
     name: 'touch',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/touch.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'touch',
       'Generate a touch command to create/update file timestamps.',
@@ -815,13 +1197,14 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['filename'],
       },
-      { category: 'file', argStyle: 'positional', fileAccess: 'write' }
+      { category: 'file', argStyle: 'positional', fileAccess: 'write', buildProfile: 'size' }
     ),
   },
   {
     name: 'truncate',
     category: 'file',
     wasmUrl: 'wasm-tools/binaries/truncate.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'truncate',
       'Truncate or extend text to a specific length.',
@@ -839,7 +1222,7 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input', 'size'],
       },
-      { category: 'file', argStyle: 'positional' }
+      { category: 'file', argStyle: 'positional', buildProfile: 'size' }
     ),
   },
 
@@ -850,6 +1233,7 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'shfmt',
     category: 'code',
     wasmUrl: 'wasm-tools/binaries/shfmt.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'shfmt',
       'Format shell scripts.',
@@ -868,36 +1252,44 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input', buildProfile: 'size', deterministic: true }
     ),
   },
   {
     name: 'minify',
     category: 'code',
     wasmUrl: 'wasm-tools/binaries/minify.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'minify',
-      'Minify JavaScript code by removing whitespace and comments.',
+      'Minify JavaScript, CSS or HTML by removing whitespace and comments.',
       {
         type: 'object',
         properties: {
           input: {
             type: 'string',
-            description: 'JavaScript code to minify',
+            description: 'Code to minify',
+          },
+          type: {
+            type: 'string',
+            enum: ['js', 'css', 'html'],
+            description: 'Language of the input',
+            default: 'js',
           },
         },
         required: ['input'],
       },
-      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'code', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'terser',
     category: 'code',
     wasmUrl: 'wasm-tools/binaries/terser.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'terser',
-      'Minify JavaScript code (simplified terser-like minification).',
+      'Minify JavaScript code. With compress or mangle the code is parsed: compress folds constants, drops unreachable code and rewrites statements into shorter expressions; mangle renames local variables to short names.',
       {
         type: 'object',
         properties: {
@@ -905,19 +1297,30 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
             type: 'string',
             description: 'JavaScript code to minify',
           },
+          compress: {
+            type: 'boolean',
+            description: 'Fold constants, drop dead code and shorten statements',
+            default: false,
+          },
+          mangle: {
+            type: 'boolean',
+            description: 'Rename local variables and functions to short names',
+            default: false,
+          },
         },
         required: ['input'],
       },
-      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'code', argStyle: 'cli', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'csso',
     category: 'code',
     wasmUrl: 'wasm-tools/binaries/csso.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'csso',
-      'Minify CSS code by removing whitespace and comments.',
+      'Minify CSS code by removing whitespace and comments, shortening colors and numbers.',
       {
         type: 'object',
         properties: {
@@ -928,16 +1331,17 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
   {
     name: 'html-minifier',
     category: 'code',
     wasmUrl: 'wasm-tools/binaries/html-minifier.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'html-minifier',
-      'Minify HTML by removing whitespace and comments.',
+      'Minify HTML by removing whitespace and comments; inline scripts and styles are minified too.',
       {
         type: 'object',
         properties: {
@@ -948,7 +1352,7 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
         },
         required: ['input'],
       },
-      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input' }
+      { category: 'code', argStyle: 'positional', pipeable: true, stdinParam: 'input', buildProfile: 'speed', deterministic: true }
     ),
   },
 
@@ -959,9 +1363,11 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
     name: 'fzf',
     category: 'search',
     wasmUrl: 'wasm-tools/binaries/fzf.wasm',
+    simdWasmUrl: 'wasm-tools/binaries/fzf.simd.wasm',
+    bundle: MULTICALL_BUNDLE,
     manifest: createManifest(
       'fzf',
-      'Fuzzy find matching items from a list.',
+      'Fuzzy find matching items from a list. Streams any number of items, keeps the best greedy matches and ranks them by optimal alignment.',
       {
         type: 'object',
         properties: {
@@ -975,13 +1381,22 @@ export const BUILTIN_TOOLS: BuiltinToolConfig[] = [
           },
           limit: {
             type: 'number',
-            description: 'Maximum number of results (default: 10)',
-            default: 10,
+            description: 'Maximum number of results (default: 20)',
+            default: 20,
+          },
+          algo: {
+            type: 'string',
+            enum: ['v1', 'v2'],
+            description: 'Ranking: v2 (default) rescores the best greedy matches with an optimal alignment; v1 uses the greedy score only',
+          },
+          positions: {
+            type: 'boolean',
+            description: 'Append the matched character offsets (0-based, comma-separated) after a tab, for highlighting',
           },
         },
         required: ['query', 'items'],
       },
-      { category: 'search', argStyle: 'positional' }
+      { category: 'search', argStyle: 'cli', pipeable: true, stdinParam: 'items', buildProfile: 'speed', deterministic: true }
     ),
   },
 
@@ -8,6 +8,8 @@
 
 import { VirtualFileSystem } from './vfs';
 import type { ExecutionResult, ExecutionOptions } from './types';
+import { decodeOutput } from './worker-types';
+import { ExecutionRecorder } from './instrumentation';
 
 /**
  * WASI error codes
@@ -59,12 +61,14 @@ export class WasmRuntime {
   private args: string[] = [];
   private exitCode: number = 0;
   private hasExited: boolean = false;
+  private recorder: ExecutionRecorder | null = null;
 
   /**
-   * Execute a WASM module with the given arguments.
+   * Execute a WASM module with the given arguments. Accepts either the
+   * binary or a module already compiled from it (see module-cache.ts).
    */
   async execute(
-    wasmBinary: ArrayBuffer,
+    wasm: ArrayBuffer | WebAssembly.Module,
     args: string[],
     options: ExecutionOptions,
     vfs: VirtualFileSystem
@@ -73,6 +77,7 @@ export class WasmRuntime {
     this.args = args;
     this.exitCode = 0;
     this.hasExited = false;
+    this.recorder = options.trace ? new ExecutionRecorder() : null;
 
     // Set stdin: binary takes precedence over text
     if (options.stdinBinary) {
@@ -90,7 +95,7 @@ export class WasmRuntime {
     });
 
     // Execute with timeout
-    const executionPromise = this.executeInternal(wasmBinary);
+    const executionPromise = this.executeInternal(wasm);
 
     try {
       await Promise.race([executionPromise, timeoutPromise]);
@@ -102,43 +107,42 @@ export class WasmRuntime {
         this.exitCode = 1;
       }
     }
+    const trace = this.recorder?.finish();
 
-    // Get raw binary output
-    const stdoutBinary = vfs.getStdoutBinary();
-    const stderrBinary = vfs.getStderrBinary();
-
-    // Check if stdout contains valid UTF-8 by comparing round-trip lengths.
-    // If the encoded length of the decoded text doesn't match the original
-    // byte length, the output contains non-UTF-8 binary data.
-    const stdoutText = textDecoder.decode(stdoutBinary);
-    const isStdoutBinary = stdoutBinary.length > 0 &&
-      textEncoder.encode(stdoutText).length !== stdoutBinary.length;
-
-    const stderrText = textDecoder.decode(stderrBinary);
-    const isStderrBinary = stderrBinary.length > 0 &&
-      textEncoder.encode(stderrText).length !== stderrBinary.length;
+    // Output that is not valid UTF-8 is also returned as raw bytes
+    const stdout = decodeOutput(vfs.getStdoutBinary());
+    const stderr = decodeOutput(vfs.getStderrBinary());
 
     return {
       exitCode: this.exitCode,
-      stdout: stdoutText,
-      stderr: stderrText,
-      ...(isStdoutBinary && { stdoutBinary }),
-      ...(isStderrBinary && { stderrBinary }),
+      stdout: stdout.text,
+      stderr: stderr.text,
+      ...(stdout.binary && { stdoutBinary: stdout.binary }),
+      ...(stderr.binary && { stderrBinary: stderr.binary }),
+      ...(trace && { trace }),
     };
   }
 
   /**
    * Internal execution logic.
    */
-  private async executeInternal(wasmBinary: ArrayBuffer): Promise<void> {
-    const imports = this.createWasiImports();
-
-    // Compile and instantiate the module
-    const module = await WebAssembly.compile(wasmBinary);
+  private async executeInternal(wasm: ArrayBuffer | WebAssembly.Module): Promise<void> {
+    const wasiImports = this.createWasiImports();
+    const imports = this.recorder ? this.recorder.instrument(wasiImports) : wasiImports;
+
+    // Compile (unless precompiled) and instantiate the module
+    const compileStart = performance.now();
+    const module = wasm instanceof WebAssembly.Module ? wasm : await WebAssembly.compile(wasm);
+    const instantiateStart = performance.now();
     const instance = await WebAssembly.instantiate(module, imports);
 
     // Get memory from exports
     this.memory = instance.exports.memory as WebAssembly.Memory;
+    this.recorder?.attach(
+      this.memory,
+      instantiateStart - compileStart,
+      performance.now() - instantiateStart
+    );
 
     // Call the WASI _start function
     const start = instance.exports._start as (() => void) | undefined;
@@ -0,0 +1,129 @@
+/**
+ * Execution Trace Store
+ *
+ * Keeps the ExecutionTraces of recent tool executions for the UI, and
+ * exports them in the Trace Event Format read by chrome://tracing and
+ * Perfetto (https://ui.perfetto.dev).
+ */
+
+import type { ExecutionTrace } from './worker-types';
+
+export interface StoredTrace {
+  id: string;
+  toolName: string;
+  /** Tool input; long strings (inline content, base64 data) are truncated */
+  input: Record<string, unknown>;
+  /** Wall-clock start of the execution (Date.now()) */
+  startedAt: number;
+  trace: ExecutionTrace;
+}
+
+/**
+ * One event of the Trace Event Format; only the phases used here.
+ */
+export interface TraceEvent {
+  name: string;
+  /** X: complete event, C: counter, M: metadata */
+  ph: 'X' | 'C' | 'M';
+  /** Microseconds */
+  ts: number;
+  dur?: number;
+  pid: number;
+  tid: number;
+  cat?: string;
+  args?: Record<string, unknown>;
+}
+
+/** Longest string input value kept in a stored trace */
+const MAX_INPUT_STRING = 200;
+
+class TraceStore {
+  private traces: Map<string, StoredTrace> = new Map();
+  private traceCounter = 0;
+  private readonly maxTraces = 100;
+
+  /**
+   * Store a trace and return its ID
+   */
+  store(toolName: string, input: Record<string, unknown>, startedAt: number, trace: ExecutionTrace): string {
+    const id = `trace_${startedAt}_${this.traceCounter++}`;
+    const kept = Object.fromEntries(Object.entries(input).map(([key, value]) => [
+      key,
+      typeof value === 'string' && value.length > MAX_INPUT_STRING
+        ? `${value.slice(0, MAX_INPUT_STRING)}… (${value.length} chars)`
+        : value,
+    ]));
+    this.traces.set(id, { id, toolName, input: kept, startedAt, trace });
+
+    // Maps iterate in insertion order, so the first key is the oldest
+    while (this.traces.size > this.maxTraces) {
+      this.traces.delete(this.traces.keys().next().value!);
+    }
+    return id;
+  }
+
+  /**
+   * Retrieve a stored trace by ID
+   */
+  get(id: string): StoredTrace | undefined {
+    return this.traces.get(id);
+  }
+
+  /**
+   * All stored traces, oldest first
+   */
+  list(): StoredTrace[] {
+    return Array.from(this.traces.values());
+  }
+
+  /**
+   * Clear all stored traces
+   */
+  clear(): void {
+    this.traces.clear();
+  }
+}
+
+/**
+ * Convert traces to Trace Event Format JSON. Each execution gets its own
+ * track with compile, instantiate and run slices, the run slice carrying
+ * the per-syscall statistics, and a counter track for its memory size.
+ */
+export function toTraceEvents(traces: StoredTrace[]): { traceEvents: TraceEvent[]; displayTimeUnit: 'ms' } {
+  const events: TraceEvent[] = [];
+  const origin = Math.min(...traces.map((t) => t.startedAt));
+  const us = (ms: number) => Math.round(ms * 1000);
+
+  traces.forEach((stored, index) => {
+    const { trace } = stored;
+    const tid = index + 1;
+    const label = `${stored.toolName} #${tid}`;
+    const compileStart = us(stored.startedAt - origin);
+    const instantiateStart = compileStart + us(trace.compileMs);
+    const runStart = instantiateStart + us(trace.instantiateMs);
+    const slice = (name: string, ts: number, ms: number, args?: Record<string, unknown>): TraceEvent => ({
+      name, ph: 'X', ts, dur: us(ms), pid: 1, tid, cat: 'wasm', ...(args && { args }),
+    });
+    const memory = (ts: number, bytes: number): TraceEvent => ({
+      name: `${label} memory`, ph: 'C', ts, pid: 1, tid, args: { bytes },
+    });
+
+    events.push({ name: 'thread_name', ph: 'M', ts: 0, pid: 1, tid, args: { name: label } });
+    events.push(slice('compile', compileStart, trace.compileMs));
+    events.push(slice('instantiate', instantiateStart, trace.instantiateMs));
+    events.push(slice('run', runStart, trace.runMs, {
+      input: stored.input,
+      hostMs: trace.hostMs,
+      syscalls: trace.syscalls,
+    }));
+    events.push(memory(runStart, trace.initialMemoryBytes));
+    for (const growth of trace.memoryGrowth) {
+      events.push(memory(runStart + us(growth.atMs), growth.bytes));
+    }
+  });
+
+  return { traceEvents: events, displayTimeUnit: 'ms' };
+}
+
+// Export singleton instance
+export const traceStore = new TraceStore();
@@ -6,6 +6,7 @@
  */
 
 import { z } from 'zod';
+import type { ExecutionTrace } from './worker-types';
 
 // =============================================================================
 // Zod Schemas for Validation
@@ -46,6 +47,9 @@ export const WasmToolManifestSchema = z.object({
     memoryLimit: z.number().optional(),
     timeout: z.number().optional(),
     stdinParam: z.string().optional(),
+    fileParams: z.array(z.string()).optional(),
+    buildProfile: z.enum(['speed', 'size', 'pgo']).optional(),
+    deterministic: z.boolean().optional(),
   }),
   pipeable: z.boolean().optional(),
   category: z.string(),
@@ -100,6 +104,24 @@ export interface WasmToolManifest {
     timeout?: number;
     /** Parameter name whose value should be sent via stdin instead of argv */
     stdinParam?: string;
+    /**
+     * Parameter names holding project file paths. The named files are
+     * pre-loaded into the Worker's read-only VFS so the tool can open them.
+     */
+    fileParams?: string[];
+    /**
+     * Build of a built-in tool to fetch (see wasm-tools/build.sh): `speed`
+     * for hot tools, `size` for rarely used ones, `pgo` for speed with
+     * profile-guided optimization. Unset or missing builds fall back to
+     * the default -O2 binary.
+     */
+    buildProfile?: BuildProfile;
+    /**
+     * Output depends only on the arguments, stdin and the files named by
+     * fileParams (no clock, randomness or other file access), so a
+     * repeated execution can be answered from the execution cache.
+     */
+    deterministic?: boolean;
   };
 
   // Pipe support
@@ -112,6 +134,11 @@ export interface WasmToolManifest {
   homepage?: string;
 }
 
+/**
+ * Optimization profile of a built-in tool's binary.
+ */
+export type BuildProfile = 'speed' | 'size' | 'pgo';
+
 /**
  * A WASM tool as stored in IndexedDB.
  */
@@ -123,6 +150,22 @@ export interface StoredWasmTool {
   enabled: boolean;
   installedAt: number;
   updatedAt: number;
+  /**
+   * ID of the multicall bundle whose binary `wasmBinary` is. IndexedDB
+   * keeps one copy of a bundle's binary for all of its tools.
+   */
+  bundle?: string;
+}
+
+/**
+ * A multi-call module holding several built-in tools, which runs the one
+ * named by argv[0] (wasm-tools/src/multicall, built by build.sh).
+ */
+export interface MulticallBundle {
+  id: string;
+  wasmUrl: string;
+  /** Build compiled with `-msimd128`, as for BuiltinToolConfig */
+  simdWasmUrl?: string;
 }
 
 /**
@@ -132,6 +175,17 @@ export interface BuiltinToolConfig {
   name: string;
   category: string;
   wasmUrl: string;
+  /**
+   * Optional build of the same tool compiled with `-msimd128`. Used instead
+   * of `wasmUrl` when the engine supports WebAssembly SIMD.
+   */
+  simdWasmUrl?: string;
+  /**
+   * Multicall bundle that contains the tool. Preferred over the tool's own
+   * binary when the build provides it, so one download and one compiled
+   * module serve every tool in the bundle.
+   */
+  bundle?: MulticallBundle;
   manifest: WasmToolManifest;
   /**
    * Whether the tool is enabled on first install. Defaults to true.
@@ -156,6 +210,8 @@ export interface ExecutionOptions {
   stdin?: string;
   /** Binary stdin data. Takes precedence over `stdin` when both are set. */
   stdinBinary?: Uint8Array;
+  /** Record an ExecutionTrace and return it with the result */
+  trace?: boolean;
 }
 
 /**
@@ -169,6 +225,8 @@ export interface ExecutionResult {
   stdoutBinary?: Uint8Array;
   /** Raw binary stderr. Present when output contains non-UTF-8 data. */
   stderrBinary?: Uint8Array;
+  /** Present when the `trace` option was set */
+  trace?: ExecutionTrace;
 }
 
 /**
@@ -192,4 +250,6 @@ export interface ToolExecutionResult {
   error?: string;
   /** Raw binary stdout. Present when output contains non-UTF-8 data. */
   stdoutBinary?: Uint8Array;
+  /** Present when tracing is enabled; see setWasmTracingEnabled() */
+  trace?: ExecutionTrace;
 }
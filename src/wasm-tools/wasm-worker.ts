@@ -15,25 +15,50 @@
  * Performance features:
  * - Runs off main thread - UI remains responsive
  * - Pre-allocated memory for predictable performance
- * - Streaming output support (future)
+ * - Accepts precompiled modules and may be kept in a warm pool by the
+ *   manager; every request gets a fresh instance and VFS
+ * - stdin/stdout are copied straight between WASM memory and transferred
+ *   buffers, or streamed through ByteChannels when cross-origin isolated
  *
  * Cache version: 2
  */
 
-import type { WorkerRequest, WorkerResponse, WorkerExecutionOptions } from './worker-types';
-import type { ExecutionResult } from './types';
+import type { WorkerRequest, WorkerResponse, WorkerExecutionOptions, WorkerOutput, ExecutionTiming } from './worker-types';
+import { EXIT_BROKEN_PIPE } from './worker-types';
+import { ByteChannel } from './byte-channel';
+import { ExecutionRecorder } from './instrumentation';
 
 // WASI error codes
 const WASI_ERRNO = {
   SUCCESS: 0,
   BADF: 8,
+  EXIST: 20,
   INVAL: 28,
   IO: 29,
   NOENT: 44,
+  NOSPC: 51,
   NOSYS: 52,
   PERM: 63,
+  SPIPE: 70,
 } as const;
 
+// WASI path_open flags
+const WASI_OFLAGS = {
+  CREAT: 1,
+  EXCL: 4,
+  TRUNC: 8,
+} as const;
+
+/**
+ * Tools may create scratch files (e.g. sort's spilled runs) under this
+ * directory. They live in Worker memory only and are dropped when the
+ * execution ends.
+ */
+const SCRATCH_DIR = 'tmp/';
+
+/** Upper bound on the total size of scratch files per execution. */
+const MAX_SCRATCH_BYTES = 512 * 1024 * 1024;
+
 // WASI file types
 const WASI_FILETYPE = {
   CHARACTER_DEVICE: 2,
@@ -50,17 +75,56 @@ const WASI_RIGHTS = {
 const textEncoder = new TextEncoder();
 const textDecoder = new TextDecoder();
 
+/**
+ * Growable byte buffer that fd_write appends to directly from WASM memory.
+ * The backing ArrayBuffer is transferred to the main thread at the end.
+ */
+class OutputBuffer {
+  private bytes = new Uint8Array(4096);
+  private used = 0;
+
+  append(data: Uint8Array): void {
+    const needed = this.used + data.length;
+    if (needed > this.bytes.length) {
+      let capacity = this.bytes.length * 2;
+      while (capacity < needed) capacity *= 2;
+      const grown = new Uint8Array(capacity);
+      grown.set(this.bytes.subarray(0, this.used));
+      this.bytes = grown;
+    }
+    this.bytes.set(data, this.used);
+    this.used = needed;
+  }
+
+  get length(): number {
+    return this.used;
+  }
+
+  get buffer(): ArrayBuffer {
+    return this.bytes.buffer as ArrayBuffer;
+  }
+
+  view(): Uint8Array {
+    return this.bytes.subarray(0, this.used);
+  }
+}
+
 /**
  * Simple Virtual File System for Worker context.
- * Only handles stdin/stdout/stderr and pre-loaded files.
+ * Handles stdin/stdout/stderr, pre-loaded files (read-only) and scratch
+ * files created under SCRATCH_DIR.
  */
 class WorkerVFS {
   private stdinBuffer: Uint8Array = new Uint8Array(0);
   private stdinOffset = 0;
-  private stdoutChunks: Uint8Array[] = [];
-  private stderrChunks: Uint8Array[] = [];
+  private stdinChannel: ByteChannel | null = null;
+  private stdoutChannel: ByteChannel | null = null;
+  private stdout = new OutputBuffer();
+  private stderr = new OutputBuffer();
   private files: Map<string, Uint8Array> = new Map();
-  private openFiles: Map<number, { path: string; offset: number }> = new Map();
+  private openFiles: Map<number, { path: string; offset: number; writes?: Uint8Array[]; unlinked?: boolean }> =
+    new Map();
+  private scratchBytes = 0;
   // Reserve fd 3 for the preopened directory; dynamic fds start at 4
   private nextFd = 4;
 
@@ -73,6 +137,12 @@ class WorkerVFS {
     this.stdinOffset = 0;
   }
 
+  /** Stream stdin and/or stdout through shared ring buffers. */
+  setChannels(stdin?: SharedArrayBuffer, stdout?: SharedArrayBuffer): void {
+    this.stdinChannel = stdin ? new ByteChannel(stdin) : null;
+    this.stdoutChannel = stdout ? new ByteChannel(stdout) : null;
+  }
+
   setFiles(files: Record<string, string>): void {
     for (const [path, content] of Object.entries(files)) {
       this.files.set(path, textEncoder.encode(content));
@@ -86,42 +156,66 @@ class WorkerVFS {
     }
   }
 
-  readStdin(maxBytes: number): Uint8Array {
+  /**
+   * Copy stdin into `target` (a view of WASM memory). Blocks on a stdin
+   * channel until data arrives.
+   * @returns bytes read; 0 at end of input
+   */
+  readStdinInto(target: Uint8Array): number {
+    if (this.stdinChannel) {
+      return this.stdinChannel.readBlocking(target);
+    }
     const remaining = this.stdinBuffer.length - this.stdinOffset;
-    const bytesToRead = Math.min(maxBytes, remaining);
-    if (bytesToRead === 0) return new Uint8Array(0);
-    const result = this.stdinBuffer.slice(
-      this.stdinOffset,
-      this.stdinOffset + bytesToRead
-    );
+    const bytesToRead = Math.min(target.length, remaining);
+    if (bytesToRead === 0) return 0;
+    target.set(this.stdinBuffer.subarray(this.stdinOffset, this.stdinOffset + bytesToRead));
     this.stdinOffset += bytesToRead;
-    return result;
-  }
-
-  writeStdout(data: Uint8Array): number {
-    this.stdoutChunks.push(data.slice());
-    return data.length;
+    return bytesToRead;
   }
 
-  writeStderr(data: Uint8Array): number {
-    this.stderrChunks.push(data.slice());
-    return data.length;
+  /**
+   * Append to stdout. `data` may be a view of WASM memory; it is copied.
+   * @returns false if the stdout channel's reader has gone away
+   */
+  writeStdout(data: Uint8Array): boolean {
+    if (this.stdoutChannel) {
+      return this.stdoutChannel.writeBlocking(data);
+    }
+    this.stdout.append(data);
+    return true;
   }
 
-  getStdout(): string {
-    return textDecoder.decode(this.combineRawChunks(this.stdoutChunks));
+  writeStderr(data: Uint8Array): void {
+    this.stderr.append(data);
   }
 
-  getStdoutBinary(): Uint8Array {
-    return this.combineRawChunks(this.stdoutChunks);
+  /**
+   * Release the channels once the module has finished: readers of stdout
+   * see end of data, and the writer of stdin is told to stop (the module
+   * may exit without reading all of it, e.g. `head`).
+   */
+  closeChannels(): void {
+    this.stdoutChannel?.close();
+    this.stdinChannel?.cancel();
   }
 
-  getStderr(): string {
-    return textDecoder.decode(this.combineRawChunks(this.stderrChunks));
+  /** Raw output, with buffers ready to be transferred. */
+  takeOutput(exitCode: number): WorkerOutput {
+    return {
+      exitCode,
+      stdout: this.stdout.buffer,
+      stdoutLength: this.stdout.length,
+      stderr: this.stderr.buffer,
+      stderrLength: this.stderr.length,
+    };
   }
 
-  getStderrBinary(): Uint8Array {
-    return this.combineRawChunks(this.stderrChunks);
+  /** Leading stdout/stderr text, for logging. */
+  preview(maxBytes: number): { stdout: string; stderr: string } {
+    return {
+      stdout: textDecoder.decode(this.stdout.view().subarray(0, maxBytes)),
+      stderr: textDecoder.decode(this.stderr.view().subarray(0, maxBytes)),
+    };
   }
 
   private combineRawChunks(chunks: Uint8Array[]): Uint8Array {
@@ -146,23 +240,107 @@ class WorkerVFS {
     return fd;
   }
 
-  readFile(fd: number, maxBytes: number): Uint8Array {
+  /**
+   * Create (or truncate) a scratch file for writing. Writes are collected
+   * per descriptor and become readable when the descriptor is closed.
+   * Returns a WASI errno on failure.
+   */
+  createScratchFile(path: string, exclusive: boolean): number | { errno: number } {
+    const normalized = path.replace(/^\//, '');
+    if (!normalized.startsWith(SCRATCH_DIR)) {
+      return { errno: WASI_ERRNO.PERM };
+    }
+    const existing = this.files.get(normalized);
+    if (existing && exclusive) {
+      return { errno: WASI_ERRNO.EXIST };
+    }
+    if (existing) {
+      this.scratchBytes -= existing.length;
+    }
+    this.files.set(normalized, new Uint8Array(0));
+    const fd = this.nextFd++;
+    this.openFiles.set(fd, { path: normalized, offset: 0, writes: [] });
+    return fd;
+  }
+
+  isWritable(fd: number): boolean {
+    return this.openFiles.get(fd)?.writes !== undefined;
+  }
+
+  /** Append to a scratch file. Returns false when the scratch quota is exhausted. */
+  writeFile(fd: number, data: Uint8Array): boolean {
+    const fileInfo = this.openFiles.get(fd);
+    if (!fileInfo?.writes) throw new Error(`Invalid fd: ${fd}`);
+    if (this.scratchBytes + data.length > MAX_SCRATCH_BYTES) return false;
+    fileInfo.writes.push(data.slice());
+    this.scratchBytes += data.length;
+    return true;
+  }
+
+  /** Remove a scratch file. Pre-loaded files cannot be removed. */
+  unlinkFile(path: string): number {
+    const normalized = path.replace(/^\//, '');
+    if (!normalized.startsWith(SCRATCH_DIR)) return WASI_ERRNO.PERM;
+    const content = this.files.get(normalized);
+    if (!content) return WASI_ERRNO.NOENT;
+    this.scratchBytes -= content.length;
+    this.files.delete(normalized);
+    // Descriptors still writing to it must not recreate it on close
+    for (const fileInfo of this.openFiles.values()) {
+      if (fileInfo.path === normalized && fileInfo.writes) fileInfo.unlinked = true;
+    }
+    return WASI_ERRNO.SUCCESS;
+  }
+
+  /**
+   * Copy file content into `target` (a view of WASM memory).
+   * @returns bytes read; 0 at end of file
+   */
+  readFileInto(fd: number, target: Uint8Array): number {
     const fileInfo = this.openFiles.get(fd);
     if (!fileInfo) throw new Error(`Invalid fd: ${fd}`);
 
     const content = this.files.get(fileInfo.path);
     if (!content) throw new Error(`File not found: ${fileInfo.path}`);
 
-    const remaining = content.length - fileInfo.offset;
-    const bytesToRead = Math.min(maxBytes, remaining);
-    if (bytesToRead === 0) return new Uint8Array(0);
+    // Seeking past the end is allowed; reads there return nothing
+    const remaining = Math.max(0, content.length - fileInfo.offset);
+    const bytesToRead = Math.min(target.length, remaining);
+    if (bytesToRead === 0) return 0;
 
-    const result = content.slice(fileInfo.offset, fileInfo.offset + bytesToRead);
+    target.set(content.subarray(fileInfo.offset, fileInfo.offset + bytesToRead));
     fileInfo.offset += bytesToRead;
-    return result;
+    return bytesToRead;
+  }
+
+  /**
+   * Reposition a pre-loaded file (whence: 0 = SET, 1 = CUR, 2 = END).
+   * Scratch files being written are append-only.
+   * @returns the new offset, or a WASI errno
+   */
+  seekFile(fd: number, offset: number, whence: number): number | { errno: number } {
+    const fileInfo = this.openFiles.get(fd);
+    if (!fileInfo) return { errno: WASI_ERRNO.BADF };
+    if (fileInfo.writes) return { errno: WASI_ERRNO.SPIPE };
+
+    const size = this.files.get(fileInfo.path)?.length ?? 0;
+    const base = whence === 0 ? 0 : whence === 1 ? fileInfo.offset : whence === 2 ? size : NaN;
+    const target = base + offset;
+    if (!Number.isFinite(target) || target < 0) return { errno: WASI_ERRNO.INVAL };
+
+    fileInfo.offset = target;
+    return target;
   }
 
   closeFile(fd: number): void {
+    const fileInfo = this.openFiles.get(fd);
+    if (fileInfo?.writes) {
+      if (fileInfo.unlinked) {
+        this.scratchBytes -= fileInfo.writes.reduce((sum, chunk) => sum + chunk.length, 0);
+      } else {
+        this.files.set(fileInfo.path, this.combineRawChunks(fileInfo.writes));
+      }
+    }
     this.openFiles.delete(fd);
   }
 
@@ -180,18 +358,20 @@ class SandboxedWasmRuntime {
   private args: string[] = [];
   private exitCode = 0;
   private hasExited = false;
+  private recorder: ExecutionRecorder | null = null;
 
   constructor() {
     this.vfs = new WorkerVFS();
   }
 
   async execute(
-    wasmBinary: ArrayBuffer,
+    wasm: ArrayBuffer | WebAssembly.Module,
     args: string[],
-    options: WorkerExecutionOptions
-  ): Promise<ExecutionResult> {
+    options: WorkerExecutionOptions,
+    onInstantiated?: (timing: ExecutionTiming) => void
+  ): Promise<WorkerOutput> {
     console.log('[WASM Worker] execute() called', JSON.stringify({
-      binarySize: wasmBinary.byteLength,
+      binarySize: wasm instanceof ArrayBuffer ? wasm.byteLength : 'precompiled',
       args,
       hasStdin: !!options.stdin,
       stdinLength: options.stdin?.length ?? 0,
@@ -202,6 +382,7 @@ class SandboxedWasmRuntime {
     this.exitCode = 0;
     this.hasExited = false;
     this.vfs = new WorkerVFS();
+    this.recorder = options.trace ? new ExecutionRecorder() : null;
 
     // Set stdin: binary takes precedence over text
     if (options.stdinBinary) {
@@ -211,6 +392,13 @@ class SandboxedWasmRuntime {
       this.vfs.setStdin(options.stdin);
       console.log('[WASM Worker] stdin set:', options.stdin.substring(0, 100) + (options.stdin.length > 100 ? '...' : ''));
     }
+    if (options.stdinChannel || options.stdoutChannel) {
+      this.vfs.setChannels(options.stdinChannel, options.stdoutChannel);
+      console.log('[WASM Worker] streaming via channels:', JSON.stringify({
+        stdin: !!options.stdinChannel,
+        stdout: !!options.stdoutChannel,
+      }));
+    }
 
     // Set pre-loaded files (text)
     if (options.files) {
@@ -230,7 +418,7 @@ class SandboxedWasmRuntime {
 
     try {
       console.log('[WASM Worker] calling executeInternal...');
-      await this.executeInternal(wasmBinary);
+      await this.executeInternal(wasm, onInstantiated);
       console.log('[WASM Worker] executeInternal completed, exitCode:', this.exitCode);
     } catch (error) {
       console.error('[WASM Worker] executeInternal error:', error);
@@ -242,50 +430,50 @@ class SandboxedWasmRuntime {
       }
     }
 
-    // Get raw binary output
-    const stdoutBinary = this.vfs.getStdoutBinary();
-    const stderrBinary = this.vfs.getStderrBinary();
-
-    // Check if stdout contains valid UTF-8 by doing a round-trip test.
-    // If encoding the decoded string doesn't match the original bytes,
-    // the output contains non-UTF-8 binary data.
-    const stdoutText = textDecoder.decode(stdoutBinary);
-    const isStdoutBinary = stdoutBinary.length > 0 &&
-      textEncoder.encode(stdoutText).length !== stdoutBinary.length;
-
-    const stderrText = textDecoder.decode(stderrBinary);
-    const isStderrBinary = stderrBinary.length > 0 &&
-      textEncoder.encode(stderrText).length !== stderrBinary.length;
-
-    const result: import('./types').ExecutionResult = {
-      exitCode: this.exitCode,
-      stdout: stdoutText,
-      stderr: stderrText,
-      ...(isStdoutBinary && { stdoutBinary }),
-      ...(isStderrBinary && { stderrBinary }),
-    };
+    const trace = this.recorder?.finish();
+    this.vfs.closeChannels();
+
+    // Decoding happens on the main thread, once, after the buffers have
+    // been transferred
+    const output = this.vfs.takeOutput(this.exitCode);
+    if (trace) output.trace = trace;
 
     console.log('[WASM Worker] execute() returning', JSON.stringify({
-      exitCode: result.exitCode,
-      stdoutLength: result.stdout.length,
-      stderrLength: result.stderr.length,
-      hasBinaryStdout: !!result.stdoutBinary,
-      hasBinaryStderr: !!result.stderrBinary,
-      stdout: result.stdout,
-      stderr: result.stderr || undefined,
+      exitCode: output.exitCode,
+      stdoutLength: output.stdoutLength,
+      stderrLength: output.stderrLength,
+      ...this.vfs.preview(1024),
     }));
 
-    return result;
+    return output;
   }
 
-  private async executeInternal(wasmBinary: ArrayBuffer): Promise<void> {
+  private async executeInternal(
+    wasm: ArrayBuffer | WebAssembly.Module,
+    onInstantiated?: (timing: ExecutionTiming) => void
+  ): Promise<void> {
     console.log('[WASM Worker] executeInternal: creating WASI imports...');
-    const imports = this.createWasiImports();
+    const wasiImports = this.createWasiImports();
+    const imports = this.recorder ? this.recorder.instrument(wasiImports) : wasiImports;
 
-    console.log('[WASM Worker] executeInternal: compiling WASM module...');
-    const module = await WebAssembly.compile(wasmBinary);
-    console.log('[WASM Worker] executeInternal: module compiled, instantiating...');
+    const compileStart = performance.now();
+    let module: WebAssembly.Module;
+    if (wasm instanceof WebAssembly.Module) {
+      module = wasm;
+    } else {
+      console.log('[WASM Worker] executeInternal: compiling WASM module...');
+      module = await WebAssembly.compile(wasm);
+    }
+    const instantiateStart = performance.now();
+    console.log('[WASM Worker] executeInternal: module ready, instantiating...');
     const instance = await WebAssembly.instantiate(module, imports);
+    const timing: ExecutionTiming = {
+      compiled: !(wasm instanceof WebAssembly.Module),
+      pooledWorker: false,
+      compileMs: instantiateStart - compileStart,
+      instantiateMs: performance.now() - instantiateStart,
+    };
+    onInstantiated?.(timing);
     console.log('[WASM Worker] executeInternal: instance created, exports:', JSON.stringify(Object.keys(instance.exports)));
 
     // WASI modules compiled with WASI SDK define and export their own memory.
@@ -293,6 +481,7 @@ class SandboxedWasmRuntime {
     const exportedMemory = instance.exports.memory as WebAssembly.Memory | undefined;
     if (exportedMemory) {
       this.memory = exportedMemory;
+      this.recorder?.attach(exportedMemory, timing.compileMs, timing.instantiateMs);
       console.log('[WASM Worker] executeInternal: using exported memory, buffer size:', exportedMemory.buffer.byteLength);
     } else {
       throw new Error('WASM module does not export memory');
@@ -336,7 +525,7 @@ class SandboxedWasmRuntime {
         fd_read: this.fd_read.bind(this),
         fd_write: this.fd_write.bind(this),
         fd_close: this.fd_close.bind(this),
-        fd_seek: () => WASI_ERRNO.NOSYS,
+        fd_seek: this.fd_seek.bind(this),
         fd_fdstat_get: this.fd_fdstat_get.bind(this),
         fd_fdstat_set_flags: () => WASI_ERRNO.SUCCESS,
         fd_prestat_get: this.fd_prestat_get.bind(this),
@@ -347,7 +536,7 @@ class SandboxedWasmRuntime {
         path_filestat_get: () => WASI_ERRNO.NOSYS,
         path_create_directory: () => WASI_ERRNO.NOSYS,
         path_remove_directory: () => WASI_ERRNO.NOSYS,
-        path_unlink_file: () => WASI_ERRNO.NOSYS,
+        path_unlink_file: this.path_unlink_file.bind(this),
         path_rename: () => WASI_ERRNO.NOSYS,
 
         // Clock
@@ -445,12 +634,14 @@ class SandboxedWasmRuntime {
       const bufPtr = view.getUint32(iovsPtr + i * 8, true);
       const bufLen = view.getUint32(iovsPtr + i * 8 + 4, true);
 
-      let data: Uint8Array;
+      // Copy straight into linear memory, no intermediate buffer
+      const target = mem.subarray(bufPtr, bufPtr + bufLen);
+      let n: number;
       if (fd === 0) {
-        data = this.vfs.readStdin(bufLen);
+        n = this.vfs.readStdinInto(target);
       } else if (fd >= 3) {
         try {
-          data = this.vfs.readFile(fd, bufLen);
+          n = this.vfs.readFileInto(fd, target);
         } catch {
           return WASI_ERRNO.BADF;
         }
@@ -458,9 +649,8 @@ class SandboxedWasmRuntime {
         return WASI_ERRNO.BADF;
       }
 
-      mem.set(data, bufPtr);
-      totalRead += data.length;
-      if (data.length < bufLen) break;
+      totalRead += n;
+      if (n < bufLen) break;
     }
 
     view.setUint32(nreadPtr, totalRead, true);
@@ -480,14 +670,20 @@ class SandboxedWasmRuntime {
     for (let i = 0; i < iovsLen; i++) {
       const bufPtr = view.getUint32(iovsPtr + i * 8, true);
       const bufLen = view.getUint32(iovsPtr + i * 8 + 4, true);
-      const data = mem.slice(bufPtr, bufPtr + bufLen);
+      // A view, not a copy: stdout/stderr copy it into their own buffers
+      const data = mem.subarray(bufPtr, bufPtr + bufLen);
 
       if (fd === 1) {
-        this.vfs.writeStdout(data);
+        // No reader any more: end the module like SIGPIPE would rather
+        // than let it compute output nobody will read
+        if (!this.vfs.writeStdout(data)) this.proc_exit(EXIT_BROKEN_PIPE);
         totalWritten += data.length;
       } else if (fd === 2) {
         this.vfs.writeStderr(data);
         totalWritten += data.length;
+      } else if (this.vfs.isWritable(fd)) {
+        if (!this.vfs.writeFile(fd, data)) return WASI_ERRNO.NOSPC;
+        totalWritten += data.length;
       } else {
         return WASI_ERRNO.BADF;
       }
@@ -497,6 +693,14 @@ class SandboxedWasmRuntime {
     return WASI_ERRNO.SUCCESS;
   }
 
+  private fd_seek(fd: number, offset: bigint, whence: number, newOffsetPtr: number): number {
+    if (fd < 3) return WASI_ERRNO.SPIPE;
+    const result = this.vfs.seekFile(fd, Number(offset), whence);
+    if (typeof result !== 'number') return result.errno;
+    new DataView(this.memory!.buffer).setBigUint64(newOffsetPtr, BigInt(result), true);
+    return WASI_ERRNO.SUCCESS;
+  }
+
   private fd_close(fd: number): number {
     if (fd < 3) return WASI_ERRNO.SUCCESS;
     this.vfs.closeFile(fd);
@@ -556,7 +760,7 @@ class SandboxedWasmRuntime {
     _dirflags: number,
     pathPtr: number,
     pathLen: number,
-    _oflags: number,
+    oflags: number,
     _fsRightsBase: bigint,
     _fsRightsInheriting: bigint,
     _fdflags: number,
@@ -568,6 +772,14 @@ class SandboxedWasmRuntime {
     const pathBytes = mem.slice(pathPtr, pathPtr + pathLen);
     const path = textDecoder.decode(pathBytes);
 
+    // Creating or truncating is only allowed for scratch files
+    if (oflags & (WASI_OFLAGS.CREAT | WASI_OFLAGS.TRUNC)) {
+      const result = this.vfs.createScratchFile(path, (oflags & WASI_OFLAGS.EXCL) !== 0);
+      if (typeof result !== 'number') return result.errno;
+      view.setUint32(fdPtr, result, true);
+      return WASI_ERRNO.SUCCESS;
+    }
+
     try {
       const fd = this.vfs.openFile(path);
       view.setUint32(fdPtr, fd, true);
@@ -577,6 +789,12 @@ class SandboxedWasmRuntime {
     }
   }
 
+  private path_unlink_file(_fd: number, pathPtr: number, pathLen: number): number {
+    const mem = new Uint8Array(this.memory!.buffer);
+    const path = textDecoder.decode(mem.slice(pathPtr, pathPtr + pathLen));
+    return this.vfs.unlinkFile(path);
+  }
+
   // Clock
   private clock_time_get(
     _clockId: number,
@@ -611,8 +829,8 @@ const runtime = new SandboxedWasmRuntime();
 /**
  * Send a response back to the main thread.
  */
-function sendResponse(response: WorkerResponse): void {
-  self.postMessage(response);
+function sendResponse(response: WorkerResponse, transfer: Transferable[] = []): void {
+  self.postMessage(response, { transfer });
 }
 
 /**
@@ -637,19 +855,31 @@ self.onmessage = async (event: MessageEvent<WorkerRequest>) => {
   }
 
   try {
+    const wasm = request.wasmModule ?? request.wasmBinary;
+    if (!wasm) {
+      throw new Error('No WASM module or binary in request');
+    }
+
     console.log('[WASM Worker] starting execution for request:', request.id);
-    const result = await runtime.execute(
-      request.wasmBinary,
+    const output = await runtime.execute(
+      wasm,
       request.args,
-      request.options
+      request.options,
+      (timing) => {
+        sendResponse({
+          type: 'progress',
+          id: request.id,
+          progress: { stdout: '', stderr: '', timing },
+        });
+      }
     );
 
     console.log('[WASM Worker] execution complete, sending result for request:', request.id);
     sendResponse({
       type: 'result',
       id: request.id,
-      result,
-    });
+      output,
+    }, [output.stdout, output.stderr]);
   } catch (error) {
     console.error('[WASM Worker] execution failed for request:', request.id, error);
     sendResponse({
@@ -4,17 +4,48 @@
  * Manages the lifecycle of WASM sandbox Workers from the main thread.
  * Handles:
  * - Worker creation and termination
- * - Message passing for execution requests
+ * - A small pool of pre-started Workers reused across executions
+ * - Message passing for execution requests, transferring stdin/stdout
+ *   buffers instead of copying them
  * - Timeout enforcement with true termination
  * - Resource cleanup
  *
  * Security: Workers provide isolation from the main thread. If a WASM module
  * attempts to hang or consume resources, we can terminate the Worker cleanly.
+ * Only Workers whose execution finished normally go back to the pool; a
+ * timed out, cancelled or failed Worker is always terminated. Each request
+ * gets a fresh WASM instance, memory and VFS inside the Worker.
  */
 
 import type { ExecutionResult } from './types';
 import type { WorkerRequest, WorkerResponse } from './worker-types';
-import { generateRequestId, sanitizeExecutionOptions } from './worker-types';
+import { generateRequestId, sanitizeExecutionOptions, toExecutionResult } from './worker-types';
+import type { ByteChannel } from './byte-channel';
+
+/**
+ * Workers a parallel execution (see parallel-grep.ts) runs at once: one
+ * per core, capped so a search can't starve the page of memory.
+ */
+export const MAX_PARALLEL_WORKERS = Math.max(
+  1,
+  Math.min(typeof navigator !== 'undefined' ? navigator.hardwareConcurrency || 4 : 4, 8)
+);
+
+/**
+ * Maximum number of idle Workers kept alive for reuse. Enough for a
+ * repeated parallel search to start every Worker warm.
+ */
+const MAX_IDLE_WORKERS = Math.max(2, MAX_PARALLEL_WORKERS);
+
+/**
+ * Idle Workers are terminated after this long without work (1 minute).
+ */
+const IDLE_WORKER_TIMEOUT = 60000;
+
+/**
+ * Progress payload forwarded to `onProgress`.
+ */
+export type WorkerProgress = NonNullable<WorkerResponse['progress']>;
 
 /**
  * Pending execution tracking.
@@ -24,6 +55,24 @@ interface PendingExecution {
   reject: (error: Error) => void;
   timeoutId: ReturnType<typeof setTimeout>;
   worker: Worker;
+  /** Whether the Worker came from the idle pool */
+  pooled: boolean;
+  onProgress?: (progress: WorkerProgress) => void;
+  /** Streaming stdout, closed if the Worker is terminated early */
+  stdoutChannel?: ByteChannel;
+  /** Streaming stdin, cancelled if the Worker is terminated early */
+  stdinChannel?: ByteChannel;
+  /** Caller's abort signal and the listener to remove once settled */
+  signal?: AbortSignal;
+  onAbort?: () => void;
+}
+
+/**
+ * An idle Worker waiting in the pool.
+ */
+interface IdleWorker {
+  worker: Worker;
+  idleTimer: ReturnType<typeof setTimeout>;
 }
 
 /**
@@ -42,16 +91,34 @@ export interface WorkerManagerExecutionOptions {
   files?: Record<string, string>;
   /** Pre-loaded binary files (path -> raw content) */
   filesBinary?: Record<string, ArrayBuffer>;
+  /** Called for progress messages, including start-up timing */
+  onProgress?: (progress: WorkerProgress) => void;
+  /**
+   * Read stdin from this channel instead of `stdin`/`stdinBinary`.
+   * Only usable when isByteChannelSupported() is true.
+   */
+  stdinChannel?: ByteChannel;
+  /**
+   * Write stdout to this channel; the result's `stdout` is then empty.
+   * Only usable when isByteChannelSupported() is true.
+   */
+  stdoutChannel?: ByteChannel;
+  /** Return an ExecutionTrace with the result (see instrumentation.ts) */
+  trace?: boolean;
+  /** Terminates the execution when aborted, as cancel() does */
+  signal?: AbortSignal;
 }
 
 /**
  * WASM Worker Manager - handles Worker-based WASM execution.
  *
- * Each execution gets a fresh Worker for isolation. Workers are terminated
- * after execution completes or on timeout.
+ * Each execution runs in its own Worker. Workers that finish normally are
+ * returned to a bounded idle pool so the next execution skips Worker
+ * start-up; Workers are terminated on timeout, cancellation or error.
  */
 export class WasmWorkerManager {
   private pending: Map<string, PendingExecution> = new Map();
+  private idle: IdleWorker[] = [];
   private isSupported: boolean = true;
 
   constructor() {
@@ -69,16 +136,30 @@ export class WasmWorkerManager {
     return this.isSupported;
   }
 
+  /**
+   * Start Workers ahead of time so the next executions are warm.
+   *
+   * @param count - Number of idle Workers to have ready (capped by the pool size)
+   */
+  prewarm(count: number = 1): void {
+    if (!this.isSupported) return;
+    const target = Math.min(count, MAX_IDLE_WORKERS);
+    while (this.idle.length < target) {
+      this.releaseWorker(this.createWorker());
+    }
+  }
+
   /**
    * Execute a WASM module in an isolated Worker.
    *
-   * @param wasmBinary - The compiled WASM binary
+   * @param wasm - The WASM binary, or a module compiled from it (preferred;
+   *   the Worker then only has to instantiate it)
    * @param args - Command-line arguments for the module
    * @param options - Execution options
    * @returns Execution result with stdout, stderr, and exit code
    */
   async execute(
-    wasmBinary: ArrayBuffer,
+    wasm: ArrayBuffer | WebAssembly.Module,
     args: string[],
     options: WorkerManagerExecutionOptions = {}
   ): Promise<ExecutionResult> {
@@ -86,11 +167,33 @@ export class WasmWorkerManager {
       throw new Error('Web Workers not supported in this environment');
     }
 
+    if (options.signal?.aborted) {
+      throw new Error('Cancelled by user');
+    }
+
     const requestId = generateRequestId();
     const sanitizedOptions = sanitizeExecutionOptions(options);
 
-    // Create a new Worker for this execution
-    const worker = this.createWorker();
+    // Encode text stdin once here and transfer the bytes, rather than
+    // structured-cloning the string and encoding it again in the Worker
+    if (sanitizedOptions.stdin && !sanitizedOptions.stdinBinary) {
+      const encoded = new TextEncoder().encode(sanitizedOptions.stdin);
+      sanitizedOptions.stdinBinary = encoded.buffer as ArrayBuffer;
+      sanitizedOptions.stdin = undefined;
+    }
+
+    // Channels are shared, never transferred
+    if (options.stdinChannel) {
+      sanitizedOptions.stdinChannel = options.stdinChannel.buffer;
+      sanitizedOptions.stdin = undefined;
+      sanitizedOptions.stdinBinary = undefined;
+    }
+    if (options.stdoutChannel) {
+      sanitizedOptions.stdoutChannel = options.stdoutChannel.buffer;
+    }
+
+    // Reuse an idle Worker when one is available
+    const { worker, pooled } = this.acquireWorker();
 
     return new Promise<ExecutionResult>((resolve, reject) => {
       // Set up timeout for true termination, using sanitized options
@@ -98,12 +201,20 @@ export class WasmWorkerManager {
         this.terminateExecution(requestId, 'Execution timeout');
       }, sanitizedOptions.timeout);
 
+      const onAbort = () => this.cancel(requestId);
+
       // Track this pending execution
       this.pending.set(requestId, {
         resolve,
         reject,
         timeoutId,
         worker,
+        pooled,
+        onProgress: options.onProgress,
+        stdoutChannel: options.stdoutChannel,
+        stdinChannel: options.stdinChannel,
+        signal: options.signal,
+        onAbort,
       });
 
       // Set up message handler
@@ -119,16 +230,18 @@ export class WasmWorkerManager {
       };
 
       // Send execution request
+      const isModule = wasm instanceof WebAssembly.Module;
       const request: WorkerRequest = {
         type: 'execute',
         id: requestId,
-        wasmBinary,
+        ...(isModule ? { wasmModule: wasm } : { wasmBinary: wasm }),
         args,
         options: sanitizedOptions,
       };
 
-      // Collect all ArrayBuffers for zero-copy transfer
-      const transferables: ArrayBuffer[] = [wasmBinary];
+      // Collect all ArrayBuffers for zero-copy transfer. Modules are
+      // shared with the Worker, not transferred.
+      const transferables: ArrayBuffer[] = isModule ? [] : [wasm];
       if (sanitizedOptions.stdinBinary) {
         transferables.push(sanitizedOptions.stdinBinary);
       }
@@ -139,9 +252,49 @@ export class WasmWorkerManager {
       }
 
       worker.postMessage(request, transferables);
+
+      options.signal?.addEventListener('abort', onAbort, { once: true });
     });
   }
 
+  /**
+   * Take a Worker from the idle pool, or start a new one.
+   */
+  private acquireWorker(): { worker: Worker; pooled: boolean } {
+    const entry = this.idle.pop();
+    if (entry) {
+      clearTimeout(entry.idleTimer);
+      return { worker: entry.worker, pooled: true };
+    }
+    return { worker: this.createWorker(), pooled: false };
+  }
+
+  /**
+   * Return a Worker that finished normally to the idle pool, or terminate
+   * it when the pool is full.
+   */
+  private releaseWorker(worker: Worker): void {
+    if (this.idle.length >= MAX_IDLE_WORKERS) {
+      worker.terminate();
+      return;
+    }
+
+    worker.onmessage = null;
+    worker.onerror = () => this.discardIdleWorker(worker);
+
+    const idleTimer = setTimeout(() => this.discardIdleWorker(worker), IDLE_WORKER_TIMEOUT);
+    this.idle.push({ worker, idleTimer });
+  }
+
+  private discardIdleWorker(worker: Worker): void {
+    const index = this.idle.findIndex((entry) => entry.worker === worker);
+    if (index >= 0) {
+      clearTimeout(this.idle[index].idleTimer);
+      this.idle.splice(index, 1);
+    }
+    worker.terminate();
+  }
+
   /**
    * Create a new Worker instance.
    * Uses Vite's URL-based Worker support for proper bundling.
@@ -168,12 +321,13 @@ export class WasmWorkerManager {
     // Handle response type
     switch (response.type) {
       case 'result':
-        // Clear timeout and cleanup on final result
-        clearTimeout(pending.timeoutId);
-        pending.worker.terminate();
-        this.pending.delete(response.id);
+        // Clear timeout; the Worker finished normally and can be reused
+        this.settle(response.id, pending);
+        this.releaseWorker(pending.worker);
 
-        if (response.result) {
+        if (response.output) {
+          pending.resolve(toExecutionResult(response.output));
+        } else if (response.result) {
           pending.resolve(response.result);
         } else {
           pending.reject(new Error('No result in response'));
@@ -182,9 +336,9 @@ export class WasmWorkerManager {
 
       case 'error':
         // Clear timeout and cleanup on error
-        clearTimeout(pending.timeoutId);
+        this.settle(response.id, pending);
         pending.worker.terminate();
-        this.pending.delete(response.id);
+        this.releaseChannels(pending);
 
         pending.reject(new Error(response.error || 'Unknown error'));
         break;
@@ -192,14 +346,19 @@ export class WasmWorkerManager {
       case 'progress':
         // Progress updates are informational, don't terminate or resolve
         // Keep timeout running and Worker alive
-        // Future: Could emit events for streaming output
+        if (response.progress && pending.onProgress) {
+          const progress = response.progress.timing
+            ? { ...response.progress, timing: { ...response.progress.timing, pooledWorker: pending.pooled } }
+            : response.progress;
+          pending.onProgress(progress);
+        }
         break;
 
       default:
         // Unknown response type - cleanup and reject
-        clearTimeout(pending.timeoutId);
+        this.settle(response.id, pending);
         pending.worker.terminate();
-        this.pending.delete(response.id);
+        this.releaseChannels(pending);
 
         pending.reject(new Error(`Unknown response type: ${response.type}`));
     }
@@ -212,20 +371,38 @@ export class WasmWorkerManager {
     const pending = this.pending.get(requestId);
     if (!pending) return;
 
-    // Clear timeout
-    clearTimeout(pending.timeoutId);
+    // Clear timeout and remove from pending
+    this.settle(requestId, pending);
 
     // CRITICAL: Actually terminate the Worker
     // This is the key security feature - it truly stops WASM execution
     pending.worker.terminate();
 
-    // Remove from pending
-    this.pending.delete(requestId);
+    // The Worker can no longer close its channels itself
+    this.releaseChannels(pending);
 
     // Reject the promise
     pending.reject(new Error(reason));
   }
 
+  /**
+   * Forget a finished execution: clear its timeout and stop listening to
+   * its abort signal, which may outlive it (e.g. one signal for a batch).
+   */
+  private settle(requestId: string, pending: PendingExecution): void {
+    clearTimeout(pending.timeoutId);
+    if (pending.onAbort) pending.signal?.removeEventListener('abort', pending.onAbort);
+    this.pending.delete(requestId);
+  }
+
+  /**
+   * Unblock the other ends of a terminated execution's channels.
+   */
+  private releaseChannels(pending: PendingExecution): void {
+    pending.stdoutChannel?.close();
+    pending.stdinChannel?.cancel();
+  }
+
   /**
    * Cancel a specific execution by request ID.
    */
@@ -238,13 +415,24 @@ export class WasmWorkerManager {
   }
 
   /**
-   * Cancel all pending executions.
+   * Cancel all pending executions and shut down idle Workers.
    * Useful for cleanup when the user navigates away or closes the tool manager.
    */
   cancelAll(): void {
     for (const requestId of this.pending.keys()) {
       this.terminateExecution(requestId, 'All executions cancelled');
     }
+    for (const entry of this.idle.splice(0)) {
+      clearTimeout(entry.idleTimer);
+      entry.worker.terminate();
+    }
+  }
+
+  /**
+   * Get the number of idle Workers ready for reuse.
+   */
+  get idleCount(): number {
+    return this.idle.length;
   }
 
   /**
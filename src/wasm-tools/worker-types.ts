@@ -32,6 +32,12 @@ export const DEFAULT_TIMEOUT = 30000;
  */
 export const MAX_TIMEOUT = 300000;
 
+/**
+ * Exit status of a module whose stdout channel reader has gone away
+ * (128 + SIGPIPE), as a shell reports for `producer | head`.
+ */
+export const EXIT_BROKEN_PIPE = 141;
+
 /**
  * Request message sent from main thread to Worker.
  */
@@ -39,8 +45,10 @@ export interface WorkerRequest {
   type: 'execute';
   /** Unique request ID for correlating responses */
   id: string;
-  /** WASM binary to execute */
-  wasmBinary: ArrayBuffer;
+  /** WASM binary to execute (compiled in the Worker) */
+  wasmBinary?: ArrayBuffer;
+  /** Already compiled module; takes precedence over `wasmBinary` */
+  wasmModule?: WebAssembly.Module;
   /** Command-line arguments for the WASM module */
   args: string[];
   /** Execution options */
@@ -70,6 +78,33 @@ export interface WorkerExecutionOptions {
    * Keys are virtual paths, values are raw file contents.
    */
   filesBinary?: Record<string, ArrayBuffer>;
+  /**
+   * Stream stdin from a ByteChannel (see byte-channel.ts) instead of a
+   * buffer. Requires cross-origin isolation.
+   */
+  stdinChannel?: SharedArrayBuffer;
+  /**
+   * Stream stdout into a ByteChannel instead of buffering it; the result's
+   * `stdout` is then empty. If the reader cancels, the module exits with
+   * EXIT_BROKEN_PIPE. Requires cross-origin isolation.
+   */
+  stdoutChannel?: SharedArrayBuffer;
+  /** Record an ExecutionTrace and return it with the output */
+  trace?: boolean;
+}
+
+/**
+ * Raw output of a Worker execution. The buffers are transferred, not
+ * copied; only the first `*Length` bytes are meaningful.
+ */
+export interface WorkerOutput {
+  exitCode: number;
+  stdout: ArrayBuffer;
+  stdoutLength: number;
+  stderr: ArrayBuffer;
+  stderrLength: number;
+  /** Present when the `trace` option was set */
+  trace?: ExecutionTrace;
 }
 
 /**
@@ -81,12 +116,121 @@ export interface WorkerResponse {
   id: string;
   /** Execution result (for type: 'result') */
   result?: ExecutionResult;
+  /** Undecoded execution output (for type: 'result'); see toExecutionResult() */
+  output?: WorkerOutput;
   /** Error message (for type: 'error') */
   error?: string;
   /** Progress update with partial output */
   progress?: {
     stdout: string;
     stderr: string;
+    /** Start-up timing, sent once the module has been instantiated */
+    timing?: ExecutionTiming;
+  };
+}
+
+/**
+ * Start-up cost of one execution, for cold vs warm start reporting.
+ * A warm start reuses both a compiled module and a pooled Worker.
+ */
+export interface ExecutionTiming {
+  /** The module had to be compiled for this execution */
+  compiled: boolean;
+  /** The request ran in a pre-started Worker from the pool */
+  pooledWorker: boolean;
+  /** Time spent compiling (or loading the cached module), in milliseconds */
+  compileMs: number;
+  /** Time spent instantiating the module in the Worker, in milliseconds */
+  instantiateMs: number;
+}
+
+/**
+ * Host-side cost of one WASI import over an execution.
+ */
+export interface SyscallStats {
+  calls: number;
+  /**
+   * Payload bytes of successful calls: bytes read or written for fd_read
+   * and fd_write, bytes filled for random_get, path length for path_*
+   */
+  bytes: number;
+  /** Time spent in the host implementation, in milliseconds */
+  ms: number;
+}
+
+/**
+ * Growth of the module's linear memory. memory.grow runs inside the
+ * module, so growth is observed at the next host call (or at exit).
+ */
+export interface MemoryGrowth {
+  /** Milliseconds since _start was called */
+  atMs: number;
+  /** Memory size after growing, in bytes */
+  bytes: number;
+}
+
+/**
+ * What one execution did, recorded when the `trace` option is set.
+ * See instrumentation.ts.
+ */
+export interface ExecutionTrace {
+  /**
+   * Time spent compiling, in milliseconds: zero for a precompiled module
+   * in the runtimes, the module cache's compile or load time in the manager
+   */
+  compileMs: number;
+  /** Time spent instantiating, in milliseconds */
+  instantiateMs: number;
+  /** Time spent in _start, host calls included, in milliseconds */
+  runMs: number;
+  /** Time spent in host calls, in milliseconds */
+  hostMs: number;
+  /** Per WASI import, keyed by import name; imports never called are left out */
+  syscalls: Record<string, SyscallStats>;
+  /** Linear memory size when _start was called, in bytes */
+  initialMemoryBytes: number;
+  /** Largest linear memory size observed, in bytes */
+  peakMemoryBytes: number;
+  /** Observed growths, oldest first; at most MAX_TRACE_GROWTH_EVENTS */
+  memoryGrowth: MemoryGrowth[];
+}
+
+/**
+ * Cap on ExecutionTrace.memoryGrowth, as allocators that grow memory one
+ * page at a time would otherwise make the trace as large as the output.
+ */
+export const MAX_TRACE_GROWTH_EVENTS = 1024;
+
+const strictDecoder = new TextDecoder('utf-8', { fatal: true });
+const lenientDecoder = new TextDecoder();
+
+/**
+ * Decode tool output as UTF-8 in a single pass. Output that is not valid
+ * UTF-8 is decoded leniently for display and the raw bytes are returned
+ * as `binary`.
+ */
+export function decodeOutput(bytes: Uint8Array): { text: string; binary?: Uint8Array } {
+  if (bytes.length === 0) return { text: '' };
+  try {
+    return { text: strictDecoder.decode(bytes) };
+  } catch {
+    return { text: lenientDecoder.decode(bytes), binary: bytes };
+  }
+}
+
+/**
+ * Build an ExecutionResult from raw Worker output.
+ */
+export function toExecutionResult(output: WorkerOutput): ExecutionResult {
+  const stdout = decodeOutput(new Uint8Array(output.stdout, 0, output.stdoutLength));
+  const stderr = decodeOutput(new Uint8Array(output.stderr, 0, output.stderrLength));
+  return {
+    exitCode: output.exitCode,
+    stdout: stdout.text,
+    stderr: stderr.text,
+    ...(stdout.binary && { stdoutBinary: stdout.binary }),
+    ...(stderr.binary && { stderrBinary: stderr.binary }),
+    ...(output.trace && { trace: output.trace }),
   };
 }
 
@@ -150,5 +294,6 @@ export function sanitizeExecutionOptions(
     // Pass through pre-loaded files when provided
     files: options.files,
     filesBinary: options.filesBinary,
+    trace: options.trace,
   };
 }
@@ -0,0 +1,77 @@
+import { test, expect } from '@playwright/test';
+
+/**
+ * Streaming WASM Pipeline Integration Tests
+ *
+ * Pipe chains only stream when the page is cross-origin isolated, because
+ * their stages are connected by SharedArrayBuffer channels. These tests
+ * load the app from the dev server (which sends the same COOP/COEP headers
+ * as production, see server/isolation.ts) and run a real pipeline through
+ * the Worker runtime.
+ */
+
+/**
+ * A minimal WASI `cat`: copies stdin to stdout in 4 KB reads.
+ *
+ * (module
+ *   (import "wasi_snapshot_preview1" "fd_read" (func $read (param i32 i32 i32 i32) (result i32)))
+ *   (import "wasi_snapshot_preview1" "fd_write" (func $write (param i32 i32 i32 i32) (result i32)))
+ *   (memory (export "memory") 1)
+ *   (func (export "_start")
+ *     (i32.store (i32.const 0) (i32.const 1024))       ;; read iovec: buf
+ *     (i32.store (i32.const 4) (i32.const 4096))       ;;             len
+ *     (block $done
+ *       (loop $next
+ *         (br_if $done (call $read (i32.const 0) (i32.const 0) (i32.const 1) (i32.const 16)))
+ *         (br_if $done (i32.eqz (i32.load (i32.const 16))))
+ *         (i32.store (i32.const 8) (i32.const 1024))     ;; write iovec: buf
+ *         (i32.store (i32.const 12) (i32.load (i32.const 16)))
+ *         (br_if $done (call $write (i32.const 1) (i32.const 8) (i32.const 1) (i32.const 20)))
+ *         (br $next)))))
+ */
+const WASI_CAT_BASE64 =
+  'AGFzbQEAAAABDAJgBH9/f38Bf2AAAAJEAhZ3YXNpX3NuYXBzaG90X3ByZXZpZXcxB2ZkX3JlYWQAABZ3YXNpX3NuYXBzaG90X3ByZXZpZXcx' +
+  'CGZkX3dyaXRlAAADAgEBBQMBAAEHEwIGbWVtb3J5AgAGX3N0YXJ0AAIKTgFMAEEAQYAINgIAQQRBgCA2AgACQANAQQBBAEEBQRAQAA0BQRAo' +
+  'AgBFDQFBCEGACDYCAEEMQRAoAgA2AgBBAUEIQQFBFBABDQEMAAsLCw==';
+
+test.describe('Streaming WASM Pipeline', () => {
+  test.beforeEach(async ({ page }) => {
+    await page.goto('/');
+    await page.waitForLoadState('networkidle');
+  });
+
+  test('page is cross-origin isolated', async ({ page }) => {
+    const isolation = await page.evaluate(async () => {
+      // Module paths are served by the Vite dev server
+      const byteChannel = '/src/wasm-tools/byte-channel.ts';
+      const { isByteChannelSupported } = await import(byteChannel);
+      return {
+        crossOriginIsolated: self.crossOriginIsolated,
+        byteChannelSupported: isByteChannelSupported(),
+      };
+    });
+
+    expect(isolation).toEqual({ crossOriginIsolated: true, byteChannelSupported: true });
+  });
+
+  test('pipe chain streams through channels between Workers', async ({ page }) => {
+    const result = await page.evaluate(async (wasmBase64) => {
+      const pipeline = '/src/wasm-tools/pipeline.ts';
+      const { runStreamingPipeline } = await import(pipeline);
+      const wasm = Uint8Array.from(atob(wasmBase64), (c) => c.charCodeAt(0));
+
+      // 1 MB through a 4 KB channel: the stages must run concurrently
+      const input = Array.from({ length: 100_000 }, (_, i) => `line ${i}\n`).join('');
+      const stage = () => ({ name: 'cat', wasm: wasm.slice().buffer, args: ['cat'], timeout: 30_000 });
+      const output = await runStreamingPipeline([stage(), stage(), stage()], input, 4096);
+
+      return {
+        success: output.success,
+        matches: output.stdout === input,
+        exitCodes: output.stages.map((s: { exitCode?: number; error?: string }) => s.exitCode ?? s.error),
+      };
+    }, WASI_CAT_BASE64);
+
+    expect(result).toEqual({ success: true, matches: true, exitCodes: [0, 0, 0] });
+  });
+});
@@ -9,6 +9,7 @@
  */
 import { describe, it, expect } from 'vitest';
 import { findBinaryParam, convertArgsToCliFormat } from '../../src/wasm-tools/manager';
+import { decodeOutput, toExecutionResult } from '../../src/wasm-tools/worker-types';
 import type { WasmToolManifest } from '../../src/wasm-tools/types';
 
 // ---------------------------------------------------------------------------
@@ -131,17 +132,10 @@ describe('VirtualFileSystem binary I/O', () => {
 
 describe('Binary output detection', () => {
   const textEncoder = new TextEncoder();
-  const textDecoder = new TextDecoder();
 
-  /**
-   * Reproduces the binary detection logic used in runtime.ts and wasm-worker.ts:
-   * compare byte length of original output with the byte length of
-   * re-encoding the decoded text.
-   */
+  /** decodeOutput() is shared by runtime.ts and the Worker manager */
   function isBinaryOutput(data: Uint8Array): boolean {
-    if (data.length === 0) return false;
-    const decoded = textDecoder.decode(data);
-    return textEncoder.encode(decoded).length !== data.length;
+    return decodeOutput(data).binary !== undefined;
   }
 
   it('detects valid UTF-8 text as non-binary', () => {
@@ -172,6 +166,31 @@ describe('Binary output detection', () => {
     const gzip = new Uint8Array([0x1F, 0x8B, 0x08, 0x00]);
     expect(isBinaryOutput(gzip)).toBe(true);
   });
+
+  it('returns the raw bytes alongside lenient text for binary output', () => {
+    const bytes = new Uint8Array([0x61, 0xFF, 0x62]);
+    const decoded = decodeOutput(bytes);
+    expect(decoded.text).toBe('a\uFFFDb');
+    expect(decoded.binary).toBe(bytes);
+  });
+
+  it('decodes transferred Worker output using only the reported lengths', () => {
+    const stdout = new Uint8Array(16);
+    stdout.set(textEncoder.encode('hello'));
+    const stderr = new Uint8Array([0xC0, 0x00, 0x00, 0x00]);
+
+    const result = toExecutionResult({
+      exitCode: 2,
+      stdout: stdout.buffer,
+      stdoutLength: 5,
+      stderr: stderr.buffer,
+      stderrLength: 1,
+    });
+    expect(result.exitCode).toBe(2);
+    expect(result.stdout).toBe('hello');
+    expect(result.stdoutBinary).toBeUndefined();
+    expect(result.stderrBinary).toEqual(new Uint8Array([0xC0]));
+  });
 });
 
 // ---------------------------------------------------------------------------
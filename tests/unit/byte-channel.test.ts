@@ -0,0 +1,88 @@
+/**
+ * Unit tests for the SharedArrayBuffer byte channel
+ *
+ * Both ends run on the test thread, so only the non-blocking and async
+ * paths are exercised here; the blocking paths are used inside Workers.
+ */
+import { describe, it, expect } from 'vitest';
+import { ByteChannel } from '../../src/wasm-tools/byte-channel';
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+describe('ByteChannel', () => {
+  it('rounds the capacity up to a power of two', () => {
+    expect(new ByteChannel(3000).capacity).toBe(4096);
+    expect(new ByteChannel(1).capacity).toBe(1024);
+  });
+
+  it('shares state between instances wrapping the same buffer', () => {
+    const writer = new ByteChannel(1024);
+    const reader = new ByteChannel(writer.buffer);
+
+    expect(writer.tryWrite(textEncoder.encode('hello'))).toBe(5);
+    const target = new Uint8Array(16);
+    const n = reader.tryRead(target);
+    expect(textDecoder.decode(target.subarray(0, n))).toBe('hello');
+  });
+
+  it('wraps around the end of the ring', () => {
+    const channel = new ByteChannel(1024);
+    const target = new Uint8Array(1024);
+
+    channel.tryWrite(new Uint8Array(1000));
+    channel.tryRead(target);
+
+    const data = new Uint8Array(100).map((_, i) => i);
+    expect(channel.tryWrite(data)).toBe(100);
+    expect(channel.tryRead(target)).toBe(100);
+    expect(target.subarray(0, 100)).toEqual(data);
+  });
+
+  it('accepts only what fits when full', () => {
+    const channel = new ByteChannel(1024);
+    expect(channel.tryWrite(new Uint8Array(1500))).toBe(1024);
+    expect(channel.tryWrite(new Uint8Array(1))).toBe(0);
+  });
+
+  it('drains buffered bytes before reporting end of data', async () => {
+    const channel = new ByteChannel(1024);
+    channel.tryWrite(textEncoder.encode('tail'));
+    channel.close();
+
+    const target = new Uint8Array(16);
+    expect(await channel.read(target)).toBe(4);
+    expect(await channel.read(target)).toBe(0);
+  });
+
+  it('applies backpressure to async writers until the reader catches up', async () => {
+    const channel = new ByteChannel(1024);
+    const data = new Uint8Array(3000).map((_, i) => i & 0xff);
+
+    const writing = channel.write(data).then((ok) => {
+      channel.close();
+      return ok;
+    });
+
+    const received: number[] = [];
+    const target = new Uint8Array(700);
+    for (;;) {
+      const n = await channel.read(target);
+      if (n === 0) break;
+      received.push(...target.subarray(0, n));
+    }
+
+    expect(await writing).toBe(true);
+    expect(new Uint8Array(received)).toEqual(data);
+  });
+
+  it('stops writers once the reader cancels', async () => {
+    const channel = new ByteChannel(1024);
+    const writing = channel.write(new Uint8Array(4096));
+    channel.cancel();
+
+    expect(await writing).toBe(false);
+    expect(channel.cancelled).toBe(true);
+    expect(channel.tryWrite(new Uint8Array(1))).toBe(0);
+  });
+});
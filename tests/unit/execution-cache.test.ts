@@ -0,0 +1,100 @@
+/**
+ * Unit tests for the execution cache of deterministic WASM tools
+ *
+ * IndexedDB access is mocked through storageManager.
+ */
+import { describe, it, expect, vi, beforeEach } from 'vitest';
+
+vi.mock('../../src/storage', () => ({
+  storageManager: {
+    getExecutionResult: vi.fn(),
+    saveExecutionResult: vi.fn(),
+    pruneExecutionResults: vi.fn(),
+    clearExecutionResults: vi.fn(),
+  },
+}));
+
+import { storageManager } from '../../src/storage';
+import { ExecutionCache, hashExecutionInputs } from '../../src/toolResultCache';
+
+const mockGet = vi.mocked(storageManager.getExecutionResult);
+const mockSave = vi.mocked(storageManager.saveExecutionResult);
+const mockPrune = vi.mocked(storageManager.pruneExecutionResults);
+
+function output(stdout: string) {
+  return { exitCode: 0, stdout, stderr: '' };
+}
+
+describe('hashExecutionInputs', () => {
+  it('is stable for equal inputs, whatever their buffer', async () => {
+    const a = await hashExecutionInputs(['tool', 'args', new TextEncoder().encode('stdin')]);
+    const b = await hashExecutionInputs(['tool', 'args', new TextEncoder().encode('stdin').buffer]);
+    expect(a).toBe(b);
+    expect(a).toMatch(/^[0-9a-f]{64}$/);
+  });
+
+  it('tells apart inputs that concatenate to the same bytes', async () => {
+    const a = await hashExecutionInputs(['ab', 'c']);
+    const b = await hashExecutionInputs(['a', 'bc']);
+    const c = await hashExecutionInputs(['abc', undefined]);
+    const d = await hashExecutionInputs(['abc', '']);
+    expect(new Set([a, b, c, d]).size).toBe(4);
+  });
+});
+
+describe('ExecutionCache', () => {
+  beforeEach(() => {
+    mockGet.mockReset().mockResolvedValue(null);
+    mockSave.mockReset().mockResolvedValue(undefined);
+    mockPrune.mockReset().mockResolvedValue(undefined);
+  });
+
+  it('returns stored executions and counts hits and misses', async () => {
+    const cache = new ExecutionCache();
+    expect(await cache.get('k')).toBeUndefined();
+
+    cache.set('k', 'wc', output('3\n'));
+    expect(await cache.get('k')).toEqual(output('3\n'));
+    expect(cache.getStats()).toMatchObject({ size: 1, hits: 1, misses: 1 });
+    expect(mockSave).not.toHaveBeenCalled();
+  });
+
+  it('evicts the least recently used outputs by size', async () => {
+    // Room for two 10-character outputs (UTF-16)
+    const cache = new ExecutionCache(40);
+    cache.set('a', 'tr', output('a'.repeat(10)));
+    cache.set('b', 'tr', output('b'.repeat(10)));
+    await cache.get('a');
+    cache.set('c', 'tr', output('c'.repeat(10)));
+
+    expect(await cache.get('b')).toBeUndefined();
+    expect(await cache.get('a')).toEqual(output('a'.repeat(10)));
+    expect(await cache.get('c')).toEqual(output('c'.repeat(10)));
+    expect(cache.getStats().bytes).toBe(40);
+  });
+
+  it('does not cache outputs larger than the cache', async () => {
+    const cache = new ExecutionCache(10);
+    cache.set('big', 'sort', output('x'.repeat(100)));
+    expect(await cache.get('big')).toBeUndefined();
+    expect(cache.getStats().size).toBe(0);
+  });
+
+  it('persists to IndexedDB and prunes it when asked', async () => {
+    const cache = new ExecutionCache(1024, 4096);
+    cache.set('k', 'yq', output('a: 1\n'), { persist: true });
+    await vi.waitFor(() => expect(mockPrune).toHaveBeenCalledWith(4096));
+    expect(mockSave.mock.calls[0]![0]).toMatchObject({ key: 'k', toolName: 'yq', execution: output('a: 1\n') });
+  });
+
+  it('loads persisted executions into memory', async () => {
+    mockGet.mockResolvedValue({ key: 'k', toolName: 'yq', execution: output('a: 1\n'), byteSize: 10, usedAt: 0 });
+    const cache = new ExecutionCache();
+
+    expect(await cache.get('k')).toBeUndefined();
+    expect(await cache.get('k', { persist: true })).toEqual(output('a: 1\n'));
+    mockGet.mockReset();
+    expect(await cache.get('k')).toEqual(output('a: 1\n'));
+    expect(mockGet).not.toHaveBeenCalled();
+  });
+});
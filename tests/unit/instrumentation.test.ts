@@ -0,0 +1,135 @@
+/**
+ * Unit tests for WASI execution instrumentation and trace export
+ *
+ * The recorder is driven directly with a WebAssembly.Memory and host
+ * functions standing in for the runtimes' WASI imports.
+ */
+import { describe, it, expect } from 'vitest';
+import { ExecutionRecorder } from '../../src/wasm-tools/instrumentation';
+import { traceStore, toTraceEvents } from '../../src/wasm-tools/trace-store';
+import { MAX_TRACE_GROWTH_EVENTS } from '../../src/wasm-tools/worker-types';
+
+const PAGE = 65536;
+
+type Host = (...args: unknown[]) => number;
+
+/** Instrumented fd_write/fd_read/random_get over `memory` */
+function setup(memory: WebAssembly.Memory) {
+  const recorder = new ExecutionRecorder();
+  const imports = recorder.instrument({
+    wasi_snapshot_preview1: {
+      // Reports `len` bytes transferred through the out-parameter
+      fd_write: (_fd: number, len: number, _iovsLen: number, nwrittenPtr: number) => {
+        new DataView(memory.buffer).setUint32(nwrittenPtr, len, true);
+        return 0;
+      },
+      fd_read: () => 8, // BADF: no bytes counted
+      random_get: () => 0,
+      proc_exit: () => {
+        throw new Error('exit');
+      },
+    },
+  });
+  const wasi = imports.wasi_snapshot_preview1 as Record<string, Host>;
+  return { recorder, wasi };
+}
+
+describe('ExecutionRecorder', () => {
+  it('counts calls and payload bytes per import', () => {
+    const memory = new WebAssembly.Memory({ initial: 1 });
+    const { recorder, wasi } = setup(memory);
+    recorder.attach(memory, 2, 1);
+
+    wasi.fd_write(1, 100, 1, 16);
+    wasi.fd_write(1, 28, 1, 16);
+    wasi.fd_read(0, 0, 1, 16);
+    wasi.random_get(0, 32);
+
+    const trace = recorder.finish();
+    expect(trace.syscalls.fd_write).toMatchObject({ calls: 2, bytes: 128 });
+    expect(trace.syscalls.fd_read).toMatchObject({ calls: 1, bytes: 0 });
+    expect(trace.syscalls.random_get).toMatchObject({ calls: 1, bytes: 32 });
+    expect(trace.syscalls.proc_exit).toBeUndefined();
+    expect(trace.compileMs).toBe(2);
+    expect(trace.instantiateMs).toBe(1);
+    expect(trace.hostMs).toBeGreaterThanOrEqual(0);
+    expect(trace.runMs).toBeGreaterThanOrEqual(trace.hostMs);
+  });
+
+  it('records calls that unwind, as proc_exit does', () => {
+    const memory = new WebAssembly.Memory({ initial: 1 });
+    const { recorder, wasi } = setup(memory);
+    recorder.attach(memory, 0, 0);
+
+    expect(() => wasi.proc_exit(0)).toThrow('exit');
+    expect(recorder.finish().syscalls.proc_exit.calls).toBe(1);
+  });
+
+  it('observes memory growth at host calls and at finish', () => {
+    const memory = new WebAssembly.Memory({ initial: 1 });
+    const { recorder, wasi } = setup(memory);
+    recorder.attach(memory, 0, 0);
+
+    memory.grow(1);
+    wasi.random_get(0, 1);
+    wasi.random_get(0, 1);
+    memory.grow(2);
+
+    const trace = recorder.finish();
+    expect(trace.initialMemoryBytes).toBe(PAGE);
+    expect(trace.peakMemoryBytes).toBe(4 * PAGE);
+    expect(trace.memoryGrowth.map((g) => g.bytes)).toEqual([2 * PAGE, 4 * PAGE]);
+  });
+
+  it('caps the number of growth events kept', () => {
+    const memory = new WebAssembly.Memory({ initial: 1 });
+    const { recorder, wasi } = setup(memory);
+    recorder.attach(memory, 0, 0);
+
+    for (let i = 0; i < MAX_TRACE_GROWTH_EVENTS + 10; i++) {
+      memory.grow(1);
+      wasi.random_get(0, 1);
+    }
+
+    const trace = recorder.finish();
+    expect(trace.memoryGrowth).toHaveLength(MAX_TRACE_GROWTH_EVENTS);
+    expect(trace.peakMemoryBytes).toBe((MAX_TRACE_GROWTH_EVENTS + 11) * PAGE);
+  });
+
+  it('returns an empty trace when the module never started', () => {
+    const trace = new ExecutionRecorder().finish();
+    expect(trace).toMatchObject({ compileMs: 0, instantiateMs: 0, runMs: 0, peakMemoryBytes: 0, syscalls: {} });
+  });
+});
+
+describe('toTraceEvents', () => {
+  it('lays out phases and memory on one track per execution', () => {
+    const trace = {
+      compileMs: 1,
+      instantiateMs: 2,
+      runMs: 10,
+      hostMs: 4,
+      syscalls: { fd_write: { calls: 3, bytes: 300, ms: 4 } },
+      initialMemoryBytes: PAGE,
+      peakMemoryBytes: 2 * PAGE,
+      memoryGrowth: [{ atMs: 5, bytes: 2 * PAGE }],
+    };
+    const first = traceStore.get(traceStore.store('wc', { input: 'x'.repeat(1000) }, 1000, trace))!;
+    const second = traceStore.get(traceStore.store('sort', {}, 1500, trace))!;
+    expect(first.input.input).toMatch(/… \(1000 chars\)$/);
+
+    const { traceEvents } = toTraceEvents([first, second]);
+    const track = (tid: number) => traceEvents.filter((e) => e.tid === tid && e.ph !== 'M');
+
+    expect(track(1).map((e) => [e.name, e.ts, e.dur])).toEqual([
+      ['compile', 0, 1000],
+      ['instantiate', 1000, 2000],
+      ['run', 3000, 10000],
+      ['wc #1 memory', 3000, undefined],
+      ['wc #1 memory', 8000, undefined],
+    ]);
+    expect(track(2)[0].ts).toBe(500000);
+    expect(track(1)[2].args?.syscalls).toEqual(trace.syscalls);
+    expect(traceEvents.find((e) => e.ph === 'M' && e.tid === 2)?.args).toEqual({ name: 'sort #2' });
+  });
+});
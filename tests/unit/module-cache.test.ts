@@ -0,0 +1,97 @@
+/**
+ * Unit tests for the compiled WASM module cache
+ *
+ * Uses the smallest valid WebAssembly binary (just the header) so the
+ * real WebAssembly.compile() runs; IndexedDB access is mocked through
+ * storageManager.
+ */
+import { describe, it, expect, vi, beforeEach } from 'vitest';
+
+vi.mock('../../src/storage', () => ({
+  storageManager: {
+    getCompiledModule: vi.fn(),
+    saveCompiledModule: vi.fn(),
+    clearCompiledModules: vi.fn(),
+  },
+}));
+
+import { storageManager } from '../../src/storage';
+import { WasmModuleCache } from '../../src/wasm-tools/module-cache';
+
+const mockGet = vi.mocked(storageManager.getCompiledModule);
+const mockSave = vi.mocked(storageManager.saveCompiledModule);
+
+/** Empty module: "\0asm" magic + version 1 */
+function emptyModuleBinary(): ArrayBuffer {
+  return new Uint8Array([0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00]).buffer;
+}
+
+describe('WasmModuleCache', () => {
+  beforeEach(() => {
+    mockGet.mockReset().mockResolvedValue(null);
+    mockSave.mockReset().mockResolvedValue(undefined);
+  });
+
+  it('compiles on first use and serves later calls from memory', async () => {
+    const cache = new WasmModuleCache();
+    const binary = emptyModuleBinary();
+
+    const first = await cache.get(binary);
+    expect(first.source).toBe('compiled');
+    expect(first.module).toBeInstanceOf(WebAssembly.Module);
+
+    const second = await cache.get(binary);
+    expect(second.source).toBe('memory');
+    expect(second.module).toBe(first.module);
+  });
+
+  it('keys modules by content, not by buffer identity', async () => {
+    const cache = new WasmModuleCache();
+    const first = await cache.get(emptyModuleBinary());
+    const second = await cache.get(emptyModuleBinary());
+
+    expect(second.source).toBe('memory');
+    expect(second.module).toBe(first.module);
+    expect(cache.size).toBe(1);
+  });
+
+  it('shares one compilation between concurrent cold starts', async () => {
+    const cache = new WasmModuleCache();
+    const compileSpy = vi.spyOn(WebAssembly, 'compile');
+    const binary = emptyModuleBinary();
+
+    const [a, b] = await Promise.all([cache.get(binary), cache.get(binary)]);
+    expect(a.module).toBe(b.module);
+    expect(compileSpy).toHaveBeenCalledTimes(1);
+    compileSpy.mockRestore();
+  });
+
+  it('uses a persisted module when IndexedDB has one', async () => {
+    const module = await WebAssembly.compile(emptyModuleBinary());
+    mockGet.mockResolvedValue({ key: 'k', module, createdAt: 0 });
+
+    const cache = new WasmModuleCache();
+    const result = await cache.get(emptyModuleBinary());
+    expect(result.source).toBe('persisted');
+    expect(result.module).toBe(module);
+    expect(mockSave).not.toHaveBeenCalled();
+  });
+
+  it('stops touching IndexedDB after a failed write', async () => {
+    mockSave.mockRejectedValue(new DOMException('cannot clone', 'DataCloneError'));
+    const cache = new WasmModuleCache();
+
+    await cache.get(emptyModuleBinary());
+    // Let the fire-and-forget persist() settle
+    await new Promise((resolve) => setTimeout(resolve, 0));
+    expect(mockSave).toHaveBeenCalledTimes(1);
+
+    // A different binary (header + empty custom section "no") misses
+    // memory but must not query IndexedDB again
+    const other = new Uint8Array([0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x00, 0x03, 0x02, 0x6e, 0x6f]).buffer;
+    mockGet.mockClear();
+    const result = await cache.get(other);
+    expect(result.source).toBe('compiled');
+    expect(mockGet).not.toHaveBeenCalled();
+  });
+});
@@ -0,0 +1,228 @@
+/**
+ * Unit tests for parallel grep over project files
+ *
+ * The Worker manager is replaced by a fake grep that implements the
+ * options parallel-grep.ts passes to shards (--paths, --label,
+ * --withFilename, --lineOffset) with substring matching, so merged
+ * results can be compared with a search of the whole input.
+ */
+import { describe, it, expect, vi, beforeEach } from 'vitest';
+import type { WorkerManagerExecutionOptions } from '../../src/wasm-tools/worker-manager';
+
+vi.mock('../../src/wasm-tools/worker-manager', () => ({
+  MAX_PARALLEL_WORKERS: 4,
+  wasmWorkerManager: {
+    execute: vi.fn(),
+  },
+}));
+
+import { wasmWorkerManager } from '../../src/wasm-tools/worker-manager';
+import {
+  LARGE_FILE_BYTES,
+  expandSearchPaths,
+  planSearchShards,
+  runParallelSearch,
+} from '../../src/wasm-tools/parallel-grep';
+import type { SearchFile, SearchOutput } from '../../src/wasm-tools/parallel-grep';
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+function flag(args: string[], name: string): string | undefined {
+  const index = args.indexOf(name);
+  return index >= 0 ? args[index + 1] : undefined;
+}
+
+/** grep over one input, as grep/main.c's search_input() prints it */
+function searchText(args: string[], name: string, text: string): { out: string; selected: number } {
+  const pattern = flag(args, '--pattern')!;
+  const withFilename = args.includes('--withFilename');
+  const maxCount = Number(flag(args, '--maxCount') ?? Infinity);
+  const offset = Number(flag(args, '--lineOffset') ?? 0);
+  const prefix = withFilename ? `${name}:` : '';
+
+  let out = '';
+  let selected = 0;
+  const lines = text.split('\n');
+  if (lines[lines.length - 1] === '') lines.pop();
+  for (let i = 0; i < lines.length && selected < maxCount; i++) {
+    if (!lines[i]!.includes(pattern)) continue;
+    selected++;
+    if (!args.includes('--count') && !args.includes('--filesWithMatches')) {
+      out += `${prefix}${args.includes('--lineNumbers') ? `${offset + i + 1}:` : ''}${lines[i]}\n`;
+    }
+  }
+  if (args.includes('--filesWithMatches')) out = selected > 0 ? `${name}\n` : '';
+  if (args.includes('--count')) out = `${prefix}${selected}\n`;
+  return { out, selected };
+}
+
+function fakeGrep(args: string[], options: WorkerManagerExecutionOptions) {
+  let stdout = '';
+  let stderr = '';
+  let matched = false;
+  let failed = false;
+  const paths = args.flatMap((arg, i) => (arg === '--paths' ? [args[i + 1]!] : []));
+  const inputs = paths.length > 0
+    ? paths.map((path) => [path, options.filesBinary?.[path]] as const)
+    : [[flag(args, '--label') ?? '(standard input)', options.stdinBinary] as const];
+
+  for (const [name, data] of inputs) {
+    if (!data) {
+      stderr += `grep: ${name}: No such file or directory\n`;
+      failed = true;
+      continue;
+    }
+    const { out, selected } = searchText(args, name, textDecoder.decode(data));
+    stdout += out;
+    matched ||= selected > 0;
+  }
+  return { exitCode: failed ? 2 : matched ? 0 : 1, stdout, stderr };
+}
+
+function file(path: string, text: string): SearchFile {
+  return { path, data: textEncoder.encode(text).buffer as ArrayBuffer };
+}
+
+/** A file over LARGE_FILE_BYTES: numbered lines, every 1000th containing "needle" */
+function largeFile(path: string): { file: SearchFile; text: string } {
+  const lines: string[] = [];
+  let size = 0;
+  for (let i = 0; size <= LARGE_FILE_BYTES + 1000; i++) {
+    const line = `line ${i}${i % 1000 === 0 ? ' needle' : ''} ${'x'.repeat(50)}`;
+    lines.push(line);
+    size += line.length + 1;
+  }
+  const text = `${lines.join('\n')}\n`;
+  return { file: file(path, text), text };
+}
+
+function output(overrides: Partial<SearchOutput> = {}): SearchOutput {
+  return {
+    count: false,
+    filesWithMatches: false,
+    onlyMatching: false,
+    lineNumbers: false,
+    withFilename: true,
+    ...overrides,
+  };
+}
+
+function search(args: string[], out: SearchOutput, files: SearchFile[]) {
+  return runParallelSearch(
+    { wasm: new ArrayBuffer(0), args: ['grep', ...args], sharedFiles: {}, timeout: 1000, output: out },
+    files
+  );
+}
+
+describe('expandSearchPaths', () => {
+  const entries = [
+    { path: 'src', kind: 'directory' as const },
+    { path: 'src/b.ts', kind: 'file' as const },
+    { path: 'src/a.ts', kind: 'file' as const },
+    { path: 'src/lib', kind: 'directory' as const },
+    { path: 'src/lib/c.ts', kind: 'file' as const },
+    { path: 'README.md', kind: 'file' as const },
+  ];
+
+  it('expands directories in path order when recursive', () => {
+    expect(expandSearchPaths(['/src/'], true, entries)).toEqual(['src/a.ts', 'src/b.ts', 'src/lib/c.ts']);
+    expect(expandSearchPaths(['.'], true, entries)).toEqual(['README.md', 'src/a.ts', 'src/b.ts', 'src/lib/c.ts']);
+  });
+
+  it('keeps files and unknown paths in order without duplicates', () => {
+    expect(expandSearchPaths(['README.md', 'src/lib', 'missing', 'README.md'], true, entries))
+      .toEqual(['README.md', 'src/lib/c.ts', 'missing']);
+    expect(expandSearchPaths(['src', 'README.md'], false, entries)).toEqual(['src', 'README.md']);
+  });
+});
+
+describe('planSearchShards', () => {
+  it('groups small files in order', () => {
+    const files = ['a', 'b', 'c'].map((name) => file(name, 'text\n'));
+    const shards = planSearchShards(files, 4);
+    expect(shards).toEqual([{ kind: 'files', files }]);
+  });
+
+  it('splits large files into line-aligned chunks with line offsets', () => {
+    const { file: large, text } = largeFile('big.log');
+    const shards = planSearchShards([file('a', 'x\n'), large, file('z', 'y\n')], 4, { lineNumbers: true });
+
+    expect(shards.map((s) => s.kind)).toEqual(['files', 'chunk', 'chunk', 'chunk', 'chunk', 'files']);
+    let lineOffset = 0;
+    let rejoined = '';
+    for (const shard of shards.slice(1, 5)) {
+      if (shard.kind !== 'chunk') continue;
+      const chunk = textDecoder.decode(shard.data);
+      expect(chunk.endsWith('\n')).toBe(true);
+      expect(shard.lineOffset).toBe(lineOffset);
+      lineOffset += chunk.split('\n').length - 1;
+      rejoined += chunk;
+    }
+    expect(rejoined).toBe(text);
+  });
+
+  it('does not split files for a single worker', () => {
+    const { file: large } = largeFile('big.log');
+    expect(planSearchShards([large], 1)).toEqual([{ kind: 'files', files: [large] }]);
+  });
+});
+
+describe('runParallelSearch', () => {
+  beforeEach(() => {
+    vi.mocked(wasmWorkerManager.execute).mockReset().mockImplementation(
+      async (_wasm, args, options = {}) => fakeGrep(args, options)
+    );
+  });
+
+  it('matches a single search of every file', async () => {
+    const { file: large, text } = largeFile('big.log');
+    const small = file('notes.txt', 'a needle\nhay\n');
+    const args = ['--pattern', 'needle', '--lineNumbers'];
+
+    const result = await search(args, output({ lineNumbers: true }), [small, large]);
+    const expected = searchText([...args, '--withFilename'], 'notes.txt', 'a needle\nhay\n').out +
+      searchText([...args, '--withFilename'], 'big.log', text).out;
+
+    expect(result.exitCode).toBe(0);
+    expect(result.stdout).toBe(expected);
+    expect(vi.mocked(wasmWorkerManager.execute).mock.calls.length).toBeGreaterThan(2);
+  });
+
+  it('sums counts across the chunks of a file', async () => {
+    const { file: large, text } = largeFile('big.log');
+    const result = await search(['--pattern', 'needle', '--count'], output({ count: true }), [large]);
+    expect(result.stdout).toBe(`big.log:${searchText(['--pattern', 'needle'], 'big.log', text).selected}\n`);
+  });
+
+  it('stops at maxCount across chunks', async () => {
+    const { file: large } = largeFile('big.log');
+    const result = await search(
+      ['--pattern', 'line', '--maxCount', '3'],
+      output({ maxCount: 3, withFilename: false }),
+      [large]
+    );
+    expect(result.stdout.split('\n').filter(Boolean)).toHaveLength(3);
+    expect(result.stdout.startsWith('line 0 needle')).toBe(true);
+    // The first chunk settles the file; the others are cancelled
+    const signal = vi.mocked(wasmWorkerManager.execute).mock.calls[0]![2]!.signal!;
+    expect(signal.aborted).toBe(true);
+  });
+
+  it('lists a chunked file once', async () => {
+    const { file: large } = largeFile('big.log');
+    const result = await search(
+      ['--pattern', 'needle', '--filesWithMatches'],
+      output({ filesWithMatches: true }),
+      [large, file('none.txt', 'hay\n')]
+    );
+    expect(result.stdout).toBe('big.log\n');
+  });
+
+  it('reports unreadable files and exits with 2', async () => {
+    const result = await search(['--pattern', 'needle'], output(), [{ path: 'gone.txt' }, file('a', 'needle\n')]);
+    expect(result.exitCode).toBe(2);
+    expect(result.stdout).toBe('a:needle\n');
+    expect(result.stderr).toMatch(/gone\.txt/);
+  });
+});
@@ -0,0 +1,188 @@
+/**
+ * Unit tests for the streaming WASM pipeline
+ *
+ * The Worker manager is replaced by fake stages that talk to their
+ * ByteChannels the way wasm-worker.ts does: write stdout to the outgoing
+ * channel, exit with EXIT_BROKEN_PIPE once it is cancelled, and release
+ * both channels when done.
+ */
+import { describe, it, expect, vi, beforeEach } from 'vitest';
+import type { ByteChannel } from '../../src/wasm-tools/byte-channel';
+import type { WorkerManagerExecutionOptions } from '../../src/wasm-tools/worker-manager';
+
+vi.mock('../../src/wasm-tools/worker-manager', () => ({
+  wasmWorkerManager: {
+    prewarm: vi.fn(),
+    execute: vi.fn(),
+  },
+}));
+
+import { wasmWorkerManager } from '../../src/wasm-tools/worker-manager';
+import { runStreamingPipeline } from '../../src/wasm-tools/pipeline';
+import type { PreparedStage } from '../../src/wasm-tools/pipeline';
+import { EXIT_BROKEN_PIPE } from '../../src/wasm-tools/worker-types';
+import {
+  planPipeline,
+  registerPipelineExecutor,
+} from '../../src/pipeable';
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+interface FakeIo {
+  read: () => Promise<string | null>;
+  write: (text: string) => Promise<boolean>;
+}
+
+type FakeTool = (io: FakeIo, args: string[]) => Promise<number>;
+
+/** Run a fake tool against the channels/stdin it was given */
+async function runFake(tool: FakeTool, args: string[], options: WorkerManagerExecutionOptions) {
+  const stdinChannel = options.stdinChannel as ByteChannel | undefined;
+  const stdoutChannel = options.stdoutChannel as ByteChannel | undefined;
+  let stdinText: string | null = options.stdin ?? null;
+  let stdout = '';
+  const buffer = new Uint8Array(64);
+
+  const io: FakeIo = {
+    read: async () => {
+      if (stdinChannel) {
+        const n = await stdinChannel.read(buffer);
+        return n === 0 ? null : textDecoder.decode(buffer.subarray(0, n));
+      }
+      const text = stdinText;
+      stdinText = null;
+      return text;
+    },
+    write: async (text) => {
+      if (stdoutChannel) return stdoutChannel.write(textEncoder.encode(text));
+      stdout += text;
+      return true;
+    },
+  };
+
+  const exitCode = await tool(io, args);
+  stdoutChannel?.close();
+  stdinChannel?.cancel();
+  return { exitCode, stdout, stderr: exitCode && exitCode !== EXIT_BROKEN_PIPE ? 'boom' : '' };
+}
+
+const tools: Record<string, FakeTool> = {
+  // Endless output, like `yes`
+  yes: async (io) => {
+    for (;;) {
+      if (!(await io.write('y\n'.repeat(64)))) return EXIT_BROKEN_PIPE;
+    }
+  },
+  upper: async (io) => {
+    for (let chunk = await io.read(); chunk !== null; chunk = await io.read()) {
+      if (!(await io.write(chunk.toUpperCase()))) return EXIT_BROKEN_PIPE;
+    }
+    return 0;
+  },
+  head: async (io, args) => {
+    const limit = Number(args[0]);
+    let pending = '';
+    let lines = 0;
+    for (let chunk = await io.read(); chunk !== null && lines < limit; chunk = await io.read()) {
+      pending += chunk;
+      let newline: number;
+      while (lines < limit && (newline = pending.indexOf('\n')) >= 0) {
+        await io.write(pending.slice(0, newline + 1));
+        pending = pending.slice(newline + 1);
+        lines++;
+      }
+    }
+    return 0;
+  },
+  fail: async () => 2,
+};
+
+function stage(tool: string, ...args: string[]): PreparedStage {
+  return { name: tool, wasm: new ArrayBuffer(0), args: [tool, ...args], timeout: 1000 };
+}
+
+describe('runStreamingPipeline', () => {
+  beforeEach(() => {
+    vi.mocked(wasmWorkerManager.execute).mockReset().mockImplementation(
+      async (_wasm, args, options = {}) => runFake(tools[args[0]!]!, args.slice(1), options)
+    );
+  });
+
+  it('streams stdin through every stage', async () => {
+    const result = await runStreamingPipeline(
+      [stage('upper'), stage('head', '2')],
+      'one\ntwo\nthree\n',
+      1024
+    );
+    expect(result.success).toBe(true);
+    expect(result.stdout).toBe('ONE\nTWO\n');
+  });
+
+  it('connects stages with channels and only buffers the last stdout', async () => {
+    await runStreamingPipeline([stage('upper'), stage('upper'), stage('head', '1')], 'x\n', 1024);
+
+    const calls = vi.mocked(wasmWorkerManager.execute).mock.calls.map((call) => call[2]!);
+    expect(calls[0]!.stdin).toBe('x\n');
+    expect(calls[0]!.stdoutChannel).toBe(calls[1]!.stdinChannel);
+    expect(calls[1]!.stdoutChannel).toBe(calls[2]!.stdinChannel);
+    expect(calls[2]!.stdoutChannel).toBeUndefined();
+  });
+
+  it('stops an endless producer once head has enough', async () => {
+    const result = await runStreamingPipeline(
+      [stage('yes'), stage('upper'), stage('head', '3')],
+      undefined,
+      1024
+    );
+    expect(result.success).toBe(true);
+    expect(result.stdout).toBe('Y\nY\nY\n');
+    expect(result.stages.map((s) => ('exitCode' in s ? s.exitCode : -1)))
+      .toEqual([EXIT_BROKEN_PIPE, EXIT_BROKEN_PIPE, 0]);
+  });
+
+  it('reports the stage that failed rather than the broken pipes upstream', async () => {
+    const result = await runStreamingPipeline([stage('yes'), stage('fail')], undefined, 1024);
+    expect(result.success).toBe(false);
+    expect(result.failedStage).toBe(1);
+  });
+});
+
+describe('planPipeline', () => {
+  const streamable = new Set(['grep', 'sort', 'head']);
+
+  beforeEach(() => {
+    registerPipelineExecutor({
+      canStream: (s) => streamable.has(s.tool),
+      execute: async () => ({ success: true, output: '' }),
+    });
+  });
+
+  it('groups runs of streamable commands', () => {
+    const segments = planPipeline([
+      { tool: 'cat', args: {} },
+      { tool: 'grep', args: {} },
+      { tool: 'sort', args: {} },
+      { tool: 'head', args: {} },
+    ]);
+    expect(segments.map((s) => s.kind)).toEqual(['single', 'stream']);
+    expect(segments[1]).toMatchObject({ kind: 'stream', index: 1 });
+  });
+
+  it('runs a lone streamable command on its own', () => {
+    const segments = planPipeline([
+      { tool: 'grep', args: {} },
+      { tool: 'write_file', args: {} },
+    ]);
+    expect(segments.map((s) => s.kind)).toEqual(['single', 'single']);
+  });
+
+  it('streams nothing without an executor', () => {
+    registerPipelineExecutor(null);
+    const segments = planPipeline([
+      { tool: 'grep', args: {} },
+      { tool: 'sort', args: {} },
+    ]);
+    expect(segments.every((s) => s.kind === 'single')).toBe(true);
+  });
+});
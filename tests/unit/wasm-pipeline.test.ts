@@ -6,7 +6,11 @@
  * are formatted properly for each argStyle.
  */
 import { describe, it, expect } from 'vitest';
-import { convertArgsToCliFormat, findBinaryParam } from '../../src/wasm-tools/manager';
+import {
+  collectFileParamPaths,
+  convertArgsToCliFormat,
+  findBinaryParam,
+} from '../../src/wasm-tools/manager';
 import { sanitizeExecutionOptions } from '../../src/wasm-tools/worker-types';
 import { VirtualFileSystem } from '../../src/wasm-tools/vfs';
 import type { WasmToolManifest } from '../../src/wasm-tools/types';
@@ -197,6 +201,29 @@ describe('convertArgsToCliFormat', () => {
       expect(result.cliArgs).toEqual(['tool', 'hello']);
     });
 
+    it('expands array params into separate args', () => {
+      const manifest = makeManifest({
+        name: 'tool',
+        parameters: {
+          type: 'object',
+          properties: {
+            paths: { type: 'array', items: { type: 'string' }, description: 'paths' },
+          },
+          required: ['paths'],
+        },
+        execution: {
+          argStyle: 'positional',
+          fileAccess: 'none',
+        },
+      });
+
+      const result = convertArgsToCliFormat(manifest, {
+        paths: ['a.txt', 'b.txt'],
+      });
+
+      expect(result.cliArgs).toEqual(['tool', 'a.txt', 'b.txt']);
+    });
+
     it('handles stdinParam that is in the middle of required list', () => {
       const manifest = makeManifest({
         name: 'sed',
@@ -363,6 +390,33 @@ describe('convertArgsToCliFormat', () => {
       expect(result.cliArgs).toEqual(['head', '--n', '2']);
       expect(result.stdin).toBe('line1\nline2\nline3');
     });
+
+    it('repeats the option for each element of an array', () => {
+      const manifest = makeManifest({
+        name: 'sha256sum',
+        parameters: {
+          type: 'object',
+          properties: {
+            files: { type: 'array', items: { type: 'string' }, description: 'files' },
+            tag: { type: 'boolean', description: 'tag' },
+          },
+        },
+        execution: {
+          argStyle: 'cli',
+          fileAccess: 'read',
+          fileParams: ['files'],
+        },
+      });
+
+      const result = convertArgsToCliFormat(manifest, {
+        files: ['a.txt', 'dir/b.bin'],
+        tag: true,
+      });
+
+      expect(result.cliArgs).toEqual([
+        'sha256sum', '--files', 'a.txt', '--files', 'dir/b.bin', '--tag',
+      ]);
+    });
   });
 
   // -------------------------------------------------------------------------
@@ -659,6 +713,52 @@ describe('convertArgsToCliFormat', () => {
   });
 });
 
+// ===========================================================================
+// collectFileParamPaths
+// ===========================================================================
+
+describe('collectFileParamPaths', () => {
+  const manifest = makeManifest({
+    name: 'md5sum',
+    parameters: {
+      type: 'object',
+      properties: {
+        input: { type: 'string', description: 'text' },
+        files: { type: 'array', items: { type: 'string' }, description: 'files' },
+        list: { type: 'string', description: 'list file' },
+      },
+    },
+    execution: {
+      argStyle: 'cli',
+      fileAccess: 'read',
+      stdinParam: 'input',
+      fileParams: ['list', 'files'],
+    },
+  });
+
+  it('collects paths from string and array params in order', () => {
+    expect(collectFileParamPaths(manifest, {
+      input: 'not a path',
+      files: ['a.txt', 'b.txt'],
+      list: 'sums.txt',
+    })).toEqual(['sums.txt', 'a.txt', 'b.txt']);
+  });
+
+  it('strips leading slashes and drops duplicates and blanks', () => {
+    expect(collectFileParamPaths(manifest, {
+      files: ['/a.txt', 'a.txt', ' ', 'dir/b.txt'],
+    })).toEqual(['a.txt', 'dir/b.txt']);
+  });
+
+  it('returns nothing for tools without fileParams', () => {
+    const plain = makeManifest({
+      ...manifest,
+      execution: { argStyle: 'cli', fileAccess: 'none' },
+    });
+    expect(collectFileParamPaths(plain, { files: ['a.txt'] })).toEqual([]);
+  });
+});
+
 // ===========================================================================
 // sanitizeExecutionOptions
 // ===========================================================================
@@ -16,6 +16,7 @@ import { execSync } from 'node:child_process';
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = dirname(__filename);
 import { buildCspHeaderForProvider, isWasmWorkerRequest } from './server/csp';
+import { crossOriginIsolationHeaders } from './server/isolation';
 import { parseCookies, PROVIDER_COOKIE_NAME } from './server/providers';
 
 // Read version from package.json
@@ -342,6 +343,12 @@ export default defineConfig({
     port: 3000,
     // CSP is set dynamically per-request by dynamicCspPlugin() based on
     // the user's selected provider cookie. See docs/models-csp-report.md.
+    // COOP/COEP make the page cross-origin isolated, as in production,
+    // so WASM pipelines can use SharedArrayBuffer. See server/isolation.ts.
+    headers: crossOriginIsolationHeaders,
+  },
+  preview: {
+    headers: crossOriginIsolationHeaders,
   },
   build: {
     target: 'es2022',
@@ -0,0 +1,325 @@
+/**
+ * Deterministic benchmark corpora
+ *
+ * Each kind of input is generated from a fixed seed, so a given kind and
+ * size produce the same bytes on every machine and every run. Corpora are
+ * written once to wasm-tools/.cache/bench/ and reused; bumping
+ * CORPUS_VERSION regenerates them after a generator changes.
+ *
+ * Text corpora are whole records (lines, XML elements, YAML entries, ...)
+ * with any header and footer, so structured formats stay valid; they are
+ * at most, and usually just under, the requested size.
+ */
+
+import { closeSync, existsSync, mkdirSync, openSync, readFileSync, renameSync, writeSync } from 'node:fs';
+import { join } from 'node:path';
+
+export const CORPUS_VERSION = 1;
+
+export type CorpusKind =
+  | 'log'
+  | 'csv'
+  | 'xml'
+  | 'yaml'
+  | 'toml'
+  | 'markdown'
+  | 'js'
+  | 'css'
+  | 'html'
+  | 'shell'
+  | 'paths'
+  | 'sizes'
+  | 'binary'
+  | 'base64';
+
+/** Named corpus sizes, from a tool's start-up cost up to bulk throughput */
+export const CORPUS_SIZES: Record<string, number> = {
+  '1KB': 1 << 10,
+  '64KB': 64 << 10,
+  '1MB': 1 << 20,
+  '16MB': 16 << 20,
+  '100MB': 100 << 20,
+  '500MB': 500 << 20,
+};
+
+/** mulberry32: small, fast and identical on every platform */
+class Random {
+  private state: number;
+
+  constructor(seed: number) {
+    this.state = seed >>> 0;
+  }
+
+  next(): number {
+    this.state = (this.state + 0x6d2b79f5) >>> 0;
+    let t = this.state;
+    t = Math.imul(t ^ (t >>> 15), t | 1);
+    t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+    return (t ^ (t >>> 14)) >>> 0;
+  }
+
+  int(n: number): number {
+    return this.next() % n;
+  }
+
+  pick<T>(items: readonly T[]): T {
+    return items[this.int(items.length)]!;
+  }
+
+  words(n: number): string {
+    const out: string[] = [];
+    for (let i = 0; i < n; i++) out.push(this.pick(WORDS));
+    return out.join(' ');
+  }
+}
+
+const WORDS = [
+  'alpha', 'bravo', 'cache', 'delta', 'engine', 'filter', 'gamma', 'header', 'index', 'join',
+  'kernel', 'lambda', 'module', 'network', 'object', 'parser', 'query', 'router', 'stream', 'token',
+  'update', 'vector', 'worker', 'buffer', 'yield', 'zone', 'session', 'request', 'config', 'value',
+] as const;
+const FIRST_NAMES = ['Ada', 'Grace', 'Linus', 'Ken', 'Barbara', 'Dennis', 'Margaret', 'Alan', 'Frances', 'Edsger'] as const;
+const LAST_NAMES = ['Lovelace', 'Hopper', 'Torvalds', 'Thompson', 'Liskov', 'Ritchie', 'Hamilton', 'Turing', 'Allen', 'Dijkstra'] as const;
+const CITIES = ['London', 'Paris', 'Berlin', 'Tokyo', 'Lagos', 'Lima', 'Oslo', 'Seoul', 'Austin', 'Zürich'] as const;
+const RESOURCES = ['users', 'orders', 'items', 'sessions', 'files', 'reports'] as const;
+const METHODS = ['GET', 'GET', 'GET', 'POST', 'PUT', 'DELETE'] as const;
+const ERRORS = ['connection refused', 'timeout after 30s', 'upstream reset', 'invalid token', 'disk full'] as const;
+const DIRS = ['src', 'lib', 'components', 'utils', 'tests', 'docs', 'assets', 'core', 'api', 'styles'] as const;
+const EXTENSIONS = ['ts', 'js', 'css', 'md', 'json', 'png', 'c', 'h'] as const;
+
+/** A text corpus: optional header and footer around repeated records */
+interface TextGenerator {
+  header?: string;
+  record(rng: Random, i: number): string;
+  footer?: string;
+}
+
+function logLine(rng: Random, i: number): string {
+  const time = new Date(Date.UTC(2024, 0, 1) + i * 137).toISOString();
+  const roll = rng.int(100);
+  const level = roll < 3 ? 'ERROR' : roll < 10 ? 'WARN' : roll < 25 ? 'DEBUG' : 'INFO';
+  const status = level === 'ERROR' ? 500 : level === 'WARN' ? 404 : 200;
+  const error = level === 'ERROR' ? ` error="${rng.pick(ERRORS)}"` : '';
+  return `${time} ${level.padEnd(5)} [worker-${rng.int(32)}] ${rng.pick(METHODS)} /api/v1/${rng.pick(RESOURCES)}/${rng.int(100000)} ${status} ${rng.int(2000)}ms${error}\n`;
+}
+
+function path(rng: Random): string {
+  const depth = 1 + rng.int(5);
+  const parts: string[] = [];
+  for (let d = 0; d < depth; d++) parts.push(rng.pick(DIRS));
+  return `${parts.join('/')}/${rng.pick(WORDS)}-${rng.int(1000)}.${rng.pick(EXTENSIONS)}`;
+}
+
+const GENERATORS: Record<Exclude<CorpusKind, 'binary' | 'base64'>, TextGenerator> = {
+  log: { record: logLine },
+  csv: {
+    header: 'id,name,email,city,amount,date,status,note\n',
+    record: (rng, i) => {
+      const first = rng.pick(FIRST_NAMES);
+      const last = rng.pick(LAST_NAMES);
+      const note = rng.int(10) === 0 ? `"${rng.words(2)}, ${rng.words(2)}"` : rng.pick(WORDS);
+      return `${i},${first} ${last},${first.toLowerCase()}.${last.toLowerCase()}@example.com,${rng.pick(CITIES)},` +
+        `${(rng.int(1000000) / 100).toFixed(2)},2024-${String(1 + rng.int(12)).padStart(2, '0')}-` +
+        `${String(1 + rng.int(28)).padStart(2, '0')},${rng.pick(['open', 'paid', 'void'])},${note}\n`;
+    },
+  },
+  xml: {
+    header: '<?xml version="1.0" encoding="UTF-8"?>\n<catalog>\n',
+    record: (rng, i) =>
+      `  <item id="${i}" type="${rng.pick(RESOURCES)}">\n` +
+      `    <title>${rng.words(3)}</title>\n` +
+      `    <price currency="USD">${(rng.int(100000) / 100).toFixed(2)}</price>\n` +
+      `    <tags><tag>${rng.pick(WORDS)}</tag><tag>${rng.pick(WORDS)}</tag></tags>\n` +
+      '  </item>\n',
+    footer: '</catalog>\n',
+  },
+  yaml: {
+    header: 'items:\n',
+    record: (rng, i) =>
+      `  - id: ${i}\n` +
+      `    name: ${rng.pick(WORDS)}-${i}\n` +
+      `    enabled: ${rng.int(2) === 0}\n` +
+      `    score: ${rng.int(1000)}\n` +
+      `    tags: [${rng.pick(WORDS)}, ${rng.pick(WORDS)}]\n` +
+      '    owner:\n' +
+      `      city: ${rng.pick(CITIES)}\n`,
+  },
+  toml: {
+    header: 'title = "bench"\n\n',
+    record: (rng, i) =>
+      `[section${i}]\n` +
+      `name = "${rng.pick(WORDS)}"\n` +
+      `count = ${rng.int(100000)}\n` +
+      `enabled = ${rng.int(2) === 0}\n` +
+      `tags = ["${rng.pick(WORDS)}", "${rng.pick(WORDS)}"]\n\n`,
+  },
+  markdown: {
+    record: (rng, i) => {
+      const word = rng.pick(WORDS);
+      switch (i % 4) {
+        case 0:
+          return `## ${rng.words(3)} ${i}\n\n`;
+        case 1:
+          return `${rng.words(12)} **${word}** and *${rng.pick(WORDS)}* with \`${word}()\` and ` +
+            `[a link](https://example.com/${word}/${i}).\n\n`;
+        case 2:
+          return `- ${rng.words(4)}\n- ${rng.words(5)}\n  - ${rng.words(3)}\n\n`;
+        default:
+          return '```js\n' + `const ${word}${i} = ${rng.int(1000)};\n` + '```\n\n';
+      }
+    },
+  },
+  js: {
+    record: (rng, i) => {
+      const word = rng.pick(WORDS);
+      const limit = rng.int(100);
+      return `function ${word}Filter${i}(items, limit) {\n` +
+        `  // Keep the ${word} entries above the limit\n` +
+        '  const result = [];\n' +
+        '  for (let index = 0; index < items.length; index++) {\n' +
+        '    const value = items[index];\n' +
+        `    if (value.score > limit && value.name !== "${word}") {\n` +
+        '      result.push({ id: value.id, label: `' + word + '-${value.id}` });\n' +
+        '    }\n' +
+        '  }\n' +
+        `  return result.length > ${limit} ? result.slice(0, ${limit}) : result;\n` +
+        '}\n\n';
+    },
+  },
+  css: {
+    record: (rng, i) =>
+      `/* ${rng.words(3)} */\n` +
+      `.${rng.pick(WORDS)}-${i} > .${rng.pick(WORDS)} {\n` +
+      `  color: #${rng.int(0x1000000).toString(16).padStart(6, '0')};\n` +
+      `  margin: 0px 0px ${rng.int(40)}px 0px;\n` +
+      `  padding: ${rng.int(20)}px;\n` +
+      '}\n\n',
+  },
+  html: {
+    header: '<!DOCTYPE html>\n<html>\n<head>\n  <title>Bench</title>\n</head>\n<body>\n',
+    record: (rng, i) =>
+      `  <div class="card ${rng.pick(WORDS)}">\n` +
+      `    <h2 id="h-${i}">   ${rng.words(3)}   </h2>\n` +
+      `    <!-- card ${i} -->\n` +
+      `    <p>${rng.words(15)}</p>\n` +
+      `    <a href="/${rng.pick(WORDS)}/${i}">more</a>\n` +
+      '  </div>\n',
+    footer: '</body>\n</html>\n',
+  },
+  shell: {
+    record: (rng, i) => {
+      const word = rng.pick(WORDS);
+      return `if [ -f "/tmp/${word}${i}" ];then\n` +
+        `echo   "${rng.words(3)}"\n` +
+        'for f in a b c;do\n' +
+        'rm -f "$f"\n' +
+        'done\n' +
+        'fi\n';
+    },
+  },
+  paths: { record: (rng) => `${path(rng)}\n` },
+  sizes: { record: (rng) => `${rng.int(1 << 20)} ${path(rng)}\n` },
+};
+
+/** Seed per kind, so corpora of different kinds are unrelated */
+function seedFor(kind: CorpusKind): number {
+  let h = 0x811c9dc5;
+  for (let i = 0; i < kind.length; i++) h = Math.imul(h ^ kind.charCodeAt(i), 0x01000193);
+  return h >>> 0;
+}
+
+/** Buffered writes of generated text to a file descriptor */
+class ChunkWriter {
+  private parts: string[] = [];
+  private pending = 0;
+
+  constructor(private fd: number) {}
+
+  write(text: string): void {
+    this.parts.push(text);
+    this.pending += text.length;
+    if (this.pending >= 1 << 20) this.flush();
+  }
+
+  flush(): void {
+    if (this.parts.length === 0) return;
+    writeSync(this.fd, Buffer.from(this.parts.join('')));
+    this.parts = [];
+    this.pending = 0;
+  }
+}
+
+function generateText(fd: number, kind: Exclude<CorpusKind, 'binary' | 'base64'>, size: number): void {
+  const generator = GENERATORS[kind];
+  const rng = new Random(seedFor(kind));
+  const writer = new ChunkWriter(fd);
+  const header = generator.header ?? '';
+  const footer = generator.footer ?? '';
+  let used = Buffer.byteLength(header) + Buffer.byteLength(footer);
+
+  writer.write(header);
+  for (let i = 0; ; i++) {
+    const record = generator.record(rng, i);
+    const bytes = Buffer.byteLength(record);
+    if (used + bytes > size) break;
+    writer.write(record);
+    used += bytes;
+  }
+  writer.write(footer);
+  writer.flush();
+}
+
+function generateBinary(fd: number, kind: 'binary' | 'base64', size: number): void {
+  const rng = new Random(seedFor(kind));
+  const chunk = Buffer.alloc(1 << 20);
+  let written = 0;
+
+  while (written < size) {
+    if (kind === 'binary') {
+      const n = Math.min(chunk.length, size - written);
+      for (let i = 0; i < n; i += 4) chunk.writeUInt32LE(rng.next(), i);
+      writeSync(fd, chunk, 0, n);
+      written += n;
+    } else {
+      // 57 random bytes per 76-character line, as base64(1) wraps
+      const raw = Buffer.alloc(57);
+      const lines: string[] = [];
+      let n = 0;
+      while (n + 77 <= chunk.length && written + n + 77 <= size) {
+        for (let i = 0; i < 57; i++) raw[i] = rng.int(256);
+        lines.push(raw.toString('base64'));
+        n += 77;
+      }
+      if (n === 0) break;
+      writeSync(fd, Buffer.from(lines.join('\n') + '\n'));
+      written += n;
+    }
+  }
+}
+
+/**
+ * Return the corpus of the given kind and size, generating and caching it
+ * under cacheDir on first use.
+ */
+export function loadCorpus(cacheDir: string, kind: CorpusKind, sizeName: string): Buffer {
+  const size = CORPUS_SIZES[sizeName];
+  if (size === undefined) {
+    throw new Error(`Unknown corpus size "${sizeName}" (expected one of ${Object.keys(CORPUS_SIZES).join(', ')})`);
+  }
+
+  const file = join(cacheDir, `${kind}-${sizeName}.v${CORPUS_VERSION}`);
+  if (!existsSync(file)) {
+    mkdirSync(cacheDir, { recursive: true });
+    // Written under a temporary name so an interrupted run leaves no partial corpus
+    const partial = `${file}.partial`;
+    const fd = openSync(partial, 'w');
+    try {
+      if (kind === 'binary' || kind === 'base64') generateBinary(fd, kind, size);
+      else generateText(fd, kind, size);
+    } finally {
+      closeSync(fd);
+    }
+    renameSync(partial, file);
+  }
+  return readFileSync(file);
+}
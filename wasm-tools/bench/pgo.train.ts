@@ -0,0 +1,75 @@
+/**
+ * PGO training runs
+ *
+ * Runs an instrumented (-fprofile-generate) build of one tool over its
+ * cases in cases.ts, so that build.sh can rebuild the tool's pgo profile
+ * with the collected profile. Started by build.sh, not by hand:
+ *
+ *   PGO_BINARY       the instrumented .wasm
+ *   PGO_PROFILE_DIR  where the runs write their .profraw files
+ *   PGO_TOOL         the tool whose cases to run
+ *
+ * The runs use node:wasi rather than the app's runtimes: the profile
+ * runtime writes its output through the filesystem at exit, which needs
+ * a preopened directory.
+ */
+
+import { describe, expect, it } from 'vitest';
+import { closeSync, mkdirSync, openSync, readFileSync, writeFileSync } from 'node:fs';
+import { devNull } from 'node:os';
+import { join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+import { WASI } from 'node:wasi';
+import { BENCH_CASES, materialize, sizesFor } from './cases';
+import { loadCorpus } from './corpus';
+
+const CACHE_DIR = join(fileURLToPath(new URL('..', import.meta.url)), '.cache', 'bench');
+
+/** Large enough to reach the steady-state loops, small enough to train quickly */
+const TRAINING_SIZES = ['64KB', '1MB'];
+
+const binary = process.env.PGO_BINARY!;
+const profileDir = process.env.PGO_PROFILE_DIR!;
+const tool = process.env.PGO_TOOL!;
+
+let run = 0;
+
+describe(`PGO training: ${tool}`, () => {
+  const module = WebAssembly.compile(readFileSync(binary));
+  const cases = BENCH_CASES.filter((c) => c.tool === tool);
+
+  it('has cases to train with', () => {
+    expect(cases.length).toBeGreaterThan(0);
+  });
+
+  for (const c of cases) {
+    for (const size of sizesFor(c, TRAINING_SIZES)) {
+      it(`${c.name} @ ${size}`, async () => {
+        const corpus = c.corpus ? loadCorpus(CACHE_DIR, c.corpus, size) : Buffer.alloc(0);
+        const { args, stdin } = materialize(c, corpus);
+
+        mkdirSync(profileDir, { recursive: true });
+        const stdinFile = join(profileDir, 'stdin');
+        writeFileSync(stdinFile, stdin);
+        const stdinFd = openSync(stdinFile, 'r');
+        const stdoutFd = openSync(devNull, 'w');
+        try {
+          const wasi = new WASI({
+            version: 'preview1',
+            args: [tool, ...args],
+            env: { LLVM_PROFILE_FILE: `/pgo/${tool}-${++run}.profraw` },
+            preopens: { '/pgo': profileDir },
+            stdin: stdinFd,
+            stdout: stdoutFd,
+            returnOnExit: true,
+          });
+          const instance = await WebAssembly.instantiate(await module, wasi.getImportObject());
+          expect(wasi.start(instance)).toBe(c.exitCode ?? 0);
+        } finally {
+          closeSync(stdinFd);
+          closeSync(stdoutFd);
+        }
+      });
+    }
+  }
+});
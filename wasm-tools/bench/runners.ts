@@ -0,0 +1,272 @@
+/**
+ * Benchmark runners
+ *
+ * Each runner executes one tool invocation and reports its wall time:
+ *
+ * - native:      the tool's main.c built with the host C compiler (cc -O2)
+ * - worker:      wasm-worker.ts, the default sandboxed runtime, loaded into
+ *                this process with a stand-in for the Worker global scope
+ * - worker-simd: the same with the tool's .simd.wasm build
+ *
+ * The WASI runtimes can load a build profile's binaries instead
+ * (<tool>.<profile>.wasm, see build.sh).
+ * - main:        runtime.ts, the main-thread fallback runtime
+ *
+ * WASI runs use a module compiled once per binary, as the module cache
+ * provides in the app. A probe run additionally records the peak size of
+ * the module's linear memory and the number of calls to each WASI import,
+ * from the runtime's execution trace (see instrumentation.ts). Timed runs
+ * are not traced.
+ */
+
+import { spawnSync } from 'node:child_process';
+import { createHash } from 'node:crypto';
+import { existsSync, mkdirSync, readFileSync, readdirSync, statSync } from 'node:fs';
+import { join } from 'node:path';
+import type { ExecutionTrace, WorkerRequest, WorkerResponse } from '../../src/wasm-tools/worker-types';
+import { MAX_TIMEOUT } from '../../src/wasm-tools/worker-types';
+
+export type RuntimeName = 'native' | 'worker' | 'worker-simd' | 'main';
+
+export const RUNTIME_NAMES: RuntimeName[] = ['native', 'worker', 'worker-simd', 'main'];
+
+export interface RunResult {
+  ms: number;
+  exitCode: number;
+  stderr: string;
+  /** Probe runs only */
+  outputSha256?: string;
+  /** Probe runs of WASI modules only: peak linear memory size */
+  peakMemoryBytes?: number;
+  /** Probe runs of WASI modules only: calls per WASI import */
+  hostCalls?: Record<string, number>;
+}
+
+export interface Runner {
+  name: RuntimeName;
+  /** Whether this runtime can run the tool; may build or compile it */
+  prepare(tool: string): Promise<boolean>;
+  run(tool: string, args: string[], stdin: Uint8Array, probe: boolean): Promise<RunResult>;
+}
+
+const textEncoder = new TextEncoder();
+
+function sha256(bytes: Uint8Array): string {
+  return createHash('sha256').update(bytes).digest('hex');
+}
+
+// =============================================================================
+// Native
+// =============================================================================
+
+export function nativeRunner(srcDir: string, buildDir: string): Runner {
+  const built = new Map<string, string | null>();
+  const compiler = process.env.CC ?? 'cc';
+
+  return {
+    name: 'native',
+
+    async prepare(tool) {
+      if (!built.has(tool)) {
+        const source = join(srcDir, tool, 'main.c');
+        const binary = join(buildDir, tool);
+        mkdirSync(buildDir, { recursive: true });
+        // Rebuilt when main.c or any shared header is newer than the binary
+        const inputs = [source, ...readdirSync(srcDir).filter((f) => f.endsWith('.h')).map((f) => join(srcDir, f))];
+        const newest = Math.max(...inputs.map((f) => statSync(f).mtimeMs));
+        const fresh = existsSync(binary) && statSync(binary).mtimeMs >= newest;
+        const result = fresh
+          ? { status: 0 }
+          : spawnSync(compiler, ['-O2', '-w', '-o', binary, source, '-lm'], { stdio: 'ignore' });
+        built.set(tool, result.status === 0 ? binary : null);
+      }
+      return built.get(tool) !== null;
+    },
+
+    async run(tool, args, stdin, probe) {
+      const binary = built.get(tool)!;
+      const start = performance.now();
+      const result = spawnSync(binary, args, {
+        input: stdin,
+        stdio: ['pipe', probe ? 'pipe' : 'ignore', 'pipe'],
+        maxBuffer: 2 ** 32,
+      });
+      const ms = performance.now() - start;
+      // Tools such as head may exit before reading all of stdin
+      if (result.error && (result.error as NodeJS.ErrnoException).code !== 'EPIPE') throw result.error;
+      return {
+        ms,
+        exitCode: result.status ?? 1,
+        stderr: result.stderr.toString(),
+        ...(probe && { outputSha256: sha256(result.stdout) }),
+      };
+    },
+  };
+}
+
+// =============================================================================
+// WASI runtimes
+// =============================================================================
+
+/** Run fn with console output from the runtimes suppressed */
+async function quietly<T>(fn: () => Promise<T>): Promise<T> {
+  const { log, error, warn } = console;
+  console.log = console.error = console.warn = () => {};
+  try {
+    return await fn();
+  } finally {
+    Object.assign(console, { log, error, warn });
+  }
+}
+
+async function measure(
+  probe: boolean,
+  execute: () => Promise<{ exitCode: number; stdout: Uint8Array; stderr: string; trace?: ExecutionTrace }>
+): Promise<RunResult> {
+  const start = performance.now();
+  const output = await quietly(execute);
+  const ms = performance.now() - start;
+  const { trace } = output;
+  return {
+    ms,
+    exitCode: output.exitCode,
+    stderr: output.stderr,
+    ...(probe && { outputSha256: sha256(output.stdout) }),
+    ...(trace && {
+      peakMemoryBytes: trace.peakMemoryBytes,
+      hostCalls: Object.fromEntries(Object.entries(trace.syscalls).map(([name, stats]) => [name, stats.calls])),
+    }),
+  };
+}
+
+/** Compiles each tool's binary (plain or simd128, in a build profile) once */
+function moduleLoader(binDir: string, simd: boolean, profile: string) {
+  const suffix = `${profile ? `.${profile}` : ''}${simd ? '.simd' : ''}.wasm`;
+  const modules = new Map<string, WebAssembly.Module | null>();
+  return {
+    async load(tool: string): Promise<boolean> {
+      if (!modules.has(tool)) {
+        const file = join(binDir, tool + suffix);
+        modules.set(tool, existsSync(file) ? await WebAssembly.compile(readFileSync(file)) : null);
+      }
+      return modules.get(tool) !== null;
+    },
+    get(tool: string): WebAssembly.Module {
+      return modules.get(tool)!;
+    },
+  };
+}
+
+// =============================================================================
+// wasm-worker.ts
+// =============================================================================
+
+interface WorkerScope {
+  postMessage(response: WorkerResponse): void;
+  onmessage: ((event: { data: WorkerRequest }) => Promise<void>) | null;
+}
+
+const pending = new Map<string, (response: WorkerResponse) => void>();
+let workerScope: WorkerScope | null = null;
+let nextRequestId = 0;
+
+async function loadWorkerScope(): Promise<WorkerScope> {
+  if (!workerScope) {
+    const scope: WorkerScope = {
+      postMessage(response) {
+        if (response.type !== 'progress') pending.get(response.id)?.(response);
+      },
+      onmessage: null,
+    };
+    (globalThis as { self?: unknown }).self = scope;
+    await quietly(() => import('../../src/wasm-tools/wasm-worker'));
+    workerScope = scope;
+  }
+  return workerScope;
+}
+
+export function workerRunner(binDir: string, simd: boolean, profile = ''): Runner {
+  const modules = moduleLoader(binDir, simd, profile);
+  // The Worker reads binary stdin in place; one ArrayBuffer per input
+  let stdinSource: Uint8Array | null = null;
+  let stdinBuffer: ArrayBuffer | undefined;
+
+  return {
+    name: simd ? 'worker-simd' : 'worker',
+
+    async prepare(tool) {
+      await loadWorkerScope();
+      return modules.load(tool);
+    },
+
+    async run(tool, args, stdin, probe) {
+      if (stdin !== stdinSource) {
+        stdinSource = stdin;
+        stdinBuffer = stdin.length > 0 ? stdin.slice().buffer : undefined;
+      }
+      const scope = workerScope!;
+      const id = `bench-${++nextRequestId}`;
+      const request: WorkerRequest = {
+        type: 'execute',
+        id,
+        wasmModule: modules.get(tool),
+        args: [tool, ...args],
+        options: { timeout: MAX_TIMEOUT, stdinBinary: stdinBuffer, trace: probe },
+      };
+
+      return measure(probe, async () => {
+        const response = await new Promise<WorkerResponse>((resolve) => {
+          pending.set(id, resolve);
+          void scope.onmessage!({ data: request });
+        });
+        pending.delete(id);
+        if (response.type === 'error' || !response.output) {
+          throw new Error(`${tool}: ${response.error ?? 'no output'}`);
+        }
+        const { output } = response;
+        return {
+          exitCode: output.exitCode,
+          stdout: new Uint8Array(output.stdout, 0, output.stdoutLength),
+          stderr: new TextDecoder().decode(new Uint8Array(output.stderr, 0, output.stderrLength)),
+          trace: output.trace,
+        };
+      });
+    },
+  };
+}
+
+// =============================================================================
+// runtime.ts
+// =============================================================================
+
+export function mainThreadRunner(binDir: string, profile = ''): Runner {
+  const modules = moduleLoader(binDir, false, profile);
+
+  return {
+    name: 'main',
+
+    async prepare(tool) {
+      return modules.load(tool);
+    },
+
+    async run(tool, args, stdin, probe) {
+      const { WasmRuntime } = await import('../../src/wasm-tools/runtime');
+      const { VirtualFileSystem } = await import('../../src/wasm-tools/vfs');
+
+      return measure(probe, async () => {
+        const result = await new WasmRuntime().execute(
+          modules.get(tool),
+          [tool, ...args],
+          { timeout: MAX_TIMEOUT, fileAccess: 'none', trace: probe, ...(stdin.length > 0 && { stdinBinary: stdin }) },
+          new VirtualFileSystem(null)
+        );
+        return {
+          exitCode: result.exitCode,
+          stdout: result.stdoutBinary ?? textEncoder.encode(result.stdout),
+          stderr: result.stderr,
+          trace: result.trace,
+        };
+      });
+    },
+  };
+}
@@ -0,0 +1,260 @@
+/**
+ * Benchmark and regression harness for the WASI tools
+ *
+ * Runs every case in cases.ts on each corpus size, natively and under the
+ * project's WASI runtimes (runners.ts), and records per runtime the median
+ * wall time, throughput, peak linear memory and WASI host-call counts.
+ * Results go to wasm-tools/.cache/bench/results.json; a case fails when its
+ * output differs between runtimes or it regressed against the baseline.
+ * No baseline is committed: the first run on a machine records one.
+ *
+ * Run with `npm run wasm:bench` after `npm run wasm:build`. Environment:
+ *
+ *   BENCH_SIZES      corpus sizes (default 1KB,1MB,16MB; up to 500MB)
+ *   BENCH_TOOLS      only cases for these tools, e.g. wc,grep
+ *   BENCH_RUNTIMES   default native,worker,worker-simd (also: main)
+ *   BENCH_RUNS       timed runs per case and runtime (default 3)
+ *   BENCH_PROFILE    run the WASI runtimes on a build profile's binaries
+ *                    (speed, size or pgo; see build.sh)
+ *   BENCH_TOLERANCE  allowed slowdown / growth before failing (default 0.25)
+ *   BENCH_BASELINE   baseline file (default wasm-tools/bench/baseline.json)
+ *   BENCH_UPDATE=1   merge this run's results into the baseline
+ */
+
+import { afterAll, describe, expect, it } from 'vitest';
+import { existsSync, mkdirSync, readFileSync, writeFileSync } from 'node:fs';
+import { cpus } from 'node:os';
+import { dirname, join } from 'node:path';
+import { fileURLToPath } from 'node:url';
+import { BENCH_CASES, materialize, sizesFor } from './cases';
+import { CORPUS_SIZES, loadCorpus, type CorpusKind } from './corpus';
+import {
+  RUNTIME_NAMES,
+  mainThreadRunner,
+  nativeRunner,
+  workerRunner,
+  type RunResult,
+  type Runner,
+  type RuntimeName,
+} from './runners';
+
+const WASM_TOOLS_DIR = fileURLToPath(new URL('..', import.meta.url));
+const CACHE_DIR = join(WASM_TOOLS_DIR, '.cache', 'bench');
+const RESULTS_FILE = join(CACHE_DIR, 'results.json');
+const BASELINE_FILE = process.env.BENCH_BASELINE ?? join(WASM_TOOLS_DIR, 'bench', 'baseline.json');
+
+/** Differences below this are noise, whatever the tolerance says */
+const MIN_REGRESSION_MS = 1;
+
+function listEnv(name: string, fallback: string): string[] {
+  return (process.env[name] ?? fallback).split(',').map((s) => s.trim()).filter(Boolean);
+}
+
+const SIZES = listEnv('BENCH_SIZES', '1KB,1MB,16MB');
+const TOOLS = listEnv('BENCH_TOOLS', '');
+const RUNTIMES = listEnv('BENCH_RUNTIMES', 'native,worker,worker-simd');
+const RUNS = Math.max(1, Number(process.env.BENCH_RUNS ?? 3));
+const TOLERANCE = Number(process.env.BENCH_TOLERANCE ?? 0.25);
+const UPDATE = process.env.BENCH_UPDATE === '1';
+const PROFILE = process.env.BENCH_PROFILE ?? '';
+
+for (const size of SIZES) {
+  if (!(size in CORPUS_SIZES)) {
+    throw new Error(`BENCH_SIZES: unknown size "${size}" (expected ${Object.keys(CORPUS_SIZES).join(', ')})`);
+  }
+}
+for (const runtime of RUNTIMES) {
+  if (!RUNTIME_NAMES.includes(runtime as RuntimeName)) {
+    throw new Error(`BENCH_RUNTIMES: unknown runtime "${runtime}" (expected ${RUNTIME_NAMES.join(', ')})`);
+  }
+}
+
+interface RuntimeResult {
+  medianMs: number;
+  minMs: number;
+  /** Input bytes per second of median wall time, in MB/s; absent without input */
+  mbPerSec?: number;
+  peakMemoryBytes?: number;
+  hostCalls?: Record<string, number>;
+  outputSha256?: string;
+}
+
+interface CaseResult {
+  bytes: number;
+  runtimes: Partial<Record<RuntimeName, RuntimeResult>>;
+}
+
+interface BenchFile {
+  version: 1;
+  generated: string;
+  environment: { node: string; platform: string; cpu: string; runs: number };
+  results: Record<string, CaseResult>;
+}
+
+function readBenchFile(file: string): BenchFile | null {
+  if (!existsSync(file)) return null;
+  return JSON.parse(readFileSync(file, 'utf-8')) as BenchFile;
+}
+
+function writeBenchFile(file: string, results: Record<string, CaseResult>): void {
+  const data: BenchFile = {
+    version: 1,
+    generated: new Date().toISOString(),
+    environment: {
+      node: process.version,
+      platform: `${process.platform}-${process.arch}`,
+      cpu: cpus()[0]?.model ?? 'unknown',
+      runs: RUNS,
+    },
+    results,
+  };
+  mkdirSync(dirname(file), { recursive: true });
+  writeFileSync(file, JSON.stringify(data, null, 2) + '\n');
+}
+
+// =============================================================================
+// Inputs
+// =============================================================================
+
+// Consecutive cases usually share a corpus; keep the last one loaded
+let loaded: { key: string; data: Buffer } | null = null;
+
+function corpusFor(kind: CorpusKind, size: string): Buffer {
+  const key = `${kind}-${size}`;
+  if (loaded?.key !== key) loaded = { key, data: loadCorpus(CACHE_DIR, kind, size) };
+  return loaded.data;
+}
+
+// =============================================================================
+// Comparison and reporting
+// =============================================================================
+
+function median(values: number[]): number {
+  const sorted = [...values].sort((a, b) => a - b);
+  const mid = sorted.length >> 1;
+  return sorted.length % 2 ? sorted[mid]! : (sorted[mid - 1]! + sorted[mid]!) / 2;
+}
+
+function round(value: number, digits = 3): number {
+  return Number(value.toFixed(digits));
+}
+
+function summarize(times: number[], bytes: number, probe: RunResult): RuntimeResult {
+  const medianMs = median(times);
+  return {
+    medianMs: round(medianMs),
+    minMs: round(Math.min(...times)),
+    ...(bytes > 0 && { mbPerSec: round(bytes / (1 << 20) / (medianMs / 1000), 2) }),
+    ...(probe.peakMemoryBytes !== undefined && { peakMemoryBytes: probe.peakMemoryBytes }),
+    ...(probe.hostCalls && { hostCalls: probe.hostCalls }),
+    ...(probe.outputSha256 && { outputSha256: probe.outputSha256 }),
+  };
+}
+
+function totalCalls(calls: Record<string, number> | undefined): number {
+  return Object.values(calls ?? {}).reduce((sum, n) => sum + n, 0);
+}
+
+function findRegressions(current: CaseResult, base: CaseResult | undefined): string[] {
+  const regressions: string[] = [];
+  if (!base) return regressions;
+
+  for (const [runtime, now] of Object.entries(current.runtimes)) {
+    const before = base.runtimes[runtime as RuntimeName];
+    if (!before) continue;
+    if (now.medianMs > before.medianMs * (1 + TOLERANCE) && now.medianMs - before.medianMs >= MIN_REGRESSION_MS) {
+      regressions.push(`${runtime}: median ${before.medianMs} ms -> ${now.medianMs} ms`);
+    }
+    if (now.peakMemoryBytes && before.peakMemoryBytes && now.peakMemoryBytes > before.peakMemoryBytes * (1 + TOLERANCE)) {
+      regressions.push(`${runtime}: peak memory ${before.peakMemoryBytes} -> ${now.peakMemoryBytes} bytes`);
+    }
+    const callsBefore = totalCalls(before.hostCalls);
+    const callsNow = totalCalls(now.hostCalls);
+    if (callsBefore > 0 && callsNow > callsBefore * (1 + TOLERANCE)) {
+      regressions.push(`${runtime}: host calls ${callsBefore} -> ${callsNow}`);
+    }
+  }
+  return regressions;
+}
+
+function formatRuntime(result: RuntimeResult, base: RuntimeResult | undefined): string {
+  const speed = result.mbPerSec !== undefined ? `${result.mbPerSec} MB/s` : `${result.medianMs} ms`;
+  const change = base ? ` (${result.medianMs <= base.medianMs ? '' : '+'}${Math.round((result.medianMs / base.medianMs - 1) * 100)}%)` : '';
+  const memory = result.peakMemoryBytes ? `, ${(result.peakMemoryBytes / (1 << 20)).toFixed(1)} MB` : '';
+  const calls = result.hostCalls ? `, ${totalCalls(result.hostCalls)} calls` : '';
+  return `${speed}${change}${memory}${calls}`;
+}
+
+// =============================================================================
+// Cases
+// =============================================================================
+
+const baseline = readBenchFile(BASELINE_FILE);
+const results: Record<string, CaseResult> = {};
+
+const runners: Runner[] = RUNTIMES.map((name) => {
+  switch (name as RuntimeName) {
+    case 'native':
+      return nativeRunner(join(WASM_TOOLS_DIR, 'src'), join(WASM_TOOLS_DIR, '.build', 'bench-native'));
+    case 'worker':
+      return workerRunner(join(WASM_TOOLS_DIR, 'binaries'), false, PROFILE);
+    case 'worker-simd':
+      return workerRunner(join(WASM_TOOLS_DIR, 'binaries'), true, PROFILE);
+    case 'main':
+      return mainThreadRunner(join(WASM_TOOLS_DIR, 'binaries'), PROFILE);
+  }
+});
+
+const cases = BENCH_CASES.filter((c) => TOOLS.length === 0 || TOOLS.includes(c.tool));
+
+for (const c of cases) {
+  describe(c.name, () => {
+    for (const size of sizesFor(c, SIZES)) {
+      const key = size === '-' ? c.name : `${c.name} @ ${size}`;
+
+      it(size === '-' ? 'no input' : size, async ({ skip }) => {
+        const corpus = c.corpus ? corpusFor(c.corpus, size) : Buffer.alloc(0);
+        const { args, stdin } = materialize(c, corpus);
+        const entry: CaseResult = { bytes: corpus.length, runtimes: {} };
+
+        for (const runner of runners) {
+          if (!(await runner.prepare(c.tool))) continue;
+          // The probe run doubles as warm-up
+          const probe = await runner.run(c.tool, args, stdin, true);
+          expect(probe.exitCode, `${runner.name} exit status; stderr: ${probe.stderr}`).toBe(c.exitCode ?? 0);
+          const times: number[] = [];
+          for (let i = 0; i < RUNS; i++) times.push((await runner.run(c.tool, args, stdin, false)).ms);
+          entry.runtimes[runner.name] = summarize(times, corpus.length, probe);
+        }
+        if (Object.keys(entry.runtimes).length === 0) skip(`${c.tool}: not built for any selected runtime`);
+        results[key] = entry;
+
+        if (!c.nondeterministic) {
+          const digests = new Set(Object.values(entry.runtimes).map((r) => r.outputSha256));
+          expect(digests.size, 'output differs between runtimes').toBe(1);
+        }
+        expect(findRegressions(entry, baseline?.results[key]), 'regressions against the baseline').toEqual([]);
+      });
+    }
+  });
+}
+
+afterAll(() => {
+  if (Object.keys(results).length === 0) return;
+
+  const lines = Object.entries(results).map(([key, entry]) => {
+    const base = baseline?.results[key];
+    const columns = Object.entries(entry.runtimes).map(
+      ([runtime, result]) => `${runtime} ${formatRuntime(result, base?.runtimes[runtime as RuntimeName])}`
+    );
+    return `  ${key.padEnd(32)} ${columns.join(' | ')}`;
+  });
+  console.log(`\nWASI tool benchmarks (median of ${RUNS} runs)\n${lines.join('\n')}`);
+
+  writeBenchFile(RESULTS_FILE, results);
+  console.log(`\nResults: ${RESULTS_FILE}`);
+  if (UPDATE || !baseline) {
+    writeBenchFile(BASELINE_FILE, { ...baseline?.results, ...results });
+    console.log(`Baseline ${baseline ? 'updated' : 'created'}: ${BASELINE_FILE}`);
+  }
+});
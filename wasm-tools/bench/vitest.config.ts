@@ -0,0 +1,16 @@
+import { fileURLToPath } from 'node:url';
+import { defineConfig } from 'vitest/config';
+
+export default defineConfig({
+  // Repository root, wherever vitest is started from
+  root: fileURLToPath(new URL('../..', import.meta.url)),
+  test: {
+    environment: 'node',
+    // build.sh sets PGO_BINARY to run the PGO training instead (pgo.train.ts)
+    include: process.env.PGO_BINARY ? ['wasm-tools/bench/pgo.train.ts'] : ['wasm-tools/bench/**/*.bench.ts'],
+    globals: false,
+    // One file, one case at a time, so timings do not compete for the CPU
+    fileParallelism: false,
+    testTimeout: 30 * 60 * 1000,
+  },
+});
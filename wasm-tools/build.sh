@@ -12,6 +12,7 @@ BIN_DIR="$WASM_TOOLS_DIR/binaries"
 LIB_DIR="$WASM_TOOLS_DIR/libs"
 CACHE_DIR="$WASM_TOOLS_DIR/.cache"
 BUILD_DIR="$WASM_TOOLS_DIR/.build"
+REGISTRY_FILE="$WASM_TOOLS_DIR/../src/wasm-tools/registry.ts"
 
 # WASI SDK version and download URLs
 WASI_SDK_VERSION="24"
@@ -213,17 +214,290 @@ build_native_tool() {
 
     echo "  Building $tool_name..."
 
-    "$WASI_SDK_PATH/bin/clang" \
-        --target=wasm32-wasi \
-        --sysroot="$WASI_SDK_PATH/share/wasi-sysroot" \
-        -O2 \
+    local cflags=(
+        --target=wasm32-wasi
+        --sysroot="$WASI_SDK_PATH/share/wasi-sysroot"
+        -O2
+    )
+
+    "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" \
         -o "$BIN_DIR/$tool_name.wasm" \
         "$src_file" 2>&1 || {
             echo "  Failed to build $tool_name"
             return 1
         }
 
-    echo "  ✓ Built $tool_name"
+    # Tools that use the simd.h kernels (directly or through another
+    # shared header) also get a simd128 variant. The loader picks it at
+    # runtime when the engine supports SIMD and falls back to the plain
+    # binary otherwise.
+    local simd=false
+    if "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" -E -dM "$src_file" 2>/dev/null | grep -q '^#define SIMD_H'; then
+        "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" -msimd128 \
+            -o "$BIN_DIR/$tool_name.simd.wasm" \
+            "$src_file" 2>&1 || {
+                echo "  Failed to build $tool_name (simd128)"
+                return 1
+            }
+        simd=true
+    fi
+
+    # The -O2 builds above are the fallback; the tool's build profile
+    # adds <tool>.<profile>.wasm (and .simd.wasm) next to them
+    local profile=$(tool_build_profile "$tool_name")
+    if [ -n "$profile" ] && [ "$profile" != "none" ]; then
+        build_profile_variant "$tool_name" "$profile" "$simd" || {
+            echo "  Failed to build $tool_name ($profile profile)"
+            return 1
+        }
+    fi
+
+    local variants=()
+    [ "$simd" = true ] && variants+=("simd128")
+    [ -n "$profile" ] && [ "$profile" != "none" ] && variants+=("$profile")
+    if [ ${#variants[@]} -gt 0 ]; then
+        echo "  ✓ Built $tool_name (+ ${variants[*]} variants)"
+    else
+        echo "  ✓ Built $tool_name"
+    fi
+}
+
+# ============================================
+# Build Profiles
+# ============================================
+#
+# speed  -O3 with LTO, then wasm-opt -O3
+# size   -Oz with LTO and stripped names, then wasm-opt -Oz
+# pgo    speed, with the branch and inlining decisions of a profile
+#        collected by running an instrumented build over the bench corpora
+#
+# Each tool's profile is the buildProfile of its manifest in
+# src/wasm-tools/registry.ts; --profile overrides it for every tool.
+
+# Profile of a native tool, or nothing when it has none
+tool_build_profile() {
+    local tool_name="$1"
+    if [ -n "$PROFILE_OVERRIDE" ]; then
+        echo "$PROFILE_OVERRIDE"
+        return 0
+    fi
+    [ -f "$REGISTRY_FILE" ] || return 0
+    awk -v entry="    name: '$tool_name'," '
+        $0 == entry { found = 1; next }
+        found && /^    name: / { exit }
+        found && match($0, /buildProfile: '\''[a-z]+'\''/) {
+            print substr($0, RSTART + 15, RLENGTH - 16)
+            exit
+        }
+    ' "$REGISTRY_FILE"
+}
+
+# Locate wasm-opt (binaryen) and llvm-profdata once
+find_profile_tools() {
+    if [ -z "${WASM_OPT+x}" ]; then
+        WASM_OPT=""
+        if command_exists wasm-opt; then
+            WASM_OPT="$(command -v wasm-opt)"
+        else
+            echo "  Note: wasm-opt not found; profile builds skip binaryen passes"
+        fi
+    fi
+    if [ -z "${LLVM_PROFDATA+x}" ]; then
+        LLVM_PROFDATA=""
+        if [ -x "$WASI_SDK_PATH/bin/llvm-profdata" ]; then
+            LLVM_PROFDATA="$WASI_SDK_PATH/bin/llvm-profdata"
+        elif command_exists llvm-profdata; then
+            LLVM_PROFDATA="$(command -v llvm-profdata)"
+        fi
+    fi
+}
+
+# Whether the SDK can link -fprofile-generate binaries (it needs the
+# compiler-rt profile runtime for wasm32-wasi, which not every WASI SDK
+# release ships) and the profile can be merged
+pgo_available() {
+    if [ -z "$PGO_AVAILABLE" ]; then
+        PGO_AVAILABLE=false
+        local probe="$BUILD_DIR/pgo/probe"
+        mkdir -p "$BUILD_DIR/pgo"
+        echo 'int main(void) { return 0; }' > "$probe.c"
+        if [ -n "$LLVM_PROFDATA" ] && command_exists npx && \
+            "$WASI_SDK_PATH/bin/clang" --target=wasm32-wasi \
+                --sysroot="$WASI_SDK_PATH/share/wasi-sysroot" \
+                -fprofile-generate -o "$probe.wasm" "$probe.c" >/dev/null 2>&1; then
+            PGO_AVAILABLE=true
+        else
+            echo "  Note: PGO needs the wasm32-wasi profile runtime, llvm-profdata and npx;"
+            echo "        pgo profile builds use the speed flags"
+        fi
+        rm -f "$probe.c" "$probe.wasm"
+    fi
+    [ "$PGO_AVAILABLE" = true ]
+}
+
+# Collect a profile for a tool: build it instrumented, run the bench cases
+# for the tool over a training corpus (bench/pgo.train.ts) and merge the
+# raw profiles. Prints the .profdata path.
+train_pgo_profile() {
+    local tool_name="$1"
+    local src_file="$2"
+    local profile_dir="$BUILD_DIR/pgo/$tool_name"
+
+    rm -rf "$profile_dir"
+    mkdir -p "$profile_dir"
+    "$WASI_SDK_PATH/bin/clang" --target=wasm32-wasi \
+        --sysroot="$WASI_SDK_PATH/share/wasi-sysroot" \
+        -O2 -fprofile-generate \
+        -o "$profile_dir/$tool_name.wasm" "$src_file" >&2 || return 1
+
+    (cd "$WASM_TOOLS_DIR/.." && \
+        PGO_BINARY="$profile_dir/$tool_name.wasm" PGO_PROFILE_DIR="$profile_dir" PGO_TOOL="$tool_name" \
+        npx vitest run --config wasm-tools/bench/vitest.config.ts >&2) || return 1
+
+    ls "$profile_dir"/*.profraw >/dev/null 2>&1 || return 1
+    "$LLVM_PROFDATA" merge -o "$profile_dir/$tool_name.profdata" "$profile_dir"/*.profraw >&2 || return 1
+    echo "$profile_dir/$tool_name.profdata"
+}
+
+# Build <tool>.<profile>.wasm, and <tool>.<profile>.simd.wasm when the
+# tool has a simd128 variant
+build_profile_variant() {
+    local tool_name="$1"
+    local profile="$2"
+    local simd="$3"
+    local src_file="$SRC_DIR/$tool_name/main.c"
+
+    find_profile_tools
+
+    local cflags=(
+        --target=wasm32-wasi
+        --sysroot="$WASI_SDK_PATH/share/wasi-sysroot"
+        -flto
+        -mbulk-memory
+    )
+    local opt_flags=(--enable-bulk-memory)
+    case "$profile" in
+        speed)
+            cflags+=(-O3)
+            opt_flags+=(-O3)
+            ;;
+        size)
+            cflags+=(-Oz -Wl,--strip-all)
+            opt_flags+=(-Oz --strip-debug --strip-producers)
+            ;;
+        pgo)
+            cflags+=(-O3)
+            opt_flags+=(-O3)
+            if pgo_available; then
+                local profdata
+                if profdata=$(train_pgo_profile "$tool_name" "$src_file"); then
+                    cflags+=(-fprofile-use="$profdata" -Wno-profile-instr-unprofiled)
+                else
+                    echo "  Note: PGO training failed for $tool_name; using the speed flags"
+                fi
+            fi
+            ;;
+        *)
+            echo "  Unknown build profile: $profile"
+            return 1
+            ;;
+    esac
+
+    local out="$BIN_DIR/$tool_name.$profile.wasm"
+    "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" -o "$out" "$src_file" 2>&1 || return 1
+    if [ -n "$WASM_OPT" ]; then
+        "$WASM_OPT" "${opt_flags[@]}" -o "$out" "$out" || return 1
+    fi
+
+    if [ "$simd" = true ]; then
+        out="$BIN_DIR/$tool_name.$profile.simd.wasm"
+        "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" -msimd128 -o "$out" "$src_file" 2>&1 || return 1
+        if [ -n "$WASM_OPT" ]; then
+            "$WASM_OPT" "${opt_flags[@]}" --enable-simd -o "$out" "$out" || return 1
+        fi
+    fi
+}
+
+# ============================================
+# Multi-call Bundle
+# ============================================
+#
+# multicall.wasm links every native tool into one module that dispatches
+# on argv[0] (src/multicall/main.c), so libc and the shared headers are
+# downloaded and compiled once for all tools. Each tool is compiled with
+# the flags of its build profile and main renamed to <tool>_main; LTO
+# keeps those per-function optimization choices (and PGO branch weights)
+# through the link. multicall.simd.wasm is the simd128 build. -DMULTICALL
+# makes the tools share one stdout buffer (see src/stdout_write.h).
+
+build_multicall() {
+    local out_dir="$BUILD_DIR/multicall"
+    local tools_inc="$out_dir/tools.inc"
+
+    echo "  Building multicall bundle..."
+    rm -rf "$out_dir"
+    mkdir -p "$out_dir"
+    : > "$tools_inc"
+
+    local cflags=(
+        --target=wasm32-wasi
+        --sysroot="$WASI_SDK_PATH/share/wasi-sysroot"
+        -flto
+        -mbulk-memory
+        -DMULTICALL
+    )
+    local objects=()
+    local simd_objects=()
+    local tool
+    for tool in "${NATIVE_TOOLS[@]}"; do
+        local src_file="$SRC_DIR/$tool/main.c"
+        [ -f "$src_file" ] || continue
+
+        local entry="${tool//-/_}_main"
+        local tool_flags=(-O2)
+        case "$(tool_build_profile "$tool")" in
+            speed) tool_flags=(-O3) ;;
+            size) tool_flags=(-Oz) ;;
+            pgo)
+                tool_flags=(-O3)
+                # Collected by the tool's own pgo build, when it ran
+                local profdata="$BUILD_DIR/pgo/$tool/$tool.profdata"
+                if [ -f "$profdata" ]; then
+                    tool_flags+=(-fprofile-use="$profdata" -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date)
+                fi
+                ;;
+        esac
+
+        "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" "${tool_flags[@]}" -Dmain="$entry" \
+            -c -o "$out_dir/$tool.o" "$src_file" 2>&1 &&
+        "$WASI_SDK_PATH/bin/clang" "${cflags[@]}" "${tool_flags[@]}" -msimd128 -Dmain="$entry" \
+            -c -o "$out_dir/$tool.simd.o" "$src_file" 2>&1 || {
+                echo "  Failed to build $tool for the multicall bundle"
+                return 1
+            }
+        echo "TOOL(\"$tool\", $entry)" >> "$tools_inc"
+        objects+=("$out_dir/$tool.o")
+        simd_objects+=("$out_dir/$tool.simd.o")
+    done
+
+    local link_flags=("${cflags[@]}" -O3 -Wl,--strip-debug -I"$out_dir")
+    "$WASI_SDK_PATH/bin/clang" "${link_flags[@]}" \
+        -o "$BIN_DIR/multicall.wasm" "$SRC_DIR/multicall/main.c" "${objects[@]}" 2>&1 &&
+    "$WASI_SDK_PATH/bin/clang" "${link_flags[@]}" -msimd128 \
+        -o "$BIN_DIR/multicall.simd.wasm" "$SRC_DIR/multicall/main.c" "${simd_objects[@]}" 2>&1 || {
+            echo "  Failed to link the multicall bundle"
+            return 1
+        }
+
+    # The bundle mixes speed and size tools; -O2 keeps both reasonable
+    find_profile_tools
+    if [ -n "$WASM_OPT" ]; then
+        "$WASM_OPT" -O2 --enable-bulk-memory -o "$BIN_DIR/multicall.wasm" "$BIN_DIR/multicall.wasm" &&
+        "$WASM_OPT" -O2 --enable-bulk-memory --enable-simd \
+            -o "$BIN_DIR/multicall.simd.wasm" "$BIN_DIR/multicall.simd.wasm" || return 1
+    fi
+
+    echo "  ✓ Built multicall bundle (${#objects[@]} tools + simd128 variant)"
 }
 
 # ============================================
@@ -568,6 +842,8 @@ echo ""
 BUILD_NATIVE=true
 BUILD_EXTERNAL=true
 SPECIFIC_TOOLS=()
+PROFILE_OVERRIDE=""
+BUILD_MULTICALL=true
 
 while [[ $# -gt 0 ]]; do
     case $1 in
@@ -579,6 +855,20 @@ while [[ $# -gt 0 ]]; do
             BUILD_NATIVE=false
             shift
             ;;
+        --no-multicall)
+            BUILD_MULTICALL=false
+            shift
+            ;;
+        --profile)
+            case "$2" in
+                speed|size|pgo|none) PROFILE_OVERRIDE="$2" ;;
+                *)
+                    echo "Error: --profile expects speed, size, pgo or none"
+                    exit 1
+                    ;;
+            esac
+            shift 2
+            ;;
         --help)
             echo "Usage: $0 [options] [tool1] [tool2] ..."
             echo ""
@@ -590,6 +880,12 @@ while [[ $# -gt 0 ]]; do
             echo "Options:"
             echo "  --native-only    Only build native C tools"
             echo "  --external-only  Only build/download external libraries"
+            echo "  --no-multicall   Skip the multicall bundle (all native tools in one"
+            echo "                   module); it is only built when building all tools"
+            echo "  --profile P      Build profile for every native tool, overriding the"
+            echo "                   buildProfile in registry.ts: speed (-O3, LTO,"
+            echo "                   wasm-opt -O3), size (-Oz, LTO, stripped), pgo (speed"
+            echo "                   plus a profile from the bench corpora) or none"
             echo "  --help           Show this help"
             echo ""
             echo "Native tools (${#NATIVE_TOOLS[@]} tools):"
@@ -609,6 +905,8 @@ while [[ $# -gt 0 ]]; do
             echo ""
             echo "Prerequisites for building from source:"
             echo "  - curl (for downloading dependencies)"
+            echo "  - wasm-opt from binaryen (optional, for build profiles)"
+            echo "  - llvm-profdata and a WASI SDK with the profile runtime (optional, for pgo)"
             exit 0
             ;;
         *)
@@ -636,6 +934,9 @@ if [ "$BUILD_NATIVE" = true ]; then
             for tool in "${NATIVE_TOOLS[@]}"; do
                 build_native_tool "$tool" || true
             done
+            if [ "$BUILD_MULTICALL" = true ]; then
+                build_multicall || true
+            fi
         else
             for tool in "${SPECIFIC_TOOLS[@]}"; do
                 build_native_tool "$tool" || true
@@ -688,13 +989,13 @@ get_tool_info() {
         uuid) echo "crypto|Generate a random UUID v4|positional|none" ;;
 
         # Text Processing tools
-        wc) echo "text|Count lines, words, and characters in text|cli|none" ;;
+        wc) echo "text|Count lines, words, bytes, UTF-8 characters or max line length|cli|none" ;;
         head) echo "text|Output the first N lines of text|cli|none" ;;
         tail) echo "text|Output the last N lines of text|cli|none" ;;
-        cut) echo "text|Extract columns/fields from text|cli|none" ;;
+        cut) echo "text|Extract fields, bytes or characters from text|cli|none" ;;
         sort) echo "text|Sort lines of text alphabetically or numerically|cli|none" ;;
         uniq) echo "text|Report or filter out repeated adjacent lines|cli|none" ;;
-        tr) echo "text|Translate or delete characters in text|positional|none" ;;
+        tr) echo "text|Translate, delete or squeeze characters in text|cli|none" ;;
         grep) echo "text|Search for patterns in text|cli|none" ;;
         sed) echo "text|Stream editor for text transformation|positional|none" ;;
         awk) echo "text|Pattern scanning and processing|cli|none" ;;
@@ -703,24 +1004,24 @@ get_tool_info() {
 
         # Data Format tools
         toml2json) echo "data|Convert TOML to JSON format|positional|none" ;;
-        csvtool) echo "data|Process CSV data|positional|none" ;;
-        markdown) echo "data|Convert Markdown to HTML|positional|none" ;;
+        csvtool) echo "data|Process CSV data|cli|none" ;;
+        markdown) echo "data|Convert CommonMark (GFM tables, strikethrough) to HTML|cli|none" ;;
         jwt) echo "data|Decode and inspect JWT tokens|positional|none" ;;
-        xmllint) echo "data|Validate and format XML documents|positional|none" ;;
-        yq) echo "data|Query and transform YAML data|positional|none" ;;
+        xmllint) echo "data|Validate and format XML documents|cli|none" ;;
+        yq) echo "data|Query and transform YAML data|cli|none" ;;
 
         # File Utilities
         file) echo "file|Determine file type from content|positional|none" ;;
         du) echo "file|Calculate and format file sizes|cli|none" ;;
         stat) echo "file|Display formatted file information|positional|none" ;;
-        tree) echo "file|Display directory structure as a tree|positional|none" ;;
+        tree) echo "file|Display paths as a directory tree|cli|none" ;;
         touch) echo "file|Create or update file timestamps|positional|write" ;;
         truncate) echo "file|Truncate or extend text to a specific length|positional|none" ;;
 
         # Code/Minification tools
         shfmt) echo "code|Format shell scripts|positional|none" ;;
-        minify) echo "code|Minify JavaScript code|positional|none" ;;
-        terser) echo "code|Minify JavaScript code (terser-like)|positional|none" ;;
+        minify) echo "code|Minify JavaScript, CSS or HTML|cli|none" ;;
+        terser) echo "code|Minify JavaScript code, with --compress and --mangle (terser-like)|cli|none" ;;
         csso) echo "code|Minify CSS code|positional|none" ;;
         html-minifier) echo "code|Minify HTML code|positional|none" ;;
 
@@ -820,6 +1121,10 @@ echo ""
 # Generate manifests and ZIP packages for all built tools
 PACKAGED_COUNT=0
 for wasm_file in "$BIN_DIR"/*.wasm; do
+    # SIMD and build profile variants (<tool>.<variant>.wasm) are served
+    # alongside the plain binary, and the multicall bundle only backs the
+    # built-in tools; neither is packaged
+    case "$(basename "$wasm_file" .wasm)" in *.*|multicall) continue ;; esac
     if [ -f "$wasm_file" ]; then
         tool_name=$(basename "$wasm_file" .wasm)
         if create_zip_package "$tool_name"; then
@@ -0,0 +1,359 @@
+/**
+ * Multi-pattern string search for WASM tools (grep -F, awk pattern lists).
+ *
+ * Builds an Aho-Corasick automaton over any number of fixed strings, so a
+ * text is searched for all of them in one pass whatever their number:
+ *
+ * - Patterns go into a trie; ac_compile() adds failure links in breadth-
+ *   first order and links each state to the nearest pattern end on its
+ *   failure chain, so every pattern ending at a position is reported.
+ * - Bytes are grouped into equivalence classes (bytes in no pattern share
+ *   one class; with AC_ICASE both cases of a letter share one), and the
+ *   automaton is compiled into a dense states x classes transition table,
+ *   one lookup per text byte. Past AC_DENSE_MAX_CELLS cells it keeps the
+ *   trie's edge lists and follows failure links at search time.
+ * - While in the root state, the text is skipped to the next byte that
+ *   can start a pattern with simd_memchr() (one such byte) or
+ *   simd_find_set() (up to AC_PREFILTER_MAX_BYTES of them).
+ *
+ * ac_search() finds the leftmost-longest match, as grep -o prints them,
+ * ac_match() only answers whether any pattern occurs, and ac_scan() marks
+ * every pattern that occurs.
+ *
+ * Usage:
+ *   AhoCorasick *ac = ac_new(AC_ICASE);
+ *   ac_add(ac, "foo", 3);
+ *   ac_add(ac, "barbaz", 6);
+ *   ac_compile(ac);
+ *   if (ac_match(ac, line, len)) { ... }
+ *   ac_free(ac);
+ */
+
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "simd.h"
+
+#define AC_ICASE 1                      /* ASCII case-insensitive matching */
+#define AC_DENSE_MAX_CELLS (1 << 21)    /* Largest dense table (8MB) */
+#define AC_PREFILTER_MAX_BYTES 32       /* Beyond this most text bytes are candidates */
+
+enum { AC_PREFILTER_NONE, AC_PREFILTER_BYTE, AC_PREFILTER_SET };
+
+typedef struct {
+    int32_t to;
+    int32_t next;       /* Next edge of the same state, -1 at the end */
+    uint8_t key;        /* Pattern byte while building, its class once compiled */
+} AcEdge;
+
+typedef struct {
+    int32_t edges;      /* First edge, -1 if none */
+    int32_t fail;
+    int32_t match;      /* Nearest pattern end on the failure chain (itself included), -1 if none */
+    int32_t pattern;    /* Id of the pattern ending here, -1 if none */
+    int32_t depth;
+} AcState;
+
+typedef struct {
+    int flags;
+    AcState *states;
+    int nstates, states_cap;
+    AcEdge *edges;
+    int nedges, edges_cap;
+    int32_t root[256];          /* Children of the root by (folded) byte, -1 if none */
+    int npatterns;
+    int empty_pattern;          /* Id of the empty pattern, -1 if none */
+
+    uint8_t used[256];          /* Bytes occurring in patterns (folded) */
+    uint8_t byte_class[256];
+    int ncls;
+    int32_t root_row[256];      /* Root transitions by class */
+    int32_t *table;             /* Dense transitions, nstates * ncls; NULL when sparse */
+
+    int prefilter;
+    unsigned char first_byte;
+    SimdByteSet first_set;
+} AhoCorasick;
+
+static inline unsigned char ac_fold(const AhoCorasick *ac, unsigned char c) {
+    return (ac->flags & AC_ICASE) ? simd_lower_byte(c) : c;
+}
+
+static inline int ac_new_state(AhoCorasick *ac, int depth) {
+    if (ac->nstates == ac->states_cap) {
+        ac->states_cap = ac->states_cap ? ac->states_cap * 2 : 64;
+        ac->states = (AcState *)realloc(ac->states, ac->states_cap * sizeof(AcState));
+    }
+    AcState *s = &ac->states[ac->nstates];
+    s->edges = -1;
+    s->fail = 0;
+    s->match = -1;
+    s->pattern = -1;
+    s->depth = depth;
+    return ac->nstates++;
+}
+
+static inline AhoCorasick *ac_new(int flags) {
+    AhoCorasick *ac = (AhoCorasick *)calloc(1, sizeof(AhoCorasick));
+    ac->flags = flags;
+    ac->empty_pattern = -1;
+    memset(ac->root, -1, sizeof(ac->root));
+    ac_new_state(ac, 0);
+    return ac;
+}
+
+/*
+ * Add a pattern (before ac_compile). Returns its id, numbered from 0 in
+ * order of addition; adding a pattern again returns the existing id.
+ */
+static inline int ac_add(AhoCorasick *ac, const char *pattern, size_t len) {
+    if (len == 0) {
+        if (ac->empty_pattern < 0) ac->empty_pattern = ac->npatterns++;
+        return ac->empty_pattern;
+    }
+
+    const unsigned char *p = (const unsigned char *)pattern;
+    unsigned char c = ac_fold(ac, p[0]);
+    ac->used[c] = 1;
+    if (ac->root[c] < 0) ac->root[c] = ac_new_state(ac, 1);
+    int s = ac->root[c];
+
+    for (size_t i = 1; i < len; i++) {
+        c = ac_fold(ac, p[i]);
+        ac->used[c] = 1;
+        int next = -1;
+        for (int e = ac->states[s].edges; e >= 0; e = ac->edges[e].next) {
+            if (ac->edges[e].key == c) {
+                next = ac->edges[e].to;
+                break;
+            }
+        }
+        if (next < 0) {
+            next = ac_new_state(ac, (int)i + 1);
+            if (ac->nedges == ac->edges_cap) {
+                ac->edges_cap = ac->edges_cap ? ac->edges_cap * 2 : 64;
+                ac->edges = (AcEdge *)realloc(ac->edges, ac->edges_cap * sizeof(AcEdge));
+            }
+            AcEdge *edge = &ac->edges[ac->nedges];
+            edge->to = next;
+            edge->key = c;
+            edge->next = ac->states[s].edges;
+            ac->states[s].edges = ac->nedges++;
+        }
+        s = next;
+    }
+
+    if (ac->states[s].pattern < 0) ac->states[s].pattern = ac->npatterns++;
+    return ac->states[s].pattern;
+}
+
+/* Transition without a dense table: follow failure links to an edge */
+static inline int ac_next_sparse(const AhoCorasick *ac, int s, int cls) {
+    for (;;) {
+        if (s == 0) return ac->root_row[cls];
+        for (int e = ac->states[s].edges; e >= 0; e = ac->edges[e].next) {
+            if (ac->edges[e].key == cls) return ac->edges[e].to;
+        }
+        s = ac->states[s].fail;
+    }
+}
+
+static inline int ac_next(const AhoCorasick *ac, int s, unsigned char c) {
+    int cls = ac->byte_class[c];
+    if (ac->table) return ac->table[(size_t)s * ac->ncls + cls];
+    return ac_next_sparse(ac, s, cls);
+}
+
+/* Build failure links, the transition table and the prefilter */
+static inline void ac_compile(AhoCorasick *ac) {
+    /* Classes: one per byte used in a pattern, then one for all others */
+    int nused = 0;
+    for (int c = 0; c < 256; c++) {
+        if (ac->used[c]) ac->byte_class[c] = (uint8_t)nused++;
+    }
+    for (int c = 0; c < 256; c++) {
+        if (ac->used[c]) continue;
+        unsigned char folded = ac_fold(ac, (unsigned char)c);
+        ac->byte_class[c] = ac->used[folded] ? ac->byte_class[folded] : (uint8_t)nused;
+    }
+    ac->ncls = nused < 256 ? nused + 1 : 256;
+
+    memset(ac->root_row, 0, sizeof(ac->root_row));
+    for (int c = 0; c < 256; c++) {
+        if (ac->root[c] >= 0) ac->root_row[ac->byte_class[c]] = ac->root[c];
+    }
+
+    size_t cells = (size_t)ac->nstates * ac->ncls;
+    ac->table = cells <= AC_DENSE_MAX_CELLS ? (int32_t *)malloc(cells * sizeof(int32_t)) : NULL;
+    if (ac->table) memcpy(ac->table, ac->root_row, ac->ncls * sizeof(int32_t));
+
+    /* Breadth-first, so a state's failure target is complete before it */
+    int *queue = (int *)malloc(ac->nstates * sizeof(int));
+    int head = 0, tail = 0;
+    for (int c = 0; c < 256; c++) {
+        if (ac->root[c] >= 0) queue[tail++] = ac->root[c];
+    }
+
+    while (head < tail) {
+        int s = queue[head++];
+        AcState *st = &ac->states[s];
+        st->match = st->pattern >= 0 ? s : ac->states[st->fail].match;
+
+        int32_t *row = NULL;
+        if (ac->table) {
+            /* Start from the failure state's row, then override with edges */
+            row = ac->table + (size_t)s * ac->ncls;
+            memcpy(row, ac->table + (size_t)st->fail * ac->ncls, ac->ncls * sizeof(int32_t));
+        }
+        for (int e = st->edges; e >= 0; e = ac->edges[e].next) {
+            AcEdge *edge = &ac->edges[e];
+            int cls = ac->byte_class[edge->key];
+            edge->key = (uint8_t)cls;
+            if (row) {
+                ac->states[edge->to].fail = row[cls];
+                row[cls] = edge->to;
+            } else {
+                ac->states[edge->to].fail = ac_next_sparse(ac, st->fail, cls);
+            }
+            queue[tail++] = edge->to;
+        }
+    }
+    free(queue);
+
+    /* Bytes that leave the root state */
+    int nfirst = 0;
+    memset(&ac->first_set, 0, sizeof(ac->first_set));
+    for (int c = 0; c < 256; c++) {
+        if (ac->root[ac_fold(ac, (unsigned char)c)] >= 0) {
+            simd_byte_set_add(&ac->first_set, (unsigned char)c);
+            ac->first_byte = (unsigned char)c;
+            nfirst++;
+        }
+    }
+    if (ac->empty_pattern >= 0 || nfirst == 0 || nfirst > AC_PREFILTER_MAX_BYTES) {
+        ac->prefilter = AC_PREFILTER_NONE;
+    } else {
+        ac->prefilter = nfirst == 1 ? AC_PREFILTER_BYTE : AC_PREFILTER_SET;
+    }
+}
+
+/* Position of the next byte at or after i that can start a match (len if none) */
+static inline size_t ac_skip(const AhoCorasick *ac, const unsigned char *text, size_t len, size_t i) {
+    const unsigned char *hit;
+    if (ac->prefilter == AC_PREFILTER_BYTE) {
+        hit = (const unsigned char *)simd_memchr(text + i, ac->first_byte, len - i);
+    } else {
+        hit = (const unsigned char *)simd_find_set(&ac->first_set, text + i, len - i);
+    }
+    return hit ? (size_t)(hit - text) : len;
+}
+
+static inline int ac_word_byte(unsigned char c) {
+    return isalnum(c) || c == '_';
+}
+
+/* Whether text[start..end) is a whole word (grep -w) */
+static inline int ac_whole_word(const char *text, size_t len, size_t start, size_t end) {
+    const unsigned char *t = (const unsigned char *)text;
+    return (start == 0 || !ac_word_byte(t[start - 1])) && (end == len || !ac_word_byte(t[end]));
+}
+
+/* Does any pattern occur in text[0..len)? */
+static inline int ac_match(const AhoCorasick *ac, const char *text, size_t len) {
+    if (ac->empty_pattern >= 0) return 1;
+
+    const unsigned char *t = (const unsigned char *)text;
+    int s = 0;
+    for (size_t i = 0; i < len; ) {
+        if (s == 0 && ac->prefilter != AC_PREFILTER_NONE) {
+            i = ac_skip(ac, t, len, i);
+            if (i == len) break;
+        }
+        s = ac_next(ac, s, t[i++]);
+        if (ac->states[s].match >= 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Find the leftmost-longest match that starts at or after `from`; with
+ * whole_words only matches that are whole words count. Returns 1 and sets
+ * match_start and match_end on success.
+ */
+static inline int ac_search(const AhoCorasick *ac, const char *text, size_t len, size_t from,
+                     int whole_words, size_t *match_start, size_t *match_end) {
+    const unsigned char *t = (const unsigned char *)text;
+    size_t best_start = from, best_end = from;
+    int found = ac->empty_pattern >= 0 && (!whole_words || ac_whole_word(text, len, from, from));
+    int s = 0;
+
+    for (size_t i = from; i < len; ) {
+        /* Matches still in progress start at i - depth or later */
+        if (found && i - ac->states[s].depth > best_start) break;
+        if (s == 0 && ac->prefilter != AC_PREFILTER_NONE) {
+            i = ac_skip(ac, t, len, i);
+            if (i == len) break;
+        }
+        s = ac_next(ac, s, t[i++]);
+
+        for (int m = ac->states[s].match; m >= 0; m = ac->states[ac->states[m].fail].match) {
+            size_t start = i - ac->states[m].depth;
+            if (whole_words && !ac_whole_word(text, len, start, i)) continue;
+            if (!found || start < best_start || (start == best_start && i > best_end)) {
+                found = 1;
+                best_start = start;
+                best_end = i;
+            }
+        }
+    }
+
+    if (found) {
+        *match_start = best_start;
+        *match_end = best_end;
+    }
+    return found;
+}
+
+/*
+ * Set seen[id] for every pattern occurring in text[0..len) and clear it
+ * for the others. Returns the number of patterns found.
+ */
+static inline int ac_scan(const AhoCorasick *ac, const char *text, size_t len, unsigned char *seen) {
+    const unsigned char *t = (const unsigned char *)text;
+    int found = 0;
+    memset(seen, 0, ac->npatterns);
+    if (ac->empty_pattern >= 0) {
+        seen[ac->empty_pattern] = 1;
+        found++;
+    }
+
+    int s = 0;
+    for (size_t i = 0; i < len && found < ac->npatterns; ) {
+        if (s == 0 && ac->prefilter != AC_PREFILTER_NONE) {
+            i = ac_skip(ac, t, len, i);
+            if (i == len) break;
+        }
+        s = ac_next(ac, s, t[i++]);
+        for (int m = ac->states[s].match; m >= 0; m = ac->states[ac->states[m].fail].match) {
+            int id = ac->states[m].pattern;
+            if (!seen[id]) {
+                seen[id] = 1;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+static inline void ac_free(AhoCorasick *ac) {
+    if (!ac) return;
+    free(ac->states);
+    free(ac->edges);
+    free(ac->table);
+    free(ac);
+}
+
+#endif /* AHO_CORASICK_H */
@@ -1,315 +1,3800 @@
 /**
  * awk - Pattern scanning and processing
- * Usage: awk [-F sep] <program> <text>
- * Supports: {print}, {print $N}, BEGIN, END, /pattern/
+ * Usage: awk [-F sep] [-v var=value]... <program> [<text>]
+ *
+ * The program is parsed once into an AST, checked (array vs scalar use,
+ * function arity) and compiled to bytecode for a small stack VM, so each
+ * record only runs the compiled rules.
+ *
+ * Supported language:
+ *   BEGIN/END, expression and /regex/ patterns, range patterns (p1, p2)
+ *   print, printf, if/else, while, do-while, for(;;), for (k in a),
+ *   break, continue, next, exit, getline [var], delete a[k], delete a
+ *   user functions (scalars by value, arrays by reference, extra
+ *   parameters as locals, recursion)
+ *   numeric and string values with awk's comparison rules, associative
+ *   arrays (open-addressing hash table, a[i,j] via SUBSEP, k in a)
+ *   all arithmetic, assignment, increment, comparison, match (~ !~),
+ *   ternary and logical operators, string concatenation
+ *   NR NF FNR FS OFS ORS RS SUBSEP RSTART RLENGTH CONVFMT OFMT FILENAME
+ *   length substr index split sub gsub match sprintf sin cos atan2 exp
+ *   log sqrt int rand srand tolower toupper close fflush
+ * Regular expressions are POSIX extended (regex_engine.h). When several
+ * rules have plain-string patterns (/error/, /warning/), they are matched
+ * together by one Aho-Corasick pass over the record (aho_corasick.h)
+ * instead of one regex match per rule.
+ *
+ * Fields are split lazily: $1 on a 500-column row stops after the first
+ * separator, and NF or $0 changes trigger a full split or a rebuild only
+ * when needed. FS may be " " (runs of blanks), a single literal
+ * character, "" (one field per character) or an ERE. RS may be "\n", any
+ * single character, "" (paragraph mode) or an ERE.
+ *
+ * Output redirection (> and >>) writes to files, "/dev/stdout" or
+ * "/dev/stderr"; pipes and getline from files or commands are not
+ * available in the sandbox. Strings are handled as bytes.
+ *
+ * The host's cli argument style is also accepted: --program, --input,
+ * --fieldSeparator and --assign var=value.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <ctype.h>
-#include "../stdin_read.h"
+#include <math.h>
+#include <time.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
+#include "../regex_engine.h"
+#include "../aho_corasick.h"
 
-#define MAX_FIELDS 1024
-#define MAX_LINE 65536
+#define STACK_SIZE 65536
+#define MAX_FRAMES 4096
 
-static char field_sep[32] = " \t";
-static char *fields[MAX_FIELDS];
-static int nf = 0;
-static int nr = 0;
-static char current_line[MAX_LINE];
+static void fatal(const char *fmt, ...) {
+    va_list ap;
+    out_flush();
+    fprintf(stderr, "awk: ");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n ? n : 1);
+    if (!p) fatal("out of memory");
+    return p;
+}
+
+static void *xrealloc(void *p, size_t n) {
+    p = realloc(p, n ? n : 1);
+    if (!p) fatal("out of memory");
+    return p;
+}
+
+/* ========================================================================== */
+/* Strings and values                                                         */
+/* ========================================================================== */
+
+/* Immutable, reference-counted, always NUL-terminated */
+typedef struct Str {
+    size_t refs;
+    size_t len;
+    char data[];
+} Str;
+
+static Str *str_new(const char *s, size_t len) {
+    Str *r = (Str *)xmalloc(sizeof(Str) + len + 1);
+    r->refs = 1;
+    r->len = len;
+    if (len) memcpy(r->data, s, len);
+    r->data[len] = '\0';
+    return r;
+}
+
+static Str *str_cstr(const char *s) { return str_new(s, strlen(s)); }
+static inline Str *str_ref(Str *s) { s->refs++; return s; }
+static inline void str_unref(Str *s) { if (--s->refs == 0) free(s); }
+
+/* Growable byte buffer for building strings */
+typedef struct {
+    char *p;
+    size_t len, cap;
+} Buf;
+
+static void buf_reserve(Buf *b, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 256;
+        while (b->len + n + 1 > cap) cap *= 2;
+        b->p = (char *)xrealloc(b->p, cap);
+        b->cap = cap;
+    }
+}
+
+static void buf_add(Buf *b, const char *s, size_t n) {
+    buf_reserve(b, n);
+    memcpy(b->p + b->len, s, n);
+    b->len += n;
+}
+
+static void buf_addc(Buf *b, char c) {
+    buf_reserve(b, 1);
+    b->p[b->len++] = c;
+}
+
+enum { V_UNSET, V_NUM, V_STR, V_STRNUM, V_ARRAY, V_REGEX };
+
+struct Array;
+
+/*
+ * V_STRNUM is input data (fields, getline, split, -v) that looks like a
+ * number: it compares numerically but prints as its original text.
+ * V_REGEX (num = regex index) only lives on the stack, for arguments of
+ * match/split/sub/gsub and the right side of ~.
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t owned;          /* V_ARRAY: freed with the variable */
+    double num;
+    union {
+        Str *s;
+        struct Array *a;
+    };
+} Cell;
+
+static inline int cell_has_str(const Cell *c) { return c->type == V_STR || c->type == V_STRNUM; }
+
+static inline void cell_free(Cell *c) {
+    if (cell_has_str(c)) str_unref(c->s);
+    c->type = V_UNSET;
+}
+
+static inline Cell cell_copy(const Cell *c) {
+    Cell r = *c;
+    if (cell_has_str(&r)) str_ref(r.s);
+    r.owned = 0;
+    return r;
+}
+
+static inline Cell cell_num(double d) {
+    Cell c;
+    c.type = V_NUM;
+    c.owned = 0;
+    c.num = d;
+    c.s = NULL;
+    return c;
+}
+
+static inline Cell cell_str(Str *s) {
+    Cell c;
+    c.type = V_STR;
+    c.owned = 0;
+    c.num = 0;
+    c.s = s;
+    return c;
+}
+
+/* awk's "looks like a number": optional blanks, a decimal number, blanks */
+static int looks_numeric(const char *s, size_t len, double *out) {
+    size_t i = 0;
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n')) i++;
+    size_t start = i;
+    if (i < len && (s[i] == '+' || s[i] == '-')) i++;
+    size_t digits = 0;
+    while (i < len && isdigit((unsigned char)s[i])) { i++; digits++; }
+    if (i < len && s[i] == '.') {
+        i++;
+        while (i < len && isdigit((unsigned char)s[i])) { i++; digits++; }
+    }
+    if (digits == 0) return 0;
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        size_t j = i + 1;
+        if (j < len && (s[j] == '+' || s[j] == '-')) j++;
+        if (j < len && isdigit((unsigned char)s[j])) {
+            while (j < len && isdigit((unsigned char)s[j])) j++;
+            i = j;
+        }
+    }
+    size_t end = i;
+    while (i < len && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n')) i++;
+    if (i != len) return 0;
+    /* strtod needs a terminated copy only when the number is not at the end */
+    char tmp[64];
+    size_t n = end - start;
+    if (n < sizeof(tmp)) {
+        memcpy(tmp, s + start, n);
+        tmp[n] = '\0';
+        *out = strtod(tmp, NULL);
+    } else {
+        char *big = (char *)xmalloc(n + 1);
+        memcpy(big, s + start, n);
+        big[n] = '\0';
+        *out = strtod(big, NULL);
+        free(big);
+    }
+    return 1;
+}
+
+/* Input data: V_STRNUM if it looks numeric, V_STR otherwise */
+static Cell cell_input(Str *s) {
+    Cell c = cell_str(s);
+    if (looks_numeric(s->data, s->len, &c.num)) c.type = V_STRNUM;
+    return c;
+}
+
+/* Leading-prefix conversion used for arithmetic on strings ("3abc" is 3) */
+static double str_to_num(const Str *s) {
+    const char *p = s->data;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\f' || *p == '\v') p++;
+    const char *q = p;
+    if (*q == '+' || *q == '-') q++;
+    /* strtod would also take hex, inf and nan, which awk does not */
+    if (!(isdigit((unsigned char)*q) || (*q == '.' && isdigit((unsigned char)q[1])))) return 0;
+    if (q[0] == '0' && (q[1] == 'x' || q[1] == 'X')) return 0;
+    return strtod(p, NULL);
+}
+
+static inline double to_num(const Cell *c) {
+    switch (c->type) {
+    case V_NUM:
+    case V_STRNUM: return c->num;
+    case V_STR: return str_to_num(c->s);
+    case V_ARRAY: fatal("attempt to use array in a scalar context");
+    }
+    return 0;
+}
+
+/* Format a number: integers exactly, anything else with fmt (CONVFMT/OFMT) */
+static size_t format_num(char *out, size_t size, double d, const char *fmt) {
+    if (d == (double)(long long)d && fabs(d) < 1e16) {
+        return (size_t)snprintf(out, size, "%lld", (long long)d);
+    }
+    if (isnan(d)) return (size_t)snprintf(out, size, "%s", signbit(d) ? "-nan" : "nan");
+    if (isinf(d)) return (size_t)snprintf(out, size, "%s", d < 0 ? "-inf" : "inf");
+    return (size_t)snprintf(out, size, fmt, d);
+}
+
+/* ========================================================================== */
+/* Associative arrays                                                         */
+/* ========================================================================== */
+
+/*
+ * Entries are kept densely in insertion order (so for-in is stable and
+ * iteration is cache-friendly); an open-addressing slot table with linear
+ * probing maps hashes to entry indexes. Deleted entries keep their slot
+ * as a tombstone until the next rehash compacts the entry list.
+ */
+typedef struct {
+    Str *key;               /* NULL once deleted */
+    uint32_t hash;
+    Cell val;
+} Entry;
+
+typedef struct Array {
+    Entry *entries;
+    size_t used;            /* Entries appended, including deleted ones */
+    size_t count;           /* Live entries */
+    int32_t *slots;         /* -1 = empty */
+    size_t nslots;          /* Power of two */
+} Array;
+
+static inline uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static Array *array_new(void) {
+    Array *a = (Array *)xmalloc(sizeof(Array));
+    memset(a, 0, sizeof(*a));
+    return a;
+}
+
+static void array_clear(Array *a) {
+    for (size_t i = 0; i < a->used; i++) {
+        Entry *e = &a->entries[i];
+        if (!e->key) continue;
+        str_unref(e->key);
+        cell_free(&e->val);
+    }
+    free(a->entries);
+    free(a->slots);
+    memset(a, 0, sizeof(*a));
+}
+
+static void array_free(Array *a) {
+    array_clear(a);
+    free(a);
+}
+
+static void array_rehash(Array *a, size_t min_count) {
+    size_t nslots = 16;
+    while (nslots < min_count * 2) nslots *= 2;
+
+    /* Compact live entries in order */
+    size_t live = 0;
+    for (size_t i = 0; i < a->used; i++) {
+        if (a->entries[i].key) a->entries[live++] = a->entries[i];
+    }
+    a->used = live;
+    a->entries = (Entry *)xrealloc(a->entries, (nslots / 2) * sizeof(Entry));
+
+    free(a->slots);
+    a->slots = (int32_t *)xmalloc(nslots * sizeof(int32_t));
+    memset(a->slots, 0xff, nslots * sizeof(int32_t));
+    a->nslots = nslots;
+    size_t mask = nslots - 1;
+    for (size_t i = 0; i < live; i++) {
+        size_t s = a->entries[i].hash & mask;
+        while (a->slots[s] >= 0) s = (s + 1) & mask;
+        a->slots[s] = (int32_t)i;
+    }
+}
+
+/* Slot holding key, or the empty slot where it would go */
+static size_t array_probe(const Array *a, const char *key, size_t len, uint32_t h) {
+    size_t mask = a->nslots - 1;
+    size_t s = h & mask;
+    for (;;) {
+        int32_t idx = a->slots[s];
+        if (idx < 0) return s;
+        const Entry *e = &a->entries[idx];
+        if (e->key && e->hash == h && e->key->len == len && memcmp(e->key->data, key, len) == 0) return s;
+        s = (s + 1) & mask;
+    }
+}
+
+static Cell *array_find(const Array *a, const Str *key) {
+    if (a->count == 0) return NULL;
+    uint32_t h = hash_bytes(key->data, key->len);
+    int32_t idx = a->slots[array_probe(a, key->data, key->len, h)];
+    return idx < 0 ? NULL : &a->entries[idx].val;
+}
+
+/* Element for key, created (uninitialized) if missing */
+static Cell *array_get(Array *a, Str *key) {
+    uint32_t h = hash_bytes(key->data, key->len);
+    if (a->nslots) {
+        int32_t idx = a->slots[array_probe(a, key->data, key->len, h)];
+        if (idx >= 0) return &a->entries[idx].val;
+    }
+    if ((a->used + 1) * 2 > a->nslots) array_rehash(a, a->count + 1);
+    size_t s = array_probe(a, key->data, key->len, h);
+    Entry *e = &a->entries[a->used];
+    e->key = str_ref(key);
+    e->hash = h;
+    e->val.type = V_UNSET;
+    e->val.owned = 0;
+    a->slots[s] = (int32_t)a->used++;
+    a->count++;
+    return &e->val;
+}
+
+static void array_delete(Array *a, const Str *key) {
+    if (a->count == 0) return;
+    uint32_t h = hash_bytes(key->data, key->len);
+    int32_t idx = a->slots[array_probe(a, key->data, key->len, h)];
+    if (idx < 0) return;
+    Entry *e = &a->entries[idx];
+    str_unref(e->key);
+    e->key = NULL;
+    cell_free(&e->val);
+    a->count--;
+}
+
+/* ========================================================================== */
+/* Global state                                                               */
+/* ========================================================================== */
+
+/* Special variables occupy the first global slots */
+enum {
+    G_NF, G_NR, G_FNR, G_FS, G_OFS, G_ORS, G_RS, G_SUBSEP, G_RSTART, G_RLENGTH,
+    G_CONVFMT, G_OFMT, G_FILENAME, NUM_SPECIAL
+};
+
+static const char *special_names[NUM_SPECIAL] = {
+    "NF", "NR", "FNR", "FS", "OFS", "ORS", "RS", "SUBSEP", "RSTART", "RLENGTH",
+    "CONVFMT", "OFMT", "FILENAME"
+};
+
+static Cell *globals;
+static char **global_names;
+static uint8_t *global_is_array;
+static int nglobals, globals_cap;
+
+static Regex **regexes;
+static int nregexes, regexes_cap;
+static Array *regex_cache;   /* Pattern text -> regex index (as a number) */
+
+static int add_regex(Regex *re) {
+    if (nregexes == regexes_cap) {
+        regexes_cap = regexes_cap ? regexes_cap * 2 : 16;
+        regexes = (Regex **)xrealloc(regexes, regexes_cap * sizeof(Regex *));
+    }
+    regexes[nregexes] = re;
+    return nregexes++;
+}
+
+/* Compiled regex for a dynamic pattern string; compiled once and cached */
+static Regex *regex_for(Str *pattern) {
+    Cell *c = array_get(regex_cache, pattern);
+    if (c->type == V_NUM) return regexes[(int)c->num];
+    const char *err;
+    Regex *re = re_compile(pattern->data, RE_EXTENDED, &err);
+    if (!re) fatal("invalid regular expression /%s/: %s", pattern->data, err);
+    *c = cell_num(add_regex(re));
+    return re;
+}
+
+/* String value of a cell (new reference), numbers via CONVFMT */
+static Str *to_str_fmt(const Cell *c, int slot) {
+    switch (c->type) {
+    case V_STR:
+    case V_STRNUM: return str_ref(c->s);
+    case V_NUM: {
+        char tmp[512];
+        const Cell *fmt = &globals[slot];
+        size_t n = format_num(tmp, sizeof(tmp), c->num, cell_has_str(fmt) ? fmt->s->data : "%.6g");
+        return str_new(tmp, n < sizeof(tmp) ? n : sizeof(tmp) - 1);
+    }
+    case V_ARRAY: fatal("attempt to use array in a scalar context");
+    }
+    return str_new("", 0);
+}
+
+static inline Str *to_str(const Cell *c) { return to_str_fmt(c, G_CONVFMT); }
+
+static inline int to_bool(const Cell *c) {
+    switch (c->type) {
+    case V_NUM:
+    case V_STRNUM: return c->num != 0;
+    case V_STR: return c->s->len != 0;
+    }
+    return 0;
+}
+
+static Regex *to_regex(Cell *c) {
+    if (c->type == V_REGEX) return regexes[(int)c->num];
+    Str *s = to_str(c);
+    Regex *re = regex_for(s);
+    str_unref(s);
+    return re;
+}
+
+/* ========================================================================== */
+/* Field splitting                                                            */
+/* ========================================================================== */
+
+enum { FS_BLANK, FS_CHAR, FS_EMPTY, FS_REGEX };
+
+typedef struct {
+    int mode;
+    char c;
+    int newline;            /* Paragraph mode: '\n' also separates fields */
+    Regex *re;
+} FieldSep;
+
+static FieldSep field_sep_for(const Str *fs, int paragraph) {
+    FieldSep f;
+    f.mode = FS_BLANK;
+    f.c = 0;
+    f.newline = paragraph;
+    f.re = NULL;
+    if (fs->len == 1 && fs->data[0] == ' ') {
+        f.mode = FS_BLANK;
+    } else if (fs->len == 0) {
+        f.mode = FS_EMPTY;
+    } else if (fs->len == 1 && fs->data[0] != '\\') {
+        f.mode = FS_CHAR;
+        f.c = fs->data[0];
+    } else {
+        f.mode = FS_REGEX;
+        f.re = regex_for((Str *)fs);
+    }
+    return f;
+}
+
+/* Resumable splitter over one string */
+typedef struct {
+    const char *s;
+    size_t len;
+    size_t pos;
+    int done;
+} SplitState;
+
+static void split_init(SplitState *st, const FieldSep *fs, const char *s, size_t len) {
+    st->s = s;
+    st->len = len;
+    st->pos = 0;
+    st->done = fs->mode != FS_BLANK && len == 0;
+}
+
+static inline int is_blank(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+/* Next field as [*start, *start + *flen); returns 0 when there are no more */
+static int split_next(SplitState *st, const FieldSep *fs, size_t *start, size_t *flen) {
+    if (st->done) return 0;
+    const char *s = st->s;
+    size_t len = st->len, p = st->pos;
+
+    switch (fs->mode) {
+    case FS_BLANK:
+        while (p < len && is_blank(s[p])) p++;
+        if (p >= len) { st->done = 1; return 0; }
+        *start = p;
+        while (p < len && !is_blank(s[p])) p++;
+        *flen = p - *start;
+        st->pos = p;
+        return 1;
+    case FS_EMPTY:
+        *start = p;
+        *flen = 1;
+        st->pos = p + 1;
+        st->done = st->pos >= len;
+        return 1;
+    case FS_CHAR: {
+        const char *hit = (const char *)simd_memchr(s + p, fs->c, len - p);
+        if (fs->newline) {
+            const char *nl = (const char *)simd_memchr(s + p, '\n', len - p);
+            if (nl && (!hit || nl < hit)) hit = nl;
+        }
+        *start = p;
+        if (hit) {
+            *flen = (size_t)(hit - s) - p;
+            st->pos = (size_t)(hit - s) + 1;
+        } else {
+            *flen = len - p;
+            st->done = 1;
+        }
+        return 1;
+    }
+    default: {
+        size_t ms, me, from = p;
+        int found;
+        /* Separators must be non-empty */
+        while ((found = re_search(fs->re, s, len, from, &ms, &me)) && me == ms) {
+            if (ms >= len) { found = 0; break; }
+            from = ms + 1;
+        }
+        if (fs->newline && found) {
+            const char *nl = (const char *)simd_memchr(s + p, '\n', ms - p);
+            if (nl) { ms = (size_t)(nl - s); me = ms + 1; }
+        }
+        *start = p;
+        if (found) {
+            *flen = ms - p;
+            st->pos = me;
+        } else {
+            *flen = len - p;
+            st->done = 1;
+        }
+        return 1;
+    }
+    }
+}
+
+/* ========================================================================== */
+/* The current record                                                         */
+/* ========================================================================== */
+
+typedef struct {
+    size_t off, len;        /* In rec.text while the record is unmodified */
+    int has_cell;
+    Cell cell;
+} Field;
+
+static struct {
+    Buf text;               /* $0 */
+    int text_valid;         /* 0 after a field or NF assignment */
+    Str *str;               /* Cached $0 string */
+    Field *f;               /* f[1..nf] */
+    int fcap;
+    int nf;                 /* Fields found so far */
+    int split_all;          /* nf is final */
+    FieldSep fs;            /* FS in effect when the record was read */
+    SplitState st;
+} rec;
+
+static FieldSep current_fs;
+static int paragraph_mode;
+static unsigned long record_version = 1;    /* Changes whenever $0 may have */
+
+static void record_reset_fields(void) {
+    for (int i = 1; i <= rec.nf; i++) {
+        if (rec.f[i].has_cell) cell_free(&rec.f[i].cell);
+    }
+    rec.nf = 0;
+    rec.split_all = 0;
+}
+
+static void fields_reserve(int n) {
+    if (n + 1 > rec.fcap) {
+        int cap = rec.fcap ? rec.fcap : 64;
+        while (cap < n + 1) cap *= 2;
+        rec.f = (Field *)xrealloc(rec.f, cap * sizeof(Field));
+        rec.fcap = cap;
+    }
+}
+
+static void set_record(const char *s, size_t len) {
+    record_reset_fields();
+    rec.text.len = 0;
+    buf_add(&rec.text, s, len);
+    rec.text.p[len] = '\0';
+    rec.text_valid = 1;
+    record_version++;
+    if (rec.str) { str_unref(rec.str); rec.str = NULL; }
+    rec.fs = current_fs;
+    split_init(&rec.st, &rec.fs, rec.text.p, len);
+}
+
+/* Split until field n exists (or the record is exhausted) */
+static void split_until(int n) {
+    while (!rec.split_all && rec.nf < n) {
+        size_t start, len;
+        if (!split_next(&rec.st, &rec.fs, &start, &len)) {
+            rec.split_all = 1;
+            break;
+        }
+        fields_reserve(rec.nf + 1);
+        Field *f = &rec.f[++rec.nf];
+        f->off = start;
+        f->len = len;
+        f->has_cell = 0;
+    }
+}
+
+static inline int record_nf(void) {
+    split_until(0x7fffffff);
+    return rec.nf;
+}
+
+static Cell *field_cell(int i) {
+    Field *f = &rec.f[i];
+    if (!f->has_cell) {
+        f->cell = cell_input(str_new(rec.text.p + f->off, f->len));
+        f->has_cell = 1;
+    }
+    return &f->cell;
+}
+
+/* Rebuild $0 from the fields with OFS */
+static void record_rebuild(void) {
+    static Buf spare;
+    if (rec.text_valid) return;
+    Buf b = spare;
+    b.len = 0;
+    Str *ofs = to_str(&globals[G_OFS]);
+    for (int i = 1; i <= rec.nf; i++) {
+        if (i > 1) buf_add(&b, ofs->data, ofs->len);
+        Str *s = to_str(field_cell(i));
+        buf_add(&b, s->data, s->len);
+        str_unref(s);
+    }
+    str_unref(ofs);
+    buf_reserve(&b, 0);
+    b.p[b.len] = '\0';
+    spare = rec.text;
+    rec.text = b;
+    rec.text_valid = 1;
+}
+
+static Str *record_str(void) {
+    record_rebuild();
+    if (!rec.str) rec.str = str_new(rec.text.p, rec.text.len);
+    return str_ref(rec.str);
+}
+
+static Cell get_field(double d) {
+    if (d < 0) fatal("attempt to access field %g", d);
+    int i = (int)d;
+    if (i == 0) return cell_input(record_str());
+    split_until(i);
+    if (i > rec.nf) {
+        Cell c;
+        c.type = V_UNSET;
+        c.owned = 0;
+        return c;
+    }
+    return cell_copy(field_cell(i));
+}
+
+/* Materialize every field so $0 can be rebuilt from cells */
+static void fields_detach(void) {
+    record_nf();
+    for (int i = 1; i <= rec.nf; i++) field_cell(i);
+}
+
+static void set_nf(int n) {
+    if (n < 0) fatal("NF set to negative value");
+    fields_detach();
+    for (int i = n + 1; i <= rec.nf; i++) cell_free(&rec.f[i].cell);
+    fields_reserve(n);
+    for (int i = rec.nf + 1; i <= n; i++) {
+        rec.f[i].has_cell = 1;
+        rec.f[i].cell = cell_str(str_new("", 0));
+    }
+    rec.nf = n;
+    rec.text_valid = 0;
+    record_version++;
+    if (rec.str) { str_unref(rec.str); rec.str = NULL; }
+}
+
+/* Takes ownership of v */
+static void set_field(double d, Cell v) {
+    if (d < 0) fatal("attempt to access field %g", d);
+    int i = (int)d;
+    if (i == 0) {
+        Str *s = to_str(&v);
+        set_record(s->data, s->len);
+        str_unref(s);
+        cell_free(&v);
+        return;
+    }
+    if (i > record_nf()) set_nf(i);
+    else fields_detach();
+    cell_free(&rec.f[i].cell);
+    rec.f[i].cell = v;
+    rec.f[i].cell.owned = 0;
+    rec.text_valid = 0;
+    record_version++;
+    if (rec.str) { str_unref(rec.str); rec.str = NULL; }
+}
+
+/* ========================================================================== */
+/* Input records                                                              */
+/* ========================================================================== */
+
+enum { RS_NEWLINE, RS_CHAR, RS_PARAGRAPH, RS_REGEX };
+
+static LineReader input;
+static int rs_mode = RS_NEWLINE;
+static char rs_char;
+static Regex *rs_regex;
+static Buf pending;         /* Unconsumed input for the non-newline modes */
+static size_t pending_pos;
+static int input_eof;
+
+static void update_rs(void) {
+    Str *rs = to_str(&globals[G_RS]);
+    paragraph_mode = 0;
+    if (rs->len == 1 && rs->data[0] == '\n') {
+        rs_mode = RS_NEWLINE;
+    } else if (rs->len == 0) {
+        rs_mode = RS_PARAGRAPH;
+        paragraph_mode = 1;
+    } else if (rs->len == 1) {
+        rs_mode = RS_CHAR;
+        rs_char = rs->data[0];
+    } else {
+        rs_mode = RS_REGEX;
+        rs_regex = regex_for(rs);
+    }
+    str_unref(rs);
+}
+
+static void update_fs(void) {
+    Str *fs = to_str(&globals[G_FS]);
+    current_fs = field_sep_for(fs, paragraph_mode);
+    str_unref(fs);
+}
+
+/* Pull another chunk of input into pending; returns 0 at EOF */
+static int pending_fill(void) {
+    if (input_eof) return 0;
+    const char *data;
+    size_t len;
+    if (!line_reader_chunk(&input, &data, &len)) {
+        input_eof = 1;
+        return 0;
+    }
+    if (pending_pos > 0) {
+        memmove(pending.p, pending.p + pending_pos, pending.len - pending_pos);
+        pending.len -= pending_pos;
+        pending_pos = 0;
+    }
+    buf_add(&pending, data, len);
+    return 1;
+}
+
+/* Next record into s and len (valid until the next call); 0 at end */
+static int read_record(const char **s, size_t *len) {
+    if (rs_mode == RS_NEWLINE && pending_pos == pending.len) {
+        char *line;
+        if (!line_reader_next(&input, &line, len)) return 0;
+        *s = line;
+        return 1;
+    }
+
+    if (rs_mode == RS_PARAGRAPH) {
+        /* Leading newlines never start a record */
+        for (;;) {
+            while (pending_pos < pending.len && pending.p[pending_pos] == '\n') pending_pos++;
+            if (pending_pos < pending.len || !pending_fill()) break;
+        }
+    }
+
+    /*
+     * Single-character separators resume scanning where the last chunk
+     * ended; paragraph and regex separators can straddle chunks, so those
+     * rescan the record, and get one final look once EOF is known.
+     */
+    size_t from = 0;
+    int final_pass = 0;
+    for (;;) {
+        const char *base = pending.p + pending_pos;
+        size_t avail = pending.len - pending_pos;
+        size_t sep = 0, sep_end = 0;
+        int found = 0;
+
+        if (rs_mode == RS_NEWLINE || rs_mode == RS_CHAR) {
+            char c = rs_mode == RS_NEWLINE ? '\n' : rs_char;
+            const char *hit = (const char *)simd_memchr(base + from, c, avail - from);
+            if (hit) { found = 1; sep = (size_t)(hit - base); sep_end = sep + 1; }
+            from = avail;
+        } else if (rs_mode == RS_PARAGRAPH) {
+            for (size_t i = 0; i + 1 < avail; i++) {
+                if (base[i] == '\n' && base[i + 1] == '\n') {
+                    size_t j = i + 2;
+                    while (j < avail && base[j] == '\n') j++;
+                    /* More newlines may follow in the next chunk */
+                    if (j == avail && !input_eof) break;
+                    found = 1; sep = i; sep_end = j;
+                    break;
+                }
+            }
+        } else {
+            size_t ms, me;
+            if (re_search(rs_regex, base, avail, 0, &ms, &me) && me > ms &&
+                (me < avail || input_eof)) {
+                found = 1; sep = ms; sep_end = me;
+            }
+        }
+
+        if (found) {
+            *s = base;
+            *len = sep;
+            pending_pos += sep_end;
+            return 1;
+        }
+        if (final_pass) break;
+        if (!pending_fill()) {
+            if (rs_mode == RS_NEWLINE || rs_mode == RS_CHAR) break;
+            final_pass = 1;
+        }
+    }
+
+    if (pending_pos >= pending.len) return 0;
+    *s = pending.p + pending_pos;
+    *len = pending.len - pending_pos;
+    if (rs_mode == RS_PARAGRAPH) {
+        while (*len > 0 && (*s)[*len - 1] == '\n') (*len)--;
+    }
+    pending_pos = pending.len;
+    return 1;
+}
+
+/* ========================================================================== */
+/* Lexer                                                                      */
+/* ========================================================================== */
+
+enum {
+    T_EOF, T_NEWLINE, T_LBRACE, T_RBRACE, T_LPAREN, T_RPAREN, T_LBRACKET, T_RBRACKET,
+    T_SEMI, T_COMMA, T_ADD, T_SUB, T_MUL, T_DIV, T_MOD, T_POW, T_NOT, T_GT, T_LT,
+    T_PIPE, T_QUESTION, T_COLON, T_MATCH, T_NOMATCH, T_DOLLAR, T_ASSIGN, T_ADD_ASSIGN,
+    T_SUB_ASSIGN, T_MUL_ASSIGN, T_DIV_ASSIGN, T_MOD_ASSIGN, T_POW_ASSIGN, T_EQ, T_LE,
+    T_GE, T_NE, T_INCR, T_DECR, T_AND, T_OR, T_APPEND,
+    T_NUMBER, T_STRING, T_ERE, T_NAME, T_FUNC_NAME, T_BUILTIN,
+    T_BEGIN, T_END, T_FUNCTION, T_IF, T_ELSE, T_WHILE, T_FOR, T_DO, T_BREAK,
+    T_CONTINUE, T_NEXT, T_EXIT, T_RETURN, T_DELETE, T_GETLINE, T_PRINT, T_PRINTF, T_IN
+};
+
+enum {
+    B_LENGTH, B_SUBSTR, B_INDEX, B_SPLIT, B_SUB, B_GSUB, B_MATCH, B_SPRINTF,
+    B_SIN, B_COS, B_ATAN2, B_EXP, B_LOG, B_SQRT, B_INT, B_RAND, B_SRAND,
+    B_TOLOWER, B_TOUPPER, B_SYSTEM, B_CLOSE, B_FFLUSH
+};
+
+static const struct { const char *name; int token; int builtin; } keywords[] = {
+    {"BEGIN", T_BEGIN, 0}, {"END", T_END, 0}, {"function", T_FUNCTION, 0},
+    {"func", T_FUNCTION, 0}, {"if", T_IF, 0}, {"else", T_ELSE, 0},
+    {"while", T_WHILE, 0}, {"for", T_FOR, 0}, {"do", T_DO, 0},
+    {"break", T_BREAK, 0}, {"continue", T_CONTINUE, 0}, {"next", T_NEXT, 0},
+    {"exit", T_EXIT, 0}, {"return", T_RETURN, 0}, {"delete", T_DELETE, 0},
+    {"getline", T_GETLINE, 0}, {"print", T_PRINT, 0}, {"printf", T_PRINTF, 0},
+    {"in", T_IN, 0},
+    {"length", T_BUILTIN, B_LENGTH}, {"substr", T_BUILTIN, B_SUBSTR},
+    {"index", T_BUILTIN, B_INDEX}, {"split", T_BUILTIN, B_SPLIT},
+    {"sub", T_BUILTIN, B_SUB}, {"gsub", T_BUILTIN, B_GSUB},
+    {"match", T_BUILTIN, B_MATCH}, {"sprintf", T_BUILTIN, B_SPRINTF},
+    {"sin", T_BUILTIN, B_SIN}, {"cos", T_BUILTIN, B_COS},
+    {"atan2", T_BUILTIN, B_ATAN2}, {"exp", T_BUILTIN, B_EXP},
+    {"log", T_BUILTIN, B_LOG}, {"sqrt", T_BUILTIN, B_SQRT},
+    {"int", T_BUILTIN, B_INT}, {"rand", T_BUILTIN, B_RAND},
+    {"srand", T_BUILTIN, B_SRAND}, {"tolower", T_BUILTIN, B_TOLOWER},
+    {"toupper", T_BUILTIN, B_TOUPPER}, {"system", T_BUILTIN, B_SYSTEM},
+    {"close", T_BUILTIN, B_CLOSE}, {"fflush", T_BUILTIN, B_FFLUSH},
+};
+
+typedef struct {
+    int type;
+    int line;
+    size_t start;           /* Offset of the token in the source */
+    double num;
+    Str *str;               /* T_STRING, T_ERE, names */
+    int builtin;
+} Token;
+
+static const char *src;
+static size_t src_pos;
+static int src_line = 1;
+static Token tok;
+
+static void syntax_error(const char *msg) {
+    out_flush();
+    int line = tok.line;
+    fprintf(stderr, "awk: syntax error at source line %d: %s\n", line, msg);
+    /* Show the offending source line */
+    size_t s = tok.start;
+    while (s > 0 && src[s - 1] != '\n') s--;
+    size_t e = tok.start;
+    while (src[e] && src[e] != '\n') e++;
+    fprintf(stderr, "  %.*s\n", (int)(e - s), src + s);
+    exit(2);
+}
+
+static int read_escape(const char **pp) {
+    const char *p = *pp;
+    int c = *p++;
+    switch (c) {
+    case 'n': c = '\n'; break;
+    case 't': c = '\t'; break;
+    case 'r': c = '\r'; break;
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'v': c = '\v'; break;
+    case 'a': c = '\a'; break;
+    case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+        c -= '0';
+        for (int i = 0; i < 2 && *p >= '0' && *p <= '7'; i++) c = c * 8 + (*p++ - '0');
+        break;
+    }
+    default: break;     /* \" \\ \/ and unknown escapes stand for the character */
+    }
+    *pp = p;
+    return c;
+}
+
+static void next_token(void) {
+    const char *p;
+again:
+    p = src + src_pos;
+    while (*p == ' ' || *p == '\t' || *p == '\r' || (*p == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n')))) {
+        if (*p == '\\') {
+            p += p[1] == '\r' ? 3 : 2;
+            src_line++;
+        } else {
+            p++;
+        }
+    }
+    if (*p == '#') {
+        while (*p && *p != '\n') p++;
+    }
+    src_pos = (size_t)(p - src);
+    tok.start = src_pos;
+    tok.line = src_line;
+    tok.str = NULL;
+
+    char c = *p;
+    if (c == '\0') { tok.type = T_EOF; return; }
+    if (c == '\n') {
+        src_line++;
+        src_pos++;
+        tok.type = T_NEWLINE;
+        return;
+    }
+
+    if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)p[1]))) {
+        char *end;
+        tok.num = strtod(p, &end);
+        /* strtod accepts hex and inf/nan; awk source numbers are decimal */
+        const char *q = p;
+        while (isdigit((unsigned char)*q)) q++;
+        if (*q == '.') { q++; while (isdigit((unsigned char)*q)) q++; }
+        if ((*q == 'e' || *q == 'E') && (isdigit((unsigned char)q[1]) ||
+            ((q[1] == '+' || q[1] == '-') && isdigit((unsigned char)q[2])))) {
+            q += 2;
+            while (isdigit((unsigned char)*q)) q++;
+        }
+        if (end != q) tok.num = strtod(p, NULL), end = (char *)q;
+        char tmp[64];
+        size_t n = (size_t)(q - p) < sizeof(tmp) - 1 ? (size_t)(q - p) : sizeof(tmp) - 1;
+        memcpy(tmp, p, n);
+        tmp[n] = '\0';
+        tok.num = strtod(tmp, NULL);
+        src_pos = (size_t)(q - src);
+        tok.type = T_NUMBER;
+        return;
+    }
+
+    if (isalpha((unsigned char)c) || c == '_') {
+        const char *q = p;
+        while (isalnum((unsigned char)*q) || *q == '_') q++;
+        size_t n = (size_t)(q - p);
+        src_pos = (size_t)(q - src);
+        for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+            if (strlen(keywords[i].name) == n && memcmp(keywords[i].name, p, n) == 0) {
+                tok.type = keywords[i].token;
+                tok.builtin = keywords[i].builtin;
+                return;
+            }
+        }
+        tok.str = str_new(p, n);
+        tok.type = *q == '(' ? T_FUNC_NAME : T_NAME;
+        return;
+    }
+
+    if (c == '"') {
+        Buf b = {0};
+        p++;
+        while (*p != '"') {
+            if (*p == '\0' || *p == '\n') syntax_error("unterminated string");
+            if (*p == '\\' && p[1] == '\n') { p += 2; src_line++; continue; }
+            if (*p == '\\' && p[1]) {
+                p++;
+                buf_addc(&b, (char)read_escape(&p));
+            } else {
+                buf_addc(&b, *p++);
+            }
+        }
+        tok.str = str_new(b.p ? b.p : "", b.len);
+        free(b.p);
+        src_pos = (size_t)(p + 1 - src);
+        tok.type = T_STRING;
+        return;
+    }
+
+    /* Operators, longest first */
+    static const struct { const char *s; int t; } ops[] = {
+        {"**=", T_POW_ASSIGN}, {"&&", T_AND}, {"||", T_OR}, {"==", T_EQ}, {"<=", T_LE},
+        {">=", T_GE}, {"!=", T_NE}, {"++", T_INCR}, {"--", T_DECR}, {"+=", T_ADD_ASSIGN},
+        {"-=", T_SUB_ASSIGN}, {"*=", T_MUL_ASSIGN}, {"/=", T_DIV_ASSIGN}, {"%=", T_MOD_ASSIGN},
+        {"^=", T_POW_ASSIGN}, {"**", T_POW}, {">>", T_APPEND}, {"!~", T_NOMATCH},
+        {"{", T_LBRACE}, {"}", T_RBRACE}, {"(", T_LPAREN}, {")", T_RPAREN},
+        {"[", T_LBRACKET}, {"]", T_RBRACKET}, {";", T_SEMI}, {",", T_COMMA},
+        {"+", T_ADD}, {"-", T_SUB}, {"*", T_MUL}, {"/", T_DIV}, {"%", T_MOD},
+        {"^", T_POW}, {"!", T_NOT}, {">", T_GT}, {"<", T_LT}, {"|", T_PIPE},
+        {"?", T_QUESTION}, {":", T_COLON}, {"~", T_MATCH}, {"$", T_DOLLAR}, {"=", T_ASSIGN},
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        size_t n = strlen(ops[i].s);
+        if (strncmp(p, ops[i].s, n) == 0) {
+            src_pos += n;
+            tok.type = ops[i].t;
+            return;
+        }
+    }
+    tok.type = T_EOF;
+    syntax_error("unexpected character");
+    goto again;
+}
+
+/* Re-read the current '/' or '/=' token as a regex literal */
+static void lex_regex(void) {
+    const char *p = src + tok.start + 1;
+    Buf b = {0};
+    int bracket = 0;
+    while (bracket || *p != '/') {
+        if (*p == '\0' || *p == '\n') syntax_error("unterminated regular expression");
+        if (*p == '\\' && p[1] == '/') {
+            buf_addc(&b, '/');
+            p += 2;
+            continue;
+        }
+        if (*p == '\\' && p[1]) {
+            buf_add(&b, p, 2);
+            p += 2;
+            continue;
+        }
+        if (!bracket && *p == '[') {
+            bracket = 1;
+            buf_addc(&b, *p++);
+            if (*p == '^') buf_addc(&b, *p++);
+            if (*p == ']') buf_addc(&b, *p++);
+            continue;
+        }
+        if (bracket && *p == '[' && p[1] == ':') {
+            const char *close = strstr(p + 2, ":]");
+            if (close) {
+                buf_add(&b, p, (size_t)(close + 2 - p));
+                p = close + 2;
+                continue;
+            }
+        }
+        if (bracket && *p == ']') bracket = 0;
+        buf_addc(&b, *p++);
+    }
+    tok.str = str_new(b.p ? b.p : "", b.len);
+    free(b.p);
+    src_pos = (size_t)(p + 1 - src);
+    tok.type = T_ERE;
+}
+
+/* ========================================================================== */
+/* AST                                                                        */
+/* ========================================================================== */
+
+enum {
+    /* Expressions */
+    N_NUM, N_STR, N_REGEX, N_VAR, N_FIELD, N_INDEX, N_GROUPING, N_ASSIGN, N_COND,
+    N_AND, N_OR, N_NOT, N_NEG, N_PLUS, N_BINARY, N_CONCAT, N_CMP, N_MATCH, N_IN,
+    N_INCDEC, N_CALL, N_BUILTIN, N_GETLINE,
+    /* Statements */
+    S_PRINT, S_PRINTF, S_EXPR, S_IF, S_WHILE, S_DO, S_FOR, S_FORIN, S_BLOCK, S_NEXT,
+    S_EXIT, S_RETURN, S_BREAK, S_CONTINUE, S_DELETE
+};
+
+enum { SCOPE_GLOBAL, SCOPE_LOCAL };
+
+typedef struct Node {
+    int type;
+    int op;                 /* Operator token, builtin id, incdec mode */
+    int line;
+    struct Node *a, *b, *c, *d;
+    struct Node *next;      /* Next item in argument and statement lists */
+    double num;
+    Str *str;
+    int scope, slot;        /* Variables and arrays; function index for calls */
+} Node;
+
+static Node *node_new(int type, int line) {
+    Node *n = (Node *)xmalloc(sizeof(Node));
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    n->line = line;
+    return n;
+}
+
+static Node *node2(int type, int op, Node *a, Node *b) {
+    Node *n = node_new(type, a ? a->line : tok.line);
+    n->op = op;
+    n->a = a;
+    n->b = b;
+    return n;
+}
+
+static int list_length(const Node *n) {
+    int count = 0;
+    for (; n; n = n->next) count++;
+    return count;
+}
+
+typedef struct {
+    Str *name;
+    int nparams;
+    Str **params;
+    uint8_t *param_is_array;
+    Node *body;
+    int defined;
+    int line;
+    size_t code;
+} Func;
+
+static Func *funcs;
+static int nfuncs, funcs_cap;
+static int cur_func = -1;       /* Function being parsed or compiled */
+
+typedef struct Rule {
+    Node *pattern, *pattern2;   /* pattern2 set for range patterns */
+    Node *action;               /* NULL: print $0 */
+    struct Rule *next;
+} Rule;
+
+static Node *begin_actions, *end_actions;
+static Rule *rules;
+
+static int global_slot(const Str *name) {
+    for (int i = 0; i < nglobals; i++) {
+        if (strcmp(global_names[i], name->data) == 0) return i;
+    }
+    if (nglobals == globals_cap) {
+        globals_cap = globals_cap ? globals_cap * 2 : 64;
+        globals = (Cell *)xrealloc(globals, globals_cap * sizeof(Cell));
+        global_names = (char **)xrealloc(global_names, globals_cap * sizeof(char *));
+        global_is_array = (uint8_t *)xrealloc(global_is_array, globals_cap);
+    }
+    globals[nglobals].type = V_UNSET;
+    globals[nglobals].owned = 0;
+    global_names[nglobals] = strdup(name->data);
+    global_is_array[nglobals] = 0;
+    return nglobals++;
+}
+
+static int func_index(const Str *name) {
+    for (int i = 0; i < nfuncs; i++) {
+        if (strcmp(funcs[i].name->data, name->data) == 0) return i;
+    }
+    if (nfuncs == funcs_cap) {
+        funcs_cap = funcs_cap ? funcs_cap * 2 : 16;
+        funcs = (Func *)xrealloc(funcs, funcs_cap * sizeof(Func));
+    }
+    memset(&funcs[nfuncs], 0, sizeof(Func));
+    funcs[nfuncs].name = str_ref((Str *)name);
+    return nfuncs++;
+}
+
+/* Resolve a variable name to a parameter of the current function or a global */
+static void resolve_name(Node *n, Str *name) {
+    n->str = name;
+    if (cur_func >= 0) {
+        Func *f = &funcs[cur_func];
+        for (int i = 0; i < f->nparams; i++) {
+            if (strcmp(f->params[i]->data, name->data) == 0) {
+                n->scope = SCOPE_LOCAL;
+                n->slot = i;
+                return;
+            }
+        }
+    }
+    n->scope = SCOPE_GLOBAL;
+    n->slot = global_slot(name);
+}
+
+/* ========================================================================== */
+/* Parser                                                                     */
+/* ========================================================================== */
+
+static int no_gt;               /* Inside unparenthesized print arguments */
+
+static Node *parse_expr(void);
+static Node *parse_ternary(void);
+static Node *parse_concat(void);
+static Node *parse_unary(void);
+static Node *parse_primary(void);
+static Node *parse_statement(void);
+
+static void expect(int type, const char *what) {
+    if (tok.type != type) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "expected %s", what);
+        syntax_error(msg);
+    }
+    next_token();
+}
+
+static void skip_newlines(void) {
+    while (tok.type == T_NEWLINE) next_token();
+}
+
+static void skip_terminators(void) {
+    while (tok.type == T_NEWLINE || tok.type == T_SEMI) next_token();
+}
+
+static int is_lvalue(const Node *n) {
+    return n->type == N_VAR || n->type == N_FIELD || n->type == N_INDEX;
+}
+
+/* Comma-separated expressions, newlines allowed after commas */
+static Node *parse_expr_list(int *count) {
+    Node *head = parse_expr(), *tail = head;
+    int n = 1;
+    while (tok.type == T_COMMA) {
+        next_token();
+        skip_newlines();
+        tail->next = parse_expr();
+        tail = tail->next;
+        n++;
+    }
+    if (count) *count = n;
+    return head;
+}
+
+static Node *parse_array_ref(Str *name, int line) {
+    Node *n = node_new(N_VAR, line);
+    resolve_name(n, name);
+    return n;
+}
+
+static Node *parse_lvalue_primary(void) {
+    Node *n = parse_primary();
+    if (!is_lvalue(n)) syntax_error("expected a variable, field or array element");
+    return n;
+}
+
+static Node *parse_primary(void) {
+    int line = tok.line;
+    Node *n;
+
+    switch (tok.type) {
+    case T_NUMBER:
+        n = node_new(N_NUM, line);
+        n->num = tok.num;
+        next_token();
+        return n;
+    case T_STRING:
+        n = node_new(N_STR, line);
+        n->str = tok.str;
+        next_token();
+        return n;
+    case T_DIV:
+    case T_DIV_ASSIGN: {
+        lex_regex();
+        const char *err;
+        Regex *re = re_compile(tok.str->data, RE_EXTENDED, &err);
+        if (!re) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "invalid regular expression /%s/: %s", tok.str->data, err);
+            syntax_error(msg);
+        }
+        n = node_new(N_REGEX, line);
+        n->str = tok.str;
+        n->slot = add_regex(re);
+        next_token();
+        return n;
+    }
+    case T_LPAREN: {
+        int saved = no_gt;
+        no_gt = 0;
+        next_token();
+        int count;
+        Node *list = parse_expr_list(&count);
+        expect(T_RPAREN, "')'");
+        no_gt = saved;
+        if (count == 1) return list;
+        if (tok.type == T_IN) {
+            next_token();
+            if (tok.type != T_NAME) syntax_error("expected array name after 'in'");
+            n = node_new(N_IN, line);
+            n->a = list;
+            n->b = parse_array_ref(tok.str, tok.line);
+            next_token();
+            return n;
+        }
+        n = node_new(N_GROUPING, line);
+        n->a = list;
+        return n;
+    }
+    case T_DOLLAR:
+        next_token();
+        n = node_new(N_FIELD, line);
+        if (tok.type == T_INCR || tok.type == T_DECR || tok.type == T_SUB ||
+            tok.type == T_ADD || tok.type == T_NOT) {
+            n->a = parse_unary();
+        } else {
+            n->a = parse_primary();
+        }
+        return n;
+    case T_INCR:
+    case T_DECR: {
+        int op = tok.type;
+        next_token();
+        n = node_new(N_INCDEC, line);
+        n->op = op == T_INCR ? 0 : 1;   /* pre-increment / pre-decrement */
+        n->a = parse_lvalue_primary();
+        return n;
+    }
+    case T_SUB:
+    case T_ADD:
+    case T_NOT:
+        return parse_unary();
+    case T_NAME: {
+        Str *name = tok.str;
+        next_token();
+        if (tok.type == T_LBRACKET) {
+            next_token();
+            n = node_new(N_INDEX, line);
+            resolve_name(n, name);
+            n->a = parse_expr_list(NULL);
+            expect(T_RBRACKET, "']'");
+            return n;
+        }
+        n = node_new(N_VAR, line);
+        resolve_name(n, name);
+        return n;
+    }
+    case T_FUNC_NAME: {
+        n = node_new(N_CALL, line);
+        n->str = tok.str;
+        n->slot = func_index(tok.str);
+        next_token();
+        expect(T_LPAREN, "'('");
+        skip_newlines();
+        if (tok.type != T_RPAREN) n->a = parse_expr_list(NULL);
+        skip_newlines();
+        expect(T_RPAREN, "')'");
+        return n;
+    }
+    case T_BUILTIN: {
+        n = node_new(N_BUILTIN, line);
+        n->op = tok.builtin;
+        next_token();
+        if (tok.type == T_LPAREN) {
+            next_token();
+            skip_newlines();
+            int saved = no_gt;
+            no_gt = 0;
+            if (tok.type != T_RPAREN) n->a = parse_expr_list(NULL);
+            no_gt = saved;
+            skip_newlines();
+            expect(T_RPAREN, "')'");
+        } else if (n->op != B_LENGTH) {
+            syntax_error("expected '(' after built-in function name");
+        }
+        return n;
+    }
+    case T_GETLINE:
+        next_token();
+        n = node_new(N_GETLINE, line);
+        if (tok.type == T_DOLLAR || tok.type == T_NAME) n->a = parse_lvalue_primary();
+        if (tok.type == T_LT) syntax_error("getline from a file is not supported");
+        return n;
+    default:
+        syntax_error("unexpected token in expression");
+        return NULL;
+    }
+}
+
+static Node *parse_postfix(void) {
+    Node *n = parse_primary();
+    if (is_lvalue(n) && (tok.type == T_INCR || tok.type == T_DECR)) {
+        Node *p = node_new(N_INCDEC, n->line);
+        p->op = tok.type == T_INCR ? 2 : 3;     /* post-increment / post-decrement */
+        p->a = n;
+        next_token();
+        return p;
+    }
+    return n;
+}
+
+static Node *parse_pow(void) {
+    Node *base = parse_postfix();
+    if (tok.type == T_POW) {
+        next_token();
+        return node2(N_BINARY, T_POW, base, parse_unary());
+    }
+    return base;
+}
+
+static Node *parse_unary(void) {
+    int line = tok.line;
+    if (tok.type == T_NOT || tok.type == T_SUB || tok.type == T_ADD) {
+        int t = tok.type;
+        next_token();
+        Node *n = node_new(t == T_NOT ? N_NOT : t == T_SUB ? N_NEG : N_PLUS, line);
+        n->a = parse_unary();
+        return n;
+    }
+    return parse_pow();
+}
+
+static Node *parse_mul(void) {
+    Node *l = parse_unary();
+    while (tok.type == T_MUL || tok.type == T_DIV || tok.type == T_MOD) {
+        int op = tok.type;
+        next_token();
+        l = node2(N_BINARY, op, l, parse_unary());
+    }
+    return l;
+}
+
+static Node *parse_additive(void) {
+    Node *l = parse_mul();
+    while (tok.type == T_ADD || tok.type == T_SUB) {
+        int op = tok.type;
+        next_token();
+        l = node2(N_BINARY, op, l, parse_mul());
+    }
+    return l;
+}
+
+/* Tokens that can start the right operand of a concatenation */
+static int starts_concat(int t) {
+    switch (t) {
+    case T_NUMBER: case T_STRING: case T_DIV: case T_DIV_ASSIGN: case T_NAME:
+    case T_FUNC_NAME: case T_BUILTIN: case T_DOLLAR: case T_NOT: case T_LPAREN:
+    case T_SUB: case T_ADD: case T_INCR: case T_DECR:
+        return 1;
+    }
+    return 0;
+}
+
+static Node *parse_concat(void) {
+    Node *l = parse_additive();
+    /* '-' and '+' were taken by parse_additive, '/' by parse_mul */
+    while (starts_concat(tok.type) && tok.type != T_SUB && tok.type != T_ADD &&
+           tok.type != T_DIV && tok.type != T_DIV_ASSIGN && tok.type != T_NOT) {
+        l = node2(N_CONCAT, 0, l, parse_additive());
+    }
+    return l;
+}
+
+static Node *parse_comparison(void) {
+    Node *l = parse_concat();
+    int t = tok.type;
+    if (t == T_LT || t == T_LE || t == T_EQ || t == T_NE || t == T_GE || (t == T_GT && !no_gt)) {
+        next_token();
+        l = node2(N_CMP, t, l, parse_concat());
+    }
+    return l;
+}
+
+static Node *parse_match(void) {
+    Node *l = parse_comparison();
+    while (tok.type == T_MATCH || tok.type == T_NOMATCH) {
+        int op = tok.type;
+        next_token();
+        l = node2(N_MATCH, op, l, parse_comparison());
+    }
+    return l;
+}
+
+static Node *parse_in(void) {
+    Node *l = parse_match();
+    while (tok.type == T_IN) {
+        next_token();
+        if (tok.type != T_NAME) syntax_error("expected array name after 'in'");
+        Node *n = node_new(N_IN, l->line);
+        n->a = l;
+        n->b = parse_array_ref(tok.str, tok.line);
+        next_token();
+        l = n;
+    }
+    return l;
+}
+
+static Node *parse_and(void) {
+    Node *l = parse_in();
+    while (tok.type == T_AND) {
+        next_token();
+        skip_newlines();
+        l = node2(N_AND, 0, l, parse_in());
+    }
+    return l;
+}
+
+static Node *parse_or(void) {
+    Node *l = parse_and();
+    while (tok.type == T_OR) {
+        next_token();
+        skip_newlines();
+        l = node2(N_OR, 0, l, parse_and());
+    }
+    return l;
+}
+
+static Node *parse_ternary(void) {
+    Node *c = parse_or();
+    if (tok.type != T_QUESTION) return c;
+    next_token();
+    skip_newlines();
+    Node *n = node_new(N_COND, c->line);
+    n->a = c;
+    n->b = parse_expr();
+    skip_newlines();
+    expect(T_COLON, "':'");
+    skip_newlines();
+    n->c = parse_expr();
+    return n;
+}
+
+static int assign_op(int t) {
+    switch (t) {
+    case T_ASSIGN: return 0;
+    case T_ADD_ASSIGN: return T_ADD;
+    case T_SUB_ASSIGN: return T_SUB;
+    case T_MUL_ASSIGN: return T_MUL;
+    case T_DIV_ASSIGN: return T_DIV;
+    case T_MOD_ASSIGN: return T_MOD;
+    case T_POW_ASSIGN: return T_POW;
+    }
+    return -1;
+}
+
+static Node *parse_expr(void) {
+    Node *l = parse_ternary();
+    if (tok.type == T_PIPE && !no_gt) syntax_error("pipes are not supported");
+    int op = assign_op(tok.type);
+    if (op >= 0 && is_lvalue(l)) {
+        next_token();
+        skip_newlines();
+        return node2(N_ASSIGN, op, l, parse_expr());
+    }
+    return l;
+}
+
+static void end_simple_statement(void) {
+    if (tok.type == T_SEMI || tok.type == T_NEWLINE) {
+        next_token();
+    } else if (tok.type != T_RBRACE && tok.type != T_EOF) {
+        syntax_error("expected ';' or newline after statement");
+    }
+}
+
+static Node *parse_print(int type, int line) {
+    Node *n = node_new(type, line);
+    next_token();
+    if (tok.type != T_SEMI && tok.type != T_NEWLINE && tok.type != T_RBRACE &&
+        tok.type != T_GT && tok.type != T_APPEND && tok.type != T_PIPE && tok.type != T_EOF) {
+        no_gt++;
+        n->a = parse_expr_list(NULL);
+        no_gt--;
+        if (!n->a->next && n->a->type == N_GROUPING) n->a = n->a->a;
+    }
+    if (type == S_PRINTF && !n->a) syntax_error("printf needs a format");
+    if (tok.type == T_GT || tok.type == T_APPEND || tok.type == T_PIPE) {
+        if (tok.type == T_PIPE) syntax_error("output pipes are not supported");
+        n->op = tok.type;
+        next_token();
+        no_gt++;
+        n->b = parse_concat();
+        no_gt--;
+    }
+    return n;
+}
+
+/* print, printf, delete or an expression */
+static Node *parse_simple_statement(void) {
+    int line = tok.line;
+    Node *n;
+    if (tok.type == T_PRINT) return parse_print(S_PRINT, line);
+    if (tok.type == T_PRINTF) return parse_print(S_PRINTF, line);
+    if (tok.type == T_DELETE) {
+        next_token();
+        if (tok.type != T_NAME) syntax_error("expected array name after 'delete'");
+        n = node_new(S_DELETE, line);
+        n->b = parse_array_ref(tok.str, tok.line);
+        next_token();
+        if (tok.type == T_LBRACKET) {
+            next_token();
+            n->a = parse_expr_list(NULL);
+            expect(T_RBRACKET, "']'");
+        }
+        return n;
+    }
+    n = node_new(S_EXPR, line);
+    n->a = parse_expr();
+    return n;
+}
+
+static Node *parse_block(void) {
+    Node *block = node_new(S_BLOCK, tok.line), *tail = NULL;
+    expect(T_LBRACE, "'{'");
+    skip_terminators();
+    while (tok.type != T_RBRACE) {
+        if (tok.type == T_EOF) syntax_error("unexpected end of program, missing '}'");
+        Node *s = parse_statement();
+        if (s) {
+            if (tail) tail->next = s;
+            else block->a = s;
+            tail = s;
+        }
+        skip_terminators();
+    }
+    next_token();
+    return block;
+}
+
+/* Body of if/while/for: a statement, or ';' for an empty one */
+static Node *parse_body(void) {
+    if (tok.type == T_SEMI) {
+        next_token();
+        return node_new(S_BLOCK, tok.line);
+    }
+    skip_newlines();
+    return parse_statement();
+}
+
+static Node *parse_statement(void) {
+    int line = tok.line;
+    Node *n;
+
+    switch (tok.type) {
+    case T_LBRACE:
+        return parse_block();
+    case T_SEMI:
+        next_token();
+        return NULL;
+    case T_IF:
+        next_token();
+        n = node_new(S_IF, line);
+        expect(T_LPAREN, "'('");
+        n->a = parse_expr();
+        expect(T_RPAREN, "')'");
+        n->b = parse_body();
+        /* else may follow after newlines or a ';' */
+        {
+            size_t save_pos = src_pos;
+            int save_line = src_line;
+            Token save_tok = tok;
+            skip_terminators();
+            if (tok.type == T_ELSE) {
+                next_token();
+                skip_newlines();
+                n->c = parse_statement();
+            } else {
+                src_pos = save_pos;
+                src_line = save_line;
+                tok = save_tok;
+            }
+        }
+        return n;
+    case T_WHILE:
+        next_token();
+        n = node_new(S_WHILE, line);
+        expect(T_LPAREN, "'('");
+        n->a = parse_expr();
+        expect(T_RPAREN, "')'");
+        n->b = parse_body();
+        return n;
+    case T_DO:
+        next_token();
+        skip_newlines();
+        n = node_new(S_DO, line);
+        n->b = parse_statement();
+        skip_terminators();
+        expect(T_WHILE, "'while' after do body");
+        expect(T_LPAREN, "'('");
+        n->a = parse_expr();
+        expect(T_RPAREN, "')'");
+        end_simple_statement();
+        return n;
+    case T_FOR: {
+        next_token();
+        expect(T_LPAREN, "'('");
+        /* for (name in array) needs two tokens of lookahead */
+        if (tok.type == T_NAME) {
+            size_t save_pos = src_pos;
+            int save_line = src_line;
+            Token save_tok = tok;
+            next_token();
+            if (tok.type == T_IN) {
+                next_token();
+                if (tok.type == T_NAME) {
+                    Str *array = tok.str;
+                    int array_line = tok.line;
+                    next_token();
+                    if (tok.type == T_RPAREN) {
+                        next_token();
+                        n = node_new(S_FORIN, line);
+                        n->a = parse_array_ref(save_tok.str, save_tok.line);
+                        n->b = parse_array_ref(array, array_line);
+                        n->c = parse_body();
+                        return n;
+                    }
+                }
+            }
+            src_pos = save_pos;
+            src_line = save_line;
+            tok = save_tok;
+        }
+        n = node_new(S_FOR, line);
+        if (tok.type != T_SEMI) n->a = parse_simple_statement();
+        expect(T_SEMI, "';'");
+        skip_newlines();
+        if (tok.type != T_SEMI) n->b = parse_expr();
+        expect(T_SEMI, "';'");
+        skip_newlines();
+        if (tok.type != T_RPAREN) n->c = parse_simple_statement();
+        expect(T_RPAREN, "')'");
+        n->d = parse_body();
+        return n;
+    }
+    case T_BREAK:
+    case T_CONTINUE:
+    case T_NEXT:
+        n = node_new(tok.type == T_BREAK ? S_BREAK : tok.type == T_CONTINUE ? S_CONTINUE : S_NEXT, line);
+        if (n->type == S_NEXT && cur_func < 0 && !rules) {
+            /* Checked again at compile time for BEGIN/END */
+        }
+        next_token();
+        end_simple_statement();
+        return n;
+    case T_EXIT:
+    case T_RETURN:
+        n = node_new(tok.type == T_EXIT ? S_EXIT : S_RETURN, line);
+        if (n->type == S_RETURN && cur_func < 0) syntax_error("return outside a function");
+        next_token();
+        if (tok.type != T_SEMI && tok.type != T_NEWLINE && tok.type != T_RBRACE && tok.type != T_EOF) {
+            n->a = parse_expr();
+        }
+        end_simple_statement();
+        return n;
+    default:
+        n = parse_simple_statement();
+        end_simple_statement();
+        return n;
+    }
+}
+
+static void parse_function(void) {
+    next_token();
+    if (tok.type != T_NAME && tok.type != T_FUNC_NAME) syntax_error("expected function name");
+    int fi = func_index(tok.str);
+    Func *f = &funcs[fi];
+    if (f->defined) syntax_error("function defined twice");
+    f->defined = 1;
+    f->line = tok.line;
+    next_token();
+    expect(T_LPAREN, "'('");
+    skip_newlines();
+    while (tok.type == T_NAME) {
+        f = &funcs[fi];
+        f->params = (Str **)xrealloc(f->params, (f->nparams + 1) * sizeof(Str *));
+        f->params[f->nparams++] = tok.str;
+        next_token();
+        skip_newlines();
+        if (tok.type != T_COMMA) break;
+        next_token();
+        skip_newlines();
+    }
+    expect(T_RPAREN, "')'");
+    skip_newlines();
+    f = &funcs[fi];
+    f->param_is_array = (uint8_t *)xmalloc(f->nparams + 1);
+    memset(f->param_is_array, 0, f->nparams + 1);
+    cur_func = fi;
+    Node *body = parse_block();
+    funcs[fi].body = body;
+    cur_func = -1;
+}
+
+static void append_action(Node **list, Node *block) {
+    while (*list) list = &(*list)->next;
+    *list = block;
+}
+
+static void parse_program(void) {
+    Rule **rule_tail = &rules;
+    next_token();
+    skip_terminators();
+    while (tok.type != T_EOF) {
+        if (tok.type == T_FUNCTION) {
+            parse_function();
+        } else if (tok.type == T_BEGIN || tok.type == T_END) {
+            int begin = tok.type == T_BEGIN;
+            next_token();
+            skip_newlines();
+            if (tok.type != T_LBRACE) syntax_error(begin ? "BEGIN needs an action" : "END needs an action");
+            append_action(begin ? &begin_actions : &end_actions, parse_block());
+        } else {
+            Rule *r = (Rule *)xmalloc(sizeof(Rule));
+            memset(r, 0, sizeof(*r));
+            if (tok.type != T_LBRACE) {
+                r->pattern = parse_expr();
+                if (tok.type == T_COMMA) {
+                    next_token();
+                    skip_newlines();
+                    r->pattern2 = parse_expr();
+                }
+            }
+            if (tok.type == T_LBRACE) r->action = parse_block();
+            *rule_tail = r;
+            rule_tail = &r->next;
+        }
+        if (tok.type != T_EOF && tok.type != T_NEWLINE && tok.type != T_SEMI &&
+            tok.type != T_FUNCTION && tok.type != T_BEGIN && tok.type != T_END &&
+            tok.type != T_LBRACE && !starts_concat(tok.type)) {
+            syntax_error("unexpected token after rule");
+        }
+        skip_terminators();
+    }
+}
+
+/* ========================================================================== */
+/* Array inference                                                            */
+/* ========================================================================== */
+
+/*
+ * A name is an array when it is subscripted, used with 'in', iterated,
+ * deleted, passed as split()'s target or passed to a function parameter
+ * that is an array. Function parameters are inferred the same way, and
+ * the whole program is re-scanned until nothing changes, because calls
+ * can precede definitions.
+ */
+static int inference_changed;
+
+static int name_is_array(const Node *n) {
+    if (n->scope == SCOPE_LOCAL) return funcs[cur_func].param_is_array[n->slot];
+    return global_is_array[n->slot];
+}
+
+static void mark_array(const Node *n) {
+    if (name_is_array(n)) return;
+    if (n->scope == SCOPE_LOCAL) funcs[cur_func].param_is_array[n->slot] = 1;
+    else global_is_array[n->slot] = 1;
+    inference_changed = 1;
+}
+
+static void infer(Node *n) {
+    for (; n; n = n->next) {
+        switch (n->type) {
+        case N_INDEX:
+            mark_array(n);
+            break;
+        case N_IN:
+        case S_FORIN:
+        case S_DELETE:
+            mark_array(n->b);
+            break;
+        case N_BUILTIN:
+            if (n->op == B_SPLIT && n->a && n->a->next && n->a->next->type == N_VAR) {
+                mark_array(n->a->next);
+            }
+            break;
+        case N_CALL: {
+            Func *f = &funcs[n->slot];
+            int i = 0;
+            for (Node *arg = n->a; arg; arg = arg->next, i++) {
+                if (arg->type == N_VAR && i < f->nparams && f->param_is_array[i]) mark_array(arg);
+            }
+            break;
+        }
+        }
+        infer(n->a);
+        infer(n->b);
+        infer(n->c);
+        infer(n->d);
+    }
+}
+
+static void infer_arrays(void) {
+    do {
+        inference_changed = 0;
+        cur_func = -1;
+        infer(begin_actions);
+        infer(end_actions);
+        for (Rule *r = rules; r; r = r->next) {
+            infer(r->pattern);
+            infer(r->pattern2);
+            infer(r->action);
+        }
+        for (int i = 0; i < nfuncs; i++) {
+            cur_func = i;
+            infer(funcs[i].body);
+        }
+        cur_func = -1;
+    } while (inference_changed);
+}
+
+/* ========================================================================== */
+/* Bytecode                                                                   */
+/* ========================================================================== */
+
+/*
+ * Stack machine. Instructions are int32 words followed by their operands.
+ * Assignment targets ("lvalues") are described by a kind and a slot; the
+ * array subscript or field number, when there is one, is on the stack
+ * below the value.
+ */
+enum {
+    LV_NONE, LV_GLOBAL, LV_LOCAL, LV_FIELD, LV_GARRAY, LV_LARRAY
+};
+
+enum {
+    OP_HALT,
+    OP_PUSH_NUM,        /* k */
+    OP_PUSH_STR,        /* k */
+    OP_PUSH_REGEX,      /* re */
+    OP_PUSH_UNSET,
+    OP_POP,
+    OP_GET_GLOBAL,      /* slot */
+    OP_GET_LOCAL,       /* slot */
+    OP_GET_FIELD,       /* pops field number */
+    OP_GET_FIELD_CONST, /* n */
+    OP_INDEX,           /* kind slot; pops key */
+    OP_MAKE_KEY,        /* n; joins n subscripts with SUBSEP */
+    OP_ASSIGN,          /* kind slot; pops value (and key/field) */
+    OP_AUG_ASSIGN,      /* kind slot op */
+    OP_INCDEC,          /* kind slot mode */
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW,
+    OP_NEG, OP_PLUS, OP_NOT, OP_BOOL,
+    OP_CONCAT,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+    OP_MATCH,           /* pops regex, string */
+    OP_MATCH_STATIC,    /* re; pops string */
+    OP_MATCH_RECORD,    /* re; matches $0 */
+    OP_MATCH_LITERAL,   /* id; $0 contains rule literal id */
+    OP_IN,              /* kind slot; pops key */
+    OP_JUMP,            /* addr */
+    OP_JUMP_FALSE,      /* addr; pops */
+    OP_JUMP_TRUE,       /* addr; pops */
+    OP_RANGE_ACTIVE,    /* id addr: jump if range id is active */
+    OP_RANGE_SET,       /* id value */
+    OP_PRINT,           /* nargs dest */
+    OP_PRINTF,          /* nargs dest */
+    OP_CALL,            /* func nargs */
+    OP_RETURN,          /* pops return value */
+    OP_ARRAY_REF,       /* kind slot; pushes the array itself */
+    OP_BUILTIN,         /* id nargs */
+    OP_LENGTH_ARRAY,    /* kind slot */
+    OP_SPLIT,           /* kind slot has_fs */
+    OP_SUBST,           /* kind slot global */
+    OP_GETLINE,         /* kind slot */
+    OP_DELETE,          /* kind slot; pops key */
+    OP_DELETE_ALL,      /* kind slot */
+    OP_FORIN_START,     /* kind slot */
+    OP_FORIN_NEXT,      /* kind slot addr: assign the next key or jump */
+    OP_FORIN_END,
+    OP_NEXT,
+    OP_EXIT,            /* has_value */
+};
+
+static int32_t *code;
+static size_t ncode, code_cap;
+static double *num_consts;
+static int nnum_consts, num_consts_cap;
+static Str **str_consts;
+static int nstr_consts, str_consts_cap;
+static int nranges;
+
+static size_t emit(int32_t word) {
+    if (ncode == code_cap) {
+        code_cap = code_cap ? code_cap * 2 : 1024;
+        code = (int32_t *)xrealloc(code, code_cap * sizeof(int32_t));
+    }
+    code[ncode] = word;
+    return ncode++;
+}
+
+static void emit1(int op, int32_t a) { emit(op); emit(a); }
+static void emit2(int op, int32_t a, int32_t b) { emit(op); emit(a); emit(b); }
+
+static void emit_num(double d) {
+    if (nnum_consts == num_consts_cap) {
+        num_consts_cap = num_consts_cap ? num_consts_cap * 2 : 64;
+        num_consts = (double *)xrealloc(num_consts, num_consts_cap * sizeof(double));
+    }
+    num_consts[nnum_consts] = d;
+    emit1(OP_PUSH_NUM, nnum_consts++);
+}
+
+static void emit_str(Str *s) {
+    if (nstr_consts == str_consts_cap) {
+        str_consts_cap = str_consts_cap ? str_consts_cap * 2 : 64;
+        str_consts = (Str **)xrealloc(str_consts, str_consts_cap * sizeof(Str *));
+    }
+    str_consts[nstr_consts] = s;
+    emit1(OP_PUSH_STR, nstr_consts++);
+}
+
+/* Emit a jump and return the operand position to patch */
+static size_t emit_jump(int op) {
+    emit(op);
+    return emit(0);
+}
+
+static void patch(size_t at) { code[at] = (int32_t)ncode; }
+
+/* Break/continue targets for the innermost loop */
+typedef struct {
+    size_t *breaks;
+    int nbreaks;
+    size_t continue_to;
+    size_t *continues;
+    int ncontinues;
+} Loop;
+
+static Loop loops[256];
+static int nloops;
+static int in_main_rules;       /* 'next' allowed */
+
+static void compile_error(const Node *n, const char *msg) {
+    out_flush();
+    fprintf(stderr, "awk: error at source line %d: %s\n", n->line, msg);
+    exit(2);
+}
+
+static void compile_expr(Node *n);
+static void compile_statements(Node *n);
+
+static int array_kind(const Node *n) { return n->scope == SCOPE_LOCAL ? LV_LARRAY : LV_GARRAY; }
 
-// Split line into fields
-void split_line(char *line) {
-    nf = 0;
-    char *p = line;
+static void check_array(const Node *n) {
+    if (!name_is_array(n)) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "can't use scalar %s as an array", n->str->data);
+        compile_error(n, msg);
+    }
+}
+
+/* Push an array subscript (a single key or a SUBSEP-joined list) */
+static void compile_key(Node *list) {
+    int n = 0;
+    for (Node *e = list; e; e = e->next, n++) compile_expr(e);
+    if (n > 1) emit1(OP_MAKE_KEY, n);
+}
+
+/* Push whatever the lvalue needs on the stack and describe it */
+static void compile_lvalue(Node *n, int *kind, int *slot) {
+    switch (n->type) {
+    case N_VAR:
+        if (name_is_array(n)) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "can't assign to array %s", n->str->data);
+            compile_error(n, msg);
+        }
+        *kind = n->scope == SCOPE_LOCAL ? LV_LOCAL : LV_GLOBAL;
+        *slot = n->slot;
+        break;
+    case N_INDEX:
+        compile_key(n->a);
+        *kind = array_kind(n);
+        *slot = n->slot;
+        break;
+    case N_FIELD:
+        compile_expr(n->a);
+        *kind = LV_FIELD;
+        *slot = 0;
+        break;
+    default:
+        compile_error(n, "assignment to something that is not a variable");
+    }
+}
 
-    while (*p && nf < MAX_FIELDS) {
-        // Skip separators
-        while (*p && strchr(field_sep, *p)) p++;
-        if (!*p) break;
+/* Regex-valued argument: a literal compiles to the regex itself */
+static void compile_regex_arg(Node *n) {
+    if (n->type == N_REGEX) emit1(OP_PUSH_REGEX, n->slot);
+    else compile_expr(n);
+}
+
+static void compile_builtin(Node *n) {
+    int nargs = list_length(n->a);
+    Node *a0 = n->a, *a1 = a0 ? a0->next : NULL, *a2 = a1 ? a1->next : NULL;
+    static const struct { int min, max; } arity[] = {
+        [B_LENGTH] = {0, 1}, [B_SUBSTR] = {2, 3}, [B_INDEX] = {2, 2}, [B_SPLIT] = {2, 3},
+        [B_SUB] = {2, 3}, [B_GSUB] = {2, 3}, [B_MATCH] = {2, 2}, [B_SPRINTF] = {1, 255},
+        [B_SIN] = {1, 1}, [B_COS] = {1, 1}, [B_ATAN2] = {2, 2}, [B_EXP] = {1, 1},
+        [B_LOG] = {1, 1}, [B_SQRT] = {1, 1}, [B_INT] = {1, 1}, [B_RAND] = {0, 0},
+        [B_SRAND] = {0, 1}, [B_TOLOWER] = {1, 1}, [B_TOUPPER] = {1, 1},
+        [B_SYSTEM] = {1, 1}, [B_CLOSE] = {1, 1}, [B_FFLUSH] = {0, 1},
+    };
+    if (nargs < arity[n->op].min || nargs > arity[n->op].max) {
+        compile_error(n, "wrong number of arguments to built-in function");
+    }
 
-        fields[nf++] = p;
+    int kind, slot;
+    switch (n->op) {
+    case B_LENGTH:
+        if (a0 && a0->type == N_VAR && name_is_array(a0)) {
+            emit2(OP_LENGTH_ARRAY, array_kind(a0), a0->slot);
+            return;
+        }
+        if (!a0) emit1(OP_GET_FIELD_CONST, 0);
+        else compile_expr(a0);
+        emit2(OP_BUILTIN, B_LENGTH, 1);
+        return;
+    case B_SPLIT:
+        if (a1->type != N_VAR) compile_error(n, "split: second argument must be an array name");
+        compile_expr(a0);
+        if (a2) compile_regex_arg(a2);
+        emit(OP_SPLIT);
+        emit(array_kind(a1));
+        emit(a1->slot);
+        emit(a2 != NULL);
+        return;
+    case B_SUB:
+    case B_GSUB:
+        compile_regex_arg(a0);
+        compile_expr(a1);
+        if (a2) {
+            if (!is_lvalue(a2)) compile_error(n, "sub/gsub: third argument must be a variable, field or array element");
+            compile_lvalue(a2, &kind, &slot);
+        } else {
+            emit_num(0);
+            kind = LV_FIELD;
+            slot = 0;
+        }
+        emit(OP_SUBST);
+        emit(kind);
+        emit(slot);
+        emit(n->op == B_GSUB);
+        return;
+    case B_MATCH:
+        compile_expr(a0);
+        compile_regex_arg(a1);
+        emit2(OP_BUILTIN, B_MATCH, 2);
+        return;
+    default:
+        for (Node *a = n->a; a; a = a->next) compile_expr(a);
+        emit2(OP_BUILTIN, n->op, nargs);
+        return;
+    }
+}
 
-        // Find end of field
-        while (*p && !strchr(field_sep, *p)) p++;
-        if (*p) *p++ = '\0';
+static void compile_call(Node *n) {
+    Func *f = &funcs[n->slot];
+    if (!f->defined) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "function %s is never defined", f->name->data);
+        compile_error(n, msg);
+    }
+    int nargs = list_length(n->a);
+    if (nargs > f->nparams) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "function %s called with %d arguments, accepts only %d",
+                 f->name->data, nargs, f->nparams);
+        compile_error(n, msg);
+    }
+    int i = 0;
+    for (Node *a = n->a; a; a = a->next, i++) {
+        if (f->param_is_array[i]) {
+            if (a->type != N_VAR) compile_error(a, "array argument expected");
+            emit2(OP_ARRAY_REF, array_kind(a), a->slot);
+        } else {
+            compile_expr(a);
+        }
     }
+    emit2(OP_CALL, n->slot, nargs);
 }
 
-// Print field or expression
-void print_field(const char *expr) {
-    if (*expr == '$') {
-        int n = atoi(expr + 1);
-        if (n == 0) {
-            // $0 = whole line
-            printf("%s", current_line);
-        } else if (n > 0 && n <= nf) {
-            printf("%s", fields[n - 1]);
+static void compile_expr(Node *n) {
+    int kind, slot;
+    size_t j1, j2;
+
+    switch (n->type) {
+    case N_NUM:
+        emit_num(n->num);
+        break;
+    case N_STR:
+        emit_str(n->str);
+        break;
+    case N_REGEX:
+        emit1(OP_MATCH_RECORD, n->slot);
+        break;
+    case N_VAR:
+        if (name_is_array(n)) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "can't use array %s in a scalar context", n->str->data);
+            compile_error(n, msg);
         }
-    } else if (strcmp(expr, "NF") == 0) {
-        printf("%d", nf);
-    } else if (strcmp(expr, "NR") == 0) {
-        printf("%d", nr);
-    } else {
-        // Literal string (strip quotes if present)
-        const char *s = expr;
-        if (*s == '"') {
-            s++;
-            while (*s && *s != '"') {
-                if (*s == '\\' && *(s+1)) {
-                    s++;
-                    switch (*s) {
-                        case 'n': putchar('\n'); break;
-                        case 't': putchar('\t'); break;
-                        default: putchar(*s);
-                    }
-                } else {
-                    putchar(*s);
-                }
-                s++;
-            }
+        emit1(n->scope == SCOPE_LOCAL ? OP_GET_LOCAL : OP_GET_GLOBAL, n->slot);
+        break;
+    case N_FIELD:
+        if (n->a->type == N_NUM && n->a->num >= 0 && n->a->num < 0x7fffffff) {
+            emit1(OP_GET_FIELD_CONST, (int32_t)n->a->num);
+        } else {
+            compile_expr(n->a);
+            emit(OP_GET_FIELD);
+        }
+        break;
+    case N_INDEX:
+        check_array(n);
+        compile_key(n->a);
+        emit2(OP_INDEX, array_kind(n), n->slot);
+        break;
+    case N_GROUPING:
+        compile_error(n, "unexpected expression list");
+        break;
+    case N_ASSIGN:
+        compile_lvalue(n->a, &kind, &slot);
+        compile_expr(n->b);
+        if (n->op == 0) {
+            emit2(OP_ASSIGN, kind, slot);
+        } else {
+            emit(OP_AUG_ASSIGN);
+            emit(kind);
+            emit(slot);
+            emit(n->op);
+        }
+        break;
+    case N_COND:
+        compile_expr(n->a);
+        j1 = emit_jump(OP_JUMP_FALSE);
+        compile_expr(n->b);
+        j2 = emit_jump(OP_JUMP);
+        patch(j1);
+        compile_expr(n->c);
+        patch(j2);
+        break;
+    case N_AND:
+    case N_OR:
+        /* Short-circuit, result normalized to 0 or 1 */
+        compile_expr(n->a);
+        j1 = emit_jump(n->type == N_AND ? OP_JUMP_FALSE : OP_JUMP_TRUE);
+        compile_expr(n->b);
+        emit(OP_BOOL);
+        j2 = emit_jump(OP_JUMP);
+        patch(j1);
+        emit_num(n->type == N_AND ? 0 : 1);
+        patch(j2);
+        break;
+    case N_NOT:
+        compile_expr(n->a);
+        emit(OP_NOT);
+        break;
+    case N_NEG:
+        compile_expr(n->a);
+        emit(OP_NEG);
+        break;
+    case N_PLUS:
+        compile_expr(n->a);
+        emit(OP_PLUS);
+        break;
+    case N_BINARY:
+        compile_expr(n->a);
+        compile_expr(n->b);
+        switch (n->op) {
+        case T_ADD: emit(OP_ADD); break;
+        case T_SUB: emit(OP_SUB); break;
+        case T_MUL: emit(OP_MUL); break;
+        case T_DIV: emit(OP_DIV); break;
+        case T_MOD: emit(OP_MOD); break;
+        default: emit(OP_POW); break;
+        }
+        break;
+    case N_CONCAT:
+        compile_expr(n->a);
+        compile_expr(n->b);
+        emit(OP_CONCAT);
+        break;
+    case N_CMP:
+        compile_expr(n->a);
+        compile_expr(n->b);
+        switch (n->op) {
+        case T_LT: emit(OP_LT); break;
+        case T_LE: emit(OP_LE); break;
+        case T_GT: emit(OP_GT); break;
+        case T_GE: emit(OP_GE); break;
+        case T_EQ: emit(OP_EQ); break;
+        default: emit(OP_NE); break;
+        }
+        break;
+    case N_MATCH:
+        compile_expr(n->a);
+        if (n->b->type == N_REGEX) {
+            emit1(OP_MATCH_STATIC, n->b->slot);
+        } else {
+            compile_expr(n->b);
+            emit(OP_MATCH);
+        }
+        if (n->op == T_NOMATCH) emit(OP_NOT);
+        break;
+    case N_IN:
+        check_array(n->b);
+        compile_key(n->a->type == N_GROUPING ? n->a->a : n->a);
+        emit2(OP_IN, array_kind(n->b), n->b->slot);
+        break;
+    case N_INCDEC:
+        compile_lvalue(n->a, &kind, &slot);
+        emit(OP_INCDEC);
+        emit(kind);
+        emit(slot);
+        emit(n->op);
+        break;
+    case N_CALL:
+        compile_call(n);
+        break;
+    case N_BUILTIN:
+        compile_builtin(n);
+        break;
+    case N_GETLINE:
+        if (n->a) {
+            compile_lvalue(n->a, &kind, &slot);
         } else {
-            printf("%s", expr);
+            kind = LV_NONE;
+            slot = 0;
+        }
+        emit2(OP_GETLINE, kind, slot);
+        break;
+    default:
+        compile_error(n, "internal error: unknown expression");
+    }
+}
+
+/*
+ * Rule patterns that are plain strings, matched together by one
+ * Aho-Corasick scan of $0 per record. literal_ids maps a regex slot to
+ * its pattern id in literal_ac, or -1.
+ */
+static AhoCorasick *literal_ac;
+static int *literal_ids;
+static unsigned char *literal_seen;
+static unsigned long literal_version;   /* record_version literal_seen is for */
+
+/* A regex literal without metacharacters matches as a plain string */
+static int regex_is_literal(const Str *re) {
+    return re->len > 0 && strpbrk(re->data, "\\^$.[]|()*+?{}") == NULL;
+}
+
+static void collect_literal_patterns(void) {
+    int count = 0;
+    for (Rule *r = rules; r; r = r->next) {
+        if (r->pattern && r->pattern->type == N_REGEX && regex_is_literal(r->pattern->str)) count++;
+        if (r->pattern2 && r->pattern2->type == N_REGEX && regex_is_literal(r->pattern2->str)) count++;
+    }
+    /* One pattern is matched as fast by its own regex */
+    if (count < 2) return;
+
+    literal_ac = ac_new(0);
+    literal_ids = (int *)xmalloc(nregexes * sizeof(int));
+    for (int i = 0; i < nregexes; i++) literal_ids[i] = -1;
+    for (Rule *r = rules; r; r = r->next) {
+        Node *patterns[2] = { r->pattern, r->pattern2 };
+        for (int i = 0; i < 2; i++) {
+            Node *n = patterns[i];
+            if (n && n->type == N_REGEX && regex_is_literal(n->str)) {
+                literal_ids[n->slot] = ac_add(literal_ac, n->str->data, n->str->len);
+            }
         }
     }
+    ac_compile(literal_ac);
+    literal_seen = (unsigned char *)xmalloc(literal_ac->npatterns);
 }
 
-// Parse and execute print statement
-void exec_print(const char *args) {
-    if (!args || !*args) {
-        // Print whole line
-        printf("%s\n", current_line);
+/* A pattern or condition: regex literals match $0 */
+static void compile_cond(Node *n) {
+    if (n->type == N_REGEX && literal_ids && literal_ids[n->slot] >= 0) {
+        emit1(OP_MATCH_LITERAL, literal_ids[n->slot]);
         return;
     }
+    compile_expr(n);
+}
+
+static void loop_begin(void) {
+    if (nloops == (int)(sizeof(loops) / sizeof(loops[0]))) fatal("loops nested too deeply");
+    memset(&loops[nloops], 0, sizeof(Loop));
+    nloops++;
+}
+
+static void loop_add(size_t **list, int *count, size_t at) {
+    *list = (size_t *)xrealloc(*list, (*count + 1) * sizeof(size_t));
+    (*list)[(*count)++] = at;
+}
+
+/* Patch breaks to here and continues to continue_to */
+static void loop_end(void) {
+    Loop *l = &loops[--nloops];
+    for (int i = 0; i < l->nbreaks; i++) patch(l->breaks[i]);
+    for (int i = 0; i < l->ncontinues; i++) code[l->continues[i]] = (int32_t)l->continue_to;
+    free(l->breaks);
+    free(l->continues);
+}
+
+static void compile_statement(Node *n) {
+    size_t j1, j2, top;
+    int kind, slot;
+
+    switch (n->type) {
+    case S_BLOCK:
+        compile_statements(n->a);
+        break;
+    case S_EXPR:
+        compile_expr(n->a);
+        emit(OP_POP);
+        break;
+    case S_PRINT:
+    case S_PRINTF: {
+        int nargs = 0;
+        for (Node *a = n->a; a; a = a->next, nargs++) compile_expr(a);
+        int dest = 0;
+        if (n->b) {
+            compile_expr(n->b);
+            dest = n->op == T_APPEND ? 2 : 1;
+        }
+        emit2(n->type == S_PRINT ? OP_PRINT : OP_PRINTF, nargs, dest);
+        break;
+    }
+    case S_IF:
+        compile_cond(n->a);
+        j1 = emit_jump(OP_JUMP_FALSE);
+        if (n->b) compile_statement(n->b);
+        if (n->c) {
+            j2 = emit_jump(OP_JUMP);
+            patch(j1);
+            compile_statement(n->c);
+            patch(j2);
+        } else {
+            patch(j1);
+        }
+        break;
+    case S_WHILE:
+        loop_begin();
+        top = ncode;
+        loops[nloops - 1].continue_to = top;
+        compile_cond(n->a);
+        loop_add(&loops[nloops - 1].breaks, &loops[nloops - 1].nbreaks, emit_jump(OP_JUMP_FALSE));
+        compile_statement(n->b);
+        emit1(OP_JUMP, (int32_t)top);
+        loop_end();
+        break;
+    case S_DO: {
+        loop_begin();
+        top = ncode;
+        compile_statement(n->b);
+        loops[nloops - 1].continue_to = ncode;
+        compile_cond(n->a);
+        emit1(OP_JUMP_TRUE, (int32_t)top);
+        loop_end();
+        break;
+    }
+    case S_FOR:
+        if (n->a) compile_statement(n->a);
+        loop_begin();
+        top = ncode;
+        if (n->b) {
+            compile_cond(n->b);
+            loop_add(&loops[nloops - 1].breaks, &loops[nloops - 1].nbreaks, emit_jump(OP_JUMP_FALSE));
+        }
+        compile_statement(n->d);
+        loops[nloops - 1].continue_to = ncode;
+        if (n->c) compile_statement(n->c);
+        emit1(OP_JUMP, (int32_t)top);
+        loop_end();
+        break;
+    case S_FORIN:
+        check_array(n->b);
+        compile_lvalue(n->a, &kind, &slot);
+        emit2(OP_FORIN_START, array_kind(n->b), n->b->slot);
+        loop_begin();
+        top = ncode;
+        loops[nloops - 1].continue_to = top;
+        emit(OP_FORIN_NEXT);
+        emit(kind);
+        emit(slot);
+        loop_add(&loops[nloops - 1].breaks, &loops[nloops - 1].nbreaks, emit(0));
+        compile_statement(n->c);
+        emit1(OP_JUMP, (int32_t)top);
+        loop_end();
+        emit(OP_FORIN_END);
+        break;
+    case S_BREAK:
+    case S_CONTINUE:
+        if (nloops == 0) compile_error(n, n->type == S_BREAK ? "break outside a loop" : "continue outside a loop");
+        if (n->type == S_BREAK) {
+            loop_add(&loops[nloops - 1].breaks, &loops[nloops - 1].nbreaks, emit_jump(OP_JUMP));
+        } else {
+            loop_add(&loops[nloops - 1].continues, &loops[nloops - 1].ncontinues, emit_jump(OP_JUMP));
+        }
+        break;
+    case S_NEXT:
+        if (!in_main_rules) compile_error(n, "next used in BEGIN or END");
+        emit(OP_NEXT);
+        break;
+    case S_EXIT:
+        if (n->a) compile_expr(n->a);
+        emit1(OP_EXIT, n->a != NULL);
+        break;
+    case S_RETURN:
+        if (n->a) compile_expr(n->a);
+        else emit(OP_PUSH_UNSET);
+        emit(OP_RETURN);
+        break;
+    case S_DELETE:
+        check_array(n->b);
+        if (n->a) {
+            compile_key(n->a);
+            emit2(OP_DELETE, array_kind(n->b), n->b->slot);
+        } else {
+            emit2(OP_DELETE_ALL, array_kind(n->b), n->b->slot);
+        }
+        break;
+    default:
+        compile_error(n, "internal error: unknown statement");
+    }
+}
+
+static void compile_statements(Node *n) {
+    for (; n; n = n->next) compile_statement(n);
+}
+
+static size_t begin_code, main_code, end_code;
+
+static void compile_program(void) {
+    infer_arrays();
+
+    in_main_rules = 0;
+    begin_code = ncode;
+    compile_statements(begin_actions);
+    emit(OP_HALT);
+
+    /* Functions may use 'next'; it is checked at run time outside main rules */
+    for (int i = 0; i < nfuncs; i++) {
+        if (!funcs[i].defined) continue;
+        cur_func = i;
+        in_main_rules = 1;
+        funcs[i].code = ncode;
+        compile_statements(funcs[i].body);
+        emit(OP_PUSH_UNSET);
+        emit(OP_RETURN);
+    }
+    cur_func = -1;
+
+    in_main_rules = 1;
+    main_code = ncode;
+    collect_literal_patterns();
+    for (Rule *r = rules; r; r = r->next) {
+        size_t skip = 0;
+        if (r->pattern2) {
+            int id = nranges++;
+            emit(OP_RANGE_ACTIVE);
+            emit(id);
+            size_t to_end_check = emit(0);
+            compile_cond(r->pattern);
+            skip = emit_jump(OP_JUMP_FALSE);
+            emit2(OP_RANGE_SET, id, 1);
+            patch(to_end_check);
+            compile_cond(r->pattern2);
+            size_t to_action = emit_jump(OP_JUMP_FALSE);
+            emit2(OP_RANGE_SET, id, 0);
+            patch(to_action);
+        } else if (r->pattern) {
+            compile_cond(r->pattern);
+            skip = emit_jump(OP_JUMP_FALSE);
+        }
+        if (r->action) compile_statement(r->action);
+        else emit2(OP_PRINT, 0, 0);
+        if (skip) patch(skip);
+    }
+    emit(OP_HALT);
+
+    in_main_rules = 0;
+    end_code = ncode;
+    compile_statements(end_actions);
+    emit(OP_HALT);
+}
+
+/* ========================================================================== */
+/* Output                                                                     */
+/* ========================================================================== */
+
+typedef struct {
+    Str *name;
+    FILE *fp;
+} OutFile;
+
+static OutFile *out_files;
+static int nout_files;
+
+/* Stream for a redirection target; NULL means stdout */
+static FILE *output_for(Str *name, int append) {
+    if (strcmp(name->data, "/dev/stdout") == 0 || strcmp(name->data, "-") == 0) return NULL;
+    if (strcmp(name->data, "/dev/stderr") == 0) {
+        out_flush();
+        return stderr;
+    }
+    for (int i = 0; i < nout_files; i++) {
+        if (strcmp(out_files[i].name->data, name->data) == 0) return out_files[i].fp;
+    }
+    FILE *fp = fopen(name->data, append ? "ab" : "wb");
+    if (!fp) fatal("can't redirect to %s", name->data);
+    out_files = (OutFile *)xrealloc(out_files, (nout_files + 1) * sizeof(OutFile));
+    out_files[nout_files].name = str_ref(name);
+    out_files[nout_files].fp = fp;
+    nout_files++;
+    return fp;
+}
+
+static int output_close(Str *name) {
+    for (int i = 0; i < nout_files; i++) {
+        if (strcmp(out_files[i].name->data, name->data) == 0) {
+            int r = fclose(out_files[i].fp);
+            str_unref(out_files[i].name);
+            out_files[i] = out_files[--nout_files];
+            return r == 0 ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+static inline void output(FILE *fp, const char *s, size_t n) {
+    if (fp) fwrite(s, 1, n, fp);
+    else out_write(s, n);
+}
 
-    char *args_copy = strdup(args);
-    char *token = args_copy;
-    int first = 1;
+/* print's conversion: numbers via OFMT, strings as they are */
+static void output_cell(FILE *fp, const Cell *c) {
+    if (cell_has_str(c)) {
+        output(fp, c->s->data, c->s->len);
+    } else if (c->type == V_NUM) {
+        Str *s = to_str_fmt(c, G_OFMT);
+        output(fp, s->data, s->len);
+        str_unref(s);
+    }
+}
 
-    while (*token) {
-        // Skip whitespace
-        while (*token && isspace((unsigned char)*token)) token++;
-        if (!*token) break;
+/* printf/sprintf formatting */
+static void format(Buf *b, const Str *fmt, Cell *args, int nargs) {
+    const char *p = fmt->data, *end = fmt->data + fmt->len;
+    int ai = 0;
+    while (p < end) {
+        if (*p != '%') {
+            const char *q = (const char *)memchr(p, '%', (size_t)(end - p));
+            if (!q) q = end;
+            buf_add(b, p, (size_t)(q - p));
+            p = q;
+            continue;
+        }
+        if (p + 1 < end && p[1] == '%') {
+            buf_addc(b, '%');
+            p += 2;
+            continue;
+        }
 
-        if (!first) {
-            // Default OFS is space
-            putchar(' ');
+        /* Copy the spec, resolving '*' widths from the arguments */
+        char spec[64];
+        size_t sl = 0;
+        const char *start = p++;
+        spec[sl++] = '%';
+        while (p < end && strchr("-+ #0", *p) && sl < 40) spec[sl++] = *p++;
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (p < end && *p == '.') spec[sl++] = *p++;
+                else break;
+            }
+            if (p < end && *p == '*') {
+                p++;
+                int w = ai < nargs ? (int)to_num(&args[ai++]) : 0;
+                sl += (size_t)snprintf(spec + sl, sizeof(spec) - sl, "%d", w);
+            } else {
+                while (p < end && isdigit((unsigned char)*p) && sl < 50) spec[sl++] = *p++;
+            }
+        }
+        while (p < end && strchr("hlLqjzt", *p)) p++;
+        if (p >= end) {
+            buf_add(b, start, (size_t)(end - start));
+            break;
         }
-        first = 0;
+        char conv = *p++;
+        Cell empty;
+        empty.type = V_UNSET;
+        Cell *arg = ai < nargs ? &args[ai++] : &empty;
 
-        // Handle quoted strings
-        if (*token == '"') {
-            char *end = strchr(token + 1, '"');
-            if (end) {
-                *end = '\0';
-                print_field(token);
-                token = end + 1;
+        char tmp[512];
+        char *out = tmp;
+        int n = 0;
+        switch (conv) {
+        case 'd':
+        case 'i': {
+            double d = to_num(arg);
+            if (isnan(d) || isinf(d) || fabs(d) >= 9.2e18) {
+                spec[sl++] = '.';
+                spec[sl++] = '0';
+                spec[sl++] = 'f';
+                spec[sl] = '\0';
+                n = snprintf(tmp, sizeof(tmp), spec, d);
             } else {
-                print_field(token);
-                break;
+                spec[sl++] = 'l';
+                spec[sl++] = 'l';
+                spec[sl++] = 'd';
+                spec[sl] = '\0';
+                n = snprintf(tmp, sizeof(tmp), spec, (long long)d);
             }
-        } else {
-            // Find end of token
-            char *end = token;
-            while (*end && !isspace((unsigned char)*end) && *end != ',') end++;
-            char saved = *end;
-            *end = '\0';
-
-            print_field(token);
-
-            if (saved == ',') {
-                token = end + 1;
-            } else if (saved) {
-                token = end + 1;
+            break;
+        }
+        case 'o': case 'x': case 'X': case 'u': {
+            double d = to_num(arg);
+            unsigned long long u = d < 0 ? (unsigned long long)(long long)d : (unsigned long long)d;
+            spec[sl++] = 'l';
+            spec[sl++] = 'l';
+            spec[sl++] = conv;
+            spec[sl] = '\0';
+            n = snprintf(tmp, sizeof(tmp), spec, u);
+            break;
+        }
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            spec[sl++] = conv;
+            spec[sl] = '\0';
+            n = snprintf(tmp, sizeof(tmp), spec, to_num(arg));
+            break;
+        case 'c': {
+            char ch[2] = {0, 0};
+            if (arg->type == V_NUM) {
+                ch[0] = (char)(int)to_num(arg);
             } else {
-                break;
+                Str *s = to_str(arg);
+                ch[0] = s->data[0];
+                str_unref(s);
             }
+            spec[sl++] = 'c';
+            spec[sl] = '\0';
+            n = snprintf(tmp, sizeof(tmp), spec, ch[0]);
+            break;
+        }
+        case 's': {
+            Str *s = to_str(arg);
+            spec[sl++] = 's';
+            spec[sl] = '\0';
+            n = snprintf(NULL, 0, spec, s->data);
+            if ((size_t)n >= sizeof(tmp)) out = (char *)xmalloc((size_t)n + 1);
+            snprintf(out, (size_t)n + 1, spec, s->data);
+            str_unref(s);
+            break;
+        }
+        default:
+            /* Unknown conversion: output it literally */
+            buf_add(b, start, (size_t)(p - start));
+            if (ai > 0 && arg != &empty) ai--;
+            continue;
+        }
+        if (n > 0) {
+            if (out == tmp && (size_t)n >= sizeof(tmp)) n = sizeof(tmp) - 1;
+            buf_add(b, out, (size_t)n);
         }
+        if (out != tmp) free(out);
     }
+}
+
+/* ========================================================================== */
+/* Virtual machine                                                            */
+/* ========================================================================== */
+
+typedef struct {
+    size_t ret_pc;
+    int base;
+    int nlocals;
+    int iter_depth;
+} Frame;
+
+typedef struct {
+    Str **keys;
+    size_t n, i;
+} Iter;
 
-    putchar('\n');
-    free(args_copy);
+static Cell *stack;
+static int sp;
+static Frame frames[MAX_FRAMES];
+static int nframes;
+static Iter *iters;
+static int niters, iters_cap;
+static uint8_t *range_active;
+static int exit_status;
+static double rand_seed;
+static Buf fmt_buf;
+
+enum { RUN_DONE, RUN_NEXT, RUN_EXIT };
+
+static inline void push(Cell c) {
+    if (sp >= STACK_SIZE) fatal("stack overflow (function calls nested too deeply)");
+    stack[sp++] = c;
 }
 
-// Simple pattern matching
-int match_pattern(const char *line, const char *pattern) {
-    return strstr(line, pattern) != NULL;
+static inline Cell pop(void) { return stack[--sp]; }
+
+static inline void push_num(double d) { push(cell_num(d)); }
+static inline void push_str(Str *s) { push(cell_str(s)); }
+
+static inline Cell *local_cell(int slot) { return &stack[frames[nframes - 1].base + slot]; }
+
+static Array *array_at(int kind, int slot) {
+    Cell *c = kind == LV_GARRAY ? &globals[slot] : local_cell(slot);
+    if (c->type == V_UNSET) {
+        c->type = V_ARRAY;
+        c->owned = 1;
+        c->a = array_new();
+    } else if (c->type != V_ARRAY) {
+        fatal("can't use scalar as an array");
+    }
+    return c->a;
 }
 
-// Parse and execute program
-void run_program(const char *program, const char *text) {
-    // Very simple parser
-    const char *p = program;
+/* Subscript string for a key value (new reference) */
+static inline Str *to_key(const Cell *c) {
+    if (cell_has_str(c)) return str_ref(c->s);
+    return to_str(c);
+}
 
-    // Check for BEGIN block
-    const char *begin_start = strstr(p, "BEGIN");
-    const char *end_start = strstr(p, "END");
-    const char *main_start = NULL;
+static Cell get_global(int slot) {
+    if (slot == G_NF) return cell_num(record_nf());
+    if (globals[slot].type == V_ARRAY) fatal("can't use array %s in a scalar context", global_names[slot]);
+    return cell_copy(&globals[slot]);
+}
 
-    // Find main action block
-    const char *brace = strchr(p, '{');
-    if (brace) {
-        if (begin_start && brace > begin_start && brace < begin_start + 20) {
-            // This is BEGIN block, find next
-            brace = strchr(brace + 1, '{');
-            if (brace) {
-                brace = strchr(brace + 1, '{');
-            }
-        }
-        main_start = brace;
+/* Takes ownership of v */
+static void set_global(int slot, Cell v) {
+    if (slot == G_NF) {
+        set_nf((int)to_num(&v));
+        cell_free(&v);
+        return;
     }
+    cell_free(&globals[slot]);
+    v.owned = 0;
+    globals[slot] = v;
+    if (slot == G_FS) update_fs();
+    else if (slot == G_RS) { update_rs(); update_fs(); }
+}
 
-    // Execute BEGIN if present
-    if (begin_start) {
-        const char *b = strchr(begin_start, '{');
-        if (b) {
-            b++;
-            const char *e = strchr(b, '}');
-            if (e) {
-                char action[1024];
-                size_t len = e - b;
-                if (len >= sizeof(action)) len = sizeof(action) - 1;
-                strncpy(action, b, len);
-                action[len] = '\0';
+/* Read an lvalue; key (array subscript) or field number is given by *idx */
+static Cell lvalue_get(int kind, int slot, const Cell *idx) {
+    switch (kind) {
+    case LV_GLOBAL: return get_global(slot);
+    case LV_LOCAL: {
+        Cell *c = local_cell(slot);
+        if (c->type == V_ARRAY) fatal("can't use array in a scalar context");
+        return cell_copy(c);
+    }
+    case LV_FIELD: return get_field(to_num(idx));
+    default: {
+        Str *key = to_key(idx);
+        Cell r = cell_copy(array_get(array_at(kind, slot), key));
+        str_unref(key);
+        return r;
+    }
+    }
+}
 
-                // Parse action
-                if (strstr(action, "print")) {
-                    const char *args = strstr(action, "print");
-                    args += 5;
-                    while (*args && isspace((unsigned char)*args)) args++;
-                    exec_print(args);
-                }
-            }
-        }
+/* Store v (taking ownership) */
+static void lvalue_set(int kind, int slot, const Cell *idx, Cell v) {
+    switch (kind) {
+    case LV_GLOBAL:
+        set_global(slot, v);
+        break;
+    case LV_LOCAL: {
+        Cell *c = local_cell(slot);
+        if (c->type == V_ARRAY) fatal("can't assign to an array");
+        cell_free(c);
+        v.owned = 0;
+        *c = v;
+        break;
+    }
+    case LV_FIELD:
+        set_field(to_num(idx), v);
+        break;
+    default: {
+        Str *key = to_key(idx);
+        Cell *c = array_get(array_at(kind, slot), key);
+        str_unref(key);
+        cell_free(c);
+        v.owned = 0;
+        *c = v;
+        break;
     }
+    }
+}
+
+static inline int lvalue_has_index(int kind) {
+    return kind == LV_FIELD || kind == LV_GARRAY || kind == LV_LARRAY;
+}
 
-    // Process lines
-    char *text_copy = strdup(text);
-    char *line = strtok(text_copy, "\n");
+static double arith(int op, double a, double b) {
+    switch (op) {
+    case T_ADD: return a + b;
+    case T_SUB: return a - b;
+    case T_MUL: return a * b;
+    case T_DIV:
+        if (b == 0) fatal("division by zero");
+        return a / b;
+    case T_MOD:
+        if (b == 0) fatal("division by zero in %%");
+        return fmod(a, b);
+    default: return pow(a, b);
+    }
+}
 
-    while (line) {
-        nr++;
-        strncpy(current_line, line, MAX_LINE - 1);
-        current_line[MAX_LINE - 1] = '\0';
+/* awk comparison: numeric if both sides are numbers, else as strings */
+static int compare(const Cell *a, const Cell *b) {
+    int an = a->type == V_NUM || a->type == V_STRNUM || a->type == V_UNSET;
+    int bn = b->type == V_NUM || b->type == V_STRNUM || b->type == V_UNSET;
+    if (an && bn) {
+        double x = to_num(a), y = to_num(b);
+        return x < y ? -1 : x > y ? 1 : 0;
+    }
+    Str *x = to_str(a), *y = to_str(b);
+    size_t n = x->len < y->len ? x->len : y->len;
+    int r = memcmp(x->data, y->data, n);
+    if (r == 0) r = x->len < y->len ? -1 : x->len > y->len ? 1 : 0;
+    str_unref(x);
+    str_unref(y);
+    return r;
+}
 
-        char *line_copy = strdup(line);
-        split_line(line_copy);
+static int next_input_record(void) {
+    const char *s;
+    size_t len;
+    if (!read_record(&s, &len)) return 0;
+    globals[G_NR] = cell_num(to_num(&globals[G_NR]) + 1);
+    globals[G_FNR] = cell_num(to_num(&globals[G_FNR]) + 1);
+    set_record(s, len);
+    return 1;
+}
 
-        // Check pattern if present
-        int should_exec = 1;
-        const char *pattern_start = strchr(program, '/');
-        if (pattern_start && pattern_start < main_start) {
-            const char *pattern_end = strchr(pattern_start + 1, '/');
-            if (pattern_end) {
-                char pattern[256];
-                size_t plen = pattern_end - pattern_start - 1;
-                if (plen >= sizeof(pattern)) plen = sizeof(pattern) - 1;
-                strncpy(pattern, pattern_start + 1, plen);
-                pattern[plen] = '\0';
+/* sub/gsub on the string s; returns the count and the result in *out */
+static int substitute(Regex *re, const Str *repl, const Str *s, int global, Str **out) {
+    Buf b = {0};
+    size_t pos = 0, copied = 0;
+    size_t prev_end = (size_t)-1;
+    int count = 0;
 
-                should_exec = match_pattern(current_line, pattern);
+    while (pos <= s->len) {
+        size_t ms, me;
+        if (!re_search(re, s->data, s->len, pos, &ms, &me)) break;
+        /* An empty match right after the previous match does not count */
+        if (ms == me && ms == prev_end) {
+            if (ms >= s->len) break;
+            pos = ms + 1;
+            continue;
+        }
+        buf_add(&b, s->data + copied, ms - copied);
+        for (size_t i = 0; i < repl->len; i++) {
+            char c = repl->data[i];
+            if (c == '\\' && i + 1 < repl->len && (repl->data[i + 1] == '&' || repl->data[i + 1] == '\\')) {
+                buf_addc(&b, repl->data[++i]);
+            } else if (c == '&') {
+                buf_add(&b, s->data + ms, me - ms);
+            } else {
+                buf_addc(&b, c);
             }
         }
+        copied = me;
+        prev_end = me;
+        count++;
+        if (!global) break;
+        pos = me > ms ? me : me + 1;
+    }
 
-        // Execute main action
-        if (should_exec && main_start) {
-            const char *action_start = main_start + 1;
-            const char *action_end = strchr(action_start, '}');
+    if (count) {
+        buf_add(&b, s->data + copied, s->len - copied);
+        *out = str_new(b.p ? b.p : "", b.len);
+    }
+    free(b.p);
+    return count;
+}
 
-            if (action_end) {
-                char action[1024];
-                size_t len = action_end - action_start;
-                if (len >= sizeof(action)) len = sizeof(action) - 1;
-                strncpy(action, action_start, len);
-                action[len] = '\0';
+static void iter_pop(void) {
+    Iter *it = &iters[--niters];
+    for (size_t i = it->i; i < it->n; i++) str_unref(it->keys[i]);
+    free(it->keys);
+}
 
-                if (strstr(action, "print")) {
-                    const char *args = strstr(action, "print");
-                    args += 5;
-                    while (*args && isspace((unsigned char)*args)) args++;
-                    exec_print(*args ? args : NULL);
-                }
-            }
-        } else if (should_exec && !main_start && !begin_start && !end_start) {
-            // Default action: print line
-            printf("%s\n", current_line);
+/* Release a frame's locals (owned arrays included) */
+static void frame_release(Frame *f) {
+    for (int i = f->base; i < f->base + f->nlocals; i++) {
+        if (stack[i].type == V_ARRAY) {
+            if (stack[i].owned) array_free(stack[i].a);
+            stack[i].type = V_UNSET;
+        } else {
+            cell_free(&stack[i]);
         }
-
-        free(line_copy);
-        line = strtok(NULL, "\n");
     }
+    while (niters > f->iter_depth) iter_pop();
+}
 
-    free(text_copy);
+/* Drop everything down to the top-level frame (next, exit) */
+static void unwind(void) {
+    while (nframes > 1) {
+        frame_release(&frames[nframes - 1]);
+        nframes--;
+    }
+    while (sp > 0) {
+        Cell c = pop();
+        if (c.type != V_ARRAY) cell_free(&c);
+    }
+    while (niters > 0) iter_pop();
+}
 
-    // Execute END if present
-    if (end_start) {
-        const char *b = strchr(end_start, '{');
-        if (b) {
-            b++;
-            const char *e = strchr(b, '}');
-            if (e) {
-                char action[1024];
-                size_t len = e - b;
-                if (len >= sizeof(action)) len = sizeof(action) - 1;
-                strncpy(action, b, len);
-                action[len] = '\0';
+static Cell builtin(int id, Cell *args, int nargs) {
+    switch (id) {
+    case B_LENGTH: {
+        Str *s = to_str(&args[0]);
+        double n = (double)s->len;
+        str_unref(s);
+        return cell_num(n);
+    }
+    case B_SUBSTR: {
+        Str *s = to_str(&args[0]);
+        double m = rint(to_num(&args[1]));
+        double len = nargs > 2 ? rint(to_num(&args[2])) : INFINITY;
+        /* Characters m .. m+len-1 (1-based), clipped to the string */
+        double from = m < 1 ? 1 : m;
+        double to = m + len;
+        if (isnan(len) || to > (double)s->len + 1) to = (double)s->len + 1;
+        Str *r = to > from ? str_new(s->data + (size_t)from - 1, (size_t)(to - from)) : str_new("", 0);
+        str_unref(s);
+        return cell_str(r);
+    }
+    case B_INDEX: {
+        Str *s = to_str(&args[0]), *t = to_str(&args[1]);
+        double r = 0;
+        if (t->len == 0) {
+            r = 0;
+        } else {
+            const char *hit = simd_memmem(s->data, s->len, t->data, t->len);
+            if (hit) r = (double)(hit - s->data) + 1;
+        }
+        str_unref(s);
+        str_unref(t);
+        return cell_num(r);
+    }
+    case B_MATCH: {
+        Str *s = to_str(&args[0]);
+        Regex *re = to_regex(&args[1]);
+        size_t ms, me;
+        double start = 0, len = -1;
+        if (re_search(re, s->data, s->len, 0, &ms, &me)) {
+            start = (double)ms + 1;
+            len = (double)(me - ms);
+        }
+        str_unref(s);
+        set_global(G_RSTART, cell_num(start));
+        set_global(G_RLENGTH, cell_num(len));
+        return cell_num(start);
+    }
+    case B_SPRINTF: {
+        Str *fmt = to_str(&args[0]);
+        fmt_buf.len = 0;
+        format(&fmt_buf, fmt, args + 1, nargs - 1);
+        str_unref(fmt);
+        return cell_str(str_new(fmt_buf.p ? fmt_buf.p : "", fmt_buf.len));
+    }
+    case B_SIN: return cell_num(sin(to_num(&args[0])));
+    case B_COS: return cell_num(cos(to_num(&args[0])));
+    case B_ATAN2: return cell_num(atan2(to_num(&args[0]), to_num(&args[1])));
+    case B_EXP: return cell_num(exp(to_num(&args[0])));
+    case B_LOG: return cell_num(log(to_num(&args[0])));
+    case B_SQRT: return cell_num(sqrt(to_num(&args[0])));
+    case B_INT: return cell_num(trunc(to_num(&args[0])));
+    case B_RAND: return cell_num(rand() / ((double)RAND_MAX + 1));
+    case B_SRAND: {
+        double prev = rand_seed;
+        rand_seed = nargs ? to_num(&args[0]) : (double)time(NULL);
+        srand((unsigned)rand_seed);
+        return cell_num(prev);
+    }
+    case B_TOLOWER:
+    case B_TOUPPER: {
+        Str *s = to_str(&args[0]);
+        Str *r = str_new(s->data, s->len);
+        for (size_t i = 0; i < r->len; i++) {
+            r->data[i] = (char)(id == B_TOLOWER ? tolower((unsigned char)r->data[i])
+                                                : toupper((unsigned char)r->data[i]));
+        }
+        str_unref(s);
+        return cell_str(r);
+    }
+    case B_SYSTEM:
+        out_flush();
+        fprintf(stderr, "awk: system() is not supported\n");
+        return cell_num(-1);
+    case B_CLOSE: {
+        Str *s = to_str(&args[0]);
+        int r = output_close(s);
+        str_unref(s);
+        return cell_num(r);
+    }
+    case B_FFLUSH:
+        out_flush();
+        for (int i = 0; i < nout_files; i++) fflush(out_files[i].fp);
+        return cell_num(0);
+    }
+    return cell_num(0);
+}
 
-                if (strstr(action, "print")) {
-                    const char *args = strstr(action, "print");
-                    args += 5;
-                    while (*args && isspace((unsigned char)*args)) args++;
-                    exec_print(args);
+static int run(size_t pc) {
+    for (;;) {
+        int op = code[pc++];
+        switch (op) {
+        case OP_HALT:
+            return RUN_DONE;
+        case OP_PUSH_NUM:
+            push_num(num_consts[code[pc++]]);
+            break;
+        case OP_PUSH_STR:
+            push_str(str_ref(str_consts[code[pc++]]));
+            break;
+        case OP_PUSH_REGEX: {
+            Cell c = cell_num(code[pc++]);
+            c.type = V_REGEX;
+            push(c);
+            break;
+        }
+        case OP_PUSH_UNSET: {
+            Cell c;
+            c.type = V_UNSET;
+            c.owned = 0;
+            push(c);
+            break;
+        }
+        case OP_POP:
+            cell_free(&stack[--sp]);
+            break;
+        case OP_GET_GLOBAL:
+            push(get_global(code[pc++]));
+            break;
+        case OP_GET_LOCAL: {
+            Cell *c = local_cell(code[pc++]);
+            if (c->type == V_ARRAY) fatal("can't use array in a scalar context");
+            push(cell_copy(c));
+            break;
+        }
+        case OP_GET_FIELD: {
+            Cell idx = pop();
+            double d = to_num(&idx);
+            cell_free(&idx);
+            push(get_field(d));
+            break;
+        }
+        case OP_GET_FIELD_CONST:
+            push(get_field(code[pc++]));
+            break;
+        case OP_INDEX: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell key = pop();
+            Str *k = to_key(&key);
+            cell_free(&key);
+            push(cell_copy(array_get(array_at(kind, slot), k)));
+            str_unref(k);
+            break;
+        }
+        case OP_MAKE_KEY: {
+            int n = code[pc++];
+            Buf b = {0};
+            Str *subsep = to_str(&globals[G_SUBSEP]);
+            for (int i = sp - n; i < sp; i++) {
+                if (i > sp - n) buf_add(&b, subsep->data, subsep->len);
+                Str *s = to_key(&stack[i]);
+                buf_add(&b, s->data, s->len);
+                str_unref(s);
+                cell_free(&stack[i]);
+            }
+            str_unref(subsep);
+            sp -= n;
+            push_str(str_new(b.p ? b.p : "", b.len));
+            free(b.p);
+            break;
+        }
+        case OP_ASSIGN: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell v = pop();
+            if (v.type == V_REGEX) v = cell_num(0);
+            Cell result = cell_copy(&v);
+            if (lvalue_has_index(kind)) {
+                Cell idx = pop();
+                lvalue_set(kind, slot, &idx, v);
+                cell_free(&idx);
+            } else {
+                lvalue_set(kind, slot, NULL, v);
+            }
+            push(result);
+            break;
+        }
+        case OP_AUG_ASSIGN: {
+            int kind = code[pc++], slot = code[pc++], aop = code[pc++];
+            Cell v = pop();
+            Cell idx;
+            idx.type = V_UNSET;
+            if (lvalue_has_index(kind)) idx = pop();
+            Cell cur = lvalue_get(kind, slot, &idx);
+            double r = arith(aop, to_num(&cur), to_num(&v));
+            cell_free(&cur);
+            cell_free(&v);
+            lvalue_set(kind, slot, &idx, cell_num(r));
+            cell_free(&idx);
+            push_num(r);
+            break;
+        }
+        case OP_INCDEC: {
+            int kind = code[pc++], slot = code[pc++], mode = code[pc++];
+            Cell idx;
+            idx.type = V_UNSET;
+            if (lvalue_has_index(kind)) idx = pop();
+            Cell cur = lvalue_get(kind, slot, &idx);
+            double old = to_num(&cur);
+            cell_free(&cur);
+            double now = (mode == 0 || mode == 2) ? old + 1 : old - 1;
+            lvalue_set(kind, slot, &idx, cell_num(now));
+            cell_free(&idx);
+            push_num(mode < 2 ? now : old);
+            break;
+        }
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD: case OP_POW: {
+            static const int ops[] = { T_ADD, T_SUB, T_MUL, T_DIV, T_MOD, T_POW };
+            Cell b = pop(), a = pop();
+            double r = arith(ops[op - OP_ADD], to_num(&a), to_num(&b));
+            cell_free(&a);
+            cell_free(&b);
+            push_num(r);
+            break;
+        }
+        case OP_NEG:
+        case OP_PLUS: {
+            Cell a = pop();
+            double d = to_num(&a);
+            cell_free(&a);
+            push_num(op == OP_NEG ? -d : d);
+            break;
+        }
+        case OP_NOT:
+        case OP_BOOL: {
+            Cell a = pop();
+            int t = to_bool(&a);
+            cell_free(&a);
+            push_num(op == OP_NOT ? !t : t);
+            break;
+        }
+        case OP_CONCAT: {
+            Cell b = pop(), a = pop();
+            Str *x = to_str(&a), *y = to_str(&b);
+            Str *r = (Str *)xmalloc(sizeof(Str) + x->len + y->len + 1);
+            r->refs = 1;
+            r->len = x->len + y->len;
+            memcpy(r->data, x->data, x->len);
+            memcpy(r->data + x->len, y->data, y->len);
+            r->data[r->len] = '\0';
+            str_unref(x);
+            str_unref(y);
+            cell_free(&a);
+            cell_free(&b);
+            push_str(r);
+            break;
+        }
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE: {
+            Cell b = pop(), a = pop();
+            int c = compare(&a, &b);
+            cell_free(&a);
+            cell_free(&b);
+            int r;
+            switch (op) {
+            case OP_LT: r = c < 0; break;
+            case OP_LE: r = c <= 0; break;
+            case OP_GT: r = c > 0; break;
+            case OP_GE: r = c >= 0; break;
+            case OP_EQ: r = c == 0; break;
+            default: r = c != 0; break;
+            }
+            push_num(r);
+            break;
+        }
+        case OP_MATCH:
+        case OP_MATCH_STATIC: {
+            Regex *re;
+            Cell rhs;
+            rhs.type = V_UNSET;
+            if (op == OP_MATCH) {
+                rhs = pop();
+                re = to_regex(&rhs);
+            } else {
+                re = regexes[code[pc++]];
+            }
+            Cell a = pop();
+            Str *s = to_str(&a);
+            int r = re_match(re, s->data, s->len);
+            str_unref(s);
+            cell_free(&a);
+            if (rhs.type != V_REGEX) cell_free(&rhs);
+            push_num(r);
+            break;
+        }
+        case OP_MATCH_RECORD:
+            record_rebuild();
+            push_num(re_match(regexes[code[pc++]], rec.text.p, rec.text.len));
+            break;
+        case OP_MATCH_LITERAL:
+            record_rebuild();
+            if (literal_version != record_version) {
+                ac_scan(literal_ac, rec.text.p, rec.text.len, literal_seen);
+                literal_version = record_version;
+            }
+            push_num(literal_seen[code[pc++]]);
+            break;
+        case OP_IN: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell key = pop();
+            Str *k = to_key(&key);
+            cell_free(&key);
+            int r = array_find(array_at(kind, slot), k) != NULL;
+            str_unref(k);
+            push_num(r);
+            break;
+        }
+        case OP_JUMP:
+            pc = (size_t)code[pc];
+            break;
+        case OP_JUMP_FALSE:
+        case OP_JUMP_TRUE: {
+            Cell a = pop();
+            int t = to_bool(&a);
+            cell_free(&a);
+            if (t == (op == OP_JUMP_TRUE)) pc = (size_t)code[pc];
+            else pc++;
+            break;
+        }
+        case OP_RANGE_ACTIVE: {
+            int id = code[pc++];
+            if (range_active[id]) pc = (size_t)code[pc];
+            else pc++;
+            break;
+        }
+        case OP_RANGE_SET: {
+            int id = code[pc++];
+            range_active[id] = (uint8_t)code[pc++];
+            break;
+        }
+        case OP_PRINT:
+        case OP_PRINTF: {
+            int nargs = code[pc++], dest = code[pc++];
+            FILE *fp = NULL;
+            if (dest) {
+                Cell d = pop();
+                Str *name = to_str(&d);
+                cell_free(&d);
+                fp = output_for(name, dest == 2);
+                str_unref(name);
+            }
+            Cell *args = &stack[sp - nargs];
+            if (op == OP_PRINTF) {
+                Str *fmt = to_str(&args[0]);
+                fmt_buf.len = 0;
+                format(&fmt_buf, fmt, args + 1, nargs - 1);
+                str_unref(fmt);
+                output(fp, fmt_buf.p, fmt_buf.len);
+            } else if (nargs == 0) {
+                record_rebuild();
+                output(fp, rec.text.p, rec.text.len);
+                output_cell(fp, &globals[G_ORS]);
+            } else {
+                for (int i = 0; i < nargs; i++) {
+                    if (i > 0) output_cell(fp, &globals[G_OFS]);
+                    output_cell(fp, &args[i]);
+                }
+                output_cell(fp, &globals[G_ORS]);
+            }
+            for (int i = 0; i < nargs; i++) cell_free(&args[i]);
+            sp -= nargs;
+            break;
+        }
+        case OP_CALL: {
+            int fi = code[pc++], nargs = code[pc++];
+            Func *f = &funcs[fi];
+            if (nframes == MAX_FRAMES) fatal("function calls nested too deeply");
+            for (int i = nargs; i < f->nparams; i++) {
+                Cell c;
+                c.type = V_UNSET;
+                c.owned = 0;
+                push(c);
+            }
+            Frame *fr = &frames[nframes++];
+            fr->ret_pc = pc;
+            fr->base = sp - f->nparams;
+            fr->nlocals = f->nparams;
+            fr->iter_depth = niters;
+            pc = f->code;
+            break;
+        }
+        case OP_RETURN: {
+            Cell v = pop();
+            Frame *fr = &frames[nframes - 1];
+            frame_release(fr);
+            sp = fr->base;
+            pc = fr->ret_pc;
+            nframes--;
+            push(v);
+            break;
+        }
+        case OP_ARRAY_REF: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell c;
+            c.type = V_ARRAY;
+            c.owned = 0;
+            c.a = array_at(kind, slot);
+            push(c);
+            break;
+        }
+        case OP_BUILTIN: {
+            int id = code[pc++], nargs = code[pc++];
+            Cell *args = &stack[sp - nargs];
+            Cell r = builtin(id, args, nargs);
+            for (int i = 0; i < nargs; i++) {
+                if (args[i].type != V_REGEX) cell_free(&args[i]);
+            }
+            sp -= nargs;
+            push(r);
+            break;
+        }
+        case OP_LENGTH_ARRAY: {
+            int kind = code[pc++], slot = code[pc++];
+            push_num((double)array_at(kind, slot)->count);
+            break;
+        }
+        case OP_SPLIT: {
+            int kind = code[pc++], slot = code[pc++], has_fs = code[pc++];
+            FieldSep fs = current_fs;
+            Cell sep;
+            sep.type = V_UNSET;
+            if (has_fs) {
+                sep = pop();
+                if (sep.type == V_REGEX) {
+                    fs.mode = FS_REGEX;
+                    fs.re = regexes[(int)sep.num];
+                    fs.newline = 0;
+                } else {
+                    Str *s = to_str(&sep);
+                    fs = field_sep_for(s, 0);
+                    str_unref(s);
+                    cell_free(&sep);
+                }
+            }
+            Cell src_cell = pop();
+            Str *s = to_str(&src_cell);
+            cell_free(&src_cell);
+            Array *a = array_at(kind, slot);
+            array_clear(a);
+            SplitState st;
+            split_init(&st, &fs, s->data, s->len);
+            size_t start, len;
+            int n = 0;
+            char key[32];
+            while (split_next(&st, &fs, &start, &len)) {
+                int kl = snprintf(key, sizeof(key), "%d", ++n);
+                Str *k = str_new(key, (size_t)kl);
+                Cell *c = array_get(a, k);
+                str_unref(k);
+                *c = cell_input(str_new(s->data + start, len));
+            }
+            str_unref(s);
+            push_num(n);
+            break;
+        }
+        case OP_SUBST: {
+            int kind = code[pc++], slot = code[pc++], global = code[pc++];
+            Cell idx;
+            idx.type = V_UNSET;
+            if (lvalue_has_index(kind)) idx = pop();
+            Cell repl_cell = pop(), re_cell = pop();
+            Regex *re = to_regex(&re_cell);
+            Str *repl = to_str(&repl_cell);
+            Cell target = lvalue_get(kind, slot, &idx);
+            Str *s = to_str(&target);
+            cell_free(&target);
+            Str *result;
+            int count = substitute(re, repl, s, global, &result);
+            if (count) lvalue_set(kind, slot, &idx, cell_str(result));
+            str_unref(s);
+            str_unref(repl);
+            cell_free(&repl_cell);
+            if (re_cell.type != V_REGEX) cell_free(&re_cell);
+            cell_free(&idx);
+            push_num(count);
+            break;
+        }
+        case OP_GETLINE: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell idx;
+            idx.type = V_UNSET;
+            if (lvalue_has_index(kind)) idx = pop();
+            int r;
+            if (kind == LV_NONE) {
+                r = next_input_record();
+            } else {
+                const char *s;
+                size_t len;
+                r = read_record(&s, &len);
+                if (r) {
+                    globals[G_NR] = cell_num(to_num(&globals[G_NR]) + 1);
+                    globals[G_FNR] = cell_num(to_num(&globals[G_FNR]) + 1);
+                    lvalue_set(kind, slot, &idx, cell_input(str_new(s, len)));
                 }
             }
+            cell_free(&idx);
+            push_num(r);
+            break;
+        }
+        case OP_DELETE: {
+            int kind = code[pc++], slot = code[pc++];
+            Cell key = pop();
+            Str *k = to_key(&key);
+            cell_free(&key);
+            array_delete(array_at(kind, slot), k);
+            str_unref(k);
+            break;
+        }
+        case OP_DELETE_ALL: {
+            int kind = code[pc++], slot = code[pc++];
+            array_clear(array_at(kind, slot));
+            break;
+        }
+        case OP_FORIN_START: {
+            int kind = code[pc++], slot = code[pc++];
+            Array *a = array_at(kind, slot);
+            /* Iterate over a snapshot, so the body may add and delete keys */
+            if (niters == iters_cap) {
+                iters_cap = iters_cap ? iters_cap * 2 : 16;
+                iters = (Iter *)xrealloc(iters, iters_cap * sizeof(Iter));
+            }
+            Iter *it = &iters[niters++];
+            it->keys = (Str **)xmalloc((a->count ? a->count : 1) * sizeof(Str *));
+            it->n = 0;
+            it->i = 0;
+            for (size_t i = 0; i < a->used; i++) {
+                if (a->entries[i].key) it->keys[it->n++] = str_ref(a->entries[i].key);
+            }
+            break;
+        }
+        case OP_FORIN_NEXT: {
+            int kind = code[pc++], slot = code[pc++];
+            Iter *it = &iters[niters - 1];
+            if (it->i >= it->n) {
+                pc = (size_t)code[pc];
+                break;
+            }
+            pc++;
+            Str *key = it->keys[it->i++];
+            lvalue_set(kind, slot, NULL, cell_input(key));
+            break;
+        }
+        case OP_FORIN_END:
+            iter_pop();
+            break;
+        case OP_NEXT:
+            if (nframes == 0 || !in_main_rules) fatal("next used in BEGIN or END");
+            unwind();
+            return RUN_NEXT;
+        case OP_EXIT:
+            if (code[pc++]) {
+                Cell v = pop();
+                exit_status = (int)to_num(&v);
+                cell_free(&v);
+            }
+            unwind();
+            return RUN_EXIT;
+        default:
+            fatal("internal error: bad opcode %d", op);
         }
     }
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: awk [-F sep] <program> <text>\n");
-        fprintf(stderr, "Examples:\n");
-        fprintf(stderr, "  awk '{print $1}' \"hello world\"\n");
-        fprintf(stderr, "  awk -F: '{print $1}' \"user:pass\"\n");
-        fprintf(stderr, "  awk '/pattern/{print}' \"text\"\n");
-        return 1;
+/* ========================================================================== */
+/* Main                                                                       */
+/* ========================================================================== */
+
+/* var=value from -v or --assign; value escapes are processed like strings */
+static void assign_var(const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (!eq || eq == arg) fatal("invalid variable assignment: %s", arg);
+    for (const char *p = arg; p < eq; p++) {
+        if (!(isalnum((unsigned char)*p) || *p == '_') || isdigit((unsigned char)arg[0])) {
+            fatal("invalid variable name in assignment: %s", arg);
+        }
     }
+    Buf b = {0};
+    for (const char *p = eq + 1; *p;) {
+        if (*p == '\\' && p[1]) {
+            p++;
+            buf_addc(&b, (char)read_escape(&p));
+        } else {
+            buf_addc(&b, *p++);
+        }
+    }
+    Str *name = str_new(arg, (size_t)(eq - arg));
+    int slot = global_slot(name);
+    str_unref(name);
+    set_global(slot, cell_input(str_new(b.p ? b.p : "", b.len)));
+    free(b.p);
+}
 
-    int arg_idx = 1;
+static void usage(void) {
+    fprintf(stderr, "Usage: awk [-F sep] [-v var=value]... <program> [<text>]\n");
+    fprintf(stderr, "Examples:\n");
+    fprintf(stderr, "  awk '{print $1}' \"hello world\"\n");
+    fprintf(stderr, "  awk -F: '{print $1}' \"user:pass\"\n");
+    fprintf(stderr, "  awk '/pattern/{print}' \"text\"\n");
+    fprintf(stderr, "  awk '{s[$1] += $3} END {for (k in s) print k, s[k]}'\n");
+}
+
+int main(int argc, char **argv) {
+    const char *program = NULL;
+    const char *text = NULL;
+    const char *fs = NULL;
+    const char **assigns = (const char **)xmalloc(argc * sizeof(char *));
+    int nassigns = 0;
 
-    // Parse options
-    while (arg_idx < argc && argv[arg_idx][0] == '-') {
-        if (strcmp(argv[arg_idx], "-F") == 0 && arg_idx + 1 < argc) {
-            strncpy(field_sep, argv[arg_idx + 1], sizeof(field_sep) - 1);
-            arg_idx += 2;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if ((strcmp(arg, "-F") == 0 || strcmp(arg, "--fieldSeparator") == 0) && value) {
+            fs = value;
+            i++;
+        } else if (strncmp(arg, "-F", 2) == 0 && arg[2]) {
+            fs = arg + 2;
+        } else if ((strcmp(arg, "-v") == 0 || strcmp(arg, "--assign") == 0) && value) {
+            assigns[nassigns++] = value;
+            i++;
+        } else if (strncmp(arg, "-v", 2) == 0 && arg[2]) {
+            assigns[nassigns++] = arg + 2;
+        } else if (strcmp(arg, "--program") == 0 && value) {
+            program = value;
+            i++;
+        } else if (strcmp(arg, "--input") == 0 && value) {
+            text = value;
+            i++;
+        } else if (strcmp(arg, "--") == 0) {
+            continue;
+        } else if (!program) {
+            program = arg;
+        } else if (!text) {
+            text = arg;
         } else {
-            arg_idx++;
+            usage();
+            return 1;
         }
     }
 
-    if (argc - arg_idx < 1) {
-        fprintf(stderr, "Error: Missing program\n");
+    if (!program) {
+        usage();
         return 1;
     }
 
-    const char *program = argv[arg_idx];
-    const char *text = NULL;
-    char *stdin_buf = NULL;
+    stack = (Cell *)xmalloc(STACK_SIZE * sizeof(Cell));
+    regex_cache = array_new();
 
-    if (argc - arg_idx >= 2) {
-        text = argv[arg_idx + 1];
-    } else {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Error: Missing text (provide as argument or via stdin)\n");
-            return 1;
+    /* Special variables come first so their slots match the G_ constants */
+    for (int i = 0; i < NUM_SPECIAL; i++) {
+        Str *name = str_cstr(special_names[i]);
+        global_slot(name);
+        str_unref(name);
+    }
+    globals[G_NR] = cell_num(0);
+    globals[G_FNR] = cell_num(0);
+    globals[G_FS] = cell_str(str_cstr(" "));
+    globals[G_OFS] = cell_str(str_cstr(" "));
+    globals[G_ORS] = cell_str(str_cstr("\n"));
+    globals[G_RS] = cell_str(str_cstr("\n"));
+    globals[G_SUBSEP] = cell_str(str_cstr("\034"));
+    globals[G_RSTART] = cell_num(0);
+    globals[G_RLENGTH] = cell_num(-1);
+    globals[G_CONVFMT] = cell_str(str_cstr("%.6g"));
+    globals[G_OFMT] = cell_str(str_cstr("%.6g"));
+    globals[G_FILENAME] = cell_str(str_cstr(""));
+    update_rs();
+    update_fs();
+
+    src = program;
+    parse_program();
+    compile_program();
+    range_active = (uint8_t *)xmalloc(nranges + 1);
+    memset(range_active, 0, nranges + 1);
+
+    if (fs) {
+        /* -F '\t' means a tab, as in other awks */
+        Buf b = {0};
+        for (const char *p = fs; *p;) {
+            if (*p == '\\' && p[1]) {
+                p++;
+                buf_addc(&b, (char)read_escape(&p));
+            } else {
+                buf_addc(&b, *p++);
+            }
         }
-        text = stdin_buf;
+        set_global(G_FS, cell_str(str_new(b.p ? b.p : "", b.len)));
+        free(b.p);
     }
+    for (int i = 0; i < nassigns; i++) assign_var(assigns[i]);
+    free(assigns);
 
-    run_program(program, text);
+    if (text) line_reader_init_string(&input, text);
+    else line_reader_init_stdin(&input);
+    set_record("", 0);
 
-    free(stdin_buf);
-    return 0;
+    /* The top-level frame holds no locals */
+    frames[0].base = 0;
+    frames[0].nlocals = 0;
+    frames[0].iter_depth = 0;
+    nframes = 1;
+
+    in_main_rules = 0;
+    int r = run(begin_code);
+
+    /* Input is only read when there are main rules or an END block */
+    if (r != RUN_EXIT && (rules || end_actions)) {
+        in_main_rules = 1;
+        while (next_input_record()) {
+            if (!rules) continue;
+            r = run(main_code);
+            if (r == RUN_EXIT) break;
+        }
+        in_main_rules = 0;
+    }
+    if (end_actions && !(r == RUN_EXIT && !end_actions)) {
+        r = run(end_code);
+    }
+
+    out_flush();
+    for (int i = 0; i < nout_files; i++) fclose(out_files[i].fp);
+    line_reader_free(&input);
+    return input.error ? 2 : exit_status;
 }
@@ -0,0 +1,335 @@
+/**
+ * Base64 codec (RFC 4648) with the standard and URL-safe alphabets.
+ *
+ * Encoding and decoding work on byte buffers of any content, so binary
+ * payloads (images, PDFs) round-trip unchanged. With -msimd128 both
+ * directions process a 16-character block per step, following the
+ * Muła/Lemire approach:
+ * - encode: 12 input bytes are shuffled so each 32-bit lane holds one
+ *   3-byte group, the four 6-bit indices are split out with shifts and
+ *   masks, and a 16-entry swizzle table adds the per-range ASCII offset
+ * - decode: range compares classify all 16 characters at once; a block
+ *   that is all alphabet characters is translated with one add and
+ *   packed back to 12 bytes, anything else (whitespace, padding, errors)
+ *   takes the scalar path, which uses a 256-entry lookup table
+ *
+ * The decoder is streaming: feed input in pieces of any size with
+ * b64_decode_update() and finish with b64_decode_final(). By default it
+ * skips whitespace and accepts missing padding (as base64url in JWTs
+ * has); strict mode accepts only canonical input: no whitespace, full
+ * padding and zero trailing bits.
+ *
+ * Usage:
+ *   char *text = malloc(b64_encoded_len(n, 1));
+ *   size_t len = b64_encode(&B64_STD, data, n, text, 1);
+ *
+ *   B64Decoder dec;
+ *   b64_decoder_init(&dec, &B64_URL, 0);
+ *   size_t n = b64_decode_update(&dec, text, len, out);  // out: b64_decode_bound(len)
+ *   n += b64_decode_final(&dec, out + n);
+ *   if (dec.error) ...
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "simd.h"
+
+/* Decode table entries outside 0..63 */
+#define B64_INVALID 0xff
+#define B64_SPACE 0xfe
+#define B64_PAD 0xfd
+
+typedef struct {
+    const char *chars;         /* The 64 symbols in value order */
+    uint8_t dec[256];          /* Filled on first use by b64_table() */
+    int ready;
+} B64Alphabet;
+
+static B64Alphabet B64_STD __attribute__((unused)) = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", {0}, 0
+};
+static B64Alphabet B64_URL __attribute__((unused)) = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", {0}, 0
+};
+
+static const uint8_t *b64_table(B64Alphabet *a) {
+    if (!a->ready) {
+        memset(a->dec, B64_INVALID, sizeof(a->dec));
+        for (int i = 0; i < 64; i++) a->dec[(uint8_t)a->chars[i]] = (uint8_t)i;
+        a->dec[' '] = a->dec['\t'] = a->dec['\r'] = a->dec['\n'] = B64_SPACE;
+        a->dec['\f'] = a->dec['\v'] = B64_SPACE;
+        a->dec['='] = B64_PAD;
+        a->ready = 1;
+    }
+    return a->dec;
+}
+
+/* ========================================================================== */
+/* Encoding                                                                   */
+/* ========================================================================== */
+
+static size_t b64_encoded_len(size_t n, int pad) {
+    if (pad) return (n + 2) / 3 * 4;
+    return n / 3 * 4 + (n % 3 ? n % 3 + 1 : 0);
+}
+
+#ifdef __wasm_simd128__
+
+/* Encode the first 12 of 16 loaded bytes into 16 characters */
+static inline v128_t b64_encode_block(v128_t in, v128_t offsets) {
+    /* Each 32-bit lane gets one 3-byte group as bytes [b1 b0 b2 b1] */
+    in = wasm_i8x16_shuffle(in, in, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+
+    /* Index a = b0 >> 2 and c = (b1 & 15) << 2 | b2 >> 6 sit in the low and
+       high 16 bits of t0; b and d in t1. Shift each half into place. */
+    v128_t t0 = wasm_v128_and(in, wasm_i32x4_splat(0x0fc0fc00));
+    t0 = wasm_v128_or(wasm_v128_and(wasm_u16x8_shr(t0, 10), wasm_i32x4_splat(0x0000ffff)),
+                      wasm_v128_and(wasm_u16x8_shr(t0, 6), wasm_i32x4_splat((int32_t)0xffff0000)));
+    v128_t t1 = wasm_v128_and(in, wasm_i32x4_splat(0x003f03f0));
+    t1 = wasm_v128_or(wasm_v128_and(wasm_i16x8_shl(t1, 4), wasm_i32x4_splat(0x0000ffff)),
+                      wasm_v128_and(wasm_i16x8_shl(t1, 8), wasm_i32x4_splat((int32_t)0xffff0000)));
+    v128_t indices = wasm_v128_or(t0, t1);
+
+    /* Map each index range to a table slot: 0..25 -> 13, 26..51 -> 0,
+       52..61 -> 1..10, 62 -> 11, 63 -> 12 */
+    v128_t slot = wasm_u8x16_sub_sat(indices, wasm_i8x16_splat(51));
+    v128_t upper = wasm_i8x16_gt(wasm_i8x16_splat(26), indices);
+    slot = wasm_v128_or(slot, wasm_v128_and(upper, wasm_i8x16_splat(13)));
+    return wasm_i8x16_add(indices, wasm_i8x16_swizzle(offsets, slot));
+}
+
+#endif
+
+/**
+ * Encode n bytes into dst (b64_encoded_len(n, pad) bytes, not
+ * terminated). Returns the number of characters written.
+ */
+static size_t b64_encode(const B64Alphabet *a, const uint8_t *src, size_t n, char *dst, int pad) {
+    const char *chars = a->chars;
+    size_t i = 0;
+    char *o = dst;
+
+#ifdef __wasm_simd128__
+    v128_t offsets = wasm_i8x16_make(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, (int8_t)(chars[62] - 62), (int8_t)(chars[63] - 63), 'A', 0, 0);
+    /* Each step loads 16 bytes but consumes 12 */
+    for (; i + 16 <= n; i += 12, o += 16) {
+        wasm_v128_store(o, b64_encode_block(wasm_v128_load(src + i), offsets));
+    }
+#endif
+
+    for (; i + 3 <= n; i += 3, o += 4) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        o[0] = chars[v >> 18];
+        o[1] = chars[(v >> 12) & 63];
+        o[2] = chars[(v >> 6) & 63];
+        o[3] = chars[v & 63];
+    }
+
+    if (i < n) {
+        uint32_t v = (uint32_t)src[i] << 16 | (i + 1 < n ? (uint32_t)src[i + 1] << 8 : 0);
+        *o++ = chars[v >> 18];
+        *o++ = chars[(v >> 12) & 63];
+        if (i + 1 < n) *o++ = chars[(v >> 6) & 63];
+        else if (pad) *o++ = '=';
+        if (pad) *o++ = '=';
+    }
+    return (size_t)(o - dst);
+}
+
+/* ========================================================================== */
+/* Decoding                                                                   */
+/* ========================================================================== */
+
+typedef struct {
+    B64Alphabet *alpha;
+    const uint8_t *dec;
+    int strict;
+    uint32_t acc;              /* Pending 6-bit values */
+    int nacc;                  /* How many (0..3) */
+    int pads;                  /* '=' seen */
+    int pads_expected;         /* '=' the final quantum needs (1 or 2) */
+    int error;                 /* Set on invalid input; decoding stops */
+} B64Decoder;
+
+static void b64_decoder_init(B64Decoder *d, B64Alphabet *alpha, int strict) {
+    d->alpha = alpha;
+    d->dec = b64_table(alpha);
+    d->strict = strict;
+    d->acc = 0;
+    d->nacc = 0;
+    d->pads = 0;
+    d->pads_expected = 0;
+    d->error = 0;
+}
+
+/* Output buffer size needed for b64_decode_update() on n characters */
+static size_t b64_decode_bound(size_t n) {
+    return n / 4 * 3 + 3 + 16;
+}
+
+/*
+ * Emit the bytes of a partial quantum (2 or 3 values). Strict mode
+ * rejects non-zero bits left over, which non-canonical encoders produce.
+ */
+static size_t b64_decode_partial(B64Decoder *d, uint8_t *o) {
+    size_t n = 0;
+    if (d->nacc == 2) {
+        if (d->strict && (d->acc & 0x0f)) d->error = 1;
+        o[n++] = (uint8_t)(d->acc >> 4);
+    } else if (d->nacc == 3) {
+        if (d->strict && (d->acc & 0x03)) d->error = 1;
+        o[n++] = (uint8_t)(d->acc >> 10);
+        o[n++] = (uint8_t)(d->acc >> 2);
+    } else if (d->nacc == 1) {
+        d->error = 1;
+    }
+    d->nacc = 0;
+    d->acc = 0;
+    return n;
+}
+
+/* One character through the lookup table; returns bytes written */
+static size_t b64_decode_char(B64Decoder *d, uint8_t c, uint8_t *o) {
+    uint8_t v = d->dec[c];
+    if (v < 64) {
+        if (d->pads) {
+            /* Data after padding */
+            d->error = 1;
+            return 0;
+        }
+        d->acc = d->acc << 6 | v;
+        if (++d->nacc < 4) return 0;
+        o[0] = (uint8_t)(d->acc >> 16);
+        o[1] = (uint8_t)(d->acc >> 8);
+        o[2] = (uint8_t)d->acc;
+        d->nacc = 0;
+        d->acc = 0;
+        return 3;
+    }
+    if (v == B64_SPACE) {
+        if (d->strict) d->error = 1;
+        return 0;
+    }
+    if (v == B64_PAD) {
+        /* "xx==" or "xxx=": the first '=' completes the quantum */
+        if (d->pads++ == 0) {
+            if (d->nacc < 2) {
+                d->error = 1;
+                return 0;
+            }
+            d->pads_expected = 4 - d->nacc;
+            return b64_decode_partial(d, o);
+        }
+        if (d->pads > d->pads_expected) d->error = 1;
+        return 0;
+    }
+    d->error = 1;
+    return 0;
+}
+
+#ifdef __wasm_simd128__
+
+/*
+ * Decode 16 characters to 12 bytes if they are all alphabet characters.
+ * Writes 16 bytes to dst (the last 4 are scratch). Returns 0 otherwise.
+ */
+static inline int b64_decode_block(const B64Alphabet *a, const char *src, uint8_t *dst) {
+    v128_t c = wasm_v128_load(src);
+    v128_t upper = wasm_v128_and(wasm_u8x16_ge(c, wasm_i8x16_splat('A')),
+                                 wasm_u8x16_le(c, wasm_i8x16_splat('Z')));
+    v128_t lower = wasm_v128_and(wasm_u8x16_ge(c, wasm_i8x16_splat('a')),
+                                 wasm_u8x16_le(c, wasm_i8x16_splat('z')));
+    v128_t digit = wasm_v128_and(wasm_u8x16_ge(c, wasm_i8x16_splat('0')),
+                                 wasm_u8x16_le(c, wasm_i8x16_splat('9')));
+    v128_t s62 = wasm_i8x16_eq(c, wasm_i8x16_splat(a->chars[62]));
+    v128_t s63 = wasm_i8x16_eq(c, wasm_i8x16_splat(a->chars[63]));
+    v128_t valid = wasm_v128_or(wasm_v128_or(upper, lower),
+                                wasm_v128_or(digit, wasm_v128_or(s62, s63)));
+    if (!wasm_i8x16_all_true(valid)) return 0;
+
+    v128_t offset = wasm_v128_or(
+        wasm_v128_or(wasm_v128_and(upper, wasm_i8x16_splat(-'A')),
+                     wasm_v128_and(lower, wasm_i8x16_splat(26 - 'a'))),
+        wasm_v128_or(wasm_v128_and(digit, wasm_i8x16_splat(52 - '0')),
+                     wasm_v128_or(wasm_v128_and(s62, wasm_i8x16_splat((int8_t)(62 - a->chars[62]))),
+                                  wasm_v128_and(s63, wasm_i8x16_splat((int8_t)(63 - a->chars[63]))))));
+    v128_t v = wasm_i8x16_add(c, offset);
+
+    /* Pairs of 6-bit values -> 12 bits per 16-bit lane, then pairs of
+       those -> 24 bits per 32-bit lane, stored big-endian */
+    v128_t m = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(v, wasm_i16x8_splat(0x00ff)), 6),
+                            wasm_u16x8_shr(v, 8));
+    v128_t w = wasm_v128_or(wasm_i32x4_shl(wasm_v128_and(m, wasm_i32x4_splat(0x0000ffff)), 12),
+                            wasm_u32x4_shr(m, 16));
+    wasm_v128_store(dst, wasm_i8x16_shuffle(w, w, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, 3, 7, 11, 15));
+    return 1;
+}
+
+#endif
+
+/**
+ * Decode n characters into dst, which must hold b64_decode_bound(n)
+ * bytes. Returns the number of bytes written; check d->error afterwards.
+ */
+static size_t b64_decode_update(B64Decoder *d, const char *src, size_t n, uint8_t *dst) {
+    const uint8_t *dec = d->dec;
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *o = dst;
+    size_t i = 0;
+
+    while (i < n && !d->error) {
+#ifdef __wasm_simd128__
+        if (d->nacc == 0 && !d->pads) {
+            while (i + 16 <= n && b64_decode_block(d->alpha, src + i, o)) {
+                i += 16;
+                o += 12;
+            }
+        }
+#endif
+        /* Scalar for at least one block, then until back on a quantum
+           boundary; whole quanta of plain characters skip the state machine */
+        size_t stop = n - i > 16 ? i + 16 : n;
+        while (i < n && !d->error && (i < stop || d->nacc != 0)) {
+            if (d->nacc == 0 && !d->pads && i + 4 <= n) {
+                uint8_t v0 = dec[s[i]], v1 = dec[s[i + 1]], v2 = dec[s[i + 2]], v3 = dec[s[i + 3]];
+                if ((v0 | v1 | v2 | v3) < 64) {
+                    uint32_t v = (uint32_t)v0 << 18 | (uint32_t)v1 << 12 | (uint32_t)v2 << 6 | v3;
+                    o[0] = (uint8_t)(v >> 16);
+                    o[1] = (uint8_t)(v >> 8);
+                    o[2] = (uint8_t)v;
+                    o += 3;
+                    i += 4;
+                    continue;
+                }
+            }
+            o += b64_decode_char(d, s[i++], o);
+        }
+    }
+    return (size_t)(o - dst);
+}
+
+/**
+ * Finish decoding: flush a final unpadded quantum (an error in strict
+ * mode) and check padding. Writes at most 2 bytes to dst.
+ */
+static size_t b64_decode_final(B64Decoder *d, uint8_t *dst) {
+    if (d->error) return 0;
+    if (d->pads) {
+        if (d->strict && d->pads != d->pads_expected) d->error = 1;
+        return 0;
+    }
+    if (d->nacc == 0) return 0;
+    if (d->strict) {
+        d->error = 1;
+        return 0;
+    }
+    return b64_decode_partial(d, dst);
+}
+
+#endif /* BASE64_H */
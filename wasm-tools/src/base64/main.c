@@ -1,7 +1,13 @@
 /**
  * base64 - Encode and decode Base64 data
  *
- * Usage: base64 <encode|decode> <input>
+ * Usage: base64 [encode|decode] [--mode encode|decode] [--url] [--strict] [input]
+ *
+ * Without an input argument, stdin is streamed through in fixed-size
+ * chunks, so binary data of any size is handled. Decoding skips
+ * whitespace (e.g. MIME line breaks) and tolerates missing padding;
+ * --strict accepts only canonical Base64. --url uses the URL-safe
+ * alphabet (- and _ instead of + and /).
  *
  * This is a simple WASM tool that demonstrates the custom tools system.
  */
@@ -9,95 +15,138 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include "../base64.h"
+#include "../stdout_write.h"
+
+/* Encode input in multiples of 3 bytes so chunks join without padding */
+#define ENCODE_CHUNK (3 * 12288)
+#define DECODE_CHUNK 32768
 
-static const char b64_table[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static uint8_t in_buf[ENCODE_CHUNK > DECODE_CHUNK ? ENCODE_CHUNK : DECODE_CHUNK];
+
+static void encode_chunk(const B64Alphabet *alpha, const uint8_t *data, size_t len) {
+    char *out = out_reserve(b64_encoded_len(len, 1));
+    out_len += b64_encode(alpha, data, len, out, 1);
+}
 
 /**
- * Encode a string to Base64.
+ * Encode a buffer or, when input is NULL, all of stdin.
  */
-void encode(const char *input) {
-    size_t len = strlen(input);
-    size_t i;
-
-    for (i = 0; i < len; i += 3) {
-        unsigned char b0 = input[i];
-        unsigned char b1 = (i + 1 < len) ? input[i + 1] : 0;
-        unsigned char b2 = (i + 2 < len) ? input[i + 2] : 0;
-
-        putchar(b64_table[b0 >> 2]);
-        putchar(b64_table[((b0 & 0x03) << 4) | (b1 >> 4)]);
-        putchar((i + 1 < len) ? b64_table[((b1 & 0x0f) << 2) | (b2 >> 6)] : '=');
-        putchar((i + 2 < len) ? b64_table[b2 & 0x3f] : '=');
+static int encode(const B64Alphabet *alpha, const char *input) {
+    size_t total = 0;
+
+    if (input) {
+        size_t len = strlen(input);
+        for (size_t i = 0; i < len; i += ENCODE_CHUNK) {
+            size_t n = len - i < ENCODE_CHUNK ? len - i : ENCODE_CHUNK;
+            encode_chunk(alpha, (const uint8_t *)input + i, n);
+        }
+        total = len;
+    } else {
+        /* Short reads leave up to 2 bytes to carry into the next chunk */
+        size_t fill = 0, n;
+        while ((n = fread(in_buf + fill, 1, ENCODE_CHUNK - fill, stdin)) > 0) {
+            fill += n;
+            total += n;
+            size_t whole = fill - fill % 3;
+            encode_chunk(alpha, in_buf, whole);
+            memmove(in_buf, in_buf + whole, fill - whole);
+            fill -= whole;
+        }
+        if (ferror(stdin)) {
+            out_flush();
+            fprintf(stderr, "base64: read error\n");
+            return 1;
+        }
+        encode_chunk(alpha, in_buf, fill);
     }
-    putchar('\n');
+
+    if (total > 0) out_char('\n');
+    return 0;
 }
 
-/**
- * Reverse lookup table for base64 decoding.
- */
-static int b64_decode_char(char c) {
-    if (c >= 'A' && c <= 'Z') return c - 'A';
-    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
-    if (c >= '0' && c <= '9') return c - '0' + 52;
-    if (c == '+') return 62;
-    if (c == '/') return 63;
-    return -1;  // Invalid character or padding
+static void decode_chunk(B64Decoder *dec, const char *data, size_t len) {
+    uint8_t *out = (uint8_t *)out_reserve(b64_decode_bound(len));
+    out_len += b64_decode_update(dec, data, len, out);
 }
 
 /**
- * Decode a Base64 string.
+ * Decode a buffer or, when input is NULL, all of stdin.
  */
-void decode(const char *input) {
-    size_t len = strlen(input);
-    size_t i;
-
-    for (i = 0; i < len; i += 4) {
-        int b0 = b64_decode_char(input[i]);
-        int b1 = (i + 1 < len) ? b64_decode_char(input[i + 1]) : -1;
-        int b2 = (i + 2 < len && input[i + 2] != '=') ? b64_decode_char(input[i + 2]) : 0;
-        int b3 = (i + 3 < len && input[i + 3] != '=') ? b64_decode_char(input[i + 3]) : 0;
-
-        if (b0 < 0 || b1 < 0) break;  // Invalid input
+static int decode(B64Alphabet *alpha, int strict, const char *input) {
+    B64Decoder dec;
+    b64_decoder_init(&dec, alpha, strict);
 
-        putchar((b0 << 2) | (b1 >> 4));
-        if (i + 2 < len && input[i + 2] != '=') {
-            putchar(((b1 & 0x0f) << 4) | (b2 >> 2));
+    if (input) {
+        size_t len = strlen(input);
+        for (size_t i = 0; i < len && !dec.error; i += DECODE_CHUNK) {
+            size_t n = len - i < DECODE_CHUNK ? len - i : DECODE_CHUNK;
+            decode_chunk(&dec, input + i, n);
         }
-        if (i + 3 < len && input[i + 3] != '=') {
-            putchar(((b2 & 0x03) << 6) | b3);
+    } else {
+        size_t n;
+        while (!dec.error && (n = fread(in_buf, 1, DECODE_CHUNK, stdin)) > 0) {
+            decode_chunk(&dec, (const char *)in_buf, n);
+        }
+        if (ferror(stdin)) {
+            out_flush();
+            fprintf(stderr, "base64: read error\n");
+            return 1;
         }
     }
-}
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: base64 <encode|decode> [input]\n");
+    uint8_t *out = (uint8_t *)out_reserve(2);
+    out_len += b64_decode_final(&dec, out);
+    if (dec.error) {
+        out_flush();
+        fprintf(stderr, "base64: invalid input\n");
         return 1;
     }
+    return 0;
+}
 
-    const char *input = (argc >= 3) ? argv[2] : NULL;
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: base64 <encode|decode> <input>\nOr pipe input via stdin.\n");
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: base64 [encode|decode] [--mode encode|decode] [--url] [--strict] [input]\n"
+            "Or pipe input via stdin.\n");
+}
+
+int main(int argc, char **argv) {
+    const char *mode = NULL;
+    const char *input = NULL;
+    int url = 0, strict = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--mode") == 0 && i + 1 < argc) mode = argv[++i];
+        else if (strcmp(arg, "--url") == 0) url = 1;
+        else if (strcmp(arg, "--strict") == 0) strict = 1;
+        else if (!mode && (strcmp(arg, "encode") == 0 || strcmp(arg, "decode") == 0)) mode = arg;
+        else if (strcmp(arg, "--input") == 0 && i + 1 < argc) input = argv[++i];
+        else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            usage();
             return 1;
         }
-        input = stdin_buf;
+        else input = arg;
     }
 
-    if (strcmp(argv[1], "encode") == 0) {
-        encode(input);
-    } else if (strcmp(argv[1], "decode") == 0) {
-        decode(input);
+    if (!mode) {
+        usage();
+        return 1;
+    }
+
+    B64Alphabet *alpha = url ? &B64_URL : &B64_STD;
+    int status;
+    if (strcmp(mode, "encode") == 0) {
+        status = encode(alpha, input);
+    } else if (strcmp(mode, "decode") == 0) {
+        status = decode(alpha, strict, input);
     } else {
-        fprintf(stderr, "Unknown mode: %s\n", argv[1]);
-        free(stdin_buf);
+        fprintf(stderr, "Unknown mode: %s\n", mode);
         return 1;
     }
 
-    free(stdin_buf);
-    return 0;
+    out_flush();
+    return status;
 }
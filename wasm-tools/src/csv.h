@@ -0,0 +1,307 @@
+/**
+ * Streaming RFC 4180 CSV tokenizer for WASM tools.
+ *
+ * CsvReader pulls input through a LineReader window and yields one record
+ * at a time as field spans into that window; nothing is copied. Quoted
+ * fields may contain the delimiter, doubled quotes ("") and newlines, and
+ * records may be any length.
+ *
+ * Structure is found 64 bytes at a time instead of byte by byte (the
+ * simdcsv approach): each block is turned into three bitmasks (quote,
+ * delimiter, newline) with simd128 compares, or word-at-a-time SWAR code
+ * in the scalar build. A prefix XOR over the quote mask marks every byte
+ * that sits inside quotes, with a carry bit across blocks, so
+ *
+ *   structural = (delimiter | newline) & ~inside_quotes
+ *
+ * and the field boundaries are just the set bits of that mask. Doubled
+ * quotes flip the state twice, so they need no special case.
+ *
+ * As in simdcsv, a quote is treated as opening a quoted region wherever it
+ * appears; RFC 4180 only allows one at the start of a field, and stray
+ * quotes inside an unquoted field are only read the same way as by
+ * lenient parsers when they come in pairs.
+ *
+ * A quoted field's span excludes its outer quotes. Its contents are still
+ * in escaped form: `escaped` is set when it holds a doubled quote, and
+ * csv_field_unescape() produces the real value. A trailing '\r' (CRLF
+ * line endings) is dropped, and blank lines are skipped.
+ *
+ * Usage:
+ *   LineReader in;
+ *   line_reader_init_stdin(&in);
+ *   CsvReader csv;
+ *   csv_reader_init(&csv, &in, ',');
+ *   while (csv_reader_next(&csv)) {
+ *       for (size_t i = 0; i < csv.rec.count; i++) {
+ *           csv_write_field(&csv.rec.fields[i], ',');
+ *       }
+ *   }
+ *   csv_reader_free(&csv);
+ *   line_reader_free(&in);
+ */
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "line_reader.h"
+#include "stdout_write.h"
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+    int quoted;     /* Field was enclosed in quotes */
+    int escaped;    /* Contents hold doubled quotes; see csv_field_unescape() */
+} CsvField;
+
+typedef struct {
+    CsvField *fields;
+    size_t count;
+    const char *raw;    /* The record's own text, without its line ending */
+    size_t raw_len;
+} CsvRecord;
+
+typedef struct {
+    size_t start, end;  /* Relative to the record start (the reader's head) */
+} CsvSpan;
+
+typedef struct {
+    LineReader *in;
+    char delim;
+    CsvRecord rec;      /* Valid until the next csv_reader_next() call */
+    size_t records;     /* Records yielded so far */
+    int error;          /* Allocation failure */
+
+    CsvSpan *spans;
+    size_t span_count, span_cap;
+    size_t fields_cap;
+    size_t field_start;
+
+    uint64_t bits;      /* Unvisited structural positions in the current block */
+    size_t block;       /* Buffer offset of the current block */
+    uint64_t in_quotes; /* All ones when the last block ended inside quotes */
+} CsvReader;
+
+static void csv_reader_init(CsvReader *c, LineReader *in, char delim) {
+    memset(c, 0, sizeof(*c));
+    c->in = in;
+    c->delim = delim;
+}
+
+static void csv_reader_free(CsvReader *c) {
+    free(c->spans);
+    free(c->rec.fields);
+    c->spans = NULL;
+    c->rec.fields = NULL;
+}
+
+/* Bit i set <=> an odd number of bits at or below i are set in x */
+static inline uint64_t csv_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+#ifndef __wasm_simd128__
+/* Gather the 0x80 flags of simd_zero_bytes() into the low 8 bits */
+static inline uint64_t csv_movemask64(uint64_t hits) {
+    return ((hits >> 7) * 0x0102040810204080ULL) >> 56;
+}
+#endif
+
+/* Quote, delimiter and newline masks for n <= 64 bytes (bit i = p[i]) */
+static void csv_block_masks(const unsigned char *p, size_t n, unsigned char delim,
+                            uint64_t *quote, uint64_t *sep, uint64_t *newline) {
+    uint64_t q = 0, d = 0, nl = 0;
+    if (n == 64) {
+#ifdef __wasm_simd128__
+        v128_t q_v = wasm_i8x16_splat('"');
+        v128_t d_v = wasm_i8x16_splat((int8_t)delim);
+        v128_t nl_v = wasm_i8x16_splat('\n');
+        for (int k = 0; k < 4; k++) {
+            v128_t v = wasm_v128_load(p + 16 * k);
+            q |= (uint64_t)wasm_i8x16_bitmask(wasm_i8x16_eq(v, q_v)) << (16 * k);
+            d |= (uint64_t)wasm_i8x16_bitmask(wasm_i8x16_eq(v, d_v)) << (16 * k);
+            nl |= (uint64_t)wasm_i8x16_bitmask(wasm_i8x16_eq(v, nl_v)) << (16 * k);
+        }
+#else
+        for (int k = 0; k < 8; k++) {
+            uint64_t w = simd_load64(p + 8 * k);
+            q |= csv_movemask64(simd_zero_bytes(w ^ (SIMD_ONES * '"'))) << (8 * k);
+            d |= csv_movemask64(simd_zero_bytes(w ^ (SIMD_ONES * delim))) << (8 * k);
+            nl |= csv_movemask64(simd_zero_bytes(w ^ (SIMD_ONES * '\n'))) << (8 * k);
+        }
+#endif
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            q |= (uint64_t)(p[i] == '"') << i;
+            d |= (uint64_t)(p[i] == delim) << i;
+            nl |= (uint64_t)(p[i] == '\n') << i;
+        }
+    }
+    *quote = q;
+    *sep = d;
+    *newline = nl;
+}
+
+static int csv_push_span(CsvReader *c, size_t start, size_t end) {
+    if (c->span_count == c->span_cap) {
+        size_t cap = c->span_cap ? c->span_cap * 2 : 64;
+        CsvSpan *tmp = (CsvSpan *)realloc(c->spans, cap * sizeof(CsvSpan));
+        if (!tmp) { c->error = 1; return 0; }
+        c->spans = tmp;
+        c->span_cap = cap;
+    }
+    c->spans[c->span_count].start = start;
+    c->spans[c->span_count].end = end;
+    c->span_count++;
+    return 1;
+}
+
+/*
+ * Turn the collected spans of the record at [head, head + len) into
+ * fields. Returns 0 for a blank line (which is skipped) or on error.
+ */
+static int csv_finish_record(CsvReader *c, size_t len) {
+    const char *base = c->in->buf + c->in->head;
+    if (len > 0 && base[len - 1] == '\r') len--;
+    if (len == 0) return 0;
+
+    if (c->span_count > c->fields_cap) {
+        CsvField *tmp = (CsvField *)realloc(c->rec.fields, c->span_count * sizeof(CsvField));
+        if (!tmp) { c->error = 1; return 0; }
+        c->rec.fields = tmp;
+        c->fields_cap = c->span_count;
+    }
+
+    for (size_t i = 0; i < c->span_count; i++) {
+        size_t s = c->spans[i].start, e = c->spans[i].end;
+        if (e > len) e = len;
+        CsvField *f = &c->rec.fields[i];
+        f->quoted = f->escaped = 0;
+        if (e > s && base[s] == '"') {
+            f->quoted = 1;
+            s++;
+            if (e > s && base[e - 1] == '"') e--;
+            f->escaped = memchr(base + s, '"', e - s) != NULL;
+        }
+        f->ptr = base + s;
+        f->len = e - s;
+    }
+    c->rec.count = c->span_count;
+    c->rec.raw = base;
+    c->rec.raw_len = len;
+    c->records++;
+    return 1;
+}
+
+/*
+ * Advance to the next record; its fields are in c->rec. Returns 1 when a
+ * record was produced, 0 at end of input or on error (c->error or
+ * c->in->error is set).
+ */
+static int csv_reader_next(CsvReader *c) {
+    LineReader *r = c->in;
+    for (;;) {
+        while (c->bits) {
+            size_t pos = c->block + (size_t)__builtin_ctzll(c->bits);
+            c->bits &= c->bits - 1;
+            if (!csv_push_span(c, c->field_start, pos - r->head)) return 0;
+            c->field_start = pos - r->head + 1;
+            if (r->buf[pos] == '\n') {
+                int ok = csv_finish_record(c, pos - r->head);
+                if (c->error) return 0;
+                // The fields stay valid: the window only slides on the
+                // next refill, and this block still has to be finished
+                r->head = pos + 1;
+                c->span_count = 0;
+                c->field_start = 0;
+                if (ok) return 1;
+            }
+        }
+
+        size_t avail = r->tail - r->scan;
+        if (avail < 64 && !r->eof && !r->error) {
+            line_reader_fill(r);
+            continue;
+        }
+        if (avail == 0) {
+            // Final record without a line ending
+            if (r->error || (r->head == r->tail && c->span_count == 0)) return 0;
+            size_t len = r->tail - r->head;
+            if (!csv_push_span(c, c->field_start, len)) return 0;
+            int ok = csv_finish_record(c, len);
+            r->head = r->scan = r->tail;
+            c->span_count = 0;
+            c->field_start = 0;
+            return ok;
+        }
+
+        size_t n = avail < 64 ? avail : 64;
+        uint64_t quote, sep, newline;
+        csv_block_masks((const unsigned char *)r->buf + r->scan, n, (unsigned char)c->delim,
+                        &quote, &sep, &newline);
+        uint64_t inside = csv_prefix_xor(quote) ^ c->in_quotes;
+        c->in_quotes = (inside >> (n - 1)) & 1 ? ~0ULL : 0;
+        c->bits = (sep | newline) & ~inside;
+        c->block = r->scan;
+        r->scan += n;
+    }
+}
+
+/* Copy a field's value to dst (at least f->len bytes), undoubling quotes */
+static size_t csv_field_unescape(const CsvField *f, char *dst) {
+    if (!f->escaped) {
+        memcpy(dst, f->ptr, f->len);
+        return f->len;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < f->len; i++) {
+        dst[n++] = f->ptr[i];
+        if (f->ptr[i] == '"' && i + 1 < f->len && f->ptr[i + 1] == '"') i++;
+    }
+    return n;
+}
+
+/*
+ * Write a field to stdout as CSV, quoted only when its value needs it
+ * (it holds the delimiter, a quote, CR or LF).
+ */
+static void csv_write_field(const CsvField *f, char delim) {
+    if (f->escaped) {
+        // Escaped contents are already in doubled form
+        out_char('"');
+        out_write(f->ptr, f->len);
+        out_char('"');
+        return;
+    }
+    int needs_quotes = 0, has_quote = 0;
+    for (size_t i = 0; i < f->len; i++) {
+        char ch = f->ptr[i];
+        if (ch == '"') has_quote = 1;
+        if (ch == delim || ch == '"' || ch == '\n' || ch == '\r') needs_quotes = 1;
+    }
+    if (!needs_quotes) {
+        out_write(f->ptr, f->len);
+        return;
+    }
+    out_char('"');
+    if (has_quote) {
+        for (size_t i = 0; i < f->len; i++) {
+            if (f->ptr[i] == '"') out_char('"');
+            out_char(f->ptr[i]);
+        }
+    } else {
+        out_write(f->ptr, f->len);
+    }
+    out_char('"');
+}
+
+#endif /* CSV_H */
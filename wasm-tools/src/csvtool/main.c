@@ -1,239 +1,1158 @@
 /**
  * csvtool - CSV manipulation utilities
  * Usage: csvtool <command> [options] <csv-data>
- * Commands: col, head, tail, width, height, cat
+ * Commands: cat, select (col), filter, head, tail, count (height), width, tojson,
+ *           stats, groupby, distinct
+ *
+ * Input is tokenized as RFC 4180 CSV by csv.h while it streams in:
+ * quoted fields may hold delimiters, doubled quotes and newlines, and
+ * rows may be any width or length. Every row command runs the same
+ * pipeline, so options combine freely:
+ *
+ *   rows -> --where filters -> --columns projection -> command
+ *
+ * Column references are 1-based numbers, ranges (2-4, 3-) or, with a
+ * header row, column names; using a name implies --header. Output rows
+ * are written back as CSV, quoting only the fields that need it.
+ *
+ * stats, groupby and distinct replace sort/uniq/awk pipelines: they keep
+ * one accumulator per column or group rather than the rows themselves.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include <math.h>
+#include "../csv.h"
+#include "../line_index.h"
+#include "../regex_engine.h"
+#include "../stdout_write.h"
 
-#define MAX_COLS 1024
-#define MAX_LINE 65536
+#define OPEN_END -1L
 
 typedef struct {
-    char *fields[MAX_COLS];
-    int field_count;
-} CSVRow;
+    long lo, hi;        /* 0-based, inclusive; hi is OPEN_END for "N-" */
+} ColRange;
 
-// Parse a CSV line into fields
-int parse_csv_line(char *line, CSVRow *row) {
-    row->field_count = 0;
-    char *p = line;
-    int in_quotes = 0;
-    char *field_start = p;
+enum { OP_EQ, OP_NE, OP_MATCH, OP_NOMATCH, OP_LT, OP_LE, OP_GT, OP_GE };
 
-    while (*p && row->field_count < MAX_COLS) {
-        if (*p == '"') {
-            in_quotes = !in_quotes;
-        } else if (*p == ',' && !in_quotes) {
-            *p = '\0';
-            row->fields[row->field_count++] = field_start;
-            field_start = p + 1;
-        }
-        p++;
+enum {
+    CMD_CAT, CMD_SELECT, CMD_FILTER, CMD_HEAD, CMD_TAIL, CMD_COUNT, CMD_WIDTH, CMD_TOJSON,
+    CMD_STATS, CMD_GROUPBY, CMD_DISTINCT
+};
+
+typedef struct {
+    const char *column; /* As written; resolved once the header is known */
+    long index;
+    int op;
+    const char *value;
+    size_t value_len;
+    double number;
+    int is_number;
+    Regex *re;
+} Condition;
+
+typedef struct {
+    const char *command;
+    const char *columns;
+    const char *where[64];
+    int where_count;
+    int header;
+    char delim;
+    long count;
+    const char *by;
+    const char *input;
+} Options;
+
+typedef struct {
+    char **names;       /* Header values, unescaped */
+    size_t *lens;
+    size_t count;
+} Header;
+
+static ColRange *ranges;
+static size_t range_count;
+static Condition conds[64];
+static int cond_count;
+static char *scratch;
+static size_t scratch_cap;
+
+static int out_of_memory(void) {
+    out_flush();
+    fprintf(stderr, "Error: Out of memory\n");
+    return 1;
+}
+
+/* Field value with quotes undoubled; points into the input when it can */
+static const char *field_value(const CsvField *f, size_t *len) {
+    if (!f->escaped) {
+        *len = f->len;
+        return f->ptr;
     }
+    if (f->len + 1 > scratch_cap) {
+        char *tmp = (char *)realloc(scratch, f->len + 1);
+        if (!tmp) return NULL;
+        scratch = tmp;
+        scratch_cap = f->len + 1;
+    }
+    *len = csv_field_unescape(f, scratch);
+    return scratch;
+}
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
 
-    // Add last field
-    if (field_start <= p && row->field_count < MAX_COLS) {
-        // Remove trailing newline/carriage return
-        char *end = p - 1;
-        while (end >= field_start && (*end == '\n' || *end == '\r')) {
-            *end-- = '\0';
+/*
+ * Parse a whole string as a number (surrounding blanks allowed). Plain
+ * decimals whose digits fit in 53 bits are converted directly, which is
+ * exact: both the digits and the power of ten are exact doubles, so the
+ * one division rounds correctly. Everything else goes through strtod.
+ */
+static int parse_number(const char *s, size_t len, double *out) {
+    while (len > 0 && (*s == ' ' || *s == '\t')) { s++; len--; }
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t')) len--;
+    if (len == 0) return 0;
+
+    const char *p = s, *end = s + len;
+    int neg = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    uint64_t digits = 0;
+    int count = 0, frac = -1;
+    for (; p < end && count <= 16; p++) {
+        if (*p >= '0' && *p <= '9') {
+            digits = digits * 10 + (uint64_t)(*p - '0');
+            count++;
+            if (frac >= 0) frac++;
+        } else if (*p == '.' && frac < 0) {
+            frac = 0;
+        } else {
+            break;
         }
-        row->fields[row->field_count++] = field_start;
+    }
+    if (p == end && count > 0 && digits <= (1ULL << 53)) {
+        double v = (double)digits;
+        if (frac > 0) v /= pow10_table[frac];
+        *out = neg ? -v : v;
+        return 1;
     }
 
-    return row->field_count;
+    char tmp[64];
+    if (len >= sizeof(tmp)) return 0;
+    memcpy(tmp, s, len);
+    tmp[len] = '\0';
+    char *stop;
+    *out = strtod(tmp, &stop);
+    return *stop == '\0' && *out == *out;
 }
 
-// Print a CSV row
-void print_row(CSVRow *row) {
-    for (int i = 0; i < row->field_count; i++) {
-        if (i > 0) putchar(',');
+static int is_number_ref(const char *s, size_t len) {
+    if (len == 0) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return 0;
+    }
+    return 1;
+}
 
-        // Check if field needs quoting
-        const char *field = row->fields[i];
-        int needs_quotes = 0;
-        for (const char *c = field; *c; c++) {
-            if (*c == ',' || *c == '"' || *c == '\n') {
-                needs_quotes = 1;
-                break;
+/* "N-M", "N-" or "-M" */
+static int is_range_ref(const char *s, size_t len) {
+    const char *dash = (const char *)memchr(s, '-', len);
+    if (!dash || len == 1) return 0;
+    size_t left = (size_t)(dash - s), right = len - left - 1;
+    return (left == 0 || is_number_ref(s, left)) && (right == 0 || is_number_ref(dash + 1, right));
+}
+
+/* Column index for a number or header name, or -1 */
+static long resolve_column(const char *s, size_t len, const Header *h) {
+    if (is_number_ref(s, len)) return strtol(s, NULL, 10) - 1;
+    for (size_t i = 0; i < h->count; i++) {
+        if (h->lens[i] == len && memcmp(h->names[i], s, len) == 0) return (long)i;
+    }
+    return -1;
+}
+
+static int list_uses_names(const char *list) {
+    const char *p = list;
+    while (p && *p) {
+        size_t len = strcspn(p, ",");
+        if (!is_number_ref(p, len) && !is_range_ref(p, len)) return 1;
+        p += len + (p[len] == ',');
+    }
+    return 0;
+}
+
+static int resolve_columns(const char *list, const Header *h, ColRange **out, size_t *count) {
+    const char *p = list;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        ColRange r;
+        if (is_range_ref(p, len)) {
+            const char *dash = (const char *)memchr(p, '-', len);
+            r.lo = dash == p ? 0 : strtol(p, NULL, 10) - 1;
+            r.hi = dash + 1 == p + len ? OPEN_END : strtol(dash + 1, NULL, 10) - 1;
+        } else {
+            r.lo = r.hi = resolve_column(p, len, h);
+        }
+        if (r.lo < 0 || (r.hi != OPEN_END && r.hi < r.lo)) {
+            fprintf(stderr, "Error: Unknown column '%.*s'\n", (int)len, p);
+            return 0;
+        }
+        ColRange *tmp = (ColRange *)realloc(*out, (*count + 1) * sizeof(ColRange));
+        if (!tmp) return 0;
+        *out = tmp;
+        (*out)[(*count)++] = r;
+        p += len + (p[len] == ',');
+    }
+    return 1;
+}
+
+/* Split "COL OP VALUE" */
+static int parse_condition(const char *expr, Condition *c) {
+    static const struct { const char *text; int op; } ops[] = {
+        {"!=", OP_NE}, {"!~", OP_NOMATCH}, {"<=", OP_LE}, {">=", OP_GE},
+        {"==", OP_EQ}, {"=", OP_EQ}, {"~", OP_MATCH}, {"<", OP_LT}, {">", OP_GT},
+    };
+    size_t at = strcspn(expr + (*expr != '\0'), "=!~<>") + (*expr != '\0');
+    if (at == 0 || expr[at] == '\0') {
+        fprintf(stderr, "Error: Invalid condition '%s' (expected COL OP VALUE)\n", expr);
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        size_t n = strlen(ops[i].text);
+        if (strncmp(expr + at, ops[i].text, n) != 0) continue;
+        char *column = (char *)malloc(at + 1);
+        if (!column) {
+            out_of_memory();
+            return 0;
+        }
+        memcpy(column, expr, at);
+        column[at] = '\0';
+        c->column = column;
+        c->op = ops[i].op;
+        c->value = expr + at + n;
+        c->value_len = strlen(c->value);
+        c->is_number = parse_number(c->value, c->value_len, &c->number);
+        c->re = NULL;
+        if (c->op == OP_MATCH || c->op == OP_NOMATCH) {
+            const char *err;
+            c->re = re_compile(c->value, RE_EXTENDED, &err);
+            if (!c->re) {
+                fprintf(stderr, "Error: Invalid regex '%s': %s\n", c->value, err);
+                return 0;
             }
         }
+        return 1;
+    }
+    return 0;
+}
 
-        if (needs_quotes) {
-            putchar('"');
-            for (const char *c = field; *c; c++) {
-                if (*c == '"') putchar('"');
-                putchar(*c);
+static int row_matches(const CsvRecord *rec) {
+    for (int i = 0; i < cond_count; i++) {
+        const Condition *c = &conds[i];
+        size_t len = 0;
+        const char *v = "";
+        if (c->index < (long)rec->count) {
+            v = field_value(&rec->fields[c->index], &len);
+            if (!v) return 0;
+        }
+        int ok;
+        switch (c->op) {
+        case OP_EQ: ok = len == c->value_len && memcmp(v, c->value, len) == 0; break;
+        case OP_NE: ok = !(len == c->value_len && memcmp(v, c->value, len) == 0); break;
+        case OP_MATCH: ok = re_match(c->re, v, len); break;
+        case OP_NOMATCH: ok = !re_match(c->re, v, len); break;
+        default: {
+            double x;
+            int cmp;
+            if (c->is_number && parse_number(v, len, &x)) {
+                cmp = x < c->number ? -1 : x > c->number;
+            } else {
+                size_t n = len < c->value_len ? len : c->value_len;
+                cmp = memcmp(v, c->value, n);
+                if (cmp == 0) cmp = len < c->value_len ? -1 : len > c->value_len;
             }
-            putchar('"');
+            ok = c->op == OP_LT ? cmp < 0 : c->op == OP_LE ? cmp <= 0 :
+                 c->op == OP_GT ? cmp > 0 : cmp >= 0;
+        }
+        }
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Column indexes of the projected row; an index past rec->count stands
+ * for a missing column and is written as an empty field.
+ */
+static size_t *proj;
+static size_t proj_cap;
+
+/* Expand a column list against a row of the given width; none = all */
+static size_t expand_columns(const ColRange *rs, size_t rcount, size_t width,
+                             size_t **out, size_t *cap) {
+    size_t n = 0;
+    for (size_t r = 0; r < (rcount ? rcount : 1); r++) {
+        size_t lo = rcount ? (size_t)rs[r].lo : 0;
+        size_t hi;
+        if (!rcount || rs[r].hi == OPEN_END) {
+            if (lo >= width) continue;
+            hi = width - 1;
         } else {
-            printf("%s", field);
+            hi = (size_t)rs[r].hi;
         }
+        if (n + (hi - lo + 1) > *cap) {
+            size_t new_cap = *cap ? *cap : 64;
+            while (new_cap < n + (hi - lo + 1)) new_cap *= 2;
+            size_t *tmp = (size_t *)realloc(*out, new_cap * sizeof(size_t));
+            if (!tmp) break;
+            *out = tmp;
+            *cap = new_cap;
+        }
+        for (size_t col = lo; col <= hi; col++) (*out)[n++] = col;
     }
-    putchar('\n');
+    return n;
 }
 
-// Command: col - Extract specific columns
-void cmd_col(const char *cols, char *data) {
-    // Parse column numbers
-    int col_nums[MAX_COLS];
-    int num_cols = 0;
+static size_t project(const CsvRecord *rec) {
+    return expand_columns(ranges, range_count, rec->count, &proj, &proj_cap);
+}
 
-    char *cols_copy = strdup(cols);
-    char *token = strtok(cols_copy, ",");
-    while (token && num_cols < MAX_COLS) {
-        col_nums[num_cols++] = atoi(token) - 1;  // Convert to 0-indexed
-        token = strtok(NULL, ",");
+static void write_row(const CsvRecord *rec, char delim) {
+    size_t n = project(rec);
+    if (n == 1 && (proj[0] >= rec->count || rec->fields[proj[0]].len == 0)) {
+        // A lone empty field would read back as a blank line
+        out_str("\"\"\n");
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i > 0) out_char(delim);
+        if (proj[i] < rec->count) csv_write_field(&rec->fields[proj[i]], delim);
     }
-    free(cols_copy);
+    out_char('\n');
+}
 
-    // Process lines
-    char *line = strtok(data, "\n");
-    while (line) {
-        CSVRow row;
-        char *line_copy = strdup(line);
-        parse_csv_line(line_copy, &row);
+static void write_json_string(const char *s, size_t len) {
+    out_char('"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)s[i];
+        if (ch == '"' || ch == '\\') {
+            out_char('\\');
+            out_char((char)ch);
+        } else if (ch == '\n') {
+            out_str("\\n");
+        } else if (ch == '\r') {
+            out_str("\\r");
+        } else if (ch == '\t') {
+            out_str("\\t");
+        } else if (ch < 0x20) {
+            out_str("\\u00");
+            out_char(out_hex_digits[ch >> 4]);
+            out_char(out_hex_digits[ch & 15]);
+        } else {
+            out_char((char)ch);
+        }
+    }
+    out_char('"');
+}
 
-        // Print selected columns
-        for (int i = 0; i < num_cols; i++) {
-            if (i > 0) putchar(',');
-            int col = col_nums[i];
-            if (col >= 0 && col < row.field_count) {
-                printf("%s", row.fields[col]);
-            }
+static void write_json_row(const CsvRecord *rec, const Header *h, int first_row) {
+    out_str(first_row ? "[\n  {" : ",\n  {");
+    size_t n = project(rec);
+    for (size_t i = 0; i < n; i++) {
+        size_t col = proj[i];
+        if (i > 0) out_char(',');
+        if (col < h->count) {
+            write_json_string(h->names[col], h->lens[col]);
+        } else {
+            out_char('"');
+            out_uint(col + 1);
+            out_char('"');
         }
-        putchar('\n');
+        out_char(':');
+        size_t len = 0;
+        const char *v = col < rec->count ? field_value(&rec->fields[col], &len) : "";
+        write_json_string(v ? v : "", v ? len : 0);
+    }
+    out_char('}');
+}
 
-        free(line_copy);
-        line = strtok(NULL, "\n");
+static int save_header(const CsvRecord *rec, Header *h) {
+    h->names = (char **)calloc(rec->count ? rec->count : 1, sizeof(char *));
+    h->lens = (size_t *)calloc(rec->count ? rec->count : 1, sizeof(size_t));
+    if (!h->names || !h->lens) return 0;
+    h->count = rec->count;
+    for (size_t i = 0; i < rec->count; i++) {
+        h->names[i] = (char *)malloc(rec->fields[i].len + 1);
+        if (!h->names[i]) return 0;
+        h->lens[i] = csv_field_unescape(&rec->fields[i], h->names[i]);
+        h->names[i][h->lens[i]] = '\0';
     }
+    return 1;
+}
+
+static void free_header(Header *h) {
+    for (size_t i = 0; i < h->count; i++) free(h->names[i]);
+    free(h->names);
+    free(h->lens);
 }
 
-// Command: head - First N rows
-void cmd_head(int n, char *data) {
-    int count = 0;
-    char *line = strtok(data, "\n");
-    while (line && count < n) {
-        printf("%s\n", line);
-        count++;
-        line = strtok(NULL, "\n");
+/* Last N selected rows, kept as raw record text and re-parsed at the end */
+typedef struct {
+    char **rows;
+    size_t cap, count, next;
+    long limit;
+} TailRing;
+
+static int tail_push(TailRing *t, const CsvRecord *rec) {
+    if (t->count == t->cap && t->cap < (size_t)t->limit) {
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        if (cap > (size_t)t->limit) cap = (size_t)t->limit;
+        char **tmp = (char **)realloc(t->rows, cap * sizeof(char *));
+        if (!tmp) return 0;
+        t->rows = tmp;
+        t->cap = cap;
+        t->next = t->count;
     }
+    char *copy = (char *)malloc(rec->raw_len + 1);
+    if (!copy) return 0;
+    memcpy(copy, rec->raw, rec->raw_len);
+    copy[rec->raw_len] = '\0';
+    if (t->count < t->cap) {
+        t->rows[t->count++] = copy;
+        t->next = t->count % t->cap;
+    } else {
+        free(t->rows[t->next]);
+        t->rows[t->next] = copy;
+        t->next = (t->next + 1) % t->cap;
+    }
+    return 1;
 }
 
-// Command: tail - Last N rows
-void cmd_tail(int n, char *data) {
-    // Count lines
-    int total_lines = 0;
-    char *data_copy = strdup(data);
-    char *line = strtok(data_copy, "\n");
-    while (line) {
-        total_lines++;
-        line = strtok(NULL, "\n");
+static int tail_flush(TailRing *t, char delim) {
+    int status = 0;
+    for (size_t i = 0; i < t->count; i++) {
+        size_t at = t->count < t->cap ? i : (t->next + i) % t->cap;
+        char *row = t->rows[at];
+        LineReader in;
+        CsvReader csv;
+        if (!line_reader_init_string(&in, row)) {
+            status = 1;
+        } else {
+            csv_reader_init(&csv, &in, delim);
+            if (csv_reader_next(&csv)) write_row(&csv.rec, delim);
+            csv_reader_free(&csv);
+            line_reader_free(&in);
+        }
+        free(row);
     }
-    free(data_copy);
+    free(t->rows);
+    return status;
+}
+
+/*
+ * Aggregates (stats, groupby, distinct) run over chunks of AGG_CHUNK
+ * rows. Each aggregated column is parsed once into a typed buffer of
+ * doubles, with NaN for empty or non-numeric fields, and every buffer is
+ * then folded in one pass. Memory is bounded by the chunk size and the
+ * number of groups, not the input size.
+ *
+ * Groups are keyed on the grouping fields: a single unescaped field is
+ * looked up straight from its span in the input, several fields are
+ * joined with '\0'. Keys are copied into an arena the first time they are
+ * seen and interned to dense ids (line_index.h), so groups come out in
+ * first-seen order.
+ */
+#define AGG_CHUNK 4096
+
+enum { AGG_COUNT, AGG_SUM, AGG_MEAN, AGG_MIN, AGG_MAX };
+
+typedef struct {
+    int func;
+    const char *label;  /* As written, for the output header */
+    long column;        /* -1 for a plain row count */
+    size_t buffer;      /* Typed buffer holding the column's values */
+} AggSpec;
+
+typedef struct {
+    double sum, min, max;
+    size_t numeric;     /* Values that parsed as numbers */
+} Accum;
+
+typedef struct {
+    size_t *cols;       /* Columns parsed into typed buffers */
+    size_t ncols, cols_cap;
+    double *values;     /* ncols x AGG_CHUNK */
+    size_t *empty;      /* Empty or missing fields per column (stats) */
+    int *gids;          /* Group of each buffered row */
+    size_t fill;
+    size_t rows;
 
-    // Skip first (total - n) lines
-    int skip = total_lines - n;
-    if (skip < 0) skip = 0;
+    size_t *key_cols;   /* Grouping columns; NULL means the projection */
+    size_t key_count, key_cap;
+    LineInterner interner;
+    LineArena arena;
+    LineSpan *keys;     /* Key bytes per group id */
+    size_t *group_rows;
+    Accum *acc;         /* groups x ncols; one row for stats */
+    size_t groups, groups_cap;
+    char *key_buf;
+    size_t key_buf_cap;
+    int started;        /* Interner and arena are live */
+} Aggregator;
 
-    data_copy = strdup(data);
-    int count = 0;
-    line = strtok(data_copy, "\n");
-    while (line) {
-        if (count >= skip) {
-            printf("%s\n", line);
+static AggSpec aggs[64];
+static int agg_count;
+
+static void accum_reset(Accum *a, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        a[i].sum = 0;
+        a[i].min = INFINITY;
+        a[i].max = -INFINITY;
+        a[i].numeric = 0;
+    }
+}
+
+/* Split "FUNC:COLUMN" or "count" */
+static int parse_agg(const char *spec, AggSpec *a) {
+    static const struct { const char *name; int func; } funcs[] = {
+        {"count", AGG_COUNT}, {"sum", AGG_SUM}, {"mean", AGG_MEAN},
+        {"avg", AGG_MEAN}, {"min", AGG_MIN}, {"max", AGG_MAX},
+    };
+    size_t name_len = strcspn(spec, ":");
+    for (size_t i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++) {
+        if (strlen(funcs[i].name) != name_len || strncmp(spec, funcs[i].name, name_len) != 0) continue;
+        a->func = funcs[i].func;
+        a->label = spec[name_len] ? spec + name_len + 1 : NULL;
+        if (a->func != AGG_COUNT && !a->label) break;
+        return 1;
+    }
+    fprintf(stderr, "Error: Invalid aggregate '%s' (expected count or sum|mean|min|max:COLUMN)\n", spec);
+    return 0;
+}
+
+static int agg_add_column(Aggregator *g, size_t col, size_t *buffer) {
+    for (size_t i = 0; i < g->ncols; i++) {
+        if (g->cols[i] == col) {
+            *buffer = i;
+            return 1;
         }
-        count++;
-        line = strtok(NULL, "\n");
     }
-    free(data_copy);
+    if (g->ncols == g->cols_cap) {
+        size_t cap = g->cols_cap ? g->cols_cap * 2 : 8;
+        size_t *tmp = (size_t *)realloc(g->cols, cap * sizeof(size_t));
+        if (!tmp) return 0;
+        g->cols = tmp;
+        g->cols_cap = cap;
+    }
+    *buffer = g->ncols;
+    g->cols[g->ncols++] = col;
+    return 1;
+}
+
+/* Size the typed buffers once the parsed columns are known */
+static int agg_start(Aggregator *g) {
+    size_t n = g->ncols ? g->ncols : 1;
+    g->values = (double *)malloc(n * AGG_CHUNK * sizeof(double));
+    g->empty = (size_t *)calloc(n, sizeof(size_t));
+    g->gids = (int *)malloc(AGG_CHUNK * sizeof(int));
+    if (!g->values || !g->empty || !g->gids) return 0;
+    if (!line_interner_init(&g->interner, 1024)) return 0;
+    line_arena_init(&g->arena);
+    g->started = 1;
+    return 1;
 }
 
-// Command: width - Number of columns
-void cmd_width(char *data) {
-    char *line = strtok(data, "\n");
-    if (line) {
-        char *line_copy = strdup(line);
-        CSVRow row;
-        parse_csv_line(line_copy, &row);
-        printf("%d\n", row.field_count);
-        free(line_copy);
+static int agg_grow_groups(Aggregator *g) {
+    size_t cap = g->groups_cap ? g->groups_cap * 2 : 256;
+    size_t per = g->ncols ? g->ncols : 1;
+    LineSpan *keys = (LineSpan *)realloc(g->keys, cap * sizeof(LineSpan));
+    if (keys) g->keys = keys;
+    size_t *rows = (size_t *)realloc(g->group_rows, cap * sizeof(size_t));
+    if (rows) g->group_rows = rows;
+    Accum *acc = (Accum *)realloc(g->acc, cap * per * sizeof(Accum));
+    if (acc) g->acc = acc;
+    if (!keys || !rows || !acc) return 0;
+    g->groups_cap = cap;
+    return 1;
+}
+
+/* Group id for the key fields of rec, adding a group when it is new */
+static int agg_group(Aggregator *g, const CsvRecord *rec, const size_t *cols, size_t ncols) {
+    const char *key;
+    size_t len;
+    if (ncols == 1 && cols[0] < rec->count && !rec->fields[cols[0]].escaped) {
+        key = rec->fields[cols[0]].ptr;
+        len = rec->fields[cols[0]].len;
     } else {
-        printf("0\n");
+        size_t need = ncols;
+        for (size_t i = 0; i < ncols; i++) {
+            if (cols[i] < rec->count) need += rec->fields[cols[i]].len;
+        }
+        if (need > g->key_buf_cap) {
+            char *tmp = (char *)realloc(g->key_buf, need);
+            if (!tmp) return -1;
+            g->key_buf = tmp;
+            g->key_buf_cap = need;
+        }
+        len = 0;
+        for (size_t i = 0; i < ncols; i++) {
+            if (i > 0) g->key_buf[len++] = '\0';
+            if (cols[i] < rec->count) len += csv_field_unescape(&rec->fields[cols[i]], g->key_buf + len);
+        }
+        key = g->key_buf;
     }
+
+    uint64_t h = line_hash(key, len);
+    int id = line_interner_find_hashed(&g->interner, h, key, len);
+    if (id >= 0) return id;
+
+    const char *copy = line_arena_copy(&g->arena, key, len);
+    id = copy ? line_interner_id_hashed(&g->interner, h, copy, len) : -1;
+    if (id < 0) return -1;
+    if (g->groups == g->groups_cap && !agg_grow_groups(g)) return -1;
+    g->keys[id].ptr = copy;
+    g->keys[id].len = len;
+    g->group_rows[id] = 0;
+    accum_reset(g->acc + (size_t)id * g->ncols, g->ncols);
+    g->groups++;
+    return id;
 }
 
-// Command: height - Number of rows
-void cmd_height(char *data) {
-    int count = 0;
-    char *line = strtok(data, "\n");
-    while (line) {
-        if (*line) count++;
-        line = strtok(NULL, "\n");
+/*
+ * Fold one typed buffer into a single accumulator. Four independent
+ * partial results keep the loop free of a serial dependency, so it
+ * vectorizes without -ffast-math; NaN fails every comparison and drops
+ * out of min/max on its own.
+ */
+static void fold_column(Accum *a, const double *v, size_t n) {
+    double sum[4] = {0, 0, 0, 0};
+    double lo[4] = {a->min, a->min, a->min, a->min};
+    double hi[4] = {a->max, a->max, a->max, a->max};
+    size_t numeric[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (int k = 0; k < 4; k++) {
+            double x = v[i + k];
+            int ok = x == x;
+            numeric[k] += (size_t)ok;
+            sum[k] += ok ? x : 0.0;
+            lo[k] = x < lo[k] ? x : lo[k];
+            hi[k] = x > hi[k] ? x : hi[k];
+        }
+    }
+    for (; i < n; i++) {
+        double x = v[i];
+        int ok = x == x;
+        numeric[0] += (size_t)ok;
+        sum[0] += ok ? x : 0.0;
+        lo[0] = x < lo[0] ? x : lo[0];
+        hi[0] = x > hi[0] ? x : hi[0];
+    }
+    for (int k = 0; k < 4; k++) {
+        a->sum += sum[k];
+        a->numeric += numeric[k];
+        if (lo[k] < a->min) a->min = lo[k];
+        if (hi[k] > a->max) a->max = hi[k];
     }
-    printf("%d\n", count);
+}
+
+/* Fold the buffered chunk into the accumulators */
+static void agg_flush(Aggregator *g, int grouped) {
+    for (size_t c = 0; c < g->ncols; c++) {
+        const double *v = g->values + c * AGG_CHUNK;
+        if (!grouped) {
+            fold_column(&g->acc[c], v, g->fill);
+            continue;
+        }
+        for (size_t i = 0; i < g->fill; i++) {
+            double x = v[i];
+            if (x != x) continue;
+            Accum *a = &g->acc[(size_t)g->gids[i] * g->ncols + c];
+            a->sum += x;
+            a->numeric++;
+            if (x < a->min) a->min = x;
+            if (x > a->max) a->max = x;
+        }
+    }
+    g->fill = 0;
+}
+
+/* Buffer one row: its group and the typed values of the parsed columns */
+static int agg_push(Aggregator *g, const CsvRecord *rec, int gid) {
+    size_t at = g->fill;
+    for (size_t c = 0; c < g->ncols; c++) {
+        double x = NAN;
+        size_t col = g->cols[c], len;
+        const char *v = col < rec->count ? field_value(&rec->fields[col], &len) : NULL;
+        if (!v || len == 0) {
+            g->empty[c]++;
+        } else if (!parse_number(v, len, &x)) {
+            x = NAN;
+        }
+        g->values[c * AGG_CHUNK + at] = x;
+    }
+    g->gids[at] = gid;
+    if (gid >= 0) g->group_rows[gid]++;
+    g->rows++;
+    if (++g->fill == AGG_CHUNK) agg_flush(g, gid >= 0);
+    return 1;
+}
+
+static void agg_free(Aggregator *g) {
+    free(g->cols);
+    free(g->values);
+    free(g->empty);
+    free(g->gids);
+    free(g->key_cols);
+    free(g->keys);
+    free(g->group_rows);
+    free(g->acc);
+    free(g->key_buf);
+    if (g->started) {
+        line_interner_free(&g->interner);
+        line_arena_free(&g->arena);
+    }
+}
+
+static void write_number(double v) {
+    char buf[64];
+    if (v == floor(v) && fabs(v) < 1e15) {
+        snprintf(buf, sizeof(buf), "%.0f", v);
+    } else {
+        snprintf(buf, sizeof(buf), "%.15g", v);
+    }
+    out_str(buf);
+}
+
+/* Output label of a column: its header name, else its number */
+static void write_column_label(size_t col, const Header *h, char delim) {
+    if (col < h->count) {
+        CsvField f = {h->names[col], h->lens[col], 0, 0};
+        csv_write_field(&f, delim);
+    } else {
+        out_uint(col + 1);
+    }
+}
+
+/* A group key is its fields joined with '\0' */
+static void write_key(const LineSpan *key, char delim) {
+    const char *p = key->ptr, *end = key->ptr + key->len;
+    if (key->len == 0) {
+        out_str("\"\"");
+        return;
+    }
+    for (;;) {
+        const char *sep = (const char *)memchr(p, '\0', (size_t)(end - p));
+        CsvField f = {p, sep ? (size_t)(sep - p) : (size_t)(end - p), 0, 0};
+        csv_write_field(&f, delim);
+        if (!sep) break;
+        out_char(delim);
+        p = sep + 1;
+    }
+}
+
+static void write_stats(const Aggregator *g, const Header *h, char delim) {
+    const char *names[] = {"column", "rows", "empty", "numeric", "min", "max", "sum", "mean"};
+    for (int i = 0; i < 8; i++) {
+        if (i > 0) out_char(delim);
+        out_str(names[i]);
+    }
+    out_char('\n');
+    for (size_t c = 0; c < g->ncols; c++) {
+        const Accum *a = &g->acc[c];
+        write_column_label(g->cols[c], h, delim);
+        out_char(delim);
+        out_uint(g->rows);
+        out_char(delim);
+        out_uint(g->empty[c]);
+        out_char(delim);
+        out_uint(a->numeric);
+        out_char(delim);
+        if (a->numeric) write_number(a->min);
+        out_char(delim);
+        if (a->numeric) write_number(a->max);
+        out_char(delim);
+        if (a->numeric) write_number(a->sum);
+        out_char(delim);
+        if (a->numeric) write_number(a->sum / (double)a->numeric);
+        out_char('\n');
+    }
+}
+
+static void write_groups(const Aggregator *g, const Header *h, char delim) {
+    for (size_t k = 0; k < g->key_count; k++) {
+        if (k > 0) out_char(delim);
+        write_column_label(g->key_cols[k], h, delim);
+    }
+    for (int i = 0; i < agg_count; i++) {
+        static const char *names[] = {"count", "sum", "mean", "min", "max"};
+        out_char(delim);
+        out_str(names[aggs[i].func]);
+        if (aggs[i].label) {
+            out_char('(');
+            out_str(aggs[i].label);
+            out_char(')');
+        }
+    }
+    out_char('\n');
+    for (size_t id = 0; id < g->groups; id++) {
+        write_key(&g->keys[id], delim);
+        for (int i = 0; i < agg_count; i++) {
+            const AggSpec *s = &aggs[i];
+            const Accum *a = s->column >= 0 ? &g->acc[id * g->ncols + s->buffer] : NULL;
+            out_char(delim);
+            if (!a) {
+                out_uint(g->group_rows[id]);
+            } else if (s->func == AGG_COUNT) {
+                out_uint(a->numeric);
+            } else if (a->numeric) {
+                write_number(s->func == AGG_SUM ? a->sum :
+                             s->func == AGG_MEAN ? a->sum / (double)a->numeric :
+                             s->func == AGG_MIN ? a->min : a->max);
+            } else if (s->func == AGG_SUM) {
+                out_char('0');
+            }
+        }
+        out_char('\n');
+    }
+}
+
+/*
+ * Pick the parsed and grouping columns once the first row (possibly the
+ * header) has been read.
+ */
+static int setup_aggregator(Aggregator *g, int cmd, const CsvRecord *first,
+                            const Options *opts, const Header *h) {
+    if (cmd == CMD_STATS) {
+        size_t n = project(first);
+        for (size_t i = 0; i < n; i++) {
+            size_t buffer;
+            if (!agg_add_column(g, proj[i], &buffer)) {
+                out_of_memory();
+                return 0;
+            }
+        }
+        g->acc = (Accum *)malloc((g->ncols ? g->ncols : 1) * sizeof(Accum));
+        if (!g->acc) {
+            out_of_memory();
+            return 0;
+        }
+        accum_reset(g->acc, g->ncols);
+    } else if (cmd == CMD_GROUPBY) {
+        ColRange *by = NULL;
+        size_t by_count = 0;
+        int ok = resolve_columns(opts->by, h, &by, &by_count);
+        if (ok) g->key_count = expand_columns(by, by_count, first->count, &g->key_cols, &g->key_cap);
+        free(by);
+        if (!ok) return 0;
+        if (g->key_count == 0) {
+            fprintf(stderr, "Error: No grouping columns in '%s'\n", opts->by);
+            return 0;
+        }
+        for (int i = 0; i < agg_count; i++) {
+            aggs[i].column = -1;
+            if (!aggs[i].label) continue;
+            aggs[i].column = resolve_column(aggs[i].label, strlen(aggs[i].label), h);
+            if (aggs[i].column < 0) {
+                fprintf(stderr, "Error: Unknown column '%s'\n", aggs[i].label);
+                return 0;
+            }
+            if (!agg_add_column(g, (size_t)aggs[i].column, &aggs[i].buffer)) {
+                out_of_memory();
+                return 0;
+            }
+        }
+    }
+    if (!agg_start(g)) {
+        out_of_memory();
+        return 0;
+    }
+    return 1;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: csvtool <command> [options] <csv-data>\n");
+    fprintf(stderr, "Commands:\n");
+    fprintf(stderr, "  cat         Rewrite rows as normalized CSV\n");
+    fprintf(stderr, "  select      Keep the --columns columns (also: col 1,2,3)\n");
+    fprintf(stderr, "  filter      Keep rows matching every --where condition\n");
+    fprintf(stderr, "  head N      First N rows\n");
+    fprintf(stderr, "  tail N      Last N rows\n");
+    fprintf(stderr, "  count       Number of rows (also: height)\n");
+    fprintf(stderr, "  width       Number of columns\n");
+    fprintf(stderr, "  tojson      Header-keyed JSON objects\n");
+    fprintf(stderr, "  stats       Rows, empty and numeric counts, min/max/sum/mean per column\n");
+    fprintf(stderr, "  groupby     One row per distinct --by key with its --agg aggregates\n");
+    fprintf(stderr, "  distinct    First row of each distinct --columns value\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -c, --columns LIST   Numbers, ranges (2-4, 3-) or header names\n");
+    fprintf(stderr, "  -w, --where EXPR     COL OP VALUE with OP one of = != ~ !~ < <= > >=\n");
+    fprintf(stderr, "  -H, --header         First row is a header\n");
+    fprintf(stderr, "  -d, --delimiter C    Field delimiter (default ','; 'tab' for TSV)\n");
+    fprintf(stderr, "  -n, --count N        Rows for head/tail (default 10)\n");
+    fprintf(stderr, "  -b, --by LIST        Grouping columns for groupby\n");
+    fprintf(stderr, "  -a, --agg SPEC       count, or sum|mean|min|max|count:COLUMN (repeatable)\n");
+    fprintf(stderr, "Or pipe csv-data via stdin.\n");
+}
+
+/* Command names, including aliases */
+static const struct {
+    const char *name;
+    int cmd;
+} commands[] = {
+    {"cat", CMD_CAT},         {"select", CMD_SELECT},   {"col", CMD_SELECT},
+    {"cols", CMD_SELECT},     {"filter", CMD_FILTER},   {"head", CMD_HEAD},
+    {"tail", CMD_TAIL},       {"count", CMD_COUNT},     {"height", CMD_COUNT},
+    {"width", CMD_WIDTH},     {"tojson", CMD_TOJSON},   {"stats", CMD_STATS},
+    {"groupby", CMD_GROUPBY}, {"distinct", CMD_DISTINCT},
+};
+
+/* CMD_* for name, or -1 if it names no command */
+static int parse_command(const char *name) {
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(name, commands[i].name) == 0) return commands[i].cmd;
+    }
+    return -1;
+}
+
+static int parse_delimiter(const char *s, char *out) {
+    if (strcmp(s, "tab") == 0 || strcmp(s, "\\t") == 0) {
+        *out = '\t';
+        return 1;
+    }
+    if (strlen(s) != 1 || s[0] == '"' || s[0] == '\n' || s[0] == '\r') return 0;
+    *out = s[0];
+    return 1;
 }
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: csvtool <command> [options] <csv-data>\n");
-        fprintf(stderr, "Commands:\n");
-        fprintf(stderr, "  col 1,2,3   Extract columns 1, 2, 3\n");
-        fprintf(stderr, "  head N      First N rows\n");
-        fprintf(stderr, "  tail N      Last N rows\n");
-        fprintf(stderr, "  width       Number of columns\n");
-        fprintf(stderr, "  height      Number of rows\n");
-        fprintf(stderr, "Or pipe csv-data via stdin.\n");
+    Options opts = {0};
+    opts.delim = ',';
+    opts.count = -1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        int has_value = i + 1 < argc;
+        if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--columns") == 0) && has_value) {
+            opts.columns = argv[++i];
+        } else if ((strcmp(arg, "-w") == 0 || strcmp(arg, "--where") == 0) && has_value) {
+            if (opts.where_count == 64) {
+                fprintf(stderr, "Error: Too many --where conditions\n");
+                return 1;
+            }
+            opts.where[opts.where_count++] = argv[++i];
+        } else if (strcmp(arg, "-H") == 0 || strcmp(arg, "--header") == 0) {
+            opts.header = 1;
+        } else if ((strcmp(arg, "-d") == 0 || strcmp(arg, "--delimiter") == 0) && has_value) {
+            if (!parse_delimiter(argv[++i], &opts.delim)) {
+                fprintf(stderr, "Error: Delimiter must be a single character\n");
+                return 1;
+            }
+        } else if ((strcmp(arg, "-n") == 0 || strcmp(arg, "--count") == 0) && has_value) {
+            opts.count = strtol(argv[++i], NULL, 10);
+        } else if ((strcmp(arg, "-b") == 0 || strcmp(arg, "--by") == 0) && has_value) {
+            opts.by = argv[++i];
+        } else if ((strcmp(arg, "-a") == 0 || strcmp(arg, "--agg") == 0) && has_value) {
+            if (agg_count == 64) {
+                fprintf(stderr, "Error: Too many --agg aggregates\n");
+                return 1;
+            }
+            if (!parse_agg(argv[++i], &aggs[agg_count])) return 1;
+            agg_count++;
+        } else if (strcmp(arg, "--command") == 0 && has_value) {
+            opts.command = argv[++i];
+        } else if (strcmp(arg, "--input") == 0 && has_value) {
+            opts.input = argv[++i];
+        } else if (!opts.command) {
+            opts.command = arg;
+        } else if ((strcmp(opts.command, "col") == 0 || strcmp(opts.command, "cols") == 0) &&
+                   !opts.columns) {
+            opts.columns = arg;
+        } else if ((strcmp(opts.command, "head") == 0 || strcmp(opts.command, "tail") == 0) &&
+                   opts.count < 0 && is_number_ref(arg, strlen(arg)) && !opts.input) {
+            opts.count = strtol(arg, NULL, 10);
+        } else {
+            opts.input = arg;
+        }
+    }
+
+    if (!opts.command) {
+        usage();
         return 1;
     }
 
-    const char *cmd = argv[1];
-    char *data = NULL;
-    const char *option = NULL;
-    char *stdin_buf = NULL;
+    int cmd = parse_command(opts.command);
+    if (cmd < 0) {
+        fprintf(stderr, "Error: Unknown command '%s'\n", opts.command);
+        return 1;
+    }
+    if (cmd == CMD_SELECT && !opts.columns) {
+        fprintf(stderr, "Error: Command 'select' requires --columns\n");
+        return 1;
+    }
+    if (cmd == CMD_GROUPBY && !opts.by) {
+        fprintf(stderr, "Error: Command 'groupby' requires --by\n");
+        return 1;
+    }
+    if (opts.count < 0) opts.count = 10;
 
-    // Find data and options
-    if (strcmp(cmd, "col") == 0 || strcmp(cmd, "head") == 0 || strcmp(cmd, "tail") == 0) {
-        if (argc < 3) {
-            fprintf(stderr, "Error: Command '%s' requires an option and data\n", cmd);
+    for (int i = 0; i < opts.where_count; i++) {
+        if (!parse_condition(opts.where[i], &conds[cond_count])) return 1;
+        cond_count++;
+    }
+    if (cmd == CMD_GROUPBY && agg_count == 0) {
+        aggs[0].func = AGG_COUNT;
+        aggs[0].label = NULL;
+        agg_count = 1;
+    }
+
+    // Column names resolve against the header, so using one implies it
+    int names = cmd == CMD_TOJSON || list_uses_names(opts.columns) || list_uses_names(opts.by);
+    for (int i = 0; i < cond_count; i++) {
+        if (!is_number_ref(conds[i].column, strlen(conds[i].column))) names = 1;
+    }
+    for (int i = 0; i < agg_count; i++) {
+        if (aggs[i].label && !is_number_ref(aggs[i].label, strlen(aggs[i].label))) names = 1;
+    }
+    if (names) opts.header = 1;
+
+    LineReader in;
+    if (opts.input) {
+        if (!line_reader_init_string(&in, opts.input)) return out_of_memory();
+    } else {
+        if (!line_reader_init_stdin(&in)) return out_of_memory();
+        if (line_reader_is_empty(&in)) {
+            usage();
+            line_reader_free(&in);
             return 1;
         }
-        option = argv[2];
-        data = (argc >= 4) ? strdup(argv[3]) : NULL;
-    } else {
-        data = (argc >= 3) ? strdup(argv[2]) : NULL;
     }
 
-    if (!data) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: csvtool <command> [options] <csv-data>\nOr pipe csv-data via stdin.\n");
-            return 1;
+    CsvReader csv;
+    csv_reader_init(&csv, &in, opts.delim);
+    Header header = {0};
+    TailRing ring = {0};
+    Aggregator agg = {0};
+    ring.limit = opts.count;
+    int status = 0;
+    size_t rows = 0;
+    int resolved = 0;
+
+    while (csv_reader_next(&csv)) {
+        const CsvRecord *rec = &csv.rec;
+
+        if (!resolved) {
+            resolved = 1;
+            if (opts.header && !save_header(rec, &header)) {
+                status = out_of_memory();
+                break;
+            }
+            if (opts.columns && !resolve_columns(opts.columns, &header, &ranges, &range_count)) {
+                status = 1;
+                break;
+            }
+            for (int i = 0; i < cond_count; i++) {
+                conds[i].index = resolve_column(conds[i].column, strlen(conds[i].column), &header);
+                if (conds[i].index < 0) {
+                    fprintf(stderr, "Error: Unknown column '%s'\n", conds[i].column);
+                    status = 1;
+                    break;
+                }
+            }
+            if (status) break;
+
+            if (cmd == CMD_WIDTH) {
+                out_uint(rec->count);
+                out_char('\n');
+                break;
+            }
+            if ((cmd == CMD_STATS || cmd == CMD_GROUPBY || cmd == CMD_DISTINCT) &&
+                !setup_aggregator(&agg, cmd, rec, &opts, &header)) {
+                status = 1;
+                break;
+            }
+            if (opts.header) {
+                if (cmd != CMD_TOJSON && cmd != CMD_STATS && cmd != CMD_GROUPBY && cmd != CMD_COUNT) {
+                    write_row(rec, opts.delim);
+                }
+                continue;
+            }
+        }
+
+        if (cond_count && !row_matches(rec)) continue;
+        if (cmd == CMD_HEAD && (long)rows >= opts.count) break;
+
+        switch (cmd) {
+        case CMD_COUNT:
+            rows++;
+            break;
+        case CMD_STATS:
+            agg_push(&agg, rec, -1);
+            break;
+        case CMD_GROUPBY: {
+            int gid = agg_group(&agg, rec, agg.key_cols, agg.key_count);
+            if (gid < 0) {
+                status = out_of_memory();
+                break;
+            }
+            agg_push(&agg, rec, gid);
+            break;
+        }
+        case CMD_DISTINCT: {
+            size_t before = agg.groups;
+            size_t n = project(rec);
+            if (agg_group(&agg, rec, proj, n) < 0) {
+                status = out_of_memory();
+                break;
+            }
+            if (agg.groups > before) write_row(rec, opts.delim);
+            break;
         }
-        data = strdup(stdin_buf);
+        case CMD_TOJSON:
+            write_json_row(rec, &header, rows++ == 0);
+            break;
+        case CMD_TAIL:
+            if (ring.limit > 0 && !tail_push(&ring, rec)) status = out_of_memory();
+            break;
+        default:
+            write_row(rec, opts.delim);
+            rows++;
+            break;
+        }
+        if (status) break;
     }
 
-    if (strcmp(cmd, "col") == 0) {
-        cmd_col(option, data);
-    } else if (strcmp(cmd, "head") == 0) {
-        cmd_head(atoi(option), data);
-    } else if (strcmp(cmd, "tail") == 0) {
-        cmd_tail(atoi(option), data);
-    } else if (strcmp(cmd, "width") == 0) {
-        cmd_width(data);
-    } else if (strcmp(cmd, "height") == 0) {
-        cmd_height(data);
-    } else {
-        fprintf(stderr, "Error: Unknown command '%s'\n", cmd);
-        free(data);
-        return 1;
+    if (csv.error || in.error) status = out_of_memory();
+    if (status == 0) {
+        if (cmd == CMD_COUNT) {
+            out_uint(rows);
+            out_char('\n');
+        } else if (cmd == CMD_WIDTH && !resolved) {
+            out_str("0\n");
+        } else if (cmd == CMD_TOJSON) {
+            out_str(rows ? "\n]\n" : "[]\n");
+        } else if (cmd == CMD_STATS && resolved) {
+            agg_flush(&agg, 0);
+            write_stats(&agg, &header, opts.delim);
+        } else if (cmd == CMD_GROUPBY && resolved) {
+            agg_flush(&agg, 1);
+            write_groups(&agg, &header, opts.delim);
+        }
+        if (cmd == CMD_TAIL) status = tail_flush(&ring, opts.delim);
     }
 
-    free(stdin_buf);
-    free(data);
-    return 0;
+    csv_reader_free(&csv);
+    line_reader_free(&in);
+    free_header(&header);
+    agg_free(&agg);
+    for (int i = 0; i < cond_count; i++) {
+        free((char *)conds[i].column);
+        if (conds[i].re) re_free(conds[i].re);
+    }
+    free(ranges);
+    free(proj);
+    free(scratch);
+    out_flush();
+    return status;
 }
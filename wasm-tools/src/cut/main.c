@@ -1,77 +1,306 @@
 /**
  * cut - Extract columns from text
- * Usage: cut -d DELIMITER -f FIELD <text>
+ * Usage: cut -f LIST [-d DELIM] [-s] [--output-delimiter STR] <text>
+ *        cut -b LIST [--output-delimiter STR] <text>
+ *        cut -c LIST [--output-delimiter STR] <text>
+ * Options: -f (fields), -b (bytes), -c (UTF-8 characters), -d (field
+ *          delimiter, default tab), -s (skip lines without a delimiter),
+ *          --output-delimiter (joins the selected fields or ranges)
+ * LIST: comma-separated N, N-M, N- and -M, numbered from 1 (e.g. 1,3-5,8-).
+ *       Selected parts are printed in input order, each once.
+ * Long forms --fields, --bytes, --characters, --delimiter, --outputDelimiter
+ * and --onlyDelimited are accepted as passed by the tool registry.
+ *
+ * Fields are found 16 bytes at a time: simd_match16() gives a bitmask of
+ * the delimiters in each block and the selected spans between them are
+ * written straight from the line buffer. Scanning a line stops after the
+ * last selected field, and an open range (N-) with the output delimiter
+ * left alone is written as one span, delimiters included.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include <stdint.h>
+#include "../line_reader.h"
+#include "../simd.h"
+#include "../stdout_write.h"
+
+#define USAGE "Usage: cut -f LIST [-d DELIM] [-s] [--output-delimiter STR] <text>\n" \
+              "       cut -b LIST | -c LIST [--output-delimiter STR] <text>\n"
+
+#define CUT_OPEN SIZE_MAX
+
+typedef struct {
+    size_t lo, hi;          /* 1-based, inclusive; hi is CUT_OPEN for N- */
+} Range;
+
+static Range *ranges;
+static size_t num_ranges;
+
+static unsigned char delim = '\t';
+static const char *out_delim;
+static size_t out_delim_len;
+static int only_delimited;
+
+static int cmp_range(const void *a, const void *b) {
+    const Range *x = (const Range *)a, *y = (const Range *)b;
+    return x->lo < y->lo ? -1 : x->lo > y->lo;
+}
+
+static int parse_number(const char **s, size_t *value) {
+    const char *p = *s;
+    size_t v = 0;
+    if (*p < '0' || *p > '9') return 0;
+    while (*p >= '0' && *p <= '9') {
+        if (v > (CUT_OPEN - 1) / 10) return 0;
+        v = v * 10 + (size_t)(*p++ - '0');
+    }
+    *s = p;
+    *value = v;
+    return 1;
+}
+
+/* Parse LIST into sorted, merged ranges; 0 on a malformed list */
+static int parse_list(const char *list) {
+    size_t cap = 0;
+    const char *p = list;
+    num_ranges = 0;
+    for (;;) {
+        Range r = {1, CUT_OPEN};
+        if (*p == '-') {
+            p++;
+            if (!parse_number(&p, &r.hi)) return 0;
+        } else {
+            if (!parse_number(&p, &r.lo)) return 0;
+            r.hi = r.lo;
+            if (*p == '-') {
+                p++;
+                r.hi = CUT_OPEN;
+                if (*p >= '0' && *p <= '9' && !parse_number(&p, &r.hi)) return 0;
+            }
+        }
+        if (r.lo == 0 || r.hi < r.lo) return 0;
+        if (num_ranges == cap) {
+            cap = cap ? cap * 2 : 8;
+            Range *tmp = (Range *)realloc(ranges, cap * sizeof(Range));
+            if (!tmp) return 0;
+            ranges = tmp;
+        }
+        ranges[num_ranges++] = r;
+        if (*p == '\0') break;
+        if (*p++ != ',') return 0;
+    }
+
+    // Overlapping and adjacent ranges become one, so each part prints once
+    qsort(ranges, num_ranges, sizeof(Range), cmp_range);
+    size_t merged = 0;
+    for (size_t i = 0; i < num_ranges; i++) {
+        Range *last = merged ? &ranges[merged - 1] : NULL;
+        if (last && (last->hi == CUT_OPEN || ranges[i].lo <= last->hi + 1)) {
+            if (ranges[i].hi > last->hi) last->hi = ranges[i].hi;
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    num_ranges = merged;
+    return 1;
+}
+
+/* Per-line state of the field walk */
+typedef struct {
+    const char *line;
+    size_t len;
+    size_t field;           /* Number of the field being scanned */
+    size_t start;           /* Its first byte */
+    size_t range;           /* First range that does not end before it */
+    int wrote;              /* A field has been written on this line */
+} FieldWalk;
+
+static size_t last_field;   /* Scanning can stop past this field */
+static size_t tail_field;   /* From here on the rest of the line is one span, or 0 */
+
+static void write_field(FieldWalk *w, size_t end) {
+    while (ranges[w->range].hi < w->field) w->range++;
+    if (ranges[w->range].lo > w->field) return;
+    if (w->wrote) out_write(out_delim, out_delim_len);
+    out_write(w->line + w->start, end - w->start);
+    w->wrote = 1;
+}
+
+/* The field ends at a delimiter at pos; returns 0 when the line is done */
+static int end_field(FieldWalk *w, size_t pos) {
+    write_field(w, pos);
+    w->field++;
+    w->start = pos + 1;
+    if (w->field > last_field) return 0;
+    if (tail_field && w->field >= tail_field) {
+        if (w->wrote) out_write(out_delim, out_delim_len);
+        out_write(w->line + w->start, w->len - w->start);
+        return 0;
+    }
+    return 1;
+}
+
+static void cut_fields(const char *line, size_t len) {
+    FieldWalk w = {line, len, 1, 0, 0, 0};
+    const unsigned char *s = (const unsigned char *)line;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        uint32_t mask = simd_match16(s + i, delim);
+        while (mask) {
+            if (!end_field(&w, i + (size_t)__builtin_ctz(mask))) goto done;
+            mask &= mask - 1;
+        }
+    }
+    for (; i < len; i++) {
+        if (s[i] == delim && !end_field(&w, i)) goto done;
+    }
+
+    if (w.field == 1) {
+        // No delimiter: the line is passed through whole (or dropped with -s)
+        if (only_delimited) return;
+        out_write(line, len);
+    } else {
+        write_field(&w, len);
+    }
+done:
+    out_char('\n');
+}
+
+/* Byte offset of the character count characters after the one at i */
+static size_t advance_chars(const unsigned char *s, size_t len, size_t i, size_t count) {
+    while (count > 0 && i < len) {
+        i++;
+        while (i < len && (s[i] & 0xC0) == 0x80) i++;
+        count--;
+    }
+    return i;
+}
+
+static void cut_spans(const char *line, size_t len, int chars) {
+    const unsigned char *s = (const unsigned char *)line;
+    size_t pos = 1, i = 0;  /* Position (from 1) of the byte or character at offset i */
+    for (size_t r = 0; r < num_ranges && i < len; r++) {
+        size_t skip = ranges[r].lo - pos;
+        i = chars ? advance_chars(s, len, i, skip) : (skip < len - i ? i + skip : len);
+        if (i >= len) break;
+        size_t count = ranges[r].hi == CUT_OPEN ? len : ranges[r].hi - ranges[r].lo + 1;
+        size_t end = chars ? advance_chars(s, len, i, count) : (count < len - i ? i + count : len);
+        if (r > 0 && out_delim) out_write(out_delim, out_delim_len);
+        out_write(line + i, end - i);
+        i = end;
+        pos = ranges[r].hi == CUT_OPEN ? pos : ranges[r].hi + 1;
+    }
+    out_char('\n');
+}
 
 int main(int argc, char **argv) {
-    char delimiter = '\t';  // Default delimiter
-    int field = 1;
     const char *input = NULL;
+    const char *list = NULL;
+    char mode = 0;
 
     for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
-            delimiter = argv[++i][0];
-        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
-            field = atoi(argv[++i]);
-        } else if (argv[i][0] != '-') {
-            input = argv[i];
+        const char *a = argv[i];
+        char opt = 0;
+        const char *value = NULL;
+
+        if (strcmp(a, "--fields") == 0) opt = 'f';
+        else if (strcmp(a, "--bytes") == 0) opt = 'b';
+        else if (strcmp(a, "--characters") == 0) opt = 'c';
+        else if (strcmp(a, "--delimiter") == 0) opt = 'd';
+        else if (strcmp(a, "--output-delimiter") == 0 || strcmp(a, "--outputDelimiter") == 0) opt = 'o';
+        else if (strncmp(a, "--output-delimiter=", 19) == 0) opt = 'o', value = a + 19;
+        else if (strcmp(a, "--input") == 0) opt = 'i';
+        else if (strcmp(a, "-s") == 0 || strcmp(a, "--only-delimited") == 0 || strcmp(a, "--onlyDelimited") == 0) {
+            only_delimited = 1;
+            continue;
+        } else if (a[0] == '-' && a[1] && strchr("fbcd", a[1])) {
+            opt = a[1];
+            if (a[2]) value = a + 2;
+        } else {
+            input = a;
+            continue;
         }
-    }
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: cut -d DELIMITER -f FIELD <text>\n");
-            return 1;
+        if (!value) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "cut: option %s requires an argument\n", a);
+                return 1;
+            }
+            value = argv[++i];
+        }
+        switch (opt) {
+            case 'd':
+                if (strlen(value) != 1) {
+                    fprintf(stderr, "cut: the delimiter must be a single character\n");
+                    return 1;
+                }
+                delim = (unsigned char)value[0];
+                break;
+            case 'o':
+                out_delim = value;
+                out_delim_len = strlen(value);
+                break;
+            case 'i':
+                input = value;
+                break;
+            default:
+                if (mode && mode != opt) {
+                    fprintf(stderr, "cut: only one type of list may be specified\n");
+                    return 1;
+                }
+                mode = opt;
+                list = value;
         }
-        input = stdin_buf;
     }
 
-    if (field < 1) {
-        fprintf(stderr, "Usage: cut -d DELIMITER -f FIELD <text>\n");
-        free(stdin_buf);
+    if (!mode) {
+        fprintf(stderr, "cut: you must specify a list of bytes, characters, or fields\n" USAGE);
         return 1;
     }
-
-    // Process each line
-    const char *line_start = input;
-    while (*line_start) {
-        // Find end of line
-        const char *line_end = line_start;
-        while (*line_end && *line_end != '\n') line_end++;
-
-        // Find the requested field
-        int current_field = 1;
-        const char *field_start = line_start;
-        const char *field_end = line_start;
-
-        while (field_end < line_end) {
-            if (*field_end == delimiter) {
-                if (current_field == field) break;
-                current_field++;
-                field_start = field_end + 1;
-            }
-            field_end++;
+    if (!parse_list(list)) {
+        fprintf(stderr, "cut: invalid %s list '%s'\n", mode == 'f' ? "field" : mode == 'b' ? "byte" : "character",
+                list);
+        free(ranges);
+        return 1;
+    }
+    if (mode == 'f') {
+        static char delim_str[2];
+        if (!out_delim) {
+            delim_str[0] = (char)delim;
+            out_delim = delim_str;
+            out_delim_len = 1;
+        }
+        last_field = ranges[num_ranges - 1].hi;
+        if (last_field == CUT_OPEN && out_delim_len == 1 && (unsigned char)out_delim[0] == delim) {
+            tail_field = ranges[num_ranges - 1].lo;
         }
+    }
 
-        // Output field if found
-        if (current_field == field) {
-            while (field_start < field_end && *field_start != delimiter) {
-                putchar(*field_start++);
-            }
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, USAGE "Or pipe input via stdin.\n");
+            line_reader_free(&reader);
+            free(ranges);
+            return 1;
         }
-        putchar('\n');
+    }
 
-        // Move to next line
-        line_start = *line_end ? line_end + 1 : line_end;
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        if (mode == 'f') cut_fields(line, len);
+        else cut_spans(line, len, mode == 'c');
     }
 
-    free(stdin_buf);
+    line_reader_free(&reader);
+    free(ranges);
+    out_flush();
     return 0;
 }
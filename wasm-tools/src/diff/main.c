@@ -1,202 +1,532 @@
 /**
  * diff - Compare files line by line
- * Usage: diff <text1> <text2>
- * Output: Unified diff format
+ * Usage: diff [--minimal | --patience | --histogram] [-U N] <text1> <text2>
+ * Output: Unified diff format (nothing when the texts are equal)
+ *
+ * Lines are interned to integer ids first, so the algorithms below only
+ * ever compare ints. The common prefix and suffix of every sub-range are
+ * trimmed before any real work is done.
+ *
+ * - myers (default): Myers' O(ND) algorithm in linear space, splitting on
+ *   the middle snake. Like GNU diff it gives up on a perfect result once
+ *   the edit cost gets very large and splits at the furthest-reaching
+ *   diagonal instead; --minimal (-d) turns that off.
+ * - patience: anchors the diff on lines that occur exactly once in both
+ *   texts (longest increasing subsequence of them), recursing between
+ *   anchors and falling back to Myers where there are none.
+ * - histogram: anchors on the longest common run containing the rarest
+ *   line, the way git's histogram diff does, falling back to Myers.
+ *
+ * The algorithm can also be given as a bare word after the texts
+ * (myers, minimal, patience, histogram), which is how the tool registry
+ * passes it.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include "../line_index.h"
+#include "../stdout_write.h"
 
-#define MAX_LINES 10000
-#define MAX_LINE_LEN 4096
+#define DIFF_DEFAULT_CONTEXT 3
+#define HISTOGRAM_MAX_CHAIN 64
+
+#define USAGE "Usage: diff [--minimal | --patience | --histogram] [-U N] <text1> <text2>\n"
+
+enum { ALG_MYERS, ALG_PATIENCE, ALG_HISTOGRAM };
+
+// Both texts as id sequences, plus which lines are not part of the LCS
+static int *xv, *yv;
+static char *changed_x, *changed_y;
+static int total_x, total_y;
+static int num_ids;
+
+// ============================================================================
+// Work stack: sub-ranges still to be diffed. Iterative so that deep
+// recursion cannot overflow the small WASM stack.
+// ============================================================================
 
 typedef struct {
-    char *lines[MAX_LINES];
-    int count;
-} FileLines;
+    int xoff, xlim, yoff, ylim;
+    int alg;
+} Range;
+
+static Range *stack;
+static size_t stack_len, stack_cap;
+
+static int push_range(int xoff, int xlim, int yoff, int ylim, int alg) {
+    if (stack_len == stack_cap) {
+        size_t cap = stack_cap ? stack_cap * 2 : 256;
+        Range *tmp = (Range *)realloc(stack, cap * sizeof(Range));
+        if (!tmp) return 0;
+        stack = tmp;
+        stack_cap = cap;
+    }
+    stack[stack_len].xoff = xoff;
+    stack[stack_len].xlim = xlim;
+    stack[stack_len].yoff = yoff;
+    stack[stack_len].ylim = ylim;
+    stack[stack_len].alg = alg;
+    stack_len++;
+    return 1;
+}
 
-void free_lines(FileLines *f) {
-    for (int i = 0; i < f->count; i++) {
-        free(f->lines[i]);
+// Trim equal lines off both ends. Returns 1 if nothing is left to compare
+// (one side is empty), after marking the rest of the other side changed.
+static int trim_range(Range *r) {
+    while (r->xoff < r->xlim && r->yoff < r->ylim && xv[r->xoff] == yv[r->yoff]) {
+        r->xoff++;
+        r->yoff++;
+    }
+    while (r->xlim > r->xoff && r->ylim > r->yoff && xv[r->xlim - 1] == yv[r->ylim - 1]) {
+        r->xlim--;
+        r->ylim--;
     }
-    f->count = 0;
+    if (r->xoff == r->xlim) {
+        memset(changed_y + r->yoff, 1, (size_t)(r->ylim - r->yoff));
+        return 1;
+    }
+    if (r->yoff == r->ylim) {
+        memset(changed_x + r->xoff, 1, (size_t)(r->xlim - r->xoff));
+        return 1;
+    }
+    return 0;
 }
 
-void parse_lines(const char *text, FileLines *f) {
-    f->count = 0;
-    char *text_copy = strdup(text);
-    char *line = strtok(text_copy, "\n");
+// ============================================================================
+// Myers
+// ============================================================================
+
+// Forward and backward furthest-reaching x per diagonal k = x - y,
+// indexed from -(total_y + 1) to total_x + 1
+static int *fdiag, *bdiag;
+static int minimal = 0;
+static int too_expensive;
+
+// Find the middle snake of r and return where to split it
+static void myers_split(const Range *r, int *xmid, int *ymid) {
+    const int xoff = r->xoff, xlim = r->xlim, yoff = r->yoff, ylim = r->ylim;
+    int *fd = fdiag, *bd = bdiag;
+    const int dmin = xoff - ylim, dmax = xlim - yoff;
+    const int fmid = xoff - yoff, bmid = xlim - ylim;
+    const int odd = (fmid - bmid) & 1;
+    int fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+
+    fd[fmid] = xoff;
+    bd[bmid] = xlim;
+
+    for (int c = 1;; c++) {
+        // Extend the forward paths by one edit
+        if (fmin > dmin) fd[--fmin - 1] = -1; else ++fmin;
+        if (fmax < dmax) fd[++fmax + 1] = -1; else --fmax;
+        for (int d = fmax; d >= fmin; d -= 2) {
+            int tlo = fd[d - 1], thi = fd[d + 1];
+            int x = tlo >= thi ? tlo + 1 : thi;
+            int y = x - d;
+            while (x < xlim && y < ylim && xv[x] == yv[y]) { x++; y++; }
+            fd[d] = x;
+            if (odd && bmin <= d && d <= bmax && bd[d] <= x) {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
 
-    while (line && f->count < MAX_LINES) {
-        f->lines[f->count++] = strdup(line);
-        line = strtok(NULL, "\n");
+        // Extend the backward paths by one edit
+        if (bmin > dmin) bd[--bmin - 1] = INT_MAX; else ++bmin;
+        if (bmax < dmax) bd[++bmax + 1] = INT_MAX; else --bmax;
+        for (int d = bmax; d >= bmin; d -= 2) {
+            int tlo = bd[d - 1], thi = bd[d + 1];
+            int x = tlo < thi ? tlo : thi - 1;
+            int y = x - d;
+            while (x > xoff && y > yoff && xv[x - 1] == yv[y - 1]) { x--; y--; }
+            bd[d] = x;
+            if (!odd && fmin <= d && d <= fmax && x <= fd[d]) {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        if (minimal || c < too_expensive) continue;
+
+        // Too expensive: split at whichever path got furthest towards
+        // its corner. The result is still a correct, just not minimal, diff.
+        int fxybest = -1, fxbest = xoff;
+        for (int d = fmax; d >= fmin; d -= 2) {
+            int x = fd[d] < xlim ? fd[d] : xlim;
+            int y = x - d;
+            if (ylim < y) { x = ylim + d; y = ylim; }
+            if (fxybest < x + y) { fxybest = x + y; fxbest = x; }
+        }
+        int bxybest = INT_MAX, bxbest = xlim;
+        for (int d = bmax; d >= bmin; d -= 2) {
+            int x = bd[d] > xoff ? bd[d] : xoff;
+            int y = x - d;
+            if (y < yoff) { x = yoff + d; y = yoff; }
+            if (x + y < bxybest) { bxybest = x + y; bxbest = x; }
+        }
+        if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff)) {
+            *xmid = fxbest;
+            *ymid = fxybest - fxbest;
+        } else {
+            *xmid = bxbest;
+            *ymid = bxybest - bxbest;
+        }
+        return;
     }
+}
 
-    free(text_copy);
+static int diff_myers(const Range *r) {
+    int xmid, ymid;
+    myers_split(r, &xmid, &ymid);
+    return push_range(r->xoff, xmid, r->yoff, ymid, ALG_MYERS) &&
+           push_range(xmid, r->xlim, ymid, r->ylim, ALG_MYERS);
 }
 
-// Simple LCS-based diff
-// Returns number of common lines
-int lcs_length(FileLines *a, FileLines *b, int **dp) {
-    int m = a->count;
-    int n = b->count;
-
-    // Allocate DP table
-    *dp = (int *)calloc((m + 1) * (n + 1), sizeof(int));
-
-    for (int i = 1; i <= m; i++) {
-        for (int j = 1; j <= n; j++) {
-            if (strcmp(a->lines[i-1], b->lines[j-1]) == 0) {
-                (*dp)[i * (n + 1) + j] = (*dp)[(i-1) * (n + 1) + (j-1)] + 1;
-            } else {
-                int up = (*dp)[(i-1) * (n + 1) + j];
-                int left = (*dp)[i * (n + 1) + (j-1)];
-                (*dp)[i * (n + 1) + j] = (up > left) ? up : left;
-            }
+// ============================================================================
+// Patience
+// ============================================================================
+
+// Per-id scratch; the counts are zero between uses
+static int *count_x, *count_y, *pos_y;
+
+static int diff_patience(const Range *r) {
+    for (int i = r->xoff; i < r->xlim; i++) count_x[xv[i]]++;
+    for (int j = r->yoff; j < r->ylim; j++) { count_y[yv[j]]++; pos_y[yv[j]] = j; }
+
+    // Unique common lines in x order; patience-sort their y positions.
+    // tails[k] = index into the anchor list of the smallest y ending an
+    // increasing run of length k + 1.
+    int n = r->xlim - r->xoff;
+    int *ax = (int *)malloc((size_t)n * sizeof(int));
+    int *ay = (int *)malloc((size_t)n * sizeof(int));
+    int *prev = (int *)malloc((size_t)n * sizeof(int));
+    int *tails = (int *)malloc((size_t)n * sizeof(int));
+    int ok = ax && ay && prev && tails;
+    int na = 0, len = 0;
+
+    for (int i = r->xoff; ok && i < r->xlim; i++) {
+        int id = xv[i];
+        if (count_x[id] != 1 || count_y[id] != 1) continue;
+        int y = pos_y[id];
+        int lo = 0, hi = len;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (ay[tails[mid]] < y) lo = mid + 1; else hi = mid;
         }
+        ax[na] = i;
+        ay[na] = y;
+        prev[na] = lo > 0 ? tails[lo - 1] : -1;
+        tails[lo] = na;
+        if (lo == len) len++;
+        na++;
     }
 
-    return (*dp)[m * (n + 1) + n];
-}
+    for (int i = r->xoff; i < r->xlim; i++) count_x[xv[i]] = 0;
+    for (int j = r->yoff; j < r->ylim; j++) count_y[yv[j]] = 0;
 
-void print_diff(FileLines *a, FileLines *b) {
-    int *dp;
-    lcs_length(a, b, &dp);
-
-    int m = a->count;
-    int n = b->count;
-
-    // Backtrack to find differences
-    typedef struct { int op; int ai; int bi; } DiffOp;
-    DiffOp *ops = (DiffOp *)malloc((m + n + 1) * sizeof(DiffOp));
-    int op_count = 0;
-
-    int i = m, j = n;
-    while (i > 0 || j > 0) {
-        if (i > 0 && j > 0 && strcmp(a->lines[i-1], b->lines[j-1]) == 0) {
-            ops[op_count].op = ' ';
-            ops[op_count].ai = i - 1;
-            ops[op_count].bi = j - 1;
-            op_count++;
-            i--; j--;
-        } else if (j > 0 && (i == 0 || dp[(i) * (n + 1) + (j-1)] >= dp[(i-1) * (n + 1) + j])) {
-            ops[op_count].op = '+';
-            ops[op_count].ai = -1;
-            ops[op_count].bi = j - 1;
-            op_count++;
-            j--;
-        } else {
-            ops[op_count].op = '-';
-            ops[op_count].ai = i - 1;
-            ops[op_count].bi = -1;
-            op_count++;
-            i--;
+    if (ok && len == 0) ok = diff_myers(r);
+
+    if (ok && len > 0) {
+        // Walk the LIS back to front, pushing the gaps between anchors
+        int x1 = r->xlim, y1 = r->ylim;
+        for (int k = tails[len - 1]; ok && k >= 0; k = prev[k]) {
+            ok = push_range(ax[k] + 1, x1, ay[k] + 1, y1, ALG_PATIENCE);
+            x1 = ax[k];
+            y1 = ay[k];
         }
+        if (ok) ok = push_range(r->xoff, x1, r->yoff, y1, ALG_PATIENCE);
     }
 
-    free(dp);
-
-    // Print header
-    printf("--- a\n");
-    printf("+++ b\n");
-
-    // Find hunks and print
-    int hunk_start = -1;
-    int hunk_end = -1;
-
-    for (int k = op_count - 1; k >= 0; k--) {
-        if (ops[k].op != ' ') {
-            if (hunk_start < 0) hunk_start = k;
-            hunk_end = k;
-        } else if (hunk_start >= 0) {
-            // End of hunk, print it
-            int context_before = (hunk_start < op_count - 1) ? 3 : 0;
-            int context_after = (hunk_end > 0) ? 3 : 0;
-
-            int start_idx = hunk_start + context_before;
-            if (start_idx >= op_count) start_idx = op_count - 1;
-
-            int end_idx = hunk_end - context_after;
-            if (end_idx < 0) end_idx = 0;
-
-            // Calculate line numbers
-            int a_start = 1, a_count = 0;
-            int b_start = 1, b_count = 0;
-
-            for (int x = op_count - 1; x >= end_idx; x--) {
-                if (x == start_idx) {
-                    a_start = (ops[x].ai >= 0) ? ops[x].ai + 1 : 1;
-                    b_start = (ops[x].bi >= 0) ? ops[x].bi + 1 : 1;
-                }
-                if (x <= start_idx && x >= end_idx) {
-                    if (ops[x].op == ' ' || ops[x].op == '-') a_count++;
-                    if (ops[x].op == ' ' || ops[x].op == '+') b_count++;
-                }
-            }
+    free(ax);
+    free(ay);
+    free(prev);
+    free(tails);
+    return ok;
+}
 
-            printf("@@ -%d,%d +%d,%d @@\n", a_start, a_count, b_start, b_count);
+// ============================================================================
+// Histogram
+// ============================================================================
 
-            for (int x = start_idx; x >= end_idx; x--) {
-                if (ops[x].op == ' ') {
-                    printf(" %s\n", a->lines[ops[x].ai]);
-                } else if (ops[x].op == '-') {
-                    printf("-%s\n", a->lines[ops[x].ai]);
-                } else if (ops[x].op == '+') {
-                    printf("+%s\n", b->lines[ops[x].bi]);
-                }
-            }
+static int *chain_head, *chain_next;
 
-            hunk_start = -1;
-            hunk_end = -1;
-        }
+static int diff_histogram(const Range *r) {
+    // Occurrences of each id in x, chained in ascending order
+    for (int i = r->xlim - 1; i >= r->xoff; i--) {
+        int id = xv[i];
+        chain_next[i] = count_x[id] ? chain_head[id] : -1;
+        chain_head[id] = i;
+        count_x[id]++;
     }
 
-    // Print remaining hunk
-    if (hunk_start >= 0) {
-        int a_start = 1, a_count = 0;
-        int b_start = 1, b_count = 0;
+    int best_len = 0, best_count = HISTOGRAM_MAX_CHAIN + 1;
+    int bx = 0, by = 0;
 
-        for (int x = op_count - 1; x >= 0; x--) {
-            if (ops[x].op == ' ' || ops[x].op == '-') a_count++;
-            if (ops[x].op == ' ' || ops[x].op == '+') b_count++;
+    for (int j = r->yoff; j < r->ylim;) {
+        int id = yv[j];
+        int next_j = j + 1;
+        if (count_x[id] == 0 || count_x[id] > best_count) {
+            j = next_j;
+            continue;
         }
 
-        if (op_count > 0) {
-            a_start = (ops[op_count-1].ai >= 0) ? ops[op_count-1].ai + 1 : 1;
-            b_start = (ops[op_count-1].bi >= 0) ? ops[op_count-1].bi + 1 : 1;
+        for (int i = chain_head[id]; i >= 0; i = chain_next[i]) {
+            int xs = i, ys = j, xe = i + 1, ye = j + 1;
+            int rc = count_x[id];
+            while (xs > r->xoff && ys > r->yoff && xv[xs - 1] == yv[ys - 1]) {
+                xs--; ys--;
+                if (count_x[xv[xs]] < rc) rc = count_x[xv[xs]];
+            }
+            while (xe < r->xlim && ye < r->ylim && xv[xe] == yv[ye]) {
+                if (count_x[xv[xe]] < rc) rc = count_x[xv[xe]];
+                xe++; ye++;
+            }
+            if (next_j < ye) next_j = ye;
+            if (best_len < xe - xs || rc < best_count) {
+                best_len = xe - xs;
+                best_count = rc;
+                bx = xs;
+                by = ys;
+            }
         }
+        j = next_j;
+    }
 
-        printf("@@ -%d,%d +%d,%d @@\n", a_start, a_count, b_start, b_count);
+    for (int i = r->xoff; i < r->xlim; i++) count_x[xv[i]] = 0;
 
-        for (int x = op_count - 1; x >= 0; x--) {
-            if (ops[x].op == ' ') {
-                printf(" %s\n", a->lines[ops[x].ai]);
-            } else if (ops[x].op == '-') {
-                printf("-%s\n", a->lines[ops[x].ai]);
-            } else if (ops[x].op == '+') {
-                printf("+%s\n", b->lines[ops[x].bi]);
-            }
+    if (best_len == 0) return diff_myers(r);
+    return push_range(r->xoff, bx, r->yoff, by, ALG_HISTOGRAM) &&
+           push_range(bx + best_len, r->xlim, by + best_len, r->ylim, ALG_HISTOGRAM);
+}
+
+// ============================================================================
+// Driver and output
+// ============================================================================
+
+static int compute_diff(int alg) {
+    // GNU diff's cost cutoff: about the square root of the input size
+    too_expensive = 1;
+    for (long long diags = (long long)total_x + total_y + 3; diags != 0; diags >>= 2) {
+        too_expensive <<= 1;
+    }
+    if (too_expensive < 4096) too_expensive = 4096;
+
+    size_t ndiags = (size_t)total_x + (size_t)total_y + 3;
+    int *fbuf = (int *)malloc(ndiags * sizeof(int));
+    int *bbuf = (int *)malloc(ndiags * sizeof(int));
+    if (!fbuf || !bbuf) return 0;
+    fdiag = fbuf + total_y + 1;
+    bdiag = bbuf + total_y + 1;
+
+    if (alg != ALG_MYERS) {
+        size_t n = (size_t)num_ids + 1;
+        count_x = (int *)calloc(n, sizeof(int));
+        count_y = (int *)calloc(n, sizeof(int));
+        pos_y = (int *)malloc(n * sizeof(int));
+        chain_head = (int *)malloc(n * sizeof(int));
+        chain_next = (int *)malloc(((size_t)total_x + 1) * sizeof(int));
+        if (!count_x || !count_y || !pos_y || !chain_head || !chain_next) return 0;
+    }
+
+    if (!push_range(0, total_x, 0, total_y, alg)) return 0;
+    while (stack_len > 0) {
+        Range r = stack[--stack_len];
+        if (trim_range(&r)) continue;
+
+        int ok;
+        switch (r.alg) {
+            case ALG_PATIENCE: ok = diff_patience(&r); break;
+            case ALG_HISTOGRAM: ok = diff_histogram(&r); break;
+            default: ok = diff_myers(&r); break;
+        }
+        if (!ok) return 0;
+    }
+
+    free(fbuf);
+    free(bbuf);
+    return 1;
+}
+
+// "start,count" as unified diff writes it: a one-line range omits the
+// count, an empty range names the line before it
+static void print_range(int start, int count) {
+    out_int(count == 0 ? start : start + 1);
+    if (count != 1) {
+        out_char(',');
+        out_int(count);
+    }
+}
+
+static void print_lines(char prefix, const LineList *l, int from, int to) {
+    for (int i = from; i < to; i++) {
+        out_char(prefix);
+        out_write(l->lines[i].ptr, l->lines[i].len);
+        out_char('\n');
+    }
+}
+
+typedef struct {
+    int x0, x1, y0, y1;
+} Block;
+
+// Collect the runs of changed lines, then print them as hunks, merging
+// blocks whose context would touch
+static int print_unified(const LineList *a, const LineList *b, int context) {
+    Block *blocks = NULL;
+    size_t nblocks = 0, cap = 0;
+    int i = 0, j = 0;
+
+    for (;;) {
+        while (i < total_x && j < total_y && !changed_x[i] && !changed_y[j]) { i++; j++; }
+        if (i >= total_x && j >= total_y) break;
+        if (nblocks == cap) {
+            cap = cap ? cap * 2 : 64;
+            Block *tmp = (Block *)realloc(blocks, cap * sizeof(Block));
+            if (!tmp) { free(blocks); return 0; }
+            blocks = tmp;
+        }
+        Block *blk = &blocks[nblocks++];
+        blk->x0 = i;
+        while (i < total_x && changed_x[i]) i++;
+        blk->x1 = i;
+        blk->y0 = j;
+        while (j < total_y && changed_y[j]) j++;
+        blk->y1 = j;
+    }
+
+    if (nblocks > 0) out_str("--- a\n+++ b\n");
+
+    for (size_t first = 0; first < nblocks;) {
+        size_t last = first;
+        while (last + 1 < nblocks && blocks[last + 1].x0 - blocks[last].x1 <= 2 * context) last++;
+
+        int hx = blocks[first].x0 - context < 0 ? 0 : blocks[first].x0 - context;
+        int hy = blocks[first].y0 - (blocks[first].x0 - hx);
+        int tx = blocks[last].x1 + context > total_x ? total_x : blocks[last].x1 + context;
+        int ty = blocks[last].y1 + (tx - blocks[last].x1);
+
+        out_str("@@ -");
+        print_range(hx, tx - hx);
+        out_str(" +");
+        print_range(hy, ty - hy);
+        out_str(" @@\n");
+
+        // Removals come before additions within each block
+        int x = hx;
+        for (size_t k = first; k <= last; k++) {
+            print_lines(' ', a, x, blocks[k].x0);
+            print_lines('-', a, blocks[k].x0, blocks[k].x1);
+            print_lines('+', b, blocks[k].y0, blocks[k].y1);
+            x = blocks[k].x1;
         }
+        print_lines(' ', a, x, tx);
+
+        first = last + 1;
     }
 
-    free(ops);
+    free(blocks);
+    return 1;
+}
+
+static int is_algorithm(const char *s, int *alg) {
+    if (strcmp(s, "myers") == 0 || strcmp(s, "default") == 0) {
+        *alg = ALG_MYERS;
+    } else if (strcmp(s, "minimal") == 0) {
+        *alg = ALG_MYERS;
+        minimal = 1;
+    } else if (strcmp(s, "patience") == 0) {
+        *alg = ALG_PATIENCE;
+    } else if (strcmp(s, "histogram") == 0) {
+        *alg = ALG_HISTOGRAM;
+    } else {
+        return 0;
+    }
+    return 1;
 }
 
 int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: diff <text1> <text2>\n");
+    const char *text1 = NULL, *text2 = NULL;
+    int alg = ALG_MYERS;
+    int context = DIFF_DEFAULT_CONTEXT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--minimal") == 0 || strcmp(arg, "-d") == 0) {
+            minimal = 1;
+        } else if (strcmp(arg, "--patience") == 0) {
+            alg = ALG_PATIENCE;
+        } else if (strcmp(arg, "--histogram") == 0) {
+            alg = ALG_HISTOGRAM;
+        } else if (strncmp(arg, "--diff-algorithm=", 17) == 0) {
+            if (!is_algorithm(arg + 17, &alg)) {
+                fprintf(stderr, "diff: unknown algorithm: %s\n", arg + 17);
+                return 1;
+            }
+        } else if ((strcmp(arg, "-U") == 0 || strcmp(arg, "--unified") == 0) && i + 1 < argc) {
+            context = atoi(argv[++i]);
+            if (context < 0) context = 0;
+        } else if (!text1) {
+            text1 = arg;
+        } else if (!text2) {
+            text2 = arg;
+        } else if (!is_algorithm(arg, &alg) && strcmp(arg, "true") != 0 && strcmp(arg, "false") != 0) {
+            fprintf(stderr, "diff: unexpected argument: %s\n", arg);
+            return 1;
+        }
+    }
+
+    if (!text2) {
+        fprintf(stderr, USAGE);
         return 1;
     }
 
-    FileLines a, b;
-    parse_lines(argv[1], &a);
-    parse_lines(argv[2], &b);
+    LineList a, b;
+    LineInterner interner;
+    if (!line_list_split(text1, strlen(text1), &a) ||
+        !line_list_split(text2, strlen(text2), &b) ||
+        !line_interner_init(&interner, a.count + b.count) ||
+        a.count > INT_MAX / 2 || b.count > INT_MAX / 2) {
+        fprintf(stderr, "diff: out of memory\n");
+        return 1;
+    }
+    total_x = (int)a.count;
+    total_y = (int)b.count;
+
+    xv = (int *)malloc(((size_t)total_x + 1) * sizeof(int));
+    yv = (int *)malloc(((size_t)total_y + 1) * sizeof(int));
+    changed_x = (char *)calloc((size_t)total_x + 1, 1);
+    changed_y = (char *)calloc((size_t)total_y + 1, 1);
+    if (!xv || !yv || !changed_x || !changed_y) {
+        fprintf(stderr, "diff: out of memory\n");
+        return 1;
+    }
+    int ok = 1;
+    for (int i = 0; i < total_x; i++) {
+        xv[i] = line_interner_id(&interner, a.lines[i].ptr, a.lines[i].len);
+        if (xv[i] < 0) ok = 0;
+    }
+    for (int j = 0; j < total_y; j++) {
+        yv[j] = line_interner_id(&interner, b.lines[j].ptr, b.lines[j].len);
+        if (yv[j] < 0) ok = 0;
+    }
+    num_ids = interner.count;
+    line_interner_free(&interner);
 
-    print_diff(&a, &b);
+    if (!ok || !compute_diff(alg)) {
+        fprintf(stderr, "diff: out of memory\n");
+        return 1;
+    }
 
-    free_lines(&a);
-    free_lines(&b);
+    if (!print_unified(&a, &b, context)) {
+        fprintf(stderr, "diff: out of memory\n");
+        return 1;
+    }
+    out_flush();
 
+    line_list_free(&a);
+    line_list_free(&b);
     return 0;
 }
@@ -9,7 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-void format_size(long long size, char *buf, size_t buf_len, int human_readable) {
+static void format_size(long long size, char *buf, size_t buf_len, int human_readable) {
     if (!human_readable) {
         snprintf(buf, buf_len, "%lld", (size + 1023) / 1024);  // Convert to KB blocks
         return;
@@ -74,7 +74,7 @@ static const MagicEntry magic_table[] = {
 };
 
 // Convert hex string to bytes
-int hex_to_bytes(const char *hex, uint8_t *out, size_t max_len) {
+static int hex_to_bytes(const char *hex, uint8_t *out, size_t max_len) {
     size_t hex_len = strlen(hex);
     size_t byte_len = hex_len / 2;
     if (byte_len > max_len) byte_len = max_len;
@@ -90,7 +90,7 @@ int hex_to_bytes(const char *hex, uint8_t *out, size_t max_len) {
 }
 
 // Convert bytes to hex for comparison
-void bytes_to_hex(const uint8_t *bytes, size_t len, char *out) {
+static void bytes_to_hex(const uint8_t *bytes, size_t len, char *out) {
     for (size_t i = 0; i < len; i++) {
         sprintf(out + i * 2, "%02x", bytes[i]);
     }
@@ -98,14 +98,14 @@ void bytes_to_hex(const uint8_t *bytes, size_t len, char *out) {
 }
 
 // Check if input is all hex characters
-int is_hex_string(const char *s) {
+static int is_hex_string(const char *s) {
     for (; *s; s++) {
         if (!isxdigit((unsigned char)*s)) return 0;
     }
     return 1;
 }
 
-const char* detect_type(const uint8_t *data, size_t len) {
+static const char* detect_type(const uint8_t *data, size_t len) {
     char hex_buf[64];
     size_t check_len = len > 16 ? 16 : len;
     bytes_to_hex(data, check_len, hex_buf);
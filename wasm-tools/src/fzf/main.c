@@ -1,42 +1,87 @@
 /**
  * fzf - Fuzzy finder (simplified)
- * Usage: fzf <query> <items>
- * Items: newline-separated list
+ * Usage: fzf [--limit N] <query> [items]
+ *        fzf --query <query> [--limit N] < items
+ * Items: newline-separated list (argument or stdin)
+ *
+ * Items are streamed and scored one at a time, so there is no cap on the
+ * number of candidates. A bitmask of the characters in each item rejects
+ * most non-matches before scoring, and only the best N (--limit, default
+ * 20) are kept in a min-heap, so ranking n items costs O(n log N).
+ *
+ * Ranking runs in two passes. The greedy scorer (first occurrence of each
+ * query character) is cheap and picks a pool of candidates; the pool is
+ * then rescored with an optimal alignment in the style of fzf's v2
+ * algorithm (a Smith-Waterman variant with gap penalties and word
+ * boundary bonuses), using DP rows from one arena reused for every
+ * candidate. --algo v1 ranks by the greedy score alone.
+ *
+ * Options:
+ *   --limit N      Number of results (default 20)
+ *   --algo v1|v2   Ranking algorithm (default v2)
+ *   --positions    Append the matched byte offsets (0-based,
+ *                  comma-separated) after a tab, for highlighting
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
 
-#define MAX_ITEMS 10000
+#define DEFAULT_LIMIT 20
+#define NO_MATCH INT32_MIN          /* Scores can be negative; this is never a score */
+#define MIN_RESCORE_POOL 256        /* Greedy candidates rescored with v2 */
+#define MAX_POSITION_CELLS (1 << 20) /* Largest query x item matrix kept for positions */
 
 typedef struct {
     char *text;
+    size_t len;
     int score;
+    size_t order;           /* Input position, breaks ties in favour of earlier items */
 } ScoredItem;
 
+static uint8_t lower_table[256];
+
+static void init_tables(void) {
+    for (int c = 0; c < 256; c++) lower_table[c] = (uint8_t)tolower(c);
+}
+
+/* One bit per (case-folded) character class; collisions only cause false positives */
+static inline uint64_t char_bit(uint8_t c) {
+    return (uint64_t)1 << (lower_table[c] & 63);
+}
+
+static uint64_t char_mask(const char *s, size_t len) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < len; i++) mask |= char_bit((uint8_t)s[i]);
+    return mask;
+}
+
+static inline int is_separator(char c) {
+    return c == '/' || c == '\\' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
 // Calculate fuzzy match score
-// Higher score = better match
-int fuzzy_score(const char *text, const char *query) {
-    if (!query || !*query) return 100;  // Empty query matches everything
+// Higher score = better match; query must already be lowercase
+// Returns NO_MATCH unless every query char occurs in order
+static int fuzzy_score(const char *text, size_t text_len, const char *query, size_t query_len) {
+    if (query_len == 0) return 100;  // Empty query matches everything
 
-    const char *t = text;
-    const char *q = query;
+    size_t t = 0;
     int score = 0;
     int consecutive = 0;
     int prev_matched = 0;
-    int query_len = strlen(query);
-    int text_len = strlen(text);
 
     // Must match all query characters
-    while (*q) {
-        char qc = tolower((unsigned char)*q);
+    for (size_t q = 0; q < query_len; q++) {
+        uint8_t qc = (uint8_t)query[q];
         int found = 0;
 
-        while (*t) {
-            char tc = tolower((unsigned char)*t);
-            t++;
+        while (t < text_len) {
+            uint8_t tc = lower_table[(uint8_t)text[t++]];
 
             if (tc == qc) {
                 found = 1;
@@ -51,19 +96,18 @@ int fuzzy_score(const char *text, const char *query) {
                 }
 
                 // Bonus for match at start
-                if (t - text == 1) {
+                if (t == 1) {
                     score += 20;
                 }
 
                 // Bonus for match after separator
-                if (t > text + 1) {
-                    char prev = *(t - 2);
-                    if (prev == '/' || prev == '\\' || prev == '_' || prev == '-' ||
-                        prev == '.' || prev == ' ') {
+                if (t > 1) {
+                    char prev = text[t - 2];
+                    if (is_separator(prev)) {
                         score += 15;
                     }
                     // Bonus for CamelCase
-                    if (isupper((unsigned char)*(t - 1)) && islower((unsigned char)prev)) {
+                    if (isupper((unsigned char)text[t - 1]) && islower((unsigned char)prev)) {
                         score += 15;
                     }
                 }
@@ -75,66 +119,538 @@ int fuzzy_score(const char *text, const char *query) {
             prev_matched = 0;
         }
 
-        if (!found) return -1;  // Query char not found
-        q++;
+        if (!found) return NO_MATCH;  // Query char not found
     }
 
     // Penalty for longer strings (prefer shorter matches)
-    score -= (text_len - query_len) / 2;
+    score -= ((int)text_len - (int)query_len) / 2;
 
     return score;
 }
 
-// Compare function for sorting
-int compare_items(const void *a, const void *b) {
+/* Offsets of the first occurrence of each query character */
+static void greedy_positions(const char *text, size_t text_len, const char *query, size_t query_len,
+                             int32_t *positions) {
+    size_t t = 0;
+    for (size_t q = 0; q < query_len; q++) {
+        while (t < text_len && lower_table[(uint8_t)text[t]] != (uint8_t)query[q]) t++;
+        positions[q] = (int32_t)t++;
+    }
+}
+
+/* ========================================================================== */
+/* Optimal alignment (v2)                                                     */
+/* ========================================================================== */
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START (-3)
+#define SCORE_GAP_EXTENSION (-1)
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_NON_WORD (SCORE_MATCH / 2)
+#define BONUS_CAMEL123 (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+#define BONUS_BOUNDARY_WHITE (BONUS_BOUNDARY + 2)
+#define BONUS_BOUNDARY_DELIMITER (BONUS_BOUNDARY + 1)
+#define SCORE_NONE (INT32_MIN / 2)
+
+/* Ordered so that everything after CH_NON_WORD starts a word */
+enum { CH_WHITE, CH_NON_WORD, CH_DELIMITER, CH_LOWER, CH_UPPER, CH_LETTER, CH_NUMBER };
+
+static uint8_t char_class[256];
+static int8_t bonus_table[7][7];    /* [previous class][class] */
+
+static int bonus_for(int prev, int cls) {
+    if (cls > CH_NON_WORD) {
+        if (prev == CH_WHITE) return BONUS_BOUNDARY_WHITE;
+        if (prev == CH_DELIMITER) return BONUS_BOUNDARY_DELIMITER;
+        if (prev == CH_NON_WORD) return BONUS_BOUNDARY;
+    }
+    if ((prev == CH_LOWER && cls == CH_UPPER) || (prev != CH_NUMBER && cls == CH_NUMBER)) {
+        return BONUS_CAMEL123;
+    }
+    if (cls == CH_NON_WORD || cls == CH_DELIMITER) return BONUS_NON_WORD;
+    if (cls == CH_WHITE) return BONUS_BOUNDARY_WHITE;
+    return 0;
+}
+
+static void init_v2_tables(void) {
+    for (int c = 0; c < 256; c++) {
+        int cls;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v') cls = CH_WHITE;
+        else if (c == '/' || c == ',' || c == ':' || c == ';' || c == '|') cls = CH_DELIMITER;
+        else if (c >= 'a' && c <= 'z') cls = CH_LOWER;
+        else if (c >= 'A' && c <= 'Z') cls = CH_UPPER;
+        else if (c >= '0' && c <= '9') cls = CH_NUMBER;
+        else if (c >= 0x80) cls = CH_LETTER;
+        else cls = CH_NON_WORD;
+        char_class[c] = (uint8_t)cls;
+    }
+    for (int p = 0; p < 7; p++) {
+        for (int c = 0; c < 7; c++) bonus_table[p][c] = (int8_t)bonus_for(p, c);
+    }
+}
+
+/*
+ * Scratch space for the DP, grown to the largest candidate and reused.
+ * Score-only alignment needs two rows; recovering positions keeps every
+ * row of match scores plus a bit per cell recording consecutive matches.
+ */
+typedef struct {
+    int32_t *match;         /* Best score with query[i] matched at text[j] */
+    int32_t *gap;           /* Two rows: best score with a gap covering text[j] */
+    uint8_t *chunk;         /* Two rows: bonus of the consecutive run ending at j */
+    uint8_t *consecutive;   /* Full matrix only: match[i][j] extends match[i-1][j-1] */
+    int8_t *bonus;          /* Per text position */
+    int32_t *band;          /* Leftmost then rightmost column of each query character */
+    size_t match_cap, row_cap, cons_cap, band_cap;
+} Arena;
+
+static Arena arena;
+
+static int arena_reserve(size_t rows, size_t cols, int full) {
+    size_t match_cells = (full ? rows : 2) * cols;
+    if (match_cells > arena.match_cap) {
+        int32_t *p = (int32_t *)realloc(arena.match, match_cells * sizeof(int32_t));
+        if (!p) return 0;
+        arena.match = p;
+        arena.match_cap = match_cells;
+    }
+    if (cols > arena.row_cap) {
+        int32_t *gap = (int32_t *)realloc(arena.gap, 2 * cols * sizeof(int32_t));
+        if (!gap) return 0;
+        arena.gap = gap;
+        uint8_t *chunk = (uint8_t *)realloc(arena.chunk, 2 * cols);
+        if (!chunk) return 0;
+        arena.chunk = chunk;
+        int8_t *bonus = (int8_t *)realloc(arena.bonus, cols);
+        if (!bonus) return 0;
+        arena.bonus = bonus;
+        arena.row_cap = cols;
+    }
+    if (rows > arena.band_cap) {
+        int32_t *p = (int32_t *)realloc(arena.band, 2 * rows * sizeof(int32_t));
+        if (!p) return 0;
+        arena.band = p;
+        arena.band_cap = rows;
+    }
+    if (full && rows * cols > arena.cons_cap) {
+        uint8_t *p = (uint8_t *)realloc(arena.consecutive, rows * cols);
+        if (!p) return 0;
+        arena.consecutive = p;
+        arena.cons_cap = rows * cols;
+    }
+    return 1;
+}
+
+/*
+ * Optimal alignment score of a lowercase query against text, or NO_MATCH
+ * if the query is not a subsequence. Matches score SCORE_MATCH plus the
+ * bonus of their position (word boundaries, camelCase, digits; doubled
+ * for the first query character); consecutive matches keep the bonus of
+ * the run's first character, and gaps between matches cost
+ * SCORE_GAP_START then SCORE_GAP_EXTENSION per character. Leading and
+ * trailing unmatched text is free.
+ *
+ * When positions is non-NULL and the matrix fits MAX_POSITION_CELLS,
+ * the matched offsets are recovered by backtracking; otherwise they are
+ * left to the caller.
+ */
+static int align_score(const char *text, size_t n, const char *query, size_t m,
+                       int32_t *positions, int *have_positions) {
+    if (have_positions) *have_positions = 0;
+    if (m == 0) {
+        if (have_positions) *have_positions = 1;
+        return 0;
+    }
+    if (m > n) return NO_MATCH;
+    int full = positions && m * n <= MAX_POSITION_CELLS;
+    if (!arena_reserve(m, n, full)) return NO_MATCH;
+
+    /* Band: query[i] can only sit between its greedy leftmost and rightmost spots */
+    int32_t *first = arena.band, *last = arena.band + m;
+    size_t t = 0;
+    for (size_t i = 0; i < m; i++) {
+        while (t < n && lower_table[(uint8_t)text[t]] != (uint8_t)query[i]) t++;
+        if (t >= n) return NO_MATCH;
+        first[i] = (int32_t)t++;
+    }
+    t = n;
+    for (size_t i = m; i-- > 0;) {
+        while (t > 0 && lower_table[(uint8_t)text[t - 1]] != (uint8_t)query[i]) t--;
+        last[i] = (int32_t)--t;
+    }
+    size_t first_col = (size_t)first[0];
+    size_t last_col = (size_t)last[m - 1] + 1;
+
+    int prev_class = CH_WHITE;
+    for (size_t j = 0; j < n; j++) {
+        int cls = char_class[(uint8_t)text[j]];
+        arena.bonus[j] = bonus_table[prev_class][cls];
+        prev_class = cls;
+    }
+
+    int32_t *match_prev = NULL, *gap_prev = NULL;
+    uint8_t *chunk_prev = NULL;
+    for (size_t i = 0; i < m; i++) {
+        int32_t *match_row = arena.match + (full ? i : (i & 1)) * n;
+        int32_t *gap_row = arena.gap + (i & 1) * n;
+        uint8_t *chunk_row = arena.chunk + (i & 1) * n;
+        uint8_t *cons_row = full ? arena.consecutive + i * n : NULL;
+        uint8_t qc = (uint8_t)query[i];
+        size_t lo = (size_t)first[i], hi = (size_t)last[i];
+
+        for (size_t j = first_col; j < lo; j++) {
+            match_row[j] = SCORE_NONE;
+            gap_row[j] = SCORE_NONE;
+        }
+        for (size_t j = lo; j < last_col; j++) {
+            int32_t score = SCORE_NONE;
+            uint8_t chunk = 0, consecutive = 0;
+
+            if (j <= hi && lower_table[(uint8_t)text[j]] == qc) {
+                int b = arena.bonus[j];
+                if (i == 0) {
+                    score = SCORE_MATCH + b * BONUS_FIRST_CHAR_MULTIPLIER;
+                    chunk = (uint8_t)b;
+                } else if (j > 0) {
+                    int32_t via_gap = gap_prev[j - 1] > SCORE_NONE ? gap_prev[j - 1] + SCORE_MATCH + b : SCORE_NONE;
+                    int32_t via_run = SCORE_NONE;
+                    int run_bonus = chunk_prev[j - 1];
+                    if (match_prev[j - 1] > SCORE_NONE) {
+                        if (b >= BONUS_BOUNDARY && b > run_bonus) run_bonus = b;
+                        int eff = run_bonus > b ? run_bonus : b;
+                        if (eff < BONUS_CONSECUTIVE) eff = BONUS_CONSECUTIVE;
+                        via_run = match_prev[j - 1] + SCORE_MATCH + eff;
+                    }
+                    if (via_run > SCORE_NONE && via_run >= via_gap) {
+                        score = via_run;
+                        chunk = (uint8_t)run_bonus;
+                        consecutive = 1;
+                    } else if (via_gap > SCORE_NONE) {
+                        score = via_gap;
+                        chunk = (uint8_t)b;
+                    }
+                }
+            }
+            match_row[j] = score;
+            chunk_row[j] = chunk;
+            if (cons_row) cons_row[j] = consecutive;
+
+            /* A gap at j follows a match at j-1 or extends the gap at j-1 */
+            int32_t g = SCORE_NONE;
+            if (j > lo) {
+                if (match_row[j - 1] > SCORE_NONE) g = match_row[j - 1] + SCORE_GAP_START;
+                if (gap_row[j - 1] > SCORE_NONE && gap_row[j - 1] + SCORE_GAP_EXTENSION > g) {
+                    g = gap_row[j - 1] + SCORE_GAP_EXTENSION;
+                }
+            }
+            gap_row[j] = g;
+        }
+        match_prev = match_row;
+        gap_prev = gap_row;
+        chunk_prev = chunk_row;
+    }
+
+    /* Best end position for the last query character (earliest on ties) */
+    int32_t best = SCORE_NONE;
+    size_t best_j = 0;
+    for (size_t j = (size_t)first[m - 1]; j <= (size_t)last[m - 1]; j++) {
+        if (match_prev[j] > best) {
+            best = match_prev[j];
+            best_j = j;
+        }
+    }
+    if (best <= SCORE_NONE) return NO_MATCH;
+
+    if (full) {
+        size_t j = best_j;
+        positions[m - 1] = (int32_t)j;
+        for (size_t i = m - 1; i > 0; i--) {
+            int32_t here = arena.match[i * n + j] - SCORE_MATCH - arena.bonus[j];
+            if (arena.consecutive[i * n + j]) {
+                j--;
+            } else {
+                /* here = match[i-1][k] + gap start + extensions up to j-1 */
+                const int32_t *prev = arena.match + (i - 1) * n;
+                size_t k = j - 2;
+                for (;;) {
+                    if (prev[k] > SCORE_NONE &&
+                        prev[k] + SCORE_GAP_START + (int32_t)(j - 2 - k) * SCORE_GAP_EXTENSION == here) break;
+                    if (k == 0) break;
+                    k--;
+                }
+                j = k;
+            }
+            positions[i - 1] = (int32_t)j;
+        }
+        *have_positions = 1;
+    }
+    return best;
+}
+
+/* ========================================================================== */
+/* Top-N min-heap                                                             */
+/* ========================================================================== */
+
+/* Root is the worst kept item: lowest score, latest on ties */
+typedef struct {
+    ScoredItem *items;
+    size_t count;
+    size_t cap;
+} TopHeap;
+
+/* a ranks below b */
+static inline int ranks_below(const ScoredItem *a, const ScoredItem *b) {
+    if (a->score != b->score) return a->score < b->score;
+    return a->order > b->order;
+}
+
+static void heap_sift_up(TopHeap *h, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!ranks_below(&h->items[i], &h->items[parent])) break;
+        ScoredItem tmp = h->items[i];
+        h->items[i] = h->items[parent];
+        h->items[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void heap_sift_down(TopHeap *h, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, worst = i;
+        if (l < h->count && ranks_below(&h->items[l], &h->items[worst])) worst = l;
+        if (r < h->count && ranks_below(&h->items[r], &h->items[worst])) worst = r;
+        if (worst == i) break;
+        ScoredItem tmp = h->items[i];
+        h->items[i] = h->items[worst];
+        h->items[worst] = tmp;
+        i = worst;
+    }
+}
+
+/* Would an item with this score and order make it into the heap? */
+static inline int heap_accepts(const TopHeap *h, int score, size_t order) {
+    if (h->count < h->cap) return 1;
+    ScoredItem probe;
+    probe.score = score;
+    probe.order = order;
+    return ranks_below(&h->items[0], &probe);
+}
+
+/* Insert a copy of text; the caller has checked heap_accepts */
+static void heap_push(TopHeap *h, const char *text, size_t len, int score, size_t order) {
+    ScoredItem item;
+    item.len = len;
+    item.score = score;
+    item.order = order;
+    if (h->count < h->cap) {
+        item.text = (char *)malloc(len + 1);
+        if (!item.text) return;
+        memcpy(item.text, text, len);
+        item.text[len] = '\0';
+        h->items[h->count] = item;
+        heap_sift_up(h, h->count++);
+        return;
+    }
+    /* Replace the root, reusing its buffer when it is big enough */
+    ScoredItem *root = &h->items[0];
+    if (root->len < len) {
+        char *p = (char *)realloc(root->text, len + 1);
+        if (!p) return;
+        root->text = p;
+    }
+    memcpy(root->text, text, len);
+    root->text[len] = '\0';
+    root->len = len;
+    root->score = score;
+    root->order = order;
+    heap_sift_down(h, 0);
+}
+
+/* Best first */
+static int compare_items(const void *a, const void *b) {
     const ScoredItem *ia = (const ScoredItem *)a;
     const ScoredItem *ib = (const ScoredItem *)b;
-    return ib->score - ia->score;  // Descending
+    if (ia->score != ib->score) return ib->score > ia->score ? 1 : -1;
+    return ia->order < ib->order ? -1 : ia->order > ib->order;
 }
 
-int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: fzf <query> <items>\n");
-        fprintf(stderr, "Items: newline-separated list\n");
-        return 1;
+/* Best v2 score first, then the shorter item, then input order */
+static int compare_rescored(const void *a, const void *b) {
+    const ScoredItem *ia = (const ScoredItem *)a;
+    const ScoredItem *ib = (const ScoredItem *)b;
+    if (ia->score != ib->score) return ib->score > ia->score ? 1 : -1;
+    if (ia->len != ib->len) return ia->len < ib->len ? -1 : 1;
+    return ia->order < ib->order ? -1 : ia->order > ib->order;
+}
+
+static void write_positions(const int32_t *positions, size_t count) {
+    out_char('\t');
+    for (size_t i = 0; i < count; i++) {
+        char num[16];
+        int n = snprintf(num, sizeof(num), i ? ",%d" : "%d", (int)positions[i]);
+        out_write(num, (size_t)n);
     }
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: fzf [--limit N] [--algo v1|v2] [--positions] <query> [items]\n");
+    fprintf(stderr, "       fzf --query <query> [--limit N] < items\n");
+    fprintf(stderr, "Items: newline-separated list\n");
+}
 
-    const char *query = argv[1];
-    const char *input = argv[2];
-
-    // Parse items
-    char *input_copy = strdup(input);
-    ScoredItem items[MAX_ITEMS];
-    int item_count = 0;
-
-    char *line = strtok(input_copy, "\n");
-    while (line && item_count < MAX_ITEMS) {
-        // Skip empty lines
-        while (*line && isspace((unsigned char)*line)) line++;
-        if (*line) {
-            int score = fuzzy_score(line, query);
-            if (score >= 0) {
-                items[item_count].text = line;
-                items[item_count].score = score;
-                item_count++;
+int main(int argc, char **argv) {
+    const char *query = NULL;
+    const char *input = NULL;
+    long limit = DEFAULT_LIMIT;
+    int positional = 0;
+    int use_v2 = 1;
+    int show_positions = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--query") == 0 && i + 1 < argc) {
+            query = argv[++i];
+        } else if (strcmp(arg, "--items") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if ((strcmp(arg, "--limit") == 0 || strcmp(arg, "-n") == 0) && i + 1 < argc) {
+            limit = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--algo") == 0 && i + 1 < argc) {
+            const char *algo = argv[++i];
+            if (strcmp(algo, "v1") == 0) use_v2 = 0;
+            else if (strcmp(algo, "v2") == 0) use_v2 = 1;
+            else {
+                fprintf(stderr, "fzf: unknown algorithm: %s (use v1 or v2)\n", algo);
+                return 1;
             }
+        } else if (strcmp(arg, "--positions") == 0) {
+            show_positions = 1;
+        } else if (!query) {
+            query = arg;
+            positional++;
+        } else if (!input) {
+            input = arg;
+            positional++;
+        } else if (positional == 2) {
+            /* Older positional form: fzf <query> <items> <limit> */
+            limit = strtol(arg, NULL, 10);
+            positional++;
+        } else {
+            usage();
+            return 1;
         }
-        line = strtok(NULL, "\n");
     }
 
-    // Sort by score
-    qsort(items, item_count, sizeof(ScoredItem), compare_items);
+    if (!query) {
+        usage();
+        return 1;
+    }
+    if (limit < 1) limit = 1;
+
+    init_tables();
+    init_v2_tables();
+
+    /* Lowercase the query once; the prefilter needs every query character */
+    size_t query_len = strlen(query);
+    char *lquery = (char *)malloc(query_len + 1);
+    if (!lquery) {
+        fprintf(stderr, "fzf: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i <= query_len; i++) lquery[i] = (char)lower_table[(uint8_t)query[i]];
+    uint64_t query_mask = char_mask(lquery, query_len);
+
+    /* v2 rescoring needs a wider greedy pool than the final result count */
+    size_t pool = (size_t)limit;
+    if (use_v2) {
+        pool = (size_t)limit * 4;
+        if (pool < MIN_RESCORE_POOL) pool = MIN_RESCORE_POOL;
+    }
+
+    TopHeap heap;
+    heap.cap = pool;
+    heap.count = 0;
+    heap.items = (ScoredItem *)malloc(heap.cap * sizeof(ScoredItem));
+    if (!heap.items) {
+        fprintf(stderr, "fzf: out of memory\n");
+        return 1;
+    }
+
+    LineReader reader;
+    if (input) line_reader_init_string(&reader, input);
+    else line_reader_init_stdin(&reader);
+
+    size_t match_count = 0;
+    size_t order = 0;
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        // Skip leading whitespace and empty lines
+        while (len > 0 && isspace((unsigned char)*line)) { line++; len--; }
+        if (len > 0 && line[len - 1] == '\r') len--;
+        if (len == 0) continue;
 
-    // Output top matches (max 20)
-    int max_output = item_count < 20 ? item_count : 20;
-    for (int i = 0; i < max_output; i++) {
-        printf("%s\n", items[i].text);
+        if ((query_mask & ~char_mask(line, len)) != 0) continue;
+
+        int score = fuzzy_score(line, len, lquery, query_len);
+        if (score == NO_MATCH) continue;
+
+        match_count++;
+        if (heap_accepts(&heap, score, order)) heap_push(&heap, line, len, score, order);
+        order++;
+    }
+
+    if (reader.error) {
+        out_flush();
+        fprintf(stderr, "fzf: read error\n");
+        line_reader_free(&reader);
+        return 1;
+    }
+    line_reader_free(&reader);
+
+    int32_t *positions = (int32_t *)malloc((query_len + 1) * sizeof(int32_t));
+    if (!positions) {
+        fprintf(stderr, "fzf: out of memory\n");
+        return 1;
+    }
+
+    if (use_v2) {
+        // Rescore the greedy pool with the optimal alignment
+        for (size_t i = 0; i < heap.count; i++) {
+            ScoredItem *item = &heap.items[i];
+            item->score = align_score(item->text, item->len, lquery, query_len, NULL, NULL);
+        }
+        qsort(heap.items, heap.count, sizeof(ScoredItem), compare_rescored);
+    } else {
+        // Sort the kept matches by score
+        qsort(heap.items, heap.count, sizeof(ScoredItem), compare_items);
+    }
+
+    size_t shown = heap.count < (size_t)limit ? heap.count : (size_t)limit;
+    for (size_t i = 0; i < shown; i++) {
+        ScoredItem *item = &heap.items[i];
+        out_write(item->text, item->len);
+        if (show_positions) {
+            int have = 0;
+            if (use_v2) align_score(item->text, item->len, lquery, query_len, positions, &have);
+            if (!have) greedy_positions(item->text, item->len, lquery, query_len, positions);
+            write_positions(positions, query_len);
+        }
+        out_char('\n');
     }
 
-    if (item_count > 20) {
-        printf("... and %d more matches\n", item_count - 20);
+    if (match_count > shown) {
+        char msg[64];
+        int n = snprintf(msg, sizeof(msg), "... and %zu more matches\n", match_count - shown);
+        out_write(msg, (size_t)n);
     }
 
-    free(input_copy);
-    return item_count > 0 ? 0 : 1;
+    out_flush();
+    for (size_t i = 0; i < heap.count; i++) free(heap.items[i].text);
+    free(heap.items);
+    free(positions);
+    free(lquery);
+    return match_count > 0 ? 0 : 1;
 }
@@ -1,104 +1,373 @@
 /**
- * grep - Search for patterns in text (simple substring match)
- * Usage: grep [-i] [-v] [-n] [-c] PATTERN <text>
- * Options: -i (ignore case), -v (invert match), -n (line numbers), -c (count only)
+ * grep - Search for patterns in text
+ * Usage: grep [-E|-F|-G] [-i] [-v] [-n] [-c] [-o] [-w] [-l] PATTERN <text>
+ *        grep [options] -e PATTERN... | -f FILE <text>
+ * Options: -E (extended regex), -F (fixed strings), -G (basic regex),
+ *          -i (ignore case), -v (invert match), -n (line numbers),
+ *          -c (count only), -o (print only the matching parts),
+ *          -w (match whole words), -l (print the input's name if it matches),
+ *          -e PATTERN (may be repeated), -f FILE (one pattern per line),
+ *          -m NUM (stop after NUM selected lines per input),
+ *          -H (prefix output with the input's name), -r (the same; the host
+ *          expands directories), --paths FILE (search FILE; may be repeated),
+ *          --label NAME (name of stdin for -H, -l, default "(standard input)"),
+ *          --lineOffset N (number lines from N + 1)
+ * Without -E or -G patterns are matched as plain substrings (-F). A line
+ * matches if any pattern matches; a pattern containing newlines is one
+ * pattern per line.
+ *
+ * With --paths the files are searched instead of the text argument or
+ * stdin, with names shown when there are several. The host splits large
+ * searches across Workers (src/wasm-tools/parallel-grep.ts), giving each
+ * a run of files, or a line-aligned chunk of one large file on stdin with
+ * --label and --lineOffset so the output reads as if grep saw the whole
+ * file.
+ *
+ * A single fixed string is found with simd_memmem(). Several fixed
+ * strings, or one with -o or -w, are compiled into one Aho-Corasick
+ * automaton (aho_corasick.h), so each line is scanned once however many
+ * patterns there are.
+ *
+ * Long forms --pattern, --extended, --fixed, --patterns, --patternFile,
+ * --ignoreCase, --invert, --lineNumbers, --count, --onlyMatching,
+ * --wordRegexp, --filesWithMatches, --maxCount, --withFilename and
+ * --recursive are accepted as passed by the tool registry.
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <stdlib.h>
-#include "../stdin_read.h"
+#include "../line_reader.h"
+#include "../stdout_write.h"
+#include "../regex_engine.h"
+#include "../aho_corasick.h"
+#include "../simd.h"
 
-// Case-insensitive strstr
-char *strcasestr_impl(const char *haystack, const char *needle) {
-    if (!*needle) return (char *)haystack;
+#define USAGE "Usage: grep [-E|-F|-G] [-i] [-v] [-n] [-c] [-o] [-w] [-l] [-m NUM] PATTERN <text>\n" \
+              "       grep [options] -e PATTERN... | -f FILE <text>\n" \
+              "       grep [options] PATTERN --paths FILE...\nOr pipe text via stdin.\n"
 
-    for (; *haystack; haystack++) {
-        const char *h = haystack;
-        const char *n = needle;
+typedef struct {
+    char **text;
+    size_t *len;
+    int count, cap;
+} PatternList;
 
-        while (*h && *n && (tolower((unsigned char)*h) == tolower((unsigned char)*n))) {
-            h++;
-            n++;
+static void patterns_add(PatternList *list, char *text, size_t len) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 16;
+        list->text = (char **)realloc(list->text, list->cap * sizeof(char *));
+        list->len = (size_t *)realloc(list->len, list->cap * sizeof(size_t));
+    }
+    list->text[list->count] = text;
+    list->len[list->count] = len;
+    list->count++;
+}
+
+/* Add one pattern per line of text[0..len); a final newline ends the last line */
+static void patterns_add_lines(PatternList *list, char *text, size_t len) {
+    size_t start = 0;
+    while (start < len) {
+        const char *nl = (const char *)simd_memchr(text + start, '\n', len - start);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        text[end] = '\0';
+        patterns_add(list, text + start, end - start);
+        start = end + 1;
+    }
+}
+
+/* Add a command-line pattern, which may hold several lines */
+static void patterns_add_arg(PatternList *list, char *text) {
+    size_t len = strlen(text);
+    if (len == 0) patterns_add(list, text, 0);
+    else patterns_add_lines(list, text, len);
+}
+
+/* Read -f FILE into list; the buffer is kept for the patterns' lifetime */
+static int patterns_read_file(PatternList *list, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "grep: %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    size_t len = 0, cap = 4096;
+    char *buf = (char *)malloc(cap + 1);
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, fp)) > 0) {
+        len += n;
+        if (len == cap) {
+            cap *= 2;
+            buf = (char *)realloc(buf, cap + 1);
         }
+    }
+    fclose(fp);
+    buf[len] = '\0';
+    patterns_add_lines(list, buf, len);
+    return 1;
+}
 
-        if (!*n) return (char *)haystack;
+/*
+ * Leftmost-longest match of any regex starting at or after from; with
+ * whole_words, the leftmost match of each regex that is a whole word.
+ */
+static int regex_search(Regex **res, int count, const char *line, size_t len, size_t from,
+                        int whole_words, size_t *match_start, size_t *match_end) {
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        size_t pos = from, start, end;
+        while (pos <= len && re_search(res[i], line, len, pos, &start, &end)) {
+            if (!whole_words || ac_whole_word(line, len, start, end)) {
+                if (!found || start < *match_start || (start == *match_start && end > *match_end)) {
+                    found = 1;
+                    *match_start = start;
+                    *match_end = end;
+                }
+                break;
+            }
+            pos = start + 1;
+        }
     }
-    return NULL;
+    return found;
 }
 
-int main(int argc, char **argv) {
-    int ignore_case = 0;
-    int invert_match = 0;
-    int show_line_numbers = 0;
-    int count_only = 0;
-    const char *pattern = NULL;
-    const char *input = NULL;
+typedef struct {
+    int invert_match;
+    int show_line_numbers;
+    int count_only;
+    int only_matching;
+    int whole_words;
+    int files_with_matches;
+    int with_filename;
+    long max_count;     /* -1: no limit */
+    long line_offset;
+    int ignore_case;
+    PatternList patterns;
+    Regex **res;        /* -E/-G: one regex per pattern */
+    AhoCorasick *ac;    /* Several fixed strings, or -o/-w */
+} Search;
 
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-i") == 0) {
-            ignore_case = 1;
-        } else if (strcmp(argv[i], "-v") == 0) {
-            invert_match = 1;
-        } else if (strcmp(argv[i], "-n") == 0) {
-            show_line_numbers = 1;
-        } else if (strcmp(argv[i], "-c") == 0) {
-            count_only = 1;
-        } else if (!pattern) {
-            pattern = argv[i];
-        } else if (!input) {
-            input = argv[i];
+/* Does the line match; sets the first match for -o and -w */
+static int line_matches(const Search *s, const char *line, size_t len, size_t *start, size_t *end) {
+    if (s->only_matching || s->whole_words) {
+        return s->ac ? ac_search(s->ac, line, len, 0, s->whole_words, start, end)
+                     : regex_search(s->res, s->patterns.count, line, len, 0, s->whole_words, start, end);
+    }
+    if (s->ac) return ac_match(s->ac, line, len);
+    if (s->res) {
+        for (int i = 0; i < s->patterns.count; i++) {
+            if (re_match(s->res[i], line, len)) return 1;
         }
+        return 0;
+    }
+    if (s->ignore_case) {
+        return simd_memmem_icase(line, len, s->patterns.text[0], s->patterns.len[0]) != NULL;
     }
+    return simd_memmem(line, len, s->patterns.text[0], s->patterns.len[0]) != NULL;
+}
 
-    char *stdin_buf = NULL;
-    if (!pattern) {
-        fprintf(stderr, "Usage: grep [-i] [-v] [-n] [-c] PATTERN <text>\nOr pipe text via stdin.\n");
-        return 1;
+static void print_prefix(const Search *s, const char *name, long line_num) {
+    if (s->with_filename) {
+        out_str(name);
+        out_char(':');
     }
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) { fprintf(stderr, "Usage: grep [-i] [-v] [-n] [-c] PATTERN <text>\nOr pipe text via stdin.\n"); return 1; }
-        input = stdin_buf;
+    if (s->show_line_numbers) {
+        out_int(line_num);
+        out_char(':');
     }
+}
 
-    char *input_copy = strdup(input);
-    int line_num = 0;
-    int match_count = 0;
+/* Search one input; returns the number of selected lines */
+static long search_input(const Search *s, LineReader *reader, const char *name) {
+    long line_num = s->line_offset;
+    long match_count = 0;
 
-    char *line = strtok(input_copy, "\n");
-    while (line) {
+    char *line;
+    size_t line_len;
+    while ((s->max_count < 0 || match_count < s->max_count) &&
+           line_reader_next(reader, &line, &line_len)) {
         line_num++;
 
-        // Check for match
-        int matched;
-        if (ignore_case) {
-            matched = strcasestr_impl(line, pattern) != NULL;
-        } else {
-            matched = strstr(line, pattern) != NULL;
-        }
+        size_t start = 0, end = 0;
+        int matched = line_matches(s, line, line_len, &start, &end);
+        if (s->invert_match) matched = !matched;
+        if (!matched) continue;
 
-        if (invert_match) matched = !matched;
+        match_count++;
+        if (s->files_with_matches) break;
+        if (s->count_only) continue;
 
-        if (matched) {
-            match_count++;
-            if (!count_only) {
-                if (show_line_numbers) {
-                    printf("%d:", line_num);
-                }
-                printf("%s\n", line);
+        if (!s->only_matching) {
+            print_prefix(s, name, line_num);
+            out_write(line, line_len);
+            out_char('\n');
+            continue;
+        }
+
+        /* -o: every non-empty match; -v lines have none to print */
+        while (!s->invert_match) {
+            if (end > start) {
+                print_prefix(s, name, line_num);
+                out_write(line + start, end - start);
+                out_char('\n');
             }
+            size_t from = end > start ? end : start + 1;
+            if (from > line_len) break;
+            int more = s->ac ? ac_search(s->ac, line, line_len, from, s->whole_words, &start, &end)
+                             : regex_search(s->res, s->patterns.count, line, line_len, from,
+                                            s->whole_words, &start, &end);
+            if (!more) break;
+        }
+    }
+
+    if (s->files_with_matches) {
+        if (match_count > 0) {
+            out_str(name);
+            out_char('\n');
+        }
+    } else if (s->count_only) {
+        if (s->with_filename) {
+            out_str(name);
+            out_char(':');
+        }
+        out_int(match_count);
+        out_char('\n');
+    }
+    return match_count;
+}
+
+int main(int argc, char **argv) {
+    Search search = {0};
+    Search *s = &search;
+    s->max_count = -1;
+    int regex_flags = -1;  /* -1: plain substring match */
+    const char *label = "(standard input)";
+    char *pattern = NULL;
+    const char *input = NULL;
+    const char **paths = NULL;
+    int npaths = 0;
+    int have_pattern_list = 0;  /* -e or -f given: positional args are input */
+    int positional_pattern = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-i") == 0 || strcmp(arg, "--ignoreCase") == 0) {
+            s->ignore_case = 1;
+        } else if (strcmp(arg, "-v") == 0 || strcmp(arg, "--invert") == 0) {
+            s->invert_match = 1;
+        } else if (strcmp(arg, "-n") == 0 || strcmp(arg, "--lineNumbers") == 0) {
+            s->show_line_numbers = 1;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--count") == 0) {
+            s->count_only = 1;
+        } else if (strcmp(arg, "-o") == 0 || strcmp(arg, "--onlyMatching") == 0) {
+            s->only_matching = 1;
+        } else if (strcmp(arg, "-w") == 0 || strcmp(arg, "--wordRegexp") == 0) {
+            s->whole_words = 1;
+        } else if (strcmp(arg, "-l") == 0 || strcmp(arg, "--filesWithMatches") == 0) {
+            s->files_with_matches = 1;
+        } else if (strcmp(arg, "-H") == 0 || strcmp(arg, "--withFilename") == 0 ||
+                   strcmp(arg, "-r") == 0 || strcmp(arg, "--recursive") == 0) {
+            s->with_filename = 1;
+        } else if ((strcmp(arg, "-m") == 0 || strcmp(arg, "--maxCount") == 0) && i + 1 < argc) {
+            s->max_count = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--lineOffset") == 0 && i + 1 < argc) {
+            s->line_offset = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "-E") == 0 || strcmp(arg, "--extended") == 0) {
+            regex_flags = RE_EXTENDED;
+        } else if (strcmp(arg, "-F") == 0 || strcmp(arg, "--fixed") == 0) {
+            regex_flags = -1;
+        } else if (strcmp(arg, "-G") == 0) {
+            regex_flags = 0;
+        } else if ((strcmp(arg, "-e") == 0 || strcmp(arg, "--patterns") == 0) && i + 1 < argc) {
+            patterns_add_arg(&s->patterns, argv[++i]);
+            have_pattern_list = 1;
+        } else if ((strcmp(arg, "-f") == 0 || strcmp(arg, "--patternFile") == 0) && i + 1 < argc) {
+            if (!patterns_read_file(&s->patterns, argv[++i])) return 2;
+            have_pattern_list = 1;
+        } else if (strcmp(arg, "--paths") == 0 && i + 1 < argc) {
+            paths = (const char **)realloc(paths, (npaths + 1) * sizeof(char *));
+            paths[npaths++] = argv[++i];
+        } else if (strcmp(arg, "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(arg, "--pattern") == 0 && i + 1 < argc) {
+            pattern = argv[++i];
+        } else if (!pattern && !have_pattern_list) {
+            pattern = argv[i];
+            positional_pattern = 1;
+        } else if (!input) {
+            input = arg;
         }
+    }
 
-        line = strtok(NULL, "\n");
+    /* A positional pattern seen before -e/-f was the input */
+    if (have_pattern_list && positional_pattern && !input) {
+        input = pattern;
+        pattern = NULL;
+    }
+    if (pattern) {
+        patterns_add_arg(&s->patterns, pattern);
+    } else if (!have_pattern_list) {
+        fprintf(stderr, USAGE);
+        return 1;
+    }
+    if (npaths > 1) s->with_filename = 1;
+
+    int single_fixed = regex_flags < 0 && s->patterns.count == 1 && !s->only_matching && !s->whole_words;
+    if (regex_flags >= 0) {
+        s->res = (Regex **)malloc((s->patterns.count + 1) * sizeof(Regex *));
+        for (int i = 0; i < s->patterns.count; i++) {
+            const char *error;
+            s->res[i] = re_compile(s->patterns.text[i], regex_flags | (s->ignore_case ? RE_ICASE : 0), &error);
+            if (!s->res[i]) {
+                fprintf(stderr, "grep: invalid regular expression: %s\n", error);
+                return 2;
+            }
+        }
+    } else if (!single_fixed) {
+        s->ac = ac_new(s->ignore_case ? AC_ICASE : 0);
+        for (int i = 0; i < s->patterns.count; i++) {
+            ac_add(s->ac, s->patterns.text[i], s->patterns.len[i]);
+        }
+        ac_compile(s->ac);
     }
 
-    if (count_only) {
-        printf("%d\n", match_count);
+    long match_count = 0;
+    int error = 0;
+    LineReader reader;
+    if (npaths > 0) {
+        for (int i = 0; i < npaths; i++) {
+            FILE *fp = fopen(paths[i], "rb");
+            if (!fp) {
+                out_flush();
+                fprintf(stderr, "grep: %s: %s\n", paths[i], strerror(errno));
+                error = 1;
+                continue;
+            }
+            line_reader_init_file(&reader, fp);
+            match_count += search_input(s, &reader, paths[i]);
+            line_reader_free(&reader);
+            fclose(fp);
+        }
+    } else {
+        if (input) {
+            line_reader_init_string(&reader, input);
+        } else {
+            line_reader_init_stdin(&reader);
+            if (line_reader_is_empty(&reader)) {
+                fprintf(stderr, USAGE);
+                line_reader_free(&reader);
+                return 1;
+            }
+        }
+        match_count = search_input(s, &reader, label);
+        line_reader_free(&reader);
     }
 
-    free(input_copy);
-    free(stdin_buf);
-    return match_count > 0 ? 0 : 1;
+    for (int i = 0; s->res && i < s->patterns.count; i++) re_free(s->res[i]);
+    free(s->res);
+    ac_free(s->ac);
+    free(paths);
+    out_flush();
+    return error ? 2 : match_count > 0 ? 0 : 1;
 }
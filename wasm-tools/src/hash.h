@@ -0,0 +1,617 @@
+/**
+ * Incremental message digests: MD5 (RFC 1321), SHA-256 and SHA-512
+ * (FIPS 180-4).
+ *
+ * Each algorithm has an init/update/final context. update() compresses
+ * whole blocks straight from the caller's buffer and only copies a
+ * partial trailing block into the context, so a stream of any size is
+ * hashed in constant memory and binary input (including NUL bytes) is
+ * handled as-is.
+ *
+ * HashAlgo wraps the three behind one interface for tools that pick the
+ * algorithm at startup (see hashsum.h).
+ *
+ * hash_batch() hashes many independent inputs through a HashBatchIo. For
+ * SHA-256 it runs four inputs at once, one per 32-bit lane of a simd128
+ * vector (multi-buffer hashing); lanes are refilled as inputs finish, so
+ * thousands of small files cost about a quarter of the compression work.
+ * Without -msimd128 the lanes fall back to the unrolled scalar rounds.
+ *
+ * Usage:
+ *   HashCtx ctx;
+ *   uint8_t digest[HASH_MAX_DIGEST];
+ *   HASH_SHA256.init(&ctx);
+ *   while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+ *       HASH_SHA256.update(&ctx, buf, n);
+ *   HASH_SHA256.final(&ctx, digest);   // HASH_SHA256.digest_len bytes
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "simd.h"
+
+#define HASH_MAX_DIGEST 64
+#define HASH_MAX_BLOCK 128
+
+/*
+ * Inputs for hash_batch(), numbered 0..njobs-1. Jobs are opened in order
+ * but may finish out of order.
+ */
+typedef struct {
+    void *user;
+    /* Start reading job; returns 0, or -1 if it cannot be opened */
+    int (*open)(void *user, size_t job);
+    /* Read up to cap bytes; fewer than cap only at the end; -1 on error */
+    long (*read)(void *user, size_t job, uint8_t *buf, size_t cap);
+    /* Job finished (close it); digest is NULL if open or read failed */
+    void (*done)(void *user, size_t job, const uint8_t *digest);
+} HashBatchIo;
+
+/* ========================================================================== */
+/* MD5                                                                        */
+/* ========================================================================== */
+
+typedef struct {
+    uint32_t h[4];
+    uint64_t len;              /* Total bytes hashed */
+    uint8_t buf[64];           /* Partial block */
+    size_t fill;
+} Md5Ctx;
+
+static const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint8_t MD5_S[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+#define HASH_ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define HASH_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define HASH_ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void md5_init(Md5Ctx *ctx) {
+    ctx->h[0] = 0x67452301;
+    ctx->h[1] = 0xefcdab89;
+    ctx->h[2] = 0x98badcfe;
+    ctx->h[3] = 0x10325476;
+    ctx->len = 0;
+    ctx->fill = 0;
+}
+
+static void md5_block(uint32_t h[4], const uint8_t *p) {
+    uint32_t M[16];
+    for (int i = 0; i < 16; i++) {
+        M[i] = (uint32_t)p[i*4] | ((uint32_t)p[i*4 + 1] << 8) |
+               ((uint32_t)p[i*4 + 2] << 16) | ((uint32_t)p[i*4 + 3] << 24);
+    }
+
+    uint32_t A = h[0], B = h[1], C = h[2], D = h[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t F;
+        int g;
+        if (i < 16)      { F = (B & C) | (~B & D); g = i; }
+        else if (i < 32) { F = (D & B) | (~D & C); g = (5 * i + 1) & 15; }
+        else if (i < 48) { F = B ^ C ^ D;          g = (3 * i + 5) & 15; }
+        else             { F = C ^ (B | ~D);       g = (7 * i) & 15; }
+        F += A + MD5_K[i] + M[g];
+        A = D; D = C; C = B;
+        B += HASH_ROTL32(F, MD5_S[i]);
+    }
+    h[0] += A; h[1] += B; h[2] += C; h[3] += D;
+}
+
+static void md5_update(Md5Ctx *ctx, const uint8_t *data, size_t len) {
+    ctx->len += len;
+    if (ctx->fill) {
+        size_t take = 64 - ctx->fill < len ? 64 - ctx->fill : len;
+        memcpy(ctx->buf + ctx->fill, data, take);
+        ctx->fill += take; data += take; len -= take;
+        if (ctx->fill < 64) return;
+        md5_block(ctx->h, ctx->buf);
+        ctx->fill = 0;
+    }
+    for (; len >= 64; data += 64, len -= 64) md5_block(ctx->h, data);
+    memcpy(ctx->buf, data, len);
+    ctx->fill = len;
+}
+
+static void md5_final(Md5Ctx *ctx, uint8_t out[16]) {
+    uint64_t bits = ctx->len * 8;
+    uint8_t pad[72] = {0x80};
+    size_t pad_len = (ctx->fill < 56 ? 56 : 120) - ctx->fill;
+    for (int i = 0; i < 8; i++) pad[pad_len + i] = (uint8_t)(bits >> (8 * i));
+    md5_update(ctx, pad, pad_len + 8);
+    for (int i = 0; i < 4; i++) {
+        out[i*4]     = (uint8_t)ctx->h[i];
+        out[i*4 + 1] = (uint8_t)(ctx->h[i] >> 8);
+        out[i*4 + 2] = (uint8_t)(ctx->h[i] >> 16);
+        out[i*4 + 3] = (uint8_t)(ctx->h[i] >> 24);
+    }
+}
+
+/* ========================================================================== */
+/* SHA-256                                                                    */
+/* ========================================================================== */
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;
+    uint8_t buf[64];
+    size_t fill;
+} Sha256Ctx;
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256_init(Sha256Ctx *ctx) {
+    static const uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->h, H0, sizeof(H0));
+    ctx->len = 0;
+    ctx->fill = 0;
+}
+
+/*
+ * One round with the working variables renamed instead of shifted: the
+ * caller rotates the argument order, so eight rounds need no moves.
+ */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i) do { \
+        uint32_t T1 = (h) + (HASH_ROTR32(e, 6) ^ HASH_ROTR32(e, 11) ^ HASH_ROTR32(e, 25)) + \
+                      (((e) & (f)) ^ (~(e) & (g))) + SHA256_K[i] + W[i]; \
+        (d) += T1; \
+        (h) = T1 + (HASH_ROTR32(a, 2) ^ HASH_ROTR32(a, 13) ^ HASH_ROTR32(a, 22)) + \
+              (((a) & (b)) ^ ((a) & (c)) ^ ((b) & (c))); \
+    } while (0)
+
+static void sha256_block(uint32_t H[8], const uint8_t *p) {
+    uint32_t W[64];
+    for (int i = 0; i < 16; i++) {
+        W[i] = ((uint32_t)p[i*4] << 24) | ((uint32_t)p[i*4 + 1] << 16) |
+               ((uint32_t)p[i*4 + 2] << 8) | (uint32_t)p[i*4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = HASH_ROTR32(W[i-15], 7) ^ HASH_ROTR32(W[i-15], 18) ^ (W[i-15] >> 3);
+        uint32_t s1 = HASH_ROTR32(W[i-2], 17) ^ HASH_ROTR32(W[i-2], 19) ^ (W[i-2] >> 10);
+        W[i] = s1 + W[i-7] + s0 + W[i-16];
+    }
+
+    uint32_t a = H[0], b = H[1], c = H[2], d = H[3];
+    uint32_t e = H[4], f = H[5], g = H[6], h = H[7];
+    for (int i = 0; i < 64; i += 8) {
+        SHA256_ROUND(a, b, c, d, e, f, g, h, i);
+        SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1);
+        SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2);
+        SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3);
+        SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4);
+        SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5);
+        SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6);
+        SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+    H[0] += a; H[1] += b; H[2] += c; H[3] += d;
+    H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+}
+
+static void sha256_update(Sha256Ctx *ctx, const uint8_t *data, size_t len) {
+    ctx->len += len;
+    if (ctx->fill) {
+        size_t take = 64 - ctx->fill < len ? 64 - ctx->fill : len;
+        memcpy(ctx->buf + ctx->fill, data, take);
+        ctx->fill += take; data += take; len -= take;
+        if (ctx->fill < 64) return;
+        sha256_block(ctx->h, ctx->buf);
+        ctx->fill = 0;
+    }
+    for (; len >= 64; data += 64, len -= 64) sha256_block(ctx->h, data);
+    memcpy(ctx->buf, data, len);
+    ctx->fill = len;
+}
+
+static void sha256_final(Sha256Ctx *ctx, uint8_t out[32]) {
+    uint64_t bits = ctx->len * 8;
+    uint8_t pad[72] = {0x80};
+    size_t pad_len = (ctx->fill < 56 ? 56 : 120) - ctx->fill;
+    for (int i = 0; i < 8; i++) pad[pad_len + i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_update(ctx, pad, pad_len + 8);
+    for (int i = 0; i < 8; i++) {
+        out[i*4]     = (uint8_t)(ctx->h[i] >> 24);
+        out[i*4 + 1] = (uint8_t)(ctx->h[i] >> 16);
+        out[i*4 + 2] = (uint8_t)(ctx->h[i] >> 8);
+        out[i*4 + 3] = (uint8_t)ctx->h[i];
+    }
+}
+
+/*
+ * Multi-buffer SHA-256: four independent messages, one block each per
+ * call. State is transposed, H[word][lane], so each word is one vector.
+ */
+#define SHA256_LANES 4
+
+#ifdef __wasm_simd128__
+
+#define SHA256X4_ROTR(x, n) wasm_v128_or(wasm_u32x4_shr(x, n), wasm_i32x4_shl(x, 32 - (n)))
+#define SHA256X4_SIGMA(x, r1, r2, r3) \
+    wasm_v128_xor(wasm_v128_xor(SHA256X4_ROTR(x, r1), SHA256X4_ROTR(x, r2)), SHA256X4_ROTR(x, r3))
+
+/* Ch(e,f,g) = bitselect(f, g, e); Maj(a,b,c) = bitselect(c, b, a ^ b) */
+#define SHA256X4_ROUND(a, b, c, d, e, f, g, h, i) do { \
+        v128_t T1 = wasm_i32x4_add( \
+            wasm_i32x4_add((h), SHA256X4_SIGMA(e, 6, 11, 25)), \
+            wasm_i32x4_add(wasm_v128_bitselect(f, g, e), \
+                           wasm_i32x4_add(wasm_i32x4_splat((int32_t)SHA256_K[i]), W[i]))); \
+        (d) = wasm_i32x4_add((d), T1); \
+        (h) = wasm_i32x4_add(T1, wasm_i32x4_add( \
+            SHA256X4_SIGMA(a, 2, 13, 22), \
+            wasm_v128_bitselect(c, b, wasm_v128_xor(a, b)))); \
+    } while (0)
+
+/* Four big-endian words of a block, byte-swapped into lane order */
+static inline v128_t sha256x4_load_be(const uint8_t *p) {
+    v128_t v = wasm_v128_load(p);
+    return wasm_i8x16_shuffle(v, v, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+}
+
+static void sha256_block_x4(uint32_t H[8][SHA256_LANES], const uint8_t *const p[SHA256_LANES]) {
+    v128_t W[64];
+
+    /* Load words 4k..4k+3 of every block and transpose the 4x4 tile */
+    for (int k = 0; k < 4; k++) {
+        v128_t r0 = sha256x4_load_be(p[0] + 16 * k);
+        v128_t r1 = sha256x4_load_be(p[1] + 16 * k);
+        v128_t r2 = sha256x4_load_be(p[2] + 16 * k);
+        v128_t r3 = sha256x4_load_be(p[3] + 16 * k);
+        v128_t t0 = wasm_i32x4_shuffle(r0, r1, 0, 4, 1, 5);
+        v128_t t1 = wasm_i32x4_shuffle(r0, r1, 2, 6, 3, 7);
+        v128_t t2 = wasm_i32x4_shuffle(r2, r3, 0, 4, 1, 5);
+        v128_t t3 = wasm_i32x4_shuffle(r2, r3, 2, 6, 3, 7);
+        W[4 * k]     = wasm_i64x2_shuffle(t0, t2, 0, 2);
+        W[4 * k + 1] = wasm_i64x2_shuffle(t0, t2, 1, 3);
+        W[4 * k + 2] = wasm_i64x2_shuffle(t1, t3, 0, 2);
+        W[4 * k + 3] = wasm_i64x2_shuffle(t1, t3, 1, 3);
+    }
+    for (int i = 16; i < 64; i++) {
+        v128_t s0 = wasm_v128_xor(wasm_v128_xor(SHA256X4_ROTR(W[i-15], 7), SHA256X4_ROTR(W[i-15], 18)),
+                                  wasm_u32x4_shr(W[i-15], 3));
+        v128_t s1 = wasm_v128_xor(wasm_v128_xor(SHA256X4_ROTR(W[i-2], 17), SHA256X4_ROTR(W[i-2], 19)),
+                                  wasm_u32x4_shr(W[i-2], 10));
+        W[i] = wasm_i32x4_add(wasm_i32x4_add(s1, W[i-7]), wasm_i32x4_add(s0, W[i-16]));
+    }
+
+    v128_t a = wasm_v128_load(H[0]), b = wasm_v128_load(H[1]);
+    v128_t c = wasm_v128_load(H[2]), d = wasm_v128_load(H[3]);
+    v128_t e = wasm_v128_load(H[4]), f = wasm_v128_load(H[5]);
+    v128_t g = wasm_v128_load(H[6]), h = wasm_v128_load(H[7]);
+    for (int i = 0; i < 64; i += 8) {
+        SHA256X4_ROUND(a, b, c, d, e, f, g, h, i);
+        SHA256X4_ROUND(h, a, b, c, d, e, f, g, i + 1);
+        SHA256X4_ROUND(g, h, a, b, c, d, e, f, i + 2);
+        SHA256X4_ROUND(f, g, h, a, b, c, d, e, i + 3);
+        SHA256X4_ROUND(e, f, g, h, a, b, c, d, i + 4);
+        SHA256X4_ROUND(d, e, f, g, h, a, b, c, i + 5);
+        SHA256X4_ROUND(c, d, e, f, g, h, a, b, i + 6);
+        SHA256X4_ROUND(b, c, d, e, f, g, h, a, i + 7);
+    }
+    wasm_v128_store(H[0], wasm_i32x4_add(wasm_v128_load(H[0]), a));
+    wasm_v128_store(H[1], wasm_i32x4_add(wasm_v128_load(H[1]), b));
+    wasm_v128_store(H[2], wasm_i32x4_add(wasm_v128_load(H[2]), c));
+    wasm_v128_store(H[3], wasm_i32x4_add(wasm_v128_load(H[3]), d));
+    wasm_v128_store(H[4], wasm_i32x4_add(wasm_v128_load(H[4]), e));
+    wasm_v128_store(H[5], wasm_i32x4_add(wasm_v128_load(H[5]), f));
+    wasm_v128_store(H[6], wasm_i32x4_add(wasm_v128_load(H[6]), g));
+    wasm_v128_store(H[7], wasm_i32x4_add(wasm_v128_load(H[7]), h));
+}
+
+#endif /* __wasm_simd128__ */
+
+/* Run one lane's block through the scalar rounds */
+static void sha256_block_lane(uint32_t H[8][SHA256_LANES], int lane, const uint8_t *p) {
+    uint32_t h[8];
+    for (int i = 0; i < 8; i++) h[i] = H[i][lane];
+    sha256_block(h, p);
+    for (int i = 0; i < 8; i++) H[i][lane] = h[i];
+}
+
+typedef struct {
+    size_t job;
+    uint64_t len;              /* Message bytes read so far */
+    enum { SHA256_LANE_IDLE, SHA256_LANE_DATA, SHA256_LANE_PAD, SHA256_LANE_LAST } state;
+    uint8_t block[64];
+} Sha256Lane;
+
+/* Load the lane's next block; returns -1 on a read error */
+static int sha256_lane_fill(Sha256Lane *lane, const HashBatchIo *io) {
+    size_t n = 0;
+    if (lane->state == SHA256_LANE_DATA) {
+        long got = io->read(io->user, lane->job, lane->block, 64);
+        if (got < 0) return -1;
+        n = (size_t)got;
+        lane->len += n;
+        if (n == 64) return 0;
+        memset(lane->block + n, 0, 64 - n);
+        lane->block[n] = 0x80;
+        if (n >= 56) {
+            /* No room for the length; it goes in one more block */
+            lane->state = SHA256_LANE_PAD;
+            return 0;
+        }
+    } else {
+        memset(lane->block, 0, 64);
+    }
+    uint64_t bits = lane->len * 8;
+    for (int i = 0; i < 8; i++) lane->block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    lane->state = SHA256_LANE_LAST;
+    return 0;
+}
+
+static void sha256_batch(size_t njobs, const HashBatchIo *io) {
+    static const uint8_t idle_block[64];
+    static const uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    uint32_t H[8][SHA256_LANES];
+    Sha256Lane lanes[SHA256_LANES];
+    size_t next = 0;
+
+    for (int l = 0; l < SHA256_LANES; l++) lanes[l].state = SHA256_LANE_IDLE;
+
+    for (;;) {
+        const uint8_t *blocks[SHA256_LANES];
+        int active = 0, last_active = 0;
+
+        for (int l = 0; l < SHA256_LANES; l++) {
+            Sha256Lane *lane = &lanes[l];
+            for (;;) {
+                if (lane->state == SHA256_LANE_IDLE) {
+                    if (next >= njobs) break;
+                    size_t job = next++;
+                    if (io->open(io->user, job) != 0) {
+                        io->done(io->user, job, NULL);
+                        continue;
+                    }
+                    lane->job = job;
+                    lane->len = 0;
+                    lane->state = SHA256_LANE_DATA;
+                    for (int i = 0; i < 8; i++) H[i][l] = H0[i];
+                }
+                if (sha256_lane_fill(lane, io) == 0) break;
+                io->done(io->user, lane->job, NULL);
+                lane->state = SHA256_LANE_IDLE;
+            }
+            if (lane->state == SHA256_LANE_IDLE) {
+                blocks[l] = idle_block;
+            } else {
+                blocks[l] = lane->block;
+                active++;
+                last_active = l;
+            }
+        }
+        if (active == 0) break;
+
+#ifdef __wasm_simd128__
+        /* A lone long input (the tail of a batch) runs faster without the idle lanes */
+        if (active == 1) sha256_block_lane(H, last_active, blocks[last_active]);
+        else sha256_block_x4(H, blocks);
+#else
+        (void)last_active;
+        for (int l = 0; l < SHA256_LANES; l++) {
+            if (lanes[l].state != SHA256_LANE_IDLE) sha256_block_lane(H, l, blocks[l]);
+        }
+#endif
+
+        for (int l = 0; l < SHA256_LANES; l++) {
+            if (lanes[l].state != SHA256_LANE_LAST) continue;
+            uint8_t digest[32];
+            for (int i = 0; i < 8; i++) {
+                digest[i*4]     = (uint8_t)(H[i][l] >> 24);
+                digest[i*4 + 1] = (uint8_t)(H[i][l] >> 16);
+                digest[i*4 + 2] = (uint8_t)(H[i][l] >> 8);
+                digest[i*4 + 3] = (uint8_t)H[i][l];
+            }
+            lanes[l].state = SHA256_LANE_IDLE;
+            io->done(io->user, lanes[l].job, digest);
+        }
+    }
+}
+
+/* ========================================================================== */
+/* SHA-512                                                                    */
+/* ========================================================================== */
+
+typedef struct {
+    uint64_t h[8];
+    uint64_t len;              /* Bytes; the 128-bit length field's high half is len >> 61 */
+    uint8_t buf[128];
+    size_t fill;
+} Sha512Ctx;
+
+static const uint64_t SHA512_K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static void sha512_init(Sha512Ctx *ctx) {
+    static const uint64_t H0[8] = {
+        0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+        0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+    };
+    memcpy(ctx->h, H0, sizeof(H0));
+    ctx->len = 0;
+    ctx->fill = 0;
+}
+
+static void sha512_block(uint64_t H[8], const uint8_t *p) {
+    uint64_t W[80];
+    for (int i = 0; i < 16; i++) {
+        uint64_t w = 0;
+        for (int j = 0; j < 8; j++) w = (w << 8) | p[i*8 + j];
+        W[i] = w;
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = HASH_ROTR64(W[i-15], 1) ^ HASH_ROTR64(W[i-15], 8) ^ (W[i-15] >> 7);
+        uint64_t s1 = HASH_ROTR64(W[i-2], 19) ^ HASH_ROTR64(W[i-2], 61) ^ (W[i-2] >> 6);
+        W[i] = s1 + W[i-7] + s0 + W[i-16];
+    }
+
+    uint64_t a = H[0], b = H[1], c = H[2], d = H[3];
+    uint64_t e = H[4], f = H[5], g = H[6], h = H[7];
+    for (int i = 0; i < 80; i++) {
+        uint64_t S1 = HASH_ROTR64(e, 14) ^ HASH_ROTR64(e, 18) ^ HASH_ROTR64(e, 41);
+        uint64_t T1 = h + S1 + ((e & f) ^ (~e & g)) + SHA512_K[i] + W[i];
+        uint64_t S0 = HASH_ROTR64(a, 28) ^ HASH_ROTR64(a, 34) ^ HASH_ROTR64(a, 39);
+        uint64_t T2 = S0 + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + T1;
+        d = c; c = b; b = a; a = T1 + T2;
+    }
+    H[0] += a; H[1] += b; H[2] += c; H[3] += d;
+    H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+}
+
+static void sha512_update(Sha512Ctx *ctx, const uint8_t *data, size_t len) {
+    ctx->len += len;
+    if (ctx->fill) {
+        size_t take = 128 - ctx->fill < len ? 128 - ctx->fill : len;
+        memcpy(ctx->buf + ctx->fill, data, take);
+        ctx->fill += take; data += take; len -= take;
+        if (ctx->fill < 128) return;
+        sha512_block(ctx->h, ctx->buf);
+        ctx->fill = 0;
+    }
+    for (; len >= 128; data += 128, len -= 128) sha512_block(ctx->h, data);
+    memcpy(ctx->buf, data, len);
+    ctx->fill = len;
+}
+
+static void sha512_final(Sha512Ctx *ctx, uint8_t out[64]) {
+    uint64_t bits_lo = ctx->len << 3;
+    uint64_t bits_hi = ctx->len >> 61;
+    uint8_t pad[144] = {0x80};
+    size_t pad_len = (ctx->fill < 112 ? 112 : 240) - ctx->fill;
+    for (int i = 0; i < 8; i++) {
+        pad[pad_len + i]     = (uint8_t)(bits_hi >> (56 - 8 * i));
+        pad[pad_len + 8 + i] = (uint8_t)(bits_lo >> (56 - 8 * i));
+    }
+    sha512_update(ctx, pad, pad_len + 16);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) out[i*8 + j] = (uint8_t)(ctx->h[i] >> (56 - 8 * j));
+    }
+}
+
+/* ========================================================================== */
+/* Algorithm descriptor                                                       */
+/* ========================================================================== */
+
+typedef union {
+    Md5Ctx md5;
+    Sha256Ctx sha256;
+    Sha512Ctx sha512;
+} HashCtx;
+
+typedef struct {
+    const char *name;          /* BSD-style tag, e.g. "SHA256" */
+    size_t digest_len;         /* Bytes */
+    size_t block_len;          /* Bytes per compression block */
+    void (*init)(HashCtx *ctx);
+    void (*update)(HashCtx *ctx, const uint8_t *data, size_t len);
+    void (*final)(HashCtx *ctx, uint8_t *out);
+    /* Multi-buffer implementation of hash_batch(), or NULL */
+    void (*batch)(size_t njobs, const HashBatchIo *io);
+} HashAlgo;
+
+static void hash_md5_init(HashCtx *c) { md5_init(&c->md5); }
+static void hash_md5_update(HashCtx *c, const uint8_t *d, size_t n) { md5_update(&c->md5, d, n); }
+static void hash_md5_final(HashCtx *c, uint8_t *out) { md5_final(&c->md5, out); }
+static void hash_sha256_init(HashCtx *c) { sha256_init(&c->sha256); }
+static void hash_sha256_update(HashCtx *c, const uint8_t *d, size_t n) { sha256_update(&c->sha256, d, n); }
+static void hash_sha256_final(HashCtx *c, uint8_t *out) { sha256_final(&c->sha256, out); }
+static void hash_sha512_init(HashCtx *c) { sha512_init(&c->sha512); }
+static void hash_sha512_update(HashCtx *c, const uint8_t *d, size_t n) { sha512_update(&c->sha512, d, n); }
+static void hash_sha512_final(HashCtx *c, uint8_t *out) { sha512_final(&c->sha512, out); }
+
+static const HashAlgo HASH_MD5 = {
+    "MD5", 16, 64, hash_md5_init, hash_md5_update, hash_md5_final, NULL
+};
+static const HashAlgo HASH_SHA256 = {
+    "SHA256", 32, 64, hash_sha256_init, hash_sha256_update, hash_sha256_final, sha256_batch
+};
+static const HashAlgo HASH_SHA512 = {
+    "SHA512", 64, 128, hash_sha512_init, hash_sha512_update, hash_sha512_final, NULL
+};
+
+/**
+ * Hash every job of io, reporting each digest through io->done(). Uses
+ * the algorithm's multi-buffer path when it has one and there is more
+ * than one job; otherwise jobs run one after another.
+ */
+static void hash_batch(const HashAlgo *algo, size_t njobs, const HashBatchIo *io) {
+    static uint8_t chunk[65536];
+
+    if (algo->batch && njobs > 1) {
+        algo->batch(njobs, io);
+        return;
+    }
+    for (size_t job = 0; job < njobs; job++) {
+        if (io->open(io->user, job) != 0) {
+            io->done(io->user, job, NULL);
+            continue;
+        }
+        HashCtx ctx;
+        algo->init(&ctx);
+        long n;
+        do {
+            n = io->read(io->user, job, chunk, sizeof(chunk));
+            if (n > 0) algo->update(&ctx, chunk, (size_t)n);
+        } while (n == (long)sizeof(chunk));
+        if (n < 0) {
+            io->done(io->user, job, NULL);
+            continue;
+        }
+        uint8_t digest[HASH_MAX_DIGEST];
+        algo->final(&ctx, digest);
+        io->done(io->user, job, digest);
+    }
+}
+
+#endif /* HASH_H */
@@ -0,0 +1,524 @@
+/**
+ * Shared command line for md5sum, sha256sum and sha512sum, in GNU
+ * coreutils format.
+ *
+ *   <tool> [OPTION]... [FILE]...
+ *
+ * With no FILE, or when FILE is -, stdin is hashed. Files go through
+ * hash_batch() from hash.h: streamed into incremental contexts, so memory
+ * use does not depend on file size and binary data is hashed byte for
+ * byte, and for SHA-256 several files are hashed at once in SIMD lanes.
+ * Results are always printed in operand order.
+ *
+ * Output, one line per file:
+ *   <hex digest>  <name>        (text mode, the default)
+ *   <hex digest> *<name>        (-b / --binary)
+ *   <ALGO> (<name>) = <hex>     (--tag)
+ * Names containing a backslash or newline are escaped and the line is
+ * prefixed with a backslash.
+ *
+ * Options:
+ *   -c, --check       Read checksum lines from each FILE (or stdin) and
+ *                     verify them; accepts both formats above
+ *   --files FILE      Same as a FILE operand. With --check, names the
+ *                     files the checksum lines refer to (the host makes
+ *                     them available) and is otherwise ignored
+ *   -b, --binary / -t, --text
+ *   --tag
+ *   --quiet           (--check) Don't print OK lines
+ *   --status          (--check) Print nothing; exit status only
+ *   --strict          (--check) Fail on improperly formatted lines
+ *   --records         Hash each NUL-delimited record of stdin instead of
+ *                     files; lines are named by record number (1, 2, ...)
+ *
+ * Exit status: 0 on success, 1 if any file could not be read or, with
+ * --check, did not match.
+ *
+ * Usage in a tool's main():
+ *   return hashsum_main(argc, argv, "sha256sum", &HASH_SHA256);
+ */
+
+#ifndef HASHSUM_H
+#define HASHSUM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "hash.h"
+#include "line_reader.h"
+#include "stdout_write.h"
+
+#define HASHSUM_CHUNK 65536
+
+typedef struct {
+    const char *prog;
+    const HashAlgo *algo;
+    int binary;
+    int tag;
+    int quiet;
+    int status;
+    int strict;
+} HashsumOptions;
+
+static uint8_t hashsum_buf[HASHSUM_CHUNK];
+
+/*
+ * Report a per-file error. Pending stdout is flushed first so errors land
+ * between the result lines they belong to, as with coreutils.
+ */
+static void hashsum_error(const HashsumOptions *opt, const char *path, const char *msg) {
+    out_flush();
+    fprintf(stderr, "%s: %s: %s\n", opt->prog, path, msg);
+}
+
+/**
+ * Hash one file ("-" is stdin). Returns 0 on success; on failure prints
+ * the coreutils-style error and returns -1.
+ */
+static int hashsum_file(const HashsumOptions *opt, const char *path, uint8_t *digest) {
+    int is_stdin = strcmp(path, "-") == 0;
+    FILE *fp = is_stdin ? stdin : fopen(path, "rb");
+    if (!fp) {
+        hashsum_error(opt, path, strerror(errno));
+        return -1;
+    }
+
+    HashCtx ctx;
+    opt->algo->init(&ctx);
+    size_t n;
+    while ((n = fread(hashsum_buf, 1, sizeof(hashsum_buf), fp)) > 0) {
+        opt->algo->update(&ctx, hashsum_buf, n);
+    }
+    int failed = ferror(fp);
+    if (!is_stdin) fclose(fp);
+    if (failed) {
+        hashsum_error(opt, path, "read error");
+        return -1;
+    }
+
+    opt->algo->final(&ctx, digest);
+    return 0;
+}
+
+static int hashsum_needs_escape(const char *name) {
+    return strchr(name, '\\') != NULL || strchr(name, '\n') != NULL;
+}
+
+static void hashsum_out_name(const char *name, int escape) {
+    if (!escape) {
+        out_str(name);
+        return;
+    }
+    for (const char *p = name; *p; p++) {
+        if (*p == '\\') out_str("\\\\");
+        else if (*p == '\n') out_str("\\n");
+        else out_char(*p);
+    }
+}
+
+static void hashsum_print(const HashsumOptions *opt, const char *name, const uint8_t *digest) {
+    int escape = hashsum_needs_escape(name);
+    if (escape) out_char('\\');
+
+    if (opt->tag) {
+        out_str(opt->algo->name);
+        out_str(" (");
+        hashsum_out_name(name, escape);
+        out_str(") = ");
+        for (size_t i = 0; i < opt->algo->digest_len; i++) out_hex_byte(digest[i]);
+    } else {
+        for (size_t i = 0; i < opt->algo->digest_len; i++) out_hex_byte(digest[i]);
+        out_char(' ');
+        out_char(opt->binary ? '*' : ' ');
+        hashsum_out_name(name, escape);
+    }
+    out_char('\n');
+}
+
+static int hashsum_hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/** Decode exactly digest_len bytes of hex; returns 0 on success. */
+static int hashsum_parse_hex(const char *hex, size_t hex_len, size_t digest_len, uint8_t *out) {
+    if (hex_len != digest_len * 2) return -1;
+    for (size_t i = 0; i < digest_len; i++) {
+        int hi = hashsum_hex_value(hex[2 * i]);
+        int lo = hashsum_hex_value(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return -1;
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+/** Undo hashsum_out_name() escaping in place. Returns 0 on success. */
+static int hashsum_unescape(char *name) {
+    char *w = name;
+    for (char *r = name; *r; r++) {
+        if (*r != '\\') { *w++ = *r; continue; }
+        r++;
+        if (*r == '\\') *w++ = '\\';
+        else if (*r == 'n') *w++ = '\n';
+        else return -1;
+    }
+    *w = '\0';
+    return 0;
+}
+
+/**
+ * Parse one checksum line (either output format) in place.
+ * Returns 0 and sets *name / expected on success.
+ */
+static int hashsum_parse_line(const HashsumOptions *opt, char *line, size_t len,
+                              char **name, uint8_t *expected) {
+    if (len > 0 && line[len - 1] == '\r') line[--len] = '\0';
+
+    int escaped = 0;
+    if (line[0] == '\\') { escaped = 1; line++; len--; }
+
+    size_t tag_len = strlen(opt->algo->name);
+    if (len > tag_len + 2 && strncmp(line, opt->algo->name, tag_len) == 0 &&
+        line[tag_len] == ' ' && line[tag_len + 1] == '(') {
+        /* <ALGO> (<name>) = <hex>; the name may itself contain ") = " */
+        char *sep = NULL;
+        for (char *p = line + len - 1; p > line + tag_len + 1; p--) {
+            if (p[0] == ')' && strncmp(p, ") = ", 4) == 0) { sep = p; break; }
+        }
+        if (!sep) return -1;
+        char *hex = sep + 4;
+        if (hashsum_parse_hex(hex, (size_t)(line + len - hex), opt->algo->digest_len, expected) != 0) return -1;
+        *sep = '\0';
+        *name = line + tag_len + 2;
+    } else {
+        /* <hex>  <name> or <hex> *<name> */
+        size_t hex_len = opt->algo->digest_len * 2;
+        if (len < hex_len + 3 || line[hex_len] != ' ' ||
+            (line[hex_len + 1] != ' ' && line[hex_len + 1] != '*')) return -1;
+        if (hashsum_parse_hex(line, hex_len, opt->algo->digest_len, expected) != 0) return -1;
+        *name = line + hex_len + 2;
+    }
+
+    if (escaped && hashsum_unescape(*name) != 0) return -1;
+    return **name ? 0 : -1;
+}
+
+static void hashsum_warn_count(const HashsumOptions *opt, size_t n, const char *one, const char *many) {
+    if (n == 0 || opt->status) return;
+    out_flush();
+    fprintf(stderr, "%s: WARNING: %zu %s\n", opt->prog, n, n == 1 ? one : many);
+}
+
+/** Verify the checksum lines in one list ("-" is stdin). Returns 0 if all passed. */
+static int hashsum_check_list(const HashsumOptions *opt, const char *list) {
+    int is_stdin = strcmp(list, "-") == 0;
+    FILE *fp = is_stdin ? stdin : fopen(list, "rb");
+    if (!fp) {
+        hashsum_error(opt, list, strerror(errno));
+        return 1;
+    }
+
+    LineReader reader;
+    line_reader_init_file(&reader, fp);
+
+    size_t properly_formatted = 0, improperly_formatted = 0;
+    size_t unreadable = 0, mismatched = 0;
+    uint8_t expected[HASH_MAX_DIGEST], actual[HASH_MAX_DIGEST];
+    char *line;
+    size_t len;
+
+    while (line_reader_next(&reader, &line, &len)) {
+        char *name;
+        if (hashsum_parse_line(opt, line, len, &name, expected) != 0) {
+            improperly_formatted++;
+            continue;
+        }
+        properly_formatted++;
+
+        /* Result lines only escape names that would break the line */
+        int escape = strchr(name, '\n') != NULL;
+        if (hashsum_file(opt, name, actual) != 0) {
+            unreadable++;
+            if (!opt->status) {
+                out_str(escape ? "\\" : "");
+                hashsum_out_name(name, escape);
+                out_str(": FAILED open or read\n");
+            }
+            continue;
+        }
+
+        int ok = memcmp(expected, actual, opt->algo->digest_len) == 0;
+        if (!ok) mismatched++;
+        if (!opt->status && (!ok || !opt->quiet)) {
+            out_str(escape ? "\\" : "");
+            hashsum_out_name(name, escape);
+            out_str(ok ? ": OK\n" : ": FAILED\n");
+        }
+    }
+
+    int read_error = reader.error;
+    line_reader_free(&reader);
+    if (!is_stdin) fclose(fp);
+    out_flush();
+
+    if (read_error) {
+        hashsum_error(opt, list, "out of memory");
+        return 1;
+    }
+    if (properly_formatted == 0) {
+        hashsum_error(opt, is_stdin ? "'standard input'" : list,
+                      "no properly formatted checksum lines found");
+        return 1;
+    }
+
+    hashsum_warn_count(opt, improperly_formatted, "line is improperly formatted", "lines are improperly formatted");
+    hashsum_warn_count(opt, unreadable, "listed file could not be read", "listed files could not be read");
+    hashsum_warn_count(opt, mismatched, "computed checksum did NOT match", "computed checksums did NOT match");
+
+    return (unreadable || mismatched || (opt->strict && improperly_formatted)) ? 1 : 0;
+}
+
+/* ========================================================================== */
+/* Hash mode: files or records through hash_batch()                         */
+/* ========================================================================== */
+
+typedef struct {
+    const char *path;          /* File operand, or NULL for a record */
+    FILE *fp;                  /* While open */
+    const uint8_t *data;       /* Record bytes */
+    size_t len, pos;
+    int error;                 /* errno from open, or -1 for a read error */
+    int finished;
+    uint8_t digest[HASH_MAX_DIGEST];
+} HashsumJob;
+
+typedef struct {
+    const HashsumOptions *opt;
+    HashsumJob *jobs;
+    size_t njobs;
+    size_t emitted;            /* Jobs before this one have been printed */
+    int status;
+} HashsumBatch;
+
+static int hashsum_job_open(void *user, size_t job) {
+    HashsumJob *j = &((HashsumBatch *)user)->jobs[job];
+    if (!j->path) return 0;
+    j->fp = strcmp(j->path, "-") == 0 ? stdin : fopen(j->path, "rb");
+    if (!j->fp) {
+        j->error = errno;
+        return -1;
+    }
+    return 0;
+}
+
+static long hashsum_job_read(void *user, size_t job, uint8_t *buf, size_t cap) {
+    HashsumJob *j = &((HashsumBatch *)user)->jobs[job];
+    if (!j->path) {
+        size_t n = j->len - j->pos < cap ? j->len - j->pos : cap;
+        memcpy(buf, j->data + j->pos, n);
+        j->pos += n;
+        return (long)n;
+    }
+    size_t n = fread(buf, 1, cap, j->fp);
+    if (ferror(j->fp)) {
+        j->error = -1;
+        return -1;
+    }
+    return (long)n;
+}
+
+/* Print finished jobs in input order; lanes may finish out of order */
+static void hashsum_job_done(void *user, size_t job, const uint8_t *digest) {
+    HashsumBatch *batch = (HashsumBatch *)user;
+    HashsumJob *j = &batch->jobs[job];
+    if (j->fp && j->fp != stdin) fclose(j->fp);
+    j->fp = NULL;
+    if (digest) memcpy(j->digest, digest, batch->opt->algo->digest_len);
+    j->finished = 1;
+
+    for (; batch->emitted < batch->njobs && batch->jobs[batch->emitted].finished; batch->emitted++) {
+        HashsumJob *e = &batch->jobs[batch->emitted];
+        char record_name[24];
+        const char *name = e->path;
+        if (!name) {
+            snprintf(record_name, sizeof(record_name), "%zu", batch->emitted + 1);
+            name = record_name;
+        }
+        if (e->error) {
+            hashsum_error(batch->opt, name, e->error > 0 ? strerror(e->error) : "read error");
+            batch->status = 1;
+        } else {
+            hashsum_print(batch->opt, name, e->digest);
+        }
+    }
+}
+
+static int hashsum_run(const HashsumOptions *opt, HashsumJob *jobs, size_t njobs) {
+    HashsumBatch batch = { opt, jobs, njobs, 0, 0 };
+    HashBatchIo io = { &batch, hashsum_job_open, hashsum_job_read, hashsum_job_done };
+    hash_batch(opt->algo, njobs, &io);
+    return batch.status;
+}
+
+/** Hash each operand; files are interleaved across lanes where possible. */
+static int hashsum_files(const HashsumOptions *opt, const char **paths, int npaths) {
+    HashsumJob *jobs = (HashsumJob *)calloc((size_t)npaths, sizeof(HashsumJob));
+    if (!jobs) {
+        hashsum_error(opt, paths[0], "out of memory");
+        return 1;
+    }
+    int stdin_operands = 0;
+    for (int i = 0; i < npaths; i++) {
+        jobs[i].path = paths[i];
+        stdin_operands += strcmp(paths[i], "-") == 0;
+    }
+
+    int status;
+    if (stdin_operands > 1) {
+        /* Repeated "-" must read stdin in turn, not from two lanes at once */
+        status = 0;
+        for (int i = 0; i < npaths; i++) status |= hashsum_run(opt, &jobs[i], 1);
+    } else {
+        status = hashsum_run(opt, jobs, (size_t)npaths);
+    }
+    free(jobs);
+    return status;
+}
+
+/**
+ * --records: hash each NUL-terminated record of stdin (the last record
+ * need not be terminated). Records are named by their 1-based number.
+ */
+static int hashsum_records(const HashsumOptions *opt) {
+    size_t cap = HASHSUM_CHUNK, len = 0, n;
+    uint8_t *data = (uint8_t *)malloc(cap);
+    while (data && (n = fread(data + len, 1, cap - len, stdin)) > 0) {
+        len += n;
+        if (len == cap) {
+            uint8_t *grown = (uint8_t *)realloc(data, cap * 2);
+            if (!grown) { free(data); data = NULL; break; }
+            data = grown;
+            cap *= 2;
+        }
+    }
+    if (!data || ferror(stdin)) {
+        hashsum_error(opt, "-", data ? "read error" : "out of memory");
+        free(data);
+        return 1;
+    }
+
+    size_t njobs = 0;
+    for (size_t i = 0; i < len; i++) njobs += data[i] == '\0';
+    if (len > 0 && data[len - 1] != '\0') njobs++;
+
+    HashsumJob *jobs = (HashsumJob *)calloc(njobs ? njobs : 1, sizeof(HashsumJob));
+    if (!jobs) {
+        hashsum_error(opt, "-", "out of memory");
+        free(data);
+        return 1;
+    }
+    size_t start = 0, job = 0;
+    for (size_t i = 0; i <= len && job < njobs; i++) {
+        if (i < len && data[i] != '\0') continue;
+        jobs[job].data = data + start;
+        jobs[job++].len = i - start;
+        start = i + 1;
+    }
+
+    int status = hashsum_run(opt, jobs, njobs);
+    free(jobs);
+    free(data);
+    return status;
+}
+
+static void hashsum_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [OPTION]... [FILE]...\n"
+            "Print or check checksums. With no FILE, or when FILE is -, read stdin.\n"
+            "  -c, --check   read checksums from the FILEs and check them\n"
+            "  -b, --binary  mark output lines with '*'\n"
+            "      --tag     create a BSD-style checksum\n"
+            "      --quiet   (check) don't print OK for each verified file\n"
+            "      --status  (check) don't output anything, status code shows success\n"
+            "      --strict  (check) exit non-zero for improperly formatted lines\n"
+            "      --records hash each NUL-delimited record of stdin, named by number\n",
+            prog);
+}
+
+static int hashsum_main(int argc, char **argv, const char *prog, const HashAlgo *algo) {
+    HashsumOptions opt = { prog, algo, 0, 0, 0, 0, 0 };
+    int check = 0;
+    int records = 0;
+
+    /* Operands (bare and --files) in order; --files are tagged so
+       --check can tell lists from the files the lists refer to */
+    const char **paths = (const char **)malloc(sizeof(char *) * (size_t)(argc > 1 ? argc : 1));
+    int *from_files = (int *)malloc(sizeof(int) * (size_t)(argc > 1 ? argc : 1));
+    if (!paths || !from_files) {
+        fprintf(stderr, "%s: out of memory\n", prog);
+        return 1;
+    }
+    int npaths = 0;
+    int options_done = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!options_done && arg[0] == '-' && arg[1] != '\0') {
+            if (strcmp(arg, "--") == 0) options_done = 1;
+            else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--check") == 0) check = 1;
+            else if (strcmp(arg, "-b") == 0 || strcmp(arg, "--binary") == 0) opt.binary = 1;
+            else if (strcmp(arg, "-t") == 0 || strcmp(arg, "--text") == 0) opt.binary = 0;
+            else if (strcmp(arg, "--tag") == 0) opt.tag = 1;
+            else if (strcmp(arg, "--quiet") == 0) opt.quiet = 1;
+            else if (strcmp(arg, "--status") == 0) opt.status = 1;
+            else if (strcmp(arg, "--strict") == 0) opt.strict = 1;
+            else if (strcmp(arg, "--records") == 0) records = 1;
+            else if (strcmp(arg, "--files") == 0 && i + 1 < argc) {
+                paths[npaths] = argv[++i];
+                from_files[npaths++] = 1;
+            } else {
+                fprintf(stderr, "%s: unrecognized option '%s'\n", prog, arg);
+                hashsum_usage(prog);
+                free(paths);
+                free(from_files);
+                return 1;
+            }
+            continue;
+        }
+        paths[npaths] = arg;
+        from_files[npaths++] = 0;
+    }
+
+    int status = 0;
+    if (records) {
+        if (check || npaths > 0) {
+            fprintf(stderr, "%s: --records hashes stdin and takes no FILE or --check\n", prog);
+            status = 1;
+        } else {
+            status = hashsum_records(&opt);
+        }
+    } else if (check) {
+        int lists = 0;
+        for (int i = 0; i < npaths; i++) {
+            if (from_files[i]) continue;
+            lists++;
+            status |= hashsum_check_list(&opt, paths[i]);
+        }
+        if (lists == 0) status = hashsum_check_list(&opt, "-");
+    } else {
+        if (npaths == 0) {
+            paths[npaths++] = "-";
+        }
+        status = hashsum_files(&opt, paths, npaths);
+    }
+
+    out_flush();
+    free(paths);
+    free(from_files);
+    return status;
+}
+
+#endif /* HASHSUM_H */
@@ -6,7 +6,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include "../line_reader.h"
+#include "../stdout_write.h"
 
 int main(int argc, char **argv) {
     int num_lines = 10;  // Default
@@ -20,24 +21,29 @@ int main(int argc, char **argv) {
         }
     }
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) { fprintf(stderr, "Usage: head [-n NUM] <text>\nOr pipe input via stdin.\n"); return 1; }
-        input = stdin_buf;
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, "Usage: head [-n NUM] <text>\nOr pipe input via stdin.\n");
+            line_reader_free(&reader);
+            return 1;
+        }
     }
 
+    // Stop reading as soon as enough lines have been emitted
     int lines = 0;
-    for (const char *p = input; *p && lines < num_lines; p++) {
-        putchar(*p);
-        if (*p == '\n') lines++;
-    }
-
-    // Add newline if input doesn't end with one
-    if (input[0] && input[strlen(input)-1] != '\n' && lines < num_lines) {
-        putchar('\n');
+    char *line;
+    size_t len;
+    while (lines < num_lines && line_reader_next(&reader, &line, &len)) {
+        out_write(line, len);
+        out_char('\n');
+        lines++;
     }
 
-    free(stdin_buf);
+    line_reader_free(&reader);
+    out_flush();
     return 0;
 }
@@ -1,80 +1,52 @@
 /**
  * jwt - Encode/decode JWT tokens (without signature verification)
- * Usage: jwt <encode|decode> <payload|token>
+ * Usage: jwt [encode|decode] <payload|token>   (decode is the default)
  * Note: This tool does NOT verify signatures - for inspection only
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../base64.h"
 #include "../stdin_read.h"
 
-// Base64URL alphabet
-static const char b64url_table[] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
-
-// Base64URL encode
-void base64url_encode(const unsigned char *data, size_t len, char *output) {
-    size_t i, j = 0;
-
-    for (i = 0; i < len; i += 3) {
-        unsigned char b0 = data[i];
-        unsigned char b1 = (i + 1 < len) ? data[i + 1] : 0;
-        unsigned char b2 = (i + 2 < len) ? data[i + 2] : 0;
-
-        output[j++] = b64url_table[b0 >> 2];
-        output[j++] = b64url_table[((b0 & 0x03) << 4) | (b1 >> 4)];
-        if (i + 1 < len) {
-            output[j++] = b64url_table[((b1 & 0x0f) << 2) | (b2 >> 6)];
-        }
-        if (i + 2 < len) {
-            output[j++] = b64url_table[b2 & 0x3f];
-        }
+/*
+ * Decode one base64url segment into a new NUL-terminated buffer.
+ * Returns NULL if the segment is not valid base64url.
+ */
+static unsigned char *decode_segment(const char *segment, size_t *out_len) {
+    size_t len = strlen(segment);
+    unsigned char *out = malloc(b64_decode_bound(len) + 1);
+    if (!out) return NULL;
+
+    B64Decoder dec;
+    b64_decoder_init(&dec, &B64_URL, 0);
+    size_t n = b64_decode_update(&dec, segment, len, out);
+    n += b64_decode_final(&dec, out + n);
+    if (dec.error) {
+        free(out);
+        return NULL;
     }
-    output[j] = '\0';
-}
-
-// Base64URL decode character
-int b64url_decode_char(char c) {
-    if (c >= 'A' && c <= 'Z') return c - 'A';
-    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
-    if (c >= '0' && c <= '9') return c - '0' + 52;
-    if (c == '-') return 62;
-    if (c == '_') return 63;
-    return -1;
+    out[n] = '\0';
+    *out_len = n;
+    return out;
 }
 
-// Base64URL decode
-size_t base64url_decode(const char *input, unsigned char *output) {
-    size_t len = strlen(input);
-    size_t i, j = 0;
-
-    for (i = 0; i < len; i += 4) {
-        int b0 = b64url_decode_char(input[i]);
-        int b1 = (i + 1 < len) ? b64url_decode_char(input[i + 1]) : 0;
-        int b2 = (i + 2 < len) ? b64url_decode_char(input[i + 2]) : 0;
-        int b3 = (i + 3 < len) ? b64url_decode_char(input[i + 3]) : 0;
-
-        if (b0 < 0 || b1 < 0) break;
-
-        output[j++] = (b0 << 2) | (b1 >> 4);
-
-        if (i + 2 < len && b2 >= 0) {
-            output[j++] = ((b1 & 0x0f) << 4) | (b2 >> 2);
-
-            if (i + 3 < len && b3 >= 0) {
-                output[j++] = ((b2 & 0x03) << 6) | b3;
-            }
-        }
-    }
-
-    output[j] = '\0';
-    return j;
+/* Encode as unpadded base64url, as JWT segments are */
+static char *encode_segment(const char *data) {
+    size_t len = strlen(data);
+    char *out = malloc(b64_encoded_len(len, 0) + 1);
+    if (!out) return NULL;
+    out[b64_encode(&B64_URL, (const unsigned char *)data, len, out, 0)] = '\0';
+    return out;
 }
 
 // Decode JWT
-void decode_jwt(const char *token) {
+static int decode_jwt(const char *token) {
     char *token_copy = strdup(token);
+    /* Piped tokens usually end in a newline */
+    size_t end = strlen(token_copy);
+    while (end > 0 && strchr(" \t\r\n", token_copy[end - 1])) token_copy[--end] = '\0';
     char *header_b64 = strtok(token_copy, ".");
     char *payload_b64 = strtok(NULL, ".");
     char *signature_b64 = strtok(NULL, ".");
@@ -82,44 +54,62 @@ void decode_jwt(const char *token) {
     if (!header_b64 || !payload_b64) {
         fprintf(stderr, "Error: Invalid JWT format\n");
         free(token_copy);
-        return;
+        return 1;
     }
 
-    unsigned char header[4096];
-    unsigned char payload[4096];
-
-    base64url_decode(header_b64, header);
-    base64url_decode(payload_b64, payload);
+    size_t header_len, payload_len;
+    unsigned char *header = decode_segment(header_b64, &header_len);
+    unsigned char *payload = header ? decode_segment(payload_b64, &payload_len) : NULL;
+    if (!header || !payload) {
+        fprintf(stderr, "Error: Invalid base64url in JWT %s\n", header ? "payload" : "header");
+        free(header);
+        free(token_copy);
+        return 1;
+    }
 
     printf("=== JWT Decoded ===\n\n");
-    printf("Header:\n%s\n\n", header);
-    printf("Payload:\n%s\n\n", payload);
+    printf("Header:\n");
+    fwrite(header, 1, header_len, stdout);
+    printf("\n\nPayload:\n");
+    fwrite(payload, 1, payload_len, stdout);
+    printf("\n\n");
 
     if (signature_b64) {
         printf("Signature: %s\n", signature_b64);
         printf("\nNote: Signature NOT verified. Use this for inspection only.\n");
     }
 
+    free(header);
+    free(payload);
     free(token_copy);
+    return 0;
 }
 
 // Encode JWT (unsigned - for testing only)
-void encode_jwt(const char *payload) {
+static int encode_jwt(const char *payload) {
     // Default header for unsigned token
     const char *header = "{\"alg\":\"none\",\"typ\":\"JWT\"}";
 
-    char header_b64[1024];
-    char payload_b64[8192];
-
-    base64url_encode((const unsigned char *)header, strlen(header), header_b64);
-    base64url_encode((const unsigned char *)payload, strlen(payload), payload_b64);
+    char *header_b64 = encode_segment(header);
+    char *payload_b64 = encode_segment(payload);
+    if (!header_b64 || !payload_b64) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(header_b64);
+        free(payload_b64);
+        return 1;
+    }
 
     printf("%s.%s.\n", header_b64, payload_b64);
     printf("\nWarning: This is an unsigned JWT (alg: none). Do NOT use in production.\n");
+    free(header_b64);
+    free(payload_b64);
+    return 0;
 }
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
+    /* With no command the token is decoded from stdin (how the host runs it) */
+    const char *cmd = argc >= 2 ? argv[1] : "decode";
+    if (argc >= 2 && strcmp(cmd, "decode") != 0 && strcmp(cmd, "encode") != 0) {
         fprintf(stderr, "Usage: jwt <encode|decode> [payload|token]\n");
         fprintf(stderr, "\nCommands:\n");
         fprintf(stderr, "  decode <token>    Decode and display JWT parts\n");
@@ -128,7 +118,6 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    const char *cmd = argv[1];
     const char *data = (argc >= 3) ? argv[2] : NULL;
     char *stdin_buf = NULL;
     if (!data) {
@@ -137,16 +126,8 @@ int main(int argc, char **argv) {
         data = stdin_buf;
     }
 
-    if (strcmp(cmd, "decode") == 0) {
-        decode_jwt(data);
-    } else if (strcmp(cmd, "encode") == 0) {
-        encode_jwt(data);
-    } else {
-        fprintf(stderr, "Error: Unknown command '%s'\n", cmd);
-        free(stdin_buf);
-        return 1;
-    }
+    int status = strcmp(cmd, "decode") == 0 ? decode_jwt(data) : encode_jwt(data);
 
     free(stdin_buf);
-    return 0;
+    return status;
 }
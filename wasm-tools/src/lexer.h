@@ -0,0 +1,840 @@
+/**
+ * Single-pass tokenizers for JavaScript, CSS and HTML, shared by the
+ * minifiers (minify, terser, csso, html-minifier).
+ *
+ * Each lexer walks its buffer once, front to back, and hands out tokens
+ * as spans into that buffer: nothing is copied and, apart from the JS
+ * bracket stack, nothing is allocated. Whitespace is not a token; the
+ * token after it is flagged instead (ws_before, and nl_before when a line
+ * break was crossed, which is what JS semicolon insertion depends on).
+ * Comments are tokens, so a caller can keep licence comments or treat
+ * them as whitespace.
+ *
+ * JavaScript: a '/' is told apart as regex or division from the previous
+ * token (a regex can follow an operator, "(", "," or keyword such as
+ * "return", not an operand), and a ")" or "}" by what opened it: "if (..)"
+ * and a statement block end where an expression may start, a call or an
+ * object literal end an operand. Template literals are split at each
+ * "${" / "}" so the expressions inside are ordinary tokens.
+ *
+ * CSS: CSS Syntax Level 3 tokens, with unquoted url(...) as one token.
+ *
+ * HTML: text, comments, declarations and tags. The contents of script,
+ * style, textarea and title come back as one HTML_RAW token, so markup
+ * inside them is never mistaken for tags.
+ *
+ * Usage:
+ *   JsLexer lx;
+ *   Token t;
+ *   js_lexer_init(&lx, src, len);
+ *   while (js_next(&lx, &t)) {
+ *       ... t.type, t.ptr, t.len ...
+ *   }
+ *   if (lx.error) { ... out of memory ... }
+ *   js_lexer_free(&lx);
+ */
+
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef struct {
+    int type;
+    const char *ptr;
+    size_t len;
+    int ws_before;      /* Whitespace separates it from the previous token */
+    int nl_before;      /* ... and that whitespace holds a line break */
+} Token;
+
+static int lex_has_prefix_nocase(const char *s, size_t n, const char *prefix) {
+    size_t len = strlen(prefix);
+    if (n < len) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)s[i]) != prefix[i]) return 0;
+    }
+    return 1;
+}
+
+static int lex_token_is(const Token *t, const char *text) {
+    size_t len = strlen(text);
+    return t->len == len && memcmp(t->ptr, text, len) == 0;
+}
+
+/* ---- JavaScript ---- */
+
+enum {
+    JS_EOF,
+    JS_IDENT,           /* Identifiers, keywords and #private names */
+    JS_NUMBER,
+    JS_STRING,
+    JS_TEMPLATE,        /* `...` with no substitutions */
+    JS_TEMPLATE_HEAD,   /* `...${ */
+    JS_TEMPLATE_MIDDLE, /* }...${ */
+    JS_TEMPLATE_TAIL,   /* }...` */
+    JS_REGEX,
+    JS_PUNCT,
+    JS_COMMENT          /* Block, line or #! comment, delimiters included */
+};
+
+/* What a bracket on the JS stack was opened by */
+enum {
+    JS_OPEN_PAREN = '(',
+    JS_OPEN_CONTROL = 'c',  /* The head of if / while / for / with */
+    JS_OPEN_BRACKET = '[',
+    JS_OPEN_BLOCK = '{',
+    JS_OPEN_OBJECT = 'o',
+    JS_OPEN_SUBST = '$'     /* ${ in a template literal */
+};
+
+typedef struct {
+    const char *s;
+    size_t n, pos;
+    int regex_ok;           /* A '/' here starts a regex */
+    int prev_type;          /* Last token other than a comment */
+    const char *prev_ptr;
+    size_t prev_len;
+    unsigned char *stack;
+    size_t depth, cap;
+    int error;              /* Allocation failure */
+} JsLexer;
+
+static void js_lexer_init(JsLexer *lx, const char *s, size_t n) {
+    memset(lx, 0, sizeof(*lx));
+    lx->s = s;
+    lx->n = n;
+    lx->regex_ok = 1;
+}
+
+static void js_lexer_free(JsLexer *lx) {
+    free(lx->stack);
+    lx->stack = NULL;
+}
+
+static int js_ident_char(unsigned char c) {
+    return isalnum(c) || c == '_' || c == '$' || c == '\\' || c >= 0x80;
+}
+
+/*
+ * Length of the whitespace or line terminator at s[pos], or 0. Covers the
+ * non-ASCII spaces JS allows (NBSP, BOM, the U+2000 block, ...) and the
+ * U+2028 / U+2029 line separators.
+ */
+static size_t js_space_at(const char *s, size_t n, size_t pos, int *newline) {
+    const unsigned char *u = (const unsigned char *)s + pos;
+    size_t left = n - pos;
+    *newline = 0;
+    switch (u[0]) {
+        case '\n': case '\r':
+            *newline = 1;
+            return 1;
+        case ' ': case '\t': case '\v': case '\f':
+            return 1;
+        case 0xC2:
+            return left >= 2 && u[1] == 0xA0 ? 2 : 0;
+        case 0xE1:
+            return left >= 3 && u[1] == 0x9A && u[2] == 0x80 ? 3 : 0;
+        case 0xE2:
+            if (left < 3) return 0;
+            if (u[1] == 0x80 && (u[2] == 0xA8 || u[2] == 0xA9)) {
+                *newline = 1;
+                return 3;
+            }
+            return (u[1] == 0x80 && (u[2] <= 0x8A || u[2] == 0xAF)) || (u[1] == 0x81 && u[2] == 0x9F) ? 3 : 0;
+        case 0xE3:
+            return left >= 3 && u[1] == 0x80 && u[2] == 0x80 ? 3 : 0;
+        case 0xEF:
+            return left >= 3 && u[1] == 0xBB && u[2] == 0xBF ? 3 : 0;
+        default:
+            return 0;
+    }
+}
+
+static int js_word_in(const char *p, size_t len, const char *const *words) {
+    for (; *words; words++) {
+        if (strlen(*words) == len && memcmp(p, *words, len) == 0) return 1;
+    }
+    return 0;
+}
+
+/* Is the previous token the given punctuator or word? */
+static int js_prev_is(const JsLexer *lx, const char *text) {
+    size_t len = strlen(text);
+    return lx->prev_len == len && memcmp(lx->prev_ptr, text, len) == 0;
+}
+
+static int js_prev_is_one_of(const JsLexer *lx, const char *const *words) {
+    return js_word_in(lx->prev_ptr, lx->prev_len, words);
+}
+
+/* Keywords after which an expression, and so a regex, may start */
+static const char *const js_regex_keywords[] = {
+    "return", "typeof", "instanceof", "in", "of", "new", "delete", "void", "throw",
+    "case", "do", "else", "yield", "await", NULL
+};
+
+static const char *const js_control_keywords[] = {"if", "while", "for", "with", NULL};
+
+/* Keywords after which "{" opens a block */
+static const char *const js_block_keywords[] = {"do", "else", "try", "finally", NULL};
+
+/* The previous token is a word used as a keyword, not a property name after "." */
+static int js_prev_keyword(const JsLexer *lx, const char *const *words, int after_dot) {
+    return lx->prev_type == JS_IDENT && !after_dot && js_prev_is_one_of(lx, words);
+}
+
+static int js_push(JsLexer *lx, unsigned char kind) {
+    if (lx->depth == lx->cap) {
+        size_t cap = lx->cap ? lx->cap * 2 : 64;
+        unsigned char *tmp = (unsigned char *)realloc(lx->stack, cap);
+        if (!tmp) {
+            lx->error = 1;
+            return 0;
+        }
+        lx->stack = tmp;
+        lx->cap = cap;
+    }
+    lx->stack[lx->depth++] = kind;
+    return 1;
+}
+
+static int js_pop(JsLexer *lx) {
+    return lx->depth ? lx->stack[--lx->depth] : 0;
+}
+
+/* Scan template characters from pos to the closing '`' or the next "${" */
+static int js_scan_template(JsLexer *lx, size_t *pos, int head) {
+    const char *s = lx->s;
+    size_t i = *pos, n = lx->n;
+    while (i < n) {
+        char c = s[i];
+        if (c == '\\') {
+            i += 2;
+        } else if (c == '`') {
+            *pos = i + 1;
+            return head ? JS_TEMPLATE : JS_TEMPLATE_TAIL;
+        } else if (c == '$' && i + 1 < n && s[i + 1] == '{') {
+            *pos = i + 2;
+            js_push(lx, JS_OPEN_SUBST);
+            return head ? JS_TEMPLATE_HEAD : JS_TEMPLATE_MIDDLE;
+        } else {
+            i++;
+        }
+    }
+    *pos = n;   /* Unterminated: the rest of the input */
+    return head ? JS_TEMPLATE : JS_TEMPLATE_TAIL;
+}
+
+/* End of the regex literal starting at s[pos] == '/', or 0 if it is not one */
+static size_t js_scan_regex(const JsLexer *lx, size_t pos) {
+    const char *s = lx->s;
+    size_t i = pos + 1, n = lx->n;
+    int in_class = 0;
+    while (i < n) {
+        char c = s[i];
+        if (c == '\n' || c == '\r') return 0;
+        if (c == '\\') {
+            i += 2;
+            continue;
+        }
+        if (c == '[') in_class = 1;
+        else if (c == ']') in_class = 0;
+        else if (c == '/' && !in_class) break;
+        i++;
+    }
+    if (i >= n) return 0;
+    i++;
+    while (i < n && js_ident_char((unsigned char)s[i]) && s[i] != '\\') i++;
+    return i;
+}
+
+static size_t js_scan_number(const char *s, size_t n, size_t i) {
+    if (s[i] == '0' && i + 1 < n && s[i + 1] && strchr("xXbBoO", s[i + 1])) {
+        i += 2;
+        while (i < n && (isxdigit((unsigned char)s[i]) || s[i] == '_')) i++;
+    } else {
+        while (i < n && (isdigit((unsigned char)s[i]) || s[i] == '_')) i++;
+        if (i < n && s[i] == '.') {
+            i++;
+            while (i < n && (isdigit((unsigned char)s[i]) || s[i] == '_')) i++;
+        }
+        if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+            size_t j = i + 1;
+            if (j < n && (s[j] == '+' || s[j] == '-')) j++;
+            if (j < n && isdigit((unsigned char)s[j])) {
+                i = j;
+                while (i < n && (isdigit((unsigned char)s[i]) || s[i] == '_')) i++;
+            }
+        }
+    }
+    if (i < n && s[i] == 'n') i++;
+    return i;
+}
+
+static size_t js_scan_string(const char *s, size_t n, size_t i) {
+    char quote = s[i++];
+    while (i < n) {
+        char c = s[i];
+        if (c == '\\') {
+            i += (i + 2 < n && s[i + 1] == '\r' && s[i + 2] == '\n') ? 3 : 2;
+        } else if (c == quote) {
+            return i + 1;
+        } else if (c == '\n' || c == '\r') {
+            return i;   /* Unterminated: stop at the line end */
+        } else {
+            i++;
+        }
+    }
+    return n;
+}
+
+static const char *const js_puncts[] = {
+    ">>>=", "...", "===", "!==", "**=", "<<=", ">>=", ">>>", "&&=", "||=", "?\?=",
+    "=>", "==", "!=", "<=", ">=", "&&", "||", "??", "?.", "++", "--", "+=", "-=",
+    "*=", "/=", "%=", "&=", "|=", "^=", "**", "<<", ">>", NULL
+};
+
+static size_t js_scan_punct(const char *s, size_t n, size_t i) {
+    for (const char *const *p = js_puncts; *p; p++) {
+        size_t len = strlen(*p);
+        if ((*p)[0] != s[i] || n - i < len || memcmp(s + i, *p, len) != 0) continue;
+        // "?." followed by a digit is "?" then a number: a ? .5 : b
+        if (len == 2 && s[i] == '?' && s[i + 1] == '.' && i + 2 < n && isdigit((unsigned char)s[i + 2])) continue;
+        return i + len;
+    }
+    return i + 1;
+}
+
+/* Next token into t; returns 0 at the end of input */
+static int js_next(JsLexer *lx, Token *t) {
+    const char *s = lx->s;
+    size_t n = lx->n, i = lx->pos, k;
+    int nl = 0, ws = 0, newline;
+
+    while (i < n && (k = js_space_at(s, n, i, &newline)) > 0) {
+        ws = 1;
+        nl |= newline;
+        i += k;
+    }
+    t->ws_before = ws;
+    t->nl_before = nl;
+    t->ptr = s + i;
+    if (i >= n) {
+        lx->pos = n;
+        t->type = JS_EOF;
+        t->len = 0;
+        return 0;
+    }
+
+    unsigned char c = (unsigned char)s[i];
+    size_t start = i;
+    int type = JS_PUNCT;
+    int after_dot = lx->prev_type == JS_PUNCT && (js_prev_is(lx, ".") || js_prev_is(lx, "?."));
+
+    if (c == '/' && i + 1 < n && (s[i + 1] == '/' || s[i + 1] == '*')) {
+        if (s[i + 1] == '/') {
+            while (i < n && s[i] != '\n' && s[i] != '\r') i++;
+        } else {
+            const char *end = NULL;
+            for (size_t j = i + 2; j + 1 < n; j++) {
+                if (s[j] == '*' && s[j + 1] == '/') {
+                    end = s + j;
+                    break;
+                }
+            }
+            i = end ? (size_t)(end - s) + 2 : n;
+        }
+        t->type = JS_COMMENT;
+        t->len = i - start;
+        lx->pos = i;
+        return 1;
+    }
+    if (c == '#' && i == 0 && n > 1 && s[1] == '!') {
+        while (i < n && s[i] != '\n' && s[i] != '\r') i++;
+        t->type = JS_COMMENT;
+        t->len = i;
+        lx->pos = i;
+        return 1;
+    }
+
+    if (isdigit(c) || (c == '.' && i + 1 < n && isdigit((unsigned char)s[i + 1]))) {
+        type = JS_NUMBER;
+        i = js_scan_number(s, n, i);
+    } else if (js_ident_char(c) || c == '#') {
+        type = JS_IDENT;
+        i++;
+        while (i < n && js_ident_char((unsigned char)s[i])) {
+            int dummy;
+            if ((unsigned char)s[i] >= 0x80 && js_space_at(s, n, i, &dummy)) break;
+            i += s[i] == '\\' ? 2 : 1;
+        }
+        if (i > n) i = n;
+    } else if (c == '"' || c == '\'') {
+        type = JS_STRING;
+        i = js_scan_string(s, n, i);
+    } else if (c == '`') {
+        i++;
+        type = js_scan_template(lx, &i, 1);
+    } else if (c == '}' && lx->depth && lx->stack[lx->depth - 1] == JS_OPEN_SUBST) {
+        js_pop(lx);
+        i++;
+        type = js_scan_template(lx, &i, 0);
+    } else if (c == '/' && lx->regex_ok && (k = js_scan_regex(lx, i)) > 0) {
+        type = JS_REGEX;
+        i = k;
+    } else {
+        i = js_scan_punct(s, n, i);
+    }
+
+    // Where the token leaves us: can an expression (and so a regex) start next?
+    int regex_ok = 0;
+    if (type == JS_IDENT) {
+        regex_ok = !after_dot && js_word_in(s + start, i - start, js_regex_keywords);
+    } else if (type == JS_TEMPLATE_HEAD || type == JS_TEMPLATE_MIDDLE) {
+        regex_ok = 1;
+    } else if (type == JS_PUNCT) {
+        size_t len = i - start;
+        if (len == 1 && (c == '(' || c == '[')) {
+            unsigned char kind = c == '[' ? JS_OPEN_BRACKET
+                               : js_prev_keyword(lx, js_control_keywords, after_dot) ? JS_OPEN_CONTROL
+                               : JS_OPEN_PAREN;
+            js_push(lx, kind);
+            regex_ok = 1;
+        } else if (len == 1 && c == '{') {
+            // A block after a statement boundary, ")", "=>" or a block keyword; otherwise an object
+            int block;
+            if (lx->prev_type == JS_EOF) {
+                block = 1;
+            } else if (lx->prev_type == JS_PUNCT) {
+                int top = lx->depth ? lx->stack[lx->depth - 1] : JS_OPEN_BLOCK;
+                block = js_prev_is(lx, ";") || js_prev_is(lx, "}") || js_prev_is(lx, ")") || js_prev_is(lx, "=>") ||
+                        (js_prev_is(lx, "{") && top == JS_OPEN_BLOCK) || (js_prev_is(lx, ":") && top == JS_OPEN_BLOCK);
+            } else if (lx->prev_type == JS_IDENT) {
+                block = after_dot || !js_prev_is_one_of(lx, js_regex_keywords) ||
+                        js_prev_keyword(lx, js_block_keywords, after_dot);
+            } else {
+                block = 0;
+            }
+            js_push(lx, block ? JS_OPEN_BLOCK : JS_OPEN_OBJECT);
+            regex_ok = 1;
+        } else if (len == 1 && (c == ')' || c == ']' || c == '}')) {
+            int kind = js_pop(lx);
+            regex_ok = kind == JS_OPEN_CONTROL || kind == JS_OPEN_BLOCK;
+        } else {
+            regex_ok = !(len == 2 && (memcmp(s + start, "++", 2) == 0 || memcmp(s + start, "--", 2) == 0));
+        }
+    }
+
+    lx->regex_ok = regex_ok;
+    lx->prev_type = type;
+    lx->prev_ptr = s + start;
+    lx->prev_len = i - start;
+    lx->pos = i;
+    t->type = type;
+    t->len = i - start;
+    return 1;
+}
+
+/* ---- CSS ---- */
+
+enum {
+    CSS_EOF,
+    CSS_IDENT,
+    CSS_FUNCTION,       /* name( */
+    CSS_AT_KEYWORD,     /* @name */
+    CSS_HASH,           /* #name */
+    CSS_STRING,
+    CSS_URL,            /* url(...) with an unquoted argument */
+    CSS_NUMBER,         /* Number, percentage or dimension */
+    CSS_CDO,            /* <!-- */
+    CSS_CDC,            /* --> */
+    CSS_COMMENT,
+    CSS_DELIM           /* Any other single character, including {}();:,[] */
+};
+
+typedef struct {
+    const char *s;
+    size_t n, pos;
+} CssLexer;
+
+static void css_lexer_init(CssLexer *lx, const char *s, size_t n) {
+    lx->s = s;
+    lx->n = n;
+    lx->pos = 0;
+}
+
+static int css_name_char(unsigned char c) {
+    return isalnum(c) || c == '-' || c == '_' || c >= 0x80;
+}
+
+static int css_valid_escape(const char *s, size_t n, size_t i) {
+    return i + 1 < n && s[i] == '\\' && s[i + 1] != '\n' && s[i + 1] != '\r' && s[i + 1] != '\f';
+}
+
+static int css_starts_ident(const char *s, size_t n, size_t i) {
+    if (i >= n) return 0;
+    unsigned char c = (unsigned char)s[i];
+    if (c == '-') {
+        if (i + 1 >= n) return 0;
+        unsigned char d = (unsigned char)s[i + 1];
+        return isalpha(d) || d == '_' || d == '-' || d >= 0x80 || css_valid_escape(s, n, i + 1);
+    }
+    return isalpha(c) || c == '_' || c >= 0x80 || css_valid_escape(s, n, i);
+}
+
+static int css_starts_number(const char *s, size_t n, size_t i) {
+    if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+    if (i < n && isdigit((unsigned char)s[i])) return 1;
+    return i + 1 < n && s[i] == '.' && isdigit((unsigned char)s[i + 1]);
+}
+
+static size_t css_scan_name(const char *s, size_t n, size_t i) {
+    while (i < n) {
+        if (css_name_char((unsigned char)s[i])) {
+            i++;
+        } else if (css_valid_escape(s, n, i)) {
+            i++;
+            size_t hex = 0;
+            while (i < n && hex < 6 && isxdigit((unsigned char)s[i])) {
+                i++;
+                hex++;
+            }
+            if (hex == 0) i++;
+            else if (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n')) i++;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+static size_t css_scan_string(const char *s, size_t n, size_t i) {
+    char quote = s[i++];
+    while (i < n) {
+        char c = s[i];
+        if (c == '\\') i += 2;
+        else if (c == quote) return i + 1;
+        else if (c == '\n') return i;   /* Bad string: stop at the line end */
+        else i++;
+    }
+    return n;
+}
+
+static int css_next(CssLexer *lx, Token *t) {
+    const char *s = lx->s;
+    size_t n = lx->n, i = lx->pos;
+    int ws = 0, nl = 0;
+    while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\n' || s[i] == '\r' || s[i] == '\f')) {
+        nl |= s[i] == '\n';
+        ws = 1;
+        i++;
+    }
+    t->ws_before = ws;
+    t->nl_before = nl;
+    t->ptr = s + i;
+    if (i >= n) {
+        lx->pos = n;
+        t->type = CSS_EOF;
+        t->len = 0;
+        return 0;
+    }
+
+    size_t start = i;
+    unsigned char c = (unsigned char)s[i];
+    int type = CSS_DELIM;
+    if (c == '/' && i + 1 < n && s[i + 1] == '*') {
+        type = CSS_COMMENT;
+        i += 2;
+        while (i + 1 < n && !(s[i] == '*' && s[i + 1] == '/')) i++;
+        i = i + 1 < n ? i + 2 : n;
+    } else if (c == '"' || c == '\'') {
+        type = CSS_STRING;
+        i = css_scan_string(s, n, i);
+    } else if (css_starts_number(s, n, i)) {
+        type = CSS_NUMBER;
+        if (s[i] == '+' || s[i] == '-') i++;
+        while (i < n && isdigit((unsigned char)s[i])) i++;
+        if (i + 1 < n && s[i] == '.' && isdigit((unsigned char)s[i + 1])) {
+            i++;
+            while (i < n && isdigit((unsigned char)s[i])) i++;
+        }
+        if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+            size_t j = i + 1;
+            if (j < n && (s[j] == '+' || s[j] == '-')) j++;
+            if (j < n && isdigit((unsigned char)s[j])) {
+                i = j;
+                while (i < n && isdigit((unsigned char)s[i])) i++;
+            }
+        }
+        if (i < n && s[i] == '%') i++;
+        else if (css_starts_ident(s, n, i)) i = css_scan_name(s, n, i);
+    } else if (c == '<' && n - i >= 4 && memcmp(s + i, "<!--", 4) == 0) {
+        type = CSS_CDO;
+        i += 4;
+    } else if (c == '-' && n - i >= 3 && memcmp(s + i, "-->", 3) == 0) {
+        type = CSS_CDC;
+        i += 3;
+    } else if (css_starts_ident(s, n, i)) {
+        type = CSS_IDENT;
+        i = css_scan_name(s, n, i);
+        if (i < n && s[i] == '(') {
+            type = CSS_FUNCTION;
+            i++;
+            if (i - start == 4 && lex_has_prefix_nocase(s + start, 4, "url(")) {
+                size_t j = i;
+                while (j < n && (s[j] == ' ' || s[j] == '\t' || s[j] == '\n')) j++;
+                if (j < n && s[j] != '"' && s[j] != '\'') {
+                    type = CSS_URL;
+                    while (j < n && s[j] != ')') j += s[j] == '\\' ? 2 : 1;
+                    i = j < n ? j + 1 : n;
+                }
+            }
+        }
+    } else if (c == '@' && css_starts_ident(s, n, i + 1)) {
+        type = CSS_AT_KEYWORD;
+        i = css_scan_name(s, n, i + 1);
+    } else if (c == '#' && i + 1 < n && (css_name_char((unsigned char)s[i + 1]) || css_valid_escape(s, n, i + 1))) {
+        type = CSS_HASH;
+        i = css_scan_name(s, n, i + 1);
+    } else if (c == '\\' && css_valid_escape(s, n, i)) {
+        type = CSS_IDENT;
+        i = css_scan_name(s, n, i);
+    } else {
+        i++;
+        // Keep a UTF-8 sequence together
+        while (c >= 0x80 && i < n && ((unsigned char)s[i] & 0xC0) == 0x80) i++;
+    }
+
+    if (i > n) i = n;
+    lx->pos = i;
+    t->type = type;
+    t->len = i - start;
+    return 1;
+}
+
+/* ---- HTML ---- */
+
+enum {
+    HTML_EOF,
+    HTML_TEXT,
+    HTML_COMMENT,   /* <!-- ... --> */
+    HTML_DECL,      /* <!DOCTYPE ...>, <![CDATA[ ... ]]>, <? ... > */
+    HTML_OPEN,      /* <name attr=value ...> or <name ... /> */
+    HTML_CLOSE,     /* </name> */
+    HTML_RAW        /* Contents of script / style / textarea / title */
+};
+
+typedef struct {
+    const char *s;
+    size_t n, pos;
+    const char *raw_name;   /* Inside a raw text element: its name */
+    size_t raw_len;
+} HtmlLexer;
+
+typedef struct {
+    const char *name;
+    size_t name_len;
+    const char *value;      /* NULL for a bare attribute */
+    size_t value_len;       /* Without the quotes */
+    char quote;             /* '"', '\'' or 0 */
+} HtmlAttr;
+
+static void html_lexer_init(HtmlLexer *lx, const char *s, size_t n) {
+    memset(lx, 0, sizeof(*lx));
+    lx->s = s;
+    lx->n = n;
+}
+
+static int html_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static size_t html_scan_tag_name(const char *s, size_t n, size_t i) {
+    while (i < n && !html_space((unsigned char)s[i]) && s[i] != '/' && s[i] != '>') i++;
+    return i;
+}
+
+/* Name of an HTML_OPEN or HTML_CLOSE token */
+static void html_tag_name(const Token *t, const char **name, size_t *len) {
+    size_t start = t->type == HTML_CLOSE ? 2 : 1;
+    *name = t->ptr + start;
+    *len = html_scan_tag_name(t->ptr, t->len, start) - start;
+}
+
+static int html_tag_is(const Token *t, const char *name) {
+    const char *p;
+    size_t len;
+    html_tag_name(t, &p, &len);
+    return len == strlen(name) && lex_has_prefix_nocase(p, len, name);
+}
+
+/* Does an HTML_OPEN token end in "/>"? */
+static int html_tag_self_closing(const Token *t) {
+    return t->len >= 2 && t->ptr[t->len - 1] == '>' && t->ptr[t->len - 2] == '/';
+}
+
+/*
+ * Step through the attributes of an HTML_OPEN token. *pos starts at 0;
+ * returns 0 after the last one.
+ */
+static int html_next_attr(const Token *t, size_t *pos, HtmlAttr *a) {
+    const char *s = t->ptr;
+    size_t n = t->len, i = *pos;
+    if (i == 0) i = html_scan_tag_name(s, n, 1);
+    for (;;) {
+        while (i < n && (html_space((unsigned char)s[i]) || s[i] == '/')) i++;
+        if (i >= n || s[i] == '>') {
+            *pos = n;
+            return 0;
+        }
+        size_t name = i;
+        // An attribute name may itself start with '='
+        i++;
+        while (i < n && !html_space((unsigned char)s[i]) && s[i] != '/' && s[i] != '>' && s[i] != '=') i++;
+        a->name = s + name;
+        a->name_len = i - name;
+        a->value = NULL;
+        a->value_len = 0;
+        a->quote = 0;
+        size_t j = i;
+        while (j < n && html_space((unsigned char)s[j])) j++;
+        if (j < n && s[j] == '=') {
+            j++;
+            while (j < n && html_space((unsigned char)s[j])) j++;
+            if (j < n && (s[j] == '"' || s[j] == '\'')) {
+                a->quote = s[j];
+                const char *end = (const char *)memchr(s + j + 1, s[j], n - j - 1);
+                size_t close = end ? (size_t)(end - s) : n;
+                a->value = s + j + 1;
+                a->value_len = close - j - 1;
+                i = end ? close + 1 : n;
+            } else {
+                size_t v = j;
+                while (j < n && !html_space((unsigned char)s[j]) && s[j] != '>') j++;
+                a->value = s + v;
+                a->value_len = j - v;
+                i = j;
+            }
+        }
+        *pos = i;
+        return 1;
+    }
+}
+
+/* End of the tag starting at s[i] == '<'; quoted attribute values may hold '>' */
+static size_t html_scan_tag(const char *s, size_t n, size_t i) {
+    i++;
+    while (i < n && s[i] != '>') {
+        if (s[i] == '=') {
+            i++;
+            while (i < n && html_space((unsigned char)s[i])) i++;
+            if (i < n && (s[i] == '"' || s[i] == '\'')) {
+                const char *end = (const char *)memchr(s + i + 1, s[i], n - i - 1);
+                if (!end) return n;
+                i = (size_t)(end - s) + 1;
+            }
+            continue;
+        }
+        i++;
+    }
+    return i < n ? i + 1 : n;
+}
+
+static const char *const html_raw_elements[] = {"script", "style", "textarea", "title", "xmp", NULL};
+
+static int html_next(HtmlLexer *lx, Token *t) {
+    const char *s = lx->s;
+    size_t n = lx->n, i = lx->pos;
+    t->ws_before = t->nl_before = 0;
+    t->ptr = s + i;
+    if (i >= n) {
+        t->type = HTML_EOF;
+        t->len = 0;
+        return 0;
+    }
+
+    size_t start = i;
+    int type = HTML_TEXT;
+    if (lx->raw_name) {
+        // Up to "</name" followed by a space, '/' or '>'
+        size_t len = lx->raw_len;
+        for (; i < n; i++) {
+            if (s[i] == '<' && i + 2 + len <= n && s[i + 1] == '/' &&
+                lex_has_prefix_nocase(s + i + 2, len, lx->raw_name) &&
+                (i + 2 + len == n || html_space((unsigned char)s[i + 2 + len]) || s[i + 2 + len] == '>' ||
+                 s[i + 2 + len] == '/')) {
+                break;
+            }
+        }
+        lx->raw_name = NULL;
+        if (i > start) {
+            lx->pos = i;
+            t->type = HTML_RAW;
+            t->len = i - start;
+            return 1;
+        }
+        if (i >= n) return html_next(lx, t);
+    }
+
+    unsigned char next = i + 1 < n ? (unsigned char)s[i + 1] : 0;
+    if (s[i] == '<' && n - i >= 4 && memcmp(s + i, "<!--", 4) == 0) {
+        type = HTML_COMMENT;
+        i += 4;
+        // "<!-->" and "<!--->" are complete (empty) comments
+        if (i < n && s[i] == '>') {
+            i++;
+        } else if (i + 1 < n && s[i] == '-' && s[i + 1] == '>') {
+            i += 2;
+        } else {
+            while (i + 2 < n && !(s[i] == '-' && s[i + 1] == '-' && s[i + 2] == '>')) i++;
+            i = i + 2 < n ? i + 3 : n;
+        }
+    } else if (s[i] == '<' && n - i >= 9 && memcmp(s + i, "<![CDATA[", 9) == 0) {
+        type = HTML_DECL;
+        i += 9;
+        while (i + 2 < n && !(s[i] == ']' && s[i + 1] == ']' && s[i + 2] == '>')) i++;
+        i = i + 2 < n ? i + 3 : n;
+    } else if (s[i] == '<' && (next == '!' || next == '?')) {
+        type = HTML_DECL;
+        const char *end = (const char *)memchr(s + i, '>', n - i);
+        i = end ? (size_t)(end - s) + 1 : n;
+    } else if (s[i] == '<' && next == '/' && i + 2 < n && isalpha((unsigned char)s[i + 2])) {
+        type = HTML_CLOSE;
+        const char *end = (const char *)memchr(s + i, '>', n - i);
+        i = end ? (size_t)(end - s) + 1 : n;
+    } else if (s[i] == '<' && isalpha(next)) {
+        type = HTML_OPEN;
+        i = html_scan_tag(s, n, i);
+    } else {
+        i++;
+        for (;;) {
+            const char *lt = (const char *)memchr(s + i, '<', n - i);
+            if (!lt) {
+                i = n;
+                break;
+            }
+            i = (size_t)(lt - s);
+            unsigned char c = i + 1 < n ? (unsigned char)s[i + 1] : 0;
+            if (isalpha(c) || c == '/' || c == '!' || c == '?') break;
+            i++;
+        }
+    }
+
+    t->type = type;
+    t->len = i - start;
+    lx->pos = i;
+    if (type == HTML_OPEN && !html_tag_self_closing(t)) {
+        for (const char *const *raw = html_raw_elements; *raw; raw++) {
+            if (html_tag_is(t, *raw)) {
+                lx->raw_name = *raw;
+                lx->raw_len = strlen(*raw);
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+#endif /* LEXER_H */
@@ -0,0 +1,236 @@
+/**
+ * Line splitting and interning for WASM tools that compare lines.
+ *
+ * line_list_split() cuts a text into (pointer, length) spans without
+ * copying it. A trailing newline does not start an extra empty line, and
+ * empty lines in the middle are kept.
+ *
+ * A LineInterner maps line contents to dense integer ids (0, 1, 2, ...),
+ * so that after one hashing pass two lines are equal exactly when their
+ * ids are. diff interns both inputs into one table and compares ids;
+ * patch interns the original file and looks hunk lines up in it.
+ *
+ * Streamed lines (from a LineReader) do not outlive the next read, so a
+ * LineArena copies them into large blocks that never move; uniq --global
+ * copies each new line there before interning it.
+ *
+ * Usage:
+ *   LineList a;
+ *   line_list_split(text, strlen(text), &a);
+ *   LineInterner in;
+ *   line_interner_init(&in, a.count);
+ *   for (size_t i = 0; i < a.count; i++)
+ *       ids[i] = line_interner_id(&in, a.lines[i].ptr, a.lines[i].len);
+ *   ...
+ *   line_interner_free(&in);
+ *   line_list_free(&a);
+ */
+
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simd.h"
+
+typedef struct {
+    const char *ptr;
+    size_t len;
+} LineSpan;
+
+typedef struct {
+    LineSpan *lines;
+    size_t count;
+} LineList;
+
+/* Returns 0 on allocation failure */
+static inline int line_list_split(const char *text, size_t len, LineList *out) {
+    size_t cap = 64;
+    out->count = 0;
+    out->lines = (LineSpan *)malloc(cap * sizeof(LineSpan));
+    if (!out->lines) return 0;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const char *nl = (const char *)simd_memchr(text + pos, '\n', len - pos);
+        size_t end = nl ? (size_t)(nl - text) : len;
+        if (out->count == cap) {
+            cap *= 2;
+            LineSpan *tmp = (LineSpan *)realloc(out->lines, cap * sizeof(LineSpan));
+            if (!tmp) return 0;
+            out->lines = tmp;
+        }
+        out->lines[out->count].ptr = text + pos;
+        out->lines[out->count].len = end - pos;
+        out->count++;
+        pos = end + 1;
+    }
+    return 1;
+}
+
+static inline void line_list_free(LineList *l) {
+    free(l->lines);
+    l->lines = NULL;
+    l->count = 0;
+}
+
+/* Append-only storage for line copies; returned pointers stay valid */
+#define LINE_ARENA_BLOCK (256 * 1024)
+
+typedef struct LineArenaBlock {
+    struct LineArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} LineArenaBlock;
+
+typedef struct {
+    LineArenaBlock *head;   /* Block being filled; older blocks follow */
+} LineArena;
+
+static inline void line_arena_init(LineArena *a) {
+    a->head = NULL;
+}
+
+/* Copy of s (len bytes), or NULL on allocation failure */
+static inline const char *line_arena_copy(LineArena *a, const char *s, size_t len) {
+    LineArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < len) {
+        /* Lines longer than a block get a block of their own */
+        size_t cap = len > LINE_ARENA_BLOCK ? len : LINE_ARENA_BLOCK;
+        b = (LineArenaBlock *)malloc(sizeof(LineArenaBlock) + cap);
+        if (!b) return NULL;
+        b->used = 0;
+        b->cap = cap;
+        b->next = a->head;
+        a->head = b;
+    }
+    char *p = b->data + b->used;
+    if (len) memcpy(p, s, len);
+    b->used += len;
+    return p;
+}
+
+static inline void line_arena_free(LineArena *a) {
+    while (a->head) {
+        LineArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/*
+ * 64-bit multiplicative hash, eight bytes per step so long lines hash at
+ * memory speed. Ids never leave the process, so the function can change.
+ */
+static inline uint64_t line_hash(const char *s, size_t len) {
+    const uint64_t k = 0x9e3779b97f4a7c15ULL;
+    uint64_t h = 0xcbf29ce484222325ULL ^ ((uint64_t)len * k);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, s + i, len - i);
+    h = (h ^ tail) * k;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+typedef struct {
+    uint64_t hash;
+    const char *ptr;
+    size_t len;
+    int id;            /* -1 = empty slot */
+} LineSlot;
+
+typedef struct {
+    LineSlot *slots;
+    size_t mask;       /* Capacity - 1; capacity is a power of two */
+    int count;         /* Ids handed out so far */
+} LineInterner;
+
+static inline int line_interner_init(LineInterner *in, size_t expected) {
+    size_t cap = 64;
+    while (cap < expected * 2) cap <<= 1;
+    in->slots = (LineSlot *)malloc(cap * sizeof(LineSlot));
+    if (!in->slots) return 0;
+    for (size_t i = 0; i < cap; i++) in->slots[i].id = -1;
+    in->mask = cap - 1;
+    in->count = 0;
+    return 1;
+}
+
+static inline void line_interner_free(LineInterner *in) {
+    free(in->slots);
+    in->slots = NULL;
+}
+
+static inline LineSlot *line_interner_slot(LineInterner *in, uint64_t h, const char *s, size_t len) {
+    size_t i = (size_t)h & in->mask;
+    for (;;) {
+        LineSlot *slot = &in->slots[i];
+        if (slot->id < 0) return slot;
+        if (slot->hash == h && slot->len == len && memcmp(slot->ptr, s, len) == 0) return slot;
+        i = (i + 1) & in->mask;
+    }
+}
+
+static inline int line_interner_grow(LineInterner *in) {
+    size_t cap = (in->mask + 1) * 2;
+    LineSlot *old = in->slots;
+    size_t old_cap = in->mask + 1;
+    in->slots = (LineSlot *)malloc(cap * sizeof(LineSlot));
+    if (!in->slots) {
+        in->slots = old;
+        return 0;
+    }
+    for (size_t i = 0; i < cap; i++) in->slots[i].id = -1;
+    in->mask = cap - 1;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].id < 0) continue;
+        size_t j = (size_t)old[i].hash & in->mask;
+        while (in->slots[j].id >= 0) j = (j + 1) & in->mask;
+        in->slots[j] = old[i];
+    }
+    free(old);
+    return 1;
+}
+
+/* line_interner_id() for a line whose line_hash() is already known */
+static inline int line_interner_id_hashed(LineInterner *in, uint64_t h, const char *s, size_t len) {
+    LineSlot *slot = line_interner_slot(in, h, s, len);
+    if (slot->id >= 0) return slot->id;
+
+    if ((size_t)in->count * 2 >= in->mask + 1) {
+        if (!line_interner_grow(in)) return -1;
+        slot = line_interner_slot(in, h, s, len);
+    }
+    slot->hash = h;
+    slot->ptr = s;
+    slot->len = len;
+    slot->id = in->count++;
+    return slot->id;
+}
+
+/* Id of the line, assigning the next free id to new contents. The text
+ * must outlive the interner. Returns -1 on allocation failure. */
+static inline int line_interner_id(LineInterner *in, const char *s, size_t len) {
+    return line_interner_id_hashed(in, line_hash(s, len), s, len);
+}
+
+/* Id of the line if it has been interned, otherwise -1 */
+static inline int line_interner_find(LineInterner *in, const char *s, size_t len) {
+    return line_interner_slot(in, line_hash(s, len), s, len)->id;
+}
+
+static inline int line_interner_find_hashed(LineInterner *in, uint64_t h, const char *s, size_t len) {
+    return line_interner_slot(in, h, s, len)->id;
+}
+
+#endif /* LINE_INDEX_H */
@@ -0,0 +1,193 @@
+/**
+ * Streaming chunked input for WASM tools.
+ *
+ * LineReader pulls input through a fixed-size buffer (LINE_READER_CHUNK
+ * bytes) instead of loading the whole stream into memory. Consumed bytes
+ * are dropped by sliding the unread tail back to the front of the buffer,
+ * so memory stays flat in the input size; it only grows past the chunk
+ * size to hold a single line that is longer than the buffer.
+ *
+ * Lines are yielded in place: the trailing '\n' is overwritten with '\0'
+ * and a pointer into the buffer is returned. The pointer stays valid
+ * until the next call on the same reader. Empty lines are yielded as
+ * empty strings, and a final line without a trailing newline is still
+ * yielded.
+ *
+ * The same reader works over a string argument, so tools handle
+ * "text as argument" and "text via stdin" through one code path.
+ *
+ * Usage in a tool's main():
+ *   LineReader reader;
+ *   if (input) line_reader_init_string(&reader, input);
+ *   else line_reader_init_stdin(&reader);
+ *   if (line_reader_is_empty(&reader)) { fprintf(stderr, "Usage: ..."); return 1; }
+ *
+ *   char *line;
+ *   size_t len;
+ *   while (line_reader_next(&reader, &line, &len)) {
+ *       // ... process line ...
+ *   }
+ *   line_reader_free(&reader);
+ */
+
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simd.h"
+
+#define LINE_READER_CHUNK 65536
+
+typedef struct {
+    FILE *fp;            /* Source stream, or NULL when reading a string */
+    const char *mem;     /* Source string when fp is NULL */
+    size_t mem_len;
+    size_t mem_pos;
+
+    char *buf;           /* Window over the input; one spare byte for '\0' */
+    size_t cap;
+    size_t head;         /* First unconsumed byte */
+    size_t tail;         /* One past the last buffered byte */
+    size_t scan;         /* Bytes in [head, scan) are known to hold no '\n' */
+    int eof;             /* Source exhausted */
+    int error;           /* Allocation failure */
+} LineReader;
+
+static inline int line_reader_alloc(LineReader *r) {
+    r->cap = LINE_READER_CHUNK;
+    r->buf = (char *)malloc(r->cap + 1);
+    r->head = r->tail = r->scan = 0;
+    r->eof = 0;
+    r->error = r->buf == NULL;
+    return !r->error;
+}
+
+static inline int line_reader_init_file(LineReader *r, FILE *fp) {
+    r->fp = fp;
+    r->mem = NULL;
+    r->mem_len = r->mem_pos = 0;
+    return line_reader_alloc(r);
+}
+
+static inline int line_reader_init_stdin(LineReader *r) {
+    return line_reader_init_file(r, stdin);
+}
+
+static inline int line_reader_init_string(LineReader *r, const char *s) {
+    r->fp = NULL;
+    r->mem = s;
+    r->mem_len = strlen(s);
+    r->mem_pos = 0;
+    return line_reader_alloc(r);
+}
+
+static inline void line_reader_free(LineReader *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
+
+/*
+ * Slide unread bytes to the front and read the next chunk behind them.
+ * The buffer is doubled only when it is completely full of unread data,
+ * i.e. a single line is longer than the current capacity.
+ * Returns the number of new bytes (0 at EOF or on error).
+ */
+static inline size_t line_reader_fill(LineReader *r) {
+    if (r->eof || r->error) return 0;
+
+    if (r->head > 0) {
+        size_t pending = r->tail - r->head;
+        memmove(r->buf, r->buf + r->head, pending);
+        r->scan -= r->head;
+        r->tail = pending;
+        r->head = 0;
+    }
+
+    if (r->tail == r->cap) {
+        char *tmp = (char *)realloc(r->buf, r->cap * 2 + 1);
+        if (!tmp) { r->error = 1; return 0; }
+        r->buf = tmp;
+        r->cap *= 2;
+    }
+
+    size_t want = r->cap - r->tail;
+    size_t n;
+    if (r->fp) {
+        n = fread(r->buf + r->tail, 1, want, r->fp);
+        if (n < want) r->eof = 1;
+    } else {
+        n = r->mem_len - r->mem_pos;
+        if (n > want) n = want;
+        memcpy(r->buf + r->tail, r->mem + r->mem_pos, n);
+        r->mem_pos += n;
+        if (r->mem_pos == r->mem_len) r->eof = 1;
+    }
+
+    r->tail += n;
+    return n;
+}
+
+/*
+ * Check whether the input holds no bytes at all. Peeks at the first
+ * chunk without consuming it.
+ */
+static inline int line_reader_is_empty(LineReader *r) {
+    while (r->head == r->tail && !r->eof && !r->error) {
+        line_reader_fill(r);
+    }
+    return r->head == r->tail;
+}
+
+/*
+ * Yield the next line, NUL-terminated and without its '\n'.
+ * Returns 1 when a line was produced, 0 at end of input.
+ */
+static inline int line_reader_next(LineReader *r, char **line, size_t *len) {
+    for (;;) {
+        char *start = r->buf + r->head;
+        char *nl = (char *)simd_memchr(r->buf + r->scan, '\n', r->tail - r->scan);
+
+        if (nl) {
+            *nl = '\0';
+            *line = start;
+            *len = (size_t)(nl - start);
+            r->head = r->scan = (size_t)(nl - r->buf) + 1;
+            return 1;
+        }
+        r->scan = r->tail;
+
+        if (r->eof || r->error) {
+            if (r->head == r->tail) return 0;
+            r->buf[r->tail] = '\0';
+            *line = start;
+            *len = r->tail - r->head;
+            r->head = r->scan = r->tail;
+            return 1;
+        }
+
+        line_reader_fill(r);
+    }
+}
+
+/*
+ * Yield the next block of raw bytes, for tools that work on characters
+ * rather than lines (wc, tr). Blocks are not NUL-terminated and may end
+ * in the middle of a line. Returns 1 when bytes were produced, 0 at EOF.
+ */
+static inline int line_reader_chunk(LineReader *r, const char **data, size_t *len) {
+    if (r->head == r->tail) {
+        r->head = r->tail = r->scan = 0;
+        while (r->tail == 0 && line_reader_fill(r) == 0) {
+            if (r->eof || r->error) return 0;
+        }
+    }
+
+    *data = r->buf + r->head;
+    *len = r->tail - r->head;
+    r->head = r->scan = r->tail;
+    return 1;
+}
+
+#endif /* LINE_READER_H */
@@ -1,262 +1,2341 @@
 /**
  * markdown - Convert Markdown to HTML
- * Usage: markdown <markdown-text>
- * Note: Simplified Markdown parser supporting common elements
+ * Usage: markdown [--unsafe] <markdown-text>
+ * Input: CommonMark text (argument or stdin), plus GFM tables and
+ *        ~~strikethrough~~
+ * Options: --unsafe (pass raw HTML and javascript:/vbscript:/file:/data:
+ *          links through; by default they are omitted, as cmark does)
+ *
+ * Rendering is two-phase, in the style of md4c and cmark. The block phase
+ * runs once per input line: the line is matched against the stack of open
+ * containers (block quotes, lists, list items), new blocks are opened, and
+ * what is left is appended to the open leaf. When a top-level block closes
+ * it is rendered straight away and freed, so output starts before the
+ * input ends and memory is bounded by the largest top-level block.
+ *
+ * The inline phase runs per leaf. One scan over its text builds a list of
+ * spans, pushing emphasis delimiter runs and link brackets on two stacks
+ * that are resolved in place (the CommonMark delimiter algorithm), so the
+ * text is not rescanned for each construct.
+ *
+ * Link reference definitions may come after their use. Once a block holds
+ * a "[...]" that is not an inline link, the remaining blocks are held
+ * back until the end of the input so those references can resolve.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
-#include "../stdin_read.h"
-
-// HTML escape
-void print_escaped(const char *text) {
-    for (const char *p = text; *p; p++) {
-        switch (*p) {
-            case '<': printf("&lt;"); break;
-            case '>': printf("&gt;"); break;
-            case '&': printf("&amp;"); break;
-            case '"': printf("&quot;"); break;
-            default: putchar(*p);
-        }
-    }
-}
-
-// Process inline formatting
-void process_inline(const char *text) {
-    const char *p = text;
-
-    while (*p) {
-        // Bold: **text** or __text__
-        if ((*p == '*' && *(p+1) == '*') || (*p == '_' && *(p+1) == '_')) {
-            char marker = *p;
-            const char *start = p + 2;
-            const char *end = strstr(start, (*p == '*') ? "**" : "__");
-            if (end) {
-                printf("<strong>");
-                for (const char *c = start; c < end; c++) {
-                    if (*c == '<') printf("&lt;");
-                    else if (*c == '>') printf("&gt;");
-                    else if (*c == '&') printf("&amp;");
-                    else putchar(*c);
-                }
-                printf("</strong>");
-                p = end + 2;
+#include "../line_reader.h"
+#include "../line_index.h"
+#include "../stdout_write.h"
+
+#define TAB_STOP 4
+#define CODE_INDENT 4
+#define MAX_BACKTICKS 1000
+#define MAX_LINK_LABEL 999
+#define MAX_LINK_PARENS 32
+
+static int opt_unsafe = 0;
+
+static void out_of_memory(void) {
+    out_flush();
+    fprintf(stderr, "Error: Out of memory\n");
+    exit(1);
+}
+
+/* ---- Arena ---- */
+
+#define ARENA_BLOCK (256 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+static void *arena_alloc(Arena *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    ArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = (ArenaBlock *)malloc(sizeof(ArenaBlock) + cap);
+        if (!b) out_of_memory();
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+/* Drop everything but keep the newest block for reuse */
+static void arena_reset(Arena *a) {
+    if (!a->head) return;
+    ArenaBlock *b = a->head->next;
+    while (b) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head->next = NULL;
+    a->head->used = 0;
+}
+
+static void arena_free(Arena *a) {
+    while (a->head) {
+        ArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* ---- Growable text ---- */
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} TextBuf;
+
+static void buf_append(TextBuf *b, const char *s, size_t n) {
+    if (!n) return;
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 128;
+        while (cap < b->len + n) cap *= 2;
+        char *tmp = (char *)realloc(b->data, cap);
+        if (!tmp) out_of_memory();
+        b->data = tmp;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+static void buf_free(TextBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+}
+
+static TextBuf scratch;     /* Unescaped attribute values */
+static TextBuf label_buf;   /* Normalized reference labels */
+static TextBuf cell_buf;    /* Table cell text */
+
+/* ---- Output ---- */
+
+static char last_out = '\n';
+
+static void emit(const char *s, size_t n) {
+    if (!n) return;
+    out_write(s, n);
+    last_out = s[n - 1];
+}
+
+static void emit_str(const char *s) {
+    emit(s, strlen(s));
+}
+
+static void emit_char(char c) {
+    out_char(c);
+    last_out = c;
+}
+
+/* Start a new line unless already at one */
+static void cr(void) {
+    if (last_out != '\n') emit_char('\n');
+}
+
+static void emit_uint(unsigned long long v) {
+    out_uint(v);
+    last_out = '0';
+}
+
+static void emit_escaped(const char *s, size_t n) {
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+        const char *rep;
+        switch (s[i]) {
+            case '&': rep = "&amp;"; break;
+            case '<': rep = "&lt;"; break;
+            case '>': rep = "&gt;"; break;
+            case '"': rep = "&quot;"; break;
+            default: continue;
+        }
+        emit(s + start, i - start);
+        emit_str(rep);
+        start = i + 1;
+    }
+    emit(s + start, n - start);
+}
+
+/* Characters left as they are in an href; '&' and '\'' are entity-escaped, the rest %XX */
+static int href_safe(unsigned char c) {
+    return isalnum(c) || (c && strchr("-_.+!*(),%#@?=;:/$~", c));
+}
+
+static void emit_href(const char *s, size_t n) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (href_safe(c)) continue;
+        emit(s + start, i - start);
+        if (c == '&') {
+            emit_str("&amp;");
+        } else if (c == '\'') {
+            emit_str("&#x27;");
+        } else {
+            char esc[3] = {'%', hex[c >> 4], hex[c & 15]};
+            emit(esc, 3);
+        }
+        start = i + 1;
+    }
+    emit(s + start, n - start);
+}
+
+/* ---- Characters ---- */
+
+static int is_punct_ascii(int c) {
+    return (c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) || (c >= 123 && c <= 126);
+}
+
+static int is_space_or_tab(int c) {
+    return c == ' ' || c == '\t';
+}
+
+static int is_ws(int c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static int in_set(int c, const char *set) {
+    return c && strchr(set, c) != NULL;
+}
+
+static int32_t decode_utf8(const char *p, size_t n) {
+    const unsigned char *s = (const unsigned char *)p;
+    if (s[0] < 0x80) return s[0];
+    int extra = s[0] >= 0xF0 ? 3 : s[0] >= 0xE0 ? 2 : s[0] >= 0xC0 ? 1 : -1;
+    if (extra < 0 || (size_t)extra >= n) return 0xFFFD;
+    int32_t cp = s[0] & (0x3F >> extra);
+    for (int i = 1; i <= extra; i++) {
+        if ((s[i] & 0xC0) != 0x80) return 0xFFFD;
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    return cp;
+}
+
+static size_t encode_utf8(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Code point ending just before s[pos]; the start of the text counts as a newline */
+static int32_t char_before(const char *s, size_t pos) {
+    if (pos == 0) return '\n';
+    size_t i = pos - 1;
+    while (i > 0 && pos - i < 4 && ((unsigned char)s[i] & 0xC0) == 0x80) i--;
+    return decode_utf8(s + i, pos - i);
+}
+
+static int32_t char_at(const char *s, size_t n, size_t pos) {
+    return pos < n ? decode_utf8(s + pos, n - pos) : '\n';
+}
+
+static int unicode_space(int32_t c) {
+    return is_ws(c) || c == 0xA0 || c == 0x1680 || (c >= 0x2000 && c <= 0x200A) ||
+           c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+/* ASCII punctuation plus the common Unicode punctuation and symbol ranges */
+static int unicode_punct(int32_t c) {
+    if (c < 0x80) return is_punct_ascii(c);
+    return (c >= 0xA1 && c <= 0xBF) || c == 0xD7 || c == 0xF7 || (c >= 0x2010 && c <= 0x2027) ||
+           (c >= 0x2030 && c <= 0x205E) || (c >= 0x2190 && c <= 0x23FF) || (c >= 0x3001 && c <= 0x3003) ||
+           (c >= 0x3008 && c <= 0x3011) || (c >= 0xFF01 && c <= 0xFF0F);
+}
+
+/* ---- Entities ---- */
+
+typedef struct {
+    const char *name;
+    const char *text;
+} NamedEntity;
+
+/* Decoded where a value is needed (URLs, titles, info strings); any other
+ * well-formed "&name;" is passed through for the browser to resolve */
+static const NamedEntity named_entities[] = {
+    {"amp", "&"}, {"apos", "'"}, {"bull", "\xE2\x80\xA2"}, {"cent", "\xC2\xA2"},
+    {"copy", "\xC2\xA9"}, {"deg", "\xC2\xB0"}, {"divide", "\xC3\xB7"}, {"euro", "\xE2\x82\xAC"},
+    {"gt", ">"}, {"hellip", "\xE2\x80\xA6"}, {"laquo", "\xC2\xAB"}, {"ldquo", "\xE2\x80\x9C"},
+    {"lsquo", "\xE2\x80\x98"}, {"lt", "<"}, {"mdash", "\xE2\x80\x94"}, {"middot", "\xC2\xB7"},
+    {"nbsp", "\xC2\xA0"}, {"ndash", "\xE2\x80\x93"}, {"para", "\xC2\xB6"}, {"plusmn", "\xC2\xB1"},
+    {"pound", "\xC2\xA3"}, {"quot", "\""}, {"raquo", "\xC2\xBB"}, {"rdquo", "\xE2\x80\x9D"},
+    {"reg", "\xC2\xAE"}, {"rsquo", "\xE2\x80\x99"}, {"sect", "\xC2\xA7"}, {"times", "\xC3\x97"},
+    {"trade", "\xE2\x84\xA2"}, {"yen", "\xC2\xA5"},
+};
+
+/*
+ * Length of the entity reference at s[0] == '&', or 0 if there is none.
+ * The decoded UTF-8 goes to out; *out_len is 0 for a name not in the table.
+ */
+static size_t scan_entity(const char *s, size_t n, char *out, size_t *out_len) {
+    *out_len = 0;
+    if (n < 3 || s[0] != '&') return 0;
+    size_t i = 1;
+    if (s[i] == '#') {
+        uint32_t cp = 0;
+        size_t digits = 0;
+        i++;
+        if (i < n && (s[i] == 'x' || s[i] == 'X')) {
+            i++;
+            while (i < n && digits < 7 && isxdigit((unsigned char)s[i])) {
+                int c = (unsigned char)s[i++];
+                cp = cp * 16 + (uint32_t)(isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+                digits++;
+            }
+            if (digits == 0 || digits > 6) return 0;
+        } else {
+            while (i < n && digits < 8 && isdigit((unsigned char)s[i])) {
+                cp = cp * 10 + (uint32_t)(s[i++] - '0');
+                digits++;
+            }
+            if (digits == 0 || digits > 7) return 0;
+        }
+        if (i >= n || s[i] != ';') return 0;
+        if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) cp = 0xFFFD;
+        *out_len = encode_utf8(cp, out);
+        return i + 1;
+    }
+    size_t start = i;
+    if (!isalpha((unsigned char)s[i])) return 0;
+    while (i < n && i - start < 32 && isalnum((unsigned char)s[i])) i++;
+    if (i >= n || s[i] != ';') return 0;
+    for (size_t k = 0; k < sizeof(named_entities) / sizeof(named_entities[0]); k++) {
+        const char *name = named_entities[k].name;
+        if (strlen(name) == i - start && memcmp(name, s + start, i - start) == 0) {
+            *out_len = strlen(named_entities[k].text);
+            memcpy(out, named_entities[k].text, *out_len);
+            break;
+        }
+    }
+    return i + 1;
+}
+
+/* Resolve backslash escapes and entities into b */
+static void unescape_into(TextBuf *b, const char *s, size_t n) {
+    b->len = 0;
+    size_t i = 0, start = 0;
+    while (i < n) {
+        if (s[i] == '\\' && i + 1 < n && is_punct_ascii((unsigned char)s[i + 1])) {
+            buf_append(b, s + start, i - start);
+            start = i + 1;
+            i += 2;
+            continue;
+        }
+        if (s[i] == '&') {
+            char u[8];
+            size_t ulen, k = scan_entity(s + i, n - i, u, &ulen);
+            if (k && ulen) {
+                buf_append(b, s + start, i - start);
+                buf_append(b, u, ulen);
+                i += k;
+                start = i;
                 continue;
             }
         }
+        i++;
+    }
+    buf_append(b, s + start, n - start);
+}
+
+static int has_prefix_nocase(const char *s, size_t n, const char *prefix) {
+    size_t len = strlen(prefix);
+    if (n < len) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)s[i]) != prefix[i]) return 0;
+    }
+    return 1;
+}
+
+/* Script and local-file schemes, plus data: other than common image types */
+static int url_unsafe(const char *s, size_t n) {
+    if (has_prefix_nocase(s, n, "javascript:") || has_prefix_nocase(s, n, "vbscript:") ||
+        has_prefix_nocase(s, n, "file:")) {
+        return 1;
+    }
+    if (!has_prefix_nocase(s, n, "data:")) return 0;
+    return !(has_prefix_nocase(s, n, "data:image/png") || has_prefix_nocase(s, n, "data:image/gif") ||
+             has_prefix_nocase(s, n, "data:image/jpeg") || has_prefix_nocase(s, n, "data:image/webp"));
+}
+
+static void emit_url(const char *s, size_t n) {
+    unescape_into(&scratch, s, n);
+    if (!opt_unsafe && url_unsafe(scratch.data, scratch.len)) return;
+    emit_href(scratch.data, scratch.len);
+}
+
+static void emit_attr(const char *s, size_t n) {
+    unescape_into(&scratch, s, n);
+    emit_escaped(scratch.data, scratch.len);
+}
+
+/* ---- Link reference definitions ---- */
+
+typedef struct {
+    LineSpan dest;
+    LineSpan title;
+    int has_title;
+} RefDef;
+
+typedef struct {
+    LineInterner labels;
+    LineArena arena;
+    RefDef *defs;
+    size_t cap;
+} RefMap;
 
-        // Italic: *text* or _text_
-        if (*p == '*' || *p == '_') {
-            char marker = *p;
-            const char *start = p + 1;
-            const char *end = strchr(start, marker);
-            if (end && end > start) {
-                printf("<em>");
-                for (const char *c = start; c < end; c++) {
-                    if (*c == '<') printf("&lt;");
-                    else if (*c == '>') printf("&gt;");
-                    else if (*c == '&') printf("&amp;");
-                    else putchar(*c);
+/* Collapse whitespace runs, trim and case-fold */
+static void normalize_label(const char *s, size_t n) {
+    label_buf.len = 0;
+    int space = 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (is_ws((unsigned char)c)) {
+            space = label_buf.len > 0;
+            continue;
+        }
+        if (space) buf_append(&label_buf, " ", 1);
+        space = 0;
+        c = (char)tolower((unsigned char)c);
+        buf_append(&label_buf, &c, 1);
+    }
+}
+
+/* First definition wins; returns 0 when the label is blank */
+static int ref_define(RefMap *m, const char *label, size_t label_len, const char *dest, size_t dest_len,
+                      const char *title, size_t title_len) {
+    normalize_label(label, label_len);
+    if (label_buf.len == 0) return 0;
+    uint64_t h = line_hash(label_buf.data, label_buf.len);
+    if (line_interner_find_hashed(&m->labels, h, label_buf.data, label_buf.len) >= 0) return 1;
+    const char *key = line_arena_copy(&m->arena, label_buf.data, label_buf.len);
+    int id = key ? line_interner_id_hashed(&m->labels, h, key, label_buf.len) : -1;
+    if (id < 0) out_of_memory();
+    if ((size_t)id >= m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        RefDef *tmp = (RefDef *)realloc(m->defs, cap * sizeof(RefDef));
+        if (!tmp) out_of_memory();
+        m->defs = tmp;
+        m->cap = cap;
+    }
+    RefDef *d = &m->defs[id];
+    d->dest.ptr = line_arena_copy(&m->arena, dest, dest_len);
+    d->dest.len = dest_len;
+    d->has_title = title != NULL;
+    d->title.ptr = title ? line_arena_copy(&m->arena, title, title_len) : NULL;
+    d->title.len = title ? title_len : 0;
+    if (!d->dest.ptr || (title && !d->title.ptr)) out_of_memory();
+    return 1;
+}
+
+static const RefDef *ref_lookup(RefMap *m, const char *label, size_t label_len) {
+    if (label_len > MAX_LINK_LABEL) return NULL;
+    normalize_label(label, label_len);
+    if (label_buf.len == 0) return NULL;
+    int id = line_interner_find(&m->labels, label_buf.data, label_buf.len);
+    return id < 0 ? NULL : &m->defs[id];
+}
+
+/* ---- Link syntax, shared by both phases ---- */
+
+static size_t skip_spacechars(const char *s, size_t n, size_t i) {
+    while (i < n && is_ws((unsigned char)s[i])) i++;
+    return i;
+}
+
+/* Spaces, at most one newline, spaces */
+static size_t skip_spnl(const char *s, size_t n, size_t i) {
+    while (i < n && is_space_or_tab(s[i])) i++;
+    if (i < n && s[i] == '\n') {
+        i++;
+        while (i < n && is_space_or_tab(s[i])) i++;
+    }
+    return i;
+}
+
+/* "[label]" starting at s[pos]: total length with the brackets, or 0 */
+static size_t scan_link_label(const char *s, size_t n, size_t pos) {
+    if (pos >= n || s[pos] != '[') return 0;
+    size_t i = pos + 1;
+    while (i < n && i - pos - 1 <= MAX_LINK_LABEL) {
+        char c = s[i];
+        if (c == '\\' && i + 1 < n && is_punct_ascii((unsigned char)s[i + 1])) {
+            i += 2;
+            continue;
+        }
+        if (c == '[') return 0;
+        if (c == ']') return i + 1 - pos;
+        i++;
+    }
+    return 0;
+}
+
+/* Link destination at s[pos], either <...> or a run with balanced parentheses */
+static int scan_link_dest(const char *s, size_t n, size_t pos, size_t *end, size_t *start, size_t *len) {
+    if (pos < n && s[pos] == '<') {
+        size_t i = pos + 1;
+        while (i < n) {
+            char c = s[i];
+            if (c == '>') {
+                *start = pos + 1;
+                *len = i - pos - 1;
+                *end = i + 1;
+                return 1;
+            }
+            if (c == '\n' || c == '<') return 0;
+            i += (c == '\\' && i + 1 < n) ? 2 : 1;
+        }
+        return 0;
+    }
+    size_t i = pos;
+    int depth = 0;
+    while (i < n) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\\' && i + 1 < n && is_punct_ascii((unsigned char)s[i + 1])) {
+            i += 2;
+            continue;
+        }
+        if (c == '(') {
+            if (++depth > MAX_LINK_PARENS) return 0;
+        } else if (c == ')') {
+            if (depth == 0) break;
+            depth--;
+        } else if (c <= ' ' || c == 127) {
+            break;
+        }
+        i++;
+    }
+    if (depth != 0) return 0;
+    *start = pos;
+    *len = i - pos;
+    *end = i;
+    return 1;
+}
+
+/* Link title in "...", '...' or (...) at s[pos] */
+static int scan_link_title(const char *s, size_t n, size_t pos, size_t *end, size_t *start, size_t *len) {
+    if (pos >= n) return 0;
+    char open = s[pos], close = open == '(' ? ')' : open;
+    if (open != '"' && open != '\'' && open != '(') return 0;
+    for (size_t i = pos + 1; i < n; i++) {
+        char c = s[i];
+        if (c == '\\' && i + 1 < n && is_punct_ascii((unsigned char)s[i + 1])) {
+            i++;
+        } else if (c == close) {
+            *start = pos + 1;
+            *len = i - pos - 1;
+            *end = i + 1;
+            return 1;
+        } else if (open == '(' && c == '(') {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/* Only spaces up to the end of the line: sets *end past the newline */
+static int at_line_end(const char *s, size_t n, size_t i, size_t *end) {
+    while (i < n && is_space_or_tab(s[i])) i++;
+    if (i < n && s[i] != '\n') return 0;
+    *end = i < n ? i + 1 : n;
+    return 1;
+}
+
+/* ---- HTML syntax, shared by both phases ---- */
+
+static size_t scan_tag_name(const char *s, size_t n, size_t i) {
+    if (i >= n || !isalpha((unsigned char)s[i])) return i;
+    while (i < n && (isalnum((unsigned char)s[i]) || s[i] == '-')) i++;
+    return i;
+}
+
+/* Length of an open tag at s[pos] == '<', or 0 */
+static size_t scan_open_tag(const char *s, size_t n, size_t pos) {
+    size_t i = scan_tag_name(s, n, pos + 1);
+    if (i == pos + 1) return 0;
+    for (;;) {
+        size_t ws = skip_spacechars(s, n, i);
+        if (ws == i || ws >= n || !(isalpha((unsigned char)s[ws]) || s[ws] == '_' || s[ws] == ':')) {
+            i = ws;
+            break;
+        }
+        i = ws + 1;
+        while (i < n && (isalnum((unsigned char)s[i]) || in_set(s[i], "_.:-"))) i++;
+        size_t eq = skip_spacechars(s, n, i);
+        if (eq < n && s[eq] == '=') {
+            size_t v = skip_spacechars(s, n, eq + 1);
+            if (v >= n) return 0;
+            if (s[v] == '"' || s[v] == '\'') {
+                const char *q = (const char *)memchr(s + v + 1, s[v], n - v - 1);
+                if (!q) return 0;
+                i = (size_t)(q - s) + 1;
+            } else {
+                size_t e = v;
+                while (e < n && !is_ws((unsigned char)s[e]) && !in_set(s[e], "\"'=<>`")) e++;
+                if (e == v) return 0;
+                i = e;
+            }
+        }
+    }
+    if (i < n && s[i] == '/') i++;
+    return i < n && s[i] == '>' ? i + 1 - pos : 0;
+}
+
+/* Length of a closing tag at s[pos] == '<', or 0 */
+static size_t scan_close_tag(const char *s, size_t n, size_t pos) {
+    if (pos + 1 >= n || s[pos + 1] != '/') return 0;
+    size_t i = scan_tag_name(s, n, pos + 2);
+    if (i == pos + 2) return 0;
+    i = skip_spacechars(s, n, i);
+    return i < n && s[i] == '>' ? i + 1 - pos : 0;
+}
+
+static const char *find_str(const char *s, size_t n, const char *needle) {
+    size_t len = strlen(needle);
+    const char *p = s, *end = s + n;
+    while ((size_t)(end - p) >= len) {
+        p = (const char *)memchr(p, needle[0], (size_t)(end - p) - len + 1);
+        if (!p) return NULL;
+        if (memcmp(p, needle, len) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+/* ---- Inline phase ---- */
+
+enum {
+    IN_TEXT, IN_RAW, IN_CODE, IN_SOFTBREAK, IN_HARDBREAK, IN_EMPH, IN_STRONG, IN_DEL,
+    IN_LINK, IN_IMAGE, IN_AUTOLINK, IN_HTML
+};
+
+typedef struct Inline {
+    int type;
+    const char *text;           /* Text, code, raw HTML, autolink target */
+    size_t len;
+    const char *url;            /* Links and images, still escaped */
+    size_t url_len;
+    const char *title;
+    size_t title_len;
+    int mailto;
+    struct Inline *parent, *first, *last, *prev, *next;
+} Inline;
+
+typedef struct Delim {
+    Inline *node;               /* Text node holding the run */
+    struct Delim *prev, *next;
+    char c;
+    int count, orig;
+    int can_open, can_close;
+} Delim;
+
+typedef struct Bracket {
+    Inline *node;               /* The "[" or "![" text node */
+    struct Bracket *prev;
+    Delim *prev_delim;          /* Delimiter stack top when it was pushed */
+    size_t pos;                 /* Just past the bracket */
+    int image, active, bracket_after;
+} Bracket;
+
+typedef struct {
+    const char *s;
+    size_t n, pos;
+    Arena arena;
+    Inline root;
+    Delim *delims;
+    Bracket *brackets;
+    RefMap *refs;
+    /* Start of the last backtick run of each length, to bound code span searches */
+    size_t backticks[MAX_BACKTICKS + 1];
+    int backticks_ready, backticks_scanned;
+    /* Set once a search for the end of these constructs has run off the end */
+    int no_comment_end, no_pi_end, no_cdata_end, no_decl_end;
+} InlineParser;
+
+static InlineParser inline_parser;
+static unsigned char inline_special[256];
+
+static Inline *new_inline(InlineParser *ip, int type) {
+    Inline *x = (Inline *)arena_alloc(&ip->arena, sizeof(Inline));
+    memset(x, 0, sizeof(*x));
+    x->type = type;
+    return x;
+}
+
+static void append_inline(Inline *parent, Inline *x) {
+    x->parent = parent;
+    x->prev = parent->last;
+    x->next = NULL;
+    if (parent->last) parent->last->next = x;
+    else parent->first = x;
+    parent->last = x;
+}
+
+static void unlink_inline(Inline *x) {
+    if (x->prev) x->prev->next = x->next;
+    else x->parent->first = x->next;
+    if (x->next) x->next->prev = x->prev;
+    else x->parent->last = x->prev;
+    x->prev = x->next = NULL;
+}
+
+static void insert_after(Inline *ref, Inline *x) {
+    x->parent = ref->parent;
+    x->prev = ref;
+    x->next = ref->next;
+    if (ref->next) ref->next->prev = x;
+    else ref->parent->last = x;
+    ref->next = x;
+}
+
+static Inline *add_text(InlineParser *ip, const char *s, size_t len) {
+    Inline *t = new_inline(ip, IN_TEXT);
+    t->text = s;
+    t->len = len;
+    append_inline(&ip->root, t);
+    return t;
+}
+
+static void remove_delim(InlineParser *ip, Delim *d) {
+    if (d->prev) d->prev->next = d->next;
+    if (d->next) d->next->prev = d->prev;
+    else ip->delims = d->prev;
+}
+
+/* Move the nodes strictly between a and b into a new node of the given type */
+static Inline *wrap_between(InlineParser *ip, Inline *a, Inline *b, int type) {
+    Inline *x = new_inline(ip, type);
+    Inline *cur = a->next;
+    while (cur && cur != b) {
+        Inline *next = cur->next;
+        unlink_inline(cur);
+        append_inline(x, cur);
+        cur = next;
+    }
+    insert_after(a, x);
+    return x;
+}
+
+static void skip_line_start(InlineParser *ip) {
+    while (ip->pos < ip->n && is_space_or_tab(ip->s[ip->pos])) ip->pos++;
+}
+
+static void handle_newline(InlineParser *ip) {
+    ip->pos++;
+    Inline *last = ip->root.last;
+    int hard = 0;
+    if (last && last->type == IN_TEXT) {
+        size_t spaces = 0;
+        while (spaces < last->len && last->text[last->len - 1 - spaces] == ' ') spaces++;
+        hard = spaces >= 2;
+        last->len -= spaces;
+    }
+    append_inline(&ip->root, new_inline(ip, hard ? IN_HARDBREAK : IN_SOFTBREAK));
+    skip_line_start(ip);
+}
+
+static void handle_backslash(InlineParser *ip) {
+    const char *s = ip->s;
+    size_t i = ++ip->pos;
+    if (i < ip->n && s[i] == '\n') {
+        ip->pos++;
+        append_inline(&ip->root, new_inline(ip, IN_HARDBREAK));
+        skip_line_start(ip);
+    } else if (i < ip->n && is_punct_ascii((unsigned char)s[i])) {
+        add_text(ip, s + i, 1);
+        ip->pos++;
+    } else {
+        add_text(ip, s + i - 1, 1);
+    }
+}
+
+static void handle_entity(InlineParser *ip) {
+    char u[8];
+    size_t ulen, k = scan_entity(ip->s + ip->pos, ip->n - ip->pos, u, &ulen);
+    if (!k) {
+        add_text(ip, ip->s + ip->pos++, 1);
+        return;
+    }
+    if (ulen) {
+        char *copy = (char *)arena_alloc(&ip->arena, ulen);
+        memcpy(copy, u, ulen);
+        add_text(ip, copy, ulen);
+    } else {
+        Inline *raw = new_inline(ip, IN_RAW);
+        raw->text = ip->s + ip->pos;
+        raw->len = k;
+        append_inline(&ip->root, raw);
+    }
+    ip->pos += k;
+}
+
+/* Position just past a closing run of exactly len backticks, or 0 */
+static size_t scan_closing_backticks(InlineParser *ip, size_t len) {
+    if (len > MAX_BACKTICKS) return 0;
+    if (!ip->backticks_ready) {
+        memset(ip->backticks, 0, sizeof(ip->backticks));
+        ip->backticks_ready = 1;
+    }
+    if (ip->backticks_scanned && ip->backticks[len] < ip->pos) return 0;
+    const char *s = ip->s;
+    size_t i = ip->pos, n = ip->n;
+    for (;;) {
+        const char *tick = (const char *)memchr(s + i, '`', n - i);
+        if (!tick) break;
+        size_t start = (size_t)(tick - s);
+        i = start;
+        while (i < n && s[i] == '`') i++;
+        size_t run = i - start;
+        if (run <= MAX_BACKTICKS) ip->backticks[run] = start;
+        if (run == len) return i;
+    }
+    ip->backticks_scanned = 1;
+    return 0;
+}
+
+static void handle_backticks(InlineParser *ip) {
+    const char *s = ip->s;
+    size_t start = ip->pos;
+    while (ip->pos < ip->n && s[ip->pos] == '`') ip->pos++;
+    size_t len = ip->pos - start;
+    size_t end = scan_closing_backticks(ip, len);
+    if (!end) {
+        add_text(ip, s + start, len);
+        return;
+    }
+    Inline *code = new_inline(ip, IN_CODE);
+    code->text = s + ip->pos;
+    code->len = end - len - ip->pos;
+    // Strip one space from each side unless the span is all spaces
+    if (code->len >= 2 && (code->text[0] == ' ' || code->text[0] == '\n') &&
+        (code->text[code->len - 1] == ' ' || code->text[code->len - 1] == '\n')) {
+        size_t i = 0;
+        while (i < code->len && (code->text[i] == ' ' || code->text[i] == '\n')) i++;
+        if (i < code->len) {
+            code->text++;
+            code->len -= 2;
+        }
+    }
+    append_inline(&ip->root, code);
+    ip->pos = end;
+}
+
+static size_t scan_autolink_uri(const char *s, size_t n, size_t pos) {
+    size_t i = pos + 1, start = i;
+    if (i >= n || !isalpha((unsigned char)s[i])) return 0;
+    while (i < n && (isalnum((unsigned char)s[i]) || in_set(s[i], "+.-"))) i++;
+    if (i - start < 2 || i - start > 32 || i >= n || s[i] != ':') return 0;
+    for (i++; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '>') return i + 1 - pos;
+        if (c <= ' ' || c == '<' || c == 127) return 0;
+    }
+    return 0;
+}
+
+static size_t scan_autolink_email(const char *s, size_t n, size_t pos) {
+    size_t i = pos + 1;
+    while (i < n && (isalnum((unsigned char)s[i]) || in_set(s[i], ".!#$%&'*+/=?^_`{|}~-"))) i++;
+    if (i == pos + 1 || i >= n || s[i] != '@') return 0;
+    i++;
+    for (;;) {
+        size_t label = i;
+        while (i < n && (isalnum((unsigned char)s[i]) || s[i] == '-') && i - label < 63) i++;
+        if (i == label || s[label] == '-' || s[i - 1] == '-') return 0;
+        if (i < n && s[i] == '.') {
+            i++;
+            continue;
+        }
+        return i < n && s[i] == '>' ? i + 1 - pos : 0;
+    }
+}
+
+/* Inline raw HTML at s[pos] == '<': tags, comments, PIs, declarations, CDATA */
+static size_t scan_inline_html(InlineParser *ip, size_t pos) {
+    const char *s = ip->s, *end;
+    size_t n = ip->n, i = pos + 1;
+    if (i >= n) return 0;
+    if (s[i] == '/') return scan_close_tag(s, n, pos);
+    if (isalpha((unsigned char)s[i])) return scan_open_tag(s, n, pos);
+    if (s[i] == '?') {
+        if (ip->no_pi_end || !(end = find_str(s + i + 1, n - i - 1, "?>"))) {
+            ip->no_pi_end = 1;
+            return 0;
+        }
+        return (size_t)(end - s) + 2 - pos;
+    }
+    if (s[i] != '!') return 0;
+    if (n - i >= 3 && memcmp(s + i, "!--", 3) == 0) {
+        i += 3;
+        if (i < n && s[i] == '>') return i + 1 - pos;
+        if (i + 1 < n && s[i] == '-' && s[i + 1] == '>') return i + 2 - pos;
+        if (ip->no_comment_end || !(end = find_str(s + i, n - i, "-->"))) {
+            ip->no_comment_end = 1;
+            return 0;
+        }
+        return (size_t)(end - s) + 3 - pos;
+    }
+    if (n - i >= 8 && memcmp(s + i, "![CDATA[", 8) == 0) {
+        if (ip->no_cdata_end || !(end = find_str(s + i + 8, n - i - 8, "]]>"))) {
+            ip->no_cdata_end = 1;
+            return 0;
+        }
+        return (size_t)(end - s) + 3 - pos;
+    }
+    if (i + 1 < n && isalpha((unsigned char)s[i + 1])) {
+        if (ip->no_decl_end || !(end = (const char *)memchr(s + i + 2, '>', n - i - 2))) {
+            ip->no_decl_end = 1;
+            return 0;
+        }
+        return (size_t)(end - s) + 1 - pos;
+    }
+    return 0;
+}
+
+static void handle_pointy(InlineParser *ip) {
+    const char *s = ip->s;
+    size_t pos = ip->pos, k;
+    if ((k = scan_autolink_uri(s, ip->n, pos)) || (k = scan_autolink_email(s, ip->n, pos))) {
+        Inline *a = new_inline(ip, IN_AUTOLINK);
+        a->text = s + pos + 1;
+        a->len = k - 2;
+        a->mailto = !scan_autolink_uri(s, ip->n, pos);
+        append_inline(&ip->root, a);
+    } else if ((k = scan_inline_html(ip, pos))) {
+        Inline *h = new_inline(ip, IN_HTML);
+        h->text = s + pos;
+        h->len = k;
+        append_inline(&ip->root, h);
+    } else {
+        add_text(ip, s + pos, 1);
+        k = 1;
+    }
+    ip->pos += k;
+}
+
+static void handle_delim(InlineParser *ip, char c) {
+    const char *s = ip->s;
+    size_t start = ip->pos;
+    while (ip->pos < ip->n && s[ip->pos] == c) ip->pos++;
+    size_t count = ip->pos - start;
+
+    int32_t before = char_before(s, start), after = char_at(s, ip->n, ip->pos);
+    int before_space = unicode_space(before), after_space = unicode_space(after);
+    int before_punct = unicode_punct(before), after_punct = unicode_punct(after);
+    int left = !after_space && (!after_punct || before_space || before_punct);
+    int right = !before_space && (!before_punct || after_space || after_punct);
+    int can_open = left, can_close = right;
+    if (c == '_') {
+        can_open = left && (!right || before_punct);
+        can_close = right && (!left || after_punct);
+    }
+
+    Inline *t = add_text(ip, s + start, count);
+    if ((c == '~' && count > 2) || (!can_open && !can_close)) return;
+    Delim *d = (Delim *)arena_alloc(&ip->arena, sizeof(Delim));
+    d->node = t;
+    d->c = c;
+    d->count = d->orig = (int)count;
+    d->can_open = can_open;
+    d->can_close = can_close;
+    d->prev = ip->delims;
+    d->next = NULL;
+    if (ip->delims) ip->delims->next = d;
+    ip->delims = d;
+}
+
+/* Resolve emphasis and strikethrough among delimiters above bottom */
+static void process_emphasis(InlineParser *ip, Delim *bottom) {
+    Delim *openers_bottom[3][2][3];
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 2; b++) {
+            for (int c = 0; c < 3; c++) openers_bottom[a][b][c] = bottom;
+        }
+    }
+    if (ip->delims == bottom) return;
+    Delim *closer = ip->delims;
+    while (closer->prev != bottom) closer = closer->prev;
+
+    while (closer) {
+        if (!closer->can_close) {
+            closer = closer->next;
+            continue;
+        }
+        int kind = closer->c == '*' ? 0 : closer->c == '_' ? 1 : 2;
+        Delim **floor = &openers_bottom[kind][closer->can_open][closer->orig % 3];
+        Delim *opener = closer->prev;
+        int found = 0;
+        while (opener && opener != bottom && opener != *floor) {
+            if (opener->c == closer->c && opener->can_open) {
+                if (kind == 2) {
+                    found = opener->count == closer->count;
+                } else {
+                    // The "rule of 3" for runs that can both open and close
+                    found = !((opener->can_close || closer->can_open) && closer->orig % 3 != 0 &&
+                              (opener->orig + closer->orig) % 3 == 0);
                 }
-                printf("</em>");
-                p = end + 1;
-                continue;
+                if (found) break;
+            }
+            opener = opener->prev;
+        }
+
+        Delim *next = closer->next;
+        if (!found) {
+            *floor = closer->prev;
+            if (!closer->can_open) remove_delim(ip, closer);
+            closer = next;
+            continue;
+        }
+
+        int use = kind == 2 ? closer->count : (closer->count >= 2 && opener->count >= 2 ? 2 : 1);
+        opener->count -= use;
+        opener->node->len -= (size_t)use;
+        closer->count -= use;
+        closer->node->text += use;
+        closer->node->len -= (size_t)use;
+        wrap_between(ip, opener->node, closer->node, kind == 2 ? IN_DEL : use == 2 ? IN_STRONG : IN_EMPH);
+        for (Delim *d = closer->prev; d != opener;) {
+            Delim *prev = d->prev;
+            remove_delim(ip, d);
+            d = prev;
+        }
+        if (opener->count == 0) {
+            unlink_inline(opener->node);
+            remove_delim(ip, opener);
+        }
+        if (closer->count == 0) {
+            unlink_inline(closer->node);
+            remove_delim(ip, closer);
+            closer = next;
+        }
+    }
+    while (ip->delims != bottom) remove_delim(ip, ip->delims);
+}
+
+static void push_bracket(InlineParser *ip, int image) {
+    size_t len = image ? 2 : 1;
+    Inline *t = add_text(ip, ip->s + ip->pos, len);
+    ip->pos += len;
+    Bracket *b = (Bracket *)arena_alloc(&ip->arena, sizeof(Bracket));
+    b->node = t;
+    b->prev = ip->brackets;
+    b->prev_delim = ip->delims;
+    b->pos = ip->pos;
+    b->image = image;
+    b->active = 1;
+    b->bracket_after = 0;
+    if (ip->brackets) ip->brackets->bracket_after = 1;
+    ip->brackets = b;
+}
+
+/* "]": close the innermost bracket as a link or image if what follows allows it */
+static void handle_close_bracket(InlineParser *ip) {
+    const char *s = ip->s;
+    size_t n = ip->n, close = ip->pos, after = ++ip->pos;
+    Bracket *opener = ip->brackets;
+    if (!opener || !opener->active) {
+        if (opener) ip->brackets = opener->prev;
+        add_text(ip, s + close, 1);
+        return;
+    }
+
+    const char *url = NULL, *title = NULL;
+    size_t url_len = 0, title_len = 0;
+    int matched = 0;
+
+    // Inline link: ](dest "title")
+    size_t dest_end, ds, dl;
+    if (after < n && s[after] == '(' &&
+        scan_link_dest(s, n, skip_spacechars(s, n, after + 1), &dest_end, &ds, &dl)) {
+        size_t t = skip_spacechars(s, n, dest_end), title_end = t, ts = 0, tl = 0;
+        int has_title = t > dest_end && scan_link_title(s, n, t, &title_end, &ts, &tl);
+        if (!has_title) title_end = t;
+        size_t e = skip_spacechars(s, n, title_end);
+        if (e < n && s[e] == ')') {
+            url = s + ds;
+            url_len = dl;
+            if (has_title) {
+                title = s + ts;
+                title_len = tl;
             }
+            ip->pos = e + 1;
+            matched = 1;
         }
+    }
+
+    // Reference link: full [text][label], collapsed [text][] or shortcut [text]
+    if (!matched) {
+        size_t k = scan_link_label(s, n, after), label = 0, label_len = 0;
+        int have = 0;
+        if (k > 2) {
+            label = after + 1;
+            label_len = k - 2;
+            have = 1;
+        } else if (!opener->bracket_after) {
+            label = opener->pos;
+            label_len = close - opener->pos;
+            have = 1;
+        }
+        const RefDef *def = have ? ref_lookup(ip->refs, s + label, label_len) : NULL;
+        if (def) {
+            url = def->dest.ptr;
+            url_len = def->dest.len;
+            if (def->has_title) {
+                title = def->title.ptr;
+                title_len = def->title.len;
+            }
+            ip->pos = after + k;
+            matched = 1;
+        }
+    }
 
-        // Code: `text`
-        if (*p == '`') {
-            const char *start = p + 1;
-            const char *end = strchr(start, '`');
-            if (end) {
-                printf("<code>");
-                print_escaped(start);
-                // Manually stop at end
-                for (const char *c = start; c < end; c++) {
-                    if (*c == '<') printf("&lt;");
-                    else if (*c == '>') printf("&gt;");
-                    else if (*c == '&') printf("&amp;");
-                    else putchar(*c);
+    if (!matched) {
+        ip->brackets = opener->prev;
+        add_text(ip, s + close, 1);
+        return;
+    }
+
+    Inline *link = new_inline(ip, opener->image ? IN_IMAGE : IN_LINK);
+    link->url = url;
+    link->url_len = url_len;
+    link->title = title;
+    link->title_len = title_len;
+    for (Inline *cur = opener->node->next; cur;) {
+        Inline *next = cur->next;
+        unlink_inline(cur);
+        append_inline(link, cur);
+        cur = next;
+    }
+    append_inline(&ip->root, link);
+    process_emphasis(ip, opener->prev_delim);
+    unlink_inline(opener->node);
+    ip->brackets = opener->prev;
+    // No links inside links
+    if (!opener->image) {
+        for (Bracket *b = ip->brackets; b; b = b->prev) {
+            if (!b->image) b->active = 0;
+        }
+    }
+}
+
+static void parse_inlines(InlineParser *ip) {
+    const char *s = ip->s;
+    while (ip->pos < ip->n) {
+        char c = s[ip->pos];
+        switch (c) {
+            case '\n': handle_newline(ip); break;
+            case '`': handle_backticks(ip); break;
+            case '\\': handle_backslash(ip); break;
+            case '&': handle_entity(ip); break;
+            case '<': handle_pointy(ip); break;
+            case '*': case '_': case '~': handle_delim(ip, c); break;
+            case '[': push_bracket(ip, 0); break;
+            case ']': handle_close_bracket(ip); break;
+            case '!':
+                if (ip->pos + 1 < ip->n && s[ip->pos + 1] == '[') {
+                    push_bracket(ip, 1);
+                } else {
+                    add_text(ip, s + ip->pos++, 1);
                 }
-                printf("</code>");
-                p = end + 1;
-                continue;
+                break;
+            default: {
+                size_t start = ip->pos++;
+                while (ip->pos < ip->n && !inline_special[(unsigned char)s[ip->pos]]) ip->pos++;
+                add_text(ip, s + start, ip->pos - start);
+                break;
+            }
+        }
+    }
+    process_emphasis(ip, NULL);
+}
+
+static void emit_code_text(const char *s, size_t n) {
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] != '\n') continue;
+        emit_escaped(s + start, i - start);
+        emit_char(' ');
+        start = i + 1;
+    }
+    emit_escaped(s + start, n - start);
+}
+
+/* plain > 0 inside image alt text, where only the text is written */
+static void inline_enter(const Inline *x, int *plain) {
+    switch (x->type) {
+        case IN_TEXT: emit_escaped(x->text, x->len); break;
+        case IN_RAW: emit(x->text, x->len); break;
+        case IN_CODE:
+            if (!*plain) emit_str("<code>");
+            emit_code_text(x->text, x->len);
+            if (!*plain) emit_str("</code>");
+            break;
+        case IN_SOFTBREAK: emit_char(*plain ? ' ' : '\n'); break;
+        case IN_HARDBREAK: emit_str(*plain ? " " : "<br />\n"); break;
+        case IN_EMPH: if (!*plain) emit_str("<em>"); break;
+        case IN_STRONG: if (!*plain) emit_str("<strong>"); break;
+        case IN_DEL: if (!*plain) emit_str("<del>"); break;
+        case IN_LINK:
+            if (*plain) break;
+            emit_str("<a href=\"");
+            emit_url(x->url, x->url_len);
+            if (x->title) {
+                emit_str("\" title=\"");
+                emit_attr(x->title, x->title_len);
+            }
+            emit_str("\">");
+            break;
+        case IN_IMAGE:
+            if (!(*plain)++) {
+                emit_str("<img src=\"");
+                emit_url(x->url, x->url_len);
+                emit_str("\" alt=\"");
+            }
+            break;
+        case IN_AUTOLINK:
+            if (!*plain) {
+                emit_str("<a href=\"");
+                if (x->mailto) emit_str("mailto:");
+                if (opt_unsafe || x->mailto || !url_unsafe(x->text, x->len)) emit_href(x->text, x->len);
+                emit_str("\">");
+            }
+            emit_escaped(x->text, x->len);
+            if (!*plain) emit_str("</a>");
+            break;
+        case IN_HTML:
+            if (*plain) emit_escaped(x->text, x->len);
+            else if (opt_unsafe) emit(x->text, x->len);
+            else emit_str("<!-- raw HTML omitted -->");
+            break;
+    }
+}
+
+static void inline_exit(const Inline *x, int *plain) {
+    switch (x->type) {
+        case IN_EMPH: if (!*plain) emit_str("</em>"); break;
+        case IN_STRONG: if (!*plain) emit_str("</strong>"); break;
+        case IN_DEL: if (!*plain) emit_str("</del>"); break;
+        case IN_LINK: if (!*plain) emit_str("</a>"); break;
+        case IN_IMAGE:
+            if (--(*plain)) break;
+            if (x->title) {
+                emit_str("\" title=\"");
+                emit_attr(x->title, x->title_len);
+            }
+            emit_str("\" />");
+            break;
+    }
+}
+
+/* Parse and write the inline content of one leaf */
+static void render_inlines(RefMap *refs, const char *s, size_t n) {
+    while (n > 0 && is_ws((unsigned char)*s)) {
+        s++;
+        n--;
+    }
+    while (n > 0 && is_ws((unsigned char)s[n - 1])) n--;
+    if (n == 0) return;
+
+    InlineParser *ip = &inline_parser;
+    ip->s = s;
+    ip->n = n;
+    ip->pos = 0;
+    memset(&ip->root, 0, sizeof(ip->root));
+    ip->delims = NULL;
+    ip->brackets = NULL;
+    ip->refs = refs;
+    ip->backticks_ready = ip->backticks_scanned = 0;
+    ip->no_comment_end = ip->no_pi_end = ip->no_cdata_end = ip->no_decl_end = 0;
+    parse_inlines(ip);
+
+    // Walk the tree without recursion: nesting depth is unbounded
+    int plain = 0;
+    Inline *x = ip->root.first;
+    while (x) {
+        inline_enter(x, &plain);
+        if (x->first) {
+            x = x->first;
+            continue;
+        }
+        inline_exit(x, &plain);
+        while (!x->next && x->parent != &ip->root) {
+            x = x->parent;
+            inline_exit(x, &plain);
+        }
+        x = x->next;
+    }
+    arena_reset(&ip->arena);
+}
+
+/* ---- Block phase ---- */
+
+enum {
+    B_DOCUMENT, B_QUOTE, B_LIST, B_ITEM, B_PARAGRAPH, B_HEADING, B_THEMATIC, B_CODE, B_HTML, B_TABLE
+};
+
+enum { ALIGN_NONE, ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
+
+typedef struct Block {
+    int type;
+    int open;
+    struct Block *parent, *first, *last, *prev, *next;
+    int start_line, end_line;
+    TextBuf content;
+    /* Lists and items */
+    int ordered;
+    char marker;                /* Bullet character, or '.' / ')' after a number */
+    int start;
+    int marker_offset, padding;
+    int tight;
+    /* Headings */
+    int level;
+    /* Code blocks */
+    int fenced;
+    char fence_char;
+    int fence_len, fence_offset;
+    int last_text_line;
+    /* HTML blocks: start condition 1-7 */
+    int html_type;
+    /* Tables */
+    int cols;
+    unsigned char *align;
+} Block;
+
+typedef struct {
+    Block *doc, *tip, *oldtip, *last_matched;
+    const char *line;
+    size_t len;
+    size_t offset, next_nonspace;
+    int column, next_nonspace_column, indent;
+    int indented, blank, partially_consumed_tab, all_closed;
+    int nonspace_known;         /* next_nonspace is valid for this line */
+    int line_number;
+    int defer;                  /* Hold output to the end: references may follow */
+    RefMap refs;
+    TextBuf align;
+} Parser;
+
+static void render_block(Parser *p, Block *root);
+
+static Block *block_new(int type, int line) {
+    Block *b = (Block *)calloc(1, sizeof(Block));
+    if (!b) out_of_memory();
+    b->type = type;
+    b->open = 1;
+    b->start_line = b->end_line = line;
+    return b;
+}
+
+static void block_append(Block *parent, Block *b) {
+    b->parent = parent;
+    b->prev = parent->last;
+    if (parent->last) parent->last->next = b;
+    else parent->first = b;
+    parent->last = b;
+}
+
+static void block_unlink(Block *b) {
+    if (b->prev) b->prev->next = b->next;
+    else b->parent->first = b->next;
+    if (b->next) b->next->prev = b->prev;
+    else b->parent->last = b->prev;
+    b->prev = b->next = NULL;
+}
+
+/* Free an unlinked subtree, children first, without recursion */
+static void block_free(Block *root) {
+    Block *b = root;
+    while (b) {
+        if (b->first) {
+            b = b->first;
+            continue;
+        }
+        Block *next = NULL;
+        if (b != root) {
+            b->parent->first = b->next;
+            next = b->next ? b->next : b->parent;
+        }
+        buf_free(&b->content);
+        free(b->align);
+        free(b);
+        b = next;
+    }
+}
+
+static int can_contain(int parent, int child) {
+    if (parent == B_DOCUMENT || parent == B_QUOTE || parent == B_ITEM) return child != B_ITEM;
+    return parent == B_LIST && child == B_ITEM;
+}
+
+static int accepts_lines(int type) {
+    return type == B_PARAGRAPH || type == B_CODE || type == B_HTML || type == B_TABLE;
+}
+
+static int peek(const Parser *p, size_t i) {
+    return i < p->len ? (unsigned char)p->line[i] : -1;
+}
+
+/*
+ * The first non-space character and its column do not depend on where in
+ * the leading whitespace the scan starts, so a scan is reused until the
+ * offset moves past it; deep nesting would otherwise rescan the indent
+ * once per container.
+ */
+static void find_next_nonspace(Parser *p) {
+    if (!p->nonspace_known || p->offset > p->next_nonspace) {
+        size_t i = p->offset;
+        int cols = p->column;
+        while (i < p->len) {
+            char c = p->line[i];
+            if (c == ' ') cols++;
+            else if (c == '\t') cols += TAB_STOP - cols % TAB_STOP;
+            else break;
+            i++;
+        }
+        p->next_nonspace = i;
+        p->next_nonspace_column = cols;
+        p->nonspace_known = 1;
+    }
+    p->blank = p->next_nonspace >= p->len;
+    p->indent = p->next_nonspace_column - p->column;
+    p->indented = p->indent >= CODE_INDENT;
+}
+
+static void advance_next_nonspace(Parser *p) {
+    p->offset = p->next_nonspace;
+    p->column = p->next_nonspace_column;
+    p->partially_consumed_tab = 0;
+}
+
+/* Advance by count bytes, or by count columns, where a tab may be split */
+static void advance_offset(Parser *p, int count, int columns) {
+    while (count > 0 && p->offset < p->len) {
+        if (p->line[p->offset] == '\t') {
+            int to_tab = TAB_STOP - p->column % TAB_STOP;
+            if (columns) {
+                p->partially_consumed_tab = to_tab > count;
+                int step = to_tab > count ? count : to_tab;
+                p->column += step;
+                if (!p->partially_consumed_tab) p->offset++;
+                count -= step;
+            } else {
+                p->partially_consumed_tab = 0;
+                p->column += to_tab;
+                p->offset++;
+                count--;
             }
+        } else {
+            p->partially_consumed_tab = 0;
+            p->offset++;
+            p->column++;
+            count--;
         }
+    }
+}
 
-        // Link: [text](url)
-        if (*p == '[') {
-            const char *text_start = p + 1;
-            const char *text_end = strchr(text_start, ']');
-            if (text_end && *(text_end + 1) == '(') {
-                const char *url_start = text_end + 2;
-                const char *url_end = strchr(url_start, ')');
-                if (url_end) {
-                    printf("<a href=\"");
-                    for (const char *c = url_start; c < url_end; c++) {
-                        putchar(*c);
+static void add_line(Parser *p) {
+    Block *b = p->tip;
+    if (p->partially_consumed_tab) {
+        p->offset++;
+        buf_append(&b->content, "    ", (size_t)(TAB_STOP - p->column % TAB_STOP));
+    }
+    if (p->offset < p->len) buf_append(&b->content, p->line + p->offset, p->len - p->offset);
+    buf_append(&b->content, "\n", 1);
+    if (b->type == B_CODE && !p->blank) b->last_text_line = p->line_number;
+}
+
+/* Parse one "[label]: dest 'title'" at s[0]; bytes consumed, or 0 */
+static size_t parse_reference(Parser *p, const char *s, size_t n) {
+    size_t k = scan_link_label(s, n, 0);
+    if (k < 3 || k >= n || s[k] != ':') return 0;
+    size_t i = skip_spnl(s, n, k + 1), dest_end, ds, dl;
+    if (!scan_link_dest(s, n, i, &dest_end, &ds, &dl)) return 0;
+    if (dl == 0 && s[i] != '<') return 0;
+    size_t t = skip_spnl(s, n, dest_end), title_end = 0, ts = 0, tl = 0, end;
+    int has_title = t != dest_end && scan_link_title(s, n, t, &title_end, &ts, &tl);
+    if (!has_title || !at_line_end(s, n, title_end, &end)) {
+        // The title may be missing, or a bad title may just be the next paragraph line
+        has_title = 0;
+        if (!at_line_end(s, n, dest_end, &end)) return 0;
+    }
+    if (!ref_define(&p->refs, s + 1, k - 2, s + ds, dl, has_title ? s + ts : NULL, tl)) return 0;
+    return end;
+}
+
+/* Take reference definitions off the front of a paragraph */
+static void strip_references(Parser *p, Block *b) {
+    size_t used = 0, n;
+    TextBuf *c = &b->content;
+    while (used < c->len && c->data[used] == '[' && (n = parse_reference(p, c->data + used, c->len - used)) > 0) {
+        used += n;
+    }
+    if (!used) return;
+    memmove(c->data, c->data + used, c->len - used);
+    c->len -= used;
+}
+
+static int text_blank(const TextBuf *b) {
+    for (size_t i = 0; i < b->len; i++) {
+        if (!is_ws((unsigned char)b->data[i])) return 0;
+    }
+    return 1;
+}
+
+/* A "]" not opening an inline link may be a reference defined further on */
+static void note_references(Parser *p, const Block *b) {
+    const char *s = b->content.data;
+    size_t n = b->content.len;
+    for (size_t i = 0; i < n && !p->defer; i++) {
+        const char *close = (const char *)memchr(s + i, ']', n - i);
+        if (!close) break;
+        i = (size_t)(close - s);
+        if ((i == 0 || s[i - 1] != '\\') && (i + 1 >= n || s[i + 1] != '(')) p->defer = 1;
+    }
+}
+
+static int ends_with_blank_line(const Block *b) {
+    return b->next && b->end_line < b->next->start_line - 1;
+}
+
+static void finalize(Parser *p, Block *b, int line) {
+    Block *parent = b->parent;
+    b->open = 0;
+    b->end_line = line;
+    p->tip = parent;
+
+    switch (b->type) {
+        case B_PARAGRAPH:
+            strip_references(p, b);
+            if (text_blank(&b->content)) {
+                block_unlink(b);
+                block_free(b);
+                return;
+            }
+            note_references(p, b);
+            break;
+        case B_HEADING:
+        case B_TABLE:
+            note_references(p, b);
+            break;
+        case B_CODE:
+            if (!b->fenced) {
+                // Trailing blank lines are not part of an indented code block
+                TextBuf *c = &b->content;
+                for (;;) {
+                    size_t i = c->len - 1;
+                    while (i > 0 && is_space_or_tab(c->data[i - 1])) i--;
+                    if (i == 0 || c->data[i - 1] != '\n') break;
+                    c->len = i;
+                }
+                b->end_line = b->last_text_line;
+            }
+            break;
+        case B_HTML: {
+            TextBuf *c = &b->content;
+            for (;;) {
+                size_t i = c->len;
+                while (i > 0 && c->data[i - 1] == ' ') i--;
+                if (i == 0 || c->data[i - 1] != '\n') break;
+                c->len = i - 1;
+            }
+            break;
+        }
+        case B_ITEM:
+            b->end_line = b->last ? b->last->end_line : b->start_line;
+            break;
+        case B_LIST:
+            b->tight = 1;
+            for (Block *item = b->first; item && b->tight; item = item->next) {
+                if (ends_with_blank_line(item)) b->tight = 0;
+                for (Block *sub = item->first; sub && b->tight; sub = sub->next) {
+                    if (ends_with_blank_line(sub)) b->tight = 0;
+                }
+            }
+            if (b->last) b->end_line = b->last->end_line;
+            break;
+    }
+
+    if (parent == p->doc && !p->defer) {
+        render_block(p, b);
+        block_unlink(b);
+        block_free(b);
+    }
+}
+
+static void close_unmatched(Parser *p) {
+    if (p->all_closed) return;
+    while (p->oldtip != p->last_matched) {
+        Block *parent = p->oldtip->parent;
+        finalize(p, p->oldtip, p->line_number - 1);
+        p->oldtip = parent;
+    }
+    p->all_closed = 1;
+}
+
+static Block *add_child(Parser *p, int type) {
+    while (!can_contain(p->tip->type, type)) finalize(p, p->tip, p->line_number - 1);
+    Block *b = block_new(type, p->line_number);
+    block_append(p->tip, b);
+    p->tip = b;
+    return b;
+}
+
+/* 0: the line continues the block, 1: it does not, 2: it closed a fence and is used up */
+static int block_continue(Parser *p, Block *b) {
+    switch (b->type) {
+        case B_QUOTE:
+            if (p->indented || peek(p, p->next_nonspace) != '>') return 1;
+            advance_next_nonspace(p);
+            advance_offset(p, 1, 0);
+            if (is_space_or_tab(peek(p, p->offset))) advance_offset(p, 1, 1);
+            return 0;
+        case B_ITEM:
+            if (p->blank) {
+                if (!b->first) return 1;
+                advance_next_nonspace(p);
+            } else if (p->indent >= b->marker_offset + b->padding) {
+                advance_offset(p, b->marker_offset + b->padding, 1);
+            } else {
+                return 1;
+            }
+            return 0;
+        case B_CODE:
+            if (b->fenced) {
+                if (p->indent <= 3 && peek(p, p->next_nonspace) == b->fence_char) {
+                    size_t i = p->next_nonspace;
+                    while (i < p->len && p->line[i] == b->fence_char) i++;
+                    size_t run = i - p->next_nonspace;
+                    while (i < p->len && is_space_or_tab(p->line[i])) i++;
+                    if (run >= (size_t)b->fence_len && i == p->len) {
+                        finalize(p, b, p->line_number);
+                        return 2;
                     }
-                    printf("\">");
-                    for (const char *c = text_start; c < text_end; c++) {
-                        if (*c == '<') printf("&lt;");
-                        else if (*c == '>') printf("&gt;");
-                        else if (*c == '&') printf("&amp;");
-                        else putchar(*c);
+                }
+                for (int i = b->fence_offset; i > 0 && is_space_or_tab(peek(p, p->offset)); i--) {
+                    advance_offset(p, 1, 1);
+                }
+                return 0;
+            }
+            if (p->indent >= CODE_INDENT) advance_offset(p, CODE_INDENT, 1);
+            else if (p->blank) advance_next_nonspace(p);
+            else return 1;
+            return 0;
+        case B_HTML:
+            return p->blank && (b->html_type == 6 || b->html_type == 7);
+        case B_PARAGRAPH:
+        case B_TABLE:
+            return p->blank;
+        case B_HEADING:
+        case B_THEMATIC:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static const char *const html_raw_tags[] = {"script", "pre", "textarea", "style"};
+
+static const char *const html_block_tags[] = {
+    "address", "article", "aside", "base", "basefont", "blockquote", "body", "caption", "center",
+    "col", "colgroup", "dd", "details", "dialog", "dir", "div", "dl", "dt", "fieldset", "figcaption",
+    "figure", "footer", "form", "frame", "frameset", "h1", "h2", "h3", "h4", "h5", "h6", "head",
+    "header", "hr", "html", "iframe", "legend", "li", "link", "main", "menu", "menuitem", "nav",
+    "noframes", "ol", "optgroup", "option", "p", "param", "search", "section", "summary", "table",
+    "tbody", "td", "tfoot", "th", "thead", "title", "tr", "track", "ul",
+};
+
+static int tag_in(const char *s, size_t n, const char *const *tags, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (strlen(tags[i]) == n && has_prefix_nocase(s, n, tags[i])) return 1;
+    }
+    return 0;
+}
+
+/* HTML block start condition (1-7) for a line beginning with '<', or 0 */
+static int html_block_start(const char *s, size_t n, int may_interrupt) {
+    for (size_t i = 0; i < 4; i++) {
+        size_t len = strlen(html_raw_tags[i]);
+        if (n > len && has_prefix_nocase(s + 1, n - 1, html_raw_tags[i]) &&
+            (n == len + 1 || is_ws((unsigned char)s[len + 1]) || s[len + 1] == '>')) {
+            return 1;
+        }
+    }
+    if (n >= 4 && memcmp(s, "<!--", 4) == 0) return 2;
+    if (n >= 2 && s[1] == '?') return 3;
+    if (n >= 9 && memcmp(s, "<![CDATA[", 9) == 0) return 5;
+    if (n >= 3 && s[1] == '!' && isalpha((unsigned char)s[2])) return 4;
+
+    size_t name = s[1] == '/' ? 2 : 1;
+    size_t i = name;
+    while (i < n && isalnum((unsigned char)s[i])) i++;
+    if (tag_in(s + name, i - name, html_block_tags, sizeof(html_block_tags) / sizeof(html_block_tags[0])) &&
+        (i == n || is_ws((unsigned char)s[i]) || s[i] == '>' || (s[i] == '/' && i + 1 < n && s[i + 1] == '>'))) {
+        return 6;
+    }
+
+    if (!may_interrupt) return 0;
+    size_t k = s[1] == '/' ? scan_close_tag(s, n, 0) : scan_open_tag(s, n, 0);
+    if (!k) return 0;
+    i = scan_tag_name(s, n, name);
+    if (tag_in(s + name, i - name, html_raw_tags, 4)) return 0;
+    while (k < n && is_space_or_tab(s[k])) k++;
+    return k == n ? 7 : 0;
+}
+
+static int html_block_ends(int type, const char *s, size_t n) {
+    switch (type) {
+        case 1:
+            for (const char *lt = s; (lt = (const char *)memchr(lt, '<', (size_t)(s + n - lt))); lt++) {
+                size_t rest = (size_t)(s + n - lt);
+                for (size_t i = 0; i < 4; i++) {
+                    size_t len = strlen(html_raw_tags[i]);
+                    if (rest >= len + 3 && lt[1] == '/' && has_prefix_nocase(lt + 2, rest - 2, html_raw_tags[i]) &&
+                        lt[len + 2] == '>') {
+                        return 1;
                     }
-                    printf("</a>");
-                    p = url_end + 1;
-                    continue;
                 }
             }
+            return 0;
+        case 2: return find_str(s, n, "-->") != NULL;
+        case 3: return find_str(s, n, "?>") != NULL;
+        case 4: return memchr(s, '>', n) != NULL;
+        case 5: return find_str(s, n, "]]>") != NULL;
+        default: return 0;
+    }
+}
+
+/* Split a table row on unescaped pipes; returns the cell count, storing up to max */
+static size_t split_row(const char *s, size_t n, LineSpan *cells, size_t max) {
+    while (n > 0 && is_ws((unsigned char)s[n - 1])) n--;
+    size_t i = 0;
+    while (i < n && is_space_or_tab(s[i])) i++;
+    if (i < n && s[i] == '|') i++;
+    size_t count = 0, start = i;
+    for (;;) {
+        if (i < n && s[i] == '\\' && i + 1 < n) {
+            i += 2;
+            continue;
+        }
+        if (i < n && s[i] != '|') {
+            i++;
+            continue;
         }
+        if (i == n && start == n && count > 0) break;
+        if (count < max) {
+            cells[count].ptr = s + start;
+            cells[count].len = i - start;
+        }
+        count++;
+        if (i == n) break;
+        start = ++i;
+    }
+    return count;
+}
 
-        // Regular character
-        if (*p == '<') printf("&lt;");
-        else if (*p == '>') printf("&gt;");
-        else if (*p == '&') printf("&amp;");
-        else putchar(*p);
-        p++;
+/* GFM delimiter row such as "| :-- | :-: |": column count with alignments in p->align, or 0 */
+static int parse_delimiter_row(Parser *p, const char *s, size_t n) {
+    size_t i = 0;
+    int pipes = 0, cols = 0;
+    p->align.len = 0;
+    if (i < n && s[i] == '|') {
+        pipes++;
+        i++;
     }
+    for (;;) {
+        while (i < n && is_space_or_tab(s[i])) i++;
+        if (i == n) break;
+        int left = 0, right = 0;
+        size_t dashes = 0;
+        if (s[i] == ':') {
+            left = 1;
+            i++;
+        }
+        while (i < n && s[i] == '-') {
+            dashes++;
+            i++;
+        }
+        if (!dashes) return 0;
+        if (i < n && s[i] == ':') {
+            right = 1;
+            i++;
+        }
+        while (i < n && is_space_or_tab(s[i])) i++;
+        unsigned char a = left && right ? ALIGN_CENTER : left ? ALIGN_LEFT : right ? ALIGN_RIGHT : ALIGN_NONE;
+        buf_append(&p->align, (const char *)&a, 1);
+        cols++;
+        if (i == n) break;
+        if (s[i] != '|') return 0;
+        pipes++;
+        i++;
+    }
+    return pipes ? cols : 0;
 }
 
-// Process a single line
-void process_line(const char *line, int *in_code_block, int *in_list) {
-    // Skip leading whitespace for analysis
-    const char *trimmed = line;
-    while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
+/* A delimiter row under a one-line header turns the paragraph's last line into a table */
+static int start_table(Parser *p, Block *para) {
+    int cols = parse_delimiter_row(p, p->line + p->next_nonspace, p->len - p->next_nonspace);
+    if (!cols) return 0;
+    TextBuf *c = &para->content;
+    size_t end = c->len - 1, start = end;
+    while (start > 0 && c->data[start - 1] != '\n') start--;
+    if (split_row(c->data + start, end - start, NULL, 0) != (size_t)cols) return 0;
 
-    // Code block
-    if (strncmp(trimmed, "```", 3) == 0) {
-        if (*in_code_block) {
-            printf("</code></pre>\n");
-            *in_code_block = 0;
-        } else {
-            printf("<pre><code>");
-            *in_code_block = 1;
+    char *header = (char *)malloc(end - start + 1);
+    if (!header) out_of_memory();
+    memcpy(header, c->data + start, end - start + 1);
+    size_t header_len = end - start + 1;
+
+    Block *table;
+    if (start == 0) {
+        table = para;
+        table->type = B_TABLE;
+        c->len = 0;
+    } else {
+        c->len = start;
+        finalize(p, para, p->line_number - 2);
+        table = add_child(p, B_TABLE);
+        table->start_line = p->line_number - 1;
+    }
+    buf_append(&table->content, header, header_len);
+    free(header);
+    table->cols = cols;
+    table->align = (unsigned char *)malloc((size_t)cols);
+    if (!table->align) out_of_memory();
+    memcpy(table->align, p->align.data, (size_t)cols);
+    return 1;
+}
+
+typedef struct {
+    int ordered;
+    char marker;
+    int start;
+    int marker_offset, padding;
+} ListMarker;
+
+static int parse_list_marker(Parser *p, const Block *container, ListMarker *m) {
+    if (p->indent >= 4) return 0;
+    size_t i = p->next_nonspace, mlen;
+    int c = peek(p, i);
+    if (c == '*' || c == '+' || c == '-') {
+        m->ordered = 0;
+        m->marker = (char)c;
+        m->start = 0;
+        mlen = 1;
+    } else if (c >= '0' && c <= '9') {
+        size_t j = i;
+        long v = 0;
+        while (j < p->len && j - i < 10 && isdigit((unsigned char)p->line[j])) v = v * 10 + (p->line[j++] - '0');
+        if (j - i > 9 || j >= p->len || (p->line[j] != '.' && p->line[j] != ')')) return 0;
+        // Only a list starting at 1 may interrupt a paragraph
+        if (container->type == B_PARAGRAPH && v != 1) return 0;
+        m->ordered = 1;
+        m->marker = p->line[j];
+        m->start = (int)v;
+        mlen = j - i + 1;
+    } else {
+        return 0;
+    }
+    int next = peek(p, i + mlen);
+    if (next != -1 && !is_space_or_tab(next)) return 0;
+    if (container->type == B_PARAGRAPH) {
+        size_t k = i + mlen;
+        while (k < p->len && is_space_or_tab(p->line[k])) k++;
+        if (k == p->len) return 0;
+    }
+
+    advance_next_nonspace(p);
+    advance_offset(p, (int)mlen, 1);
+    int spaces_col = p->column;
+    size_t spaces_offset = p->offset;
+    do {
+        advance_offset(p, 1, 1);
+        next = peek(p, p->offset);
+    } while (p->column - spaces_col < 5 && is_space_or_tab(next));
+    int spaces = p->column - spaces_col;
+    if (spaces >= 5 || spaces < 1 || peek(p, p->offset) == -1) {
+        // Content starts one space after the marker
+        m->padding = (int)mlen + 1;
+        p->column = spaces_col;
+        p->offset = spaces_offset;
+        if (is_space_or_tab(peek(p, p->offset))) advance_offset(p, 1, 1);
+    } else {
+        m->padding = (int)mlen + spaces;
+    }
+    m->marker_offset = p->indent;
+    return 1;
+}
+
+static int thematic_break(const char *s, size_t n) {
+    char c = s[0];
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == c) count++;
+        else if (!is_space_or_tab(s[i])) return 0;
+    }
+    return count >= 3;
+}
+
+/* Try each kind of block start: 0 none, 1 a container opened, 2 a leaf opened,
+ * 3 a table opened on its delimiter row, which is used up */
+static int start_block(Parser *p, Block *container) {
+    const char *rest = p->line + p->next_nonspace;
+    size_t rest_len = p->len - p->next_nonspace;
+    int c = peek(p, p->next_nonspace);
+
+    if (!p->indented) {
+        if (c == '>') {
+            advance_next_nonspace(p);
+            advance_offset(p, 1, 0);
+            if (is_space_or_tab(peek(p, p->offset))) advance_offset(p, 1, 1);
+            close_unmatched(p);
+            add_child(p, B_QUOTE);
+            return 1;
+        }
+
+        if (c == '#') {
+            size_t level = 0;
+            while (level < rest_len && rest[level] == '#' && level < 7) level++;
+            if (level <= 6 && (level == rest_len || is_space_or_tab(rest[level]))) {
+                close_unmatched(p);
+                Block *h = add_child(p, B_HEADING);
+                h->level = (int)level;
+                const char *s = rest + level;
+                size_t n = rest_len - level;
+                while (n > 0 && is_space_or_tab(*s)) {
+                    s++;
+                    n--;
+                }
+                while (n > 0 && is_space_or_tab(s[n - 1])) n--;
+                // Optional closing sequence of #s after a space
+                size_t j = n;
+                while (j > 0 && s[j - 1] == '#') j--;
+                if (j == 0) {
+                    n = 0;
+                } else if (j < n && is_space_or_tab(s[j - 1])) {
+                    n = j;
+                    while (n > 0 && is_space_or_tab(s[n - 1])) n--;
+                }
+                buf_append(&h->content, s, n);
+                p->offset = p->len;
+                return 2;
+            }
+        }
+
+        if (c == '`' || c == '~') {
+            size_t run = 0;
+            while (run < rest_len && rest[run] == c) run++;
+            if (run >= 3 && (c == '~' || !memchr(rest + run, '`', rest_len - run))) {
+                close_unmatched(p);
+                Block *code = add_child(p, B_CODE);
+                code->fenced = 1;
+                code->fence_char = (char)c;
+                code->fence_len = (int)run;
+                code->fence_offset = p->indent;
+                advance_next_nonspace(p);
+                advance_offset(p, (int)run, 0);
+                return 2;
+            }
+        }
+
+        if (c == '<') {
+            int lazy = !p->all_closed && !p->blank && p->tip->type == B_PARAGRAPH;
+            int type = html_block_start(rest, rest_len, container->type != B_PARAGRAPH && !lazy);
+            if (type) {
+                close_unmatched(p);
+                add_child(p, B_HTML)->html_type = type;
+                return 2;
+            }
+        }
+
+        if (container->type == B_PARAGRAPH && (c == '|' || c == ':' || c == '-') && start_table(p, container)) {
+            return 3;
+        }
+
+        if (container->type == B_PARAGRAPH && (c == '=' || c == '-')) {
+            size_t i = 0;
+            while (i < rest_len && rest[i] == c) i++;
+            while (i < rest_len && is_space_or_tab(rest[i])) i++;
+            if (i == rest_len) {
+                close_unmatched(p);
+                strip_references(p, container);
+                if (!text_blank(&container->content)) {
+                    container->type = B_HEADING;
+                    container->level = c == '=' ? 1 : 2;
+                    p->offset = p->len;
+                    return 2;
+                }
+            }
+        }
+
+        if ((c == '*' || c == '-' || c == '_') && thematic_break(rest, rest_len)) {
+            close_unmatched(p);
+            add_child(p, B_THEMATIC);
+            p->offset = p->len;
+            return 2;
         }
-        return;
     }
 
-    if (*in_code_block) {
-        print_escaped(line);
-        putchar('\n');
-        return;
+    ListMarker m;
+    if ((!p->indented || container->type == B_LIST) && parse_list_marker(p, container, &m)) {
+        close_unmatched(p);
+        Block *list = p->tip;
+        if (list->type != B_LIST || list->ordered != m.ordered || list->marker != m.marker) {
+            list = add_child(p, B_LIST);
+            list->ordered = m.ordered;
+            list->marker = m.marker;
+            list->start = m.start;
+        }
+        Block *item = add_child(p, B_ITEM);
+        item->marker_offset = m.marker_offset;
+        item->padding = m.padding;
+        return 1;
+    }
+
+    if (p->indented && p->tip->type != B_PARAGRAPH && p->tip->type != B_TABLE && !p->blank) {
+        advance_offset(p, CODE_INDENT, 1);
+        close_unmatched(p);
+        add_child(p, B_CODE);
+        return 2;
     }
+    return 0;
+}
+
+/* First characters that can begin a block other than a paragraph */
+static int maybe_special(int c) {
+    return c >= 0 && (isdigit(c) || in_set(c, "#`~*+_=<>-|:"));
+}
 
-    // Empty line
-    if (*trimmed == '\0') {
-        if (*in_list) {
-            printf("</ul>\n");
-            *in_list = 0;
+static void incorporate_line(Parser *p, const char *line, size_t len) {
+    p->line = line;
+    p->len = len;
+    p->offset = 0;
+    p->column = 0;
+    p->blank = 0;
+    p->partially_consumed_tab = 0;
+    p->nonspace_known = 0;
+    p->line_number++;
+    p->oldtip = p->tip;
+
+    // Match the line against the open containers
+    Block *container = p->doc, *last;
+    while ((last = container->last) && last->open) {
+        container = last;
+        find_next_nonspace(p);
+        int r = block_continue(p, container);
+        if (r == 2) return;
+        if (r == 1) {
+            container = container->parent;
+            break;
         }
-        printf("\n");
-        return;
     }
+    p->all_closed = container == p->oldtip;
+    p->last_matched = container;
 
-    // Headers
-    if (*trimmed == '#') {
-        int level = 0;
-        const char *p = trimmed;
-        while (*p == '#' && level < 6) { level++; p++; }
-        if (*p == ' ') {
-            p++;
-            printf("<h%d>", level);
-            process_inline(p);
-            printf("</h%d>\n", level);
-            return;
+    // Open new blocks
+    int matched_leaf = container->type != B_PARAGRAPH && container->type != B_TABLE && accepts_lines(container->type);
+    while (!matched_leaf) {
+        find_next_nonspace(p);
+        if (!p->indented && !maybe_special(peek(p, p->next_nonspace))) {
+            advance_next_nonspace(p);
+            break;
+        }
+        int r = start_block(p, container);
+        if (r == 3) return;
+        if (r == 0) {
+            advance_next_nonspace(p);
+            break;
         }
+        container = p->tip;
+        matched_leaf = r == 2;
     }
 
-    // Horizontal rule
-    if ((strncmp(trimmed, "---", 3) == 0 || strncmp(trimmed, "***", 3) == 0 ||
-         strncmp(trimmed, "___", 3) == 0)) {
-        printf("<hr>\n");
+    // The rest of the line is text for the innermost block
+    if (!p->all_closed && !p->blank && p->tip->type == B_PARAGRAPH) {
+        add_line(p);    // Lazy paragraph continuation
         return;
     }
+    close_unmatched(p);
+    if (accepts_lines(container->type)) {
+        add_line(p);
+        if (container->type == B_HTML && container->html_type <= 5 &&
+            html_block_ends(container->html_type, p->line + p->offset, p->len - p->offset)) {
+            finalize(p, container, p->line_number);
+        }
+    } else if (p->offset < p->len && !p->blank) {
+        add_child(p, B_PARAGRAPH);
+        advance_next_nonspace(p);
+        add_line(p);
+    }
+}
+
+/* ---- Block output ---- */
 
-    // Unordered list
-    if ((*trimmed == '-' || *trimmed == '*' || *trimmed == '+') && *(trimmed + 1) == ' ') {
-        if (!*in_list) {
-            printf("<ul>\n");
-            *in_list = 1;
+static int in_tight_list(const Block *b) {
+    return b->parent && b->parent->type == B_ITEM && b->parent->parent->tight;
+}
+
+static void render_code(const Block *b) {
+    const char *s = b->content.data;
+    size_t n = b->content.len;
+    cr();
+    if (!b->fenced) {
+        emit_str("<pre><code>");
+    } else {
+        // The first line holds the info string; its first word names the language
+        const char *nl = (const char *)memchr(s, '\n', n);
+        size_t info_len = nl ? (size_t)(nl - s) : n;
+        unescape_into(&scratch, s, info_len);
+        size_t i = 0, word;
+        while (i < scratch.len && is_ws((unsigned char)scratch.data[i])) i++;
+        for (word = i; word < scratch.len && !is_ws((unsigned char)scratch.data[word]);) word++;
+        if (word > i) {
+            emit_str("<pre><code class=\"language-");
+            emit_escaped(scratch.data + i, word - i);
+            emit_str("\">");
+        } else {
+            emit_str("<pre><code>");
         }
-        printf("<li>");
-        process_inline(trimmed + 2);
-        printf("</li>\n");
-        return;
+        s += nl ? info_len + 1 : n;
+        n -= nl ? info_len + 1 : n;
     }
+    emit_escaped(s, n);
+    emit_str("</code></pre>\n");
+}
 
-    // Ordered list
-    if (isdigit((unsigned char)*trimmed)) {
-        const char *p = trimmed;
-        while (isdigit((unsigned char)*p)) p++;
-        if (*p == '.' && *(p + 1) == ' ') {
-            if (!*in_list) {
-                printf("<ol>\n");
-                *in_list = 2;
+static void render_row(Parser *p, const Block *b, const char *row, size_t len, LineSpan *cells, int header) {
+    size_t count = split_row(row, len, cells, (size_t)b->cols);
+    static const char *const align_attr[] = {"", " align=\"left\"", " align=\"center\"", " align=\"right\""};
+    emit_str("<tr>\n");
+    for (int i = 0; i < b->cols; i++) {
+        emit_str(header ? "<th" : "<td");
+        emit_str(align_attr[b->align[i]]);
+        emit_char('>');
+        if ((size_t)i < count) {
+            // "\|" stands for a literal pipe, even inside code spans
+            const char *s = cells[i].ptr;
+            size_t n = cells[i].len;
+            cell_buf.len = 0;
+            for (size_t k = 0; k < n; k++) {
+                if (s[k] == '\\' && k + 1 < n && s[k + 1] == '|') continue;
+                buf_append(&cell_buf, s + k, 1);
             }
-            printf("<li>");
-            process_inline(p + 2);
-            printf("</li>\n");
-            return;
+            render_inlines(&p->refs, cell_buf.data, cell_buf.len);
         }
+        emit_str(header ? "</th>\n" : "</td>\n");
     }
+    emit_str("</tr>\n");
+}
 
-    // Blockquote
-    if (*trimmed == '>') {
-        const char *content = trimmed + 1;
-        if (*content == ' ') content++;
-        printf("<blockquote>");
-        process_inline(content);
-        printf("</blockquote>\n");
-        return;
+static void render_table(Parser *p, const Block *b) {
+    LineSpan *cells = (LineSpan *)malloc((size_t)b->cols * sizeof(LineSpan));
+    if (!cells) out_of_memory();
+    const char *s = b->content.data, *end = s + b->content.len;
+    cr();
+    emit_str("<table>\n<thead>\n");
+    for (int row = 0; s < end; row++) {
+        const char *nl = (const char *)memchr(s, '\n', (size_t)(end - s));
+        if (!nl) nl = end;
+        if (row == 1) emit_str("<tbody>\n");
+        render_row(p, b, s, (size_t)(nl - s), cells, row == 0);
+        if (row == 0) emit_str("</thead>\n");
+        s = nl + 1;
+    }
+    if (memchr(b->content.data, '\n', b->content.len) != b->content.data + b->content.len - 1) {
+        emit_str("</tbody>\n");
     }
+    emit_str("</table>\n");
+    free(cells);
+}
 
-    // Close list if open
-    if (*in_list) {
-        printf(*in_list == 1 ? "</ul>\n" : "</ol>\n");
-        *in_list = 0;
+static void block_enter(Parser *p, const Block *b) {
+    switch (b->type) {
+        case B_QUOTE:
+            cr();
+            emit_str("<blockquote>\n");
+            break;
+        case B_LIST:
+            cr();
+            if (!b->ordered) {
+                emit_str("<ul>\n");
+            } else if (b->start == 1) {
+                emit_str("<ol>\n");
+            } else {
+                emit_str("<ol start=\"");
+                emit_uint((unsigned long long)b->start);
+                emit_str("\">\n");
+            }
+            break;
+        case B_ITEM:
+            cr();
+            emit_str("<li>");
+            break;
+        case B_PARAGRAPH:
+            if (!in_tight_list(b)) {
+                cr();
+                emit_str("<p>");
+            }
+            render_inlines(&p->refs, b->content.data, b->content.len);
+            break;
+        case B_HEADING:
+            cr();
+            emit_str("<h");
+            emit_char((char)('0' + b->level));
+            emit_char('>');
+            render_inlines(&p->refs, b->content.data, b->content.len);
+            break;
+        case B_THEMATIC:
+            cr();
+            emit_str("<hr />\n");
+            break;
+        case B_CODE:
+            render_code(b);
+            break;
+        case B_HTML:
+            cr();
+            if (opt_unsafe) emit(b->content.data, b->content.len);
+            else emit_str("<!-- raw HTML omitted -->");
+            cr();
+            break;
+        case B_TABLE:
+            render_table(p, b);
+            break;
     }
+}
 
-    // Regular paragraph
-    printf("<p>");
-    process_inline(trimmed);
-    printf("</p>\n");
+static void block_exit(const Block *b) {
+    switch (b->type) {
+        case B_QUOTE:
+            cr();
+            emit_str("</blockquote>\n");
+            break;
+        case B_LIST:
+            emit_str(b->ordered ? "</ol>\n" : "</ul>\n");
+            break;
+        case B_ITEM:
+            emit_str("</li>\n");
+            break;
+        case B_PARAGRAPH:
+            if (!in_tight_list(b)) emit_str("</p>\n");
+            break;
+        case B_HEADING:
+            emit_str("</h");
+            emit_char((char)('0' + b->level));
+            emit_str(">\n");
+            break;
+    }
 }
 
-int main(int argc, char **argv) {
-    const char *raw_input = (argc >= 2) ? argv[1] : NULL;
-    char *stdin_buf = NULL;
-    if (!raw_input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: markdown <markdown-text>\nOr pipe input via stdin.\n");
-            return 1;
+static void render_block(Parser *p, Block *root) {
+    Block *b = root;
+    for (;;) {
+        block_enter(p, b);
+        if (b->first) {
+            b = b->first;
+            continue;
         }
-        raw_input = stdin_buf;
+        block_exit(b);
+        while (b != root && !b->next) {
+            b = b->parent;
+            block_exit(b);
+        }
+        if (b == root) break;
+        b = b->next;
     }
+}
 
-    char *input = strdup(raw_input);
-    char *line = strtok(input, "\n");
-    int in_code_block = 0;
-    int in_list = 0;
+static void parser_finish(Parser *p) {
+    while (p->tip != p->doc) finalize(p, p->tip, p->line_number);
+    while (p->doc->first) {
+        Block *b = p->doc->first;
+        render_block(p, b);
+        block_unlink(b);
+        block_free(b);
+    }
+}
 
-    while (line) {
-        process_line(line, &in_code_block, &in_list);
-        line = strtok(NULL, "\n");
+int main(int argc, char **argv) {
+    const char *input = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--unsafe") == 0) opt_unsafe = 1;
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input = argv[++i];
+        else if (!input) input = argv[i];
     }
 
-    // Close any open blocks
-    if (in_code_block) {
-        printf("</code></pre>\n");
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, "Usage: markdown [--unsafe] <markdown-text>\nOr pipe input via stdin.\n");
+            line_reader_free(&reader);
+            return 1;
+        }
     }
-    if (in_list) {
-        printf(in_list == 1 ? "</ul>\n" : "</ol>\n");
+
+    for (const char *c = "\n`\\&<*_~[]!"; *c; c++) inline_special[(unsigned char)*c] = 1;
+
+    Parser p;
+    memset(&p, 0, sizeof(p));
+    p.doc = p.tip = block_new(B_DOCUMENT, 0);
+    line_arena_init(&p.refs.arena);
+    if (!line_interner_init(&p.refs.labels, 64)) out_of_memory();
+
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        if (len > 0 && line[len - 1] == '\r') len--;
+        incorporate_line(&p, line, len);
     }
+    if (reader.error) out_of_memory();
+    parser_finish(&p);
 
-    free(input);
-    free(stdin_buf);
+    block_free(p.doc);
+    line_interner_free(&p.refs.labels);
+    line_arena_free(&p.refs.arena);
+    free(p.refs.defs);
+    buf_free(&p.align);
+    buf_free(&scratch);
+    buf_free(&label_buf);
+    buf_free(&cell_buf);
+    arena_free(&inline_parser.arena);
+    line_reader_free(&reader);
+    out_flush();
     return 0;
 }
@@ -1,105 +1,13 @@
 /**
- * md5sum - Calculate MD5 hash
- * Usage: md5sum <text>
+ * md5sum - Print or check MD5 checksums
+ * Usage: md5sum [-c] [--tag] [-b] [FILE]...
+ *
+ * MD5 (RFC 1321). Note: MD5 is not cryptographically secure; use it for checksums only.
+ * See hashsum.h for options and output formats.
  */
 
-#include <stdio.h>
-#include <string.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include "../stdin_read.h"
-
-#define LEFTROTATE(x, c) (((x) << (c)) | ((x) >> (32 - (c))))
-
-static const uint32_t K[64] = {
-    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
-};
-
-static const uint32_t S[64] = {
-    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
-    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
-    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
-    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
-};
-
-void md5(const uint8_t *data, size_t len, uint8_t *hash) {
-    uint32_t a0 = 0x67452301;
-    uint32_t b0 = 0xefcdab89;
-    uint32_t c0 = 0x98badcfe;
-    uint32_t d0 = 0x10325476;
-
-    size_t padded_len = ((len + 8) / 64 + 1) * 64;
-    uint8_t *msg = (uint8_t *)calloc(padded_len, 1);
-    memcpy(msg, data, len);
-    msg[len] = 0x80;
-
-    uint64_t bit_len = len * 8;
-    memcpy(msg + padded_len - 8, &bit_len, 8);
-
-    for (size_t offset = 0; offset < padded_len; offset += 64) {
-        uint32_t *M = (uint32_t *)(msg + offset);
-        uint32_t A = a0, B = b0, C = c0, D = d0;
-
-        for (int i = 0; i < 64; i++) {
-            uint32_t F, g;
-            if (i < 16) {
-                F = (B & C) | ((~B) & D);
-                g = i;
-            } else if (i < 32) {
-                F = (D & B) | ((~D) & C);
-                g = (5 * i + 1) % 16;
-            } else if (i < 48) {
-                F = B ^ C ^ D;
-                g = (3 * i + 5) % 16;
-            } else {
-                F = C ^ (B | (~D));
-                g = (7 * i) % 16;
-            }
-            F = F + A + K[i] + M[g];
-            A = D;
-            D = C;
-            C = B;
-            B = B + LEFTROTATE(F, S[i]);
-        }
-
-        a0 += A; b0 += B; c0 += C; d0 += D;
-    }
-
-    free(msg);
-
-    memcpy(hash, &a0, 4);
-    memcpy(hash + 4, &b0, 4);
-    memcpy(hash + 8, &c0, 4);
-    memcpy(hash + 12, &d0, 4);
-}
+#include "../hashsum.h"
 
 int main(int argc, char **argv) {
-    const char *input = (argc >= 2) ? argv[1] : NULL;
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: md5sum <text>\nOr pipe input via stdin.\n");
-            return 1;
-        }
-        input = stdin_buf;
-    }
-
-    uint8_t hash[16];
-    md5((const uint8_t *)input, strlen(input), hash);
-
-    for (int i = 0; i < 16; i++) {
-        printf("%02x", hash[i]);
-    }
-    printf("\n");
-
-    free(stdin_buf);
-    return 0;
+    return hashsum_main(argc, argv, "md5sum", &HASH_MD5);
 }
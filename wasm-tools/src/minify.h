@@ -0,0 +1,427 @@
+/**
+ * Whitespace and comment removal for JavaScript, CSS and HTML, built on
+ * the tokenizers in lexer.h and shared by minify, terser, csso and
+ * html-minifier so the tools produce the same output for the same input.
+ *
+ * Every function makes one pass over the token stream and writes through
+ * stdout_write.h. Tokens are copied out unchanged; only the gaps between
+ * them are decided:
+ *
+ *   JS    A gap disappears unless both sides would run together ("a b",
+ *         "a + +b", "1 .x", "/ /re/") or a line break there ends a
+ *         statement: after an operand, before a token that cannot
+ *         continue the expression, and always after return / break /
+ *         continue / throw / yield. Such line breaks are kept as "\n".
+ *   CSS   A gap disappears next to { } ; , ( ) and around selector
+ *         combinators; it stays inside values, where "1px + 2px" needs it.
+ *         The ';' before '}' is dropped.
+ *   HTML  Runs of whitespace in text become one space (not in <pre> or
+ *         <textarea>),
+ *         tags are rewritten with single spaces between attributes, and
+ *         inline <script> / <style> go through the JS and CSS minifiers.
+ *
+ * Usage:
+ *   if (minify_js(src, len) != 0) { ... out of memory ... }
+ *   minify_css(src, len, &(CssMinifyOptions){ .optimize = 1 });
+ */
+
+#ifndef MINIFY_H
+#define MINIFY_H
+
+#include "lexer.h"
+#include "stdout_write.h"
+
+/* ---- JavaScript ---- */
+
+/* Words after which a line break always ends the statement */
+static const char *const js_restricted_words[] = {"return", "break", "continue", "throw", "yield", NULL};
+
+/* The token can be the last one of a statement */
+static inline int js_can_end(const Token *t) {
+    switch (t->type) {
+        case JS_IDENT: case JS_NUMBER: case JS_STRING: case JS_TEMPLATE: case JS_TEMPLATE_TAIL: case JS_REGEX:
+            return 1;
+        case JS_PUNCT:
+            return lex_token_is(t, ")") || lex_token_is(t, "]") || lex_token_is(t, "}") ||
+                   lex_token_is(t, "++") || lex_token_is(t, "--");
+        default:
+            return 0;
+    }
+}
+
+/* The token continues the expression before it whether or not a line break separates them */
+static inline int js_continues(const Token *t) {
+    if (t->type == JS_TEMPLATE || t->type == JS_TEMPLATE_HEAD) return 1;
+    if (t->type != JS_PUNCT) return 0;
+    return !(lex_token_is(t, "{") || lex_token_is(t, "++") || lex_token_is(t, "--") || lex_token_is(t, "!") ||
+             lex_token_is(t, "~") || lex_token_is(t, "..."));
+}
+
+static inline int js_keep_newline(const Token *prev, const Token *next) {
+    if (prev->type == JS_IDENT && js_word_in(prev->ptr, prev->len, js_restricted_words)) {
+        return !(lex_token_is(next, ";") || lex_token_is(next, "}"));
+    }
+    return js_can_end(prev) && !js_continues(next);
+}
+
+/* Would the two tokens lex differently with nothing between them? */
+static inline int js_need_space(const Token *prev, const Token *next) {
+    unsigned char last = (unsigned char)prev->ptr[prev->len - 1], first = (unsigned char)next->ptr[0];
+    if (js_ident_char(last) && (js_ident_char(first) || first == '#')) return 1;
+    if ((last == '+' || last == '-') && first == last) return 1;
+    if (last == '/' && (first == '/' || first == '*')) return 1;
+    if (prev->type == JS_NUMBER && first == '.') {
+        // "1.x" would be a number; "1.5.x", "1e3.x" and "0xf.x" are fine
+        for (size_t i = 0; i < prev->len; i++) {
+            if (!isdigit((unsigned char)prev->ptr[i]) && prev->ptr[i] != '_') return 0;
+        }
+        return 1;
+    }
+    return last == '<' && first == '!';
+}
+
+/* Minify JavaScript to stdout; returns -1 if memory runs out */
+static inline int minify_js(const char *s, size_t n) {
+    JsLexer lx;
+    Token t, prev = {0};
+    int have_prev = 0, ws = 0, nl = 0;
+    js_lexer_init(&lx, s, n);
+    while (js_next(&lx, &t)) {
+        ws |= t.ws_before;
+        nl |= t.nl_before;
+        if (t.type == JS_COMMENT) {
+            if (t.ptr[0] == '#') {
+                out_write(t.ptr, t.len);    /* #! line */
+                out_char('\n');
+                continue;
+            }
+            // A comment separates tokens; a block comment spanning lines also ends a line
+            ws = 1;
+            if (t.ptr[1] == '/' || memchr(t.ptr, '\n', t.len) || memchr(t.ptr, '\r', t.len)) nl = 1;
+            continue;
+        }
+        if (have_prev) {
+            if (nl && js_keep_newline(&prev, &t)) out_char('\n');
+            else if (ws && js_need_space(&prev, &t)) out_char(' ');
+        }
+        out_write(t.ptr, t.len);
+        prev = t;
+        have_prev = 1;
+        ws = nl = 0;
+    }
+    int error = lx.error;
+    js_lexer_free(&lx);
+    return error ? -1 : 0;
+}
+
+/* ---- CSS ---- */
+
+typedef struct {
+    int optimize;   /* csso-style value rewrites: 0.5 -> .5, #aabbcc -> #abc, lowercase property names */
+} CssMinifyOptions;
+
+#define CSS_MAX_NESTING 256
+
+/* At-rules whose block holds rules rather than declarations */
+static const char *const css_group_rules[] = {
+    "@media", "@supports", "@document", "@layer", "@container", "@scope", "@starting-style",
+    "@keyframes", "@-webkit-keyframes", "@-moz-keyframes", NULL
+};
+
+typedef struct {
+    const CssMinifyOptions *opt;
+    int depth;
+    unsigned char decls[CSS_MAX_NESTING];   /* Does the block at each depth hold declarations? */
+    int parens;
+    int in_at_prelude;      /* Between an at-keyword and its '{' or ';' */
+    int group_prelude;      /* ... and the at-rule groups rules */
+    int at_decl_start;      /* Next token may be a property name */
+    int after_property;     /* Last token was a property name */
+    int in_value;           /* Between a property's ':' and the ';' or '}' */
+} CssState;
+
+static inline int css_in_decls(const CssState *st) {
+    return st->depth > 0 && st->decls[st->depth < CSS_MAX_NESTING ? st->depth : CSS_MAX_NESTING - 1];
+}
+
+static inline int css_delim_is(const Token *t, char c) {
+    return t->type == CSS_DELIM && t->len == 1 && t->ptr[0] == c;
+}
+
+static inline int css_delim_in(const Token *t, const char *set) {
+    return t->type == CSS_DELIM && t->len == 1 && strchr(set, t->ptr[0]) != NULL;
+}
+
+/* May the whitespace between prev and next go? */
+static inline int css_drop_space(const CssState *st, const Token *prev, const Token *next) {
+    if (css_delim_in(prev, "{};,(") || css_delim_in(next, "{};,)")) return 1;
+    if (prev->type == CSS_FUNCTION || prev->type == CSS_CDO || prev->type == CSS_CDC ||
+        next->type == CSS_CDO || next->type == CSS_CDC) {
+        return 1;
+    }
+    int selector = !css_in_decls(st) && !st->in_at_prelude;
+    if (css_delim_is(prev, ':')) return 1;
+    if (css_delim_is(next, ':')) return st->after_property || st->in_at_prelude;
+    if (css_delim_is(next, '!') && st->in_value) return 1;
+    if (selector && (css_delim_in(prev, ">~+") || css_delim_in(next, ">~+"))) return 1;
+    return 0;
+}
+
+/* Write a token, applying the csso value rewrites */
+static inline void css_write_token(const CssState *st, const Token *t) {
+    if (st->opt && st->opt->optimize) {
+        const char *s = t->ptr;
+        size_t n = t->len;
+        if (t->type == CSS_NUMBER && st->in_value) {
+            // 0.5 -> .5 and -0.5 -> -.5
+            size_t sign = (s[0] == '-' || s[0] == '+') ? 1 : 0;
+            if (n > sign + 2 && s[sign] == '0' && s[sign + 1] == '.' && isdigit((unsigned char)s[sign + 2])) {
+                out_write(s, sign);
+                out_write(s + sign + 1, n - sign - 1);
+                return;
+            }
+        }
+        if (t->type == CSS_HASH && st->in_value && (n == 7 || n == 4)) {
+            size_t i = 1;
+            while (i < n && isxdigit((unsigned char)s[i])) i++;
+            if (i == n) {
+                out_char('#');
+                if (n == 7 && tolower((unsigned char)s[1]) == tolower((unsigned char)s[2]) &&
+                    tolower((unsigned char)s[3]) == tolower((unsigned char)s[4]) &&
+                    tolower((unsigned char)s[5]) == tolower((unsigned char)s[6])) {
+                    out_char((char)tolower((unsigned char)s[1]));
+                    out_char((char)tolower((unsigned char)s[3]));
+                    out_char((char)tolower((unsigned char)s[5]));
+                } else {
+                    for (i = 1; i < n; i++) out_char((char)tolower((unsigned char)s[i]));
+                }
+                return;
+            }
+        }
+        if (t->type == CSS_IDENT && st->at_decl_start && css_in_decls(st) && !(n >= 2 && s[0] == '-' && s[1] == '-')) {
+            for (size_t i = 0; i < n; i++) out_char((char)tolower((unsigned char)s[i]));
+            return;
+        }
+    }
+    out_write(t->ptr, t->len);
+}
+
+/* Track rule/declaration context after writing t */
+static inline void css_update_state(CssState *st, const Token *t) {
+    int was_decl_start = st->at_decl_start;
+    st->after_property = 0;
+    st->at_decl_start = 0;
+    switch (t->type) {
+        case CSS_AT_KEYWORD:
+            if (st->parens == 0 && !st->in_value) {
+                st->in_at_prelude = 1;
+                st->group_prelude = 0;
+                for (const char *const *g = css_group_rules; *g; g++) {
+                    if (strlen(*g) == t->len && lex_has_prefix_nocase(t->ptr, t->len, *g)) st->group_prelude = 1;
+                }
+            }
+            return;
+        case CSS_FUNCTION:
+            st->parens++;
+            return;
+        case CSS_IDENT:
+            st->after_property = was_decl_start && css_in_decls(st);
+            return;
+        case CSS_DELIM:
+            break;
+        default:
+            return;
+    }
+    switch (t->ptr[0]) {
+        case '(':
+            st->parens++;
+            break;
+        case ')':
+            if (st->parens > 0) st->parens--;
+            break;
+        case '{':
+            st->depth++;
+            if (st->depth < CSS_MAX_NESTING) st->decls[st->depth] = !(st->in_at_prelude && st->group_prelude);
+            st->in_at_prelude = st->in_value = 0;
+            st->parens = 0;
+            st->at_decl_start = 1;
+            break;
+        case '}':
+            if (st->depth > 0) st->depth--;
+            st->in_at_prelude = st->in_value = 0;
+            st->parens = 0;
+            st->at_decl_start = css_in_decls(st);
+            break;
+        case ';':
+            st->in_at_prelude = st->in_value = 0;
+            st->at_decl_start = css_in_decls(st);
+            break;
+        case ':':
+            if (css_in_decls(st) && st->parens == 0 && !st->in_value) st->in_value = 1;
+            break;
+    }
+}
+
+/* Minify CSS to stdout */
+static inline void minify_css(const char *s, size_t n, const CssMinifyOptions *opt) {
+    CssLexer lx;
+    CssState st;
+    Token t, prev = {0};
+    int have_prev = 0, ws = 0, semicolon = 0;
+    memset(&st, 0, sizeof(st));
+    st.opt = opt;
+    css_lexer_init(&lx, s, n);
+    while (css_next(&lx, &t)) {
+        ws |= t.ws_before;
+        if (t.type == CSS_COMMENT) {
+            ws = 1;
+            continue;
+        }
+        // Hold each ';' back: it is dropped before '}' and when repeated
+        if (css_delim_is(&t, ';')) {
+            if (st.parens > 0) {
+                out_char(';');
+                prev = t;
+                have_prev = 1;
+                ws = 0;
+                continue;
+            }
+            semicolon = 1;
+            css_update_state(&st, &t);
+            ws = 0;
+            continue;
+        }
+        if (semicolon) {
+            semicolon = 0;
+            if (!css_delim_is(&t, '}')) {
+                out_char(';');
+                prev.type = CSS_DELIM;
+                prev.ptr = ";";
+                prev.len = 1;
+                ws = 0;
+            }
+        }
+        if (have_prev && ws && !css_drop_space(&st, &prev, &t)) out_char(' ');
+        css_write_token(&st, &t);
+        css_update_state(&st, &t);
+        prev = t;
+        have_prev = 1;
+        ws = 0;
+    }
+    if (semicolon) out_char(';');
+}
+
+/* ---- HTML ---- */
+
+static const char *const html_js_types[] = {
+    "text/javascript", "application/javascript", "module", "text/ecmascript", "application/ecmascript",
+    "application/x-javascript", NULL
+};
+
+/* Does a <script> tag hold JavaScript (no type, or a JS type)? */
+static inline int html_script_is_js(const Token *tag) {
+    size_t pos = 0;
+    HtmlAttr a;
+    while (html_next_attr(tag, &pos, &a)) {
+        if (a.name_len != 4 || !lex_has_prefix_nocase(a.name, 4, "type")) continue;
+        if (!a.value || a.value_len == 0) return 1;
+        for (const char *const *type = html_js_types; *type; type++) {
+            if (strlen(*type) == a.value_len && lex_has_prefix_nocase(a.value, a.value_len, *type)) return 1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/* Rewrite a tag with single spaces between attributes */
+static inline void html_write_tag(const Token *t) {
+    const char *name;
+    size_t name_len, pos = 0;
+    HtmlAttr a;
+    html_tag_name(t, &name, &name_len);
+    out_write(t->type == HTML_CLOSE ? "</" : "<", t->type == HTML_CLOSE ? 2 : 1);
+    out_write(name, name_len);
+    if (t->type == HTML_OPEN) {
+        while (html_next_attr(t, &pos, &a)) {
+            out_char(' ');
+            out_write(a.name, a.name_len);
+            if (!a.value) continue;
+            out_char('=');
+            if (a.quote) out_char(a.quote);
+            out_write(a.value, a.value_len);
+            if (a.quote) out_char(a.quote);
+        }
+        if (html_tag_self_closing(t)) out_char('/');
+    }
+    if (t->ptr[t->len - 1] == '>') out_char('>');
+}
+
+static inline void html_write_collapsed(const char *s, size_t n, int *prev_space) {
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!html_space((unsigned char)s[i])) {
+            *prev_space = 0;
+            continue;
+        }
+        out_write(s + start, i - start);
+        if (!*prev_space) out_char(' ');
+        *prev_space = 1;
+        start = i + 1;
+    }
+    out_write(s + start, n - start);
+}
+
+/*
+ * Minify HTML to stdout; returns -1 if memory runs out. Comments are dropped
+ * except <!--[if ...]> conditionals, and whitespace is kept as written in
+ * <pre>, <textarea> and <code>.
+ */
+static inline int minify_html(const char *s, size_t n) {
+    HtmlLexer lx;
+    Token t;
+    int pre = 0, prev_space = 0, raw_js = 0, raw_css = 0, raw_text = 0;
+    html_lexer_init(&lx, s, n);
+    while (html_next(&lx, &t)) {
+        switch (t.type) {
+            case HTML_TEXT:
+                if (pre) out_write(t.ptr, t.len);
+                else html_write_collapsed(t.ptr, t.len, &prev_space);
+                continue;
+            case HTML_RAW:
+                if (raw_js) {
+                    if (minify_js(t.ptr, t.len) != 0) return -1;
+                } else if (raw_css) {
+                    minify_css(t.ptr, t.len, NULL);
+                } else if (raw_text) {
+                    html_write_collapsed(t.ptr, t.len, &prev_space);
+                } else {
+                    out_write(t.ptr, t.len);
+                }
+                break;
+            case HTML_COMMENT:
+                if (!(t.len > 5 && t.ptr[4] == '[')) continue;
+                out_write(t.ptr, t.len);
+                break;
+            case HTML_DECL:
+                out_write(t.ptr, t.len);
+                break;
+            case HTML_OPEN:
+            case HTML_CLOSE: {
+                int opens = t.type == HTML_OPEN && !html_tag_self_closing(&t);
+                if (html_tag_is(&t, "pre") || html_tag_is(&t, "textarea") || html_tag_is(&t, "code")) {
+                    if (opens) pre++;
+                    else if (t.type == HTML_CLOSE && pre > 0) pre--;
+                }
+                raw_js = opens && html_tag_is(&t, "script") && html_script_is_js(&t);
+                raw_css = opens && html_tag_is(&t, "style");
+                raw_text = opens && html_tag_is(&t, "title");
+                html_write_tag(&t);
+                break;
+            }
+        }
+        prev_space = 0;
+    }
+    return 0;
+}
+
+#endif /* MINIFY_H */
@@ -0,0 +1,75 @@
+/**
+ * multicall - Every native tool in one module, dispatched on argv[0]
+ * Usage: <tool> [args...]
+ *        multicall <tool> [args...]
+ *        multicall --list
+ *
+ * Built by `build.sh --multicall`, not on its own: each tool's main.c is
+ * compiled with main renamed to <tool>_main (html-minifier becomes
+ * html_minifier_main), and build.sh generates tools.inc with one
+ * TOOL(name, entry) line per tool. Linking them into one module shares
+ * libc and the helper headers' code between tools, and lets one compiled
+ * WebAssembly.Module serve every tool in the registry.
+ *
+ * Each execution instantiates the module afresh, so a tool's globals start
+ * out zeroed as they would in its own binary.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../stdout_write.h"
+
+/* One stdout buffer for all tools (see stdout_write.h) */
+char out_buf[OUT_BUF_SIZE];
+size_t out_len;
+int out_atexit_registered;
+
+#define TOOL(name, entry) int entry(int argc, char **argv);
+#include "tools.inc"
+#undef TOOL
+
+static const struct {
+    const char *name;
+    int (*entry)(int argc, char **argv);
+} tools[] = {
+#define TOOL(name, entry) { name, entry },
+#include "tools.inc"
+#undef TOOL
+};
+
+#define TOOL_COUNT (sizeof(tools) / sizeof(tools[0]))
+
+/* Whether a command name ("grep", "/bin/grep", "grep.wasm") names a tool */
+static int names(const char *command, const char *tool) {
+    const char *slash = strrchr(command, '/');
+    if (slash) command = slash + 1;
+    size_t len = strcspn(command, ".");
+    return strncmp(command, tool, len) == 0 && tool[len] == '\0';
+}
+
+static int dispatch(int argc, char **argv) {
+    const char *command = argc > 0 ? argv[0] : "";
+
+    for (size_t i = 0; i < TOOL_COUNT; i++) {
+        if (names(command, tools[i].name)) {
+            return tools[i].entry(argc, argv);
+        }
+    }
+
+    if (names(command, "multicall")) {
+        if (argc > 1 && strcmp(argv[1], "--list") == 0) {
+            for (size_t i = 0; i < TOOL_COUNT; i++) {
+                printf("%s\n", tools[i].name);
+            }
+            return 0;
+        }
+        if (argc > 1) return dispatch(argc - 1, argv + 1);
+    }
+
+    fprintf(stderr, "multicall: unknown tool '%s' (multicall --list shows the tools)\n", command);
+    return 127;
+}
+
+int main(int argc, char **argv) {
+    return dispatch(argc, argv);
+}
@@ -1,144 +1,387 @@
 /**
  * patch - Apply diff patches (unified format)
- * Usage: patch <original-text> <patch>
+ * Usage: patch [-F N] <original-text> <patch>
+ * Options: -F N / --fuzz N  ignore up to N context lines at each end of a
+ *                           hunk that does not match exactly (default: 2)
+ *
+ * Every line of the original is interned once (see line_index.h) and the
+ * positions of each distinct line are indexed. A hunk is located by
+ * looking up the positions of its rarest line and checking the
+ * candidates nearest the expected position, so nothing is rescanned.
+ * The expected position follows the offset of the previous hunk, like
+ * GNU patch. The result is assembled as a list of spans pointing into the
+ * original and the patch text; no line is ever copied.
+ *
+ * Hunks that cannot be placed are reported on stderr and skipped, and the
+ * exit status is 1.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include "../line_index.h"
+#include "../stdout_write.h"
 
-#define MAX_LINES 10000
-#define MAX_LINE_LEN 4096
+#define PATCH_DEFAULT_FUZZ 2
+
+#define USAGE "Usage: patch [-F N] <original-text> <patch>\nApplies a unified diff patch to the original text\n"
+
+// The original, interned, with the positions of each id in ascending
+// order: pos[first[id] .. first[id + 1])
+static LineList orig;
+static int *orig_ids;
+static size_t *first, *pos;
+static LineInterner interner;
 
 typedef struct {
-    char *lines[MAX_LINES];
-    int count;
-} FileLines;
+    size_t old_start;     // Line number from the header (1-based; 0 = before line 1)
+    int has_old;          // old_count > 0
+    LineSpan *old_lines;  // Context and removed lines
+    int *old_ids;         // Their ids in the original, -1 if absent
+    size_t old_count;
+    LineSpan *new_lines;  // Context and added lines
+    size_t new_count;
+    size_t lead, trail;   // Context lines at the start / end
+} Hunk;
 
-void parse_lines(const char *text, FileLines *f) {
-    f->count = 0;
-    char *text_copy = strdup(text);
-    char *line = strtok(text_copy, "\n");
+// ============================================================================
+// Output spans
+// ============================================================================
 
-    while (line && f->count < MAX_LINES) {
-        f->lines[f->count++] = strdup(line);
-        line = strtok(NULL, "\n");
+static LineSpan *spans;
+static size_t span_count, span_cap;
+
+static int add_spans(const LineSpan *lines, size_t n) {
+    // Empty ranges may come with a NULL lines (and spans) pointer
+    if (n == 0) return 1;
+    if (span_count + n > span_cap) {
+        size_t cap = span_cap ? span_cap : 1024;
+        while (cap < span_count + n) cap *= 2;
+        LineSpan *tmp = (LineSpan *)realloc(spans, cap * sizeof(LineSpan));
+        if (!tmp) return 0;
+        spans = tmp;
+        span_cap = cap;
     }
+    memcpy(spans + span_count, lines, n * sizeof(LineSpan));
+    span_count += n;
+    return 1;
+}
 
-    free(text_copy);
+// ============================================================================
+// Patch parsing
+// ============================================================================
+
+static const char *parse_number(const char *p, size_t *out) {
+    if (!isdigit((unsigned char)*p)) return NULL;
+    size_t v = 0;
+    while (isdigit((unsigned char)*p)) v = v * 10 + (size_t)(*p++ - '0');
+    *out = v;
+    return p;
 }
 
-void free_lines(FileLines *f) {
-    for (int i = 0; i < f->count; i++) {
-        free(f->lines[i]);
-    }
-    f->count = 0;
+// Parse "@@ -start[,count] +start[,count] @@"; a missing count means 1
+static int parse_hunk_header(const LineSpan *l, size_t *old_start, size_t *old_count,
+                             size_t *new_start, size_t *new_count) {
+    char buf[128];
+    size_t n = l->len < sizeof(buf) - 1 ? l->len : sizeof(buf) - 1;
+    memcpy(buf, l->ptr, n);
+    buf[n] = '\0';
+
+    const char *p = buf;
+    if (strncmp(p, "@@ -", 4) != 0) return 0;
+    p = parse_number(p + 4, old_start);
+    if (!p) return 0;
+    *old_count = 1;
+    if (*p == ',' && !(p = parse_number(p + 1, old_count))) return 0;
+    if (strncmp(p, " +", 2) != 0) return 0;
+    p = parse_number(p + 2, new_start);
+    if (!p) return 0;
+    *new_count = 1;
+    if (*p == ',' && !(p = parse_number(p + 1, new_count))) return 0;
+    return strncmp(p, " @@", 3) == 0;
 }
 
-// Parse hunk header @@ -start,count +start,count @@
-int parse_hunk_header(const char *line, int *old_start, int *old_count, int *new_start, int *new_count) {
-    return sscanf(line, "@@ -%d,%d +%d,%d @@", old_start, old_count, new_start, new_count) >= 2;
+static int is_hunk_header(const LineSpan *l) {
+    return l->len >= 2 && l->ptr[0] == '@' && l->ptr[1] == '@';
 }
 
-// Apply patch to original
-void apply_patch(FileLines *original, FileLines *patch) {
-    FileLines result;
-    result.count = 0;
+// Read the hunk body after the header at *i. Lines point into the patch
+// text with the +/-/space prefix stripped.
+static int parse_hunk(const LineList *p, size_t *i, Hunk *h) {
+    size_t old_start, old_count, new_start, new_count;
+    memset(h, 0, sizeof(*h));
+    if (!parse_hunk_header(&p->lines[*i], &old_start, &old_count, &new_start, &new_count)) {
+        return 0;
+    }
+    (*i)++;
 
-    int orig_idx = 0;
-    int patch_idx = 0;
+    h->old_start = old_start;
+    h->has_old = old_count > 0;
+    h->old_lines = (LineSpan *)malloc((old_count + 1) * sizeof(LineSpan));
+    h->old_ids = (int *)malloc((old_count + 1) * sizeof(int));
+    h->new_lines = (LineSpan *)malloc((new_count + 1) * sizeof(LineSpan));
+    if (!h->old_lines || !h->old_ids || !h->new_lines) return 0;
 
-    // Skip patch header lines (--- and +++)
-    while (patch_idx < patch->count) {
-        if (strncmp(patch->lines[patch_idx], "---", 3) == 0 ||
-            strncmp(patch->lines[patch_idx], "+++", 3) == 0) {
-            patch_idx++;
-        } else {
+    int seen_change = 0;
+    while ((h->old_count < old_count || h->new_count < new_count) && *i < p->count) {
+        const LineSpan *l = &p->lines[*i];
+        // An empty line is context whose leading space was stripped
+        char kind = l->len ? l->ptr[0] : ' ';
+        LineSpan body = { l->len ? l->ptr + 1 : l->ptr, l->len ? l->len - 1 : 0 };
+
+        if (kind == ' ' && h->old_count < old_count && h->new_count < new_count) {
+            h->old_lines[h->old_count++] = body;
+            h->new_lines[h->new_count++] = body;
+            if (seen_change) h->trail++; else h->lead++;
+        } else if (kind == '-' && h->old_count < old_count) {
+            h->old_lines[h->old_count++] = body;
+            seen_change = 1;
+            h->trail = 0;
+        } else if (kind == '+' && h->new_count < new_count) {
+            h->new_lines[h->new_count++] = body;
+            seen_change = 1;
+            h->trail = 0;
+        } else if (kind != '\\') {  // "\ No newline at end of file"
             break;
         }
+        (*i)++;
     }
+    if (h->old_count != old_count || h->new_count != new_count) return 0;
+    if (!seen_change) h->trail = 0;
 
-    while (patch_idx < patch->count) {
-        char *pline = patch->lines[patch_idx];
-
-        // Hunk header
-        if (strncmp(pline, "@@", 2) == 0) {
-            int old_start, old_count, new_start, new_count;
-            if (parse_hunk_header(pline, &old_start, &old_count, &new_start, &new_count)) {
-                // Copy unchanged lines before this hunk
-                while (orig_idx < old_start - 1 && orig_idx < original->count) {
-                    if (result.count < MAX_LINES) {
-                        result.lines[result.count++] = strdup(original->lines[orig_idx]);
-                    }
-                    orig_idx++;
-                }
-            }
-            patch_idx++;
-            continue;
+    for (size_t k = 0; k < h->old_count; k++) {
+        h->old_ids[k] = line_interner_find(&interner, h->old_lines[k].ptr, h->old_lines[k].len);
+    }
+    return 1;
+}
+
+static void free_hunk(Hunk *h) {
+    free(h->old_lines);
+    free(h->old_ids);
+    free(h->new_lines);
+}
+
+// ============================================================================
+// Locating hunks
+// ============================================================================
+
+static void build_index(void) {
+    size_t nids = (size_t)interner.count;
+    first = (size_t *)calloc(nids + 1, sizeof(size_t));
+    pos = (size_t *)malloc((orig.count + 1) * sizeof(size_t));
+    size_t *fill = (size_t *)malloc((nids + 1) * sizeof(size_t));
+    if (!first || !pos || !fill) {
+        fprintf(stderr, "patch: out of memory\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < orig.count; i++) first[orig_ids[i] + 1]++;
+    for (size_t id = 0; id < nids; id++) first[id + 1] += first[id];
+    memcpy(fill, first, nids * sizeof(size_t));
+    for (size_t i = 0; i < orig.count; i++) pos[fill[orig_ids[i]]++] = i;
+    free(fill);
+}
+
+static int matches_at(const int *ids, size_t n, size_t at) {
+    if (at + n > orig.count) return 0;
+    for (size_t k = 0; k < n; k++) {
+        if (orig_ids[at + k] != ids[k]) return 0;
+    }
+    return 1;
+}
+
+// Find ids[0..n) in the original at a position >= min_pos, as close to
+// expected as possible. Candidates come from the index of the rarest
+// line. Returns 1 and sets *found on success.
+static int locate(const int *ids, size_t n, size_t expected, size_t min_pos, size_t *found) {
+    size_t anchor = 0, best = (size_t)-1;
+    for (size_t k = 0; k < n; k++) {
+        if (ids[k] < 0) return 0;  // Line does not exist in the original
+        size_t occurrences = first[ids[k] + 1] - first[ids[k]];
+        if (occurrences < best) {
+            best = occurrences;
+            anchor = k;
         }
+    }
 
-        // Context line (space prefix)
-        if (pline[0] == ' ') {
-            if (result.count < MAX_LINES) {
-                result.lines[result.count++] = strdup(pline + 1);
-            }
-            orig_idx++;
-            patch_idx++;
+    const size_t *cand = pos + first[ids[anchor]];
+    size_t ncand = best;
+
+    // Binary search for the candidate at the expected anchor position,
+    // then walk outwards in both directions
+    size_t target = expected + anchor;
+    size_t lo = 0, hi = ncand;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (cand[mid] < target) lo = mid + 1; else hi = mid;
+    }
+
+    size_t up = lo, down = lo;  // Next candidates: cand[up], cand[down - 1]
+    while (up < ncand || down > 0) {
+        int take_up;
+        if (up >= ncand) take_up = 0;
+        else if (down == 0) take_up = 1;
+        else take_up = cand[up] - target <= target - cand[down - 1];
+
+        size_t c = take_up ? cand[up++] : cand[--down];
+        if (c < anchor || c - anchor < min_pos) {
+            if (!take_up) down = 0;  // Everything further down is too early
             continue;
         }
+        if (matches_at(ids, n, c - anchor)) {
+            *found = c - anchor;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ============================================================================
+// Applying
+// ============================================================================
+
+static int apply_patch(const LineList *p, int max_fuzz) {
+    size_t cur = 0;         // Original lines before this are already emitted
+    long long offset = 0;   // Where the last hunk landed relative to its header
+    int failed = 0, hunk_no = 0;
 
-        // Removed line (minus prefix)
-        if (pline[0] == '-') {
-            // Skip this line from original
-            orig_idx++;
-            patch_idx++;
+    for (size_t i = 0; i < p->count;) {
+        if (!is_hunk_header(&p->lines[i])) {
+            i++;  // ---/+++ headers, "diff" lines and other noise
             continue;
         }
 
-        // Added line (plus prefix)
-        if (pline[0] == '+') {
-            if (result.count < MAX_LINES) {
-                result.lines[result.count++] = strdup(pline + 1);
+        Hunk h;
+        hunk_no++;
+        if (!parse_hunk(p, &i, &h)) {
+            fprintf(stderr, "patch: malformed hunk #%d\n", hunk_no);
+            free_hunk(&h);
+            return 2;
+        }
+
+        // Header position of the hunk's first old line, 0-based
+        size_t header_at = h.has_old ? h.old_start - 1 : h.old_start;
+        long long shifted = (long long)header_at + offset;
+        size_t expected = shifted < 0 ? 0 : (size_t)shifted;
+
+        int placed = 0, fuzz;
+        size_t at = 0, lead = 0, trail = 0;
+        for (fuzz = 0; fuzz <= max_fuzz; fuzz++) {
+            lead = h.lead < (size_t)fuzz ? h.lead : (size_t)fuzz;
+            trail = h.trail < (size_t)fuzz ? h.trail : (size_t)fuzz;
+            size_t n = h.old_count - lead - trail;
+            if (fuzz > 0 && lead == 0 && trail == 0) break;  // Nothing more to drop
+
+            if (n == 0) {
+                // Pure insertion: goes where the header says, after cur
+                at = expected + lead;
+                if (at < cur) at = cur;
+                if (at > orig.count) at = orig.count;
+                placed = 1;
+            } else {
+                placed = locate(h.old_ids + lead, n, expected + lead, cur, &at);
             }
-            patch_idx++;
+            if (placed) break;
+        }
+
+        if (!placed) {
+            fprintf(stderr, "Hunk #%d FAILED at %zu.\n", hunk_no, header_at + 1);
+            failed = 1;
+            free_hunk(&h);
             continue;
         }
 
-        // Unknown line, skip
-        patch_idx++;
-    }
+        // Report placements that needed an offset or fuzz, like GNU patch
+        size_t hunk_at = at - lead;
+        offset = (long long)hunk_at - (long long)header_at;
+        if (offset != 0 || fuzz > 0) {
+            fprintf(stderr, "Hunk #%d succeeded at %zu", hunk_no, hunk_at + 1);
+            if (fuzz > 0) fprintf(stderr, " with fuzz %d", fuzz);
+            if (offset != 0) {
+                fprintf(stderr, " (offset %lld line%s)", offset, offset == 1 || offset == -1 ? "" : "s");
+            }
+            fprintf(stderr, ".\n");
+        }
 
-    // Copy remaining original lines
-    while (orig_idx < original->count) {
-        if (result.count < MAX_LINES) {
-            result.lines[result.count++] = strdup(original->lines[orig_idx]);
+        // Keep the original up to the match, then the hunk's new lines
+        // (without the context that fuzz ignored)
+        size_t replaced = h.old_count - lead - trail;
+        if (!add_spans(orig.lines + cur, at - cur) ||
+            !add_spans(h.new_lines + lead, h.new_count - lead - trail)) {
+            fprintf(stderr, "patch: out of memory\n");
+            free_hunk(&h);
+            return 2;
         }
-        orig_idx++;
+        cur = at + replaced;
+        free_hunk(&h);
     }
 
-    // Output result
-    for (int i = 0; i < result.count; i++) {
-        printf("%s\n", result.lines[i]);
+    if (!add_spans(orig.lines + cur, orig.count - cur)) {
+        fprintf(stderr, "patch: out of memory\n");
+        return 2;
     }
 
-    free_lines(&result);
+    for (size_t i = 0; i < span_count; i++) {
+        out_write(spans[i].ptr, spans[i].len);
+        out_char('\n');
+    }
+    return failed;
 }
 
 int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: patch <original-text> <patch>\n");
-        fprintf(stderr, "Applies a unified diff patch to the original text\n");
+    const char *original_text = NULL, *patch_text = NULL;
+    int fuzz = PATCH_DEFAULT_FUZZ;
+
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-F") == 0 || strcmp(argv[i], "--fuzz") == 0) && i + 1 < argc) {
+            fuzz = atoi(argv[++i]);
+        } else if (!original_text) {
+            original_text = argv[i];
+        } else if (!patch_text) {
+            patch_text = argv[i];
+        } else if (isdigit((unsigned char)argv[i][0])) {
+            fuzz = atoi(argv[i]);  // Fuzz passed positionally by the registry
+        }
+    }
+    if (fuzz < 0) fuzz = 0;
+
+    if (!patch_text) {
+        fprintf(stderr, USAGE);
         return 1;
     }
 
-    FileLines original, patch;
-    parse_lines(argv[1], &original);
-    parse_lines(argv[2], &patch);
+    LineList p;
+    if (!line_list_split(original_text, strlen(original_text), &orig) ||
+        !line_list_split(patch_text, strlen(patch_text), &p) ||
+        !line_interner_init(&interner, orig.count)) {
+        fprintf(stderr, "patch: out of memory\n");
+        return 1;
+    }
 
-    apply_patch(&original, &patch);
+    orig_ids = (int *)malloc((orig.count + 1) * sizeof(int));
+    if (!orig_ids) {
+        fprintf(stderr, "patch: out of memory\n");
+        return 1;
+    }
+    for (size_t i = 0; i < orig.count; i++) {
+        orig_ids[i] = line_interner_id(&interner, orig.lines[i].ptr, orig.lines[i].len);
+        if (orig_ids[i] < 0) {
+            fprintf(stderr, "patch: out of memory\n");
+            return 1;
+        }
+    }
+    build_index();
 
-    free_lines(&original);
-    free_lines(&patch);
+    int status = apply_patch(&p, fuzz);
+    out_flush();
 
-    return 0;
+    line_interner_free(&interner);
+    line_list_free(&orig);
+    line_list_free(&p);
+    free(orig_ids);
+    free(first);
+    free(pos);
+    free(spans);
+    return status ? 1 : 0;
 }
@@ -0,0 +1,1170 @@
+/**
+ * Regular expression engine for WASM tools (grep, sed, awk).
+ *
+ * Compiles POSIX basic (BRE) or extended (ERE) regular expressions into a
+ * Thompson NFA and matches without backtracking, so running time is linear
+ * in the text for every pattern:
+ *
+ * - re_match() answers "does this line match?" with a lazily built DFA.
+ *   DFA states are created on first use and cached (bytes are grouped
+ *   into equivalence classes to keep transition tables small). When the
+ *   cache fills up it is flushed and rebuilt from the current state, so
+ *   memory is bounded no matter how many states the pattern could need.
+ * - re_search() finds the POSIX leftmost-longest match by simulating the
+ *   NFA with one thread per state, keeping the earliest start for each.
+ * - re_captures() resolves \1..\9 for a known match with a Pike VM.
+ *
+ * Supported syntax:
+ *   ERE: . [] [^] [:class:] * + ? {m,n} | ( ) ^ $
+ *   BRE: . [] [^] [:class:] * \{m,n\} \( \) ^ $ plus GNU \+ \? \|
+ *   Both: \d \D \w \W \s \S \b \B \< \> \n \t, RE_ICASE for -i
+ * Back-references inside the pattern are not supported (they cannot be
+ * matched in linear time).
+ *
+ * Usage:
+ *   const char *err;
+ *   Regex *re = re_compile("fo+|ba[rz]", RE_EXTENDED, &err);
+ *   if (!re) { fprintf(stderr, "invalid regex: %s\n", err); return 2; }
+ *   if (re_match(re, line, len)) { ... }
+ *   re_free(re);
+ */
+
+#ifndef REGEX_ENGINE_H
+#define REGEX_ENGINE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define RE_EXTENDED 1   /* POSIX ERE syntax; BRE when not set */
+#define RE_ICASE    2   /* Case-insensitive matching */
+
+#define RE_MAX_GROUPS 10        /* Whole match plus \1..\9 */
+#define RE_MAX_INSTS 32768      /* Upper bound on compiled program size */
+#define RE_MAX_DEPTH 256        /* Maximum group nesting */
+#define RE_DUP_MAX 255          /* Maximum {m,n} count, as POSIX */
+#define RE_DFA_MAX_STATES 1024  /* DFA cache size before a flush */
+
+/* NFA opcodes */
+enum {
+    RE_OP_SET,        /* Consume one byte in sets[x] */
+    RE_OP_SPLIT,      /* Fork to x (preferred) and y */
+    RE_OP_JMP,        /* Continue at x */
+    RE_OP_SAVE,       /* Record position in capture slot x */
+    RE_OP_BOL,        /* ^ */
+    RE_OP_EOL,        /* $ */
+    RE_OP_WORDB,      /* \b */
+    RE_OP_NWORDB,     /* \B */
+    RE_OP_WORD_START, /* \< */
+    RE_OP_WORD_END,   /* \> */
+    RE_OP_MATCH
+};
+
+typedef struct {
+    unsigned int w[8];
+} ReCharSet;
+
+typedef struct {
+    int op;
+    int x;
+    int y;
+} ReInst;
+
+/* A cached DFA state: the set of NFA instructions it stands for */
+typedef struct {
+    int pcs;          /* Offset into dfa_pool */
+    int npcs;
+    int accept;       /* A match ends here */
+    int accept_eol;   /* A match ends here if the text ends here */
+    unsigned int hash;
+    int chain;        /* Next state in the same hash bucket */
+} ReDState;
+
+typedef struct {
+    int pc;
+    size_t start;
+} ReThread;
+
+typedef struct Regex {
+    ReInst *insts;
+    int ninst;
+    ReCharSet *sets;
+    int nsets;
+    int ngroups;          /* Capture groups including the whole match */
+    int anchored_start;   /* Entry point without the leading .* loop */
+    int anchored_bol;     /* Every alternative starts with ^ */
+    int use_dfa;          /* 0 when the pattern needs word assertions */
+
+    /* NFA simulation scratch */
+    unsigned int *mark;
+    unsigned int gen;
+    int *stack;
+    size_t stack_cap;
+    ReThread *threads[2];
+    int nthreads[2];
+    size_t *caps[2];      /* Pike VM: per-thread capture slots */
+    size_t *cur_caps;
+
+    /* Lazy DFA */
+    unsigned char byte_class[256];
+    unsigned char class_rep[256];
+    int ncls;
+    ReDState *dstates;
+    int ndstates;
+    int *dnext;           /* ndstates x ncls transitions, -1 = not built */
+    int *dbuckets;
+    int *dpool;
+    int dpool_len;
+    int dpool_cap;
+    int dstart;
+    int *dscratch;        /* Closure output */
+    int *dstep;           /* Transition input */
+} Regex;
+
+/* ===========================================================================
+ * Character sets
+ * =========================================================================== */
+
+static inline void re_set_add(ReCharSet *s, int c) {
+    s->w[(c >> 5) & 7] |= 1u << (c & 31);
+}
+
+static inline int re_set_has(const ReCharSet *s, int c) {
+    return (s->w[(c >> 5) & 7] >> (c & 31)) & 1;
+}
+
+static inline void re_set_add_range(ReCharSet *s, int lo, int hi) {
+    for (int c = lo; c <= hi; c++) re_set_add(s, c);
+}
+
+static inline int re_is_word(int c) {
+    return isalnum(c) || c == '_';
+}
+
+static inline int re_set_add_named(ReCharSet *s, const char *name, size_t len) {
+    static const struct { const char *name; int (*pred)(int); } classes[] = {
+        {"alpha", isalpha}, {"digit", isdigit}, {"alnum", isalnum},
+        {"upper", isupper}, {"lower", islower}, {"space", isspace},
+        {"blank", isblank}, {"punct", ispunct}, {"print", isprint},
+        {"graph", isgraph}, {"cntrl", iscntrl}, {"xdigit", isxdigit},
+    };
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (strlen(classes[i].name) == len && memcmp(classes[i].name, name, len) == 0) {
+            for (int c = 0; c < 128; c++) {
+                if (classes[i].pred(c)) re_set_add(s, c);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Add the class for \d \w \s (or their negations). Returns 0 if c is not one. */
+static inline int re_set_add_escape_class(ReCharSet *s, int c) {
+    ReCharSet tmp;
+    memset(&tmp, 0, sizeof(tmp));
+    switch (tolower(c)) {
+        case 'd': re_set_add_range(&tmp, '0', '9'); break;
+        case 'w': re_set_add_named(&tmp, "alnum", 5); re_set_add(&tmp, '_'); break;
+        case 's': re_set_add_named(&tmp, "space", 5); break;
+        default: return 0;
+    }
+    int negate = isupper(c);
+    for (int i = 0; i < 8; i++) {
+        s->w[i] |= negate ? ~tmp.w[i] : tmp.w[i];
+    }
+    return 1;
+}
+
+static inline void re_set_fold_case(ReCharSet *s) {
+    for (int c = 'A'; c <= 'Z'; c++) {
+        if (re_set_has(s, c) || re_set_has(s, c + 32)) {
+            re_set_add(s, c);
+            re_set_add(s, c + 32);
+        }
+    }
+}
+
+/* ===========================================================================
+ * Parser: pattern -> AST
+ * =========================================================================== */
+
+enum { RE_N_SET, RE_N_EMPTY, RE_N_CAT, RE_N_ALT, RE_N_REPEAT, RE_N_GROUP, RE_N_ASSERT };
+
+typedef struct {
+    int type;
+    int a, b;       /* Children */
+    int min, max;   /* RE_N_REPEAT; max < 0 means unbounded */
+    int value;      /* Set index, group number or assertion opcode */
+} ReNode;
+
+typedef struct {
+    const char *p;
+    int flags;
+    const char *error;
+    ReNode *nodes;
+    int nnodes, nodes_cap;
+    ReCharSet *sets;
+    int nsets, sets_cap;
+    int ngroups;
+    int depth;
+    int branch_start;  /* BRE: '^' and '*' are special only here */
+    int has_word_assert;
+} ReParser;
+
+static inline int re_node(ReParser *ps, int type) {
+    if (ps->nnodes == ps->nodes_cap) {
+        int cap = ps->nodes_cap ? ps->nodes_cap * 2 : 64;
+        ReNode *tmp = (ReNode *)realloc(ps->nodes, cap * sizeof(ReNode));
+        if (!tmp) { ps->error = "out of memory"; return -1; }
+        ps->nodes = tmp;
+        ps->nodes_cap = cap;
+    }
+    ReNode *n = &ps->nodes[ps->nnodes];
+    n->type = type;
+    n->a = n->b = -1;
+    n->min = n->max = 0;
+    n->value = 0;
+    return ps->nnodes++;
+}
+
+static inline int re_new_set(ReParser *ps) {
+    if (ps->nsets == ps->sets_cap) {
+        int cap = ps->sets_cap ? ps->sets_cap * 2 : 32;
+        ReCharSet *tmp = (ReCharSet *)realloc(ps->sets, cap * sizeof(ReCharSet));
+        if (!tmp) { ps->error = "out of memory"; return -1; }
+        ps->sets = tmp;
+        ps->sets_cap = cap;
+    }
+    memset(&ps->sets[ps->nsets], 0, sizeof(ReCharSet));
+    return ps->nsets++;
+}
+
+/* Wrap a finished set in a node, applying case folding */
+static inline int re_set_node(ReParser *ps, int set) {
+    if (set < 0) return -1;
+    if (ps->flags & RE_ICASE) re_set_fold_case(&ps->sets[set]);
+    int n = re_node(ps, RE_N_SET);
+    if (n >= 0) ps->nodes[n].value = set;
+    return n;
+}
+
+static inline int re_literal(ReParser *ps, int c) {
+    int set = re_new_set(ps);
+    if (set < 0) return -1;
+    re_set_add(&ps->sets[set], c);
+    return re_set_node(ps, set);
+}
+
+static inline int re_binary(ReParser *ps, int type, int a, int b) {
+    if (a < 0) return b;
+    int n = re_node(ps, type);
+    if (n < 0) return -1;
+    ps->nodes[n].a = a;
+    ps->nodes[n].b = b;
+    return n;
+}
+
+static inline int re_parse_alt(ReParser *ps);
+
+static inline int re_parse_bracket(ReParser *ps) {
+    int set = re_new_set(ps);
+    if (set < 0) return -1;
+    ReCharSet *s = &ps->sets[set];
+    int negate = 0;
+    int first = 1;
+
+    ps->p++;  /* '[' */
+    if (*ps->p == '^') { negate = 1; ps->p++; }
+
+    for (;;) {
+        const char *p = ps->p;
+        if (!*p) { ps->error = "unmatched ["; return -1; }
+        if (*p == ']' && !first) { ps->p++; break; }
+        first = 0;
+
+        /* [:class:] */
+        if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            if (!end || !re_set_add_named(s, p + 2, (size_t)(end - p - 2))) {
+                ps->error = "invalid character class";
+                return -1;
+            }
+            ps->p = end + 2;
+            continue;
+        }
+
+        /* [.c.] and [=c=] name a single character */
+        int lo;
+        if (p[0] == '[' && (p[1] == '.' || p[1] == '=') && p[2] && p[3] == p[1] && p[4] == ']') {
+            lo = (unsigned char)p[2];
+            ps->p += 5;
+        } else if (p[0] == '\\' && p[1]) {
+            if (re_set_add_escape_class(s, (unsigned char)p[1])) {
+                ps->p += 2;
+                continue;
+            }
+            lo = p[1] == 'n' ? '\n' : p[1] == 't' ? '\t' : (unsigned char)p[1];
+            ps->p += 2;
+        } else {
+            lo = (unsigned char)p[0];
+            ps->p++;
+        }
+
+        /* Range a-z (a trailing '-' is literal) */
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            int hi;
+            if (ps->p[0] == '\\' && ps->p[1]) {
+                hi = (unsigned char)ps->p[1];
+                ps->p += 2;
+            } else {
+                hi = (unsigned char)ps->p[0];
+                ps->p++;
+            }
+            if (hi < lo) { ps->error = "invalid range end"; return -1; }
+            re_set_add_range(s, lo, hi);
+        } else {
+            re_set_add(s, lo);
+        }
+    }
+
+    if (ps->flags & RE_ICASE) re_set_fold_case(s);
+    if (negate) {
+        for (int i = 0; i < 8; i++) s->w[i] = ~s->w[i];
+        s->w['\n' >> 5] &= ~(1u << ('\n' & 31));
+    }
+    int n = re_node(ps, RE_N_SET);
+    if (n >= 0) ps->nodes[n].value = set;
+    return n;
+}
+
+static inline int re_assert_node(ReParser *ps, int op) {
+    int n = re_node(ps, RE_N_ASSERT);
+    if (n >= 0) ps->nodes[n].value = op;
+    return n;
+}
+
+static inline int re_group(ReParser *ps, const char *close, size_t close_len) {
+    if (++ps->depth > RE_MAX_DEPTH) { ps->error = "groups nested too deeply"; return -1; }
+    int group = ps->ngroups < RE_MAX_GROUPS ? ps->ngroups++ : -1;
+    int inner = re_parse_alt(ps);
+    if (inner < 0 && ps->error) return -1;
+    if (strncmp(ps->p, close, close_len) != 0) { ps->error = "unmatched ( or \\("; return -1; }
+    ps->p += close_len;
+    ps->depth--;
+
+    int n = re_node(ps, RE_N_GROUP);
+    if (n < 0) return -1;
+    ps->nodes[n].a = inner;
+    ps->nodes[n].value = group;
+    return n;
+}
+
+static inline int re_parse_atom(ReParser *ps) {
+    int ere = ps->flags & RE_EXTENDED;
+    const char *p = ps->p;
+
+    if (ere && *p == '(') {
+        ps->p++;
+        return re_group(ps, ")", 1);
+    }
+    if (!ere && p[0] == '\\' && p[1] == '(') {
+        ps->p += 2;
+        return re_group(ps, "\\)", 2);
+    }
+    if (*p == '[') return re_parse_bracket(ps);
+    if (*p == '.') {
+        ps->p++;
+        int set = re_new_set(ps);
+        if (set < 0) return -1;
+        re_set_add_range(&ps->sets[set], 0, 255);
+        ps->sets[set].w['\n' >> 5] &= ~(1u << ('\n' & 31));
+        return re_set_node(ps, set);
+    }
+    if (*p == '^' && (ere || ps->branch_start)) {
+        ps->p++;
+        return re_assert_node(ps, RE_OP_BOL);
+    }
+    if (*p == '$') {
+        /* BRE: '$' is an anchor only at the end of a branch */
+        const char *q = p + 1;
+        if (ere || !*q || (q[0] == '\\' && (q[1] == ')' || q[1] == '|'))) {
+            ps->p++;
+            return re_assert_node(ps, RE_OP_EOL);
+        }
+    }
+    if (*p == '\\') {
+        int c = (unsigned char)p[1];
+        if (!c) { ps->error = "trailing backslash"; return -1; }
+        ps->p += 2;
+        switch (c) {
+            case 'b': ps->has_word_assert = 1; return re_assert_node(ps, RE_OP_WORDB);
+            case 'B': ps->has_word_assert = 1; return re_assert_node(ps, RE_OP_NWORDB);
+            case '<': ps->has_word_assert = 1; return re_assert_node(ps, RE_OP_WORD_START);
+            case '>': ps->has_word_assert = 1; return re_assert_node(ps, RE_OP_WORD_END);
+            case 'n': return re_literal(ps, '\n');
+            case 't': return re_literal(ps, '\t');
+            default: break;
+        }
+        if (c >= '1' && c <= '9') { ps->error = "back-references are not supported"; return -1; }
+        int set = re_new_set(ps);
+        if (set < 0) return -1;
+        if (re_set_add_escape_class(&ps->sets[set], c)) return re_set_node(ps, set);
+        re_set_add(&ps->sets[set], c);
+        return re_set_node(ps, set);
+    }
+
+    ps->p++;
+    return re_literal(ps, (unsigned char)*p);
+}
+
+/* Parse "m}", "m,}" or "m,n}" after '{'. Returns 0 if it is not an interval. */
+static inline int re_parse_interval(ReParser *ps, const char *p, int *min, int *max, const char **end) {
+    int ere = ps->flags & RE_EXTENDED;
+    /* "{,n}" is the GNU spelling of "{0,n}" */
+    if (!isdigit((unsigned char)*p) && *p != ',') return 0;
+    long lo = 0, hi;
+    while (isdigit((unsigned char)*p) && lo <= RE_DUP_MAX) lo = lo * 10 + (*p++ - '0');
+    hi = lo;
+    if (*p == ',') {
+        p++;
+        if (isdigit((unsigned char)*p)) {
+            hi = 0;
+            while (isdigit((unsigned char)*p) && hi <= RE_DUP_MAX) hi = hi * 10 + (*p++ - '0');
+        } else {
+            hi = -1;
+        }
+    }
+    if (ere) {
+        if (*p != '}') return 0;
+        p++;
+    } else {
+        if (p[0] != '\\' || p[1] != '}') return 0;
+        p += 2;
+    }
+    if (lo > RE_DUP_MAX || hi > RE_DUP_MAX || (hi >= 0 && hi < lo)) {
+        ps->error = "invalid repetition count";
+        return 0;
+    }
+    *min = (int)lo;
+    *max = (int)hi;
+    *end = p;
+    return 1;
+}
+
+static inline int re_parse_repeat(ReParser *ps) {
+    int ere = ps->flags & RE_EXTENDED;
+    int atom;
+
+    /* A leading '*' is a literal */
+    if (*ps->p == '*' && ps->branch_start) {
+        ps->p++;
+        atom = re_literal(ps, '*');
+    } else {
+        atom = re_parse_atom(ps);
+    }
+    if (atom < 0) return -1;
+
+    /* BRE: a '*' after a leading '^' is literal (see re_parse_concat) */
+    if (!ere && ps->branch_start && ps->nodes[atom].type == RE_N_ASSERT &&
+        ps->nodes[atom].value == RE_OP_BOL) return atom;
+
+    for (;;) {
+        const char *p = ps->p;
+        int min, max;
+        const char *end = p + 1;
+
+        if (*p == '*') {
+            min = 0; max = -1;
+        } else if (ere && *p == '+') {
+            min = 1; max = -1;
+        } else if (ere && *p == '?') {
+            min = 0; max = 1;
+        } else if (!ere && p[0] == '\\' && p[1] == '+') {
+            min = 1; max = -1; end = p + 2;
+        } else if (!ere && p[0] == '\\' && p[1] == '?') {
+            min = 0; max = 1; end = p + 2;
+        } else if (ere && *p == '{') {
+            if (!re_parse_interval(ps, p + 1, &min, &max, &end)) {
+                if (ps->error) return -1;
+                break;  /* Literal '{' */
+            }
+        } else if (!ere && p[0] == '\\' && p[1] == '{') {
+            if (!re_parse_interval(ps, p + 2, &min, &max, &end)) {
+                if (!ps->error) ps->error = "invalid \\{ \\} interval";
+                return -1;
+            }
+        } else {
+            break;
+        }
+
+        ps->p = end;
+        int n = re_node(ps, RE_N_REPEAT);
+        if (n < 0) return -1;
+        ps->nodes[n].a = atom;
+        ps->nodes[n].min = min;
+        ps->nodes[n].max = max;
+        atom = n;
+    }
+    return atom;
+}
+
+static inline int re_parse_concat(ReParser *ps) {
+    int ere = ps->flags & RE_EXTENDED;
+    int left = -1;
+    ps->branch_start = 1;
+
+    while (*ps->p) {
+        const char *p = ps->p;
+        if (ere && (*p == '|' || (*p == ')' && ps->depth > 0))) break;
+        if (!ere && p[0] == '\\' && (p[1] == '|' || p[1] == ')')) break;
+
+        int node = re_parse_repeat(ps);
+        if (node < 0) return -1;
+        left = re_binary(ps, RE_N_CAT, left, node);
+        if (left < 0) return -1;
+        /* BRE: "^*" matches a literal '*' at the start of the line */
+        ps->branch_start = !ere && ps->nodes[node].type == RE_N_ASSERT &&
+                           ps->nodes[node].value == RE_OP_BOL;
+    }
+
+    if (left < 0) left = re_node(ps, RE_N_EMPTY);
+    return left;
+}
+
+static inline int re_parse_alt(ReParser *ps) {
+    int ere = ps->flags & RE_EXTENDED;
+    int left = re_parse_concat(ps);
+    if (left < 0) return -1;
+
+    for (;;) {
+        if (ere && *ps->p == '|') {
+            ps->p++;
+        } else if (!ere && ps->p[0] == '\\' && ps->p[1] == '|') {
+            ps->p += 2;
+        } else {
+            break;
+        }
+        int right = re_parse_concat(ps);
+        if (right < 0) return -1;
+        left = re_binary(ps, RE_N_ALT, left, right);
+        if (left < 0) return -1;
+    }
+    return left;
+}
+
+/* Does every path through the node begin with '^'? */
+static inline int re_starts_with_bol(const ReParser *ps, int n) {
+    const ReNode *node = &ps->nodes[n];
+    switch (node->type) {
+        case RE_N_ASSERT: return node->value == RE_OP_BOL;
+        case RE_N_CAT: return re_starts_with_bol(ps, node->a);
+        case RE_N_ALT: return re_starts_with_bol(ps, node->a) && re_starts_with_bol(ps, node->b);
+        case RE_N_GROUP: return re_starts_with_bol(ps, node->a);
+        case RE_N_REPEAT: return node->min > 0 && re_starts_with_bol(ps, node->a);
+        default: return 0;
+    }
+}
+
+/* ===========================================================================
+ * Compiler: AST -> NFA program
+ * =========================================================================== */
+
+static inline int re_emit(Regex *re, int op, int x, int y) {
+    if (re->ninst >= RE_MAX_INSTS) return -1;
+    re->insts[re->ninst].op = op;
+    re->insts[re->ninst].x = x;
+    re->insts[re->ninst].y = y;
+    return re->ninst++;
+}
+
+static inline int re_compile_node(Regex *re, const ReParser *ps, int n) {
+    const ReNode *node = &ps->nodes[n];
+
+    switch (node->type) {
+        case RE_N_SET:
+            return re_emit(re, RE_OP_SET, node->value, 0) < 0 ? -1 : 0;
+        case RE_N_EMPTY:
+            return 0;
+        case RE_N_ASSERT:
+            return re_emit(re, node->value, 0, 0) < 0 ? -1 : 0;
+        case RE_N_CAT:
+            if (re_compile_node(re, ps, node->a) < 0) return -1;
+            return re_compile_node(re, ps, node->b);
+        case RE_N_GROUP:
+            if (node->value >= 0 && re_emit(re, RE_OP_SAVE, node->value * 2, 0) < 0) return -1;
+            if (re_compile_node(re, ps, node->a) < 0) return -1;
+            if (node->value >= 0 && re_emit(re, RE_OP_SAVE, node->value * 2 + 1, 0) < 0) return -1;
+            return 0;
+        case RE_N_ALT: {
+            int split = re_emit(re, RE_OP_SPLIT, 0, 0);
+            if (split < 0) return -1;
+            re->insts[split].x = re->ninst;
+            if (re_compile_node(re, ps, node->a) < 0) return -1;
+            int jmp = re_emit(re, RE_OP_JMP, 0, 0);
+            if (jmp < 0) return -1;
+            re->insts[split].y = re->ninst;
+            if (re_compile_node(re, ps, node->b) < 0) return -1;
+            re->insts[jmp].x = re->ninst;
+            return 0;
+        }
+        case RE_N_REPEAT: {
+            for (int i = 0; i < node->min; i++) {
+                if (re_compile_node(re, ps, node->a) < 0) return -1;
+            }
+            if (node->max < 0) {
+                /* L: split body, out; body; jmp L */
+                int split = re_emit(re, RE_OP_SPLIT, 0, 0);
+                if (split < 0) return -1;
+                re->insts[split].x = re->ninst;
+                if (re_compile_node(re, ps, node->a) < 0) return -1;
+                if (re_emit(re, RE_OP_JMP, split, 0) < 0) return -1;
+                re->insts[split].y = re->ninst;
+                return 0;
+            }
+            /* Optional copies: each split skips to the common exit */
+            int splits[RE_DUP_MAX];
+            int optional = node->max - node->min;
+            for (int i = 0; i < optional; i++) {
+                splits[i] = re_emit(re, RE_OP_SPLIT, 0, 0);
+                if (splits[i] < 0) return -1;
+                re->insts[splits[i]].x = re->ninst;
+                if (re_compile_node(re, ps, node->a) < 0) return -1;
+            }
+            for (int i = 0; i < optional; i++) re->insts[splits[i]].y = re->ninst;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Split the 256 byte values into classes that every set treats alike */
+static inline void re_compute_byte_classes(Regex *re) {
+    unsigned char map[256];
+    memset(map, 0, sizeof(map));
+    int ncls = 1;
+
+    for (int s = 0; s < re->nsets; s++) {
+        int remap[512];
+        for (int i = 0; i < 512; i++) remap[i] = -1;
+        int next = 0;
+        for (int c = 0; c < 256; c++) {
+            int key = map[c] * 2 + re_set_has(&re->sets[s], c);
+            if (remap[key] < 0) remap[key] = next++;
+            map[c] = (unsigned char)remap[key];
+        }
+        ncls = next;
+        if (ncls == 256) break;
+    }
+
+    memcpy(re->byte_class, map, sizeof(map));
+    re->ncls = ncls;
+    for (int c = 255; c >= 0; c--) re->class_rep[map[c]] = (unsigned char)c;
+}
+
+static inline void re_free(Regex *re) {
+    if (!re) return;
+    free(re->insts);
+    free(re->sets);
+    free(re->mark);
+    free(re->stack);
+    free(re->threads[0]);
+    free(re->threads[1]);
+    free(re->caps[0]);
+    free(re->caps[1]);
+    free(re->cur_caps);
+    free(re->dstates);
+    free(re->dnext);
+    free(re->dbuckets);
+    free(re->dpool);
+    free(re->dscratch);
+    free(re->dstep);
+    free(re);
+}
+
+#define RE_DFA_BUCKETS 2048
+
+/*
+ * Compile a pattern. flags is a combination of RE_EXTENDED and RE_ICASE.
+ * Returns NULL and sets *error to a static message on failure.
+ */
+static inline Regex *re_compile(const char *pattern, int flags, const char **error) {
+    ReParser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = pattern;
+    ps.flags = flags;
+    ps.ngroups = 1;  /* Group 0 is the whole match */
+
+    int root = re_parse_alt(&ps);
+    if (root >= 0 && *ps.p) ps.error = (flags & RE_EXTENDED) ? "unmatched )" : "unmatched \\)";
+    if (root < 0 || ps.error) {
+        *error = ps.error ? ps.error : "invalid regular expression";
+        free(ps.nodes);
+        free(ps.sets);
+        return NULL;
+    }
+
+    Regex *re = (Regex *)calloc(1, sizeof(Regex));
+    if (!re) { *error = "out of memory"; free(ps.nodes); free(ps.sets); return NULL; }
+    re->insts = (ReInst *)malloc(RE_MAX_INSTS * sizeof(ReInst));
+
+    /* Sets: the parsed ones plus one "any byte" set for the search loop */
+    int any = re_new_set(&ps);
+    if (!re->insts || any < 0) {
+        *error = "out of memory";
+        free(ps.nodes);
+        free(ps.sets);
+        re_free(re);
+        return NULL;
+    }
+    re_set_add_range(&ps.sets[any], 0, 255);
+    re->sets = ps.sets;
+    re->nsets = ps.nsets;
+    re->ngroups = ps.ngroups;
+    re->anchored_bol = re_starts_with_bol(&ps, root);
+    re->use_dfa = !ps.has_word_assert;
+
+    /* 0: split 3, 1   1: any   2: jmp 0   3: save 0  <body>  save 1  match */
+    re_emit(re, RE_OP_SPLIT, 3, 1);
+    re_emit(re, RE_OP_SET, any, 0);
+    re_emit(re, RE_OP_JMP, 0, 0);
+    re->anchored_start = re_emit(re, RE_OP_SAVE, 0, 0);
+    int ok = re_compile_node(re, &ps, root) == 0 &&
+             re_emit(re, RE_OP_SAVE, 1, 0) >= 0 &&
+             re_emit(re, RE_OP_MATCH, 0, 0) >= 0;
+    free(ps.nodes);
+    if (!ok) {
+        *error = "regular expression too big";
+        re_free(re);
+        return NULL;
+    }
+
+    /* The search loop must not count as a class boundary */
+    re->nsets--;
+    re_compute_byte_classes(re);
+    re->nsets++;
+
+    int n = re->ninst;
+    int ncaps = re->ngroups * 2;
+    re->stack_cap = (size_t)n * 4 + 16;
+    re->mark = (unsigned int *)calloc(n, sizeof(unsigned int));
+    re->stack = (int *)malloc(re->stack_cap * sizeof(int));
+    re->threads[0] = (ReThread *)malloc(n * sizeof(ReThread));
+    re->threads[1] = (ReThread *)malloc(n * sizeof(ReThread));
+    re->caps[0] = (size_t *)malloc((size_t)n * ncaps * sizeof(size_t));
+    re->caps[1] = (size_t *)malloc((size_t)n * ncaps * sizeof(size_t));
+    re->cur_caps = (size_t *)malloc(ncaps * sizeof(size_t));
+    re->dstates = (ReDState *)malloc(RE_DFA_MAX_STATES * sizeof(ReDState));
+    re->dnext = (int *)malloc((size_t)RE_DFA_MAX_STATES * re->ncls * sizeof(int));
+    re->dbuckets = (int *)malloc(RE_DFA_BUCKETS * sizeof(int));
+    re->dscratch = (int *)malloc(n * sizeof(int));
+    re->dstep = (int *)malloc(n * sizeof(int));
+    re->dpool_cap = n * 4;
+    re->dpool = (int *)malloc(re->dpool_cap * sizeof(int));
+    if (!re->mark || !re->stack || !re->threads[0] || !re->threads[1] ||
+        !re->caps[0] || !re->caps[1] || !re->cur_caps || !re->dstates ||
+        !re->dnext || !re->dbuckets || !re->dscratch || !re->dstep || !re->dpool) {
+        *error = "out of memory";
+        re_free(re);
+        return NULL;
+    }
+    re->ndstates = 0;
+    re->dstart = -1;
+    for (int i = 0; i < RE_DFA_BUCKETS; i++) re->dbuckets[i] = -1;
+
+    return re;
+}
+
+/* ===========================================================================
+ * NFA simulation
+ * =========================================================================== */
+
+/* Does a zero-width assertion hold before text[pos]? */
+static inline int re_assert_holds(int op, const char *text, size_t len, size_t pos) {
+    int before = pos > 0 && re_is_word((unsigned char)text[pos - 1]);
+    int after = pos < len && re_is_word((unsigned char)text[pos]);
+    switch (op) {
+        case RE_OP_BOL: return pos == 0;
+        case RE_OP_EOL: return pos == len;
+        case RE_OP_WORDB: return before != after;
+        case RE_OP_NWORDB: return before == after;
+        case RE_OP_WORD_START: return !before && after;
+        case RE_OP_WORD_END: return before && !after;
+    }
+    return 0;
+}
+
+/*
+ * Add the threads reachable from pc without consuming input. The first
+ * thread to reach an instruction owns it; because threads are added in
+ * order of increasing start, that is always the leftmost one.
+ */
+static inline void re_add_closure(Regex *re, int list, int pc0, size_t start,
+                           const char *text, size_t len, size_t pos) {
+    int sp = 0;
+    re->stack[sp++] = pc0;
+
+    while (sp > 0) {
+        int pc = re->stack[--sp];
+        if (re->mark[pc] == re->gen) continue;
+        re->mark[pc] = re->gen;
+
+        const ReInst *in = &re->insts[pc];
+        switch (in->op) {
+            case RE_OP_SPLIT:
+                re->stack[sp++] = in->y;
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_JMP:
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_SAVE:
+                re->stack[sp++] = pc + 1;
+                break;
+            case RE_OP_SET:
+            case RE_OP_MATCH: {
+                ReThread *t = &re->threads[list][re->nthreads[list]++];
+                t->pc = pc;
+                t->start = start;
+                break;
+            }
+            default:
+                if (re_assert_holds(in->op, text, len, pos)) re->stack[sp++] = pc + 1;
+                break;
+        }
+    }
+}
+
+/*
+ * Find the leftmost-longest match that starts at or after `from`.
+ * Positions are offsets into text; '^' only holds at offset 0.
+ * Returns 1 and sets match_start and match_end on success.
+ */
+static inline int re_search(Regex *re, const char *text, size_t len, size_t from,
+                     size_t *match_start, size_t *match_end) {
+    int cur = 0;
+    int found = 0;
+    size_t best_start = 0, best_end = 0;
+
+    re->gen++;
+    re->nthreads[cur] = 0;
+
+    for (size_t pos = from; ; pos++) {
+        /* Start a new thread here until a match is known */
+        if (!found && !(re->anchored_bol && pos > 0)) {
+            re_add_closure(re, cur, re->anchored_start, pos, text, len, pos);
+        }
+
+        for (int i = 0; i < re->nthreads[cur]; i++) {
+            ReThread *t = &re->threads[cur][i];
+            if (re->insts[t->pc].op != RE_OP_MATCH) continue;
+            if (!found || t->start < best_start || (t->start == best_start && pos > best_end)) {
+                found = 1;
+                best_start = t->start;
+                best_end = pos;
+            }
+        }
+
+        if (pos >= len) break;
+        if (re->nthreads[cur] == 0 && (found || re->anchored_bol)) break;
+
+        int next = 1 - cur;
+        re->gen++;
+        re->nthreads[next] = 0;
+        int c = (unsigned char)text[pos];
+        for (int i = 0; i < re->nthreads[cur]; i++) {
+            ReThread *t = &re->threads[cur][i];
+            if (found && t->start > best_start) continue;
+            const ReInst *in = &re->insts[t->pc];
+            if (in->op == RE_OP_SET && re_set_has(&re->sets[in->x], c)) {
+                re_add_closure(re, next, t->pc + 1, t->start, text, len, pos + 1);
+            }
+        }
+        cur = next;
+        if (re->nthreads[cur] == 0 && found) break;
+    }
+
+    if (found) {
+        *match_start = best_start;
+        *match_end = best_end;
+    }
+    return found;
+}
+
+/* Pike VM closure carrying capture positions; y is explored after x. */
+static inline void re_add_capture_closure(Regex *re, int list, int pc0, const char *text,
+                                   size_t len, size_t pos) {
+    int ncaps = re->ngroups * 2;
+    int sp = 0;
+    /* Entries >= 0 explore a pc; entries < 0 restore slot (-e - 1) */
+    re->stack[sp++] = pc0;
+
+    while (sp > 0) {
+        int e = re->stack[--sp];
+        if (e < 0) {
+            int slot = (-e - 1) / 2;
+            /* Restores come in pairs: slot marker then saved value */
+            re->cur_caps[slot] = (size_t)re->stack[--sp];
+            continue;
+        }
+        int pc = e;
+        if (re->mark[pc] == re->gen) continue;
+        re->mark[pc] = re->gen;
+
+        const ReInst *in = &re->insts[pc];
+        switch (in->op) {
+            case RE_OP_SPLIT:
+                re->stack[sp++] = in->y;
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_JMP:
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_SAVE:
+                if ((size_t)sp + 3 > re->stack_cap) break;
+                re->stack[sp++] = (int)re->cur_caps[in->x];
+                re->stack[sp++] = -(in->x * 2) - 1;
+                re->cur_caps[in->x] = pos;
+                re->stack[sp++] = pc + 1;
+                break;
+            case RE_OP_SET:
+            case RE_OP_MATCH: {
+                int slot = re->nthreads[list]++;
+                re->threads[list][slot].pc = pc;
+                memcpy(&re->caps[list][(size_t)slot * ncaps], re->cur_caps, ncaps * sizeof(size_t));
+                break;
+            }
+            default:
+                if (re_assert_holds(in->op, text, len, pos)) re->stack[sp++] = pc + 1;
+                break;
+        }
+    }
+}
+
+/*
+ * Resolve capture groups for a match known to span [start, end).
+ * caps receives 2 * RE_MAX_GROUPS offsets; unset groups are (size_t)-1.
+ * Returns the number of groups (including group 0) or 0 on failure.
+ */
+static inline int re_captures(Regex *re, const char *text, size_t len, size_t start,
+                       size_t end, size_t *caps) {
+    int ncaps = re->ngroups * 2;
+    int cur = 0;
+    int found = 0;
+
+    for (int i = 0; i < RE_MAX_GROUPS * 2; i++) caps[i] = (size_t)-1;
+    for (int i = 0; i < ncaps; i++) re->cur_caps[i] = (size_t)-1;
+
+    re->gen++;
+    re->nthreads[cur] = 0;
+    re_add_capture_closure(re, cur, re->anchored_start, text, len, start);
+
+    for (size_t pos = start; ; pos++) {
+        int next = 1 - cur;
+        re->gen++;
+        re->nthreads[next] = 0;
+
+        for (int i = 0; i < re->nthreads[cur]; i++) {
+            const ReInst *in = &re->insts[re->threads[cur][i].pc];
+            size_t *tcaps = &re->caps[cur][(size_t)i * ncaps];
+            if (in->op == RE_OP_MATCH) {
+                if (pos == end) {
+                    memcpy(caps, tcaps, ncaps * sizeof(size_t));
+                    found = 1;
+                    break;  /* Lower-priority threads lose */
+                }
+                continue;
+            }
+            if (pos < end && re_set_has(&re->sets[in->x], (unsigned char)text[pos])) {
+                memcpy(re->cur_caps, tcaps, ncaps * sizeof(size_t));
+                re_add_capture_closure(re, next, re->threads[cur][i].pc + 1, text, len, pos + 1);
+            }
+        }
+
+        if (found || pos >= end) break;
+        cur = next;
+    }
+    return found ? re->ngroups : 0;
+}
+
+/* ===========================================================================
+ * Lazy DFA
+ * =========================================================================== */
+
+static inline int re_cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Expand pcs into the set of SET/MATCH/EOL instructions they reach.
+ * '^' holds only while building the start state. Returns the count
+ * written to re->dscratch (sorted, so equal sets compare equal).
+ */
+static inline int re_dfa_closure(Regex *re, const int *pcs, int npcs, int at_bol, int at_eol) {
+    int sp = 0, n = 0;
+    re->gen++;
+    for (int i = npcs - 1; i >= 0; i--) re->stack[sp++] = pcs[i];
+
+    while (sp > 0) {
+        int pc = re->stack[--sp];
+        if (re->mark[pc] == re->gen) continue;
+        re->mark[pc] = re->gen;
+
+        const ReInst *in = &re->insts[pc];
+        switch (in->op) {
+            case RE_OP_SPLIT:
+                re->stack[sp++] = in->y;
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_JMP:
+                re->stack[sp++] = in->x;
+                break;
+            case RE_OP_SAVE:
+                re->stack[sp++] = pc + 1;
+                break;
+            case RE_OP_BOL:
+                if (at_bol) re->stack[sp++] = pc + 1;
+                break;
+            case RE_OP_EOL:
+                if (at_eol) re->stack[sp++] = pc + 1;
+                else re->dscratch[n++] = pc;
+                break;
+            default:
+                re->dscratch[n++] = pc;
+                break;
+        }
+    }
+    qsort(re->dscratch, n, sizeof(int), re_cmp_int);
+    return n;
+}
+
+static inline void re_dfa_flush(Regex *re) {
+    re->ndstates = 0;
+    re->dpool_len = 0;
+    re->dstart = -1;
+    for (int i = 0; i < RE_DFA_BUCKETS; i++) re->dbuckets[i] = -1;
+}
+
+/* Find or create the DFA state for the pcs in re->dscratch[0..n) */
+static inline int re_dfa_state(Regex *re, int n) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < n; i++) h = (h ^ (unsigned int)re->dscratch[i]) * 16777619u;
+
+    for (int s = re->dbuckets[h % RE_DFA_BUCKETS]; s >= 0; s = re->dstates[s].chain) {
+        ReDState *st = &re->dstates[s];
+        if (st->hash == h && st->npcs == n &&
+            memcmp(&re->dpool[st->pcs], re->dscratch, n * sizeof(int)) == 0) {
+            return s;
+        }
+    }
+
+    if (re->ndstates == RE_DFA_MAX_STATES) return -1;
+    if (re->dpool_len + n > re->dpool_cap) {
+        int cap = re->dpool_cap * 2 + n;
+        int *tmp = (int *)realloc(re->dpool, cap * sizeof(int));
+        if (!tmp) return -1;
+        re->dpool = tmp;
+        re->dpool_cap = cap;
+    }
+
+    int s = re->ndstates++;
+    ReDState *st = &re->dstates[s];
+    st->pcs = re->dpool_len;
+    st->npcs = n;
+    st->hash = h;
+    memcpy(&re->dpool[st->pcs], re->dscratch, n * sizeof(int));
+    re->dpool_len += n;
+    st->chain = re->dbuckets[h % RE_DFA_BUCKETS];
+    re->dbuckets[h % RE_DFA_BUCKETS] = s;
+    for (int c = 0; c < re->ncls; c++) re->dnext[(size_t)s * re->ncls + c] = -1;
+
+    st->accept = 0;
+    st->accept_eol = 0;
+    int eol_pcs = 0;
+    for (int i = 0; i < n; i++) {
+        int op = re->insts[re->dscratch[i]].op;
+        if (op == RE_OP_MATCH) st->accept = 1;
+        if (op == RE_OP_EOL) eol_pcs = 1;
+    }
+    st->accept_eol = st->accept;
+    if (!st->accept && eol_pcs) {
+        /* Would the text ending here satisfy a pending '$'? */
+        int *pcs = (int *)malloc(n * sizeof(int));
+        if (pcs) {
+            memcpy(pcs, &re->dpool[st->pcs], n * sizeof(int));
+            int m = re_dfa_closure(re, pcs, n, 0, 1);
+            for (int i = 0; i < m; i++) {
+                if (re->insts[re->dscratch[i]].op == RE_OP_MATCH) st->accept_eol = 1;
+            }
+            free(pcs);
+        }
+    }
+    return s;
+}
+
+static inline int re_dfa_start(Regex *re) {
+    if (re->dstart < 0) {
+        int pc = re->anchored_bol ? re->anchored_start : 0;
+        int n = re_dfa_closure(re, &pc, 1, 1, 0);
+        re->dstart = re_dfa_state(re, n);
+    }
+    return re->dstart;
+}
+
+/* Compute (and cache) the transition from state s on byte class cls */
+static inline int re_dfa_step(Regex *re, int s, int cls) {
+    ReDState *st = &re->dstates[s];
+    int c = re->class_rep[cls];
+    int *next_pcs = re->dstep;
+    int m = 0;
+
+    for (int i = 0; i < st->npcs; i++) {
+        int pc = re->dpool[st->pcs + i];
+        const ReInst *in = &re->insts[pc];
+        if (in->op == RE_OP_SET && re_set_has(&re->sets[in->x], c)) next_pcs[m++] = pc + 1;
+    }
+
+    int n = re_dfa_closure(re, next_pcs, m, 0, 0);
+    int t = re_dfa_state(re, n);
+    if (t < 0) {
+        /* Cache full: start over with just the target state */
+        re_dfa_flush(re);
+        return re_dfa_state(re, n);
+    }
+    re->dnext[(size_t)s * re->ncls + cls] = t;
+    return t;
+}
+
+/*
+ * Does the pattern match anywhere in text[0..len)?
+ * This is the fast path for grep and awk patterns.
+ */
+static inline int re_match(Regex *re, const char *text, size_t len) {
+    if (!re->use_dfa) {
+        size_t s, e;
+        return re_search(re, text, len, 0, &s, &e);
+    }
+
+    int s = re_dfa_start(re);
+    if (s < 0) {
+        size_t ms, me;
+        return re_search(re, text, len, 0, &ms, &me);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (re->dstates[s].accept) return 1;
+        if (re->dstates[s].npcs == 0) return 0;
+        int cls = re->byte_class[(unsigned char)text[i]];
+        int t = re->dnext[(size_t)s * re->ncls + cls];
+        if (t < 0) t = re_dfa_step(re, s, cls);
+        if (t < 0) {
+            size_t ms, me;
+            return re_search(re, text, len, 0, &ms, &me);
+        }
+        s = t;
+    }
+    return re->dstates[s].accept_eol;
+}
+
+#endif /* REGEX_ENGINE_H */
@@ -1,154 +1,144 @@
 /**
  * sed - Stream editor for text transformation
- * Usage: sed <expression> <text>
- * Supports: s/pattern/replacement/[g]
+ * Usage: sed [-E] <expression> <text>
+ * Supports: s/pattern/replacement/[g][i][N]
+ * Patterns are POSIX basic regular expressions, or extended with -E (-r).
+ * The replacement may use & (whole match), \1-\9 (groups) and \n.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include "../stdin_read.h"
-
-#define MAX_LINE 65536
-
-// Simple pattern matching (not full regex)
-// Supports: . (any char), * (zero or more), ^ (start), $ (end)
-int match_pattern(const char *text, const char *pattern, int *match_start, int *match_end) {
-    const char *t = text;
-    const char *p = pattern;
-    int start = 0;
-
-    // Handle ^ anchor
-    if (*p == '^') {
-        p++;
-        start = 0;
+#include "../line_reader.h"
+#include "../stdout_write.h"
+#include "../regex_engine.h"
+
+// Write the replacement for the match [start, end), expanding & and \N
+static void emit_replacement(Regex *re, const char *replacement, int needs_groups,
+                      const char *line, size_t len, size_t start, size_t end) {
+    size_t caps[RE_MAX_GROUPS * 2];
+    int ngroups = 0;
+    if (needs_groups) {
+        ngroups = re_captures(re, line, len, start, end, caps);
     }
 
-    const char *text_start = t;
-
-    while (*t) {
-        const char *tt = t;
-        const char *pp = p;
-        int matched = 1;
-
-        while (*pp && *pp != '$') {
-            if (*(pp + 1) == '*') {
-                // Zero or more of previous char
-                char match_char = *pp;
-                pp += 2;
-
-                while (*tt && (match_char == '.' || *tt == match_char)) {
-                    tt++;
-                }
-            } else if (*pp == '.') {
-                // Match any character
-                if (*tt) {
-                    tt++;
-                    pp++;
-                } else {
-                    matched = 0;
-                    break;
+    for (const char *r = replacement; *r; r++) {
+        if (*r == '&') {
+            out_write(line + start, end - start);
+        } else if (*r == '\\' && r[1]) {
+            r++;
+            if (*r >= '1' && *r <= '9') {
+                int g = *r - '0';
+                if (g < ngroups && caps[g * 2] != (size_t)-1) {
+                    out_write(line + caps[g * 2], caps[g * 2 + 1] - caps[g * 2]);
                 }
-            } else if (*pp == *tt) {
-                tt++;
-                pp++;
+            } else if (*r == 'n') {
+                out_char('\n');
+            } else if (*r == 't') {
+                out_char('\t');
             } else {
-                matched = 0;
-                break;
+                out_char(*r);
             }
+        } else {
+            out_char(*r);
         }
+    }
+}
 
-        // Handle $ anchor
-        if (*pp == '$' && *tt != '\0' && *tt != '\n') {
-            matched = 0;
-        }
+// Substitute command. Writes straight to stdout, so lines of any length
+// are handled without a fixed-size result buffer.
+static void cmd_substitute(Regex *re, const char *line, size_t len, const char *replacement,
+                    int needs_groups, int global, int occurrence) {
+    // Matching lines are rare in typical use; the DFA rejects the rest
+    // without computing match positions
+    if (!re_match(re, line, len)) {
+        out_write(line, len);
+        return;
+    }
 
-        if (matched) {
-            *match_start = t - text_start;
-            *match_end = tt - text_start;
-            return 1;
+    size_t copied = 0;  // line[0..copied) has been written
+    size_t from = 0;
+    int have_prev = 0;
+    size_t prev_end = 0;
+    int count = 0;
+
+    while (from <= len) {
+        size_t start, end;
+        if (!re_search(re, line, len, from, &start, &end)) break;
+
+        // An empty match right after the previous match does not count
+        if (start == end && have_prev && start == prev_end) {
+            from = start + 1;
+            continue;
         }
 
-        // If pattern started with ^, only try at start
-        if (*pattern == '^') break;
+        count++;
+        if (count >= occurrence) {
+            out_write(line + copied, start - copied);
+            emit_replacement(re, replacement, needs_groups, line, len, start, end);
+            copied = end;
+            if (!global) break;
+        }
 
-        t++;
+        have_prev = 1;
+        prev_end = end;
+        from = end > start ? end : start + 1;
     }
 
-    return 0;
+    out_write(line + copied, len - copied);
 }
 
-// Substitute command
-void cmd_substitute(const char *text, const char *pattern, const char *replacement, int global) {
-    char result[MAX_LINE];
-    const char *src = text;
-    char *dst = result;
-    int replaced = 0;
-
-    while (*src) {
-        int match_start, match_end;
-
-        if ((!replaced || global) && match_pattern(src, pattern, &match_start, &match_end)) {
-            // Copy text before match
-            for (int i = 0; i < match_start; i++) {
-                *dst++ = src[i];
-            }
-
-            // Copy replacement
-            for (const char *r = replacement; *r; r++) {
-                *dst++ = *r;
+// Copy up to the next unescaped delimiter. "\<delim>" becomes the bare
+// delimiter; every other escape is kept for the regex or replacement.
+static const char *parse_part(const char *p, char delim, char *out) {
+    while (*p && *p != delim) {
+        if (*p == '\\' && p[1]) {
+            if (p[1] == delim) {
+                p++;
+            } else {
+                *out++ = *p++;
             }
-
-            src += match_end;
-            replaced = 1;
-        } else {
-            *dst++ = *src++;
         }
+        *out++ = *p++;
     }
-
-    *dst = '\0';
-    printf("%s", result);
+    *out = '\0';
+    return p;
 }
 
 // Parse s/pattern/replacement/flags
-int parse_substitute(const char *expr, char *pattern, char *replacement, int *global) {
+static int parse_substitute(const char *expr, char *pattern, char *replacement,
+                     int *global, int *icase, int *occurrence) {
     if (*expr != 's') return 0;
 
     char delim = expr[1];
-    if (!delim) return 0;
-
-    const char *p = expr + 2;
-    char *out = pattern;
+    if (!delim || delim == '\\' || delim == '\n') return 0;
 
     // Extract pattern
-    while (*p && *p != delim) {
-        if (*p == '\\' && *(p+1)) {
-            p++;
-        }
-        *out++ = *p++;
-    }
-    *out = '\0';
-
+    const char *p = parse_part(expr + 2, delim, pattern);
     if (*p != delim) return 0;
-    p++;
 
     // Extract replacement
-    out = replacement;
-    while (*p && *p != delim) {
-        if (*p == '\\' && *(p+1)) {
-            p++;
-        }
-        *out++ = *p++;
-    }
-    *out = '\0';
+    p = parse_part(p + 1, delim, replacement);
 
     // Check flags
     *global = 0;
+    *icase = 0;
+    *occurrence = 1;
     if (*p == delim) {
         p++;
         while (*p) {
-            if (*p == 'g') *global = 1;
+            if (*p == 'g') {
+                *global = 1;
+            } else if (*p == 'i' || *p == 'I') {
+                *icase = 1;
+            } else if (isdigit((unsigned char)*p)) {
+                *occurrence = atoi(p);
+                while (isdigit((unsigned char)p[1])) p++;
+                if (*occurrence < 1) return 0;
+            } else if (!isspace((unsigned char)*p)) {
+                return 0;
+            }
             p++;
         }
     }
@@ -157,40 +147,81 @@ int parse_substitute(const char *expr, char *pattern, char *replacement, int *gl
 }
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: sed <expression> [text]\nOr pipe text via stdin.\n");
-        return 1;
+    int extended = 0;
+    const char *expr = NULL;
+    const char *text = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-E") == 0 || strcmp(argv[i], "-r") == 0) {
+            extended = 1;
+        } else if (!expr) {
+            expr = argv[i];
+        } else if (!text) {
+            text = argv[i];
+        }
     }
 
-    const char *expr = argv[1];
-    const char *text = (argc >= 3) ? argv[2] : NULL;
-    char *stdin_buf = NULL;
-    if (!text) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) { fprintf(stderr, "Usage: sed <expression> <text>\nOr pipe text via stdin.\n"); return 1; }
-        text = stdin_buf;
+    if (!expr) {
+        fprintf(stderr, "Usage: sed [-E] <expression> [text]\nOr pipe text via stdin.\n");
+        return 1;
     }
 
-    char pattern[1024];
-    char replacement[1024];
-    int global;
+    size_t expr_len = strlen(expr);
+    char *pattern = (char *)malloc(expr_len + 1);
+    char *replacement = (char *)malloc(expr_len + 1);
+    int global, icase, occurrence;
+
+    if (!pattern || !replacement ||
+        !parse_substitute(expr, pattern, replacement, &global, &icase, &occurrence)) {
+        fprintf(stderr, "Error: Unsupported expression\n");
+        free(pattern);
+        free(replacement);
+        return 1;
+    }
 
-    if (parse_substitute(expr, pattern, replacement, &global)) {
-        char *text_copy = strdup(text);
-        char *line = strtok(text_copy, "\n");
+    const char *error;
+    Regex *re = re_compile(pattern, (extended ? RE_EXTENDED : 0) | (icase ? RE_ICASE : 0), &error);
+    if (!re) {
+        fprintf(stderr, "sed: invalid regular expression: %s\n", error);
+        free(pattern);
+        free(replacement);
+        return 1;
+    }
 
-        while (line) {
-            cmd_substitute(line, pattern, replacement, global);
-            putchar('\n');
-            line = strtok(NULL, "\n");
+    int needs_groups = 0;
+    for (const char *r = replacement; *r; r++) {
+        if (*r == '\\' && r[1]) {
+            r++;
+            if (*r >= '1' && *r <= '9') needs_groups = 1;
         }
+    }
 
-        free(text_copy);
+    LineReader reader;
+    if (text) {
+        line_reader_init_string(&reader, text);
     } else {
-        fprintf(stderr, "Error: Unsupported expression\n");
-        return 1;
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, "Usage: sed [-E] <expression> <text>\nOr pipe text via stdin.\n");
+            line_reader_free(&reader);
+            re_free(re);
+            free(pattern);
+            free(replacement);
+            return 1;
+        }
+    }
+
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        cmd_substitute(re, line, len, replacement, needs_groups, global, occurrence);
+        out_char('\n');
     }
 
-    free(stdin_buf);
+    line_reader_free(&reader);
+    re_free(re);
+    free(pattern);
+    free(replacement);
+    out_flush();
     return 0;
 }
@@ -1,117 +1,13 @@
 /**
- * sha512sum - Calculate SHA-512 hash
- * Usage: sha512sum <text>
+ * sha512sum - Print or check SHA-512 checksums
+ * Usage: sha512sum [-c] [--tag] [-b] [FILE]...
+ *
+ * SHA-512 (FIPS 180-4).
+ * See hashsum.h for options and output formats.
  */
 
-#include <stdio.h>
-#include <string.h>
-#include <stdint.h>
-#include <stdlib.h>
-#include "../stdin_read.h"
-
-static const uint64_t K[80] = {
-    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
-    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
-    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
-    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
-    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
-    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
-    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
-    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
-    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
-    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
-    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
-    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
-    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
-    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
-    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
-    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
-    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
-    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
-    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
-    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
-};
-
-#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
-#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
-#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
-#define SIG0(x) (ROTR64(x, 28) ^ ROTR64(x, 34) ^ ROTR64(x, 39))
-#define SIG1(x) (ROTR64(x, 14) ^ ROTR64(x, 18) ^ ROTR64(x, 41))
-#define sig0(x) (ROTR64(x, 1) ^ ROTR64(x, 8) ^ ((x) >> 7))
-#define sig1(x) (ROTR64(x, 19) ^ ROTR64(x, 61) ^ ((x) >> 6))
-
-void sha512(const uint8_t *data, size_t len, uint8_t *hash) {
-    uint64_t H[8] = {
-        0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
-        0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
-    };
-
-    size_t padded_len = ((len + 16) / 128 + 1) * 128;
-    uint8_t *padded = (uint8_t *)calloc(padded_len, 1);
-    memcpy(padded, data, len);
-    padded[len] = 0x80;
-
-    uint64_t bit_len = len * 8;
-    for (int i = 0; i < 8; i++) {
-        padded[padded_len - 1 - i] = (bit_len >> (i * 8)) & 0xff;
-    }
-
-    for (size_t offset = 0; offset < padded_len; offset += 128) {
-        uint64_t W[80];
-
-        for (int i = 0; i < 16; i++) {
-            W[i] = 0;
-            for (int j = 0; j < 8; j++) {
-                W[i] = (W[i] << 8) | padded[offset + i*8 + j];
-            }
-        }
-        for (int i = 16; i < 80; i++) {
-            W[i] = sig1(W[i-2]) + W[i-7] + sig0(W[i-15]) + W[i-16];
-        }
-
-        uint64_t a = H[0], b = H[1], c = H[2], d = H[3];
-        uint64_t e = H[4], f = H[5], g = H[6], h = H[7];
-
-        for (int i = 0; i < 80; i++) {
-            uint64_t T1 = h + SIG1(e) + CH(e, f, g) + K[i] + W[i];
-            uint64_t T2 = SIG0(a) + MAJ(a, b, c);
-            h = g; g = f; f = e; e = d + T1;
-            d = c; c = b; b = a; a = T1 + T2;
-        }
-
-        H[0] += a; H[1] += b; H[2] += c; H[3] += d;
-        H[4] += e; H[5] += f; H[6] += g; H[7] += h;
-    }
-
-    free(padded);
-
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            hash[i*8 + j] = (H[i] >> (56 - j*8)) & 0xff;
-        }
-    }
-}
+#include "../hashsum.h"
 
 int main(int argc, char **argv) {
-    const char *input = (argc >= 2) ? argv[1] : NULL;
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: sha512sum <text>\nOr pipe input via stdin.\n");
-            return 1;
-        }
-        input = stdin_buf;
-    }
-
-    uint8_t hash[64];
-    sha512((const uint8_t *)input, strlen(input), hash);
-
-    for (int i = 0; i < 64; i++) {
-        printf("%02x", hash[i]);
-    }
-    printf("\n");
-
-    free(stdin_buf);
-    return 0;
+    return hashsum_main(argc, argv, "sha512sum", &HASH_SHA512);
 }
@@ -11,7 +11,7 @@
 
 #define MAX_LINE 4096
 
-void format_shell(const char *script) {
+static void format_shell(const char *script) {
     char *script_copy = strdup(script);
     int indent_level = 0;
     int in_string = 0;
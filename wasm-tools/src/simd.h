@@ -0,0 +1,297 @@
+/**
+ * Byte-scanning kernels for WASM tools.
+ *
+ * When compiled with -msimd128 (build.sh produces a <tool>.simd.wasm
+ * variant for every tool that includes this header) the kernels process
+ * 16 bytes per step with wasm simd128 instructions. Otherwise they fall
+ * back to word-at-a-time (SWAR) scalar code, which is still 8 bytes per
+ * step, so the plain .wasm stays correct on engines without SIMD.
+ *
+ * - simd_memchr():       first occurrence of a byte
+ * - simd_count_byte():   number of occurrences of a byte (newline counting)
+ * - simd_match16():      bitmask of the positions of a byte in a 16-byte
+ *                        block, for walking every occurrence (cut fields)
+ * - simd_memmem():       substring search; candidate positions are found by
+ *                        comparing the needle's first and last bytes against
+ *                        two shifted blocks at once, and only those are
+ *                        verified with memcmp
+ * - simd_memmem_icase(): the same with ASCII case folding done in-register
+ * - simd_find_set():     first byte that belongs to a SimdByteSet (the
+ *                        first bytes of a set of patterns); lanes are
+ *                        classified by two nibble-table lookups
+ *                        (i8x16.swizzle) and candidates are checked
+ *                        against the exact set
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+static inline unsigned char simd_lower_byte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c | 0x20) : c;
+}
+
+/* Compare n bytes ignoring ASCII case */
+static inline int simd_equal_icase(const unsigned char *a, const unsigned char *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (simd_lower_byte(a[i]) != simd_lower_byte(b[i])) return 0;
+    }
+    return 1;
+}
+
+#ifdef __wasm_simd128__
+
+/* Lowercase ASCII letters in all 16 lanes */
+static inline v128_t simd_lower16(v128_t v) {
+    v128_t upper = wasm_v128_and(wasm_u8x16_ge(v, wasm_i8x16_splat('A')),
+                                 wasm_u8x16_le(v, wasm_i8x16_splat('Z')));
+    return wasm_v128_or(v, wasm_v128_and(upper, wasm_i8x16_splat(0x20)));
+}
+
+#else
+
+#define SIMD_ONES 0x0101010101010101ULL
+#define SIMD_HIGHS 0x8080808080808080ULL
+
+static inline uint64_t simd_load64(const unsigned char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/* 0x80 in every byte of w that is zero, 0 elsewhere (exact, no false hits) */
+static inline uint64_t simd_zero_bytes(uint64_t w) {
+    const uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+    return ~(((w & low7) + low7) | w | low7);
+}
+
+#endif
+
+static inline const void *simd_memchr(const void *s, int c, size_t n) {
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *end = p + n;
+    unsigned char b = (unsigned char)c;
+
+#ifdef __wasm_simd128__
+    v128_t needle = wasm_i8x16_splat((int8_t)b);
+    while (end - p >= 16) {
+        uint32_t mask = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(p), needle));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#else
+    uint64_t pattern = SIMD_ONES * b;
+    while (end - p >= 8) {
+        uint64_t hits = simd_zero_bytes(simd_load64(p) ^ pattern);
+        if (hits) {
+            /* Lowest set byte of hits = first match (little-endian load) */
+            return p + (__builtin_ctzll(hits) >> 3);
+        }
+        p += 8;
+    }
+#endif
+
+    for (; p < end; p++) {
+        if (*p == b) return p;
+    }
+    return NULL;
+}
+
+static inline size_t simd_count_byte(const void *s, int c, size_t n) {
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *end = p + n;
+    unsigned char b = (unsigned char)c;
+    size_t count = 0;
+
+#ifdef __wasm_simd128__
+    v128_t needle = wasm_i8x16_splat((int8_t)b);
+    while (end - p >= 16) {
+        /* Matching lanes are -1; subtracting adds one per lane. A lane
+         * can absorb at most 255 blocks before it must be widened. */
+        v128_t acc = wasm_i8x16_splat(0);
+        size_t blocks = (size_t)(end - p) / 16;
+        if (blocks > 255) blocks = 255;
+        for (size_t i = 0; i < blocks; i++, p += 16) {
+            acc = wasm_i8x16_sub(acc, wasm_i8x16_eq(wasm_v128_load(p), needle));
+        }
+        v128_t sum = wasm_u32x4_extadd_pairwise_u16x8(wasm_u16x8_extadd_pairwise_u8x16(acc));
+        count += wasm_u32x4_extract_lane(sum, 0) + wasm_u32x4_extract_lane(sum, 1) +
+                 wasm_u32x4_extract_lane(sum, 2) + wasm_u32x4_extract_lane(sum, 3);
+    }
+#else
+    uint64_t pattern = SIMD_ONES * b;
+    while (end - p >= 8) {
+        count += (size_t)__builtin_popcountll(simd_zero_bytes(simd_load64(p) ^ pattern));
+        p += 8;
+    }
+#endif
+
+    for (; p < end; p++) {
+        count += *p == b;
+    }
+    return count;
+}
+
+/*
+ * Bit i set where p[i] == c, for the 16 bytes at p (all must be
+ * readable). Callers walk the set bits with __builtin_ctz.
+ */
+static inline uint32_t simd_match16(const void *p, int c) {
+#ifdef __wasm_simd128__
+    return wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(p), wasm_i8x16_splat((int8_t)c)));
+#else
+    const unsigned char *b = (const unsigned char *)p;
+    uint64_t pattern = SIMD_ONES * (unsigned char)c;
+    /* One bit per matching byte, gathered into the top byte by the multiply */
+    uint64_t lo = simd_zero_bytes(simd_load64(b) ^ pattern) >> 7;
+    uint64_t hi = simd_zero_bytes(simd_load64(b + 8) ^ pattern) >> 7;
+    return (uint32_t)((lo * 0x0102040810204080ULL) >> 56) | (uint32_t)((hi * 0x0102040810204080ULL) >> 56) << 8;
+#endif
+}
+
+/*
+ * Find needle in haystack. Returns a pointer to the first occurrence or
+ * NULL. An empty needle matches at the start.
+ */
+static inline const char *simd_memmem(const char *haystack, size_t hlen,
+                               const char *needle, size_t nlen) {
+    const unsigned char *h = (const unsigned char *)haystack;
+    const unsigned char *n = (const unsigned char *)needle;
+
+    if (nlen == 0) return haystack;
+    if (nlen > hlen) return NULL;
+    if (nlen == 1) return (const char *)simd_memchr(h, n[0], hlen);
+
+    size_t last = hlen - nlen;  /* Last valid start position */
+    size_t i = 0;
+
+#ifdef __wasm_simd128__
+    v128_t first_v = wasm_i8x16_splat((int8_t)n[0]);
+    v128_t last_v = wasm_i8x16_splat((int8_t)n[nlen - 1]);
+    /* Both loads stay inside the haystack while i + nlen - 1 + 16 <= hlen */
+    for (; i + 16 <= last + 1; i += 16) {
+        v128_t block_first = wasm_v128_load(h + i);
+        v128_t block_last = wasm_v128_load(h + i + nlen - 1);
+        uint32_t mask = wasm_i8x16_bitmask(wasm_v128_and(wasm_i8x16_eq(block_first, first_v),
+                                                         wasm_i8x16_eq(block_last, last_v)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(h + pos + 1, n + 1, nlen - 2) == 0) return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* Scalar: jump between occurrences of the first byte */
+    while (i <= last) {
+        const unsigned char *hit = (const unsigned char *)simd_memchr(h + i, n[0], last - i + 1);
+        if (!hit) return NULL;
+        size_t pos = (size_t)(hit - h);
+        if (h[pos + nlen - 1] == n[nlen - 1] && memcmp(h + pos + 1, n + 1, nlen - 2) == 0) {
+            return haystack + pos;
+        }
+        i = pos + 1;
+    }
+    return NULL;
+}
+
+/* simd_memmem() ignoring ASCII case */
+static inline const char *simd_memmem_icase(const char *haystack, size_t hlen,
+                                     const char *needle, size_t nlen) {
+    const unsigned char *h = (const unsigned char *)haystack;
+    const unsigned char *n = (const unsigned char *)needle;
+
+    if (nlen == 0) return haystack;
+    if (nlen > hlen) return NULL;
+
+    unsigned char first = simd_lower_byte(n[0]);
+    unsigned char last_byte = simd_lower_byte(n[nlen - 1]);
+    size_t last = hlen - nlen;
+    size_t i = 0;
+
+#ifdef __wasm_simd128__
+    v128_t first_v = wasm_i8x16_splat((int8_t)first);
+    v128_t last_v = wasm_i8x16_splat((int8_t)last_byte);
+    for (; i + 16 <= last + 1; i += 16) {
+        v128_t block_first = simd_lower16(wasm_v128_load(h + i));
+        v128_t block_last = simd_lower16(wasm_v128_load(h + i + nlen - 1));
+        uint32_t mask = wasm_i8x16_bitmask(wasm_v128_and(wasm_i8x16_eq(block_first, first_v),
+                                                         wasm_i8x16_eq(block_last, last_v)));
+        while (mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (simd_equal_icase(h + pos, n, nlen)) return haystack + pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i <= last; i++) {
+        if (simd_lower_byte(h[i]) == first &&
+            simd_lower_byte(h[i + nlen - 1]) == last_byte &&
+            simd_equal_icase(h + i, n, nlen)) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * A set of bytes for simd_find_set(). Bytes are spread over eight buckets
+ * by their high nibble; lo[] and hi[] hold the buckets present for each
+ * low and high nibble, so (lo[c & 15] & hi[c >> 4]) != 0 for every member
+ * and for a few non-members sharing their nibbles. member[] is exact.
+ */
+typedef struct {
+    uint8_t lo[16];
+    uint8_t hi[16];
+    uint8_t member[32];
+} SimdByteSet;
+
+static inline void simd_byte_set_add(SimdByteSet *set, unsigned char c) {
+    uint8_t bucket = (uint8_t)(1u << ((c >> 4) & 7));
+    set->lo[c & 15] |= bucket;
+    set->hi[c >> 4] |= bucket;
+    set->member[c >> 3] |= (uint8_t)(1u << (c & 7));
+}
+
+static inline int simd_byte_set_has(const SimdByteSet *set, unsigned char c) {
+    return (set->member[c >> 3] >> (c & 7)) & 1;
+}
+
+/* First byte of s[0..n) in set, or NULL */
+static inline const void *simd_find_set(const SimdByteSet *set, const void *s, size_t n) {
+    const unsigned char *p = (const unsigned char *)s;
+    const unsigned char *end = p + n;
+
+#ifdef __wasm_simd128__
+    v128_t lo_table = wasm_v128_load(set->lo);
+    v128_t hi_table = wasm_v128_load(set->hi);
+    v128_t nibble = wasm_i8x16_splat(0x0f);
+    while (end - p >= 16) {
+        v128_t v = wasm_v128_load(p);
+        v128_t lo = wasm_i8x16_swizzle(lo_table, wasm_v128_and(v, nibble));
+        v128_t hi = wasm_i8x16_swizzle(hi_table, wasm_u8x16_shr(v, 4));
+        uint32_t mask = wasm_i8x16_bitmask(wasm_i8x16_ne(wasm_v128_and(lo, hi), wasm_i8x16_splat(0)));
+        while (mask) {
+            const unsigned char *hit = p + __builtin_ctz(mask);
+            if (simd_byte_set_has(set, *hit)) return hit;
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+
+    for (; p < end; p++) {
+        if (simd_byte_set_has(set, *p)) return p;
+    }
+    return NULL;
+}
+
+#endif /* SIMD_H */
@@ -1,74 +1,755 @@
 /**
  * sort - Sort lines of text
- * Usage: sort [-r] [-n] <text>
- * Options: -r (reverse), -n (numeric sort)
+ * Usage: sort [-r] [-n] [-u] [-f] [-b] [-s] [-t SEP] [-k POS1[,POS2]] [-S SIZE] <text>
+ * Options: -r (reverse), -n (numeric sort), -u (unique), -f (fold case),
+ *          -b (ignore leading blanks), -s (stable, no last-resort compare),
+ *          -t (field separator), -k (sort key, repeatable), -S (memory budget)
+ * Keys: F[.C][opts][,F[.C][opts]] with fields and characters numbered from 1
+ *       and opts from n, r, f, b (e.g. -k2,2n -k1.3). A key with options does
+ *       not inherit the global -n/-r/-f/-b.
+ * SIZE: number with suffix b, K (default), M or G.
+ * Long forms --reverse, --numeric, --unique, --key and --fieldSeparator are
+ * accepted as passed by the tool registry.
+ *
+ * Lines are collected until the memory budget is reached, sorted and written
+ * to a scratch file under /tmp as a sorted run. The runs are then merged,
+ * SORT_MERGE_FANIN at a time. Input that fits in the budget never touches
+ * the file system, and if scratch files cannot be created the whole input
+ * is sorted in memory instead.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include <stdint.h>
+#include <ctype.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
 
-#define MAX_LINES 10000
-#define MAX_LINE_LEN 4096
+#define SORT_DEFAULT_BUDGET (32u * 1024 * 1024)
+#define SORT_MIN_BUDGET (64u * 1024)
+#define SORT_MERGE_FANIN 16
+#define SORT_MAX_KEYS 16
+#define SORT_ARENA_BLOCK (1024 * 1024)
 
-static char *lines[MAX_LINES];
-static int num_lines = 0;
-static int reverse_sort = 0;
-static int numeric_sort = 0;
+#define USAGE "Usage: sort [-r] [-n] [-u] [-f] [-b] [-s] [-t SEP] [-k POS1[,POS2]] [-S SIZE] <text>\nOr pipe input via stdin.\n"
 
-int compare_strings(const void *a, const void *b) {
-    const char *s1 = *(const char **)a;
-    const char *s2 = *(const char **)b;
-    int result;
+// Key flags
+#define KEY_NUMERIC    1
+#define KEY_REVERSE    2
+#define KEY_FOLD       4
+#define KEY_BLANKS     8   // Skip leading blanks before the start position
+#define KEY_BLANKS_END 16  // Skip leading blanks before the end position
 
-    if (numeric_sort) {
-        result = atoi(s1) - atoi(s2);
+typedef struct {
+    int start_field, start_char;  // 1-based; start_char 0 = start of field
+    int end_field, end_char;      // end_field 0 = end of line; end_char 0 = end of field
+    int flags;
+} SortKey;
+
+// A line plus its pre-parsed first key. prefix orders records by the first
+// key (numbers exactly, text by its first 8 bytes), so most comparisons
+// never look at the line itself.
+typedef struct {
+    const char *line;
+    uint32_t len;
+    uint32_t key_start;
+    uint32_t key_len;
+    uint64_t prefix;
+} SortRec;
+
+static SortKey keys[SORT_MAX_KEYS];
+static int num_keys = 0;
+static int global_flags = 0;
+static int unique_lines = 0;
+static int stable_sort = 0;
+static int field_sep = -1;
+
+// ============================================================================
+// Key extraction
+// ============================================================================
+
+static int is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Offset of field f (1-based). Without -t a field is a run of blanks
+// followed by non-blanks, so leading blanks belong to the field.
+static size_t field_start(const char *s, size_t len, int f) {
+    size_t i = 0;
+    for (int n = 1; n < f && i < len; n++) {
+        if (field_sep >= 0) {
+            const char *p = (const char *)memchr(s + i, field_sep, len - i);
+            if (!p) return len;
+            i = (size_t)(p - s) + 1;
+        } else {
+            while (i < len && is_blank(s[i])) i++;
+            while (i < len && !is_blank(s[i])) i++;
+        }
+    }
+    return i;
+}
+
+static size_t field_end(const char *s, size_t len, size_t start) {
+    if (field_sep >= 0) {
+        const char *p = (const char *)memchr(s + start, field_sep, len - start);
+        return p ? (size_t)(p - s) : len;
+    }
+    size_t i = start;
+    while (i < len && is_blank(s[i])) i++;
+    while (i < len && !is_blank(s[i])) i++;
+    return i;
+}
+
+static void key_span(const char *s, size_t len, const SortKey *k, size_t *ks, size_t *ke) {
+    size_t start = field_start(s, len, k->start_field);
+    if (k->flags & KEY_BLANKS) {
+        while (start < len && is_blank(s[start])) start++;
+    }
+    if (k->start_char > 0) {
+        start += (size_t)k->start_char - 1;
+        if (start > len) start = len;
+    }
+
+    size_t end = len;
+    if (k->end_field > 0) {
+        size_t fs = field_start(s, len, k->end_field);
+        if (k->end_char == 0) {
+            end = field_end(s, len, fs);
+        } else {
+            if (k->flags & KEY_BLANKS_END) {
+                while (fs < len && is_blank(s[fs])) fs++;
+            }
+            end = fs + (size_t)k->end_char;
+            if (end > len) end = len;
+        }
+    }
+
+    if (end < start) end = start;
+    *ks = start;
+    *ke = end;
+}
+
+// Leading number as -n reads it: blanks, optional '-', digits, optional
+// fraction. Anything else counts as 0.
+static double parse_number(const char *s, size_t len) {
+    char buf[64];
+    size_t i = 0, n = 0;
+    while (i < len && is_blank(s[i])) i++;
+    if (i < len && s[i] == '-') buf[n++] = s[i++];
+    while (i < len && n < sizeof(buf) - 1 && (isdigit((unsigned char)s[i]) || s[i] == '.')) {
+        if (s[i] == '.' && memchr(buf, '.', n)) break;
+        buf[n++] = s[i++];
+    }
+    buf[n] = '\0';
+    double v = strtod(buf, NULL);
+    return v == 0 ? 0.0 : v;  // -0 sorts with 0
+}
+
+// Map a double to an unsigned integer with the same ordering
+static uint64_t number_prefix(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+static uint64_t text_prefix(const char *s, size_t len, int fold) {
+    uint64_t p = 0;
+    for (size_t i = 0; i < 8; i++) {
+        unsigned char c = i < len ? (unsigned char)s[i] : 0;
+        if (fold) c = (unsigned char)toupper(c);
+        p = (p << 8) | c;
+    }
+    return p;
+}
+
+static void make_record(SortRec *r, const char *line, size_t len) {
+    const SortKey *k = &keys[0];
+    size_t ks, ke;
+    key_span(line, len, k, &ks, &ke);
+
+    r->line = line;
+    r->len = (uint32_t)len;
+    r->key_start = (uint32_t)ks;
+    r->key_len = (uint32_t)(ke - ks);
+    if (k->flags & KEY_NUMERIC) {
+        r->prefix = number_prefix(parse_number(line + ks, ke - ks));
     } else {
-        result = strcmp(s1, s2);
+        r->prefix = text_prefix(line + ks, ke - ks, k->flags & KEY_FOLD);
+    }
+    if (k->flags & KEY_REVERSE) r->prefix = ~r->prefix;
+}
+
+// ============================================================================
+// Comparison
+// ============================================================================
+
+static int compare_text(const char *a, size_t alen, const char *b, size_t blen, int fold) {
+    size_t n = alen < blen ? alen : blen;
+    int c;
+    if (fold) {
+        c = 0;
+        for (size_t i = 0; i < n && c == 0; i++) {
+            c = toupper((unsigned char)a[i]) - toupper((unsigned char)b[i]);
+        }
+    } else {
+        c = memcmp(a, b, n);
+    }
+    if (c) return c < 0 ? -1 : 1;
+    return alen < blen ? -1 : alen > blen;
+}
+
+static int compare_span(const char *a, size_t alen, const char *b, size_t blen, int flags) {
+    int c;
+    if (flags & KEY_NUMERIC) {
+        double x = parse_number(a, alen), y = parse_number(b, blen);
+        c = x < y ? -1 : x > y;
+    } else {
+        c = compare_text(a, alen, b, blen, flags & KEY_FOLD);
+    }
+    return (flags & KEY_REVERSE) ? -c : c;
+}
+
+static int compare_records(const SortRec *a, const SortRec *b) {
+    if (a->prefix != b->prefix) return a->prefix < b->prefix ? -1 : 1;
+
+    // Same prefix: numbers are equal, text needs the rest of the key
+    int c = 0;
+    if (!(keys[0].flags & KEY_NUMERIC)) {
+        c = compare_span(a->line + a->key_start, a->key_len,
+                         b->line + b->key_start, b->key_len, keys[0].flags);
+        if (c) return c;
+    }
+
+    for (int i = 1; i < num_keys; i++) {
+        size_t as, ae, bs, be;
+        key_span(a->line, a->len, &keys[i], &as, &ae);
+        key_span(b->line, b->len, &keys[i], &bs, &be);
+        c = compare_span(a->line + as, ae - as, b->line + bs, be - bs, keys[i].flags);
+        if (c) return c;
+    }
+
+    // Last resort: whole line, byte by byte
+    if (unique_lines || stable_sort) return 0;
+    c = compare_text(a->line, a->len, b->line, b->len, 0);
+    return (global_flags & KEY_REVERSE) ? -c : c;
+}
+
+// ============================================================================
+// In-memory sort: LSD radix on the prefix, then a stable merge sort over
+// each run of equal prefixes using the full comparison
+// ============================================================================
+
+static void merge_sort(SortRec *a, SortRec *tmp, size_t n) {
+    if (n <= 16) {
+        for (size_t i = 1; i < n; i++) {
+            SortRec x = a[i];
+            size_t j = i;
+            while (j > 0 && compare_records(&a[j - 1], &x) > 0) {
+                a[j] = a[j - 1];
+                j--;
+            }
+            a[j] = x;
+        }
+        return;
+    }
+
+    size_t mid = n / 2;
+    merge_sort(a, tmp, mid);
+    merge_sort(a + mid, tmp, n - mid);
+    if (compare_records(&a[mid - 1], &a[mid]) <= 0) return;
+
+    memcpy(tmp, a, mid * sizeof(SortRec));
+    size_t i = 0, j = mid, k = 0;
+    while (i < mid && j < n) {
+        if (compare_records(&a[j], &tmp[i]) < 0) {
+            a[k++] = a[j++];
+        } else {
+            a[k++] = tmp[i++];
+        }
+    }
+    while (i < mid) a[k++] = tmp[i++];
+}
+
+static int sort_records(SortRec *recs, size_t n) {
+    if (n < 2) return 1;
+    SortRec *tmp = (SortRec *)malloc(n * sizeof(SortRec));
+    if (!tmp) return 0;
+
+    SortRec *src = recs, *dst = tmp;
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = {0};
+        for (size_t i = 0; i < n; i++) count[(src[i].prefix >> shift) & 0xff]++;
+        if (count[(src[0].prefix >> shift) & 0xff] == n) continue;  // Byte is the same everywhere
+
+        size_t pos = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t c = count[b];
+            count[b] = pos;
+            pos += c;
+        }
+        for (size_t i = 0; i < n; i++) dst[count[(src[i].prefix >> shift) & 0xff]++] = src[i];
+        SortRec *t = src; src = dst; dst = t;
+    }
+    if (src != recs) memcpy(recs, src, n * sizeof(SortRec));
+
+    for (size_t i = 0; i < n; ) {
+        size_t j = i + 1;
+        while (j < n && recs[j].prefix == recs[i].prefix) j++;
+        if (j - i > 1) merge_sort(recs + i, tmp, j - i);
+        i = j;
+    }
+
+    free(tmp);
+    return 1;
+}
+
+// ============================================================================
+// Output: stdout or a run file, with -u de-duplication
+// ============================================================================
+
+typedef struct {
+    FILE *fp;        // NULL = stdout
+    int have_last;
+    SortRec last;    // Last line written (copied into last_buf)
+    char *last_buf;
+    size_t last_cap;
+} Sink;
+
+static void sink_write(Sink *s, const SortRec *r) {
+    if (unique_lines && s->have_last && compare_records(&s->last, r) == 0) return;
+
+    if (s->fp) {
+        fwrite(r->line, 1, r->len, s->fp);
+        fputc('\n', s->fp);
+    } else {
+        out_write(r->line, r->len);
+        out_char('\n');
+    }
+
+    if (unique_lines) {
+        // Keep a private copy: the record's storage may be reused
+        if (r->len + 1 > s->last_cap) {
+            size_t cap = (r->len + 1) * 2;
+            char *tmp = (char *)realloc(s->last_buf, cap);
+            if (!tmp) { s->have_last = 0; return; }
+            s->last_buf = tmp;
+            s->last_cap = cap;
+        }
+        memcpy(s->last_buf, r->line, r->len);
+        s->last_buf[r->len] = '\0';
+        s->last = *r;
+        s->last.line = s->last_buf;
+        s->have_last = 1;
+    }
+}
+
+// ============================================================================
+// Record storage
+// ============================================================================
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;
+    size_t bytes;      // Line bytes plus record array, compared to the budget
+    SortRec *recs;
+    size_t nrecs, cap;
+} Batch;
+
+static char *batch_copy_line(Batch *b, const char *line, size_t len) {
+    ArenaBlock *blk = b->blocks;
+    if (!blk || blk->cap - blk->used < len + 1) {
+        size_t cap = len + 1 > SORT_ARENA_BLOCK ? len + 1 : SORT_ARENA_BLOCK;
+        blk = (ArenaBlock *)malloc(sizeof(ArenaBlock) + cap);
+        if (!blk) return NULL;
+        blk->next = b->blocks;
+        blk->used = 0;
+        blk->cap = cap;
+        b->blocks = blk;
+    }
+    char *dst = blk->data + blk->used;
+    memcpy(dst, line, len);
+    dst[len] = '\0';
+    blk->used += len + 1;
+    return dst;
+}
+
+static int batch_add(Batch *b, const char *line, size_t len) {
+    if (b->nrecs == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        SortRec *tmp = (SortRec *)realloc(b->recs, cap * sizeof(SortRec));
+        if (!tmp) return 0;
+        b->recs = tmp;
+        b->cap = cap;
+    }
+    char *copy = batch_copy_line(b, line, len);
+    if (!copy) return 0;
+    make_record(&b->recs[b->nrecs++], copy, len);
+    b->bytes += len + 1 + sizeof(SortRec);
+    return 1;
+}
+
+static void batch_clear(Batch *b) {
+    while (b->blocks) {
+        ArenaBlock *next = b->blocks->next;
+        free(b->blocks);
+        b->blocks = next;
     }
+    b->nrecs = 0;
+    b->bytes = 0;
+}
+
+// ============================================================================
+// External runs
+// ============================================================================
+
+typedef struct {
+    char **names;
+    int count, cap;
+    int next_id;
+} RunList;
+
+static char *run_name(RunList *runs) {
+    char name[64];
+    snprintf(name, sizeof(name), "/tmp/sort.%d", runs->next_id++);
+    return strdup(name);
+}
 
-    return reverse_sort ? -result : result;
+static int run_push(RunList *runs, char *name) {
+    if (runs->count == runs->cap) {
+        int cap = runs->cap ? runs->cap * 2 : 16;
+        char **tmp = (char **)realloc(runs->names, cap * sizeof(char *));
+        if (!tmp) return 0;
+        runs->names = tmp;
+        runs->cap = cap;
+    }
+    runs->names[runs->count++] = name;
+    return 1;
+}
+
+// Sort the batch and write it to a new run. Returns 0 if no scratch file
+// could be created (the caller then keeps everything in memory).
+static int spill_batch(Batch *b, RunList *runs) {
+    char *name = run_name(runs);
+    FILE *fp = name ? fopen(name, "w") : NULL;
+    if (!fp || !sort_records(b->recs, b->nrecs)) {
+        if (fp) { fclose(fp); remove(name); }
+        free(name);
+        return 0;
+    }
+    setvbuf(fp, NULL, _IOFBF, 65536);
+
+    Sink sink = {0};
+    sink.fp = fp;
+    for (size_t i = 0; i < b->nrecs; i++) sink_write(&sink, &b->recs[i]);
+    free(sink.last_buf);
+
+    int ok = !ferror(fp);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || !run_push(runs, name)) {
+        remove(name);
+        free(name);
+        return 0;
+    }
+    batch_clear(b);
+    return 1;
+}
+
+typedef struct {
+    FILE *fp;
+    LineReader reader;
+    SortRec rec;
+} RunCursor;
+
+static int cursor_advance(RunCursor *c) {
+    char *line;
+    size_t len;
+    if (!line_reader_next(&c->reader, &line, &len)) return 0;
+    make_record(&c->rec, line, len);
+    return 1;
+}
+
+// Heap order: smallest record first, earlier run on ties (keeps -s stable)
+static int cursor_less(RunCursor *cur, int a, int b) {
+    int c = compare_records(&cur[a].rec, &cur[b].rec);
+    return c < 0 || (c == 0 && a < b);
+}
+
+static void heap_sift(RunCursor *cur, int *heap, int n, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && cursor_less(cur, heap[l], heap[m])) m = l;
+        if (r < n && cursor_less(cur, heap[r], heap[m])) m = r;
+        if (m == i) return;
+        int t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+// k-way merge of the n runs in names into sink. Returns 0 on I/O failure.
+static int merge_runs(char **names, int n, Sink *sink) {
+    RunCursor *cur = (RunCursor *)calloc(n, sizeof(RunCursor));
+    int *heap = (int *)malloc(n * sizeof(int));
+    int ok = cur != NULL && heap != NULL;
+    int heap_n = 0;
+
+    for (int i = 0; ok && i < n; i++) {
+        cur[i].fp = fopen(names[i], "r");
+        if (!cur[i].fp || !line_reader_init_file(&cur[i].reader, cur[i].fp)) {
+            ok = 0;
+            break;
+        }
+        if (cursor_advance(&cur[i])) heap[heap_n++] = i;
+    }
+
+    if (ok) {
+        for (int i = heap_n / 2 - 1; i >= 0; i--) heap_sift(cur, heap, heap_n, i);
+        while (heap_n > 0) {
+            int top = heap[0];
+            sink_write(sink, &cur[top].rec);
+            if (!cursor_advance(&cur[top])) heap[0] = heap[--heap_n];
+            heap_sift(cur, heap, heap_n, 0);
+        }
+    }
+
+    for (int i = 0; cur && i < n; i++) {
+        if (cur[i].fp) {
+            if (cur[i].reader.error) ok = 0;
+            line_reader_free(&cur[i].reader);
+            fclose(cur[i].fp);
+        }
+        remove(names[i]);
+    }
+    free(cur);
+    free(heap);
+    return ok;
+}
+
+// Merge groups of SORT_MERGE_FANIN runs until one pass can reach stdout.
+// Groups are consecutive, so earlier input stays in earlier runs.
+static int merge_all(RunList *runs) {
+    while (runs->count > SORT_MERGE_FANIN) {
+        RunList next = {0};
+        next.next_id = runs->next_id;
+        for (int i = 0; i < runs->count; i += SORT_MERGE_FANIN) {
+            int n = runs->count - i < SORT_MERGE_FANIN ? runs->count - i : SORT_MERGE_FANIN;
+            char *name = run_name(&next);
+            FILE *fp = name ? fopen(name, "w") : NULL;
+            if (!fp) { free(name); return 0; }
+            setvbuf(fp, NULL, _IOFBF, 65536);
+
+            Sink sink = {0};
+            sink.fp = fp;
+            int ok = merge_runs(runs->names + i, n, &sink);
+            free(sink.last_buf);
+            if (ferror(fp)) ok = 0;
+            fclose(fp);
+            for (int j = i; j < i + n; j++) free(runs->names[j]);
+            if (!ok || !run_push(&next, name)) return 0;
+        }
+        free(runs->names);
+        *runs = next;
+    }
+
+    Sink sink = {0};
+    int ok = merge_runs(runs->names, runs->count, &sink);
+    free(sink.last_buf);
+    for (int i = 0; i < runs->count; i++) free(runs->names[i]);
+    free(runs->names);
+    return ok;
+}
+
+// ============================================================================
+// Options
+// ============================================================================
+
+static int parse_key_flags(const char **p, int *flags, int blank_flag) {
+    int any = 0;
+    for (;; (*p)++) {
+        switch (**p) {
+            case 'n': *flags |= KEY_NUMERIC; break;
+            case 'r': *flags |= KEY_REVERSE; break;
+            case 'f': *flags |= KEY_FOLD; break;
+            case 'b': *flags |= blank_flag; break;
+            default: return any;
+        }
+        any = 1;
+    }
+}
+
+static int parse_position(const char **p, int *field, int *chr) {
+    if (!isdigit((unsigned char)**p)) return 0;
+    *field = (int)strtol(*p, (char **)p, 10);
+    *chr = 0;
+    if (**p == '.') {
+        (*p)++;
+        if (!isdigit((unsigned char)**p)) return 0;
+        *chr = (int)strtol(*p, (char **)p, 10);
+    }
+    return 1;
+}
+
+// Parse F[.C][opts][,F[.C][opts]]. Flags stay -1 when the key names none.
+static int parse_key(const char *spec, SortKey *k) {
+    const char *p = spec;
+    int flags = 0, any;
+    memset(k, 0, sizeof(*k));
+
+    if (!parse_position(&p, &k->start_field, &k->start_char) || k->start_field < 1) return 0;
+    any = parse_key_flags(&p, &flags, KEY_BLANKS);
+    if (*p == ',') {
+        p++;
+        if (!parse_position(&p, &k->end_field, &k->end_char) || k->end_field < 1) return 0;
+        any |= parse_key_flags(&p, &flags, KEY_BLANKS_END);
+    }
+    if (*p) return 0;
+    k->flags = any ? flags : -1;
+    return 1;
+}
+
+// SIZE with optional suffix b, K (default), M, G
+static size_t parse_size(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || v <= 0) return 0;
+    switch (*end) {
+        case 'b': break;
+        case 'k': case 'K': case '\0': v *= 1024; break;
+        case 'm': case 'M': v *= 1024.0 * 1024; break;
+        case 'g': case 'G': v *= 1024.0 * 1024 * 1024; break;
+        default: return 0;
+    }
+    if (*end && end[1]) return 0;
+    return v > (double)SIZE_MAX / 2 ? SIZE_MAX / 2 : (size_t)v;
+}
+
+static int add_key(const char *spec) {
+    if (num_keys == SORT_MAX_KEYS || !parse_key(spec, &keys[num_keys])) {
+        fprintf(stderr, "sort: invalid key: %s\n", spec);
+        return 0;
+    }
+    num_keys++;
+    return 1;
 }
 
 int main(int argc, char **argv) {
     const char *input = NULL;
+    size_t budget = SORT_DEFAULT_BUDGET;
 
     for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-r") == 0) {
-            reverse_sort = 1;
-        } else if (strcmp(argv[i], "-n") == 0) {
-            numeric_sort = 1;
-        } else if (argv[i][0] != '-') {
-            input = argv[i];
+        const char *a = argv[i];
+        const char *value = NULL;
+
+        if (strcmp(a, "--reverse") == 0) {
+            global_flags |= KEY_REVERSE;
+        } else if (strcmp(a, "--numeric") == 0) {
+            global_flags |= KEY_NUMERIC;
+        } else if (strcmp(a, "--unique") == 0) {
+            unique_lines = 1;
+        } else if (strcmp(a, "--key") == 0 || strncmp(a, "-k", 2) == 0) {
+            value = a[1] == 'k' && a[2] ? a + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            if (!value || !add_key(value)) return 1;
+        } else if (strcmp(a, "--fieldSeparator") == 0 || strncmp(a, "-t", 2) == 0) {
+            value = a[1] == 't' && a[2] ? a + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            if (!value || strlen(value) != 1) {
+                fprintf(stderr, "sort: the field separator must be a single character\n");
+                return 1;
+            }
+            field_sep = (unsigned char)value[0];
+        } else if (strncmp(a, "-S", 2) == 0) {
+            value = a[2] ? a + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            budget = value ? parse_size(value) : 0;
+            if (!budget) {
+                fprintf(stderr, "sort: invalid buffer size\n");
+                return 1;
+            }
+            if (budget < SORT_MIN_BUDGET) budget = SORT_MIN_BUDGET;
+        } else if (a[0] == '-' && a[1] && a[1] != '-') {
+            for (const char *f = a + 1; *f; f++) {
+                switch (*f) {
+                    case 'r': global_flags |= KEY_REVERSE; break;
+                    case 'n': global_flags |= KEY_NUMERIC; break;
+                    case 'f': global_flags |= KEY_FOLD; break;
+                    case 'b': global_flags |= KEY_BLANKS | KEY_BLANKS_END; break;
+                    case 'u': unique_lines = 1; break;
+                    case 's': stable_sort = 1; break;
+                    default:
+                        fprintf(stderr, "sort: unknown option -%c\n", *f);
+                        fprintf(stderr, USAGE);
+                        return 1;
+                }
+            }
+        } else {
+            input = a;
         }
     }
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) { fprintf(stderr, "Usage: sort [-r] [-n] <text>\nOr pipe input via stdin.\n"); return 1; }
-        input = stdin_buf;
+    // Keys without options take the global ones; no keys = the whole line
+    if (num_keys == 0) {
+        keys[0].start_field = 1;
+        keys[0].flags = -1;
+        num_keys = 1;
+    }
+    for (int i = 0; i < num_keys; i++) {
+        if (keys[i].flags < 0) keys[i].flags = global_flags;
     }
 
-    // Split input into lines
-    char *input_copy = strdup(input);
-    char *line = strtok(input_copy, "\n");
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, USAGE);
+            line_reader_free(&reader);
+            return 1;
+        }
+    }
+
+    Batch batch = {0};
+    RunList runs = {0};
+    int can_spill = 1;
 
-    while (line && num_lines < MAX_LINES) {
-        lines[num_lines++] = line;
-        line = strtok(NULL, "\n");
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        if (!batch_add(&batch, line, len)) {
+            fprintf(stderr, "sort: out of memory\n");
+            return 1;
+        }
+        if (can_spill && batch.bytes >= budget) {
+            can_spill = spill_batch(&batch, &runs);
+        }
     }
+    line_reader_free(&reader);
 
-    // Sort
-    qsort(lines, num_lines, sizeof(char *), compare_strings);
+    if (runs.count > 0 && batch.nrecs > 0 && !spill_batch(&batch, &runs)) {
+        fprintf(stderr, "sort: cannot write temporary file\n");
+        return 1;
+    }
 
-    // Output
-    for (int i = 0; i < num_lines; i++) {
-        printf("%s\n", lines[i]);
+    if (runs.count > 0) {
+        if (!merge_all(&runs)) {
+            fprintf(stderr, "sort: cannot merge temporary files\n");
+            return 1;
+        }
+    } else {
+        if (!sort_records(batch.recs, batch.nrecs)) {
+            fprintf(stderr, "sort: out of memory\n");
+            return 1;
+        }
+        Sink sink = {0};
+        for (size_t i = 0; i < batch.nrecs; i++) sink_write(&sink, &batch.recs[i]);
+        free(sink.last_buf);
     }
 
-    free(input_copy);
-    free(stdin_buf);
+    batch_clear(&batch);
+    free(batch.recs);
+    out_flush();
     return 0;
 }
@@ -9,7 +9,7 @@
 #include <string.h>
 #include <time.h>
 
-void format_size(long long size, char *buf, size_t buf_len) {
+static void format_size(long long size, char *buf, size_t buf_len) {
     const char *units[] = {"B", "KB", "MB", "GB", "TB"};
     int unit_idx = 0;
     double display_size = (double)size;
@@ -26,7 +26,7 @@ void format_size(long long size, char *buf, size_t buf_len) {
     }
 }
 
-void format_time(long long timestamp, char *buf, size_t buf_len) {
+static void format_time(long long timestamp, char *buf, size_t buf_len) {
     time_t t = (time_t)timestamp;
     struct tm *tm_info = gmtime(&t);
 
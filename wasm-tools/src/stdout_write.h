@@ -0,0 +1,155 @@
+/**
+ * Buffered stdout writer for WASM tools.
+ *
+ * Every fd_write is a call out of the WASM sandbox into the host runtime,
+ * and stdio flushes stdout on every newline when it looks like a terminal
+ * (which it does under WASI). Tools that emit output byte by byte with
+ * putchar/printf therefore pay one host call per line or worse.
+ *
+ * This header collects output in one large static buffer and hands it to
+ * the host in OUT_BUF_SIZE blocks. It also provides table-driven hex and
+ * decimal formatting so hot loops never go through printf.
+ *
+ * A tool should write all of its stdout through these functions; mixing
+ * in printf/putchar would reorder output. The buffer is flushed when it
+ * fills, on out_flush(), and automatically at exit.
+ *
+ * Usage:
+ *   out_str("offset ");
+ *   out_hex(offset, 8);
+ *   out_char('\n');
+ *   ...
+ *   out_flush();
+ */
+
+#ifndef STDOUT_WRITE_H
+#define STDOUT_WRITE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_BUF_SIZE 65536
+
+/*
+ * The multi-call bundle (build.sh --multicall, built with -DMULTICALL)
+ * links every tool into one module but runs one tool per instance, so
+ * they share a single buffer, defined in multicall/main.c, rather than
+ * each carrying its own copy.
+ */
+#ifdef MULTICALL
+extern char out_buf[OUT_BUF_SIZE];
+extern size_t out_len;
+extern int out_atexit_registered;
+#else
+static char out_buf[OUT_BUF_SIZE];
+static size_t out_len = 0;
+static int out_atexit_registered = 0;
+#endif
+
+static const char out_hex_digits[] = "0123456789abcdef";
+
+static inline void out_write_fd(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Hand everything buffered so far to the host. */
+static inline void out_flush(void) {
+    fflush(stdout);
+    out_write_fd(out_buf, out_len);
+    out_len = 0;
+}
+
+/*
+ * Make room for n more bytes (n <= OUT_BUF_SIZE) and return a pointer to
+ * the free space. Callers that fill it must advance out_len themselves.
+ */
+static inline char *out_reserve(size_t n) {
+    if (!out_atexit_registered) {
+        atexit(out_flush);
+        out_atexit_registered = 1;
+    }
+    if (out_len + n > OUT_BUF_SIZE) out_flush();
+    return out_buf + out_len;
+}
+
+static inline void out_write(const void *data, size_t len) {
+    if (len >= OUT_BUF_SIZE) {
+        /* Large blocks skip the copy */
+        out_reserve(0);
+        out_flush();
+        out_write_fd((const char *)data, len);
+        return;
+    }
+    memcpy(out_reserve(len), data, len);
+    out_len += len;
+}
+
+static inline void out_char(char c) {
+    *out_reserve(1) = c;
+    out_len++;
+}
+
+static inline void out_str(const char *s) {
+    out_write(s, strlen(s));
+}
+
+/* Two lowercase hex digits, as printf("%02x"). */
+static inline void out_hex_byte(unsigned char b) {
+    char *p = out_reserve(2);
+    p[0] = out_hex_digits[b >> 4];
+    p[1] = out_hex_digits[b & 0x0f];
+    out_len += 2;
+}
+
+/* Lowercase hex, zero-padded to at least width digits, as printf("%0*llx"). */
+static inline void out_hex(unsigned long long v, int width) {
+    char tmp[16];
+    int n = 0;
+    do {
+        tmp[n++] = out_hex_digits[v & 0x0f];
+        v >>= 4;
+    } while (v);
+    while (n < width && n < (int)sizeof(tmp)) tmp[n++] = '0';
+
+    char *p = out_reserve((size_t)n);
+    for (int i = 0; i < n; i++) p[i] = tmp[n - 1 - i];
+    out_len += (size_t)n;
+}
+
+/* Unsigned decimal, right-aligned in width columns padded with pad. */
+static inline void out_uint_pad(unsigned long long v, int width, char pad) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    int padding = width > n ? width - n : 0;
+    char *p = out_reserve((size_t)(padding + n));
+    memset(p, pad, (size_t)padding);
+    for (int i = 0; i < n; i++) p[padding + i] = tmp[n - 1 - i];
+    out_len += (size_t)(padding + n);
+}
+
+static inline void out_uint(unsigned long long v) {
+    out_uint_pad(v, 0, ' ');
+}
+
+static inline void out_int(long long v) {
+    if (v < 0) {
+        out_char('-');
+        out_uint(0ULL - (unsigned long long)v);
+    } else {
+        out_uint((unsigned long long)v);
+    }
+}
+
+#endif /* STDOUT_WRITE_H */
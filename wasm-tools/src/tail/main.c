@@ -6,7 +6,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include "../line_reader.h"
+#include "../stdout_write.h"
 
 int main(int argc, char **argv) {
     int num_lines = 10;  // Default
@@ -20,39 +21,60 @@ int main(int argc, char **argv) {
         }
     }
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) { fprintf(stderr, "Usage: tail [-n NUM] <text>\nOr pipe input via stdin.\n"); return 1; }
-        input = stdin_buf;
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, "Usage: tail [-n NUM] <text>\nOr pipe input via stdin.\n");
+            line_reader_free(&reader);
+            return 1;
+        }
     }
 
-    // Count total lines
-    int total_lines = 0;
-    for (const char *p = input; *p; p++) {
-        if (*p == '\n') total_lines++;
+    if (num_lines < 0) num_lines = 0;
+
+    // Keep only the last num_lines lines in a ring, so memory is bounded
+    // by the window size rather than the input size
+    char **ring = (char **)calloc(num_lines > 0 ? num_lines : 1, sizeof(char *));
+    size_t *ring_cap = (size_t *)calloc(num_lines > 0 ? num_lines : 1, sizeof(size_t));
+    if (!ring || !ring_cap) {
+        fprintf(stderr, "Error: Out of memory\n");
+        free(ring);
+        free(ring_cap);
+        line_reader_free(&reader);
+        return 1;
     }
-    // Count last line if no trailing newline
-    size_t len = strlen(input);
-    if (len > 0 && input[len-1] != '\n') total_lines++;
-
-    // Find starting position
-    int skip_lines = total_lines - num_lines;
-    if (skip_lines < 0) skip_lines = 0;
-
-    int current_line = 0;
-    for (const char *p = input; *p; p++) {
-        if (current_line >= skip_lines) {
-            putchar(*p);
+
+    long total = 0;
+    char *line;
+    size_t len;
+    while (num_lines > 0 && line_reader_next(&reader, &line, &len)) {
+        int slot = (int)(total % num_lines);
+        if (ring_cap[slot] < len + 1) {
+            char *tmp = (char *)realloc(ring[slot], len + 1);
+            if (!tmp) {
+                fprintf(stderr, "Error: Out of memory\n");
+                break;
+            }
+            ring[slot] = tmp;
+            ring_cap[slot] = len + 1;
         }
-        if (*p == '\n') current_line++;
+        memcpy(ring[slot], line, len + 1);
+        total++;
     }
 
-    // Add newline if needed
-    if (len > 0 && input[len-1] != '\n') {
-        putchar('\n');
+    long count = total < num_lines ? total : num_lines;
+    for (long i = total - count; i < total; i++) {
+        out_str(ring[i % num_lines]);
+        out_char('\n');
     }
 
-    free(stdin_buf);
+    for (int i = 0; i < num_lines; i++) free(ring[i]);
+    free(ring);
+    free(ring_cap);
+    line_reader_free(&reader);
+    out_flush();
     return 0;
 }
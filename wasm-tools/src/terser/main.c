@@ -1,149 +1,3397 @@
 /**
  * terser - JavaScript minifier/compressor
- * Usage: terser <javascript-code>
+ * Usage: terser [-c|--compress] [-m|--mangle] [--input <code>] [<code>]
+ *
+ * Without options, removes comments and whitespace token by token (see
+ * minify.h): regex literals, template literals and line breaks that end
+ * statements are kept intact.
+ *
+ * With --compress and/or --mangle the code is parsed (ES2022 scripts and
+ * modules) and printed back from the tree:
+ * - Tokens come from the lexer.h tokenizer into one array; statements and
+ *   expressions are nodes in a bump arena that is freed in one go, so
+ *   memory grows with the input and nothing else.
+ * - Every program, function, block, catch clause and for-loop head gets a
+ *   scope. Declarations are entered as they are parsed (var and function
+ *   hoist to the enclosing function) and every identifier is resolved
+ *   once the program is read, through a single (scope, name) hash index.
+ * - --mangle renames the locals of each scope to the shortest free names,
+ *   most used first. A name is free in a scope unless something declared
+ *   further out and used inside it already has it, or it is a global, a
+ *   top-level name or a keyword. Scopes that use eval or with (and the
+ *   scopes around them) keep their names.
+ * - --compress folds constant expressions, drops code after return,
+ *   throw, break and continue (keeping hoisted functions and var names),
+ *   resolves constant if / ?: / && / || tests, turns if statements into
+ *   expressions, joins statements into sequences and var lists, drops
+ *   unused local function declarations and shortens literals
+ *   (true -> !0, undefined -> void 0, 1000 -> 1e3, a["b"] -> a.b).
+ * The printer emits only the parentheses, spaces and semicolons the
+ * grammar needs.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <math.h>
 #include "../stdin_read.h"
+#include "../line_index.h"
+#include "../minify.h"
 
-// Forward reference to minify_js from minify tool
-void minify_js(const char *js) {
-    int in_single_comment = 0;
-    int in_multi_comment = 0;
-    int in_string = 0;
-    int in_regex = 0;
-    char string_char = 0;
-    char prev_char = 0;
-    char prev_non_space = 0;
-    int space_needed = 0;
-
-    for (const char *p = js; *p; p++) {
-        // Single-line comment
-        if (!in_string && !in_multi_comment && !in_regex &&
-            *p == '/' && *(p + 1) == '/') {
-            in_single_comment = 1;
-            p++;
+/* ---- Arena ---- */
+
+#define ARENA_BLOCK (256 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+static void *arena_alloc(Arena *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    ArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = (ArenaBlock *)malloc(sizeof(ArenaBlock) + cap);
+        if (!b) return NULL;
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+static void arena_free(Arena *a) {
+    while (a->head) {
+        ArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* ---- Tree ---- */
+
+enum {
+    /* Statements */
+    N_PROGRAM, N_BLOCK, N_EMPTY, N_EXPR, N_VAR, N_DECL, N_RETURN, N_THROW, N_IF, N_FOR, N_FOR_IN,
+    N_FOR_OF, N_WHILE, N_DO, N_BREAK, N_CONTINUE, N_LABEL, N_SWITCH, N_CASE, N_TRY, N_DEBUGGER, N_WITH,
+    N_EXPORT, N_RAW,
+    /* Expressions (functions and classes are both) */
+    N_FUNC, N_CLASS, N_IDENT, N_LIT, N_TEMPLATE, N_TAGGED, N_ARRAY, N_OBJECT, N_PROP, N_HOLE, N_SPREAD,
+    N_UNARY, N_UPDATE, N_BINARY, N_ASSIGN, N_COND, N_CALL, N_NEW, N_MEMBER, N_SEQ, N_YIELD, N_AWAIT,
+    N_PAREN
+};
+
+/* N_LIT kinds */
+enum { L_NUM, L_STR, L_REGEX, L_TRUE, L_FALSE, L_NULL, L_WORD, L_NAME, L_CHUNK };
+
+/* N_VAR kinds */
+enum { V_VAR, V_LET, V_CONST };
+
+/* N_PROP kinds: object properties and class members */
+enum { P_INIT, P_SHORT, P_METHOD, P_GET, P_SET, P_FIELD, P_BLOCK };
+
+#define F_DECL      0x0001  /* Function or class declaration */
+#define F_ARROW     0x0002
+#define F_EXPR_BODY 0x0004  /* Arrow function with an expression body */
+#define F_ASYNC     0x0008
+#define F_GENERATOR 0x0010
+#define F_COMPUTED  0x0020  /* a[b], [key]: value */
+#define F_OPTIONAL  0x0040  /* a?.b, a?.(), a?.[b] */
+#define F_PREFIX    0x0080  /* ++a */
+#define F_DELEGATE  0x0100  /* yield* */
+#define F_STATIC    0x0200
+#define F_DIRECTIVE 0x0400  /* "use strict" and friends */
+#define F_AWAIT     0x0800  /* for await */
+#define F_DEFAULT   0x1000  /* export default */
+#define F_ARGS      0x2000  /* new X() rather than new X */
+
+typedef struct Scope Scope;
+typedef struct Symbol Symbol;
+typedef struct Node Node;
+
+/*
+ * One node shape for everything. Children by kind:
+ *   PROGRAM/BLOCK a=body         VAR a=declarators       DECL a=target b=init
+ *   FUNC a=name b=params c=body (an expression for F_EXPR_BODY)
+ *   CLASS a=name b=superclass c=members (PROP)
+ *   IF a=test b=then c=else      FOR a=init b=test c=update d=body
+ *   FOR_IN/FOR_OF a=left b=right d=body                  WHILE/DO a=test d=body
+ *   LABEL/BREAK/CONTINUE str=label, LABEL a=body          WITH a=object d=body
+ *   SWITCH a=discriminant b=cases   CASE a=test b=body    TRY a=block b=param c=handler d=finalizer
+ *   EXPORT a=declaration or expression                    RAW span=token range
+ *   PROP a=key b=value           TEMPLATE a=chunks and expressions   TAGGED a=tag b=template
+ *   UNARY/UPDATE/BINARY/ASSIGN str=operator, a (b)        COND a b c
+ *   CALL/NEW a=callee b=arguments   MEMBER a=object b=property   SEQ/ARRAY/OBJECT a=elements
+ * Lists are chained through next.
+ */
+struct Node {
+    uint8_t kind, op;
+    uint16_t flags;
+    uint32_t len;
+    const char *str;
+    Node *a, *b, *c, *d, *next;
+    union {
+        Symbol *sym;        /* IDENT */
+        Scope *scope;       /* PROGRAM, BLOCK, FUNC, FOR*, SWITCH */
+        uint32_t span[2];   /* RAW */
+    } u;
+};
+
+struct Symbol {
+    const char *name;
+    uint32_t len;
+    uint32_t refs;          /* Uses other than declarations */
+    uint32_t uses;          /* All occurrences */
+    int32_t slot;           /* Index of the mangled name, or -1 */
+    const char *mangled;
+    uint32_t mangled_len;
+    Scope *scope;
+    Symbol *next;           /* Next symbol of the same scope */
+};
+
+typedef struct OuterRef {
+    Symbol *sym;
+    struct OuterRef *next;
+} OuterRef;
+
+struct Scope {
+    Scope *parent, *children, *sibling;
+    Symbol *symbols;
+    OuterRef *outer;        /* Symbols of enclosing scopes used in this one or below */
+    uint8_t is_function;    /* var declarations land here */
+    uint8_t uses_eval;      /* eval or with in this scope: names must stay */
+    uint8_t keep_names;
+};
+
+/* ---- Name index ---- */
+
+/*
+ * Open-addressing index keyed by (owner, name). Declarations use their
+ * scope as the owner; names that mangled names must avoid use
+ * &reserved_owner.
+ */
+typedef struct {
+    const void *owner;
+    const char *name;
+    uint32_t len;
+    uint64_t hash;
+    void *value;
+} NameSlot;
+
+typedef struct {
+    NameSlot *slots;
+    size_t cap, count;
+} NameIndex;
+
+static const char reserved_owner = 0;
+
+static uint64_t name_hash(const void *owner, const char *name, size_t len) {
+    uint64_t h = line_hash(name, len) ^ ((uint64_t)(uintptr_t)owner * 0x9e3779b97f4a7c15ULL);
+    return h ^ (h >> 31);
+}
+
+static NameSlot *name_slot(NameIndex *ix, const void *owner, uint64_t h, const char *name, size_t len) {
+    size_t mask = ix->cap - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+        NameSlot *s = &ix->slots[i];
+        if (!s->value) return s;
+        if (s->hash == h && s->owner == owner && s->len == len && memcmp(s->name, name, len) == 0) return s;
+    }
+}
+
+static int name_index_grow(NameIndex *ix) {
+    size_t cap = ix->cap ? ix->cap * 2 : 1024;
+    NameSlot *slots = (NameSlot *)calloc(cap, sizeof(NameSlot));
+    if (!slots) return 0;
+    NameIndex grown = {slots, cap, ix->count};
+    for (size_t i = 0; i < ix->cap; i++) {
+        NameSlot *s = &ix->slots[i];
+        if (s->value) *name_slot(&grown, s->owner, s->hash, s->name, s->len) = *s;
+    }
+    free(ix->slots);
+    *ix = grown;
+    return 1;
+}
+
+static void *name_find(NameIndex *ix, const void *owner, const char *name, size_t len) {
+    if (ix->count == 0) return NULL;
+    return name_slot(ix, owner, name_hash(owner, name, len), name, len)->value;
+}
+
+/* Insert unless present; returns the slot, or NULL when memory runs out */
+static NameSlot *name_insert(NameIndex *ix, const void *owner, const char *name, size_t len) {
+    if ((ix->count + 1) * 4 > ix->cap * 3 && !name_index_grow(ix)) return NULL;
+    uint64_t h = name_hash(owner, name, len);
+    NameSlot *s = name_slot(ix, owner, h, name, len);
+    if (!s->value) {
+        s->owner = owner;
+        s->name = name;
+        s->len = (uint32_t)len;
+        s->hash = h;
+    }
+    return s;
+}
+
+/* ---- Tokens ---- */
+
+typedef struct {
+    uint32_t pos, len;
+    uint32_t match;         /* For '(': index of the matching ')' */
+    uint8_t type;
+    uint8_t nl_before;
+} Tok;
+
+/* ---- Parser ---- */
+
+#define MAX_NESTING 2048
+
+/* Where a binding is declared */
+enum { B_VAR, B_LEXICAL, B_PARAM, B_FUNCTION, B_OWN };
+
+typedef struct {
+    Node *ident;
+    Scope *scope;
+} Ref;
+
+typedef struct {
+    const char *src;
+    size_t n;
+    Tok *toks;
+    size_t ntok, pos;
+    const char *hashbang;
+    size_t hashbang_len;
+    Arena arena;
+    NameIndex names;
+    Ref *refs;
+    size_t nrefs, refs_cap;
+    Scope *program;
+    Scope *scope;           /* Innermost */
+    Scope *fscope;          /* Innermost function: where var goes */
+    int in_function, in_async, in_generator;
+    int no_in;              /* Parsing a for-loop head: 'in' is not an operator */
+    int depth;
+    char error[160];
+    size_t error_pos;
+} Parser;
+
+static int fail(Parser *p, const char *msg) {
+    if (!p->error[0]) {
+        snprintf(p->error, sizeof(p->error), "%s", msg);
+        p->error_pos = p->toks ? p->toks[p->pos].pos : 0;
+    }
+    return 0;
+}
+
+static Node *fail_node(Parser *p, const char *msg) {
+    fail(p, msg);
+    return NULL;
+}
+
+static int tokenize(Parser *p) {
+    JsLexer lx;
+    Token t;
+    size_t cap = 0;
+    uint32_t *opens = NULL;
+    size_t depth = 0, opens_cap = 0;
+    int nl = 0;
+    js_lexer_init(&lx, p->src, p->n);
+    for (;;) {
+        int more = js_next(&lx, &t);
+        nl |= t.nl_before;
+        if (more && t.type == JS_COMMENT) {
+            if (t.ptr[0] == '#') {
+                p->hashbang = t.ptr;
+                p->hashbang_len = t.len;
+            }
+            if (t.ptr[0] != '/' || t.ptr[1] == '/' || memchr(t.ptr, '\n', t.len) || memchr(t.ptr, '\r', t.len)) nl = 1;
+            continue;
+        }
+        if (p->ntok == cap) {
+            cap = cap ? cap * 2 : 4096;
+            Tok *tmp = (Tok *)realloc(p->toks, cap * sizeof(Tok));
+            if (!tmp) break;
+            p->toks = tmp;
+        }
+        Tok *k = &p->toks[p->ntok];
+        k->pos = (uint32_t)(t.ptr - p->src);
+        k->len = (uint32_t)t.len;
+        k->type = (uint8_t)(more ? t.type : JS_EOF);
+        k->nl_before = (uint8_t)nl;
+        k->match = 0;
+        nl = 0;
+        if (k->type == JS_PUNCT && t.len == 1 && t.ptr[0] == '(') {
+            if (depth == opens_cap) {
+                opens_cap = opens_cap ? opens_cap * 2 : 64;
+                uint32_t *tmp = (uint32_t *)realloc(opens, opens_cap * sizeof(uint32_t));
+                if (!tmp) break;
+                opens = tmp;
+            }
+            opens[depth++] = (uint32_t)p->ntok;
+        } else if (k->type == JS_PUNCT && t.len == 1 && t.ptr[0] == ')' && depth) {
+            p->toks[opens[--depth]].match = (uint32_t)p->ntok;
+        }
+        p->ntok++;
+        if (!more) break;
+    }
+    free(opens);
+    int error = lx.error || !p->ntok || p->toks[p->ntok - 1].type != JS_EOF;
+    js_lexer_free(&lx);
+    return error ? fail(p, "out of memory") : 1;
+}
+
+static Tok *tok(Parser *p) {
+    return &p->toks[p->pos];
+}
+
+static Tok *peek(Parser *p, size_t k) {
+    size_t i = p->pos + k;
+    return &p->toks[i < p->ntok ? i : p->ntok - 1];
+}
+
+static void advance(Parser *p) {
+    if (p->pos + 1 < p->ntok) p->pos++;
+}
+
+static const char *tok_text(const Parser *p, const Tok *t) {
+    return p->src + t->pos;
+}
+
+static int tok_is(const Parser *p, const Tok *t, const char *text) {
+    size_t len = strlen(text);
+    return (t->type == JS_PUNCT || t->type == JS_IDENT) && t->len == len && memcmp(p->src + t->pos, text, len) == 0;
+}
+
+static int at(Parser *p, const char *text) {
+    return tok_is(p, tok(p), text);
+}
+
+static int eat(Parser *p, const char *text) {
+    if (!at(p, text)) return 0;
+    advance(p);
+    return 1;
+}
+
+static int expect(Parser *p, const char *text) {
+    if (eat(p, text)) return 1;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "expected '%s'", text);
+    return fail(p, msg);
+}
+
+/* Words that can never name a variable */
+static const char *const js_reserved_words[] = {
+    "break", "case", "catch", "class", "const", "continue", "debugger", "default", "delete", "do", "else",
+    "enum", "export", "extends", "false", "finally", "for", "function", "if", "import", "in", "instanceof",
+    "new", "null", "return", "super", "switch", "this", "throw", "true", "try", "typeof", "var", "void",
+    "while", "with", NULL
+};
+
+static int tok_is_name(const Parser *p, const Tok *t) {
+    return t->type == JS_IDENT && tok_text(p, t)[0] != '#' && !js_word_in(tok_text(p, t), t->len, js_reserved_words);
+}
+
+static int consume_semicolon(Parser *p) {
+    if (eat(p, ";")) return 1;
+    if (at(p, "}") || tok(p)->type == JS_EOF || tok(p)->nl_before) return 1;
+    return fail(p, "expected ';'");
+}
+
+static Node *new_node(Parser *p, int kind) {
+    Node *n = (Node *)arena_alloc(&p->arena, sizeof(Node));
+    if (!n) return fail_node(p, "out of memory");
+    memset(n, 0, sizeof(*n));
+    n->kind = (uint8_t)kind;
+    return n;
+}
+
+/* A node holding the current token's text */
+static Node *tok_node(Parser *p, int kind, int op) {
+    Node *n = new_node(p, kind);
+    if (!n) return NULL;
+    n->op = (uint8_t)op;
+    n->str = tok_text(p, tok(p));
+    n->len = tok(p)->len;
+    advance(p);
+    return n;
+}
+
+static Node *word_node(Parser *p, int kind, int op, const char *text) {
+    Node *n = new_node(p, kind);
+    if (!n) return NULL;
+    n->op = (uint8_t)op;
+    n->str = text;
+    n->len = (uint32_t)strlen(text);
+    return n;
+}
+
+static Scope *push_scope(Parser *p, int is_function) {
+    Scope *s = (Scope *)arena_alloc(&p->arena, sizeof(Scope));
+    if (!s) {
+        fail(p, "out of memory");
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->is_function = (uint8_t)is_function;
+    s->parent = p->scope;
+    if (p->scope) {
+        s->sibling = p->scope->children;
+        p->scope->children = s;
+    }
+    p->scope = s;
+    if (is_function) p->fscope = s;
+    return s;
+}
+
+static int add_ref(Parser *p, Node *ident) {
+    if (p->nrefs == p->refs_cap) {
+        size_t cap = p->refs_cap ? p->refs_cap * 2 : 1024;
+        Ref *tmp = (Ref *)realloc(p->refs, cap * sizeof(Ref));
+        if (!tmp) return fail(p, "out of memory");
+        p->refs = tmp;
+        p->refs_cap = cap;
+    }
+    p->refs[p->nrefs].ident = ident;
+    p->refs[p->nrefs].scope = p->scope;
+    p->nrefs++;
+    return 1;
+}
+
+static Symbol *declare(Parser *p, Scope *s, const char *name, size_t len) {
+    NameSlot *slot = name_insert(&p->names, s, name, len);
+    if (!slot) return (Symbol *)fail_node(p, "out of memory");
+    if (slot->value) return (Symbol *)slot->value;
+    Symbol *sym = (Symbol *)arena_alloc(&p->arena, sizeof(Symbol));
+    if (!sym) return (Symbol *)fail_node(p, "out of memory");
+    memset(sym, 0, sizeof(*sym));
+    sym->name = name;
+    sym->len = (uint32_t)len;
+    sym->slot = -1;
+    sym->scope = s;
+    sym->next = s->symbols;
+    s->symbols = sym;
+    slot->value = sym;
+    p->names.count++;
+    return sym;
+}
+
+/* An identifier being read or written */
+static Node *ref_ident(Parser *p) {
+    Tok *t = tok(p);
+    if (!tok_is_name(p, t)) return fail_node(p, "expected an identifier");
+    if (t->len == 4 && memcmp(tok_text(p, t), "eval", 4) == 0) p->scope->uses_eval = 1;
+    Node *n = tok_node(p, N_IDENT, 0);
+    if (!n || !add_ref(p, n)) return NULL;
+    return n;
+}
+
+/* An identifier being declared */
+static Node *bind_ident(Parser *p, int kind) {
+    if (!tok_is_name(p, tok(p))) return fail_node(p, "expected an identifier");
+    Node *n = tok_node(p, N_IDENT, 0);
+    if (!n) return NULL;
+    Scope *s = kind == B_VAR || kind == B_FUNCTION ? p->fscope : p->scope;
+    n->u.sym = declare(p, s, n->str, n->len);
+    if (!n->u.sym || !add_ref(p, n)) return NULL;
+    return n;
+}
+
+static Node *parse_statement(Parser *p);
+static Node *parse_expression(Parser *p);
+static Node *parse_assign(Parser *p);
+static Node *parse_unary(Parser *p);
+static Node *parse_lhs(Parser *p);
+static Node *parse_binding(Parser *p, int kind);
+static Node *parse_function(Parser *p, int flags);
+static Node *parse_class(Parser *p, int decl);
+static Node *parse_function_rest(Parser *p, Node *fn);
+
+/* Statements up to '}' (or the end of input for a program) */
+static Node *parse_statements(Parser *p, int directives) {
+    Node *head = NULL, **tail = &head;
+    while (!at(p, "}") && tok(p)->type != JS_EOF) {
+        Node *s = parse_statement(p);
+        if (!s) return NULL;
+        if (directives) {
+            if (s->kind == N_EXPR && s->a->kind == N_LIT && s->a->op == L_STR) s->flags |= F_DIRECTIVE;
+            else directives = 0;
+        }
+        *tail = s;
+        tail = &s->next;
+    }
+    if (!head && p->error[0]) return NULL;
+    return head;
+}
+
+/* A { ... } block with its own scope; the caller may pass one in (catch) */
+static Node *parse_block(Parser *p, Scope *scope) {
+    Scope *saved = p->scope;
+    Node *n = new_node(p, N_BLOCK);
+    if (!n || !expect(p, "{")) return NULL;
+    if (scope) p->scope = scope;
+    else if (!push_scope(p, 0)) return NULL;
+    n->u.scope = p->scope;
+    n->a = parse_statements(p, 0);
+    p->scope = saved;
+    if (p->error[0] || !expect(p, "}")) return NULL;
+    return n;
+}
+
+static Node *parse_var(Parser *p, int kind) {
+    Node *n = new_node(p, N_VAR);
+    if (!n) return NULL;
+    n->op = (uint8_t)kind;
+    advance(p);
+    Node **tail = &n->a;
+    do {
+        Node *d = new_node(p, N_DECL);
+        if (!d) return NULL;
+        d->a = parse_binding(p, kind == V_VAR ? B_VAR : B_LEXICAL);
+        if (!d->a) return NULL;
+        if (eat(p, "=") && !(d->b = parse_assign(p))) return NULL;
+        *tail = d;
+        tail = &d->next;
+    } while (eat(p, ","));
+    return n;
+}
+
+/* The default of a binding element: target = value */
+static Node *parse_binding_default(Parser *p, Node *target) {
+    if (!at(p, "=")) return target;
+    Node *n = tok_node(p, N_ASSIGN, 0);
+    if (!n) return NULL;
+    n->a = target;
+    int saved = p->no_in;
+    p->no_in = 0;
+    n->b = parse_assign(p);
+    p->no_in = saved;
+    return n->b ? n : NULL;
+}
+
+static Node *parse_property_key(Parser *p, Node *prop) {
+    Tok *t = tok(p);
+    if (eat(p, "[")) {
+        prop->flags |= F_COMPUTED;
+        int saved = p->no_in;
+        p->no_in = 0;
+        prop->a = parse_assign(p);
+        p->no_in = saved;
+        if (!prop->a || !expect(p, "]")) return NULL;
+        return prop->a;
+    }
+    switch (t->type) {
+        case JS_IDENT:
+            prop->a = tok_node(p, N_LIT, tok_text(p, t)[0] == '#' ? L_WORD : L_NAME);
+            break;
+        case JS_STRING:
+            prop->a = tok_node(p, N_LIT, L_STR);
+            break;
+        case JS_NUMBER:
+            prop->a = tok_node(p, N_LIT, L_NUM);
+            break;
+        default:
+            return fail_node(p, "expected a property name");
+    }
+    return prop->a;
+}
+
+/* A binding pattern: name, [a, b = 1, ...c] or {a, b: c, ...d} */
+static Node *parse_binding(Parser *p, int kind) {
+    if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+    Node *n;
+    if (at(p, "[")) {
+        n = tok_node(p, N_ARRAY, 0);
+        if (!n) return NULL;
+        Node **tail = &n->a;
+        while (!at(p, "]")) {
+            Node *e;
+            if (at(p, ",")) {
+                e = new_node(p, N_HOLE);
+            } else if (at(p, "...")) {
+                e = tok_node(p, N_SPREAD, 0);
+                if (e && !(e->a = parse_binding(p, kind))) return NULL;
+            } else {
+                e = parse_binding(p, kind);
+                if (e) e = parse_binding_default(p, e);
+            }
+            if (!e) return NULL;
+            *tail = e;
+            tail = &e->next;
+            if (!at(p, "]") && !expect(p, ",")) return NULL;
+        }
+        advance(p);
+    } else if (at(p, "{")) {
+        n = tok_node(p, N_OBJECT, 0);
+        if (!n) return NULL;
+        Node **tail = &n->a;
+        while (!at(p, "}")) {
+            Node *e;
+            if (at(p, "...")) {
+                e = tok_node(p, N_SPREAD, 0);
+                if (e && !(e->a = bind_ident(p, kind))) return NULL;
+            } else {
+                e = new_node(p, N_PROP);
+                if (!e) return NULL;
+                Tok *key = tok(p);
+                if (!parse_property_key(p, e)) return NULL;
+                if (eat(p, ":")) {
+                    e->op = P_INIT;
+                    e->b = parse_binding(p, kind);
+                } else {
+                    if (e->flags & F_COMPUTED || !tok_is_name(p, key)) return fail_node(p, "expected ':'");
+                    e->op = P_SHORT;
+                    p->pos--;
+                    e->b = bind_ident(p, kind);
+                }
+                if (!e->b || !(e->b = parse_binding_default(p, e->b))) return NULL;
+            }
+            if (!e) return NULL;
+            *tail = e;
+            tail = &e->next;
+            if (!at(p, "}") && !expect(p, ",")) return NULL;
+        }
+        advance(p);
+    } else {
+        n = bind_ident(p, kind);
+    }
+    p->depth--;
+    return n;
+}
+
+/* (a, b = 1, ...c) */
+static Node *parse_params(Parser *p, Node *fn) {
+    if (!expect(p, "(")) return NULL;
+    Node **tail = &fn->b;
+    while (!at(p, ")")) {
+        Node *e;
+        if (at(p, "...")) {
+            e = tok_node(p, N_SPREAD, 0);
+            if (e && !(e->a = parse_binding(p, B_PARAM))) return NULL;
+        } else {
+            e = parse_binding(p, B_PARAM);
+            if (e) e = parse_binding_default(p, e);
+        }
+        if (!e) return NULL;
+        *tail = e;
+        tail = &e->next;
+        if (!at(p, ")") && !expect(p, ",")) return NULL;
+    }
+    advance(p);
+    return fn;
+}
+
+/* Parameters and body of fn, in a new function scope */
+static Node *parse_function_rest(Parser *p, Node *fn) {
+    Scope *scope = p->scope, *fscope = p->fscope;
+    int in_function = p->in_function, in_async = p->in_async, in_generator = p->in_generator, no_in = p->no_in;
+    if (!(fn->u.scope = push_scope(p, 1))) return NULL;
+    p->in_function = 1;
+    p->in_async = (fn->flags & F_ASYNC) != 0;
+    p->in_generator = (fn->flags & F_GENERATOR) != 0;
+    p->no_in = 0;
+    if (!parse_params(p, fn) || !expect(p, "{")) return NULL;
+    fn->c = parse_statements(p, 1);
+    if (p->error[0] || !expect(p, "}")) return NULL;
+    p->scope = scope;
+    p->fscope = fscope;
+    p->in_function = in_function;
+    p->in_async = in_async;
+    p->in_generator = in_generator;
+    p->no_in = no_in;
+    return fn;
+}
+
+/* function [*] [name] (...) { ... }, after any 'async' */
+static Node *parse_function(Parser *p, int flags) {
+    Node *fn = new_node(p, N_FUNC);
+    if (!fn || !expect(p, "function")) return NULL;
+    fn->flags = (uint16_t)flags;
+    if (eat(p, "*")) fn->flags |= F_GENERATOR;
+    Scope *scope = p->scope;
+    if (tok(p)->type == JS_IDENT && !at(p, "(")) {
+        if (flags & F_DECL) {
+            // Hoisted to the enclosing function, also from inside a block
+            fn->a = bind_ident(p, B_FUNCTION);
+        } else {
+            if (!push_scope(p, 0)) return NULL;
+            fn->a = bind_ident(p, B_OWN);
+        }
+        if (!fn->a) return NULL;
+    } else if ((flags & F_DECL) && !(flags & F_DEFAULT)) {
+        return fail_node(p, "expected a function name");
+    }
+    if (!parse_function_rest(p, fn)) return NULL;
+    p->scope = scope;
+    return fn;
+}
+
+/* Arrow function from its first token ('async', a name or '(') */
+static Node *parse_arrow(Parser *p, int is_async) {
+    Node *fn = new_node(p, N_FUNC);
+    if (!fn) return NULL;
+    fn->flags = F_ARROW | (is_async ? F_ASYNC : 0);
+    if (is_async) advance(p);
+    Scope *scope = p->scope, *fscope = p->fscope;
+    int in_function = p->in_function, in_async = p->in_async, in_generator = p->in_generator, no_in = p->no_in;
+    if (!(fn->u.scope = push_scope(p, 1))) return NULL;
+    p->in_function = 1;
+    p->in_async = is_async;
+    p->in_generator = 0;
+    if (at(p, "(")) {
+        p->no_in = 0;
+        if (!parse_params(p, fn)) return NULL;
+    } else if (!(fn->b = bind_ident(p, B_PARAM))) {
+        return NULL;
+    }
+    if (!expect(p, "=>")) return NULL;
+    if (at(p, "{")) {
+        advance(p);
+        p->no_in = 0;
+        fn->c = parse_statements(p, 1);
+        if (p->error[0] || !expect(p, "}")) return NULL;
+    } else {
+        fn->flags |= F_EXPR_BODY;
+        p->no_in = no_in;
+        if (!(fn->c = parse_assign(p))) return NULL;
+    }
+    p->scope = scope;
+    p->fscope = fscope;
+    p->in_function = in_function;
+    p->in_async = in_async;
+    p->in_generator = in_generator;
+    p->no_in = no_in;
+    return fn;
+}
+
+/* A method's modifiers: get / set / async / *; returns 0 on error */
+static int parse_method_modifiers(Parser *p, Node *prop) {
+    Tok *next = peek(p, 1);
+    int plain_next = tok_is(p, next, "(") || tok_is(p, next, ",") || tok_is(p, next, ":") || tok_is(p, next, "}") ||
+                     tok_is(p, next, "=") || tok_is(p, next, ";") || next->type == JS_EOF;
+    if ((at(p, "get") || at(p, "set")) && !plain_next) {
+        prop->op = at(p, "get") ? P_GET : P_SET;
+        advance(p);
+    } else if (at(p, "async") && !plain_next && !next->nl_before) {
+        prop->op = P_METHOD;
+        prop->flags |= F_ASYNC;
+        advance(p);
+    }
+    if (eat(p, "*")) {
+        prop->op = P_METHOD;
+        prop->flags |= F_GENERATOR;
+    }
+    return 1;
+}
+
+static Node *parse_method(Parser *p, Node *prop) {
+    Node *fn = new_node(p, N_FUNC);
+    if (!fn) return NULL;
+    fn->flags = prop->flags & (F_ASYNC | F_GENERATOR);
+    if (prop->op != P_GET && prop->op != P_SET) prop->op = P_METHOD;
+    prop->b = parse_function_rest(p, fn);
+    return prop->b;
+}
+
+static Node *parse_object(Parser *p) {
+    Node *n = tok_node(p, N_OBJECT, 0);
+    if (!n) return NULL;
+    int saved = p->no_in;
+    p->no_in = 0;
+    Node **tail = &n->a;
+    while (!at(p, "}")) {
+        Node *e;
+        if (at(p, "...")) {
+            e = tok_node(p, N_SPREAD, 0);
+            if (e && !(e->a = parse_assign(p))) return NULL;
+        } else {
+            e = new_node(p, N_PROP);
+            if (!e || !parse_method_modifiers(p, e)) return NULL;
+            Tok *key = tok(p);
+            if (!parse_property_key(p, e)) return NULL;
+            if (at(p, "(")) {
+                if (!parse_method(p, e)) return NULL;
+            } else if (e->op != P_INIT || e->flags & (F_ASYNC | F_GENERATOR)) {
+                return fail_node(p, "expected '('");
+            } else if (eat(p, ":")) {
+                if (!(e->b = parse_assign(p))) return NULL;
+            } else {
+                // Shorthand, or a default in an assignment pattern: ({a = 1} = b)
+                if (e->flags & F_COMPUTED || !tok_is_name(p, key)) return fail_node(p, "expected ':'");
+                e->op = P_SHORT;
+                p->pos--;
+                if (!(e->b = ref_ident(p)) || !(e->b = parse_binding_default(p, e->b))) return NULL;
+            }
+        }
+        if (!e) return NULL;
+        *tail = e;
+        tail = &e->next;
+        if (!at(p, "}") && !expect(p, ",")) return NULL;
+    }
+    advance(p);
+    p->no_in = saved;
+    return n;
+}
+
+static Node *parse_array(Parser *p) {
+    Node *n = tok_node(p, N_ARRAY, 0);
+    if (!n) return NULL;
+    int saved = p->no_in;
+    p->no_in = 0;
+    Node **tail = &n->a;
+    while (!at(p, "]")) {
+        Node *e;
+        if (at(p, ",")) {
+            e = new_node(p, N_HOLE);
+        } else if (at(p, "...")) {
+            e = tok_node(p, N_SPREAD, 0);
+            if (e && !(e->a = parse_assign(p))) return NULL;
+        } else {
+            e = parse_assign(p);
+        }
+        if (!e) return NULL;
+        *tail = e;
+        tail = &e->next;
+        if (!at(p, "]") && !expect(p, ",")) return NULL;
+    }
+    advance(p);
+    p->no_in = saved;
+    return n;
+}
+
+static Node *parse_class(Parser *p, int decl) {
+    Node *n = new_node(p, N_CLASS);
+    if (!n || !expect(p, "class")) return NULL;
+    if (decl) n->flags |= F_DECL;
+    Scope *scope = p->scope;
+    if (tok(p)->type == JS_IDENT && !at(p, "extends") && !at(p, "{")) {
+        if (!decl && !push_scope(p, 0)) return NULL;
+        if (!(n->a = bind_ident(p, decl ? B_LEXICAL : B_OWN))) return NULL;
+    }
+    if (eat(p, "extends") && !(n->b = parse_lhs(p))) return NULL;
+    if (!expect(p, "{")) return NULL;
+    int saved = p->no_in;
+    p->no_in = 0;
+    Node **tail = &n->c;
+    while (!at(p, "}")) {
+        if (eat(p, ";")) continue;
+        Node *m = new_node(p, N_PROP);
+        if (!m) return NULL;
+        Tok *next = peek(p, 1);
+        if (at(p, "static") && !tok_is(p, next, "(") && !tok_is(p, next, "=") && !tok_is(p, next, ";") &&
+            !tok_is(p, next, "}")) {
+            advance(p);
+            m->flags |= F_STATIC;
+            if (at(p, "{")) {
+                // static { ... }: a block with its own var scope
+                Scope *outer = p->scope, *fscope = p->fscope;
+                Node *block = new_node(p, N_BLOCK);
+                if (!block) return NULL;
+                advance(p);
+                if (!(block->u.scope = push_scope(p, 1))) return NULL;
+                block->a = parse_statements(p, 0);
+                p->scope = outer;
+                p->fscope = fscope;
+                if (p->error[0] || !expect(p, "}")) return NULL;
+                m->op = P_BLOCK;
+                m->b = block;
+                *tail = m;
+                tail = &m->next;
+                continue;
+            }
+        }
+        if (!parse_method_modifiers(p, m) || !parse_property_key(p, m)) return NULL;
+        if (at(p, "(")) {
+            if (!parse_method(p, m)) return NULL;
+        } else {
+            if (m->op != P_INIT || m->flags & (F_ASYNC | F_GENERATOR)) return fail_node(p, "expected '('");
+            m->op = P_FIELD;
+            if (eat(p, "=") && !(m->b = parse_assign(p))) return NULL;
+            if (!consume_semicolon(p)) return NULL;
+        }
+        *tail = m;
+        tail = &m->next;
+    }
+    advance(p);
+    p->no_in = saved;
+    p->scope = scope;
+    return n;
+}
+
+/* `...` or `...${ expr }...` */
+static Node *parse_template(Parser *p) {
+    Node *n = new_node(p, N_TEMPLATE);
+    if (!n) return NULL;
+    int type = tok(p)->type;
+    Node **tail = &n->a;
+    Node *chunk = tok_node(p, N_LIT, L_CHUNK);
+    if (!chunk) return NULL;
+    *tail = chunk;
+    tail = &chunk->next;
+    if (type == JS_TEMPLATE) return n;
+    int saved = p->no_in;
+    p->no_in = 0;
+    for (;;) {
+        Node *e = parse_expression(p);
+        if (!e) return NULL;
+        *tail = e;
+        tail = &e->next;
+        type = tok(p)->type;
+        if (type != JS_TEMPLATE_MIDDLE && type != JS_TEMPLATE_TAIL) return fail_node(p, "unterminated template");
+        if (!(chunk = tok_node(p, N_LIT, L_CHUNK))) return NULL;
+        *tail = chunk;
+        tail = &chunk->next;
+        if (type == JS_TEMPLATE_TAIL) break;
+    }
+    p->no_in = saved;
+    return n;
+}
+
+static int is_template_start(const Tok *t) {
+    return t->type == JS_TEMPLATE || t->type == JS_TEMPLATE_HEAD;
+}
+
+/* Does a member / call chain contain ?. (so that parentheses around it matter)? */
+static int has_optional(const Node *n) {
+    while (n && (n->kind == N_MEMBER || n->kind == N_CALL)) {
+        if (n->flags & F_OPTIONAL) return 1;
+        n = n->a;
+    }
+    return 0;
+}
+
+static Node *parse_primary(Parser *p) {
+    Tok *t = tok(p);
+    switch (t->type) {
+        case JS_NUMBER:
+            return tok_node(p, N_LIT, L_NUM);
+        case JS_STRING:
+            return tok_node(p, N_LIT, L_STR);
+        case JS_REGEX:
+            return tok_node(p, N_LIT, L_REGEX);
+        case JS_TEMPLATE:
+        case JS_TEMPLATE_HEAD:
+            return parse_template(p);
+        case JS_IDENT:
+            break;
+        default:
+            if (at(p, "(")) {
+                advance(p);
+                int saved = p->no_in;
+                p->no_in = 0;
+                Node *e = parse_expression(p);
+                p->no_in = saved;
+                if (!e || !expect(p, ")")) return NULL;
+                if (has_optional(e)) {
+                    Node *paren = new_node(p, N_PAREN);
+                    if (!paren) return NULL;
+                    paren->a = e;
+                    return paren;
+                }
+                return e;
+            }
+            if (at(p, "[")) return parse_array(p);
+            if (at(p, "{")) return parse_object(p);
+            return fail_node(p, t->type == JS_EOF ? "unexpected end of input" : "unexpected token");
+    }
+    if (at(p, "function")) return parse_function(p, 0);
+    if (at(p, "async") && tok_is(p, peek(p, 1), "function") && !peek(p, 1)->nl_before) {
+        advance(p);
+        return parse_function(p, F_ASYNC);
+    }
+    if (at(p, "class")) return parse_class(p, 0);
+    if (at(p, "this") || at(p, "super")) return tok_node(p, N_LIT, L_WORD);
+    if (at(p, "null")) return tok_node(p, N_LIT, L_NULL);
+    if (at(p, "true")) return tok_node(p, N_LIT, L_TRUE);
+    if (at(p, "false")) return tok_node(p, N_LIT, L_FALSE);
+    if (at(p, "import")) {
+        if (tok_is(p, peek(p, 1), ".")) {
+            advance(p);
+            advance(p);
+            if (!expect(p, "meta")) return NULL;
+            return word_node(p, N_LIT, L_WORD, "import.meta");
+        }
+        return tok_node(p, N_LIT, L_WORD);
+    }
+    if (tok_text(p, t)[0] == '#') return tok_node(p, N_LIT, L_WORD);
+    return ref_ident(p);
+}
+
+static Node *parse_arguments(Parser *p, Node *call) {
+    if (!expect(p, "(")) return NULL;
+    int saved = p->no_in;
+    p->no_in = 0;
+    Node **tail = &call->b;
+    while (!at(p, ")")) {
+        Node *e;
+        if (at(p, "...")) {
+            e = tok_node(p, N_SPREAD, 0);
+            if (e && !(e->a = parse_assign(p))) return NULL;
+        } else {
+            e = parse_assign(p);
+        }
+        if (!e) return NULL;
+        *tail = e;
+        tail = &e->next;
+        if (!at(p, ")") && !expect(p, ",")) return NULL;
+    }
+    advance(p);
+    p->no_in = saved;
+    return call;
+}
+
+/* .name, ?.name, [expr] and `template` after e; calls too when allowed */
+static Node *parse_suffixes(Parser *p, Node *e, int calls) {
+    for (;;) {
+        Node *n;
+        if (at(p, ".") || at(p, "?.")) {
+            int optional = at(p, "?.");
+            advance(p);
+            if (optional && calls && at(p, "(")) {
+                n = new_node(p, N_CALL);
+                if (!n) return NULL;
+                n->a = e;
+                n->flags |= F_OPTIONAL;
+                if (!parse_arguments(p, n)) return NULL;
+            } else if (optional && at(p, "[")) {
+                n = new_node(p, N_MEMBER);
+                if (!n) return NULL;
+                advance(p);
+                n->a = e;
+                n->flags |= F_OPTIONAL | F_COMPUTED;
+                int saved = p->no_in;
+                p->no_in = 0;
+                n->b = parse_expression(p);
+                p->no_in = saved;
+                if (!n->b || !expect(p, "]")) return NULL;
+            } else {
+                if (tok(p)->type != JS_IDENT) return fail_node(p, "expected a property name");
+                n = new_node(p, N_MEMBER);
+                if (!n) return NULL;
+                n->a = e;
+                n->flags |= optional ? F_OPTIONAL : 0;
+                n->b = tok_node(p, N_LIT, tok_text(p, tok(p))[0] == '#' ? L_WORD : L_NAME);
+                if (!n->b) return NULL;
+            }
+        } else if (at(p, "[")) {
+            n = new_node(p, N_MEMBER);
+            if (!n) return NULL;
+            advance(p);
+            n->a = e;
+            n->flags |= F_COMPUTED;
+            int saved = p->no_in;
+            p->no_in = 0;
+            n->b = parse_expression(p);
+            p->no_in = saved;
+            if (!n->b || !expect(p, "]")) return NULL;
+        } else if (calls && at(p, "(")) {
+            n = new_node(p, N_CALL);
+            if (!n) return NULL;
+            n->a = e;
+            if (!parse_arguments(p, n)) return NULL;
+        } else if (is_template_start(tok(p))) {
+            n = new_node(p, N_TAGGED);
+            if (!n) return NULL;
+            n->a = e;
+            if (!(n->b = parse_template(p))) return NULL;
+        } else {
+            return e;
+        }
+        if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+        e = n;
+    }
+}
+
+static Node *parse_new(Parser *p) {
+    advance(p);
+    if (at(p, ".")) {
+        advance(p);
+        if (!expect(p, "target")) return NULL;
+        return word_node(p, N_LIT, L_WORD, "new.target");
+    }
+    int depth = p->depth;
+    Node *n = new_node(p, N_NEW);
+    if (!n) return NULL;
+    n->a = at(p, "new") ? parse_new(p) : parse_primary(p);
+    if (!n->a || !(n->a = parse_suffixes(p, n->a, 0))) return NULL;
+    p->depth = depth;
+    if (at(p, "(")) {
+        n->flags |= F_ARGS;
+        if (!parse_arguments(p, n)) return NULL;
+    }
+    return n;
+}
+
+/* Member, call and new expressions */
+static Node *parse_lhs(Parser *p) {
+    int depth = p->depth;
+    Node *e = at(p, "new") ? parse_new(p) : parse_primary(p);
+    if (!e || !(e = parse_suffixes(p, e, 1))) return NULL;
+    p->depth = depth;
+    return e;
+}
+
+static Node *parse_postfix(Parser *p) {
+    Node *e = parse_lhs(p);
+    if (!e) return NULL;
+    if ((at(p, "++") || at(p, "--")) && !tok(p)->nl_before) {
+        Node *n = tok_node(p, N_UPDATE, 0);
+        if (!n) return NULL;
+        n->a = e;
+        return n;
+    }
+    return e;
+}
+
+static const char *const js_unary_ops[] = {"delete", "void", "typeof", "+", "-", "~", "!", NULL};
+
+/* Can an expression start with this token (for 'await' used as a name)? */
+static int starts_operand(const Parser *p, const Tok *t) {
+    if (t->type == JS_IDENT) return !js_word_in(tok_text(p, t), t->len, (const char *const[]){"in", "instanceof", "of", NULL});
+    if (t->type == JS_PUNCT) return tok_is(p, t, "(") || tok_is(p, t, "[") || tok_is(p, t, "{") || tok_is(p, t, "!") ||
+                                    tok_is(p, t, "~") || tok_is(p, t, "++") || tok_is(p, t, "--");
+    return t->type != JS_EOF && t->type != JS_TEMPLATE_MIDDLE && t->type != JS_TEMPLATE_TAIL;
+}
+
+static Node *parse_unary(Parser *p) {
+    Tok *t = tok(p);
+    if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+    Node *n = NULL;
+    if (js_word_in(tok_text(p, t), t->len, js_unary_ops) && (t->type == JS_PUNCT || t->type == JS_IDENT)) {
+        if (!(n = tok_node(p, N_UNARY, 0)) || !(n->a = parse_unary(p))) return NULL;
+    } else if (at(p, "++") || at(p, "--")) {
+        if (!(n = tok_node(p, N_UPDATE, 0)) || !(n->a = parse_unary(p))) return NULL;
+        n->flags |= F_PREFIX;
+    } else if (at(p, "await") && (p->in_async || (!p->in_function && starts_operand(p, peek(p, 1))))) {
+        if (!(n = tok_node(p, N_AWAIT, 0)) || !(n->a = parse_unary(p))) return NULL;
+    } else {
+        n = parse_postfix(p);
+    }
+    p->depth--;
+    return n;
+}
+
+static int binary_prec(const char *op, size_t len) {
+    static const struct { const char *op; int prec; } table[] = {
+        {"??", 4}, {"||", 4}, {"&&", 5}, {"|", 6}, {"^", 7}, {"&", 8},
+        {"==", 9}, {"!=", 9}, {"===", 9}, {"!==", 9},
+        {"<", 10}, {">", 10}, {"<=", 10}, {">=", 10}, {"instanceof", 10}, {"in", 10},
+        {"<<", 11}, {">>", 11}, {">>>", 11}, {"+", 12}, {"-", 12}, {"*", 13}, {"/", 13}, {"%", 13}, {"**", 14},
+    };
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (strlen(table[i].op) == len && memcmp(table[i].op, op, len) == 0) return table[i].prec;
+    }
+    return 0;
+}
+
+static Node *parse_binary(Parser *p, int min_prec) {
+    int depth = p->depth;
+    Node *left = parse_unary(p);
+    if (!left) return NULL;
+    for (;;) {
+        Tok *t = tok(p);
+        if (t->type != JS_PUNCT && t->type != JS_IDENT) break;
+        int prec = binary_prec(tok_text(p, t), t->len);
+        if (!prec || prec < min_prec || (p->no_in && at(p, "in"))) break;
+        Node *n = tok_node(p, N_BINARY, 0);
+        if (!n) return NULL;
+        n->a = left;
+        if (!(n->b = parse_binary(p, prec == 14 ? prec : prec + 1))) return NULL;
+        left = n;
+        if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+    }
+    p->depth = depth;
+    return left;
+}
+
+static Node *parse_conditional(Parser *p) {
+    Node *test = parse_binary(p, 1);
+    if (!test || !at(p, "?")) return test;
+    Node *n = new_node(p, N_COND);
+    if (!n) return NULL;
+    advance(p);
+    n->a = test;
+    int saved = p->no_in;
+    p->no_in = 0;
+    n->b = parse_assign(p);
+    p->no_in = saved;
+    if (!n->b || !expect(p, ":") || !(n->c = parse_assign(p))) return NULL;
+    return n;
+}
+
+static const char *const js_assign_ops[] = {
+    "=", "+=", "-=", "*=", "/=", "%=", "**=", "<<=", ">>=", ">>>=", "&=", "|=", "^=", "&&=", "||=", "?\?=", NULL
+};
+
+/* Does an arrow function start here? */
+static int arrow_ahead(Parser *p, int *is_async) {
+    Tok *t = tok(p), *next = peek(p, 1);
+    *is_async = 0;
+    if (tok_is(p, t, "(")) {
+        return t->match && t->match + 1 < p->ntok && tok_is(p, &p->toks[t->match + 1], "=>") &&
+               !p->toks[t->match + 1].nl_before;
+    }
+    if (!tok_is_name(p, t)) return 0;
+    if (tok_is(p, next, "=>") && !next->nl_before) return 1;
+    if (!tok_is(p, t, "async") || next->nl_before) return 0;
+    *is_async = 1;
+    if (tok_is_name(p, next)) return tok_is(p, peek(p, 2), "=>") && !peek(p, 2)->nl_before;
+    if (tok_is(p, next, "(") && next->match && next->match + 1 < p->ntok) {
+        return tok_is(p, &p->toks[next->match + 1], "=>") && !p->toks[next->match + 1].nl_before;
+    }
+    return 0;
+}
+
+static Node *parse_assign(Parser *p) {
+    if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+    Node *n;
+    int is_async;
+    if (at(p, "yield") && p->in_generator) {
+        n = tok_node(p, N_YIELD, 0);
+        if (!n) return NULL;
+        if (!tok(p)->nl_before && eat(p, "*")) n->flags |= F_DELEGATE;
+        Tok *t = tok(p);
+        if (n->flags & F_DELEGATE ||
+            (!t->nl_before && t->type != JS_EOF && !tok_is(p, t, ")") && !tok_is(p, t, "]") && !tok_is(p, t, "}") &&
+             !tok_is(p, t, ",") && !tok_is(p, t, ";") && !tok_is(p, t, ":") && !tok_is(p, t, "in") &&
+             t->type != JS_TEMPLATE_MIDDLE && t->type != JS_TEMPLATE_TAIL)) {
+            if (!(n->a = parse_assign(p))) return NULL;
+        }
+    } else if (arrow_ahead(p, &is_async)) {
+        n = parse_arrow(p, is_async);
+    } else {
+        n = parse_conditional(p);
+        Tok *t = tok(p);
+        if (n && t->type == JS_PUNCT && js_word_in(tok_text(p, t), t->len, js_assign_ops)) {
+            Node *a = tok_node(p, N_ASSIGN, 0);
+            if (!a) return NULL;
+            a->a = n;
+            if (!(a->b = parse_assign(p))) return NULL;
+            n = a;
+        }
+    }
+    p->depth--;
+    return n;
+}
+
+static Node *parse_expression(Parser *p) {
+    Node *e = parse_assign(p);
+    if (!e || !at(p, ",")) return e;
+    Node *seq = new_node(p, N_SEQ);
+    if (!seq) return NULL;
+    seq->a = e;
+    Node **tail = &e->next;
+    while (eat(p, ",")) {
+        Node *next = parse_assign(p);
+        if (!next) return NULL;
+        *tail = next;
+        tail = &next->next;
+    }
+    return seq;
+}
+
+/* ( expr ) */
+static Node *parse_paren_expression(Parser *p) {
+    if (!expect(p, "(")) return NULL;
+    Node *e = parse_expression(p);
+    if (!e || !expect(p, ")")) return NULL;
+    return e;
+}
+
+static Node *parse_for(Parser *p) {
+    Node *n = new_node(p, N_FOR);
+    if (!n) return NULL;
+    advance(p);
+    if (eat(p, "await")) n->flags |= F_AWAIT;
+    if (!expect(p, "(")) return NULL;
+    Scope *scope = p->scope;
+    if (!(n->u.scope = push_scope(p, 0))) return NULL;
+    Node *init = NULL;
+    p->no_in = 1;
+    if (at(p, "var") || at(p, "const") ||
+        (at(p, "let") && (tok_is_name(p, peek(p, 1)) || tok_is(p, peek(p, 1), "[") || tok_is(p, peek(p, 1), "{")))) {
+        init = parse_var(p, at(p, "var") ? V_VAR : at(p, "let") ? V_LET : V_CONST);
+    } else if (!at(p, ";")) {
+        init = parse_expression(p);
+    }
+    p->no_in = 0;
+    if (p->error[0]) return NULL;
+    if (init && (at(p, "in") || at(p, "of"))) {
+        n->kind = at(p, "in") ? N_FOR_IN : N_FOR_OF;
+        advance(p);
+        n->a = init;
+        if (!(n->b = n->kind == N_FOR_OF ? parse_assign(p) : parse_expression(p))) return NULL;
+    } else {
+        n->a = init;
+        if (!expect(p, ";")) return NULL;
+        if (!at(p, ";") && !(n->b = parse_expression(p))) return NULL;
+        if (!expect(p, ";")) return NULL;
+        if (!at(p, ")") && !(n->c = parse_expression(p))) return NULL;
+    }
+    if (!expect(p, ")") || !(n->d = parse_statement(p))) return NULL;
+    p->scope = scope;
+    return n;
+}
+
+/* Skip an import / export clause that only names top-level bindings */
+static Node *parse_raw_module_item(Parser *p, size_t start) {
+    // Up to the module specifier and any 'with { ... }' attributes, or a closing '}'
+    int depth = 0;
+    for (;;) {
+        Tok *t = tok(p);
+        if (t->type == JS_EOF) return fail_node(p, "unterminated import or export");
+        if (depth == 0 && t->type == JS_STRING && !tok_is(p, &p->toks[p->pos - 1], "as") &&
+            !tok_is(p, &p->toks[p->pos - 1], "{") && !tok_is(p, &p->toks[p->pos - 1], ",")) {
+            advance(p);
+            if ((at(p, "with") || at(p, "assert")) && !tok(p)->nl_before && tok_is(p, peek(p, 1), "{")) {
+                advance(p);
+                while (!at(p, "}") && tok(p)->type != JS_EOF) advance(p);
+                advance(p);
+            }
+            break;
+        }
+        if (at(p, "{")) depth++;
+        if (at(p, "}") && --depth == 0) {
+            advance(p);
+            if (!at(p, "from")) break;
+            continue;
+        }
+        if (depth == 0 && at(p, ";")) break;
+        advance(p);
+    }
+    Node *n = new_node(p, N_RAW);
+    if (!n || !consume_semicolon(p)) return NULL;
+    n->u.span[0] = (uint32_t)start;
+    n->u.span[1] = (uint32_t)p->pos;
+    while (n->u.span[1] > start && tok_is(p, &p->toks[n->u.span[1] - 1], ";")) n->u.span[1]--;
+    return n;
+}
+
+static Node *parse_export(Parser *p) {
+    size_t start = p->pos;
+    advance(p);
+    Node *n = new_node(p, N_EXPORT);
+    if (!n) return NULL;
+    if (eat(p, "default")) {
+        n->flags |= F_DEFAULT;
+        if (at(p, "function")) {
+            n->a = parse_function(p, F_DECL | F_DEFAULT);
+        } else if (at(p, "async") && tok_is(p, peek(p, 1), "function") && !peek(p, 1)->nl_before) {
+            advance(p);
+            n->a = parse_function(p, F_DECL | F_DEFAULT | F_ASYNC);
+        } else if (at(p, "class")) {
+            n->a = parse_class(p, 1);
+        } else {
+            n->a = parse_assign(p);
+            if (n->a && !consume_semicolon(p)) return NULL;
+        }
+    } else if (at(p, "var") || at(p, "let") || at(p, "const")) {
+        n->a = parse_var(p, at(p, "var") ? V_VAR : at(p, "let") ? V_LET : V_CONST);
+        if (n->a && !consume_semicolon(p)) return NULL;
+    } else if (at(p, "function")) {
+        n->a = parse_function(p, F_DECL);
+    } else if (at(p, "async")) {
+        advance(p);
+        n->a = parse_function(p, F_DECL | F_ASYNC);
+    } else if (at(p, "class")) {
+        n->a = parse_class(p, 1);
+    } else {
+        p->pos = start;
+        return parse_raw_module_item(p, start);
+    }
+    return n->a ? n : NULL;
+}
+
+static Node *parse_statement_inner(Parser *p) {
+    Tok *t = tok(p);
+    Node *n;
+    if (t->type == JS_PUNCT) {
+        if (at(p, "{")) return parse_block(p, NULL);
+        if (at(p, ";")) return tok_node(p, N_EMPTY, 0);
+    } else if (t->type == JS_IDENT) {
+        Tok *next = peek(p, 1);
+        if (at(p, "var") || at(p, "const")) {
+            n = parse_var(p, at(p, "var") ? V_VAR : V_CONST);
+            return n && consume_semicolon(p) ? n : NULL;
+        }
+        if (at(p, "let") && (tok_is_name(p, next) || tok_is(p, next, "[") || tok_is(p, next, "{"))) {
+            n = parse_var(p, V_LET);
+            return n && consume_semicolon(p) ? n : NULL;
+        }
+        if (at(p, "function")) return parse_function(p, F_DECL);
+        if (at(p, "async") && tok_is(p, next, "function") && !next->nl_before) {
+            advance(p);
+            return parse_function(p, F_DECL | F_ASYNC);
+        }
+        if (at(p, "class")) return parse_class(p, 1);
+        if (at(p, "if")) {
+            if (!(n = new_node(p, N_IF))) return NULL;
+            advance(p);
+            if (!(n->a = parse_paren_expression(p)) || !(n->b = parse_statement(p))) return NULL;
+            if (eat(p, "else") && !(n->c = parse_statement(p))) return NULL;
+            return n;
+        }
+        if (at(p, "for")) return parse_for(p);
+        if (at(p, "while") || at(p, "with")) {
+            if (!(n = new_node(p, at(p, "while") ? N_WHILE : N_WITH))) return NULL;
+            if (n->kind == N_WITH) p->scope->uses_eval = 1;
+            advance(p);
+            if (!(n->a = parse_paren_expression(p)) || !(n->d = parse_statement(p))) return NULL;
+            return n;
+        }
+        if (at(p, "do")) {
+            if (!(n = new_node(p, N_DO))) return NULL;
+            advance(p);
+            if (!(n->d = parse_statement(p)) || !expect(p, "while") || !(n->a = parse_paren_expression(p))) return NULL;
+            eat(p, ";");
+            return n;
+        }
+        if (at(p, "return") || at(p, "throw")) {
+            int is_throw = at(p, "throw");
+            if (!(n = new_node(p, is_throw ? N_THROW : N_RETURN))) return NULL;
+            advance(p);
+            Tok *a = tok(p);
+            if (is_throw || (!a->nl_before && !tok_is(p, a, ";") && !tok_is(p, a, "}") && a->type != JS_EOF)) {
+                if (!(n->a = parse_expression(p))) return NULL;
+            }
+            return consume_semicolon(p) ? n : NULL;
+        }
+        if (at(p, "break") || at(p, "continue")) {
+            if (!(n = new_node(p, at(p, "break") ? N_BREAK : N_CONTINUE))) return NULL;
+            advance(p);
+            if (tok_is_name(p, tok(p)) && !tok(p)->nl_before) {
+                n->str = tok_text(p, tok(p));
+                n->len = tok(p)->len;
+                advance(p);
+            }
+            return consume_semicolon(p) ? n : NULL;
+        }
+        if (at(p, "switch")) {
+            if (!(n = new_node(p, N_SWITCH))) return NULL;
+            advance(p);
+            if (!(n->a = parse_paren_expression(p)) || !expect(p, "{")) return NULL;
+            Scope *scope = p->scope;
+            if (!(n->u.scope = push_scope(p, 0))) return NULL;
+            Node **tail = &n->b;
+            while (!eat(p, "}")) {
+                Node *c = new_node(p, N_CASE);
+                if (!c) return NULL;
+                if (eat(p, "case")) {
+                    if (!(c->a = parse_expression(p))) return NULL;
+                } else if (!expect(p, "default")) {
+                    return NULL;
+                }
+                if (!expect(p, ":")) return NULL;
+                Node **body = &c->b;
+                while (!at(p, "case") && !at(p, "default") && !at(p, "}") && tok(p)->type != JS_EOF) {
+                    Node *s = parse_statement(p);
+                    if (!s) return NULL;
+                    *body = s;
+                    body = &s->next;
+                }
+                *tail = c;
+                tail = &c->next;
+            }
+            p->scope = scope;
+            return n;
+        }
+        if (at(p, "try")) {
+            if (!(n = new_node(p, N_TRY))) return NULL;
+            advance(p);
+            if (!(n->a = parse_block(p, NULL))) return NULL;
+            if (eat(p, "catch")) {
+                Scope *scope = p->scope;
+                Scope *catch_scope = push_scope(p, 0);
+                if (!catch_scope) return NULL;
+                if (eat(p, "(")) {
+                    if (!(n->b = parse_binding(p, B_LEXICAL)) || !expect(p, ")")) return NULL;
+                }
+                p->scope = scope;
+                if (!(n->c = parse_block(p, catch_scope))) return NULL;
+            }
+            if (eat(p, "finally") && !(n->d = parse_block(p, NULL))) return NULL;
+            if (!n->c && !n->d) return fail_node(p, "expected 'catch' or 'finally'");
+            return n;
+        }
+        if (at(p, "debugger")) {
+            if (!(n = tok_node(p, N_DEBUGGER, 0))) return NULL;
+            return consume_semicolon(p) ? n : NULL;
+        }
+        if (at(p, "import") && !tok_is(p, next, "(") && !tok_is(p, next, ".")) {
+            return parse_raw_module_item(p, p->pos);
+        }
+        if (at(p, "export")) return parse_export(p);
+        if (tok_is(p, next, ":") && tok_is_name(p, t)) {
+            if (!(n = new_node(p, N_LABEL))) return NULL;
+            n->str = tok_text(p, t);
+            n->len = t->len;
+            advance(p);
+            advance(p);
+            return (n->a = parse_statement(p)) ? n : NULL;
+        }
+    }
+    if (!(n = new_node(p, N_EXPR)) || !(n->a = parse_expression(p))) return NULL;
+    return consume_semicolon(p) ? n : NULL;
+}
+
+static Node *parse_statement(Parser *p) {
+    if (++p->depth > MAX_NESTING) return fail_node(p, "nesting too deep");
+    Node *n = parse_statement_inner(p);
+    p->depth--;
+    return n;
+}
+
+static Node *parse_program(Parser *p) {
+    Node *n = new_node(p, N_PROGRAM);
+    if (!n || !(p->program = push_scope(p, 1))) return NULL;
+    n->u.scope = p->program;
+    n->a = parse_statements(p, 1);
+    if (p->error[0]) return NULL;
+    if (tok(p)->type != JS_EOF) return fail_node(p, "unexpected '}'");
+    return n;
+}
+
+/* ---- Scope resolution ---- */
+
+/* Bind every identifier to its declaration; names left over are globals */
+static int resolve(Parser *p) {
+    for (size_t i = 0; i < p->nrefs; i++) {
+        Node *id = p->refs[i].ident;
+        Symbol *sym = id->u.sym;
+        if (!sym) {
+            for (Scope *s = p->refs[i].scope; s && !sym; s = s->parent) sym = (Symbol *)name_find(&p->names, s, id->str, id->len);
+            if (sym) {
+                id->u.sym = sym;
+                sym->refs++;
+            } else {
+                NameSlot *slot = name_insert(&p->names, &reserved_owner, id->str, id->len);
+                if (!slot) return fail(p, "out of memory");
+                if (!slot->value) {
+                    slot->value = (void *)&reserved_owner;
+                    p->names.count++;
+                }
+            }
+        }
+        if (sym) sym->uses++;
+    }
+    return 1;
+}
+
+/* ---- Compressor ---- */
+
+typedef struct {
+    Parser *p;
+} Compressor;
+
+static Node *cx(Compressor *c, Node *n);
+static Node *cs_stmt(Compressor *c, Node *n);
+static Node *cs_list(Compressor *c, Node *list, int fn_body);
+static void cs_function(Compressor *c, Node *fn);
+
+static int lit_is(const Node *n, int op) {
+    return n && n->kind == N_LIT && n->op == op;
+}
+
+static int node_text_is(const Node *n, const char *text) {
+    size_t len = strlen(text);
+    return n->len == len && memcmp(n->str, text, len) == 0;
+}
+
+/* Numeric value of a literal number (or -number) that folds exactly */
+static int number_value(const char *s, size_t len, double *v) {
+    if (len == 0 || memchr(s, '_', len) || s[len - 1] == 'n') return 0;
+    if (len > 1 && s[0] == '0' && isdigit((unsigned char)s[1])) return 0;   /* Legacy octal */
+    if (len > 2 && s[0] == '0' && strchr("xXoObB", s[1])) {
+        int base = (s[1] == 'x' || s[1] == 'X') ? 16 : (s[1] == 'o' || s[1] == 'O') ? 8 : 2;
+        double x = 0;
+        for (size_t i = 2; i < len; i++) {
+            int d = isdigit((unsigned char)s[i]) ? s[i] - '0' : tolower((unsigned char)s[i]) - 'a' + 10;
+            x = x * base + d;
+        }
+        *v = x;
+        return x < 9007199254740992.0;
+    }
+    char buf[64];
+    if (len >= sizeof(buf)) return 0;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    char *end;
+    *v = strtod(buf, &end);
+    return *end == '\0';
+}
+
+static int lit_number(const Node *n, double *v) {
+    if (n->kind == N_UNARY && node_text_is(n, "-") && lit_is(n->a, L_NUM) && number_value(n->a->str, n->a->len, v)) {
+        *v = -*v;
+        return 1;
+    }
+    return lit_is(n, L_NUM) && number_value(n->str, n->len, v);
+}
+
+/* Shortest text that reads back as v (v >= 0 and finite) */
+static size_t format_number(double v, char *buf) {
+    if (v == floor(v) && v < 1e21) {
+        size_t len = (size_t)snprintf(buf, 32, "%.0f", v);
+        size_t zeros = 0;
+        while (zeros + 1 < len && buf[len - 1 - zeros] == '0') zeros++;
+        if (zeros >= 3) len = len - zeros + (size_t)sprintf(buf + len - zeros, "e%zu", zeros);
+        return len;
+    }
+    for (int prec = 1; prec <= 17; prec++) {
+        snprintf(buf, 32, "%.*g", prec, v);
+        if (strtod(buf, NULL) == v) break;
+    }
+    // 0.5 -> .5, 1e-07 -> 1e-7, 1e+21 -> 1e21
+    char out[32];
+    size_t o = 0;
+    for (const char *s = buf; *s; s++) {
+        if (s == buf && s[0] == '0' && s[1] == '.') continue;
+        if (*s == 'e') {
+            out[o++] = 'e';
+            s++;
+            if (*s == '-') out[o++] = *s++;
+            else if (*s == '+') s++;
+            while (*s == '0' && s[1]) s++;
+            while (*s) out[o++] = *s++;
+            break;
+        }
+        out[o++] = *s;
+    }
+    memcpy(buf, out, o);
+    buf[o] = '\0';
+    return o;
+}
+
+static Node *make_node(Compressor *c, int kind) {
+    return new_node(c->p, kind);
+}
+
+static Node *make_text(Compressor *c, int kind, int op, const char *text, size_t len) {
+    Node *n = new_node(c->p, kind);
+    if (!n) return NULL;
+    n->op = (uint8_t)op;
+    n->str = text;
+    n->len = (uint32_t)len;
+    return n;
+}
+
+static Node *make_unary(Compressor *c, const char *op, Node *arg) {
+    Node *n = make_text(c, N_UNARY, 0, op, strlen(op));
+    if (n) n->a = arg;
+    return n;
+}
+
+static Node *make_number(Compressor *c, double v) {
+    if (!isfinite(v)) return NULL;
+    int negative = v < 0 || (v == 0 && signbit(v));
+    char buf[32];
+    size_t len = format_number(fabs(v), buf);
+    char *text = (char *)arena_alloc(&c->p->arena, len + 1);
+    if (!text) return NULL;
+    memcpy(text, buf, len + 1);
+    Node *n = make_text(c, N_LIT, L_NUM, text, len);
+    return n && negative ? make_unary(c, "-", n) : n;
+}
+
+static Node *make_bool(Compressor *c, int value) {
+    return make_text(c, N_LIT, value ? L_TRUE : L_FALSE, value ? "true" : "false", value ? 4 : 5);
+}
+
+static Node *make_void0(Compressor *c) {
+    Node *zero = make_text(c, N_LIT, L_NUM, "0", 1);
+    return zero ? make_unary(c, "void", zero) : NULL;
+}
+
+/* 1 truthy, 0 falsy, -1 unknown or with side effects */
+static int truthiness(const Node *n) {
+    double v;
+    if (lit_number(n, &v)) return v != 0 && !isnan(v);
+    if (n->kind == N_LIT) {
+        switch (n->op) {
+            case L_STR: return n->len > 2;
+            case L_TRUE: case L_REGEX: return 1;
+            case L_FALSE: case L_NULL: return 0;
+        }
+        return -1;
+    }
+    if (n->kind == N_UNARY && node_text_is(n, "void") && n->a->kind == N_LIT) return 0;
+    if (n->kind == N_UNARY && node_text_is(n, "!")) {
+        int t = truthiness(n->a);
+        return t < 0 ? -1 : !t;
+    }
+    if (n->kind == N_FUNC) return 1;
+    return -1;
+}
+
+/* Evaluating n has no effect (other than its value) */
+static int is_pure(const Node *n) {
+    if (n->kind == N_LIT) return n->op != L_WORD || !node_text_is(n, "super");
+    if (n->kind == N_FUNC) return 1;
+    if (n->kind == N_UNARY && !node_text_is(n, "delete")) return n->a->kind == N_LIT;
+    return 0;
+}
+
+static int is_void0(const Node *n) {
+    return n->kind == N_UNARY && node_text_is(n, "void") && lit_is(n->a, L_NUM);
+}
+
+static int is_undefined(const Node *n) {
+    return n->kind == N_IDENT && !n->u.sym && node_text_is(n, "undefined");
+}
+
+/* 's' string, 'n' number, 'b' boolean, 0 unknown */
+static int value_type(const Node *n) {
+    double v;
+    if (lit_is(n, L_STR) || n->kind == N_TEMPLATE) return 's';
+    if (n->kind == N_UNARY && node_text_is(n, "typeof")) return 's';
+    if (lit_number(n, &v)) return 'n';
+    if (lit_is(n, L_TRUE) || lit_is(n, L_FALSE) || (n->kind == N_UNARY && node_text_is(n, "!"))) return 'b';
+    return 0;
+}
+
+/* Is the string literal's content a plain identifier name? */
+static int string_is_name(const Node *n) {
+    if (n->len < 3) return 0;
+    for (size_t i = 1; i + 1 < n->len; i++) {
+        unsigned char ch = (unsigned char)n->str[i];
+        if (!(isalpha(ch) || ch == '_' || ch == '$' || (i > 1 && isdigit(ch)))) return 0;
+    }
+    return 1;
+}
+
+/* "a" + 'b' -> "ab", re-escaping b for a's quote */
+static Node *concat_strings(Compressor *c, const Node *a, const Node *b) {
+    char quote = a->str[0];
+    size_t cap = a->len + 2 * b->len;
+    char *s = (char *)arena_alloc(&c->p->arena, cap);
+    if (!s) return NULL;
+    size_t len = a->len - 1;
+    memcpy(s, a->str, len);
+    for (size_t i = 1; i + 1 < b->len; i++) {
+        char ch = b->str[i];
+        if (ch == '\\') {
+            s[len++] = ch;
+            s[len++] = b->str[++i];
+        } else {
+            if (ch == quote) s[len++] = '\\';
+            s[len++] = ch;
+        }
+    }
+    s[len++] = quote;
+    return make_text(c, N_LIT, L_STR, s, len);
+}
+
+static int32_t to_int32(double v) {
+    if (!isfinite(v)) return 0;
+    double m = fmod(trunc(v), 4294967296.0);
+    if (m < 0) m += 4294967296.0;
+    return (int32_t)(uint32_t)m;
+}
+
+static size_t printed_number_len(const Node *n) {
+    char buf[32];
+    double v;
+    if (!lit_number(n, &v)) return n->len;
+    return format_number(fabs(v), buf) + (v < 0);
+}
+
+static Node *fold_binary(Compressor *c, Node *n) {
+    Node *a = n->a, *b = n->b;
+    double x, y;
+    if (node_text_is(n, "&&") || node_text_is(n, "||") || node_text_is(n, "??")) {
+        int t = truthiness(a);
+        if (t < 0 || !is_pure(a)) return n;
+        if (node_text_is(n, "??")) return lit_is(a, L_NULL) || is_void0(a) ? b : a;
+        return (t == 1) == node_text_is(n, "&&") ? b : a;
+    }
+    if (node_text_is(n, "+") && lit_is(a, L_STR) && lit_is(b, L_STR)) {
+        Node *s = concat_strings(c, a, b);
+        return s ? s : n;
+    }
+    if ((node_text_is(n, "===") || node_text_is(n, "!==")) && value_type(a) && value_type(a) == value_type(b)) {
+        n->len--;
+        return n;
+    }
+    if (!lit_number(a, &x) || !lit_number(b, &y)) return n;
+    double r;
+    int boolean = -1;
+    int32_t ix = to_int32(x), iy = to_int32(y);
+    uint32_t shift = (uint32_t)iy & 31;
+    const char *op = n->str;
+    switch (n->len == 1 ? op[0] : 0) {
+        case '+': r = x + y; break;
+        case '-': r = x - y; break;
+        case '*': r = x * y; break;
+        case '/': r = x / y; break;
+        case '%': r = fmod(x, y); break;
+        case '&': r = ix & iy; break;
+        case '|': r = ix | iy; break;
+        case '^': r = ix ^ iy; break;
+        case '<': boolean = x < y; break;
+        case '>': boolean = x > y; break;
+        default:
+            if (node_text_is(n, "**")) r = pow(x, y);
+            else if (node_text_is(n, "<<")) r = (int32_t)((uint32_t)ix << shift);
+            else if (node_text_is(n, ">>")) r = ix >> shift;
+            else if (node_text_is(n, ">>>")) r = (uint32_t)ix >> shift;
+            else if (node_text_is(n, "<=")) boolean = x <= y;
+            else if (node_text_is(n, ">=")) boolean = x >= y;
+            else if (node_text_is(n, "==") || node_text_is(n, "===")) boolean = x == y;
+            else if (node_text_is(n, "!=") || node_text_is(n, "!==")) boolean = x != y;
+            else return n;
+    }
+    if (boolean >= 0) {
+        Node *b = make_bool(c, boolean);
+        return b ? b : n;
+    }
+    Node *folded = make_number(c, r);
+    if (!folded) return n;
+    // Keep the expression when the result prints longer (1/3)
+    size_t before = printed_number_len(a) + n->len + printed_number_len(b);
+    size_t after = printed_number_len(folded);
+    return after <= before ? folded : n;
+}
+
+/* !n, for a value only tested for truth */
+static Node *negate(Compressor *c, Node *n) {
+    if (n->kind == N_UNARY && node_text_is(n, "!") && value_type(n->a) == 'b') return n->a;
+    if (n->kind == N_UNARY && node_text_is(n, "!") && n->a->kind == N_UNARY && node_text_is(n->a, "!")) return n->a;
+    int t = truthiness(n);
+    if (t >= 0 && is_pure(n)) return make_bool(c, !t);
+    return make_unary(c, "!", n);
+}
+
+/* Compress an assignment target: names stay, computed keys and defaults fold */
+static Node *cx_target(Compressor *c, Node *n) {
+    switch (n->kind) {
+        case N_MEMBER:
+        case N_PAREN:
+            return cx(c, n);
+        case N_ASSIGN:
+            n->a = cx_target(c, n->a);
+            n->b = cx(c, n->b);
+            return n;
+        case N_ARRAY:
+            for (Node *e = n->a; e; e = e->next) {
+                if (e->kind == N_SPREAD) e->a = cx_target(c, e->a);
+            }
+            break;
+        case N_OBJECT:
+            for (Node *e = n->a; e; e = e->next) {
+                if (e->kind == N_SPREAD) continue;
+                if (e->flags & F_COMPUTED) e->a = cx(c, e->a);
+            }
+            break;
+    }
+    // Elements of patterns are targets too
+    Node **link = &n->a;
+    if (n->kind == N_ARRAY) {
+        for (Node *e = *link; e; link = &e->next, e = *link) {
+            if (e->kind == N_HOLE || e->kind == N_SPREAD) continue;
+            Node *next = e->next;
+            e = cx_target(c, e);
+            e->next = next;
+            *link = e;
+        }
+    } else if (n->kind == N_OBJECT) {
+        for (Node *e = n->a; e; e = e->next) {
+            if (e->kind == N_PROP) e->b = cx_target(c, e->b);
+        }
+    }
+    return n;
+}
+
+/* Compress each element of an expression list in place */
+static void cx_list(Compressor *c, Node **link) {
+    for (Node *e = *link; e; link = &e->next, e = *link) {
+        Node *next = e->next;
+        if (e->kind == N_HOLE) continue;
+        if (e->kind == N_SPREAD) {
+            e->a = cx(c, e->a);
             continue;
         }
-        if (in_single_comment) {
-            if (*p == '\n') {
-                in_single_comment = 0;
-                if (prev_non_space && !strchr("{};,([", prev_non_space)) {
-                    putchar('\n');
+        e = cx(c, e);
+        e->next = next;
+        *link = e;
+    }
+}
+
+static void cs_class(Compressor *c, Node *n) {
+    if (n->b) n->b = cx(c, n->b);
+    for (Node *m = n->c; m; m = m->next) {
+        if (m->flags & F_COMPUTED) m->a = cx(c, m->a);
+        if (m->op == P_BLOCK) m->b->a = cs_list(c, m->b->a, 0);
+        else if (m->op == P_FIELD && m->b) m->b = cx(c, m->b);
+        else if (m->b) cs_function(c, m->b);
+    }
+}
+
+static void cs_function(Compressor *c, Node *fn) {
+    for (Node *param = fn->b; param; param = param->next) {
+        if (param->kind == N_ASSIGN) param->b = cx(c, param->b);
+    }
+    if (fn->flags & F_EXPR_BODY) fn->c = cx(c, fn->c);
+    else fn->c = cs_list(c, fn->c, 1);
+}
+
+static Node *cx(Compressor *c, Node *n) {
+    Node *next = n->next;
+    n->next = NULL;
+    switch (n->kind) {
+        case N_IDENT:
+            if (is_undefined(n)) {
+                Node *v = make_void0(c);
+                if (v) n = v;
+            }
+            break;
+        case N_TEMPLATE:
+            for (Node *e = n->a; e; e = e->next) {
+                if (e->kind == N_LIT && e->op == L_CHUNK) continue;
+                // Only a chunk follows an expression, so the list stays linked
+                Node *after = e->next;
+                Node *folded = cx(c, e);
+                if (folded != e) {
+                    for (Node *prev = n->a; prev; prev = prev->next) {
+                        if (prev->next == e) prev->next = folded;
+                    }
+                }
+                folded->next = after;
+                e = folded;
+            }
+            break;
+        case N_TAGGED:
+            n->a = cx(c, n->a);
+            n->b = cx(c, n->b);
+            break;
+        case N_ARRAY:
+            cx_list(c, &n->a);
+            break;
+        case N_OBJECT:
+            for (Node *e = n->a; e; e = e->next) {
+                if (e->kind == N_SPREAD) {
+                    e->a = cx(c, e->a);
+                    continue;
+                }
+                if (e->flags & F_COMPUTED) {
+                    e->a = cx(c, e->a);
+                } else if (lit_is(e->a, L_STR) && string_is_name(e->a)) {
+                    e->a->op = L_NAME;
+                    e->a->str++;
+                    e->a->len -= 2;
+                }
+                if (e->op == P_INIT) e->b = cx(c, e->b);
+                else if (e->op == P_SHORT && e->b->kind == N_ASSIGN) e->b->b = cx(c, e->b->b);
+                else if (e->op != P_SHORT) cs_function(c, e->b);
+            }
+            break;
+        case N_UNARY:
+            n->a = cx(c, n->a);
+            if (node_text_is(n, "!")) {
+                int t = truthiness(n->a);
+                if (t >= 0 && is_pure(n->a)) {
+                    Node *b = make_bool(c, !t);
+                    if (b) n = b;
+                }
+            } else if (node_text_is(n, "void") && n->a->kind == N_LIT && !lit_is(n->a, L_NUM)) {
+                Node *v = make_void0(c);
+                if (v) n = v;
+            }
+            break;
+        case N_UPDATE:
+            if (n->a->kind != N_IDENT) n->a = cx(c, n->a);
+            break;
+        case N_BINARY:
+            n->a = cx(c, n->a);
+            n->b = cx(c, n->b);
+            n = fold_binary(c, n);
+            break;
+        case N_ASSIGN:
+            n->a = cx_target(c, n->a);
+            n->b = cx(c, n->b);
+            break;
+        case N_COND: {
+            n->a = cx(c, n->a);
+            n->b = cx(c, n->b);
+            n->c = cx(c, n->c);
+            int t = truthiness(n->a);
+            if (t >= 0 && is_pure(n->a)) {
+                n = t ? n->b : n->c;
+            } else if (n->a->kind == N_UNARY && node_text_is(n->a, "!")) {
+                Node *swap = n->b;
+                n->a = n->a->a;
+                n->b = n->c;
+                n->c = swap;
+            }
+            break;
+        }
+        case N_CALL:
+        case N_NEW:
+            n->a = cx(c, n->a);
+            cx_list(c, &n->b);
+            break;
+        case N_MEMBER:
+            n->a = cx(c, n->a);
+            if (n->flags & F_COMPUTED) {
+                n->b = cx(c, n->b);
+                if (lit_is(n->b, L_STR) && string_is_name(n->b)) {
+                    Node *name = make_text(c, N_LIT, L_NAME, n->b->str + 1, n->b->len - 2);
+                    if (name) {
+                        n->b = name;
+                        n->flags &= ~F_COMPUTED;
+                    }
                 }
             }
-            continue;
+            break;
+        case N_SEQ: {
+            // Flatten nested sequences and drop values nobody sees
+            Node *head = NULL, **tail = &head;
+            for (Node *e = n->a, *after; e; e = after) {
+                after = e->next;
+                e = cx(c, e);
+                e->next = NULL;
+                Node *items = e->kind == N_SEQ ? e->a : e;
+                for (Node *item = items, *following; item; item = following) {
+                    following = item->next;
+                    item->next = NULL;
+                    if (is_pure(item) && (following || after)) continue;
+                    *tail = item;
+                    tail = &item->next;
+                }
+            }
+            if (head && !head->next) n = head;
+            else if (head) n->a = head;
+            break;
         }
+        case N_SPREAD:
+        case N_YIELD:
+        case N_AWAIT:
+        case N_PAREN:
+            if (n->a) n->a = cx(c, n->a);
+            break;
+        case N_FUNC:
+            cs_function(c, n);
+            break;
+        case N_CLASS:
+            cs_class(c, n);
+            break;
+    }
+    n->next = next;
+    return n;
+}
 
-        // Multi-line comment
-        if (!in_string && !in_regex && *p == '/' && *(p + 1) == '*') {
-            in_multi_comment = 1;
-            p++;
-            continue;
+/* Binding names in a pattern, as fresh identifier nodes */
+static void collect_names(Compressor *c, Node *pattern, Node ***tail) {
+    switch (pattern->kind) {
+        case N_IDENT: {
+            Node *id = make_node(c, N_IDENT);
+            Node *d = make_node(c, N_DECL);
+            if (!id || !d) return;
+            *id = *pattern;
+            id->next = NULL;
+            d->a = id;
+            **tail = d;
+            *tail = &d->next;
+            break;
         }
-        if (in_multi_comment && *p == '*' && *(p + 1) == '/') {
-            in_multi_comment = 0;
-            p++;
-            continue;
+        case N_ASSIGN:
+            collect_names(c, pattern->a, tail);
+            break;
+        case N_SPREAD:
+            collect_names(c, pattern->a, tail);
+            break;
+        case N_ARRAY:
+            for (Node *e = pattern->a; e; e = e->next) {
+                if (e->kind != N_HOLE) collect_names(c, e, tail);
+            }
+            break;
+        case N_OBJECT:
+            for (Node *e = pattern->a; e; e = e->next) collect_names(c, e->kind == N_PROP ? e->b : e, tail);
+            break;
+    }
+}
+
+/* var names declared in a statement that is being dropped (they still hoist) */
+static void collect_vars(Compressor *c, Node *s, Node ***tail) {
+    if (!s) return;
+    switch (s->kind) {
+        case N_VAR:
+            if (s->op != V_VAR) return;
+            for (Node *d = s->a; d; d = d->next) collect_names(c, d->a, tail);
+            return;
+        case N_BLOCK:
+            for (Node *e = s->a; e; e = e->next) collect_vars(c, e, tail);
+            return;
+        case N_IF:
+            collect_vars(c, s->b, tail);
+            collect_vars(c, s->c, tail);
+            return;
+        case N_FOR:
+            if (s->a && s->a->kind == N_VAR) collect_vars(c, s->a, tail);
+            collect_vars(c, s->d, tail);
+            return;
+        case N_FOR_IN:
+        case N_FOR_OF:
+            if (s->a->kind == N_VAR) collect_vars(c, s->a, tail);
+            collect_vars(c, s->d, tail);
+            return;
+        case N_WHILE:
+        case N_DO:
+        case N_WITH:
+            collect_vars(c, s->d, tail);
+            return;
+        case N_LABEL:
+            collect_vars(c, s->a, tail);
+            return;
+        case N_TRY:
+            collect_vars(c, s->a, tail);
+            collect_vars(c, s->c, tail);
+            collect_vars(c, s->d, tail);
+            return;
+        case N_SWITCH:
+            for (Node *k = s->b; k; k = k->next) {
+                for (Node *e = k->b; e; e = e->next) collect_vars(c, e, tail);
+            }
+            return;
+    }
+}
+
+/* `var a, b;` for the vars of dropped statements, or NULL if there are none */
+static Node *hoisted_vars(Compressor *c, Node *dropped) {
+    Node *decls = NULL, **tail = &decls;
+    collect_vars(c, dropped, &tail);
+    if (!decls) return NULL;
+    Node *v = make_node(c, N_VAR);
+    if (!v) return NULL;
+    v->op = V_VAR;
+    v->a = decls;
+    return v;
+}
+
+static int is_jump(const Node *s) {
+    return s->kind == N_RETURN || s->kind == N_THROW || s->kind == N_BREAK || s->kind == N_CONTINUE;
+}
+
+/* A declaration that is scoped to the enclosing block */
+static int is_block_scoped(const Node *s) {
+    return (s->kind == N_VAR && s->op != V_VAR) || s->kind == N_CLASS || (s->kind == N_FUNC && (s->flags & F_DECL));
+}
+
+static int has_block_scoped(const Node *list) {
+    for (; list; list = list->next) {
+        if (is_block_scoped(list)) return 1;
+    }
+    return 0;
+}
+
+/* A local function declaration nothing refers to */
+static int is_unused_function(const Compressor *c, const Node *s) {
+    if (s->kind != N_FUNC || !(s->flags & F_DECL) || !s->a) return 0;
+    const Symbol *sym = s->a->u.sym;
+    for (const Scope *scope = sym->scope; scope; scope = scope->parent) {
+        if (scope->uses_eval) return 0;
+    }
+    return sym->refs == 0 && sym->scope != c->p->program;
+}
+
+static Node *make_block(Compressor *c, Node *list) {
+    Node *b = make_node(c, N_BLOCK);
+    if (b) b->a = list;
+    return b;
+}
+
+/* A statement in a position that needs one (if / loop bodies) */
+static Node *cs_body(Compressor *c, Node *s) {
+    Node *r = cs_stmt(c, s);
+    if (!r) r = make_node(c, N_EMPTY);
+    return r;
+}
+
+static Node *make_seq(Compressor *c, Node *a, Node *b) {
+    Node *seq = make_node(c, N_SEQ);
+    if (!seq) return NULL;
+    if (a->kind == N_SEQ) {
+        seq->a = a->a;
+    } else {
+        seq->a = a;
+    }
+    Node *last = seq->a;
+    while (last->next) last = last->next;
+    last->next = b->kind == N_SEQ ? b->a : b;
+    return seq;
+}
+
+static Node *cs_if(Compressor *c, Node *n) {
+    n->a = cx(c, n->a);
+    n->b = cs_body(c, n->b);
+    if (n->c) n->c = cs_body(c, n->c);
+    if (n->c && n->c->kind == N_EMPTY) n->c = NULL;
+
+    int t = truthiness(n->a);
+    if (t >= 0 && is_pure(n->a)) {
+        Node *keep = t ? n->b : n->c, *drop = t ? n->c : n->b;
+        Node *vars = hoisted_vars(c, drop);
+        if (!vars) return keep;
+        if (!keep || keep->kind == N_EMPTY) return vars;
+        keep->next = vars;
+        return make_block(c, keep);
+    }
+    if (n->b->kind == N_EMPTY && !n->c) {
+        Node *e = make_node(c, N_EXPR);
+        if (e) e->a = n->a;
+        return e;
+    }
+    if (n->b->kind == N_EMPTY) {
+        n->a = negate(c, n->a);
+        n->b = n->c;
+        n->c = NULL;
+    } else if (n->c && n->a->kind == N_UNARY && node_text_is(n->a, "!")) {
+        Node *swap = n->b;
+        n->a = n->a->a;
+        n->b = n->c;
+        n->c = swap;
+    }
+    if (n->c && n->b->kind == N_EXPR && n->c->kind == N_EXPR) {
+        Node *cond = make_node(c, N_COND), *e = make_node(c, N_EXPR);
+        if (!cond || !e) return n;
+        cond->a = n->a;
+        cond->b = n->b->a;
+        cond->c = n->c->a;
+        e->a = cond;
+        return e;
+    }
+    if (n->c && n->b->kind == N_RETURN && n->c->kind == N_RETURN && n->b->a && n->c->a) {
+        Node *cond = make_node(c, N_COND);
+        if (!cond) return n;
+        cond->a = n->a;
+        cond->b = n->b->a;
+        cond->c = n->c->a;
+        n->b->a = cond;
+        return n->b;
+    }
+    if (!n->c && n->b->kind == N_EXPR) {
+        int negated = n->a->kind == N_UNARY && node_text_is(n->a, "!");
+        Node *logic = make_text(c, N_BINARY, 0, negated ? "||" : "&&", 2), *e = make_node(c, N_EXPR);
+        if (!logic || !e) return n;
+        logic->a = negated ? n->a->a : n->a;
+        logic->b = n->b->a;
+        e->a = logic;
+        return e;
+    }
+    return n;
+}
+
+/* Compress a statement; NULL when it disappears */
+static Node *cs_stmt(Compressor *c, Node *n) {
+    n->next = NULL;
+    switch (n->kind) {
+        case N_EMPTY:
+            return NULL;
+        case N_EXPR:
+            if (n->flags & F_DIRECTIVE) return n;
+            n->a = cx(c, n->a);
+            return is_pure(n->a) ? NULL : n;
+        case N_VAR:
+            for (Node *d = n->a; d; d = d->next) {
+                d->a = cx_target(c, d->a);
+                if (d->b) d->b = cx(c, d->b);
+                if (d->b && n->op != V_CONST && is_void0(d->b)) d->b = NULL;
+            }
+            return n;
+        case N_FUNC:
+            if (is_unused_function(c, n)) return NULL;
+            cs_function(c, n);
+            return n;
+        case N_CLASS:
+            cs_class(c, n);
+            return n;
+        case N_RETURN:
+            if (n->a) n->a = cx(c, n->a);
+            if (n->a && is_void0(n->a)) n->a = NULL;
+            return n;
+        case N_THROW:
+            n->a = cx(c, n->a);
+            return n;
+        case N_IF:
+            return cs_if(c, n);
+        case N_FOR:
+            if (n->a) n->a = n->a->kind == N_VAR ? cs_stmt(c, n->a) : cx(c, n->a);
+            if (n->b) n->b = cx(c, n->b);
+            if (n->b && truthiness(n->b) == 1 && is_pure(n->b)) n->b = NULL;
+            if (n->c) n->c = cx(c, n->c);
+            n->d = cs_body(c, n->d);
+            return n;
+        case N_FOR_IN:
+        case N_FOR_OF:
+            if (n->a->kind != N_VAR) n->a = cx_target(c, n->a);
+            n->b = cx(c, n->b);
+            n->d = cs_body(c, n->d);
+            return n;
+        case N_WHILE: {
+            n->a = cx(c, n->a);
+            n->d = cs_body(c, n->d);
+            int t = truthiness(n->a);
+            if (t == 0 && is_pure(n->a)) return hoisted_vars(c, n->d);
+            if (t == 1 && is_pure(n->a)) {
+                // while (true) -> for (;;)
+                n->kind = N_FOR;
+                n->a = NULL;
+            }
+            return n;
         }
-        if (in_multi_comment) continue;
+        case N_DO:
+            n->d = cs_body(c, n->d);
+            n->a = cx(c, n->a);
+            return n;
+        case N_LABEL:
+            n->a = cs_body(c, n->a);
+            return n;
+        case N_WITH:
+            n->a = cx(c, n->a);
+            n->d = cs_body(c, n->d);
+            return n;
+        case N_SWITCH:
+            n->a = cx(c, n->a);
+            for (Node *k = n->b; k; k = k->next) {
+                if (k->a) k->a = cx(c, k->a);
+                k->b = cs_list(c, k->b, 0);
+            }
+            return n;
+        case N_TRY:
+            n->a->a = cs_list(c, n->a->a, 0);
+            if (n->b) n->b = cx_target(c, n->b);
+            if (n->c) n->c->a = cs_list(c, n->c->a, 0);
+            if (n->d) n->d->a = cs_list(c, n->d->a, 0);
+            return n;
+        case N_BLOCK:
+            n->a = cs_list(c, n->a, 0);
+            if (!n->a) return NULL;
+            if (!n->a->next && !is_block_scoped(n->a)) return n->a;
+            return n;
+        case N_EXPORT:
+            if (n->a->kind == N_FUNC) cs_function(c, n->a);
+            else if (n->a->kind == N_CLASS) cs_class(c, n->a);
+            else if (n->a->kind == N_VAR) cs_stmt(c, n->a);
+            else n->a = cx(c, n->a);
+            return n;
+        default:
+            return n;
+    }
+}
 
-        // Strings
-        if (!in_string && !in_regex && (*p == '"' || *p == '\'' || *p == '`')) {
-            in_string = 1;
-            string_char = *p;
-            putchar(*p);
-            prev_char = *p;
-            prev_non_space = *p;
-            continue;
+/* Expressions in statements that a preceding expression statement can join */
+static Node **joinable_expr(Node *s) {
+    switch (s->kind) {
+        case N_EXPR:
+            return s->flags & F_DIRECTIVE ? NULL : &s->a;
+        case N_RETURN:
+            return s->a ? &s->a : NULL;
+        case N_THROW:
+        case N_IF:
+        case N_SWITCH:
+            return &s->a;
+        case N_FOR:
+            return s->a && s->a->kind == N_VAR ? NULL : &s->a;
+        default:
+            return NULL;
+    }
+}
+
+/* Join s into the statement before it where possible; returns 1 if done */
+static int join_statements(Compressor *c, Node *prev, Node *s, Node **replace) {
+    *replace = NULL;
+    if (prev->kind == N_EXPR && !(prev->flags & F_DIRECTIVE)) {
+        Node **slot = joinable_expr(s);
+        if (!slot) return 0;
+        Node *seq = *slot ? make_seq(c, prev->a, *slot) : prev->a;
+        if (!seq) return 0;
+        *slot = seq;
+        *replace = s;
+        return 1;
+    }
+    if (prev->kind == N_VAR && s->kind == N_VAR && prev->op == s->op) {
+        Node *last = prev->a;
+        while (last->next) last = last->next;
+        last->next = s->a;
+        return 1;
+    }
+    if (prev->kind == N_VAR && prev->op == V_VAR && s->kind == N_FOR && s->a && s->a->kind == N_VAR &&
+        s->a->op == V_VAR) {
+        Node *last = prev->a;
+        while (last->next) last = last->next;
+        last->next = s->a->a;
+        s->a->a = prev->a;
+        *replace = s;
+        return 1;
+    }
+    return 0;
+}
+
+static Node *cs_list(Compressor *c, Node *list, int fn_body) {
+    Node *head = NULL, **tail = &head;
+    Node *prev = NULL, **prev_link = NULL;
+    int dead = 0;
+    for (Node *s = list, *next; s; s = next) {
+        next = s->next;
+        s->next = NULL;
+        Node *items;
+        if (dead) {
+            // Unreachable: only hoisted declarations still matter
+            if (s->kind == N_FUNC && (s->flags & F_DECL)) {
+                if (is_unused_function(c, s)) continue;
+                cs_function(c, s);
+                items = s;
+            } else if (!(items = hoisted_vars(c, s))) {
+                continue;
+            }
+        } else {
+            items = cs_stmt(c, s);
+            if (!items) continue;
+            // A block without declarations of its own melts into the list
+            if (items->kind == N_BLOCK && !has_block_scoped(items->a)) items = items->a;
         }
-        if (in_string && *p == string_char && *(p - 1) != '\\') {
-            in_string = 0;
-            putchar(*p);
-            prev_char = *p;
-            prev_non_space = *p;
-            continue;
+        for (Node *item = items, *following; item; item = following) {
+            following = item->next;
+            item->next = NULL;
+            if (is_jump(item)) dead = 1;
+            Node *replace;
+            if (prev && join_statements(c, prev, item, &replace)) {
+                if (replace) {
+                    *prev_link = replace;
+                    tail = &replace->next;
+                    prev = replace;
+                }
+                continue;
+            }
+            prev_link = tail;
+            *tail = item;
+            tail = &item->next;
+            prev = item;
         }
-        if (in_string) {
-            putchar(*p);
-            prev_char = *p;
-            continue;
+    }
+    // A bare `return;` at the end of a function body
+    if (fn_body && prev && prev->kind == N_RETURN && !prev->a) *prev_link = NULL;
+    return head;
+}
+
+/* ---- Mangler ---- */
+
+static const char mangle_first[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_";
+static const char mangle_rest[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_0123456789";
+
+static size_t mangled_name(uint32_t slot, char *buf) {
+    size_t len = 0;
+    buf[len++] = mangle_first[slot % 54];
+    slot /= 54;
+    while (slot > 0) {
+        slot--;
+        buf[len++] = mangle_rest[slot % 64];
+        slot /= 64;
+    }
+    return len;
+}
+
+static const char *const js_other_keywords[] = {
+    "let", "static", "yield", "await", "implements", "package", "protected", "interface", "private", "public",
+    "arguments", "eval", "undefined", "NaN", "Infinity", NULL
+};
+
+typedef struct {
+    Parser *p;
+    uint64_t *seen;         /* (scope, symbol) pairs already on a scope's outer list */
+    size_t seen_cap, seen_count;
+    uint32_t *taken;
+    size_t taken_cap;
+    Symbol **syms;
+    size_t syms_cap;
+} Mangler;
+
+static uint64_t pair_key(const Scope *s, const Symbol *sym) {
+    uint64_t h = ((uint64_t)(uintptr_t)s * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)(uintptr_t)sym * 0xc2b2ae3d27d4eb4fULL);
+    return (h ^ (h >> 29)) | 1;
+}
+
+/* Record that scope s sees sym from further out; returns 0 if it already did */
+static int mark_outer(Mangler *m, Scope *s, Symbol *sym) {
+    if ((m->seen_count + 1) * 2 > m->seen_cap) {
+        size_t cap = m->seen_cap ? m->seen_cap * 2 : 4096;
+        uint64_t *slots = (uint64_t *)calloc(cap, sizeof(uint64_t));
+        if (!slots) return -1;
+        for (size_t i = 0; i < m->seen_cap; i++) {
+            if (!m->seen[i]) continue;
+            size_t j = (size_t)m->seen[i] & (cap - 1);
+            while (slots[j]) j = (j + 1) & (cap - 1);
+            slots[j] = m->seen[i];
         }
+        free(m->seen);
+        m->seen = slots;
+        m->seen_cap = cap;
+    }
+    // Hash collisions only make a name unavailable that would have been free
+    uint64_t key = pair_key(s, sym);
+    size_t j = (size_t)key & (m->seen_cap - 1);
+    while (m->seen[j]) {
+        if (m->seen[j] == key) return 0;
+        j = (j + 1) & (m->seen_cap - 1);
+    }
+    m->seen[j] = key;
+    m->seen_count++;
+    OuterRef *ref = (OuterRef *)arena_alloc(&m->p->arena, sizeof(OuterRef));
+    if (!ref) return -1;
+    ref->sym = sym;
+    ref->next = s->outer;
+    s->outer = ref;
+    return 1;
+}
 
-        // Regex
-        if (!in_regex && *p == '/' &&
-            (prev_non_space == '=' || prev_non_space == '(' ||
-             prev_non_space == ',' || prev_non_space == ':' ||
-             prev_non_space == '[' || prev_non_space == '!' ||
-             prev_non_space == '&' || prev_non_space == '|' ||
-             prev_non_space == '?' || prev_non_space == '{' ||
-             prev_non_space == ';' || prev_char == '\n')) {
-            in_regex = 1;
-            putchar(*p);
-            prev_char = *p;
-            prev_non_space = *p;
-            continue;
+static int cmp_slot(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_uses(const void *a, const void *b) {
+    const Symbol *x = *(Symbol *const *)a, *y = *(Symbol *const *)b;
+    if (x->uses != y->uses) return x->uses > y->uses ? -1 : 1;
+    return x->name < y->name ? -1 : x->name > y->name;     /* Declaration order */
+}
+
+static int name_reserved(Mangler *m, const char *name, size_t len) {
+    return js_word_in(name, len, js_reserved_words) || js_word_in(name, len, js_other_keywords) ||
+           name_find(&m->p->names, &reserved_owner, name, len);
+}
+
+/* Give the symbols of s (then of the scopes inside it) their names */
+static int mangle_scope(Mangler *m, Scope *s) {
+    if (!s->keep_names && s->symbols) {
+        size_t ntaken = 0, nsyms = 0;
+        for (OuterRef *r = s->outer; r; r = r->next) {
+            if (r->sym->slot < 0) continue;
+            if (ntaken == m->taken_cap) {
+                m->taken_cap = m->taken_cap ? m->taken_cap * 2 : 256;
+                uint32_t *tmp = (uint32_t *)realloc(m->taken, m->taken_cap * sizeof(uint32_t));
+                if (!tmp) return 0;
+                m->taken = tmp;
+            }
+            m->taken[ntaken++] = (uint32_t)r->sym->slot;
         }
-        if (in_regex && *p == '/' && *(p - 1) != '\\') {
-            in_regex = 0;
-            putchar(*p);
-            prev_char = *p;
-            prev_non_space = *p;
-            continue;
+        if (ntaken > 1) qsort(m->taken, ntaken, sizeof(uint32_t), cmp_slot);
+        for (Symbol *sym = s->symbols; sym; sym = sym->next) {
+            if (nsyms == m->syms_cap) {
+                m->syms_cap = m->syms_cap ? m->syms_cap * 2 : 256;
+                Symbol **tmp = (Symbol **)realloc(m->syms, m->syms_cap * sizeof(Symbol *));
+                if (!tmp) return 0;
+                m->syms = tmp;
+            }
+            m->syms[nsyms++] = sym;
         }
-        if (in_regex) {
-            putchar(*p);
-            prev_char = *p;
-            continue;
+        qsort(m->syms, nsyms, sizeof(Symbol *), cmp_uses);
+        uint32_t slot = 0;
+        size_t t = 0;
+        for (size_t i = 0; i < nsyms; i++) {
+            char buf[8];
+            size_t len;
+            for (;; slot++) {
+                while (t < ntaken && m->taken[t] < slot) t++;
+                if (t < ntaken && m->taken[t] == slot) continue;
+                len = mangled_name(slot, buf);
+                if (!name_reserved(m, buf, len)) break;
+            }
+            Symbol *sym = m->syms[i];
+            char *name = (char *)arena_alloc(&m->p->arena, len);
+            if (!name) return 0;
+            memcpy(name, buf, len);
+            sym->slot = (int32_t)slot++;
+            sym->mangled = name;
+            sym->mangled_len = (uint32_t)len;
+        }
+    }
+    for (Scope *child = s->children; child; child = child->sibling) {
+        if (!mangle_scope(m, child)) return 0;
+    }
+    return 1;
+}
+
+/* Which scopes keep their names: the program, and scopes with eval / with around */
+static void mark_kept(Parser *p, Scope *s) {
+    if (s->uses_eval) {
+        for (Scope *up = s; up && !up->keep_names; up = up->parent) up->keep_names = 1;
+    }
+    for (Scope *child = s->children; child; child = child->sibling) mark_kept(p, child);
+}
+
+static int reserve_kept_names(Parser *p, Scope *s) {
+    if (s->keep_names) {
+        for (Symbol *sym = s->symbols; sym; sym = sym->next) {
+            NameSlot *slot = name_insert(&p->names, &reserved_owner, sym->name, sym->len);
+            if (!slot) return 0;
+            if (!slot->value) {
+                slot->value = (void *)&reserved_owner;
+                p->names.count++;
+            }
+        }
+    }
+    for (Scope *child = s->children; child; child = child->sibling) {
+        if (!reserve_kept_names(p, child)) return 0;
+    }
+    return 1;
+}
+
+static int mangle(Parser *p) {
+    Mangler m;
+    memset(&m, 0, sizeof(m));
+    m.p = p;
+    p->program->keep_names = 1;
+    mark_kept(p, p->program);
+    int ok = reserve_kept_names(p, p->program);
+    // Every scope between a use and its declaration must not reuse the name
+    for (size_t i = 0; ok && i < p->nrefs; i++) {
+        Symbol *sym = p->refs[i].ident->u.sym;
+        if (!sym) continue;
+        for (Scope *s = p->refs[i].scope; s && s != sym->scope; s = s->parent) {
+            int r = mark_outer(&m, s, sym);
+            if (r < 0) ok = 0;
+            if (r <= 0) break;
+        }
+    }
+    if (ok) ok = mangle_scope(&m, p->program);
+    free(m.seen);
+    free(m.taken);
+    free(m.syms);
+    return ok ? 1 : fail(p, "out of memory");
+}
+
+/* ---- Printer ---- */
+
+typedef struct {
+    const Parser *p;
+    int compress;
+    char last;              /* Last character written */
+    int semicolon;          /* A ';' is owed unless a '}' comes next */
+    int no_in;              /* In a for-loop head: parenthesize 'in' */
+} Printer;
+
+static void pr_write(Printer *pr, const char *s, size_t len) {
+    if (len == 0) return;
+    if (pr->semicolon) {
+        out_char(';');
+        pr->last = ';';
+        pr->semicolon = 0;
+    }
+    unsigned char last = (unsigned char)pr->last, first = (unsigned char)s[0];
+    if ((js_ident_char(last) && (js_ident_char(first) || first == '#')) ||
+        ((last == '+' || last == '-') && first == last) || (last == '/' && (first == '/' || first == '*')) ||
+        (last == '<' && first == '!')) {
+        out_char(' ');
+    }
+    out_write(s, len);
+    pr->last = s[len - 1];
+}
+
+static void pr_str(Printer *pr, const char *s) {
+    pr_write(pr, s, strlen(s));
+}
+
+/* '}' closing a block: a pending ';' is not needed before it */
+static void pr_close(Printer *pr) {
+    pr->semicolon = 0;
+    pr_str(pr, "}");
+}
+
+static void print_expr(Printer *pr, const Node *n, int prec);
+static void print_stmt(Printer *pr, const Node *n);
+static void print_function(Printer *pr, const Node *fn, int method);
+static void print_class(Printer *pr, const Node *n);
+
+static void print_stmts(Printer *pr, const Node *list) {
+    for (; list; list = list->next) {
+        if (list->kind != N_EMPTY) print_stmt(pr, list);
+    }
+}
+
+static void print_ident(Printer *pr, const Node *n) {
+    const Symbol *sym = n->u.sym;
+    if (sym && sym->mangled) pr_write(pr, sym->mangled, sym->mangled_len);
+    else pr_write(pr, n->str, n->len);
+}
+
+static int ident_printed_as(const Node *id, const Node *key) {
+    const Symbol *sym = id->u.sym;
+    const char *s = sym && sym->mangled ? sym->mangled : id->str;
+    size_t len = sym && sym->mangled ? sym->mangled_len : id->len;
+    return key->op == L_NAME && key->len == len && memcmp(key->str, s, len) == 0;
+}
+
+/* Numbers print in their shortest form when compressing */
+static void print_number(Printer *pr, const Node *n) {
+    double v;
+    char buf[32];
+    if (pr->compress && number_value(n->str, n->len, &v)) {
+        size_t len = format_number(v, buf);
+        if (len < n->len) {
+            pr_write(pr, buf, len);
+            return;
         }
+    }
+    pr_write(pr, n->str, n->len);
+}
+
+static int expr_prec(const Printer *pr, const Node *n) {
+    switch (n->kind) {
+        case N_SEQ: return 1;
+        case N_ASSIGN: case N_YIELD: return 2;
+        case N_FUNC: return n->flags & F_ARROW ? 2 : 20;
+        case N_COND: return 3;
+        case N_BINARY: return binary_prec(n->str, n->len);
+        case N_UNARY: case N_AWAIT: return 15;
+        case N_UPDATE: return n->flags & F_PREFIX ? 15 : 16;
+        case N_NEW: return n->flags & F_ARGS ? 18 : 17;
+        case N_CALL: case N_MEMBER: case N_TAGGED: return 18;
+        case N_LIT: return pr->compress && (n->op == L_TRUE || n->op == L_FALSE) ? 15 : 20;
+        default: return 20;
+    }
+}
+
+/* The node whose text starts an expression */
+static const Node *leftmost(const Node *n) {
+    for (;;) {
+        switch (n->kind) {
+            case N_BINARY: case N_ASSIGN: case N_COND: case N_CALL: case N_MEMBER: case N_TAGGED:
+                n = n->a;
+                break;
+            case N_UPDATE:
+                if (n->flags & F_PREFIX) return n;
+                n = n->a;
+                break;
+            case N_SEQ:
+                n = n->a;
+                break;
+            default:
+                return n;
+        }
+    }
+}
+
+/* Would this expression read as a statement of another kind at statement start? */
+static int needs_statement_parens(const Node *e) {
+    const Node *first = leftmost(e);
+    return first->kind == N_OBJECT || first->kind == N_CLASS || (first->kind == N_FUNC && !(first->flags & F_ARROW)) ||
+           (first->kind == N_IDENT && node_text_is(first, "let"));
+}
+
+/* A call inside the callee of new would take its arguments: new (a())() */
+static int callee_has_call(const Node *n) {
+    while (n->kind == N_MEMBER || n->kind == N_TAGGED) n = n->a;
+    return n->kind == N_CALL;
+}
+
+static void print_list(Printer *pr, const Node *list) {
+    for (const Node *e = list; e; e = e->next) {
+        if (e != list) pr_str(pr, ",");
+        print_expr(pr, e, 2);
+    }
+}
 
-        // Whitespace
-        if (isspace((unsigned char)*p)) {
-            if (prev_char && isalnum((unsigned char)prev_char)) {
-                space_needed = 1;
+static void print_args(Printer *pr, const Node *args) {
+    int no_in = pr->no_in;
+    pr->no_in = 0;
+    pr_str(pr, "(");
+    print_list(pr, args);
+    pr_str(pr, ")");
+    pr->no_in = no_in;
+}
+
+static void print_key(Printer *pr, const Node *prop) {
+    if (prop->flags & F_COMPUTED) {
+        pr_str(pr, "[");
+        print_expr(pr, prop->a, 2);
+        pr_str(pr, "]");
+    } else {
+        pr_write(pr, prop->a->str, prop->a->len);
+    }
+}
+
+static void print_prop(Printer *pr, const Node *e) {
+    if (e->kind == N_SPREAD) {
+        pr_str(pr, "...");
+        print_expr(pr, e->a, 2);
+        return;
+    }
+    if (e->flags & F_STATIC) pr_str(pr, "static");
+    switch (e->op) {
+        case P_SHORT: {
+            const Node *id = e->b->kind == N_ASSIGN ? e->b->a : e->b;
+            if (!ident_printed_as(id, e->a)) {
+                print_key(pr, e);
+                pr_str(pr, ":");
             }
-            if (*p == '\n' && prev_non_space &&
-                !strchr("{};,([+\\-*/%=<>!&|?:", prev_non_space)) {
-                putchar('\n');
-                prev_char = '\n';
+            print_expr(pr, e->b, 2);
+            return;
+        }
+        case P_INIT:
+            print_key(pr, e);
+            pr_str(pr, ":");
+            print_expr(pr, e->b, 2);
+            return;
+        case P_FIELD:
+            print_key(pr, e);
+            if (e->b) {
+                pr_str(pr, "=");
+                print_expr(pr, e->b, 2);
             }
-            continue;
+            pr->semicolon = 1;
+            return;
+        case P_BLOCK:
+            pr_str(pr, "{");
+            print_stmts(pr, e->b->a);
+            pr_close(pr);
+            return;
+        default:
+            if (e->b->flags & F_ASYNC) pr_str(pr, "async");
+            if (e->b->flags & F_GENERATOR) pr_str(pr, "*");
+            if (e->op == P_GET) pr_str(pr, "get");
+            if (e->op == P_SET) pr_str(pr, "set");
+            print_key(pr, e);
+            print_function(pr, e->b, 1);
+    }
+}
+
+static void print_body(Printer *pr, const Node *list) {
+    int no_in = pr->no_in;
+    pr->no_in = 0;
+    pr_str(pr, "{");
+    print_stmts(pr, list);
+    pr_close(pr);
+    pr->no_in = no_in;
+}
+
+static void print_function(Printer *pr, const Node *fn, int method) {
+    if (!method) {
+        if (fn->flags & F_ASYNC) pr_str(pr, "async");
+        if (!(fn->flags & F_ARROW)) {
+            pr_str(pr, "function");
+            if (fn->flags & F_GENERATOR) pr_str(pr, "*");
+            if (fn->a) print_ident(pr, fn->a);
+        }
+    }
+    const Node *params = fn->b;
+    if (fn->flags & F_ARROW && params && !params->next && params->kind == N_IDENT) {
+        print_ident(pr, params);
+    } else {
+        print_args(pr, params);
+    }
+    if (fn->flags & F_ARROW) pr_str(pr, "=>");
+    if (fn->flags & F_EXPR_BODY) {
+        if (leftmost(fn->c)->kind == N_OBJECT) {
+            int no_in = pr->no_in;
+            pr->no_in = 0;
+            pr_str(pr, "(");
+            print_expr(pr, fn->c, 1);
+            pr_str(pr, ")");
+            pr->no_in = no_in;
+        } else {
+            print_expr(pr, fn->c, 2);
+        }
+    } else {
+        print_body(pr, fn->c);
+    }
+}
+
+static void print_class(Printer *pr, const Node *n) {
+    pr_str(pr, "class");
+    if (n->a) print_ident(pr, n->a);
+    if (n->b) {
+        pr_str(pr, "extends");
+        print_expr(pr, n->b, 18);
+    }
+    int no_in = pr->no_in;
+    pr->no_in = 0;
+    pr_str(pr, "{");
+    for (const Node *m = n->c; m; m = m->next) print_prop(pr, m);
+    pr_close(pr);
+    pr->no_in = no_in;
+}
+
+static void print_expr(Printer *pr, const Node *n, int prec) {
+    int own = expr_prec(pr, n);
+    int paren = own < prec;
+    int new_args = 0;
+    if (n->kind == N_NEW && !(n->flags & F_ARGS) && prec > 17) {
+        // new X().y, not (new X).y
+        paren = 0;
+        new_args = 1;
+    }
+    if (pr->no_in && n->kind == N_BINARY && node_text_is(n, "in")) paren = 1;
+    int no_in = pr->no_in;
+    if (paren) {
+        pr_str(pr, "(");
+        pr->no_in = 0;
+    }
+    switch (n->kind) {
+        case N_IDENT:
+            print_ident(pr, n);
+            break;
+        case N_LIT:
+            if (n->op == L_NUM) print_number(pr, n);
+            else if (pr->compress && n->op == L_TRUE) pr_str(pr, "!0");
+            else if (pr->compress && n->op == L_FALSE) pr_str(pr, "!1");
+            else pr_write(pr, n->str, n->len);
+            break;
+        case N_TEMPLATE: {
+            int saved = pr->no_in;
+            pr->no_in = 0;
+            for (const Node *e = n->a; e; e = e->next) {
+                if (e->kind == N_LIT && e->op == L_CHUNK) pr_write(pr, e->str, e->len);
+                else print_expr(pr, e, 1);
+            }
+            pr->no_in = saved;
+            break;
+        }
+        case N_TAGGED:
+            print_expr(pr, n->a, 18);
+            print_expr(pr, n->b, 20);
+            break;
+        case N_ARRAY: {
+            int saved = pr->no_in;
+            pr->no_in = 0;
+            pr_str(pr, "[");
+            for (const Node *e = n->a; e; e = e->next) {
+                if (e != n->a) pr_str(pr, ",");
+                if (e->kind != N_HOLE) print_expr(pr, e, 2);
+                else if (!e->next) pr_str(pr, ",");
+            }
+            pr_str(pr, "]");
+            pr->no_in = saved;
+            break;
+        }
+        case N_OBJECT: {
+            int saved = pr->no_in;
+            pr->no_in = 0;
+            pr_str(pr, "{");
+            for (const Node *e = n->a; e; e = e->next) {
+                if (e != n->a) pr_str(pr, ",");
+                print_prop(pr, e);
+            }
+            pr_str(pr, "}");
+            pr->no_in = saved;
+            break;
+        }
+        case N_SPREAD:
+            pr_str(pr, "...");
+            print_expr(pr, n->a, 2);
+            break;
+        case N_UNARY:
+            pr_write(pr, n->str, n->len);
+            print_expr(pr, n->a, 15);
+            break;
+        case N_UPDATE:
+            if (n->flags & F_PREFIX) pr_write(pr, n->str, n->len);
+            print_expr(pr, n->a, 17);
+            if (!(n->flags & F_PREFIX)) pr_write(pr, n->str, n->len);
+            break;
+        case N_BINARY: {
+            int right_assoc = own == 14;
+            int coalesce = node_text_is(n, "??");
+            int left_prec = right_assoc ? own + 1 : own, right_prec = right_assoc ? own : own + 1;
+            const Node *sides[2] = {n->a, n->b};
+            for (int i = 0; i < 2; i++) {
+                const Node *side = sides[i];
+                int need = i == 0 ? left_prec : right_prec;
+                // ?? does not mix with && / || without parentheses, nor ** with a unary left side
+                if (side->kind == N_BINARY && (coalesce ? (node_text_is(side, "||") || node_text_is(side, "&&"))
+                                                        : ((node_text_is(n, "||") || node_text_is(n, "&&")) &&
+                                                           node_text_is(side, "??")))) {
+                    need = 21;
+                }
+                if (right_assoc && i == 0 && (side->kind == N_UNARY || side->kind == N_AWAIT ||
+                                              (side->kind == N_LIT && expr_prec(pr, side) == 15))) {
+                    need = 21;
+                }
+                if (i == 1) pr_write(pr, n->str, n->len);
+                print_expr(pr, side, need);
+            }
+            break;
+        }
+        case N_ASSIGN:
+            print_expr(pr, n->a, 17);
+            pr_write(pr, n->str, n->len);
+            print_expr(pr, n->b, 2);
+            break;
+        case N_COND: {
+            print_expr(pr, n->a, 4);
+            pr_str(pr, "?");
+            int saved = pr->no_in;
+            pr->no_in = 0;
+            print_expr(pr, n->b, 2);
+            pr->no_in = saved;
+            pr_str(pr, ":");
+            print_expr(pr, n->c, 2);
+            break;
+        }
+        case N_CALL:
+            print_expr(pr, n->a, 18);
+            if (n->flags & F_OPTIONAL) pr_str(pr, "?.");
+            print_args(pr, n->b);
+            break;
+        case N_NEW:
+            pr_str(pr, "new");
+            if (callee_has_call(n->a) || has_optional(n->a)) print_expr(pr, n->a, 21);
+            else print_expr(pr, n->a, n->a->kind == N_NEW ? 17 : 18);
+            if (n->flags & F_ARGS || new_args) print_args(pr, n->b);
+            break;
+        case N_MEMBER:
+            print_expr(pr, n->a, 18);
+            if (!(n->flags & F_COMPUTED) && !(n->flags & F_OPTIONAL) && lit_is(n->a, L_NUM)) {
+                // 1..toString(): a digit-only number would swallow the dot
+                char buf[32];
+                double v;
+                const char *text = n->a->str;
+                size_t len = n->a->len;
+                if (pr->compress && number_value(n->a->str, n->a->len, &v) && format_number(v, buf) < len) {
+                    text = buf;
+                    len = strlen(buf);
+                }
+                size_t i = 0;
+                while (i < len && isdigit((unsigned char)text[i])) i++;
+                if (i == len) pr_str(pr, ".");
+            }
+            if (n->flags & F_OPTIONAL) pr_str(pr, "?.");
+            if (n->flags & F_COMPUTED) {
+                int saved = pr->no_in;
+                pr->no_in = 0;
+                pr_str(pr, "[");
+                print_expr(pr, n->b, 1);
+                pr_str(pr, "]");
+                pr->no_in = saved;
+            } else {
+                if (!(n->flags & F_OPTIONAL)) pr_str(pr, ".");
+                pr_write(pr, n->b->str, n->b->len);
+            }
+            break;
+        case N_SEQ:
+            for (const Node *e = n->a; e; e = e->next) {
+                if (e != n->a) pr_str(pr, ",");
+                print_expr(pr, e, 2);
+            }
+            break;
+        case N_YIELD:
+            pr_str(pr, n->flags & F_DELEGATE ? "yield*" : "yield");
+            if (n->a) print_expr(pr, n->a, 2);
+            break;
+        case N_AWAIT:
+            pr_str(pr, "await");
+            print_expr(pr, n->a, 15);
+            break;
+        case N_FUNC:
+            print_function(pr, n, 0);
+            break;
+        case N_CLASS:
+            print_class(pr, n);
+            break;
+        case N_PAREN:
+            pr_str(pr, "(");
+            print_expr(pr, n->a, 1);
+            pr_str(pr, ")");
+            break;
+    }
+    if (paren) {
+        pr_str(pr, ")");
+        pr->no_in = no_in;
+    }
+}
+
+static void print_var(Printer *pr, const Node *n) {
+    static const char *const kinds[] = {"var", "let", "const"};
+    pr_str(pr, kinds[n->op]);
+    for (const Node *d = n->a; d; d = d->next) {
+        if (d != n->a) pr_str(pr, ",");
+        print_expr(pr, d->a, 2);
+        if (d->b) {
+            pr_str(pr, "=");
+            print_expr(pr, d->b, 2);
         }
+    }
+}
 
-        // Output space if needed
-        if (space_needed &&
-            (isalnum((unsigned char)*p) || *p == '_' || *p == '$') &&
-            (isalnum((unsigned char)prev_char) || prev_char == '_' || prev_char == '$')) {
-            putchar(' ');
+/* Would an 'else' after this statement attach to an if inside it? */
+static int ends_in_open_if(const Node *s) {
+    for (;;) {
+        switch (s->kind) {
+            case N_IF:
+                if (!s->c) return 1;
+                s = s->c;
+                break;
+            case N_FOR: case N_FOR_IN: case N_FOR_OF: case N_WHILE: case N_WITH:
+                s = s->d;
+                break;
+            case N_LABEL:
+                s = s->a;
+                break;
+            default:
+                return 0;
         }
-        space_needed = 0;
+    }
+}
+
+/* The statement after if (...), for (...) etc.: an empty one prints as ';' */
+static void print_sub(Printer *pr, const Node *s) {
+    if (s->kind == N_EMPTY) {
+        pr_str(pr, ";");
+        return;
+    }
+    print_stmt(pr, s);
+}
+
+static void print_stmt(Printer *pr, const Node *n) {
+    switch (n->kind) {
+        case N_BLOCK:
+            print_body(pr, n->a);
+            break;
+        case N_EMPTY:
+            pr_str(pr, ";");
+            break;
+        case N_EXPR:
+            if (needs_statement_parens(n->a)) {
+                pr_str(pr, "(");
+                print_expr(pr, n->a, 1);
+                pr_str(pr, ")");
+            } else {
+                print_expr(pr, n->a, 1);
+            }
+            pr->semicolon = 1;
+            break;
+        case N_VAR:
+            print_var(pr, n);
+            pr->semicolon = 1;
+            break;
+        case N_FUNC:
+            print_function(pr, n, 0);
+            break;
+        case N_CLASS:
+            print_class(pr, n);
+            break;
+        case N_RETURN:
+        case N_THROW:
+            pr_str(pr, n->kind == N_RETURN ? "return" : "throw");
+            if (n->a) print_expr(pr, n->a, 1);
+            pr->semicolon = 1;
+            break;
+        case N_IF:
+            pr_str(pr, "if(");
+            print_expr(pr, n->a, 1);
+            pr_str(pr, ")");
+            if (n->c && ends_in_open_if(n->b)) {
+                pr_str(pr, "{");
+                print_stmt(pr, n->b);
+                pr_close(pr);
+            } else {
+                print_sub(pr, n->b);
+            }
+            if (n->c) {
+                pr_str(pr, "else");
+                print_sub(pr, n->c);
+            }
+            break;
+        case N_FOR:
+            pr_str(pr, "for(");
+            if (n->a) {
+                pr->no_in = 1;
+                if (n->a->kind == N_VAR) print_var(pr, n->a);
+                else print_expr(pr, n->a, 1);
+                pr->no_in = 0;
+            }
+            pr_str(pr, ";");
+            if (n->b) print_expr(pr, n->b, 1);
+            pr_str(pr, ";");
+            if (n->c) print_expr(pr, n->c, 1);
+            pr_str(pr, ")");
+            print_sub(pr, n->d);
+            break;
+        case N_FOR_IN:
+        case N_FOR_OF:
+            pr_str(pr, n->flags & F_AWAIT ? "for await(" : "for(");
+            if (n->a->kind == N_VAR) print_var(pr, n->a);
+            else print_expr(pr, n->a, 17);
+            pr_str(pr, n->kind == N_FOR_IN ? "in" : "of");
+            print_expr(pr, n->b, n->kind == N_FOR_IN ? 1 : 2);
+            pr_str(pr, ")");
+            print_sub(pr, n->d);
+            break;
+        case N_WHILE:
+        case N_WITH:
+            pr_str(pr, n->kind == N_WHILE ? "while(" : "with(");
+            print_expr(pr, n->a, 1);
+            pr_str(pr, ")");
+            print_sub(pr, n->d);
+            break;
+        case N_DO:
+            pr_str(pr, "do");
+            print_sub(pr, n->d);
+            pr_str(pr, "while(");
+            print_expr(pr, n->a, 1);
+            pr_str(pr, ")");
+            pr->semicolon = 1;
+            break;
+        case N_BREAK:
+        case N_CONTINUE:
+            pr_str(pr, n->kind == N_BREAK ? "break" : "continue");
+            if (n->str) pr_write(pr, n->str, n->len);
+            pr->semicolon = 1;
+            break;
+        case N_LABEL:
+            pr_write(pr, n->str, n->len);
+            pr_str(pr, ":");
+            print_sub(pr, n->a);
+            break;
+        case N_SWITCH:
+            pr_str(pr, "switch(");
+            print_expr(pr, n->a, 1);
+            pr_str(pr, "){");
+            for (const Node *k = n->b; k; k = k->next) {
+                if (k->a) {
+                    pr_str(pr, "case");
+                    print_expr(pr, k->a, 1);
+                } else {
+                    pr_str(pr, "default");
+                }
+                pr_str(pr, ":");
+                print_stmts(pr, k->b);
+            }
+            pr_close(pr);
+            break;
+        case N_TRY:
+            pr_str(pr, "try");
+            print_body(pr, n->a->a);
+            if (n->c) {
+                pr_str(pr, "catch");
+                if (n->b) {
+                    pr_str(pr, "(");
+                    print_expr(pr, n->b, 2);
+                    pr_str(pr, ")");
+                }
+                print_body(pr, n->c->a);
+            }
+            if (n->d) {
+                pr_str(pr, "finally");
+                print_body(pr, n->d->a);
+            }
+            break;
+        case N_DEBUGGER:
+            pr_str(pr, "debugger");
+            pr->semicolon = 1;
+            break;
+        case N_EXPORT:
+            pr_str(pr, n->flags & F_DEFAULT ? "export default" : "export");
+            if (n->a->kind == N_VAR) {
+                print_var(pr, n->a);
+                pr->semicolon = 1;
+            } else if ((n->a->kind == N_FUNC || n->a->kind == N_CLASS) && (n->a->flags & F_DECL)) {
+                print_stmt(pr, n->a);
+            } else {
+                int wrap = needs_statement_parens(n->a);
+                if (wrap) pr_str(pr, "(");
+                print_expr(pr, n->a, 2);
+                if (wrap) pr_str(pr, ")");
+                pr->semicolon = 1;
+            }
+            break;
+        case N_RAW:
+            for (uint32_t i = n->u.span[0]; i < n->u.span[1]; i++) {
+                const Tok *t = &pr->p->toks[i];
+                pr_write(pr, tok_text(pr->p, t), t->len);
+            }
+            pr->semicolon = 1;
+            break;
+    }
+}
 
-        putchar(*p);
-        prev_char = *p;
-        if (!isspace((unsigned char)*p)) {
-            prev_non_space = *p;
+/* Parse, transform and print; returns 0 on success, 1 after reporting an error */
+static int terser_ast(const char *src, size_t n, int compress, int mangle_names) {
+    Parser p;
+    memset(&p, 0, sizeof(p));
+    p.src = src;
+    p.n = n;
+    Node *program = NULL;
+    if (tokenize(&p) && (program = parse_program(&p)) && resolve(&p)) {
+        if (compress) {
+            Compressor c = {&p};
+            program->a = cs_list(&c, program->a, 0);
+        }
+        if (mangle_names) mangle(&p);
+    }
+    if (p.error[0]) {
+        size_t line = 1, col = 1;
+        for (size_t i = 0; i < p.error_pos && i < n; i++) {
+            if (src[i] == '\n') {
+                line++;
+                col = 1;
+            } else {
+                col++;
+            }
         }
+        fprintf(stderr, "Error: line %zu, column %zu: %s\n", line, col, p.error);
+    } else {
+        Printer pr;
+        memset(&pr, 0, sizeof(pr));
+        pr.p = &p;
+        pr.compress = compress;
+        if (p.hashbang) {
+            out_write(p.hashbang, p.hashbang_len);
+            out_char('\n');
+        }
+        print_stmts(&pr, program->a);
+        out_char('\n');
     }
+    int rc = p.error[0] ? 1 : 0;
+    free(p.toks);
+    free(p.refs);
+    free(p.names.slots);
+    arena_free(&p.arena);
+    return rc;
 }
 
 int main(int argc, char **argv) {
-    const char *input = (argc >= 2) ? argv[1] : NULL;
+    const char *input = NULL;
+    int compress = 0, mangle_names = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--compress") == 0) compress = 1;
+        else if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--mangle") == 0) mangle_names = 1;
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input = argv[++i];
+        else if (!input) input = argv[i];
+    }
     char *stdin_buf = NULL;
     if (!input) {
         stdin_buf = read_all_stdin();
         if (!stdin_buf) {
-            fprintf(stderr, "Usage: terser <javascript-code>\nOr pipe input via stdin.\n");
+            fprintf(stderr, "Usage: terser [-c|--compress] [-m|--mangle] <javascript-code>\nOr pipe input via stdin.\n");
             return 1;
         }
         input = stdin_buf;
     }
 
-    minify_js(input);
-    printf("\n");
+    int rc;
+    if (compress || mangle_names) {
+        rc = terser_ast(input, strlen(input), compress, mangle_names);
+        out_flush();
+        free(stdin_buf);
+        return rc;
+    }
 
+    rc = minify_js(input, strlen(input));
     free(stdin_buf);
+    if (rc != 0) {
+        out_flush();
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    out_char('\n');
+    out_flush();
     return 0;
 }
@@ -1,257 +1,880 @@
 /**
  * toml2json - Convert TOML to JSON
  * Usage: toml2json <toml-data>
- * Note: Simplified TOML parser supporting basic key-value pairs and sections
+ *
+ * Parses TOML 1.0 into a table model: every table, array and value is a
+ * node in an arena, children are kept in document order, and a single
+ * hash index keyed by (parent table, key) makes every key, dotted key and
+ * [header] lookup O(1), so there are no caps on keys or sections and
+ * large lock files (Cargo.lock, poetry.lock) convert in linear time.
+ * Strings without escapes point into the input instead of being copied.
+ *
+ * Supported: bare, quoted and dotted keys; [tables] and [[arrays of
+ * tables]]; basic, literal and multi-line strings with all escapes;
+ * decimal, hex, octal and binary integers; floats (inf and nan come out as
+ * strings, since JSON has no such numbers); booleans; dates and times
+ * (as strings); arrays and inline tables of any nesting. Redefinitions
+ * (duplicate keys, a table defined twice, extending an inline table) are
+ * errors, reported with their line.
+ *
+ * The JSON is written straight from the tree to buffered stdout.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
 #include "../stdin_read.h"
+#include "../line_index.h"
+#include "../stdout_write.h"
 
-#define MAX_SECTIONS 100
-#define MAX_KEYS 1000
-#define MAX_LINE 4096
+/* ---- Arena ---- */
+
+#define ARENA_BLOCK (256 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+static void *arena_alloc(Arena *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    ArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = (ArenaBlock *)malloc(sizeof(ArenaBlock) + cap);
+        if (!b) return NULL;
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+static void arena_free(Arena *a) {
+    while (a->head) {
+        ArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
+}
+
+/* ---- Table model ---- */
+
+enum { T_STRING, T_INTEGER, T_FLOAT, T_BOOL, T_DATETIME, T_ARRAY, T_TABLE };
+
+/* How a table came to exist, for the redefinition rules */
+#define DEF_IMPLICIT 1      /* Parent of a [header]; may still get its own header */
+#define DEF_HEADER   2      /* Defined by [header], or an element of [[header]] */
+#define DEF_DOTTED   4      /* Created by a dotted key */
+#define DEF_FROZEN   8      /* Inline table or array value: closed to additions */
+#define DEF_AOT      16     /* Array created by [[header]] */
+
+typedef struct TomlNode {
+    int type;
+    int flags;
+    const char *key;
+    size_t key_len;
+    const char *text;       /* String value, or number/date text as written to JSON */
+    size_t len;
+    struct TomlNode *first, *last, *next;
+    size_t count;
+} TomlNode;
+
+/* Open-addressing index of table members by (parent, key) */
+typedef struct {
+    const TomlNode *parent;
+    TomlNode *node;
+    uint64_t hash;
+} KeySlot;
 
 typedef struct {
-    char section[256];
-    char key[256];
-    char value[4096];
-    int value_type;  // 0=string, 1=number, 2=bool, 3=array
-} TOMLEntry;
-
-static TOMLEntry entries[MAX_KEYS];
-static int entry_count = 0;
-static char current_section[256] = "";
-
-// Trim whitespace
-char* trim(char *str) {
-    while (isspace((unsigned char)*str)) str++;
-    if (*str == 0) return str;
-
-    char *end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end)) end--;
-    *(end + 1) = '\0';
-
-    return str;
-}
-
-// Escape string for JSON
-void print_json_string(const char *str) {
-    putchar('"');
-    for (const char *p = str; *p; p++) {
-        switch (*p) {
-            case '"': printf("\\\""); break;
-            case '\\': printf("\\\\"); break;
-            case '\n': printf("\\n"); break;
-            case '\r': printf("\\r"); break;
-            case '\t': printf("\\t"); break;
-            default:
-                if ((unsigned char)*p < 32) {
-                    printf("\\u%04x", (unsigned char)*p);
-                } else {
-                    putchar(*p);
-                }
+    KeySlot *slots;
+    size_t cap, count;
+} KeyIndex;
+
+static uint64_t key_hash(const TomlNode *parent, const char *key, size_t len) {
+    uint64_t h = line_hash(key, len) ^ ((uint64_t)(uintptr_t)parent * 0x9e3779b97f4a7c15ULL);
+    return h ^ (h >> 31);
+}
+
+static KeySlot *index_slot(KeyIndex *ix, const TomlNode *parent, uint64_t h, const char *key, size_t len) {
+    size_t mask = ix->cap - 1;
+    for (size_t i = (size_t)h & mask;; i = (i + 1) & mask) {
+        KeySlot *s = &ix->slots[i];
+        if (!s->node) return s;
+        if (s->hash == h && s->parent == parent && s->node->key_len == len &&
+            memcmp(s->node->key, key, len) == 0) {
+            return s;
         }
     }
-    putchar('"');
 }
 
-// Parse TOML value
-int parse_value(const char *value, char *out, int *type) {
-    const char *v = trim((char*)value);
+static int index_grow(KeyIndex *ix) {
+    size_t cap = ix->cap ? ix->cap * 2 : 1024;
+    KeySlot *slots = (KeySlot *)calloc(cap, sizeof(KeySlot));
+    if (!slots) return 0;
+    KeyIndex grown = {slots, cap, ix->count};
+    for (size_t i = 0; i < ix->cap; i++) {
+        KeySlot *s = &ix->slots[i];
+        if (!s->node) continue;
+        *index_slot(&grown, s->parent, s->hash, s->node->key, s->node->key_len) = *s;
+    }
+    free(ix->slots);
+    *ix = grown;
+    return 1;
+}
 
-    // Boolean
-    if (strcmp(v, "true") == 0 || strcmp(v, "false") == 0) {
-        strcpy(out, v);
-        *type = 2;
+/* ---- Parser ---- */
+
+#define MAX_NESTING 512
+
+typedef struct {
+    const char *src;
+    size_t len, pos;
+    size_t line;
+    Arena arena;
+    KeyIndex index;
+    TomlNode *root;
+    TomlNode *current;      /* Table that key/value lines go into */
+    int depth;
+    char error[160];
+    size_t error_line;
+} TomlParser;
+
+static int fail(TomlParser *p, const char *msg) {
+    if (!p->error[0]) {
+        snprintf(p->error, sizeof(p->error), "%s", msg);
+        p->error_line = p->line;
+    }
+    return 0;
+}
+
+static TomlNode *new_node(TomlParser *p, int type) {
+    TomlNode *n = (TomlNode *)arena_alloc(&p->arena, sizeof(TomlNode));
+    if (!n) {
+        fail(p, "out of memory");
+        return NULL;
+    }
+    memset(n, 0, sizeof(*n));
+    n->type = type;
+    return n;
+}
+
+static void append_child(TomlNode *parent, TomlNode *child) {
+    if (parent->last) parent->last->next = child;
+    else parent->first = child;
+    parent->last = child;
+    parent->count++;
+}
+
+static TomlNode *find_key(TomlParser *p, const TomlNode *table, const char *key, size_t len) {
+    if (p->index.count == 0) return NULL;
+    return index_slot(&p->index, table, key_hash(table, key, len), key, len)->node;
+}
+
+/* Add child under key to table; the caller has checked the key is new */
+static int add_key(TomlParser *p, TomlNode *table, TomlNode *child, const char *key, size_t len) {
+    if ((p->index.count + 1) * 4 > p->index.cap * 3 && !index_grow(&p->index)) return fail(p, "out of memory");
+    child->key = key;
+    child->key_len = len;
+    uint64_t h = key_hash(table, key, len);
+    KeySlot *s = index_slot(&p->index, table, h, key, len);
+    s->parent = table;
+    s->node = child;
+    s->hash = h;
+    p->index.count++;
+    append_child(table, child);
+    return 1;
+}
+
+static int at_end(const TomlParser *p) {
+    return p->pos >= p->len;
+}
+
+static char peek(const TomlParser *p) {
+    return p->pos < p->len ? p->src[p->pos] : '\0';
+}
+
+static int starts_with(const TomlParser *p, const char *s) {
+    size_t n = strlen(s);
+    return p->len - p->pos >= n && memcmp(p->src + p->pos, s, n) == 0;
+}
+
+static void skip_ws(TomlParser *p) {
+    while (p->pos < p->len && (p->src[p->pos] == ' ' || p->src[p->pos] == '\t')) p->pos++;
+}
+
+static int skip_comment(TomlParser *p) {
+    if (peek(p) != '#') return 1;
+    while (p->pos < p->len && p->src[p->pos] != '\n') {
+        unsigned char c = (unsigned char)p->src[p->pos];
+        if ((c < 0x20 && c != '\t' && c != '\r') || c == 0x7f) return fail(p, "control character in comment");
+        p->pos++;
+    }
+    return 1;
+}
+
+/* Consume a line ending (LF or CRLF); 0 if there is none here */
+static int eat_newline(TomlParser *p) {
+    if (peek(p) == '\n') {
+        p->pos++;
+        p->line++;
         return 1;
     }
+    if (peek(p) == '\r' && p->pos + 1 < p->len && p->src[p->pos + 1] == '\n') {
+        p->pos += 2;
+        p->line++;
+        return 1;
+    }
+    return 0;
+}
 
-    // Number (int or float)
-    if ((*v == '-' || *v == '+' || isdigit((unsigned char)*v))) {
-        int is_number = 1;
-        int has_dot = 0;
-        const char *p = v;
-        if (*p == '-' || *p == '+') p++;
-
-        while (*p) {
-            if (*p == '.') {
-                if (has_dot) { is_number = 0; break; }
-                has_dot = 1;
-            } else if (*p == 'e' || *p == 'E') {
-                p++;
-                if (*p == '+' || *p == '-') p++;
-                continue;
-            } else if (!isdigit((unsigned char)*p) && *p != '_') {
-                is_number = 0;
-                break;
-            }
-            p++;
+/* Whitespace, comments and newlines, as allowed inside arrays */
+static int skip_ws_lines(TomlParser *p) {
+    for (;;) {
+        skip_ws(p);
+        if (!skip_comment(p)) return 0;
+        if (!eat_newline(p)) return 1;
+    }
+}
+
+/* ---- Strings ---- */
+
+static int is_bare_key_char(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static size_t utf8_encode(uint32_t cp, char *out) {
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) { out[0] = (char)(0xc0 | (cp >> 6)); out[1] = (char)(0x80 | (cp & 0x3f)); return 2; }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xe0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[2] = (char)(0x80 | (cp & 0x3f));
+        return 3;
+    }
+    out[0] = (char)(0xf0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    out[3] = (char)(0x80 | (cp & 0x3f));
+    return 4;
+}
+
+/*
+ * Parse a string at the cursor: "basic", 'literal', """multi-line basic"""
+ * or '''multi-line literal'''. The value points into the input when it
+ * needed no decoding, and into the arena otherwise.
+ */
+static int parse_string(TomlParser *p, int allow_multiline, const char **out, size_t *out_len) {
+    char quote = peek(p);
+    int literal = quote == '\'';
+    int multiline = starts_with(p, literal ? "'''" : "\"\"\"");
+    if (multiline && !allow_multiline) return fail(p, "multi-line strings cannot be keys");
+    p->pos += multiline ? 3 : 1;
+    if (multiline) eat_newline(p);  // A newline right after the opening is trimmed
+
+    // Find the end first: the decoded value is never longer than that
+    size_t start = p->pos, end = p->pos;
+    for (size_t i = p->pos; ; i++) {
+        if (i >= p->len) return fail(p, "unterminated string");
+        char c = p->src[i];
+        if (c == '\\' && !literal) {
+            i++;
+            continue;
+        }
+        if (c == '\n' && !multiline) return fail(p, "newline in a single-line string");
+        if (c != quote) continue;
+        if (!multiline) {
+            end = i;
+            p->pos = i + 1;
+            break;
         }
+        size_t run = 0;
+        while (i + run < p->len && p->src[i + run] == quote) run++;
+        if (run >= 3) {
+            // Up to two quotes may sit right before the closing delimiter
+            if (run > 5) return fail(p, "too many quotes at the end of a multi-line string");
+            end = i + run - 3;
+            p->pos = i + run;
+            break;
+        }
+        i += run - 1;
+    }
 
-        if (is_number) {
-            // Remove underscores
-            char *o = out;
-            for (const char *i = v; *i; i++) {
-                if (*i != '_') *o++ = *i;
+    int plain = 1;
+    for (size_t i = start; i < end; i++) {
+        unsigned char c = (unsigned char)p->src[i];
+        if (c == '\\' && !literal) plain = 0;
+        if (c == '\r') plain = 0;
+        if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r') || c == 0x7f) {
+            return fail(p, "control character in string");
+        }
+        if (c == '\n') p->line++;
+    }
+    if (plain) {
+        *out = p->src + start;
+        *out_len = end - start;
+        return 1;
+    }
+
+    char *dst = (char *)arena_alloc(&p->arena, end - start + 1);
+    if (!dst) return fail(p, "out of memory");
+    size_t n = 0;
+    for (size_t i = start; i < end; i++) {
+        char c = p->src[i];
+        if (c == '\r' && i + 1 < end && p->src[i + 1] == '\n') continue;
+        if (c == '\r') return fail(p, "bare carriage return in string");
+        if (c != '\\' || literal) {
+            dst[n++] = c;
+            continue;
+        }
+        char e = ++i < end ? p->src[i] : '\0';
+        int digits = 0;
+        switch (e) {
+        case 'b': dst[n++] = '\b'; break;
+        case 't': dst[n++] = '\t'; break;
+        case 'n': dst[n++] = '\n'; break;
+        case 'f': dst[n++] = '\f'; break;
+        case 'r': dst[n++] = '\r'; break;
+        case 'e': dst[n++] = 0x1b; break;
+        case '"': dst[n++] = '"'; break;
+        case '\\': dst[n++] = '\\'; break;
+        case 'x': digits = 2; break;
+        case 'u': digits = 4; break;
+        case 'U': digits = 8; break;
+        default: {
+            // Line-ending backslash: drop the newline and following whitespace
+            size_t j = i;
+            while (j < end && (p->src[j] == ' ' || p->src[j] == '\t')) j++;
+            if (!multiline || j >= end || (p->src[j] != '\n' && p->src[j] != '\r')) {
+                return fail(p, "invalid escape in string");
             }
-            *o = '\0';
-            *type = 1;
-            return 1;
+            while (j < end && (p->src[j] == ' ' || p->src[j] == '\t' || p->src[j] == '\n' || p->src[j] == '\r')) {
+                j++;
+            }
+            i = j - 1;
+            break;
+        }
+        }
+        if (digits) {
+            uint32_t cp = 0;
+            for (int k = 0; k < digits; k++) {
+                int h = i + 1 < end ? hex_digit(p->src[i + 1]) : -1;
+                if (h < 0) return fail(p, "invalid unicode escape");
+                cp = cp * 16 + (uint32_t)h;
+                i++;
+            }
+            if (cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) return fail(p, "invalid unicode scalar value");
+            n += utf8_encode(cp, dst + n);
         }
     }
+    *out = dst;
+    *out_len = n;
+    return 1;
+}
 
-    // Array
-    if (*v == '[') {
-        strcpy(out, v);
-        *type = 3;
-        return 1;
+/* One part of a key: bare or quoted */
+static int parse_simple_key(TomlParser *p, const char **key, size_t *len) {
+    char c = peek(p);
+    if (c == '"' || c == '\'') return parse_string(p, 0, key, len);
+    size_t start = p->pos;
+    while (p->pos < p->len && is_bare_key_char(p->src[p->pos])) p->pos++;
+    if (p->pos == start) return fail(p, "expected a key");
+    *key = p->src + start;
+    *len = p->pos - start;
+    return 1;
+}
+
+#define MAX_KEY_PARTS 128
+
+typedef struct {
+    const char *part[MAX_KEY_PARTS];
+    size_t len[MAX_KEY_PARTS];
+    int count;
+} DottedKey;
+
+static int parse_key(TomlParser *p, DottedKey *k) {
+    k->count = 0;
+    for (;;) {
+        skip_ws(p);
+        if (k->count == MAX_KEY_PARTS) return fail(p, "key has too many parts");
+        if (!parse_simple_key(p, &k->part[k->count], &k->len[k->count])) return 0;
+        k->count++;
+        skip_ws(p);
+        if (peek(p) != '.') return 1;
+        p->pos++;
     }
+}
+
+/* ---- Values ---- */
+
+static int parse_value(TomlParser *p, TomlNode **out);
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* Digits with single underscores between them; returns the digit count */
+static size_t scan_digits(const char *s, size_t n, size_t *i, int (*ok)(char)) {
+    size_t digits = 0;
+    while (*i < n) {
+        if (ok(s[*i])) {
+            digits++;
+            (*i)++;
+        } else if (s[*i] == '_' && digits > 0 && *i + 1 < n && ok(s[*i + 1])) {
+            (*i)++;
+        } else {
+            break;
+        }
+    }
+    return digits;
+}
+
+static int is_hex(char c) { return hex_digit(c) >= 0; }
+static int is_oct(char c) { return c >= '0' && c <= '7'; }
+static int is_bin(char c) { return c == '0' || c == '1'; }
 
-    // String (quoted or bare)
-    if (*v == '"' || *v == '\'') {
-        char quote = *v;
-        v++;
-        char *o = out;
-        while (*v && *v != quote) {
-            if (*v == '\\' && *(v+1)) {
-                v++;
-                switch (*v) {
-                    case 'n': *o++ = '\n'; break;
-                    case 'r': *o++ = '\r'; break;
-                    case 't': *o++ = '\t'; break;
-                    case '\\': *o++ = '\\'; break;
-                    case '"': *o++ = '"'; break;
-                    case '\'': *o++ = '\''; break;
-                    default: *o++ = *v;
-                }
+static int looks_like_datetime(const TomlParser *p) {
+    const char *s = p->src + p->pos;
+    size_t n = p->len - p->pos;
+    int date = n >= 5 && is_digit(s[0]) && is_digit(s[1]) && is_digit(s[2]) && is_digit(s[3]) && s[4] == '-';
+    int time = n >= 3 && is_digit(s[0]) && is_digit(s[1]) && s[2] == ':';
+    return date || time;
+}
+
+/* Offset/local date-times, dates and times, kept as written (a space separator becomes 'T') */
+static int parse_datetime(TomlParser *p, TomlNode *n) {
+    size_t start = p->pos;
+    while (p->pos < p->len) {
+        char c = p->src[p->pos];
+        if (is_digit(c) || c == '-' || c == ':' || c == '.' || c == '+' || c == 'T' || c == 't' ||
+            c == 'Z' || c == 'z') {
+            p->pos++;
+        } else if (c == ' ' && p->pos - start == 10 && p->pos + 1 < p->len && is_digit(p->src[p->pos + 1])) {
+            p->pos++;
+        } else {
+            break;
+        }
+    }
+    size_t len = p->pos - start;
+    const char *s = p->src + start;
+    // Validate the shape: date, time, or date + time (+ offset)
+    size_t i = 0;
+    int has_date = 0, has_time = 0;
+    if (len >= 10 && s[4] == '-' && s[7] == '-') {
+        for (size_t k = 0; k < 10; k++) {
+            if (k != 4 && k != 7 && !is_digit(s[k])) return fail(p, "invalid date");
+        }
+        int month = (s[5] - '0') * 10 + (s[6] - '0'), day = (s[8] - '0') * 10 + (s[9] - '0');
+        if (month < 1 || month > 12 || day < 1 || day > 31) return fail(p, "invalid date");
+        has_date = 1;
+        i = 10;
+        if (i < len) {
+            if (s[i] != 'T' && s[i] != 't' && s[i] != ' ') return fail(p, "invalid date-time");
+            i++;
+        }
+    }
+    if (i < len) {
+        if (len - i < 8 || !is_digit(s[i]) || !is_digit(s[i + 1]) || s[i + 2] != ':' || !is_digit(s[i + 3]) ||
+            !is_digit(s[i + 4]) || s[i + 5] != ':' || !is_digit(s[i + 6]) || !is_digit(s[i + 7])) {
+            return fail(p, "invalid time");
+        }
+        int hour = (s[i] - '0') * 10 + (s[i + 1] - '0'), minute = (s[i + 3] - '0') * 10 + (s[i + 4] - '0');
+        int second = (s[i + 6] - '0') * 10 + (s[i + 7] - '0');
+        if (hour > 23 || minute > 59 || second > 60) return fail(p, "invalid time");
+        has_time = 1;
+        i += 8;
+        if (i < len && s[i] == '.') {
+            size_t frac = ++i;
+            while (i < len && is_digit(s[i])) i++;
+            if (i == frac) return fail(p, "invalid fractional seconds");
+        }
+        if (i < len && has_date) {
+            if (s[i] == 'Z' || s[i] == 'z') {
+                i++;
+            } else if ((s[i] == '+' || s[i] == '-') && len - i == 6 && is_digit(s[i + 1]) && is_digit(s[i + 2]) &&
+                       s[i + 3] == ':' && is_digit(s[i + 4]) && is_digit(s[i + 5])) {
+                i += 6;
             } else {
-                *o++ = *v;
+                return fail(p, "invalid time offset");
             }
-            v++;
         }
-        *o = '\0';
-        *type = 0;
+    }
+    if (i != len || (!has_date && !has_time)) return fail(p, "invalid date-time");
+
+    char *text = (char *)arena_alloc(&p->arena, len);
+    if (!text) return fail(p, "out of memory");
+    memcpy(text, s, len);
+    if (has_date && has_time && text[10] == ' ') text[10] = 'T';
+    n->type = T_DATETIME;
+    n->text = text;
+    n->len = len;
+    return 1;
+}
+
+static int parse_number(TomlParser *p, TomlNode *n) {
+    const char *s = p->src + p->pos;
+    size_t avail = p->len - p->pos, i = 0;
+    int negative = 0;
+    if (i < avail && (s[i] == '+' || s[i] == '-')) {
+        negative = s[i] == '-';
+        i++;
+    }
+
+    if (avail - i >= 3 && (memcmp(s + i, "inf", 3) == 0 || memcmp(s + i, "nan", 3) == 0)) {
+        n->type = T_FLOAT;
+        n->text = s[i] == 'n' ? "nan" : negative ? "-inf" : "inf";
+        n->len = strlen(n->text);
+        p->pos += i + 3;
         return 1;
     }
 
-    // Bare string (unquoted)
-    strcpy(out, v);
-    *type = 0;
+    if (i == 0 && avail >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'o' || s[1] == 'b')) {
+        int base = s[1] == 'x' ? 16 : s[1] == 'o' ? 8 : 2;
+        int (*ok)(char) = base == 16 ? is_hex : base == 8 ? is_oct : is_bin;
+        i = 2;
+        size_t first = i;
+        if (scan_digits(s, avail, &i, ok) == 0) return fail(p, "invalid integer");
+        uint64_t v = 0;
+        for (size_t k = first; k < i; k++) {
+            if (s[k] == '_') continue;
+            uint64_t d = (uint64_t)hex_digit(s[k]);
+            if (v > (UINT64_C(0x7fffffffffffffff) - d) / (uint64_t)base) return fail(p, "integer out of range");
+            v = v * (uint64_t)base + d;
+        }
+        char buf[24];
+        int len = snprintf(buf, sizeof(buf), "%llu", (unsigned long long)v);
+        char *text = (char *)arena_alloc(&p->arena, (size_t)len);
+        if (!text) return fail(p, "out of memory");
+        memcpy(text, buf, (size_t)len);
+        n->type = T_INTEGER;
+        n->text = text;
+        n->len = (size_t)len;
+        p->pos += i;
+        return 1;
+    }
+
+    size_t int_start = i;
+    size_t int_digits = scan_digits(s, avail, &i, is_digit);
+    if (int_digits == 0) return fail(p, "invalid value");
+    if (int_digits > 1 && s[int_start] == '0') return fail(p, "leading zeros are not allowed");
+    int is_float = 0;
+    if (i < avail && s[i] == '.') {
+        i++;
+        if (scan_digits(s, avail, &i, is_digit) == 0) return fail(p, "invalid float");
+        is_float = 1;
+    }
+    if (i < avail && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        if (i < avail && (s[i] == '+' || s[i] == '-')) i++;
+        if (scan_digits(s, avail, &i, is_digit) == 0) return fail(p, "invalid float exponent");
+        is_float = 1;
+    }
+    if (i < avail && (is_bare_key_char(s[i]) || s[i] == '.')) return fail(p, "invalid value");
+
+    // Written without underscores or a leading '+'
+    char *text = (char *)arena_alloc(&p->arena, i);
+    if (!text) return fail(p, "out of memory");
+    size_t len = 0;
+    for (size_t k = 0; k < i; k++) {
+        if (s[k] == '_' || (k == 0 && s[k] == '+')) continue;
+        text[len++] = s[k];
+    }
+    if (!is_float) {
+        // Range check against int64
+        const char *digits = text + (text[0] == '-');
+        size_t nd = len - (size_t)(text[0] == '-');
+        const char *limit = text[0] == '-' ? "9223372036854775808" : "9223372036854775807";
+        if (nd > 19 || (nd == 19 && memcmp(digits, limit, 19) > 0)) return fail(p, "integer out of range");
+    }
+    n->type = is_float ? T_FLOAT : T_INTEGER;
+    n->text = text;
+    n->len = len;
+    p->pos += i;
     return 1;
 }
 
-// Parse a TOML line
-void parse_line(char *line) {
-    char *l = trim(line);
+static int parse_array(TomlParser *p, TomlNode *arr) {
+    p->pos++;
+    for (;;) {
+        if (!skip_ws_lines(p)) return 0;
+        if (peek(p) == ']') {
+            p->pos++;
+            return 1;
+        }
+        TomlNode *v;
+        if (!parse_value(p, &v)) return 0;
+        append_child(arr, v);
+        if (!skip_ws_lines(p)) return 0;
+        if (peek(p) == ',') {
+            p->pos++;
+        } else if (peek(p) != ']') {
+            return fail(p, at_end(p) ? "unterminated array" : "expected ',' or ']' in array");
+        }
+    }
+}
 
-    // Skip empty lines and comments
-    if (*l == '\0' || *l == '#') return;
+static int set_key_value(TomlParser *p, TomlNode *table, const DottedKey *k, TomlNode *value);
 
-    // Section header
-    if (*l == '[') {
-        char *end = strchr(l, ']');
-        if (end) {
-            *end = '\0';
-            strncpy(current_section, l + 1, sizeof(current_section) - 1);
-            current_section[sizeof(current_section) - 1] = '\0';
+static int parse_inline_table(TomlParser *p, TomlNode *t) {
+    p->pos++;
+    // Newlines and a trailing comma are accepted (TOML 1.1)
+    if (!skip_ws_lines(p)) return 0;
+    if (peek(p) == '}') {
+        p->pos++;
+        return 1;
+    }
+    for (;;) {
+        DottedKey k;
+        if (!parse_key(p, &k)) return 0;
+        if (peek(p) != '=') return fail(p, "expected '=' after a key");
+        p->pos++;
+        skip_ws(p);
+        TomlNode *v;
+        if (!parse_value(p, &v) || !set_key_value(p, t, &k, v)) return 0;
+        if (!skip_ws_lines(p)) return 0;
+        if (peek(p) == '}') {
+            p->pos++;
+            return 1;
+        }
+        if (peek(p) != ',') return fail(p, at_end(p) ? "unterminated inline table" : "expected ',' or '}' in inline table");
+        p->pos++;
+        if (!skip_ws_lines(p)) return 0;
+        if (peek(p) == '}') {
+            p->pos++;
+            return 1;
         }
-        return;
     }
+}
 
-    // Key-value pair
-    char *eq = strchr(l, '=');
-    if (eq && entry_count < MAX_KEYS) {
-        *eq = '\0';
-        char *key = trim(l);
-        char *value = trim(eq + 1);
+static void freeze(TomlNode *n) {
+    n->flags |= DEF_FROZEN;
+}
 
-        strncpy(entries[entry_count].section, current_section, 255);
-        strncpy(entries[entry_count].key, key, 255);
-        parse_value(value, entries[entry_count].value, &entries[entry_count].value_type);
-        entry_count++;
+static int parse_value(TomlParser *p, TomlNode **out) {
+    TomlNode *n = new_node(p, T_STRING);
+    if (!n) return 0;
+    *out = n;
+    char c = peek(p);
+    if (c == '"' || c == '\'') return parse_string(p, 1, &n->text, &n->len);
+    if (c == '[' || c == '{') {
+        if (++p->depth > MAX_NESTING) return fail(p, "values are nested too deeply");
+        n->type = c == '[' ? T_ARRAY : T_TABLE;
+        int ok = c == '[' ? parse_array(p, n) : parse_inline_table(p, n);
+        p->depth--;
+        freeze(n);
+        return ok;
     }
+    if (starts_with(p, "true") && !is_bare_key_char(p->pos + 4 < p->len ? p->src[p->pos + 4] : ' ')) {
+        n->type = T_BOOL;
+        n->text = "true";
+        n->len = 4;
+        p->pos += 4;
+        return 1;
+    }
+    if (starts_with(p, "false") && !is_bare_key_char(p->pos + 5 < p->len ? p->src[p->pos + 5] : ' ')) {
+        n->type = T_BOOL;
+        n->text = "false";
+        n->len = 5;
+        p->pos += 5;
+        return 1;
+    }
+    if (looks_like_datetime(p)) return parse_datetime(p, n);
+    if (is_digit(c) || c == '+' || c == '-' || c == 'i' || c == 'n') return parse_number(p, n);
+    return fail(p, at_end(p) || c == '\n' || c == '\r' ? "missing value" : "invalid value");
 }
 
-// Print JSON output
-void print_json(void) {
-    printf("{\n");
+/* ---- Tables ---- */
+
+/* key = value (k may be dotted) in table */
+static int set_key_value(TomlParser *p, TomlNode *table, const DottedKey *k, TomlNode *value) {
+    TomlNode *t = table;
+    for (int i = 0; i < k->count - 1; i++) {
+        TomlNode *next = find_key(p, t, k->part[i], k->len[i]);
+        if (!next) {
+            next = new_node(p, T_TABLE);
+            if (!next) return 0;
+            next->flags = DEF_DOTTED;
+            if (!add_key(p, t, next, k->part[i], k->len[i])) return 0;
+        } else if (next->type != T_TABLE || (next->flags & (DEF_FROZEN | DEF_HEADER))) {
+            return fail(p, "cannot add keys to a value or table defined elsewhere");
+        }
+        t = next;
+    }
+    const char *key = k->part[k->count - 1];
+    size_t len = k->len[k->count - 1];
+    if (find_key(p, t, key, len)) return fail(p, "duplicate key");
+    return add_key(p, t, value, key, len);
+}
 
-    // Group by section
-    char sections[MAX_SECTIONS][256];
-    int section_count = 0;
+/* [a.b.c] or [[a.b.c]] */
+static int parse_header(TomlParser *p) {
+    int aot = starts_with(p, "[[");
+    p->pos += aot ? 2 : 1;
+    DottedKey k;
+    if (!parse_key(p, &k)) return 0;
+    if (aot ? !starts_with(p, "]]") : peek(p) != ']') return fail(p, "expected ']' to close the table header");
+    p->pos += aot ? 2 : 1;
+
+    TomlNode *t = p->root;
+    for (int i = 0; i < k.count - 1; i++) {
+        TomlNode *next = find_key(p, t, k.part[i], k.len[i]);
+        if (!next) {
+            next = new_node(p, T_TABLE);
+            if (!next) return 0;
+            next->flags = DEF_IMPLICIT;
+            if (!add_key(p, t, next, k.part[i], k.len[i])) return 0;
+        } else if (next->type == T_ARRAY && (next->flags & DEF_AOT)) {
+            // A sub-table of the latest [[element]]
+            next = next->last;
+        } else if (next->type != T_TABLE || (next->flags & DEF_FROZEN)) {
+            return fail(p, "cannot define a table inside a value");
+        }
+        t = next;
+    }
 
-    // Collect unique sections
-    for (int i = 0; i < entry_count; i++) {
-        int found = 0;
-        for (int j = 0; j < section_count; j++) {
-            if (strcmp(sections[j], entries[i].section) == 0) {
-                found = 1;
-                break;
-            }
+    const char *key = k.part[k.count - 1];
+    size_t len = k.len[k.count - 1];
+    TomlNode *existing = find_key(p, t, key, len);
+    if (aot) {
+        if (!existing) {
+            existing = new_node(p, T_ARRAY);
+            if (!existing) return 0;
+            existing->flags = DEF_AOT;
+            if (!add_key(p, t, existing, key, len)) return 0;
+        } else if (existing->type != T_ARRAY || !(existing->flags & DEF_AOT)) {
+            return fail(p, "cannot append to a key that is not an array of tables");
         }
-        if (!found && section_count < MAX_SECTIONS) {
-            strcpy(sections[section_count++], entries[i].section);
+        TomlNode *elem = new_node(p, T_TABLE);
+        if (!elem) return 0;
+        elem->flags = DEF_HEADER;
+        append_child(existing, elem);
+        p->current = elem;
+        return 1;
+    }
+    if (!existing) {
+        existing = new_node(p, T_TABLE);
+        if (!existing) return 0;
+        if (!add_key(p, t, existing, key, len)) return 0;
+    } else if (existing->type != T_TABLE || (existing->flags & ~DEF_IMPLICIT)) {
+        return fail(p, "table is already defined");
+    }
+    existing->flags = DEF_HEADER;
+    p->current = existing;
+    return 1;
+}
+
+static int parse_document(TomlParser *p) {
+    p->root = new_node(p, T_TABLE);
+    if (!p->root) return 0;
+    p->current = p->root;
+    p->line = 1;
+    if (starts_with(p, "\xef\xbb\xbf")) p->pos += 3;
+
+    while (!at_end(p)) {
+        skip_ws(p);
+        char c = peek(p);
+        if (c == '[') {
+            if (!parse_header(p)) return 0;
+        } else if (c != '#' && c != '\n' && c != '\r' && !at_end(p)) {
+            DottedKey k;
+            if (!parse_key(p, &k)) return 0;
+            if (peek(p) != '=') return fail(p, "expected '=' after a key");
+            p->pos++;
+            skip_ws(p);
+            TomlNode *v;
+            if (!parse_value(p, &v) || !set_key_value(p, p->current, &k, v)) return 0;
         }
+        skip_ws(p);
+        if (!skip_comment(p)) return 0;
+        if (!eat_newline(p) && !at_end(p)) return fail(p, "expected a newline after the value");
     }
+    return 1;
+}
 
-    int first_section = 1;
-    for (int s = 0; s < section_count; s++) {
-        if (!first_section) printf(",\n");
-        first_section = 0;
-
-        if (sections[s][0]) {
-            // Named section
-            printf("  ");
-            print_json_string(sections[s]);
-            printf(": {\n");
-
-            int first_key = 1;
-            for (int i = 0; i < entry_count; i++) {
-                if (strcmp(entries[i].section, sections[s]) == 0) {
-                    if (!first_key) printf(",\n");
-                    first_key = 0;
-
-                    printf("    ");
-                    print_json_string(entries[i].key);
-                    printf(": ");
-
-                    switch (entries[i].value_type) {
-                        case 0: print_json_string(entries[i].value); break;
-                        case 1:
-                        case 2:
-                        case 3: printf("%s", entries[i].value); break;
-                    }
-                }
+/* ---- JSON output ---- */
+
+static void write_json_string(const char *s, size_t n) {
+    out_char('"');
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        switch (c) {
+        case '"': out_str("\\\""); break;
+        case '\\': out_str("\\\\"); break;
+        case '\n': out_str("\\n"); break;
+        case '\r': out_str("\\r"); break;
+        case '\t': out_str("\\t"); break;
+        case '\b': out_str("\\b"); break;
+        case '\f': out_str("\\f"); break;
+        default:
+            if (c < 0x20 || c == 0x7f) {
+                out_str("\\u00");
+                out_char(out_hex_digits[c >> 4]);
+                out_char(out_hex_digits[c & 15]);
+            } else {
+                out_char((char)c);
             }
+        }
+    }
+    out_char('"');
+}
 
-            printf("\n  }");
-        } else {
-            // Root level keys
-            int first_key = 1;
-            for (int i = 0; i < entry_count; i++) {
-                if (entries[i].section[0] == '\0') {
-                    if (!first_key) printf(",\n");
-                    first_key = 0;
-
-                    printf("  ");
-                    print_json_string(entries[i].key);
-                    printf(": ");
-
-                    switch (entries[i].value_type) {
-                        case 0: print_json_string(entries[i].value); break;
-                        case 1:
-                        case 2:
-                        case 3: printf("%s", entries[i].value); break;
-                    }
-                }
-            }
+static void write_indent(int depth) {
+    for (int i = 0; i < depth; i++) out_str("  ");
+}
+
+static void write_json(const TomlNode *n, int depth) {
+    switch (n->type) {
+    case T_STRING:
+    case T_DATETIME:
+        write_json_string(n->text, n->len);
+        return;
+    case T_FLOAT:
+        if (n->text[0] == 'n' || n->text[n->len - 1] == 'f') {
+            write_json_string(n->text, n->len);
+            return;
         }
+        out_write(n->text, n->len);
+        return;
+    case T_INTEGER:
+    case T_BOOL:
+        out_write(n->text, n->len);
+        return;
     }
 
-    printf("\n}\n");
+    int table = n->type == T_TABLE;
+    if (!n->first) {
+        out_str(table ? "{}" : "[]");
+        return;
+    }
+    out_str(table ? "{\n" : "[\n");
+    for (const TomlNode *c = n->first; c; c = c->next) {
+        write_indent(depth + 1);
+        if (table) {
+            write_json_string(c->key, c->key_len);
+            out_str(": ");
+        }
+        write_json(c, depth + 1);
+        out_str(c->next ? ",\n" : "\n");
+    }
+    write_indent(depth);
+    out_char(table ? '}' : ']');
 }
 
 int main(int argc, char **argv) {
@@ -266,17 +889,23 @@ int main(int argc, char **argv) {
         input = stdin_buf;
     }
 
-    char *data = strdup(input);
-    char *line = strtok(data, "\n");
-
-    while (line) {
-        parse_line(line);
-        line = strtok(NULL, "\n");
+    TomlParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.src = input;
+    parser.len = strlen(input);
+
+    int status = 0;
+    if (parse_document(&parser)) {
+        write_json(parser.root, 0);
+        out_char('\n');
+    } else {
+        fprintf(stderr, "Error: line %zu: %s\n", parser.error_line, parser.error);
+        status = 1;
     }
 
-    free(data);
-    print_json();
-
+    out_flush();
+    free(parser.index.slots);
+    arena_free(&parser.arena);
     free(stdin_buf);
-    return 0;
+    return status;
 }
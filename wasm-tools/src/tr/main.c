@@ -1,73 +1,388 @@
 /**
- * tr - Translate or delete characters
- * Usage: tr [-d] SET1 [SET2] <text>
- * Options: -d (delete characters in SET1)
+ * tr - Translate, delete or squeeze characters
+ * Usage: tr [-c] [-d] [-s] SET1 [SET2] <text>
+ * Options: -c (use the complement of SET1), -d (delete characters in SET1),
+ *          -s (squeeze runs of a character of the last set given into one)
+ * Sets: plain characters, escapes (\n \t \\ \NNN octal, ...), ranges (a-z),
+ *       classes ([:alpha:] [:digit:] [:upper:] [:lower:] [:space:] ...),
+ *       [=c=], and in SET2 the repeats [c*n] and [c*] (fill to SET1's
+ *       length). A short SET2 is padded with its last character.
+ * Long forms --set1, --set2, --delete, --squeeze and --complement are
+ * accepted as passed by the tool registry.
+ *
+ * Both sets are compiled once into 256-entry tables: the translation of
+ * every byte, and which bytes are deleted or squeezed. Input is then
+ * mapped 16 bytes at a time. With simd128 each 16-byte row of the table
+ * that is not the identity is applied with one i8x16.swizzle, indexed by
+ * the low nibble and zero for bytes from other rows, so case conversion
+ * costs two lookups per block and no branches. Blocks holding a byte to
+ * delete or squeeze take the byte-at-a-time path.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include <stdint.h>
+#include <ctype.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
+
+#define USAGE "Usage: tr [-c] [-d] [-s] SET1 [SET2] <text>\n"
+
+/* Longest expanded set: repeats beyond this are cut off */
+#define TR_MAX_SET 65536
+
+static unsigned char map[256];          /* Translation of each input byte */
+static unsigned char deleted[256];      /* Input bytes dropped by -d */
+static unsigned char squeezed[256];     /* Output bytes whose runs -s collapses */
+static unsigned char special[256];      /* Input bytes that need the slow path */
+static int any_special;
+
+typedef struct {
+    unsigned char *chars;
+    size_t len, cap;
+    size_t fill_at;         /* Index of a [c*] to widen, or SIZE_MAX */
+    unsigned char fill_char;
+} Set;
+
+static int set_push(Set *s, unsigned char c, size_t count) {
+    if (s->len + count > TR_MAX_SET) count = TR_MAX_SET - s->len;
+    if (s->len + count > s->cap) {
+        size_t cap = s->cap ? s->cap : 64;
+        while (cap < s->len + count) cap *= 2;
+        unsigned char *tmp = (unsigned char *)realloc(s->chars, cap);
+        if (!tmp) return 0;
+        s->chars = tmp;
+        s->cap = cap;
+    }
+    memset(s->chars + s->len, c, count);
+    s->len += count;
+    return 1;
+}
+
+/* One character of a set, with backslash escapes */
+static unsigned char read_char(const char **p) {
+    const unsigned char *s = (const unsigned char *)*p;
+    unsigned char c = *s++;
+    if (c == '\\' && *s) {
+        c = *s++;
+        switch (c) {
+            case 'a': c = '\a'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'v': c = '\v'; break;
+            default:
+                if (c >= '0' && c <= '7') {
+                    unsigned v = c - '0';
+                    for (int k = 0; k < 2 && *s >= '0' && *s <= '7'; k++) v = v * 8 + (unsigned)(*s++ - '0');
+                    c = (unsigned char)v;
+                }
+        }
+    }
+    *p = (const char *)s;
+    return c;
+}
+
+static int in_class(const char *name, size_t len, int c) {
+#define CLASS(n, test) if (len == sizeof(n) - 1 && memcmp(name, n, len) == 0) return (test) != 0
+    CLASS("alpha", isalpha(c));
+    CLASS("digit", isdigit(c));
+    CLASS("alnum", isalnum(c));
+    CLASS("upper", isupper(c));
+    CLASS("lower", islower(c));
+    CLASS("space", isspace(c));
+    CLASS("blank", c == ' ' || c == '\t');
+    CLASS("punct", ispunct(c));
+    CLASS("cntrl", iscntrl(c));
+    CLASS("graph", isgraph(c));
+    CLASS("print", isprint(c));
+    CLASS("xdigit", isxdigit(c));
+#undef CLASS
+    return -1;
+}
+
+/* Expand a SET argument into its characters; 0 after reporting an error */
+static int expand_set(const char *spec, Set *s, int is_set2) {
+    s->fill_at = SIZE_MAX;
+    const char *p = spec;
+    while (*p) {
+        if (p[0] == '[' && p[1] == ':') {
+            const char *end = strstr(p + 2, ":]");
+            if (end) {
+                size_t len = (size_t)(end - p - 2);
+                if (in_class(p + 2, len, 'a') < 0) {
+                    fprintf(stderr, "tr: invalid character class '%.*s'\n", (int)len, p + 2);
+                    return 0;
+                }
+                for (int c = 0; c < 256; c++) {
+                    if (in_class(p + 2, len, c) > 0 && !set_push(s, (unsigned char)c, 1)) return 0;
+                }
+                p = end + 2;
+                continue;
+            }
+        }
+        if (p[0] == '[' && p[1] == '=' && p[2] && p[3] == '=' && p[4] == ']') {
+            if (!set_push(s, (unsigned char)p[2], 1)) return 0;
+            p += 5;
+            continue;
+        }
+        if (p[0] == '[' && p[1]) {
+            // [c*n] / [c*]: repeat c
+            const char *q = p + 1;
+            unsigned char c = read_char(&q);
+            if (q[0] == '*') {
+                const char *digits = q + 1;
+                const char *close = digits + strspn(digits, "0123456789");
+                if (*close == ']') {
+                    if (!is_set2) {
+                        fprintf(stderr, "tr: the [c*] repeat construct may not appear in SET1\n");
+                        return 0;
+                    }
+                    size_t n = 0;
+                    for (const char *d = digits; d < close && n < TR_MAX_SET; d++) n = n * 10 + (size_t)(*d - '0');
+                    if (close == digits || n == 0) {
+                        if (s->fill_at != SIZE_MAX) {
+                            fprintf(stderr, "tr: only one [c*] repeat construct may appear in SET2\n");
+                            return 0;
+                        }
+                        s->fill_at = s->len;
+                        s->fill_char = c;
+                    } else if (!set_push(s, c, n)) {
+                        return 0;
+                    }
+                    p = close + 1;
+                    continue;
+                }
+            }
+        }
+        unsigned char lo = read_char(&p);
+        if (p[0] == '-' && p[1]) {
+            const char *q = p + 1;
+            unsigned char hi = read_char(&q);
+            if (hi < lo) {
+                fprintf(stderr, "tr: range-endpoints of '%c-%c' are in reverse collating sequence order\n", lo, hi);
+                return 0;
+            }
+            for (unsigned c = lo; c <= hi; c++) {
+                if (!set_push(s, (unsigned char)c, 1)) return 0;
+            }
+            p = q;
+        } else if (!set_push(s, lo, 1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Widen SET2's [c*] so that it is as long as SET1 */
+static int fill_set(Set *s, size_t target) {
+    if (s->fill_at == SIZE_MAX) return 1;
+    size_t count = target > s->len ? target - s->len : 0;
+    size_t tail = s->len - s->fill_at;
+    if (!set_push(s, s->fill_char, count)) return 0;
+    memmove(s->chars + s->fill_at + count, s->chars + s->fill_at, tail);
+    memset(s->chars + s->fill_at, s->fill_char, count);
+    return 1;
+}
+
+/* The complement of a set, in ascending byte order */
+static int complement_set(Set *s) {
+    unsigned char member[256] = {0};
+    for (size_t i = 0; i < s->len; i++) member[s->chars[i]] = 1;
+    s->len = 0;
+    for (int c = 0; c < 256; c++) {
+        if (!member[c] && !set_push(s, (unsigned char)c, 1)) return 0;
+    }
+    return 1;
+}
+
+#ifdef __wasm_simd128__
+
+/* Rows of the 256-entry tables that are not all identity / all zero */
+static v128_t map_rows[16], special_rows[16];
+static v128_t map_offsets[16], special_offsets[16];
+static int num_map_rows, num_special_rows;
+
+/* Collect the rows of table (less base, for the map) that are not all zero */
+static int table_rows(const unsigned char *table, int identity, v128_t *rows, v128_t *offsets) {
+    int n = 0;
+    for (int r = 0; r < 16; r++) {
+        unsigned char row[16];
+        int used = 0;
+        for (int k = 0; k < 16; k++) {
+            row[k] = (unsigned char)(table[r * 16 + k] - (identity ? r * 16 + k : 0));
+            used |= row[k];
+        }
+        if (!used) continue;
+        rows[n] = wasm_v128_load(row);
+        offsets[n] = wasm_i8x16_splat((int8_t)(r * 16));
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Look up every byte of v in the rows: for a row starting at byte b,
+ * v - b is below 16 only for the bytes of that row, and swizzle yields
+ * zero for all other indices, so the row lookups can simply be summed.
+ */
+static inline v128_t lookup_rows(v128_t v, const v128_t *rows, const v128_t *offsets, int n) {
+    v128_t sum = wasm_i8x16_splat(0);
+    for (int r = 0; r < n; r++) {
+        sum = wasm_i8x16_add(sum, wasm_i8x16_swizzle(rows[r], wasm_i8x16_sub(v, offsets[r])));
+    }
+    return sum;
+}
+
+#endif
+
+static int last_squeezed = -1;  /* Last byte written, when it is squeezable */
+
+/* Map s[0..n) into o; returns the number of bytes written */
+static size_t tr_segment(const unsigned char *s, size_t n, unsigned char *o) {
+    unsigned char *start = o;
+    size_t i = 0;
+    while (i < n) {
+#ifdef __wasm_simd128__
+        for (; i + 16 <= n; i += 16, o += 16) {
+            v128_t v = wasm_v128_load(s + i);
+            if (num_special_rows &&
+                wasm_v128_any_true(lookup_rows(v, special_rows, special_offsets, num_special_rows))) {
+                break;
+            }
+            wasm_v128_store(o, wasm_i8x16_add(v, lookup_rows(v, map_rows, map_offsets, num_map_rows)));
+            last_squeezed = -1;
+        }
+#endif
+        size_t stop = n - i > 16 ? i + 16 : n;
+        if (!any_special) {
+            for (; i < stop; i++) *o++ = map[s[i]];
+            continue;
+        }
+        for (; i < stop; i++) {
+            unsigned char c = s[i];
+            if (deleted[c]) continue;
+            c = map[c];
+            if (squeezed[c]) {
+                if (c == last_squeezed) continue;
+                last_squeezed = c;
+            } else {
+                last_squeezed = -1;
+            }
+            *o++ = c;
+        }
+    }
+    return (size_t)(o - start);
+}
 
 int main(int argc, char **argv) {
-    int delete_mode = 0;
-    const char *set1 = NULL;
-    const char *set2 = NULL;
-    const char *input = NULL;
+    int delete_mode = 0, squeeze_mode = 0, complement = 0;
+    const char *set1 = NULL, *set2 = NULL, *input = NULL;
+    const char *positional[3];
+    int npositional = 0;
 
     for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-d") == 0) {
+        const char *a = argv[i];
+        if (strcmp(a, "--delete") == 0) {
             delete_mode = 1;
-        } else if (!set1) {
-            set1 = argv[i];
-        } else if (!set2 && !delete_mode) {
-            set2 = argv[i];
-        } else if (!input) {
-            input = argv[i];
+        } else if (strcmp(a, "--squeeze") == 0 || strcmp(a, "--squeeze-repeats") == 0) {
+            squeeze_mode = 1;
+        } else if (strcmp(a, "--complement") == 0) {
+            complement = 1;
+        } else if ((strcmp(a, "--set1") == 0 || strcmp(a, "--set2") == 0 || strcmp(a, "--input") == 0) &&
+                   i + 1 < argc) {
+            const char **dst = a[2] == 'i' ? &input : a[5] == '1' ? &set1 : &set2;
+            *dst = argv[++i];
+        } else if (a[0] == '-' && a[1] && strspn(a + 1, "cdsC") == strlen(a + 1)) {
+            for (const char *f = a + 1; *f; f++) {
+                if (*f == 'd') delete_mode = 1;
+                else if (*f == 's') squeeze_mode = 1;
+                else complement = 1;
+            }
+        } else if (npositional < 3) {
+            positional[npositional++] = a;
         }
     }
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: tr [-d] SET1 [SET2] <text>\n");
-            return 1;
-        }
-        input = stdin_buf;
+    // Positional arguments: SET1, then SET2 unless only deleting, then the text
+    int k = 0;
+    if (!set1 && k < npositional) set1 = positional[k++];
+    if (!set2 && !(delete_mode && !squeeze_mode) && k < npositional) set2 = positional[k++];
+    if (!input && k < npositional) input = positional[k++];
+
+    if (!set1 || (!delete_mode && !squeeze_mode && !set2) || (delete_mode && !squeeze_mode && set2)) {
+        fprintf(stderr, USAGE);
+        return 1;
     }
 
-    if (!set1 || (!delete_mode && !set2)) {
-        fprintf(stderr, "Usage: tr [-d] SET1 [SET2] <text>\n");
-        free(stdin_buf);
+    Set s1 = {0}, s2 = {0};
+    int ok = expand_set(set1, &s1, 0) && (!complement || complement_set(&s1)) &&
+             (!set2 || (expand_set(set2, &s2, 1) && fill_set(&s2, s1.len)));
+    if (!ok) {
+        free(s1.chars);
+        free(s2.chars);
         return 1;
     }
 
-    size_t set1_len = strlen(set1);
-    size_t set2_len = set2 ? strlen(set2) : 0;
+    for (int c = 0; c < 256; c++) map[c] = (unsigned char)c;
+    int translate = set2 && !delete_mode;
+    if (translate) {
+        if (s2.len == 0 && s1.len > 0) {
+            fprintf(stderr, "tr: when not truncating SET1, SET2 must be non-empty\n");
+            free(s1.chars);
+            free(s2.chars);
+            return 1;
+        }
+        for (size_t i = 0; i < s1.len; i++) map[s1.chars[i]] = s2.chars[i < s2.len ? i : s2.len - 1];
+    }
+    if (delete_mode) {
+        for (size_t i = 0; i < s1.len; i++) deleted[s1.chars[i]] = 1;
+    }
+    if (squeeze_mode) {
+        const Set *last = set2 ? &s2 : &s1;
+        for (size_t i = 0; i < last->len; i++) squeezed[last->chars[i]] = 1;
+    }
+    for (int c = 0; c < 256; c++) {
+        special[c] = deleted[c] || squeezed[map[c]] ? 0xff : 0;
+        any_special |= special[c];
+    }
+    free(s1.chars);
+    free(s2.chars);
+
+#ifdef __wasm_simd128__
+    num_map_rows = table_rows(map, 1, map_rows, map_offsets);
+    num_special_rows = table_rows(special, 0, special_rows, special_offsets);
+#endif
 
-    for (const char *p = input; *p; p++) {
-        // Check if character is in set1
-        const char *found = strchr(set1, *p);
-        if (found) {
-            if (delete_mode) {
-                // Skip this character
-                continue;
-            } else {
-                // Translate to corresponding character in set2
-                size_t idx = found - set1;
-                if (idx < set2_len) {
-                    putchar(set2[idx]);
-                } else if (set2_len > 0) {
-                    // Use last character of set2 if set1 is longer
-                    putchar(set2[set2_len - 1]);
-                }
-            }
-        } else {
-            putchar(*p);
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, USAGE "Or pipe input via stdin.\n");
+            line_reader_free(&reader);
+            return 1;
+        }
+    }
+
+    const char *chunk;
+    size_t chunk_len;
+    while (line_reader_chunk(&reader, &chunk, &chunk_len)) {
+        // Output never outgrows input, so each piece fits the output buffer
+        while (chunk_len > 0) {
+            size_t piece = chunk_len < OUT_BUF_SIZE ? chunk_len : OUT_BUF_SIZE;
+            unsigned char *o = (unsigned char *)out_reserve(piece);
+            out_len += tr_segment((const unsigned char *)chunk, piece, o);
+            chunk += piece;
+            chunk_len -= piece;
         }
     }
 
-    free(stdin_buf);
+    line_reader_free(&reader);
+    out_flush();
     return 0;
 }
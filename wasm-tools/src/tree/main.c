@@ -1,169 +1,522 @@
 /**
  * tree - Display directory structure (text representation)
- * Usage: tree <directory-listing>
- * Input: Newline-separated file paths
+ * Usage: tree [-d] [-L depth] [--sort name|size] [--du] [-h] <directory-listing>
+ * Input: Newline-separated file paths (or a JSON array of paths)
+ * Options: -d (directories only), -L (max display depth), --sort (order
+ *          entries by name, or by size with --du), --du (input lines are
+ *          "size path"; directories show the total of their contents),
+ *          -h (human-readable sizes)
+ *
+ * Paths are streamed through a LineReader and merged into a tree of
+ * compact nodes held in one growing pool. Each path component is interned
+ * once (line_index.h), so a name like "src" or "index.ts" is stored a
+ * single time however often it appears, and a child is found by one
+ * lookup in a hash index keyed by (directory, name id) rather than by
+ * scanning the directory. Building is O(path components) whatever the
+ * fan-out, and output is written iteratively, so depth is unbounded.
+ * Without --sort, entries keep the order in which they first appear.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "../line_reader.h"
+#include "../line_index.h"
+#include "../stdout_write.h"
 
-#define MAX_DEPTH 64
-#define MAX_LINE 4096
-#define MAX_LINES 10000
+#define NO_NODE UINT32_MAX
 
-typedef struct TreeNode {
-    char name[256];
+typedef struct {
+    uint32_t name;          /* Interned name id */
+    uint32_t first_child, last_child, next;
+    uint32_t child_count;
     int is_dir;
-    struct TreeNode *children;
-    struct TreeNode *next;
-    int child_count;
+    uint64_t size;          /* With --du: own size, then the subtree total */
 } TreeNode;
 
-TreeNode* create_node(const char *name, int is_dir) {
-    TreeNode *node = (TreeNode *)calloc(1, sizeof(TreeNode));
-    strncpy(node->name, name, 255);
-    node->is_dir = is_dir;
-    return node;
+/* Child index: (parent, name id) -> node */
+typedef struct {
+    uint32_t parent;
+    uint32_t name;
+    uint32_t node;
+} ChildSlot;
+
+typedef struct {
+    TreeNode *nodes;
+    size_t count, cap;
+    ChildSlot *slots;
+    size_t slot_cap;        /* Power of two */
+    LineInterner names;
+    LineArena arena;
+    LineSpan *name_spans;   /* Name text by id */
+    size_t name_cap;
+} Tree;
+
+typedef struct {
+    int dirs_only;
+    long max_depth;         /* -1: unlimited */
+    int sort;               /* 0 none, 1 name, 2 size */
+    int du;
+    int human;
+} TreeOptions;
+
+static inline size_t child_hash(uint32_t parent, uint32_t name) {
+    uint64_t h = ((uint64_t)parent << 32 | name) * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h ^ (h >> 29));
 }
 
-void free_tree(TreeNode *node) {
-    if (!node) return;
-    TreeNode *child = node->children;
-    while (child) {
-        TreeNode *next = child->next;
-        free_tree(child);
-        child = next;
+static int tree_index_grow(Tree *t) {
+    size_t cap = t->slot_cap ? t->slot_cap * 2 : 1024;
+    ChildSlot *slots = (ChildSlot *)malloc(cap * sizeof(ChildSlot));
+    if (!slots) return 0;
+    for (size_t i = 0; i < cap; i++) slots[i].node = NO_NODE;
+    for (size_t i = 0; i < t->slot_cap; i++) {
+        ChildSlot *s = &t->slots[i];
+        if (s->node == NO_NODE) continue;
+        size_t j = child_hash(s->parent, s->name) & (cap - 1);
+        while (slots[j].node != NO_NODE) j = (j + 1) & (cap - 1);
+        slots[j] = *s;
     }
-    free(node);
+    free(t->slots);
+    t->slots = slots;
+    t->slot_cap = cap;
+    return 1;
 }
 
-TreeNode* find_or_create_child(TreeNode *parent, const char *name, int is_dir) {
-    TreeNode *child = parent->children;
-    TreeNode *last = NULL;
-
-    while (child) {
-        if (strcmp(child->name, name) == 0) {
-            return child;
-        }
-        last = child;
-        child = child->next;
+static uint32_t new_node(Tree *t, uint32_t name, int is_dir) {
+    if (t->count == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 1024;
+        TreeNode *tmp = (TreeNode *)realloc(t->nodes, cap * sizeof(TreeNode));
+        if (!tmp) return NO_NODE;
+        t->nodes = tmp;
+        t->cap = cap;
     }
+    TreeNode *n = &t->nodes[t->count];
+    n->name = name;
+    n->first_child = n->last_child = n->next = NO_NODE;
+    n->child_count = 0;
+    n->is_dir = is_dir;
+    n->size = 0;
+    return (uint32_t)t->count++;
+}
 
-    // Create new child
-    TreeNode *new_child = create_node(name, is_dir);
-    if (last) {
-        last->next = new_child;
-    } else {
-        parent->children = new_child;
-    }
-    parent->child_count++;
+static int tree_init(Tree *t) {
+    memset(t, 0, sizeof(*t));
+    line_arena_init(&t->arena);
+    if (!line_interner_init(&t->names, 1024) || !tree_index_grow(t)) return 0;
+    return new_node(t, 0, 1) != NO_NODE;
+}
 
-    return new_child;
+static void tree_free(Tree *t) {
+    free(t->nodes);
+    free(t->slots);
+    free(t->name_spans);
+    line_interner_free(&t->names);
+    line_arena_free(&t->arena);
 }
 
-void insert_path(TreeNode *root, const char *path) {
-    char *path_copy = strdup(path);
-    char *token = strtok(path_copy, "/\\");
-    TreeNode *current = root;
+/* Interned id of a path component; copies it into the arena once */
+static int64_t intern_name(Tree *t, const char *s, size_t len) {
+    uint64_t h = line_hash(s, len);
+    int id = line_interner_find_hashed(&t->names, h, s, len);
+    if (id >= 0) return id;
+    const char *copy = line_arena_copy(&t->arena, s, len);
+    id = copy ? line_interner_id_hashed(&t->names, h, copy, len) : -1;
+    if (id < 0) return -1;
+    if ((size_t)id >= t->name_cap) {
+        size_t cap = t->name_cap ? t->name_cap * 2 : 1024;
+        LineSpan *tmp = (LineSpan *)realloc(t->name_spans, cap * sizeof(LineSpan));
+        if (!tmp) return -1;
+        t->name_spans = tmp;
+        t->name_cap = cap;
+    }
+    t->name_spans[id].ptr = copy;
+    t->name_spans[id].len = len;
+    return id;
+}
 
-    while (token) {
-        char *next_token = strtok(NULL, "/\\");
-        int is_dir = (next_token != NULL);
-        current = find_or_create_child(current, token, is_dir);
-        token = next_token;
+static uint32_t find_or_create_child(Tree *t, uint32_t parent, uint32_t name) {
+    size_t mask = t->slot_cap - 1;
+    size_t i = child_hash(parent, name) & mask;
+    for (;; i = (i + 1) & mask) {
+        ChildSlot *s = &t->slots[i];
+        if (s->node == NO_NODE) break;
+        if (s->parent == parent && s->name == name) return s->node;
     }
 
-    free(path_copy);
+    uint32_t child = new_node(t, name, 0);
+    if (child == NO_NODE) return NO_NODE;
+    ChildSlot *s = &t->slots[i];
+    s->parent = parent;
+    s->name = name;
+    s->node = child;
+
+    TreeNode *p = &t->nodes[parent];
+    if (p->last_child == NO_NODE) p->first_child = child;
+    else t->nodes[p->last_child].next = child;
+    p->last_child = child;
+    p->child_count++;
+    p->is_dir = 1;
+
+    // Keep the index at most half full
+    if ((t->count - 1) * 2 >= t->slot_cap && !tree_index_grow(t)) return NO_NODE;
+    return child;
 }
 
-void print_tree(TreeNode *node, int depth, int *is_last, int show_root) {
-    if (show_root && depth >= 0) {
-        // Print prefix
-        for (int i = 0; i < depth; i++) {
-            printf("%s", is_last[i] ? "    " : "│   ");
+/* Add one path; '.' and empty components are skipped, a trailing '/' marks a directory */
+static int insert_path(Tree *t, const char *path, size_t len, uint64_t size) {
+    uint32_t current = 0;
+    size_t i = 0;
+    while (i < len) {
+        size_t start = i;
+        while (i < len && path[i] != '/' && path[i] != '\\') i++;
+        size_t n = i - start;
+        if (i < len) i++;
+        if (n == 0 || (n == 1 && path[start] == '.')) continue;
+        int64_t name = intern_name(t, path + start, n);
+        if (name < 0) return 0;
+        current = find_or_create_child(t, current, (uint32_t)name);
+        if (current == NO_NODE) return 0;
+    }
+    if (current == 0) return 1;
+    if (len > 0 && (path[len - 1] == '/' || path[len - 1] == '\\')) t->nodes[current].is_dir = 1;
+    t->nodes[current].size += size;
+    return 1;
+}
+
+/* Handle one input line; with du, it starts with a size */
+static int add_line(Tree *t, const char *line, size_t len, int du) {
+    while (len > 0 && (*line == ' ' || *line == '\t')) {
+        line++;
+        len--;
+    }
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t' || line[len - 1] == '\r')) len--;
+    uint64_t size = 0;
+    if (du) {
+        size_t i = 0;
+        while (i < len && line[i] >= '0' && line[i] <= '9') size = size * 10 + (uint64_t)(line[i++] - '0');
+        if (i > 0 && i < len && (line[i] == ' ' || line[i] == '\t')) {
+            while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
+            line += i;
+            len -= i;
+        } else {
+            size = 0;
         }
+    }
+    return len == 0 || insert_path(t, line, len, size);
+}
 
-        if (depth >= 0) {
-            printf("%s", is_last[depth] ? "└── " : "├── ");
+/* Paths given as a JSON array of strings, which may span lines */
+static int add_json_line(Tree *t, char *line, size_t len, int du) {
+    size_t i = 0;
+    while (i < len) {
+        if (line[i] != '"') {
+            i++;
+            continue;
         }
+        size_t out = ++i, start = i;
+        while (i < len && line[i] != '"') {
+            char c = line[i++];
+            if (c == '\\' && i < len) {
+                char e = line[i++];
+                c = e == 'n' ? '\n' : e == 't' ? '\t' : e;
+            }
+            line[out++] = c;
+        }
+        i++;
+        if (!add_line(t, line + start, out - start, du)) return 0;
+    }
+    return 1;
+}
+
+/* ---- Sorting and sizes ---- */
 
-        printf("%s%s\n", node->name, node->is_dir ? "/" : "");
+static const Tree *sort_tree;
+
+static int compare_names(const void *a, const void *b) {
+    const LineSpan *x = &sort_tree->name_spans[sort_tree->nodes[*(const uint32_t *)a].name];
+    const LineSpan *y = &sort_tree->name_spans[sort_tree->nodes[*(const uint32_t *)b].name];
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(x->ptr, y->ptr, n);
+    if (c) return c;
+    return x->len < y->len ? -1 : x->len > y->len;
+}
+
+/* Largest first, then by name */
+static int compare_sizes(const void *a, const void *b) {
+    uint64_t x = sort_tree->nodes[*(const uint32_t *)a].size, y = sort_tree->nodes[*(const uint32_t *)b].size;
+    if (x != y) return x > y ? -1 : 1;
+    return compare_names(a, b);
+}
+
+static int sort_children(Tree *t, int by) {
+    uint32_t *ids = NULL;
+    size_t cap = 0;
+    sort_tree = t;
+    for (size_t d = 0; d < t->count; d++) {
+        TreeNode *dir = &t->nodes[d];
+        if (dir->child_count < 2) continue;
+        if (dir->child_count > cap) {
+            free(ids);
+            cap = dir->child_count;
+            ids = (uint32_t *)malloc(cap * sizeof(uint32_t));
+            if (!ids) return 0;
+        }
+        size_t n = 0;
+        for (uint32_t c = dir->first_child; c != NO_NODE; c = t->nodes[c].next) ids[n++] = c;
+        qsort(ids, n, sizeof(uint32_t), by == 2 ? compare_sizes : compare_names);
+        dir->first_child = ids[0];
+        for (size_t i = 0; i + 1 < n; i++) t->nodes[ids[i]].next = ids[i + 1];
+        t->nodes[ids[n - 1]].next = NO_NODE;
+        dir->last_child = ids[n - 1];
     }
+    free(ids);
+    return 1;
+}
 
-    // Print children
-    TreeNode *child = node->children;
-    int child_idx = 0;
-    while (child) {
-        is_last[depth + 1] = (child->next == NULL);
-        print_tree(child, depth + 1, is_last, 1);
-        child = child->next;
-        child_idx++;
+/* Children always come after their parent in the pool, so one backward pass sums subtrees */
+static void total_sizes(Tree *t) {
+    for (size_t i = t->count; i-- > 1;) {
+        TreeNode *n = &t->nodes[i];
+        for (uint32_t c = n->first_child; c != NO_NODE; c = t->nodes[c].next) n->size += t->nodes[c].size;
     }
+    for (uint32_t c = t->nodes[0].first_child; c != NO_NODE; c = t->nodes[c].next) t->nodes[0].size += t->nodes[c].size;
 }
 
-void count_tree(TreeNode *node, int *dirs, int *files) {
-    TreeNode *child = node->children;
-    while (child) {
-        if (child->is_dir || child->child_count > 0) {
-            (*dirs)++;
-        } else {
-            (*files)++;
-        }
-        count_tree(child, dirs, files);
-        child = child->next;
+static void write_size(uint64_t size, int human) {
+    if (!human) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%11llu", (unsigned long long)size);
+        out_str(buf);
+        return;
+    }
+    static const char units[] = "BKMGTPE";
+    double v = (double)size;
+    int u = 0;
+    while (v >= 1024 && u < 6) {
+        v /= 1024;
+        u++;
     }
+    char buf[32];
+    if (u == 0) snprintf(buf, sizeof(buf), "%4llu", (unsigned long long)size);
+    else if (v < 10) snprintf(buf, sizeof(buf), "%3.1f%c", v, units[u]);
+    else snprintf(buf, sizeof(buf), "%3.0f%c", v, units[u]);
+    out_str(buf);
 }
 
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: tree <directory-listing>\n");
-        fprintf(stderr, "Input: Newline-separated file paths\n");
-        return 1;
+/* ---- Output ---- */
+
+typedef struct {
+    uint32_t node;          /* Next child to print at this level */
+    long depth;
+    size_t prefix_len;      /* Prefix bytes in front of its entries */
+} PrintFrame;
+
+static int print_tree(const Tree *t, const TreeOptions *opts, size_t *dirs, size_t *files) {
+    // The prefix holds one "│   " or "    " per open level
+    char *prefix = NULL;
+    size_t prefix_cap = 0;
+    PrintFrame *stack = NULL;
+    size_t depth = 0, cap = 0;
+    int ok = 1;
+
+    out_str(".\n");
+    uint32_t first = t->nodes[0].first_child;
+    if (first == NO_NODE) goto done;
+    cap = 64;
+    stack = (PrintFrame *)malloc(cap * sizeof(PrintFrame));
+    if (!stack) {
+        ok = 0;
+        goto done;
     }
+    stack[depth].node = first;
+    stack[depth].depth = 1;
+    stack[depth].prefix_len = 0;
+    depth++;
 
-    const char *input = argv[1];
+    while (depth > 0) {
+        PrintFrame *f = &stack[depth - 1];
+        // Skip files when only directories are shown
+        while (opts->dirs_only && f->node != NO_NODE && !t->nodes[f->node].is_dir) f->node = t->nodes[f->node].next;
+        if (f->node == NO_NODE) {
+            depth--;
+            continue;
+        }
+        const TreeNode *n = &t->nodes[f->node];
+        uint32_t next = n->next;
+        while (opts->dirs_only && next != NO_NODE && !t->nodes[next].is_dir) next = t->nodes[next].next;
+        int last = next == NO_NODE;
+        long level = f->depth;
+        size_t prefix_len = f->prefix_len;
+        f->node = next;
 
-    // Create root node
-    TreeNode *root = create_node(".", 1);
+        if (prefix_len) out_write(prefix, prefix_len);
+        out_str(last ? "└── " : "├── ");
+        if (opts->du) {
+            out_char('[');
+            write_size(n->size, opts->human);
+            out_str("]  ");
+        }
+        const LineSpan *name = &t->name_spans[n->name];
+        out_write(name->ptr, name->len);
+        if (n->is_dir) out_char('/');
+        out_char('\n');
+        if (n->is_dir) (*dirs)++;
+        else (*files)++;
 
-    // Parse input (newline-separated paths)
-    char *input_copy = strdup(input);
-    char *line = strtok(input_copy, "\n");
+        if (n->first_child == NO_NODE || (opts->max_depth >= 0 && level >= opts->max_depth)) continue;
 
-    while (line) {
-        // Skip empty lines
-        while (*line == ' ' || *line == '\t') line++;
-        if (*line && *line != '\n') {
-            // Remove trailing whitespace
-            char *end = line + strlen(line) - 1;
-            while (end > line && (*end == ' ' || *end == '\t' || *end == '\r')) {
-                *end-- = '\0';
+        // Descend: extend the prefix for this level
+        const char *bar = last ? "    " : "│   ";
+        size_t bar_len = strlen(bar);
+        if (prefix_len + bar_len > prefix_cap) {
+            size_t pcap = prefix_cap ? prefix_cap * 2 : 256;
+            char *tmp = (char *)realloc(prefix, pcap);
+            if (!tmp) {
+                ok = 0;
+                goto done;
             }
-            if (*line) {
-                insert_path(root, line);
+            prefix = tmp;
+            prefix_cap = pcap;
+        }
+        memcpy(prefix + prefix_len, bar, bar_len);
+        if (depth == cap) {
+            cap *= 2;
+            PrintFrame *tmp = (PrintFrame *)realloc(stack, cap * sizeof(PrintFrame));
+            if (!tmp) {
+                ok = 0;
+                goto done;
             }
+            stack = tmp;
         }
-        line = strtok(NULL, "\n");
+        stack[depth].node = n->first_child;
+        stack[depth].depth = level + 1;
+        stack[depth].prefix_len = prefix_len + bar_len;
+        depth++;
     }
 
-    free(input_copy);
+done:
+    free(prefix);
+    free(stack);
+    return ok;
+}
+
+static int out_of_memory(void) {
+    out_flush();
+    fprintf(stderr, "Error: Out of memory\n");
+    return 1;
+}
 
-    // Print tree
-    printf(".\n");
-    int is_last[MAX_DEPTH] = {0};
-    TreeNode *child = root->children;
-    while (child) {
-        is_last[0] = (child->next == NULL);
-        print_tree(child, 0, is_last, 1);
-        child = child->next;
+static void usage(void) {
+    fprintf(stderr, "Usage: tree [-d] [-L depth] [--sort name|size] [--du] [-h] <directory-listing>\n");
+    fprintf(stderr, "Input: Newline-separated file paths (or a JSON array of paths)\n");
+}
+
+int main(int argc, char **argv) {
+    TreeOptions opts = {0};
+    opts.max_depth = -1;
+    const char *input = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-d") == 0 || strcmp(arg, "--directoriesOnly") == 0) {
+            opts.dirs_only = 1;
+        } else if ((strcmp(arg, "-L") == 0 || strcmp(arg, "--level") == 0) && i + 1 < argc) {
+            opts.max_depth = strtol(argv[++i], NULL, 10);
+            if (opts.max_depth < 1) {
+                fprintf(stderr, "tree: Invalid level, must be greater than 0.\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--sort") == 0 && i + 1 < argc && argv[i + 1][0] != '-' &&
+                   (strcmp(argv[i + 1], "name") == 0 || strcmp(argv[i + 1], "size") == 0)) {
+            opts.sort = strcmp(argv[++i], "size") == 0 ? 2 : 1;
+        } else if (strcmp(arg, "--sort") == 0 || strcmp(arg, "--sort=name") == 0) {
+            opts.sort = 1;
+        } else if (strcmp(arg, "--sort=size") == 0) {
+            opts.sort = 2;
+        } else if (strcmp(arg, "--du") == 0) {
+            opts.du = 1;
+        } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--human") == 0) {
+            opts.human = 1;
+        } else if (strcmp(arg, "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (!input) {
+            input = arg;
+        }
+    }
+    if (opts.sort == 2 && !opts.du) {
+        fprintf(stderr, "tree: --sort size needs --du\n");
+        return 1;
+    }
+
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            usage();
+            line_reader_free(&reader);
+            return 1;
+        }
     }
 
-    // Count and print summary
-    int dirs = 0, files = 0;
-    count_tree(root, &dirs, &files);
-    printf("\n%d directories, %d files\n", dirs, files);
+    Tree tree;
+    if (!tree_init(&tree)) {
+        tree_free(&tree);
+        line_reader_free(&reader);
+        return out_of_memory();
+    }
+
+    int status = 0, json = -1;
+    char *line;
+    size_t len;
+    while (line_reader_next(&reader, &line, &len)) {
+        if (json < 0) {
+            size_t i = 0;
+            while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
+            if (i == len) continue;
+            json = line[i] == '[';
+        }
+        if (!(json ? add_json_line(&tree, line, len, opts.du) : add_line(&tree, line, len, opts.du))) {
+            status = out_of_memory();
+            goto done;
+        }
+    }
+    if (reader.error) {
+        status = out_of_memory();
+        goto done;
+    }
+
+    if (opts.du) total_sizes(&tree);
+    if (opts.sort && !sort_children(&tree, opts.sort)) {
+        status = out_of_memory();
+        goto done;
+    }
+
+    size_t dirs = 0, files = 0;
+    if (!print_tree(&tree, &opts, &dirs, &files)) {
+        status = out_of_memory();
+        goto done;
+    }
+    out_char('\n');
+    if (opts.du) {
+        write_size(tree.nodes[0].size, opts.human);
+        out_str(" used in ");
+    }
+    out_uint(dirs);
+    out_str(" directories");
+    if (!opts.dirs_only) {
+        out_str(", ");
+        out_uint(files);
+        out_str(" files");
+    }
+    out_char('\n');
 
-    free_tree(root);
-    return 0;
+done:
+    tree_free(&tree);
+    line_reader_free(&reader);
+    out_flush();
+    return status;
 }
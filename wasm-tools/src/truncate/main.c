@@ -9,7 +9,7 @@
 #include <string.h>
 #include <ctype.h>
 
-long long parse_size(const char *size_str) {
+static long long parse_size(const char *size_str) {
     char *endptr;
     long long size = strtoll(size_str, &endptr, 10);
 
@@ -34,7 +34,7 @@ long long parse_size(const char *size_str) {
     return size;
 }
 
-void format_size(long long size, char *buf, size_t buf_len) {
+static void format_size(long long size, char *buf, size_t buf_len) {
     const char *units[] = {"B", "KB", "MB", "GB", "TB"};
     int unit_idx = 0;
     double display_size = (double)size;
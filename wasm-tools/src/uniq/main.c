@@ -1,90 +1,278 @@
 /**
  * uniq - Filter adjacent duplicate lines
- * Usage: uniq [-c] [-d] [-u] <text>
+ * Usage: uniq [-c] [-d] [-u] [--global] [--top N] <text>
  * Options: -c (count), -d (only duplicates), -u (only unique)
+ *
+ * --global collapses duplicates anywhere in the input, not just adjacent
+ * ones, in first-seen order: `uniq --global -c` gives the counts of
+ * `sort | uniq -c` in one pass without sorting. Distinct lines are copied
+ * once into an arena and interned in a hash table (line_index.h), so
+ * memory grows with the number of distinct lines, not the input size.
+ *
+ * --top N (implies --global and -c) prints the N most frequent lines,
+ * most frequent first, like `sort | uniq -c | sort -rn | head -N`; ties
+ * keep first-seen order. A min-heap of N entries picks them.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../stdin_read.h"
+#include "../line_reader.h"
+#include "../line_index.h"
+#include "../stdout_write.h"
 
-#define MAX_LINE_LEN 4096
+typedef struct {
+    int show_count;
+    int only_duplicates;
+    int only_unique;
+} UniqOptions;
 
-int main(int argc, char **argv) {
-    int show_count = 0;
-    int only_duplicates = 0;
-    int only_unique = 0;
-    const char *input = NULL;
-
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-c") == 0) {
-            show_count = 1;
-        } else if (strcmp(argv[i], "-d") == 0) {
-            only_duplicates = 1;
-        } else if (strcmp(argv[i], "-u") == 0) {
-            only_unique = 1;
-        } else if (argv[i][0] != '-') {
-            input = argv[i];
+static void print_line(const UniqOptions *opts, size_t count, const char *line, size_t len) {
+    int is_duplicate = count > 1;
+    if ((!opts->only_duplicates && !opts->only_unique) ||
+        (opts->only_duplicates && is_duplicate) ||
+        (opts->only_unique && !is_duplicate)) {
+        if (opts->show_count) {
+            out_uint_pad(count, 7, ' ');
+            out_char(' ');
         }
+        out_write(line, len);
+        out_char('\n');
     }
+}
 
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: uniq [-c] [-d] [-u] <text>\n");
-            return 1;
-        }
-        input = stdin_buf;
-    }
+static int out_of_memory(void) {
+    out_flush();
+    fprintf(stderr, "Error: Out of memory\n");
+    return 1;
+}
 
-    char *input_copy = strdup(input);
-    char prev_line[MAX_LINE_LEN] = "";
-    int count = 0;
+static int uniq_adjacent(LineReader *reader, const UniqOptions *opts) {
+    // The previous line is copied out of the reader's buffer, which is
+    // reused for the next line; it grows to fit the longest line seen
+    char *prev_line = NULL;
+    size_t prev_len = 0, prev_cap = 0;
+    size_t count = 0;
     int first = 1;
 
-    char *line = strtok(input_copy, "\n");
-    while (line) {
-        if (first || strcmp(line, prev_line) != 0) {
+    char *line;
+    size_t len;
+    while (line_reader_next(reader, &line, &len)) {
+        if (first || len != prev_len || memcmp(line, prev_line, len) != 0) {
             // Output previous line if needed
-            if (!first) {
-                int is_duplicate = count > 1;
-                if ((!only_duplicates && !only_unique) ||
-                    (only_duplicates && is_duplicate) ||
-                    (only_unique && !is_duplicate)) {
-                    if (show_count) {
-                        printf("%7d %s\n", count, prev_line);
-                    } else {
-                        printf("%s\n", prev_line);
-                    }
+            if (!first) print_line(opts, count, prev_line, prev_len);
+            if (len + 1 > prev_cap) {
+                char *tmp = (char *)realloc(prev_line, len + 1);
+                if (!tmp) {
+                    free(prev_line);
+                    return out_of_memory();
                 }
+                prev_line = tmp;
+                prev_cap = len + 1;
             }
-            strncpy(prev_line, line, MAX_LINE_LEN - 1);
-            prev_line[MAX_LINE_LEN - 1] = '\0';
+            memcpy(prev_line, line, len + 1);
+            prev_len = len;
             count = 1;
             first = 0;
         } else {
             count++;
         }
-        line = strtok(NULL, "\n");
     }
 
     // Output last line
-    if (!first) {
-        int is_duplicate = count > 1;
-        if ((!only_duplicates && !only_unique) ||
-            (only_duplicates && is_duplicate) ||
-            (only_unique && !is_duplicate)) {
-            if (show_count) {
-                printf("%7d %s\n", count, prev_line);
-            } else {
-                printf("%s\n", prev_line);
+    if (!first) print_line(opts, count, prev_line, prev_len);
+
+    free(prev_line);
+    return 0;
+}
+
+/* Distinct lines by interner id, with their counts */
+typedef struct {
+    LineSpan *lines;
+    size_t *counts;
+    size_t count, cap;
+} DistinctLines;
+
+/* Root is the least frequent kept id (latest first seen on ties) */
+typedef struct {
+    int *ids;
+    size_t count, cap;
+    const size_t *counts;
+} TopHeap;
+
+/* Does id a rank below id b? */
+static inline int ranks_below(const TopHeap *h, int a, int b) {
+    if (h->counts[a] != h->counts[b]) return h->counts[a] < h->counts[b];
+    return a > b;
+}
+
+static void heap_sift_down(TopHeap *h, size_t i) {
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, low = i;
+        if (l < h->count && ranks_below(h, h->ids[l], h->ids[low])) low = l;
+        if (r < h->count && ranks_below(h, h->ids[r], h->ids[low])) low = r;
+        if (low == i) break;
+        int tmp = h->ids[i];
+        h->ids[i] = h->ids[low];
+        h->ids[low] = tmp;
+        i = low;
+    }
+}
+
+static void heap_offer(TopHeap *h, int id) {
+    if (h->count < h->cap) {
+        size_t i = h->count++;
+        h->ids[i] = id;
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!ranks_below(h, h->ids[i], h->ids[parent])) break;
+            int tmp = h->ids[i];
+            h->ids[i] = h->ids[parent];
+            h->ids[parent] = tmp;
+            i = parent;
+        }
+    } else if (ranks_below(h, h->ids[0], id)) {
+        h->ids[0] = id;
+        heap_sift_down(h, 0);
+    }
+}
+
+static const size_t *sort_counts;
+
+/* Most frequent first, then first seen */
+static int compare_ids(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    if (sort_counts[x] != sort_counts[y]) return sort_counts[x] > sort_counts[y] ? -1 : 1;
+    return x < y ? -1 : x > y;
+}
+
+static int uniq_global(LineReader *reader, const UniqOptions *opts, size_t top) {
+    LineInterner interner;
+    LineArena arena;
+    DistinctLines distinct = {0};
+    int status = 0;
+
+    if (!line_interner_init(&interner, 1024)) return out_of_memory();
+    line_arena_init(&arena);
+
+    char *line;
+    size_t len;
+    while (line_reader_next(reader, &line, &len)) {
+        uint64_t h = line_hash(line, len);
+        int id = line_interner_find_hashed(&interner, h, line, len);
+        if (id < 0) {
+            // First occurrence: keep a copy that outlives the reader's buffer
+            const char *copy = line_arena_copy(&arena, line, len);
+            id = copy ? line_interner_id_hashed(&interner, h, copy, len) : -1;
+            if (id < 0) {
+                status = out_of_memory();
+                goto done;
+            }
+            if (distinct.count == distinct.cap) {
+                size_t cap = distinct.cap ? distinct.cap * 2 : 1024;
+                LineSpan *lines = (LineSpan *)realloc(distinct.lines, cap * sizeof(LineSpan));
+                if (lines) distinct.lines = lines;
+                size_t *counts = (size_t *)realloc(distinct.counts, cap * sizeof(size_t));
+                if (counts) distinct.counts = counts;
+                if (!lines || !counts) {
+                    status = out_of_memory();
+                    goto done;
+                }
+                distinct.cap = cap;
             }
+            distinct.lines[id].ptr = copy;
+            distinct.lines[id].len = len;
+            distinct.counts[id] = 0;
+            distinct.count++;
         }
+        distinct.counts[id]++;
     }
 
-    free(input_copy);
-    free(stdin_buf);
-    return 0;
+    if (top == 0) {
+        for (size_t i = 0; i < distinct.count; i++) {
+            print_line(opts, distinct.counts[i], distinct.lines[i].ptr, distinct.lines[i].len);
+        }
+        goto done;
+    }
+
+    // Pick the most frequent lines that pass -d/-u with a bounded min-heap
+    TopHeap heap;
+    heap.cap = top < distinct.count ? top : distinct.count;
+    heap.count = 0;
+    heap.counts = distinct.counts;
+    heap.ids = (int *)malloc((heap.cap ? heap.cap : 1) * sizeof(int));
+    if (!heap.ids) {
+        status = out_of_memory();
+        goto done;
+    }
+    for (size_t i = 0; i < distinct.count; i++) {
+        size_t count = distinct.counts[i];
+        if (opts->only_duplicates && count < 2) continue;
+        if (opts->only_unique && count != 1) continue;
+        heap_offer(&heap, (int)i);
+    }
+    sort_counts = distinct.counts;
+    qsort(heap.ids, heap.count, sizeof(int), compare_ids);
+    for (size_t i = 0; i < heap.count; i++) {
+        int id = heap.ids[i];
+        print_line(opts, distinct.counts[id], distinct.lines[id].ptr, distinct.lines[id].len);
+    }
+    free(heap.ids);
+
+done:
+    free(distinct.lines);
+    free(distinct.counts);
+    line_arena_free(&arena);
+    line_interner_free(&interner);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    UniqOptions opts = {0};
+    int global = 0;
+    size_t top = 0;
+    const char *input = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--count") == 0) {
+            opts.show_count = 1;
+        } else if (strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--repeated") == 0) {
+            opts.only_duplicates = 1;
+        } else if (strcmp(argv[i], "-u") == 0 || strcmp(argv[i], "--unique") == 0) {
+            opts.only_unique = 1;
+        } else if (strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--global") == 0) {
+            global = 1;
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            long n = strtol(argv[++i], NULL, 10);
+            if (n < 1) {
+                fprintf(stderr, "uniq: --top needs a positive count\n");
+                return 1;
+            }
+            top = (size_t)n;
+            global = 1;
+            opts.show_count = 1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            input = argv[++i];
+        } else if (argv[i][0] != '-') {
+            input = argv[i];
+        }
+    }
+
+    LineReader reader;
+    if (input) {
+        line_reader_init_string(&reader, input);
+    } else {
+        line_reader_init_stdin(&reader);
+        if (line_reader_is_empty(&reader)) {
+            fprintf(stderr, "Usage: uniq [-c] [-d] [-u] [--global] [--top N] <text>\n");
+            line_reader_free(&reader);
+            return 1;
+        }
+    }
+
+    int status = global ? uniq_global(&reader, &opts, top) : uniq_adjacent(&reader, &opts);
+
+    line_reader_free(&reader);
+    out_flush();
+    return status;
 }
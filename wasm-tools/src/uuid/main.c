@@ -12,13 +12,13 @@
 // Simple PRNG (xorshift64)
 static uint64_t rng_state;
 
-void seed_rng(void) {
+static void seed_rng(void) {
     // Use time as seed - in WASI this should work
     rng_state = (uint64_t)time(NULL) ^ 0x5DEECE66DULL;
     if (rng_state == 0) rng_state = 1;
 }
 
-uint64_t next_random(void) {
+static uint64_t next_random(void) {
     uint64_t x = rng_state;
     x ^= x << 13;
     x ^= x >> 7;
@@ -27,7 +27,7 @@ uint64_t next_random(void) {
     return x;
 }
 
-void generate_uuid(char *buf) {
+static void generate_uuid(char *buf) {
     uint8_t bytes[16];
 
     // Generate random bytes
@@ -1,326 +1,1193 @@
 /**
  * xmllint - XML validation and query
- * Usage: xmllint [--xpath EXPR] <xml>
- * Options: --xpath (evaluate XPath expression)
+ * Usage: xmllint [--format] [--noout] [--xpath EXPR] <xml>
+ * Options: --xpath (evaluate XPath expression), --noout (check only),
+ *          --format (pretty-print; the default output)
+ *
+ * Every mode checks that the input is well-formed: one root element,
+ * matching end tags, quoted attributes, valid entity references. The
+ * first error is reported with its line number and the exit status is 1.
+ * Nesting depth is unlimited.
+ *
+ * Parsing is split into a pull lexer, a reader that checks structure, and
+ * consumers of its tokens:
+ *
+ * - Formatting builds a DOM in one bump arena. Names, attribute values
+ *   and text are spans into the input buffer, and each element's children
+ *   are collected on a shared stack and copied into the arena once the
+ *   element closes, so there is no per-node malloc and no free walk.
+ *
+ * - --xpath and --noout stream: input is read through a LineReader window
+ *   and no tree is built. The XPath subset (/a/b, //b, *, [@attr],
+ *   [@attr='v'], final @attr or text()) is matched as tokens arrive. Each
+ *   depth keeps the set of steps still waiting for a match as a bitmask,
+ *   and only the subtree of a matching element is copied into the arena
+ *   while it is printed.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include <stdint.h>
+#include "../line_reader.h"
 #include "../stdin_read.h"
+#include "../stdout_write.h"
 
-#define MAX_DEPTH 100
+/* ---- Arena ---- */
 
-typedef struct XmlNode {
-    char *tag;
-    char *text;
-    char **attr_names;
-    char **attr_values;
-    int attr_count;
-    struct XmlNode **children;
-    int child_count;
-    struct XmlNode *parent;
-} XmlNode;
+#define ARENA_BLOCK (256 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+static void *arena_alloc(Arena *a, size_t n) {
+    n = (n + 7) & ~(size_t)7;
+    ArenaBlock *b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = (ArenaBlock *)malloc(sizeof(ArenaBlock) + cap);
+        if (!b) return NULL;
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    void *p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+static const char *arena_copy(Arena *a, const char *s, size_t len) {
+    char *p = (char *)arena_alloc(a, len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
 
-XmlNode* create_node(const char *tag) {
-    XmlNode *node = (XmlNode *)calloc(1, sizeof(XmlNode));
-    if (tag) node->tag = strdup(tag);
-    return node;
+static void arena_free(Arena *a) {
+    while (a->head) {
+        ArenaBlock *next = a->head->next;
+        free(a->head);
+        a->head = next;
+    }
 }
 
-void free_node(XmlNode *node) {
-    if (!node) return;
+/* ---- Lexer ---- */
 
-    free(node->tag);
-    free(node->text);
+enum {
+    TOK_EOF, TOK_START, TOK_END, TOK_TEXT, TOK_CDATA, TOK_COMMENT, TOK_PI, TOK_DOCTYPE, TOK_ERROR
+};
 
-    for (int i = 0; i < node->attr_count; i++) {
-        free(node->attr_names[i]);
-        free(node->attr_values[i]);
+typedef struct {
+    const char *name;
+    size_t name_len;
+    const char *value;
+    size_t value_len;
+} XmlAttr;
+
+typedef struct {
+    int type;
+    const char *name;       /* Element name or PI target */
+    size_t name_len;
+    const char *text;       /* Text, CDATA, comment or PI body */
+    size_t text_len;
+    XmlAttr *attrs;
+    size_t attr_count;
+    int self_closing;
+    size_t line;
+} XmlToken;
+
+/*
+ * Tokens point into the lexer's buffer and stay valid until the next
+ * token. When streaming, a token that runs past the buffered bytes pulls
+ * more input in; the window grows only for a single token that is longer
+ * than it.
+ */
+typedef struct {
+    LineReader *in;         /* NULL when the whole input is in buf */
+    const char *buf;
+    size_t pos, len;
+    size_t line;
+    XmlAttr *attrs;
+    size_t attr_cap;
+    int oom;
+    char error[160];
+} XmlLexer;
+
+static void lexer_init_buffer(XmlLexer *lx, const char *buf, size_t len) {
+    memset(lx, 0, sizeof(*lx));
+    lx->buf = buf;
+    lx->len = len;
+    lx->line = 1;
+}
+
+static void lexer_init_stream(XmlLexer *lx, LineReader *in) {
+    memset(lx, 0, sizeof(*lx));
+    lx->in = in;
+    lx->buf = in->buf;
+    lx->pos = in->head;
+    lx->len = in->tail;
+    lx->line = 1;
+}
+
+/* Read more input behind the current token; returns 0 at EOF */
+static int lexer_more(XmlLexer *lx) {
+    LineReader *in = lx->in;
+    if (!in) return 0;
+    in->head = lx->pos;
+    size_t n = line_reader_fill(in);
+    if (in->error) lx->oom = 1;
+    lx->buf = in->buf;
+    lx->pos = in->head;
+    lx->len = in->tail;
+    return n > 0;
+}
+
+static int lexer_fail(XmlLexer *lx, const char *msg) {
+    snprintf(lx->error, sizeof(lx->error), "%s", msg);
+    return TOK_ERROR;
+}
+
+/* Offset of term at or after pos + from, pulling in input as needed */
+static int lexer_find(XmlLexer *lx, size_t from, const char *term, size_t *at) {
+    size_t tlen = strlen(term);
+    for (;;) {
+        if (lx->pos + from < lx->len) {
+            const char *hit = simd_memmem(lx->buf + lx->pos + from, lx->len - lx->pos - from, term, tlen);
+            if (hit) {
+                *at = (size_t)(hit - (lx->buf + lx->pos));
+                return 1;
+            }
+            size_t scanned = lx->len - lx->pos;
+            from = scanned >= tlen ? scanned - tlen + 1 : from;
+        }
+        if (!lexer_more(lx)) return 0;
     }
-    free(node->attr_names);
-    free(node->attr_values);
+}
 
-    for (int i = 0; i < node->child_count; i++) {
-        free_node(node->children[i]);
+/* Offset of the '>' closing a tag or declaration, skipping quoted values */
+static int lexer_find_tag_end(XmlLexer *lx, size_t from, int brackets, size_t *at) {
+    char quote = 0;
+    int depth = 0;
+    size_t off = from;
+    for (;;) {
+        while (lx->pos + off < lx->len) {
+            char c = lx->buf[lx->pos + off];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (brackets && c == '[') {
+                depth++;
+            } else if (brackets && c == ']') {
+                depth--;
+            } else if (c == '>' && depth <= 0) {
+                *at = off;
+                return 1;
+            }
+            off++;
+        }
+        if (!lexer_more(lx)) return 0;
     }
-    free(node->children);
+}
 
-    free(node);
+static int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
 }
 
-void add_child(XmlNode *parent, XmlNode *child) {
-    parent->child_count++;
-    parent->children = (XmlNode **)realloc(
-        parent->children,
-        parent->child_count * sizeof(XmlNode *)
-    );
-    parent->children[parent->child_count - 1] = child;
-    child->parent = parent;
+static int is_name_start(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || c >= 0x80;
 }
 
-// Simple XML parser
-XmlNode* parse_xml(const char *xml) {
-    XmlNode *root = NULL;
-    XmlNode *current = NULL;
-    const char *p = xml;
+static int is_name_char(unsigned char c) {
+    return is_name_start(c) || (c >= '0' && c <= '9') || c == '-' || c == '.';
+}
 
-    while (*p) {
-        // Skip whitespace
-        while (*p && isspace((unsigned char)*p)) p++;
-        if (!*p) break;
+/* Check that every '&' starts a well-formed entity or character reference */
+static const char *check_references(const char *s, size_t len) {
+    const char *end = s + len;
+    const char *p = s;
+    while ((p = (const char *)simd_memchr(p, '&', (size_t)(end - p))) != NULL) {
+        const char *q = p + 1;
+        if (q < end && *q == '#') {
+            q++;
+            int hex = q < end && *q == 'x';
+            if (hex) q++;
+            const char *digits = q;
+            while (q < end && ((*q >= '0' && *q <= '9') ||
+                               (hex && ((*q >= 'a' && *q <= 'f') || (*q >= 'A' && *q <= 'F'))))) {
+                q++;
+            }
+            if (q == digits) return "invalid character reference";
+        } else {
+            if (q >= end || !is_name_start((unsigned char)*q)) return "'&' must start an entity reference (use &amp;)";
+            while (q < end && is_name_char((unsigned char)*q)) q++;
+        }
+        if (q >= end || *q != ';') return "entity reference is missing ';'";
+        p = q + 1;
+    }
+    return NULL;
+}
 
-        // XML declaration or DOCTYPE - skip
-        if (strncmp(p, "<?", 2) == 0 || strncmp(p, "<!", 2) == 0) {
-            p = strchr(p, '>');
-            if (p) p++;
-            continue;
+static int lexer_push_attr(XmlLexer *lx, size_t count, const XmlAttr *a) {
+    if (count == lx->attr_cap) {
+        size_t cap = lx->attr_cap ? lx->attr_cap * 2 : 16;
+        XmlAttr *tmp = (XmlAttr *)realloc(lx->attrs, cap * sizeof(XmlAttr));
+        if (!tmp) {
+            lx->oom = 1;
+            return 0;
         }
+        lx->attrs = tmp;
+        lx->attr_cap = cap;
+    }
+    lx->attrs[count] = *a;
+    return 1;
+}
 
-        // Closing tag
-        if (strncmp(p, "</", 2) == 0) {
-            p += 2;
-            while (*p && *p != '>') p++;
-            if (*p) p++;
-            if (current && current->parent) {
-                current = current->parent;
+/* Split the inside of a start tag, buf[s..e), into name and attributes */
+static int lexer_start_tag(XmlLexer *lx, XmlToken *t, const char *s, const char *e) {
+    if (e > s && e[-1] == '/') {
+        t->self_closing = 1;
+        e--;
+    }
+    const char *p = s;
+    if (p >= e || !is_name_start((unsigned char)*p)) return lexer_fail(lx, "invalid element name");
+    while (p < e && is_name_char((unsigned char)*p)) p++;
+    t->name = s;
+    t->name_len = (size_t)(p - s);
+
+    size_t count = 0;
+    for (;;) {
+        const char *before = p;
+        while (p < e && is_space(*p)) p++;
+        if (p >= e) break;
+        if (p == before) return lexer_fail(lx, "expected whitespace between attributes");
+        XmlAttr a;
+        a.name = p;
+        if (!is_name_start((unsigned char)*p)) return lexer_fail(lx, "invalid attribute name");
+        while (p < e && is_name_char((unsigned char)*p)) p++;
+        a.name_len = (size_t)(p - a.name);
+        while (p < e && is_space(*p)) p++;
+        if (p >= e || *p != '=') return lexer_fail(lx, "attribute without a value");
+        p++;
+        while (p < e && is_space(*p)) p++;
+        if (p >= e || (*p != '"' && *p != '\'')) return lexer_fail(lx, "attribute value must be quoted");
+        char quote = *p++;
+        a.value = p;
+        while (p < e && *p != quote) p++;
+        if (p >= e) return lexer_fail(lx, "unterminated attribute value");
+        a.value_len = (size_t)(p - a.value);
+        p++;
+        if (memchr(a.value, '<', a.value_len)) return lexer_fail(lx, "'<' in attribute value");
+        const char *bad = check_references(a.value, a.value_len);
+        if (bad) return lexer_fail(lx, bad);
+        if (!lexer_push_attr(lx, count, &a)) return TOK_ERROR;
+        count++;
+    }
+    t->attrs = lx->attrs;
+    t->attr_count = count;
+    return TOK_START;
+}
+
+static int lexer_token(XmlLexer *lx, XmlToken *t, size_t *consumed) {
+    if (lx->pos >= lx->len && !lexer_more(lx)) return TOK_EOF;
+
+    if (lx->buf[lx->pos] != '<') {
+        // Text runs up to the next '<'
+        size_t off = 0;
+        for (;;) {
+            const char *lt = (const char *)simd_memchr(lx->buf + lx->pos + off, '<', lx->len - lx->pos - off);
+            if (lt) {
+                off = (size_t)(lt - (lx->buf + lx->pos));
+                break;
             }
-            continue;
+            off = lx->len - lx->pos;
+            if (!lexer_more(lx)) break;
         }
+        t->text = lx->buf + lx->pos;
+        t->text_len = off;
+        *consumed = off;
+        const char *bad = check_references(t->text, t->text_len);
+        if (bad) return lexer_fail(lx, bad);
+        return TOK_TEXT;
+    }
 
-        // Opening tag
-        if (*p == '<') {
-            p++;
+    // Make sure enough bytes are buffered to tell the markup kinds apart
+    while (lx->len - lx->pos < 9 && lexer_more(lx)) {}
+    const char *p = lx->buf + lx->pos;
+    size_t avail = lx->len - lx->pos;
+    size_t at;
 
-            // Get tag name
-            const char *tag_start = p;
-            while (*p && !isspace((unsigned char)*p) && *p != '>' && *p != '/') p++;
-
-            char tag[256];
-            size_t tag_len = p - tag_start;
-            if (tag_len >= sizeof(tag)) tag_len = sizeof(tag) - 1;
-            strncpy(tag, tag_start, tag_len);
-            tag[tag_len] = '\0';
-
-            XmlNode *node = create_node(tag);
-
-            // Parse attributes
-            while (*p && *p != '>' && *p != '/') {
-                while (*p && isspace((unsigned char)*p)) p++;
-                if (*p == '>' || *p == '/') break;
-
-                // Attribute name
-                const char *name_start = p;
-                while (*p && *p != '=' && !isspace((unsigned char)*p)) p++;
-
-                char name[256];
-                size_t name_len = p - name_start;
-                if (name_len >= sizeof(name)) name_len = sizeof(name) - 1;
-                strncpy(name, name_start, name_len);
-                name[name_len] = '\0';
-
-                // Skip =
-                while (*p && (*p == '=' || isspace((unsigned char)*p))) p++;
-
-                // Attribute value
-                char quote = *p;
-                if (quote == '"' || quote == '\'') {
-                    p++;
-                    const char *val_start = p;
-                    while (*p && *p != quote) p++;
-
-                    char value[1024];
-                    size_t val_len = p - val_start;
-                    if (val_len >= sizeof(value)) val_len = sizeof(value) - 1;
-                    strncpy(value, val_start, val_len);
-                    value[val_len] = '\0';
-
-                    // Add attribute
-                    node->attr_count++;
-                    node->attr_names = (char **)realloc(
-                        node->attr_names,
-                        node->attr_count * sizeof(char *)
-                    );
-                    node->attr_values = (char **)realloc(
-                        node->attr_values,
-                        node->attr_count * sizeof(char *)
-                    );
-                    node->attr_names[node->attr_count - 1] = strdup(name);
-                    node->attr_values[node->attr_count - 1] = strdup(value);
-
-                    if (*p == quote) p++;
-                }
-            }
+    if (avail >= 4 && memcmp(p, "<!--", 4) == 0) {
+        if (!lexer_find(lx, 4, "-->", &at)) return lexer_fail(lx, "unterminated comment");
+        t->text = lx->buf + lx->pos + 4;
+        t->text_len = at - 4;
+        *consumed = at + 3;
+        return TOK_COMMENT;
+    }
+    if (avail >= 9 && memcmp(p, "<![CDATA[", 9) == 0) {
+        if (!lexer_find(lx, 9, "]]>", &at)) return lexer_fail(lx, "unterminated CDATA section");
+        t->text = lx->buf + lx->pos + 9;
+        t->text_len = at - 9;
+        *consumed = at + 3;
+        return TOK_CDATA;
+    }
+    if (avail >= 2 && p[1] == '?') {
+        if (!lexer_find(lx, 2, "?>", &at)) return lexer_fail(lx, "unterminated processing instruction");
+        p = lx->buf + lx->pos;
+        size_t n = 2;
+        while (n < at && is_name_char((unsigned char)p[n])) n++;
+        if (n == 2) return lexer_fail(lx, "processing instruction without a target");
+        t->name = p + 2;
+        t->name_len = n - 2;
+        while (n < at && is_space(p[n])) n++;
+        t->text = p + n;
+        t->text_len = at - n;
+        *consumed = at + 2;
+        return TOK_PI;
+    }
+    if (avail >= 2 && p[1] == '!') {
+        if (!lexer_find_tag_end(lx, 2, 1, &at)) return lexer_fail(lx, "unterminated declaration");
+        t->text = lx->buf + lx->pos;
+        t->text_len = at + 1;
+        *consumed = at + 1;
+        return TOK_DOCTYPE;
+    }
+    if (avail >= 2 && p[1] == '/') {
+        if (!lexer_find_tag_end(lx, 2, 0, &at)) return lexer_fail(lx, "unterminated end tag");
+        p = lx->buf + lx->pos;
+        size_t n = 2;
+        if (n >= at || !is_name_start((unsigned char)p[n])) return lexer_fail(lx, "invalid end tag");
+        while (n < at && is_name_char((unsigned char)p[n])) n++;
+        t->name = p + 2;
+        t->name_len = n - 2;
+        while (n < at && is_space(p[n])) n++;
+        if (n != at) return lexer_fail(lx, "invalid end tag");
+        *consumed = at + 1;
+        return TOK_END;
+    }
 
-            // Self-closing tag
-            int self_closing = 0;
-            if (*p == '/') {
-                self_closing = 1;
-                p++;
+    if (!lexer_find_tag_end(lx, 1, 0, &at)) return lexer_fail(lx, "unterminated start tag");
+    *consumed = at + 1;
+    p = lx->buf + lx->pos;
+    return lexer_start_tag(lx, t, p + 1, p + at);
+}
+
+/* Next token; consumes it so the following call moves past it */
+static int lexer_next(XmlLexer *lx, XmlToken *t) {
+    memset(t, 0, sizeof(*t));
+    size_t consumed = 0;
+    t->type = lexer_token(lx, t, &consumed);
+    if (lx->oom) {
+        snprintf(lx->error, sizeof(lx->error), "out of memory");
+        t->type = TOK_ERROR;
+    }
+    t->line = lx->line;
+    if (t->type != TOK_ERROR && t->type != TOK_EOF) {
+        lx->line += simd_count_byte(lx->buf + lx->pos, '\n', consumed);
+        lx->pos += consumed;
+    }
+    return t->type;
+}
+
+/* ---- Reader: well-formedness on top of the lexer ---- */
+
+typedef struct {
+    XmlLexer lx;
+    char *names;            /* Open element names back to back */
+    size_t names_len, names_cap;
+    size_t *name_ends;
+    size_t depth, depth_cap;
+    int seen_root, root_closed;
+    XmlToken tok;
+    size_t error_line;
+    char error[256];
+} XmlReader;
+
+static int reader_fail(XmlReader *r, const char *fmt, const char *name, size_t name_len) {
+    snprintf(r->error, sizeof(r->error), fmt, (int)name_len, name);
+    r->error_line = r->tok.line;
+    return r->tok.type = TOK_ERROR;
+}
+
+static int reader_push(XmlReader *r, const char *name, size_t len) {
+    if (r->names_len + len > r->names_cap) {
+        size_t cap = r->names_cap ? r->names_cap * 2 : 1024;
+        while (cap < r->names_len + len) cap *= 2;
+        char *tmp = (char *)realloc(r->names, cap);
+        if (!tmp) return 0;
+        r->names = tmp;
+        r->names_cap = cap;
+    }
+    if (r->depth == r->depth_cap) {
+        size_t cap = r->depth_cap ? r->depth_cap * 2 : 64;
+        size_t *tmp = (size_t *)realloc(r->name_ends, cap * sizeof(size_t));
+        if (!tmp) return 0;
+        r->name_ends = tmp;
+        r->depth_cap = cap;
+    }
+    memcpy(r->names + r->names_len, name, len);
+    r->names_len += len;
+    r->name_ends[r->depth++] = r->names_len;
+    return 1;
+}
+
+static int is_blank(const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (!is_space(s[i])) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Next well-formed token in r->tok. Whitespace outside the root element
+ * is skipped. Returns the token type; TOK_ERROR leaves a message in
+ * r->error.
+ */
+static int reader_next(XmlReader *r) {
+    XmlToken *t = &r->tok;
+    for (;;) {
+        switch (lexer_next(&r->lx, t)) {
+        case TOK_ERROR:
+            snprintf(r->error, sizeof(r->error), "%s", r->lx.error);
+            r->error_line = t->line;
+            return TOK_ERROR;
+        case TOK_EOF:
+            if (r->depth > 0) {
+                size_t start = r->depth > 1 ? r->name_ends[r->depth - 2] : 0;
+                return reader_fail(r, "premature end of data: <%.*s> is not closed",
+                                   r->names + start, r->name_ends[r->depth - 1] - start);
             }
-            if (*p == '>') p++;
-
-            if (!root) {
-                root = node;
-                current = node;
-            } else if (current) {
-                add_child(current, node);
-                if (!self_closing) {
-                    current = node;
-                }
+            if (!r->seen_root) return reader_fail(r, "document is empty%.*s", "", 0);
+            return TOK_EOF;
+        case TOK_START:
+            if (r->root_closed) {
+                return reader_fail(r, "extra content at the end of the document: <%.*s>",
+                                   t->name, t->name_len);
+            }
+            r->seen_root = 1;
+            if (t->self_closing) {
+                if (r->depth == 0) r->root_closed = 1;
+            } else if (!reader_push(r, t->name, t->name_len)) {
+                return reader_fail(r, "out of memory%.*s", "", 0);
+            }
+            return TOK_START;
+        case TOK_END: {
+            if (r->depth == 0) return reader_fail(r, "unexpected end tag </%.*s>", t->name, t->name_len);
+            size_t start = r->depth > 1 ? r->name_ends[r->depth - 2] : 0;
+            size_t len = r->name_ends[r->depth - 1] - start;
+            if (len != t->name_len || memcmp(r->names + start, t->name, len) != 0) {
+                snprintf(r->error, sizeof(r->error), "mismatched end tag: expected </%.*s>, found </%.*s>",
+                         (int)len, r->names + start, (int)t->name_len, t->name);
+                r->error_line = t->line;
+                return t->type = TOK_ERROR;
             }
+            r->depth--;
+            r->names_len = start;
+            if (r->depth == 0) r->root_closed = 1;
+            return TOK_END;
+        }
+        case TOK_TEXT:
+        case TOK_CDATA:
+            if (r->depth == 0) {
+                if (t->type == TOK_TEXT && is_blank(t->text, t->text_len)) continue;
+                return reader_fail(r, "content outside the root element%.*s", "", 0);
+            }
+            return t->type;
+        case TOK_DOCTYPE:
+            if (r->seen_root) return reader_fail(r, "declaration inside the document%.*s", "", 0);
+            return TOK_DOCTYPE;
+        default:
+            return t->type;
+        }
+    }
+}
 
-            continue;
+static void reader_free(XmlReader *r) {
+    free(r->names);
+    free(r->name_ends);
+    free(r->lx.attrs);
+}
+
+/* ---- DOM ---- */
+
+enum { NODE_ELEMENT, NODE_TEXT, NODE_CDATA, NODE_COMMENT, NODE_PI };
+
+typedef struct XmlNode {
+    int kind;
+    const char *name;
+    size_t name_len;
+    const char *text;
+    size_t text_len;
+    XmlAttr *attrs;
+    size_t attr_count;
+    struct XmlNode **children;
+    size_t child_count;
+} XmlNode;
+
+/*
+ * Builds nodes from reader tokens. An open element's children are pushed
+ * on one shared stack; when it closes they are copied into an exact-size
+ * array in the arena. With copy set, strings are copied into the arena
+ * too (needed when the input is a sliding window).
+ */
+typedef struct {
+    Arena arena;
+    int copy;
+    XmlNode **pending;
+    size_t pending_len, pending_cap;
+    XmlNode **open;
+    size_t *starts;
+    size_t depth, open_cap;
+    int oom;
+} DomBuilder;
+
+static const char *dom_string(DomBuilder *b, const char *s, size_t len) {
+    if (!b->copy) return s;
+    const char *p = arena_copy(&b->arena, s, len);
+    if (!p) b->oom = 1;
+    return p;
+}
+
+static void dom_add(DomBuilder *b, XmlNode *n) {
+    if (b->pending_len == b->pending_cap) {
+        size_t cap = b->pending_cap ? b->pending_cap * 2 : 256;
+        XmlNode **tmp = (XmlNode **)realloc(b->pending, cap * sizeof(XmlNode *));
+        if (!tmp) {
+            b->oom = 1;
+            return;
+        }
+        b->pending = tmp;
+        b->pending_cap = cap;
+    }
+    b->pending[b->pending_len++] = n;
+}
+
+static XmlNode *dom_node(DomBuilder *b, int kind) {
+    XmlNode *n = (XmlNode *)arena_alloc(&b->arena, sizeof(XmlNode));
+    if (!n) {
+        b->oom = 1;
+        return NULL;
+    }
+    memset(n, 0, sizeof(*n));
+    n->kind = kind;
+    return n;
+}
+
+static XmlNode *dom_start(DomBuilder *b, const XmlToken *t) {
+    XmlNode *n = dom_node(b, NODE_ELEMENT);
+    if (!n) return NULL;
+    n->name = dom_string(b, t->name, t->name_len);
+    n->name_len = t->name_len;
+    if (t->attr_count) {
+        n->attrs = (XmlAttr *)arena_alloc(&b->arena, t->attr_count * sizeof(XmlAttr));
+        if (!n->attrs) {
+            b->oom = 1;
+            return NULL;
+        }
+        for (size_t i = 0; i < t->attr_count; i++) {
+            n->attrs[i].name = dom_string(b, t->attrs[i].name, t->attrs[i].name_len);
+            n->attrs[i].name_len = t->attrs[i].name_len;
+            n->attrs[i].value = dom_string(b, t->attrs[i].value, t->attrs[i].value_len);
+            n->attrs[i].value_len = t->attrs[i].value_len;
         }
+        n->attr_count = t->attr_count;
+    }
+    dom_add(b, n);
+    if (t->self_closing) return n;
 
-        // Text content
-        if (current) {
-            const char *text_start = p;
-            while (*p && *p != '<') p++;
-
-            size_t text_len = p - text_start;
-            char *text = (char *)malloc(text_len + 1);
-            strncpy(text, text_start, text_len);
-            text[text_len] = '\0';
-
-            // Trim
-            char *t = text;
-            while (*t && isspace((unsigned char)*t)) t++;
-            if (*t) {
-                if (current->text) {
-                    size_t old_len = strlen(current->text);
-                    current->text = (char *)realloc(current->text, old_len + strlen(t) + 2);
-                    strcat(current->text, " ");
-                    strcat(current->text, t);
+    if (b->depth == b->open_cap) {
+        size_t cap = b->open_cap ? b->open_cap * 2 : 64;
+        XmlNode **open = (XmlNode **)realloc(b->open, cap * sizeof(XmlNode *));
+        if (open) b->open = open;
+        size_t *starts = (size_t *)realloc(b->starts, cap * sizeof(size_t));
+        if (starts) b->starts = starts;
+        if (!open || !starts) {
+            b->oom = 1;
+            return NULL;
+        }
+        b->open_cap = cap;
+    }
+    b->open[b->depth] = n;
+    b->starts[b->depth] = b->pending_len;
+    b->depth++;
+    return n;
+}
+
+static void dom_end(DomBuilder *b) {
+    if (b->depth == 0) return;
+    b->depth--;
+    XmlNode *n = b->open[b->depth];
+    size_t start = b->starts[b->depth];
+    n->child_count = b->pending_len - start;
+    if (n->child_count) {
+        n->children = (XmlNode **)arena_alloc(&b->arena, n->child_count * sizeof(XmlNode *));
+        if (!n->children) {
+            b->oom = 1;
+            n->child_count = 0;
+        } else {
+            memcpy(n->children, b->pending + start, n->child_count * sizeof(XmlNode *));
+        }
+    }
+    b->pending_len = start;
+}
+
+/* Text, CDATA, comment or PI; whitespace-only text is dropped */
+static void dom_leaf(DomBuilder *b, const XmlToken *t) {
+    int kind = t->type == TOK_TEXT ? NODE_TEXT : t->type == TOK_CDATA ? NODE_CDATA :
+               t->type == TOK_COMMENT ? NODE_COMMENT : NODE_PI;
+    if (kind == NODE_TEXT && is_blank(t->text, t->text_len)) return;
+    XmlNode *n = dom_node(b, kind);
+    if (!n) return;
+    if (kind == NODE_PI) {
+        n->name = dom_string(b, t->name, t->name_len);
+        n->name_len = t->name_len;
+    }
+    n->text = dom_string(b, t->text, t->text_len);
+    n->text_len = t->text_len;
+    dom_add(b, n);
+}
+
+static void dom_reset(DomBuilder *b) {
+    arena_free(&b->arena);
+    b->pending_len = 0;
+    b->depth = 0;
+}
+
+static void dom_free(DomBuilder *b) {
+    arena_free(&b->arena);
+    free(b->pending);
+    free(b->open);
+    free(b->starts);
+}
+
+/* ---- Output ---- */
+
+static void trim(const char **s, size_t *len) {
+    while (*len > 0 && is_space(**s)) { (*s)++; (*len)--; }
+    while (*len > 0 && is_space((*s)[*len - 1])) (*len)--;
+}
+
+static void out_indent(size_t indent) {
+    for (size_t i = 0; i < indent; i++) out_str("  ");
+}
+
+static void print_attrs(const XmlNode *n) {
+    for (size_t i = 0; i < n->attr_count; i++) {
+        const XmlAttr *a = &n->attrs[i];
+        out_char(' ');
+        out_write(a->name, a->name_len);
+        out_str("=\"");
+        // Values may have been single-quoted and contain '"'
+        for (size_t k = 0; k < a->value_len; k++) {
+            if (a->value[k] == '"') out_str("&quot;");
+            else out_char(a->value[k]);
+        }
+        out_char('"');
+    }
+}
+
+static int has_only_text(const XmlNode *n) {
+    for (size_t i = 0; i < n->child_count; i++) {
+        int k = n->children[i]->kind;
+        if (k != NODE_TEXT && k != NODE_CDATA) return 0;
+    }
+    return 1;
+}
+
+static void print_leaf(const XmlNode *n) {
+    const char *s = n->text;
+    size_t len = n->text_len;
+    switch (n->kind) {
+    case NODE_TEXT:
+        trim(&s, &len);
+        out_write(s, len);
+        break;
+    case NODE_CDATA:
+        out_str("<![CDATA[");
+        out_write(s, len);
+        out_str("]]>");
+        break;
+    case NODE_COMMENT:
+        out_str("<!--");
+        out_write(s, len);
+        out_str("-->");
+        break;
+    default:
+        out_str("<?");
+        out_write(n->name, n->name_len);
+        if (len) {
+            out_char(' ');
+            out_write(s, len);
+        }
+        out_str("?>");
+    }
+}
+
+typedef struct {
+    const XmlNode *node;
+    size_t next;            /* Next child to print */
+} PrintFrame;
+
+static PrintFrame *print_stack;
+static size_t print_cap;
+
+/* Pretty-print a subtree; iterative, so depth is bounded only by memory */
+static int print_xml(const XmlNode *root, size_t indent) {
+    size_t depth = 0;
+    const XmlNode *n = root;
+    for (;;) {
+        if (n) {
+            out_indent(indent + depth);
+            if (n->kind != NODE_ELEMENT) {
+                print_leaf(n);
+                out_char('\n');
+            } else {
+                out_char('<');
+                out_write(n->name, n->name_len);
+                print_attrs(n);
+                if (n->child_count == 0) {
+                    out_str("/>\n");
+                } else if (has_only_text(n)) {
+                    out_char('>');
+                    for (size_t i = 0; i < n->child_count; i++) {
+                        const XmlNode *c = n->children[i];
+                        const char *s = c->text;
+                        size_t len = c->text_len;
+                        if (c->kind == NODE_TEXT && n->child_count == 1) trim(&s, &len);
+                        if (c->kind == NODE_CDATA) print_leaf(c);
+                        else out_write(s, len);
+                    }
+                    out_str("</");
+                    out_write(n->name, n->name_len);
+                    out_str(">\n");
                 } else {
-                    current->text = strdup(t);
+                    out_str(">\n");
+                    if (depth == print_cap) {
+                        size_t cap = print_cap ? print_cap * 2 : 64;
+                        PrintFrame *tmp = (PrintFrame *)realloc(print_stack, cap * sizeof(PrintFrame));
+                        if (!tmp) return 0;
+                        print_stack = tmp;
+                        print_cap = cap;
+                    }
+                    print_stack[depth].node = n;
+                    print_stack[depth].next = 0;
+                    depth++;
                 }
             }
-            free(text);
+        }
+        if (depth == 0) return 1;
+
+        PrintFrame *f = &print_stack[depth - 1];
+        if (f->next < f->node->child_count) {
+            n = f->node->children[f->next++];
         } else {
+            depth--;
+            out_indent(indent + depth);
+            out_str("</");
+            out_write(f->node->name, f->node->name_len);
+            out_str(">\n");
+            n = NULL;
+        }
+    }
+}
+
+/* An XPath result: text-only elements print their text, others their markup */
+static int print_match(const XmlNode *n) {
+    if (n->child_count == 0 || !has_only_text(n)) return print_xml(n, 0);
+    size_t total = 0;
+    for (size_t i = 0; i < n->child_count; i++) total += n->children[i]->text_len;
+    if (n->child_count == 1) {
+        const char *s = n->children[0]->text;
+        size_t len = n->children[0]->text_len;
+        trim(&s, &len);
+        out_write(s, len);
+    } else {
+        // Join the pieces first so trimming applies to the whole value
+        char *joined = (char *)malloc(total ? total : 1);
+        if (!joined) return 0;
+        size_t len = 0;
+        for (size_t i = 0; i < n->child_count; i++) {
+            memcpy(joined + len, n->children[i]->text, n->children[i]->text_len);
+            len += n->children[i]->text_len;
+        }
+        const char *s = joined;
+        trim(&s, &len);
+        out_write(s, len);
+        free(joined);
+    }
+    out_char('\n');
+    return 1;
+}
+
+/* ---- Streaming XPath ---- */
+
+#define MAX_STEPS 64
+
+enum { SELECT_ELEMENT, SELECT_ATTR, SELECT_TEXT };
+
+typedef struct {
+    int descendant;         /* '//' before the step */
+    const char *name;       /* NULL for '*' */
+    size_t name_len;
+    const char *pred_attr;  /* [@attr] or [@attr='value'] */
+    size_t pred_attr_len;
+    const char *pred_value; /* NULL when only presence is tested */
+    size_t pred_value_len;
+} XPathStep;
+
+typedef struct {
+    XPathStep steps[MAX_STEPS];
+    int count;
+    int select;
+    const char *attr;       /* SELECT_ATTR target */
+    size_t attr_len;
+} XPath;
+
+static int xpath_name(const char **p, const char **name, size_t *len) {
+    const char *s = *p;
+    if (*s == '*') {
+        *name = NULL;
+        *len = 0;
+        *p = s + 1;
+        return 1;
+    }
+    if (!is_name_start((unsigned char)*s)) return 0;
+    while (is_name_char((unsigned char)**p)) (*p)++;
+    *name = s;
+    *len = (size_t)(*p - s);
+    return 1;
+}
+
+static int xpath_compile(const char *expr, XPath *xp) {
+    const char *p = expr;
+    memset(xp, 0, sizeof(*xp));
+    int descendant = 0;
+    for (;;) {
+        if (p[0] == '/' && p[1] == '/') {
+            descendant = 1;
+            p += 2;
+        } else if (p[0] == '/') {
+            p++;
+        } else if (p != expr) {
+            return 0;
+        }
+
+        if (*p == '@' || strncmp(p, "text()", 6) == 0) {
+            if (descendant || xp->count == 0) {
+                // //@id and //text() select from every element
+                if (xp->count == MAX_STEPS) return 0;
+                xp->steps[xp->count].descendant = 1;
+                xp->count++;
+            }
+            if (*p == '@') {
+                p++;
+                const char *name;
+                if (!xpath_name(&p, &name, &xp->attr_len) || !name) return 0;
+                xp->attr = name;
+                xp->select = SELECT_ATTR;
+            } else {
+                p += 6;
+                xp->select = SELECT_TEXT;
+            }
+            return *p == '\0';
+        }
+
+        if (xp->count == MAX_STEPS) return 0;
+        XPathStep *s = &xp->steps[xp->count++];
+        s->descendant = descendant;
+        descendant = 0;
+        if (!xpath_name(&p, &s->name, &s->name_len)) return 0;
+        if (*p == '[') {
             p++;
+            if (*p++ != '@') return 0;
+            if (!xpath_name(&p, &s->pred_attr, &s->pred_attr_len) || !s->pred_attr) return 0;
+            if (*p == '=') {
+                p++;
+                char quote = *p++;
+                if (quote != '\'' && quote != '"') return 0;
+                s->pred_value = p;
+                while (*p && *p != quote) p++;
+                if (!*p) return 0;
+                s->pred_value_len = (size_t)(p - s->pred_value);
+                p++;
+            }
+            if (*p++ != ']') return 0;
         }
+        if (*p == '\0') return 1;
     }
+}
 
-    return root;
+static const XmlAttr *find_attr(const XmlToken *t, const char *name, size_t len) {
+    for (size_t i = 0; i < t->attr_count; i++) {
+        if (t->attrs[i].name_len == len && memcmp(t->attrs[i].name, name, len) == 0) return &t->attrs[i];
+    }
+    return NULL;
 }
 
-// Print XML
-void print_xml(XmlNode *node, int indent) {
-    if (!node) return;
+static int step_matches(const XPathStep *s, const XmlToken *t) {
+    if (s->name && (s->name_len != t->name_len || memcmp(s->name, t->name, t->name_len) != 0)) return 0;
+    if (!s->pred_attr) return 1;
+    const XmlAttr *a = find_attr(t, s->pred_attr, s->pred_attr_len);
+    if (!a) return 0;
+    return !s->pred_value || (a->value_len == s->pred_value_len &&
+                              memcmp(a->value, s->pred_value, a->value_len) == 0);
+}
 
-    for (int i = 0; i < indent; i++) printf("  ");
+typedef struct {
+    uint64_t waiting;       /* Steps that may match this element's children */
+    int text_target;        /* Print this element's text (final text()) */
+} MatchFrame;
 
-    printf("<%s", node->tag);
+typedef struct {
+    const XPath *xp;
+    MatchFrame *frames;
+    size_t depth, cap;
+    DomBuilder dom;
+    size_t capture_depth;   /* Depth of the element being captured, or 0 */
+    XmlNode **matches;      /* Matching elements inside the capture */
+    size_t match_count, match_cap;
+    int oom;
+} Matcher;
 
-    for (int i = 0; i < node->attr_count; i++) {
-        printf(" %s=\"%s\"", node->attr_names[i], node->attr_values[i]);
+static int matcher_push(Matcher *m, uint64_t waiting, int text_target) {
+    if (m->depth == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        MatchFrame *tmp = (MatchFrame *)realloc(m->frames, cap * sizeof(MatchFrame));
+        if (!tmp) return 0;
+        m->frames = tmp;
+        m->cap = cap;
     }
+    m->frames[m->depth].waiting = waiting;
+    m->frames[m->depth].text_target = text_target;
+    m->depth++;
+    return 1;
+}
 
-    if (node->child_count == 0 && !node->text) {
-        printf("/>\n");
-        return;
+static void matcher_flush(Matcher *m) {
+    for (size_t i = 0; i < m->match_count; i++) {
+        if (!print_match(m->matches[i])) m->oom = 1;
     }
+    m->match_count = 0;
+    m->capture_depth = 0;
+    dom_reset(&m->dom);
+}
 
-    printf(">");
+static void matcher_start(Matcher *m, const XmlToken *t) {
+    const XPath *xp = m->xp;
+    uint64_t waiting = m->depth ? m->frames[m->depth - 1].waiting : 1;
+    uint64_t next = 0;
+    int matched = 0;
+    for (uint64_t w = waiting; w; w &= w - 1) {
+        int i = __builtin_ctzll(w);
+        const XPathStep *s = &xp->steps[i];
+        if (s->descendant) next |= 1ULL << i;
+        if (!step_matches(s, t)) continue;
+        if (i == xp->count - 1) matched = 1;
+        else next |= 1ULL << (i + 1);
+    }
 
-    if (node->text && node->child_count == 0) {
-        printf("%s</%s>\n", node->text, node->tag);
-        return;
+    if (matched && xp->select == SELECT_ATTR) {
+        const XmlAttr *a = find_attr(t, xp->attr, xp->attr_len);
+        if (a) {
+            out_write(a->value, a->value_len);
+            out_char('\n');
+        }
     }
 
-    printf("\n");
+    int capture = matched && xp->select == SELECT_ELEMENT;
+    if (capture && !m->capture_depth) m->capture_depth = m->depth + 1;
+    if (m->capture_depth) {
+        XmlNode *n = dom_start(&m->dom, t);
+        if (capture && n) {
+            if (m->match_count == m->match_cap) {
+                size_t cap = m->match_cap ? m->match_cap * 2 : 16;
+                XmlNode **tmp = (XmlNode **)realloc(m->matches, cap * sizeof(XmlNode *));
+                if (!tmp) {
+                    m->oom = 1;
+                    return;
+                }
+                m->matches = tmp;
+                m->match_cap = cap;
+            }
+            m->matches[m->match_count++] = n;
+        }
+        if (m->dom.oom) m->oom = 1;
+    }
 
-    if (node->text) {
-        for (int i = 0; i < indent + 1; i++) printf("  ");
-        printf("%s\n", node->text);
+    if (t->self_closing) {
+        if (m->capture_depth == m->depth + 1) matcher_flush(m);
+        return;
     }
+    if (!matcher_push(m, next, matched && xp->select == SELECT_TEXT)) m->oom = 1;
+}
 
-    for (int i = 0; i < node->child_count; i++) {
-        print_xml(node->children[i], indent + 1);
+static void matcher_end(Matcher *m) {
+    if (m->capture_depth) {
+        dom_end(&m->dom);
+        if (m->capture_depth == m->depth) matcher_flush(m);
     }
+    if (m->depth) m->depth--;
+}
 
-    for (int i = 0; i < indent; i++) printf("  ");
-    printf("</%s>\n", node->tag);
+static void matcher_leaf(Matcher *m, const XmlToken *t) {
+    if (m->capture_depth) {
+        dom_leaf(&m->dom, t);
+        if (m->dom.oom) m->oom = 1;
+    }
+    if ((t->type == TOK_TEXT || t->type == TOK_CDATA) && m->depth && m->frames[m->depth - 1].text_target) {
+        const char *s = t->text;
+        size_t len = t->text_len;
+        if (t->type == TOK_TEXT) trim(&s, &len);
+        if (len) {
+            out_write(s, len);
+            out_char('\n');
+        }
+    }
 }
 
-// Simple XPath evaluation
-void xpath_query(XmlNode *node, const char *xpath) {
-    if (!node || !xpath) return;
+static void matcher_free(Matcher *m) {
+    dom_free(&m->dom);
+    free(m->frames);
+    free(m->matches);
+}
 
-    // Handle /tag/subtag format
-    if (*xpath == '/') xpath++;
+/* ---- Main ---- */
 
-    char current_tag[256];
-    const char *slash = strchr(xpath, '/');
+static int report(const XmlReader *r) {
+    out_flush();
+    fprintf(stderr, "Error: line %zu: %s\n", r->error_line, r->error);
+    return 1;
+}
 
-    if (slash) {
-        size_t len = slash - xpath;
-        if (len >= sizeof(current_tag)) len = sizeof(current_tag) - 1;
-        strncpy(current_tag, xpath, len);
-        current_tag[len] = '\0';
+/* Check and optionally query the document in one streaming pass */
+static int run_stream(XmlReader *r, const XPath *xp) {
+    Matcher m;
+    memset(&m, 0, sizeof(m));
+    m.xp = xp;
+    m.dom.copy = 1;
 
-        // Match current tag
-        if (strcmp(node->tag, current_tag) == 0) {
-            for (int i = 0; i < node->child_count; i++) {
-                xpath_query(node->children[i], slash);
-            }
+    int status = 0;
+    int type;
+    while ((type = reader_next(r)) != TOK_EOF) {
+        if (type == TOK_ERROR) {
+            status = report(r);
+            break;
         }
-    } else {
-        // Final tag - print matches
-        if (strcmp(node->tag, xpath) == 0) {
-            if (node->text) {
-                printf("%s\n", node->text);
-            } else {
-                print_xml(node, 0);
-            }
+        if (!xp) continue;
+        if (type == TOK_START) matcher_start(&m, &r->tok);
+        else if (type == TOK_END) matcher_end(&m);
+        else if (type != TOK_DOCTYPE) matcher_leaf(&m, &r->tok);
+        if (m.oom) {
+            out_flush();
+            fprintf(stderr, "Error: Out of memory\n");
+            status = 1;
+            break;
         }
+    }
+    matcher_free(&m);
+    return status;
+}
 
-        // Search children
-        for (int i = 0; i < node->child_count; i++) {
-            xpath_query(node->children[i], xpath);
+/* Build the DOM over the in-memory input and pretty-print it */
+static int run_format(XmlReader *r) {
+    DomBuilder dom;
+    memset(&dom, 0, sizeof(dom));
+    int status = 0;
+    int type;
+    while ((type = reader_next(r)) != TOK_EOF) {
+        if (type == TOK_ERROR) {
+            status = report(r);
+            break;
         }
+        if (type == TOK_START) dom_start(&dom, &r->tok);
+        else if (type == TOK_END) dom_end(&dom);
+        // The XML declaration and DOCTYPE are not reproduced
+        else if (type == TOK_PI && r->tok.name_len == 3 && memcmp(r->tok.name, "xml", 3) == 0) continue;
+        else if (type != TOK_DOCTYPE) dom_leaf(&dom, &r->tok);
+        if (dom.oom) break;
+    }
+    if (dom.oom) {
+        out_flush();
+        fprintf(stderr, "Error: Out of memory\n");
+        status = 1;
     }
+    for (size_t i = 0; status == 0 && i < dom.pending_len; i++) {
+        if (!print_xml(dom.pending[i], 0)) status = 1;
+    }
+    dom_free(&dom);
+    return status;
 }
 
 int main(int argc, char **argv) {
     const char *xpath = NULL;
     const char *xml = NULL;
+    int noout = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--xpath") == 0 && i + 1 < argc) {
             xpath = argv[++i];
+        } else if (strcmp(argv[i], "--noout") == 0) {
+            noout = 1;
+        } else if (strcmp(argv[i], "--format") == 0) {
+            // Formatted output is the default
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            xml = argv[++i];
         } else {
             xml = argv[i];
         }
     }
 
+    XPath xp;
+    if (xpath && !xpath_compile(xpath, &xp)) {
+        fprintf(stderr, "Error: Unsupported XPath expression '%s'\n", xpath);
+        fprintf(stderr, "Supported: /a/b, //b, *, [@attr], [@attr='v'], trailing /@attr or /text()\n");
+        return 1;
+    }
+
+    XmlReader reader;
+    memset(&reader, 0, sizeof(reader));
+    LineReader in;
     char *stdin_buf = NULL;
-    if (!xml) {
+    int streaming = xpath || noout;
+    int status;
+
+    if (xml) {
+        lexer_init_buffer(&reader.lx, xml, strlen(xml));
+    } else if (streaming) {
+        if (!line_reader_init_stdin(&in)) {
+            fprintf(stderr, "Error: Out of memory\n");
+            return 1;
+        }
+        if (line_reader_is_empty(&in)) {
+            fprintf(stderr, "Usage: xmllint [--format] [--noout] [--xpath EXPR] <xml>\nOr pipe input via stdin.\n");
+            line_reader_free(&in);
+            return 1;
+        }
+        lexer_init_stream(&reader.lx, &in);
+    } else {
         stdin_buf = read_all_stdin();
         if (!stdin_buf) {
-            fprintf(stderr, "Usage: xmllint [--xpath EXPR] <xml>\nOr pipe input via stdin.\n");
+            fprintf(stderr, "Usage: xmllint [--format] [--noout] [--xpath EXPR] <xml>\nOr pipe input via stdin.\n");
             return 1;
         }
-        xml = stdin_buf;
+        lexer_init_buffer(&reader.lx, stdin_buf, strlen(stdin_buf));
     }
 
-    XmlNode *root = parse_xml(xml);
-
-    if (!root) {
-        fprintf(stderr, "Error: Failed to parse XML\n");
-        free(stdin_buf);
-        return 1;
-    }
-
-    if (xpath) {
-        xpath_query(root, xpath);
-    } else {
-        print_xml(root, 0);
-    }
+    status = streaming ? run_stream(&reader, xpath ? &xp : NULL) : run_format(&reader);
 
-    free_node(root);
+    reader_free(&reader);
+    if (!xml && streaming) line_reader_free(&in);
     free(stdin_buf);
-    return 0;
+    free(print_stack);
+    out_flush();
+    return status;
 }
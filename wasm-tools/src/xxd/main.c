@@ -1,11 +1,28 @@
 /**
  * xxd - Create hex dump
- * Usage: xxd [dump|reverse] [-r] [-p] [<text>]
+ * Usage: xxd [dump|reverse] [-r] [-p] [-s offset] [-l length] [-c cols]
+ *            [--file PATH] [<text>]
  * Options:
  *   dump     - hex dump mode (default)
  *   reverse  - reverse hex dump (same as -r)
  *   -r       - reverse hex dump
  *   -p       - plain hex output (no offset/ASCII columns)
+ *   -s N     - start at byte offset N (negative: N bytes before the end
+ *              of --file); offsets in the dump stay absolute
+ *   -l N     - stop after N bytes
+ *   -c N     - bytes per line (default 16, or 30 with -p)
+ *   --file   - read this file instead of the text argument or stdin
+ *
+ * Long forms for the host's argument style: --mode dump|reverse, --plain,
+ * --seek, --length, --cols.
+ *
+ * Input is read by length in fixed-size chunks, so binary data (NUL
+ * bytes included) of any size is dumped as-is. Rows are formatted from
+ * a precomputed byte-to-hex table straight into the output buffer.
+ *
+ * Reverse mode accepts both dump lines ("offset: hex  ascii") and plain
+ * hex, decoded in order; with -msimd128, runs of plain hex are decoded
+ * 16 digits at a time.
  *
  * If no positional text argument is provided, reads from stdin.
  */
@@ -13,99 +30,345 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include "../stdin_read.h"
-
-int hex_to_int(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    return -1;
+#include <errno.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
+
+#define READ_CHUNK 65536
+#define MAX_COLS 256
+
+/* Decode table entries outside 0..15 */
+#define HEX_SPACE 0xfe
+#define HEX_INVALID 0xff
+
+static char hex_pairs[256][2];
+static uint8_t hex_values[256];
+
+static void init_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        hex_pairs[i][0] = out_hex_digits[i >> 4];
+        hex_pairs[i][1] = out_hex_digits[i & 15];
+    }
+    memset(hex_values, HEX_INVALID, sizeof(hex_values));
+    for (int i = 0; i < 10; i++) hex_values['0' + i] = (uint8_t)i;
+    for (int i = 0; i < 6; i++) hex_values['a' + i] = hex_values['A' + i] = (uint8_t)(10 + i);
+    hex_values[' '] = hex_values['\t'] = hex_values['\r'] = hex_values['\n'] = HEX_SPACE;
 }
 
-int main(int argc, char **argv) {
-    int reverse = 0;
-    int plain = 0;
-    const char *input = NULL;
+typedef struct {
+    int plain;
+    int cols;
+    long long seek;
+    long long length;          /* -1 = to the end */
+} DumpOptions;
 
-    for (int i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "reverse") == 0) {
-            reverse = 1;
-        } else if (strcmp(argv[i], "-p") == 0) {
-            plain = 1;
-        } else if (strcmp(argv[i], "dump") == 0) {
-            /* Default mode, nothing to set */
-        } else if (argv[i][0] != '-') {
-            input = argv[i];
+/* ========================================================================== */
+/* Dump                                                                       */
+/* ========================================================================== */
+
+/* "offset: 6865 6c6c ...  hello" for one row of up to cols bytes */
+static void dump_row(const DumpOptions *opt, unsigned long long offset, const uint8_t *p, size_t n) {
+    size_t cols = (size_t)opt->cols;
+    char *o = out_reserve(16 + 2 + cols * 3 + 2 + cols + 1);
+    char *start = o;
+
+    int digits = 8;
+    while (digits < 16 && (offset >> (digits * 4)) != 0) digits++;
+    for (int d = digits - 1; d >= 0; d--) *o++ = out_hex_digits[(offset >> (d * 4)) & 15];
+    *o++ = ':';
+    *o++ = ' ';
+
+    for (size_t j = 0; j < cols; j++) {
+        if (j < n) {
+            memcpy(o, hex_pairs[p[j]], 2);
+        } else {
+            o[0] = o[1] = ' ';
         }
+        o += 2;
+        if (j % 2 == 1 || j == cols - 1) *o++ = ' ';
+    }
+    *o++ = ' ';
+
+    for (size_t j = 0; j < n; j++) {
+        *o++ = (p[j] >= 0x20 && p[j] < 0x7f) ? (char)p[j] : '.';
+    }
+    *o++ = '\n';
+    out_len += (size_t)(o - start);
+}
+
+static void plain_row(const DumpOptions *opt, const uint8_t *p, size_t n) {
+    char *o = out_reserve((size_t)opt->cols * 2 + 1);
+    for (size_t j = 0; j < n; j++, o += 2) memcpy(o, hex_pairs[p[j]], 2);
+    *o = '\n';
+    out_len += n * 2 + 1;
+}
+
+/* Read up to len bytes from either source */
+static size_t read_input(FILE *fp, const char **text, size_t *text_len, uint8_t *buf, size_t len) {
+    if (!fp) {
+        size_t n = *text_len < len ? *text_len : len;
+        memcpy(buf, *text, n);
+        *text += n;
+        *text_len -= n;
+        return n;
     }
+    return fread(buf, 1, len, fp);
+}
+
+static int dump(const DumpOptions *opt, FILE *fp, const char *text) {
+    static uint8_t buf[READ_CHUNK];
+    size_t text_len = text ? strlen(text) : 0;
+    unsigned long long offset = 0;
 
-    /* If no positional input argument, read from stdin */
-    char *stdin_buf = NULL;
-    if (!input) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
-            fprintf(stderr, "Usage: xxd [dump|reverse] [-r] [-p] [<text>]\n");
-            fprintf(stderr, "  Or pipe input via stdin.\n");
+    /* Position at -s: seek where possible, otherwise read past it */
+    if (opt->seek < 0) {
+        if (!fp || fp == stdin || fseek(fp, opt->seek, SEEK_END) != 0) {
+            fprintf(stderr, "xxd: Sorry, cannot seek.\n");
             return 1;
         }
-        input = stdin_buf;
+        offset = (unsigned long long)ftell(fp);
+    } else if (opt->seek > 0) {
+        offset = (unsigned long long)opt->seek;
+        if (!fp) {
+            size_t skip = offset < text_len ? (size_t)offset : text_len;
+            text += skip;
+            text_len -= skip;
+        } else if (fp == stdin || fseek(fp, opt->seek, SEEK_SET) != 0) {
+            unsigned long long left = offset;
+            size_t n = 1;
+            while (left > 0 && n > 0) {
+                n = fread(buf, 1, left < sizeof(buf) ? (size_t)left : sizeof(buf), fp);
+                left -= n;
+            }
+        }
     }
 
-    if (reverse) {
-        /* Decode hex to binary */
-        const char *p = input;
-        while (*p) {
-            /* Skip whitespace */
-            while (*p && isspace((unsigned char)*p)) p++;
-            if (!*p) break;
+    /* Whole rows per read so rows never straddle chunks */
+    size_t cols = (size_t)opt->cols;
+    size_t chunk = sizeof(buf) / cols * cols;
+    unsigned long long left = opt->length < 0 ? ~0ULL : (unsigned long long)opt->length;
 
-            int hi = hex_to_int(*p++);
-            if (hi < 0) continue;
+    while (left > 0) {
+        size_t want = left < chunk ? (size_t)left : chunk;
+        size_t n = 0, got;
+        /* Fill the chunk completely unless the input ends (pipes give short reads) */
+        while (n < want && (got = read_input(fp, &text, &text_len, buf + n, want - n)) > 0) n += got;
+        if (n == 0) break;
 
-            while (*p && isspace((unsigned char)*p)) p++;
-            if (!*p) break;
+        for (size_t i = 0; i < n; i += cols) {
+            size_t row = n - i < cols ? n - i : cols;
+            if (opt->plain) plain_row(opt, buf + i, row);
+            else dump_row(opt, offset + i, buf + i, row);
+        }
+        offset += n;
+        left -= n;
+        if (n < want) break;
+    }
 
-            int lo = hex_to_int(*p++);
-            if (lo < 0) continue;
+    if (fp && ferror(fp)) {
+        out_flush();
+        fprintf(stderr, "xxd: read error\n");
+        return 1;
+    }
+    return 0;
+}
 
-            putchar((hi << 4) | lo);
-        }
-    } else if (plain) {
-        /* Plain hex output */
-        size_t len = strlen(input);
-        for (size_t i = 0; i < len; i++) {
-            printf("%02x", (unsigned char)input[i]);
+/* ========================================================================== */
+/* Reverse                                                                    */
+/* ========================================================================== */
+
+typedef struct {
+    int pending;               /* High nibble waiting for its pair, or -1 */
+} HexDecoder;
+
+#ifdef __wasm_simd128__
+
+/* Decode 16 hex digits to 8 bytes; returns 0 if any is not a hex digit */
+static inline int hex_decode_block(const char *src, uint8_t *dst) {
+    v128_t c = wasm_v128_load(src);
+    v128_t digit = wasm_v128_and(wasm_u8x16_ge(c, wasm_i8x16_splat('0')),
+                                 wasm_u8x16_le(c, wasm_i8x16_splat('9')));
+    v128_t lc = wasm_v128_or(c, wasm_i8x16_splat(0x20));
+    v128_t alpha = wasm_v128_and(wasm_u8x16_ge(lc, wasm_i8x16_splat('a')),
+                                 wasm_u8x16_le(lc, wasm_i8x16_splat('f')));
+    if (!wasm_i8x16_all_true(wasm_v128_or(digit, alpha))) return 0;
+
+    v128_t nibbles = wasm_v128_bitselect(wasm_i8x16_sub(c, wasm_i8x16_splat('0')),
+                                         wasm_i8x16_sub(lc, wasm_i8x16_splat('a' - 10)), digit);
+    /* Even positions are high nibbles: hi << 4 | lo per 16-bit lane, then narrow */
+    v128_t pairs = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(nibbles, wasm_i16x8_splat(0x00ff)), 4),
+                                wasm_u16x8_shr(nibbles, 8));
+    uint64_t bytes = (uint64_t)wasm_i64x2_extract_lane(wasm_u8x16_narrow_i16x8(pairs, pairs), 0);
+    memcpy(dst, &bytes, 8);
+    return 1;
+}
+
+#endif
+
+/* Decode hex digits in s[0..n), skipping whitespace and other characters */
+static void hex_decode_segment(HexDecoder *d, const char *s, size_t n) {
+    uint8_t *o = (uint8_t *)out_reserve(n / 2 + 1);
+    uint8_t *start = o;
+    size_t i = 0;
+
+    while (i < n) {
+#ifdef __wasm_simd128__
+        if (d->pending < 0) {
+            while (i + 16 <= n && hex_decode_block(s + i, o)) {
+                i += 16;
+                o += 8;
+            }
         }
-        printf("\n");
-    } else {
-        /* Traditional xxd format */
-        size_t len = strlen(input);
-        for (size_t i = 0; i < len; i += 16) {
-            printf("%08zx: ", i);
-
-            /* Hex */
-            for (size_t j = 0; j < 16; j++) {
-                if (i + j < len) {
-                    printf("%02x", (unsigned char)input[i + j]);
-                } else {
-                    printf("  ");
-                }
-                if (j % 2 == 1) printf(" ");
+#endif
+        size_t stop = n - i > 16 ? i + 16 : n;
+        for (; i < stop; i++) {
+            uint8_t v = hex_values[(uint8_t)s[i]];
+            if (v > 15) continue;
+            if (d->pending < 0) {
+                d->pending = v;
+            } else {
+                *o++ = (uint8_t)(d->pending << 4 | v);
+                d->pending = -1;
             }
+        }
+    }
+    out_len += (size_t)(o - start);
+}
 
-            printf(" ");
+/* Long lines are decoded in pieces that fit the output buffer */
+static void hex_decode(HexDecoder *d, const char *s, size_t n) {
+    while (n > 0) {
+        size_t piece = n < OUT_BUF_SIZE ? n : OUT_BUF_SIZE;
+        hex_decode_segment(d, s, piece);
+        s += piece;
+        n -= piece;
+    }
+}
 
-            /* ASCII */
-            for (size_t j = 0; j < 16 && i + j < len; j++) {
-                char c = input[i + j];
-                putchar(isprint((unsigned char)c) ? c : '.');
-            }
+/* Length of a leading "hexoffset:" or 0 if the line is not a dump line */
+static size_t dump_prefix(const char *line, size_t len) {
+    size_t i = 0;
+    while (i < len && hex_values[(uint8_t)line[i]] <= 15) i++;
+    return (i > 0 && i < len && line[i] == ':') ? i + 1 : 0;
+}
+
+static int reverse(LineReader *reader) {
+    HexDecoder dec = { -1 };
+    char *line;
+    size_t len;
 
-            printf("\n");
+    while (line_reader_next(reader, &line, &len)) {
+        size_t prefix = dump_prefix(line, len);
+        if (prefix == 0) {
+            hex_decode(&dec, line, len);
+            continue;
+        }
+        /* The hex columns end at the first double space (before the ASCII) */
+        const char *hex = line + prefix;
+        size_t hex_len = len - prefix;
+        while (hex_len > 0 && *hex == ' ') { hex++; hex_len--; }
+        for (size_t i = 0; i + 1 < hex_len; i++) {
+            if (hex[i] == ' ' && hex[i + 1] == ' ') { hex_len = i; break; }
         }
+        dec.pending = -1;
+        hex_decode(&dec, hex, hex_len);
+        dec.pending = -1;
     }
+    return reader->error ? 1 : 0;
+}
+
+/* ========================================================================== */
+/* Main                                                                       */
+/* ========================================================================== */
 
-    free(stdin_buf);
+static int parse_number(const char *s, long long *out) {
+    char *end;
+    errno = 0;
+    long long v = strtoll(s, &end, 0);
+    if (errno || end == s || *end) return -1;
+    *out = v;
     return 0;
 }
+
+static void usage(void) {
+    fprintf(stderr, "Usage: xxd [dump|reverse] [-r] [-p] [-s offset] [-l length] [-c cols] [--file PATH] [<text>]\n");
+    fprintf(stderr, "  Or pipe input via stdin.\n");
+}
+
+int main(int argc, char **argv) {
+    int rev = 0;
+    long long cols = 0;
+    DumpOptions opt = { 0, 16, 0, -1 };
+    const char *input = NULL;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-r") == 0 || strcmp(arg, "reverse") == 0) {
+            rev = 1;
+        } else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--plain") == 0) {
+            opt.plain = 1;
+        } else if (strcmp(arg, "dump") == 0) {
+            /* Default mode, nothing to set */
+        } else if (strcmp(arg, "--mode") == 0 && value) {
+            rev = strcmp(value, "reverse") == 0;
+            i++;
+        } else if (strcmp(arg, "--file") == 0 && value) {
+            path = value;
+            i++;
+        } else if ((strcmp(arg, "-s") == 0 || strcmp(arg, "--seek") == 0) && value) {
+            if (parse_number(value, &opt.seek) != 0) {
+                fprintf(stderr, "xxd: invalid offset: %s\n", value);
+                return 1;
+            }
+            i++;
+        } else if ((strcmp(arg, "-l") == 0 || strcmp(arg, "--length") == 0) && value) {
+            if (parse_number(value, &opt.length) != 0 || opt.length < 0) {
+                fprintf(stderr, "xxd: invalid length: %s\n", value);
+                return 1;
+            }
+            i++;
+        } else if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--cols") == 0) && value) {
+            if (parse_number(value, &cols) != 0 || cols < 1 || cols > MAX_COLS) {
+                fprintf(stderr, "xxd: invalid number of columns (max. %d): %s\n", MAX_COLS, value);
+                return 1;
+            }
+            i++;
+        } else if (arg[0] != '-' || arg[1] == '\0') {
+            input = arg;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    opt.cols = cols ? (int)cols : opt.plain ? 30 : 16;
+    init_tables();
+
+    FILE *fp = NULL;
+    if (path) {
+        fp = fopen(path, "rb");
+        if (!fp) {
+            fprintf(stderr, "xxd: %s: %s\n", path, strerror(errno));
+            return 2;
+        }
+    } else if (!input) {
+        /* If no positional input argument, read from stdin */
+        fp = stdin;
+    }
+
+    int status;
+    if (rev) {
+        LineReader reader;
+        if (fp) line_reader_init_file(&reader, fp);
+        else line_reader_init_string(&reader, input);
+        status = reverse(&reader);
+        line_reader_free(&reader);
+    } else {
+        status = dump(&opt, fp, fp ? NULL : input);
+    }
+
+    out_flush();
+    if (fp && fp != stdin) fclose(fp);
+    return status;
+}
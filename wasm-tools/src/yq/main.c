@@ -1,307 +1,1865 @@
 /**
  * yq - YAML query and transform
- * Usage: yq <filter> <yaml>
- * Supports basic YAML and jq-like filters
+ * Usage: yq [-o yaml|json] [-r] [-c] <filter> <yaml>
+ * Supports block and flow YAML and jq-like path filters
+ *
+ * The input is read line by line through a LineReader and turned into
+ * events (document, mapping and sequence start/end, scalar, alias) by a
+ * pull parser; no document tree is ever built. The filter is a path
+ * (.a.b[3], .items[].name, ."key", .["key"]) evaluated on the event
+ * stream: a node that cannot be on the path is skipped by depth counting
+ * alone, and a matching node's events go straight to the output writer
+ * (block YAML, or JSON with -o json). Memory stays flat in the input size,
+ * apart from one document's output, which is held until that document has
+ * parsed so that a syntax error never leaves partial output.
+ *
+ * Supported YAML: block mappings and sequences (including compact "- a: 1"
+ * entries and sequences at their key's indentation), flow collections,
+ * plain, single- and double-quoted scalars with line folding, literal and
+ * folded block scalars with chomping and indentation indicators,
+ * comments, tags, multiple documents, and anchors with aliases (anchored
+ * nodes are recorded as events and replayed where they are referenced).
+ * Explicit "? " keys must be scalars.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include "../stdin_read.h"
-
-#define MAX_DEPTH 100
-#define MAX_LINE 4096
-
-typedef enum {
-    YAML_NULL,
-    YAML_BOOL,
-    YAML_NUMBER,
-    YAML_STRING,
-    YAML_ARRAY,
-    YAML_OBJECT
-} YamlType;
-
-typedef struct YamlValue {
-    YamlType type;
-    char *key;
-    union {
-        int bool_val;
-        double num_val;
-        char *str_val;
-        struct {
-            struct YamlValue **items;
-            int count;
-        } array;
-        struct {
-            struct YamlValue **items;
-            int count;
-        } object;
-    } data;
-} YamlValue;
-
-void free_yaml(YamlValue *v);
-
-YamlValue* create_value(YamlType type) {
-    YamlValue *v = (YamlValue *)calloc(1, sizeof(YamlValue));
-    v->type = type;
-    return v;
-}
-
-// Get indentation level
-int get_indent(const char *line) {
-    int indent = 0;
-    while (*line == ' ') {
-        indent++;
-        line++;
-    }
-    return indent;
-}
-
-// Parse YAML value from string
-YamlValue* parse_scalar(const char *value) {
-    // Skip leading whitespace
-    while (*value && isspace((unsigned char)*value)) value++;
-
-    // Remove trailing whitespace
-    char *trimmed = strdup(value);
-    char *end = trimmed + strlen(trimmed) - 1;
-    while (end > trimmed && isspace((unsigned char)*end)) *end-- = '\0';
-
-    // Check type
-    YamlValue *v;
-
-    if (strcmp(trimmed, "null") == 0 || strcmp(trimmed, "~") == 0 || *trimmed == '\0') {
-        v = create_value(YAML_NULL);
-    } else if (strcmp(trimmed, "true") == 0 || strcmp(trimmed, "yes") == 0) {
-        v = create_value(YAML_BOOL);
-        v->data.bool_val = 1;
-    } else if (strcmp(trimmed, "false") == 0 || strcmp(trimmed, "no") == 0) {
-        v = create_value(YAML_BOOL);
-        v->data.bool_val = 0;
-    } else if ((*trimmed == '-' && isdigit((unsigned char)trimmed[1])) ||
-               isdigit((unsigned char)*trimmed)) {
-        v = create_value(YAML_NUMBER);
-        v->data.num_val = strtod(trimmed, NULL);
+#include <stdint.h>
+#include "../line_reader.h"
+#include "../stdout_write.h"
+
+/* ---- Events ---- */
+
+enum {
+    EV_STREAM_END, EV_DOC_START, EV_DOC_END, EV_MAP_START, EV_MAP_END,
+    EV_SEQ_START, EV_SEQ_END, EV_SCALAR, EV_ALIAS, EV_ERROR
+};
+
+enum { STYLE_PLAIN, STYLE_SINGLE, STYLE_DOUBLE, STYLE_LITERAL, STYLE_FOLDED };
+
+typedef struct {
+    int type;
+    const char *value;      /* Scalar value, or alias name */
+    size_t len;
+    int style;
+    const char *anchor;
+    size_t anchor_len;
+    const char *tag;
+    size_t tag_len;
+    size_t line;
+} YamlEvent;
+
+/* ---- Parser ---- */
+
+enum { F_ROOT, F_BLOCK_MAP, F_BLOCK_SEQ, F_FLOW_SEQ, F_FLOW_MAP };
+
+/* Frame states */
+enum {
+    S_NODE, S_DONE,                 /* F_ROOT */
+    S_NEXT, S_KEY_AT, S_VALUE,      /* Block collections (S_KEY_AT is a '-' for sequences) */
+    S_ITEM, S_SEP, S_COLON          /* Flow collections (S_ITEM is the key for mappings) */
+};
+
+enum { CTX_ROOT, CTX_MAP_VALUE, CTX_SEQ_ITEM };
+
+#define PROPERTY_MAX 256    /* Longest anchor name or tag kept */
+
+typedef struct {
+    int kind;
+    long indent;
+    int state;
+} ParseFrame;
+
+typedef struct {
+    LineReader *in;
+    char *line;             /* Current line, without its line ending */
+    size_t len, cap;
+    size_t col;             /* Cursor in the current line */
+    size_t lineno;
+    int fresh;              /* The current line has not been started yet */
+    int have_line;
+    int doc_open;
+
+    ParseFrame *stack;
+    size_t depth, stack_cap;
+
+    char *scratch;          /* Decoded scalar values */
+    size_t scratch_len, scratch_cap;
+
+    YamlEvent ev;
+    char anchor_buf[PROPERTY_MAX];
+    char tag_buf[PROPERTY_MAX];
+    size_t error_line;
+    char error[192];
+    int oom;
+} YamlParser;
+
+static void parser_init(YamlParser *p, LineReader *in) {
+    memset(p, 0, sizeof(*p));
+    p->in = in;
+}
+
+static void parser_free(YamlParser *p) {
+    free(p->line);
+    free(p->stack);
+    free(p->scratch);
+}
+
+static int parser_fail(YamlParser *p, const char *msg) {
+    snprintf(p->error, sizeof(p->error), "%s", msg);
+    p->error_line = p->lineno;
+    p->ev.type = EV_ERROR;
+    return EV_ERROR;
+}
+
+/* Read the next physical line into p->line; 0 at end of input */
+static int read_line(YamlParser *p) {
+    char *line;
+    size_t len;
+    if (!line_reader_next(p->in, &line, &len)) {
+        p->have_line = 0;
+        p->len = p->col = 0;
+        if (p->in->error) p->oom = 1;
+        return 0;
+    }
+    if (len > 0 && line[len - 1] == '\r') len--;
+    if (len + 1 > p->cap) {
+        size_t cap = p->cap ? p->cap : 256;
+        while (cap < len + 1) cap *= 2;
+        char *tmp = (char *)realloc(p->line, cap);
+        if (!tmp) {
+            p->oom = 1;
+            return 0;
+        }
+        p->line = tmp;
+        p->cap = cap;
+    }
+    memcpy(p->line, line, len);
+    p->line[len] = '\0';
+    p->len = len;
+    p->col = 0;
+    p->lineno++;
+    p->fresh = 1;
+    p->have_line = 1;
+    return 1;
+}
+
+static int is_blank_char(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static size_t line_indent(const YamlParser *p) {
+    size_t i = 0;
+    while (i < p->len && p->line[i] == ' ') i++;
+    return i;
+}
+
+static void skip_blanks(YamlParser *p) {
+    while (p->col < p->len && is_blank_char(p->line[p->col])) p->col++;
+}
+
+/* Only whitespace or a comment remains on the current line */
+static int at_line_end(YamlParser *p) {
+    skip_blanks(p);
+    return p->col >= p->len || p->line[p->col] == '#';
+}
+
+/* "---" or "..." document marker at the start of the current line */
+static int at_doc_marker(const YamlParser *p) {
+    if (p->len < 3) return 0;
+    if (memcmp(p->line, "---", 3) != 0 && memcmp(p->line, "...", 3) != 0) return 0;
+    return p->len == 3 || is_blank_char(p->line[3]);
+}
+
+/*
+ * Position the cursor on the next line that holds content. A line that
+ * has been peeked at but not started (fresh) is used as is. Returns 0 at
+ * the end of input.
+ */
+static int next_content_line(YamlParser *p) {
+    for (;;) {
+        if (!p->have_line || !p->fresh) {
+            if (!read_line(p)) return 0;
+        }
+        size_t ind = line_indent(p);
+        if (ind >= p->len || p->line[ind] == '#') {
+            p->fresh = 0;
+            continue;
+        }
+        p->col = ind;
+        return 1;
+    }
+}
+
+/* Nothing but a comment may follow a finished node on its line */
+static int finish_line(YamlParser *p) {
+    if (!p->have_line || p->fresh) return 1;
+    if (!at_line_end(p)) return 0;
+    p->fresh = 0;
+    return 1;
+}
+
+static int push_frame(YamlParser *p, int kind, long indent, int state) {
+    if (p->depth == p->stack_cap) {
+        size_t cap = p->stack_cap ? p->stack_cap * 2 : 32;
+        ParseFrame *tmp = (ParseFrame *)realloc(p->stack, cap * sizeof(ParseFrame));
+        if (!tmp) {
+            p->oom = 1;
+            return 0;
+        }
+        p->stack = tmp;
+        p->stack_cap = cap;
+    }
+    p->stack[p->depth].kind = kind;
+    p->stack[p->depth].indent = indent;
+    p->stack[p->depth].state = state;
+    p->depth++;
+    return 1;
+}
+
+static int scratch_put(YamlParser *p, const char *s, size_t n) {
+    if (p->scratch_len + n > p->scratch_cap) {
+        size_t cap = p->scratch_cap ? p->scratch_cap : 256;
+        while (cap < p->scratch_len + n) cap *= 2;
+        char *tmp = (char *)realloc(p->scratch, cap);
+        if (!tmp) {
+            p->oom = 1;
+            return 0;
+        }
+        p->scratch = tmp;
+        p->scratch_cap = cap;
+    }
+    memcpy(p->scratch + p->scratch_len, s, n);
+    p->scratch_len += n;
+    return 1;
+}
+
+static int scratch_char(YamlParser *p, char c) {
+    return scratch_put(p, &c, 1);
+}
+
+static void set_scalar(YamlParser *p, const char *s, size_t n, int style) {
+    p->ev.type = EV_SCALAR;
+    p->ev.value = s;
+    p->ev.len = n;
+    p->ev.style = style;
+}
+
+static int emit(YamlParser *p, int type) {
+    p->ev.type = type;
+    return type;
+}
+
+/* Anchor (&name) and tag (!tag) in front of a node */
+static void parse_properties(YamlParser *p) {
+    for (;;) {
+        skip_blanks(p);
+        if (p->col >= p->len) return;
+        char c = p->line[p->col];
+        if (c != '&' && c != '!') return;
+        size_t start = ++p->col;
+        while (p->col < p->len && !is_blank_char(p->line[p->col]) && !strchr(",[]{}", p->line[p->col])) {
+            p->col++;
+        }
+        // Copied: the node itself may start on a later line
+        size_t n = p->col - start;
+        char *dst = c == '&' ? p->anchor_buf : p->tag_buf;
+        if (n > PROPERTY_MAX) n = PROPERTY_MAX;
+        memcpy(dst, p->line + start, n);
+        if (c == '&') {
+            p->ev.anchor = dst;
+            p->ev.anchor_len = n;
+        } else {
+            p->ev.tag = dst;
+            p->ev.tag_len = n;
+        }
+    }
+}
+
+static void append_utf8(YamlParser *p, uint32_t cp) {
+    char b[4];
+    size_t n;
+    if (cp < 0x80) { b[0] = (char)cp; n = 1; }
+    else if (cp < 0x800) { b[0] = (char)(0xc0 | (cp >> 6)); b[1] = (char)(0x80 | (cp & 0x3f)); n = 2; }
+    else if (cp < 0x10000) {
+        b[0] = (char)(0xe0 | (cp >> 12)); b[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        b[2] = (char)(0x80 | (cp & 0x3f)); n = 3;
     } else {
-        v = create_value(YAML_STRING);
-        // Remove quotes if present
-        if ((*trimmed == '"' || *trimmed == '\'') && strlen(trimmed) >= 2) {
-            v->data.str_val = strndup(trimmed + 1, strlen(trimmed) - 2);
+        b[0] = (char)(0xf0 | (cp >> 18)); b[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        b[2] = (char)(0x80 | ((cp >> 6) & 0x3f)); b[3] = (char)(0x80 | (cp & 0x3f)); n = 4;
+    }
+    scratch_put(p, b, n);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Quoted scalar starting at the cursor. Line breaks fold to a space, and
+ * each blank line to a newline. Returns 0 on error.
+ */
+static int parse_quoted(YamlParser *p) {
+    char quote = p->line[p->col++];
+    p->scratch_len = 0;
+    size_t start_line = p->lineno;
+    for (;;) {
+        int escaped_break = 0;
+        while (p->col < p->len) {
+            char c = p->line[p->col];
+            if (c == quote) {
+                if (quote == '\'' && p->col + 1 < p->len && p->line[p->col + 1] == '\'') {
+                    scratch_char(p, '\'');
+                    p->col += 2;
+                    continue;
+                }
+                p->col++;
+                set_scalar(p, p->scratch, p->scratch_len, quote == '"' ? STYLE_DOUBLE : STYLE_SINGLE);
+                return 1;
+            }
+            if (c == '\\' && quote == '"') {
+                if (p->col + 1 >= p->len) {
+                    // Escaped line break: join without a space
+                    p->col++;
+                    escaped_break = 1;
+                    break;
+                }
+                char e = p->line[p->col + 1];
+                p->col += 2;
+                int digits = 0;
+                switch (e) {
+                case 'n': scratch_char(p, '\n'); break;
+                case 't': case '\t': scratch_char(p, '\t'); break;
+                case 'r': scratch_char(p, '\r'); break;
+                case '0': scratch_char(p, '\0'); break;
+                case 'a': scratch_char(p, '\a'); break;
+                case 'b': scratch_char(p, '\b'); break;
+                case 'e': scratch_char(p, 0x1b); break;
+                case 'f': scratch_char(p, '\f'); break;
+                case 'v': scratch_char(p, '\v'); break;
+                case ' ': case '"': case '/': case '\\': scratch_char(p, e); break;
+                case 'N': append_utf8(p, 0x85); break;
+                case '_': append_utf8(p, 0xa0); break;
+                case 'L': append_utf8(p, 0x2028); break;
+                case 'P': append_utf8(p, 0x2029); break;
+                case 'x': digits = 2; break;
+                case 'u': digits = 4; break;
+                case 'U': digits = 8; break;
+                default: return parser_fail(p, "invalid escape in double-quoted scalar") == EV_SCALAR;
+                }
+                if (digits) {
+                    uint32_t cp = 0;
+                    for (int i = 0; i < digits; i++) {
+                        int h = p->col < p->len ? hex_value(p->line[p->col]) : -1;
+                        if (h < 0) return parser_fail(p, "invalid escape in double-quoted scalar") == EV_SCALAR;
+                        cp = cp * 16 + (uint32_t)h;
+                        p->col++;
+                    }
+                    append_utf8(p, cp);
+                }
+                continue;
+            }
+            scratch_char(p, c);
+            p->col++;
+        }
+
+        // The scalar continues on the next line
+        if (!escaped_break) {
+            while (p->scratch_len > 0 && is_blank_char(p->scratch[p->scratch_len - 1])) p->scratch_len--;
+        }
+        int blank_lines = 0;
+        for (;;) {
+            if (!read_line(p)) {
+                p->lineno = start_line;
+                return parser_fail(p, "unterminated quoted scalar") == EV_SCALAR;
+            }
+            skip_blanks(p);
+            if (p->col < p->len) break;
+            blank_lines++;
+        }
+        p->fresh = 0;
+        if (blank_lines) {
+            for (int i = 0; i < blank_lines; i++) scratch_char(p, '\n');
+        } else if (!escaped_break) {
+            scratch_char(p, ' ');
+        }
+    }
+}
+
+/* Is there an implicit-key ':' on this line, at or after the cursor? */
+static int line_has_key(const YamlParser *p, size_t from) {
+    for (size_t i = from; i < p->len; i++) {
+        char c = p->line[i];
+        if (c == ':' && (i + 1 == p->len || is_blank_char(p->line[i + 1]))) return 1;
+        if (c == '#' && i > from && is_blank_char(p->line[i - 1])) return 0;
+    }
+    return 0;
+}
+
+/* Plain text from the cursor to ": ", " #" or the end of the line, trimmed */
+static void plain_span(YamlParser *p, int flow, size_t *start, size_t *end) {
+    size_t i = p->col;
+    *start = i;
+    for (; i < p->len; i++) {
+        char c = p->line[i];
+        if (c == ':' && (i + 1 == p->len || is_blank_char(p->line[i + 1]) ||
+                         (flow && strchr(",[]{}", p->line[i + 1])))) break;
+        if (c == '#' && i > *start && is_blank_char(p->line[i - 1])) break;
+        if (flow && strchr(",[]{}", c)) break;
+    }
+    size_t e = i;
+    while (e > *start && is_blank_char(p->line[e - 1])) e--;
+    *end = e;
+    p->col = i;
+}
+
+/*
+ * Plain scalar in block context. Continuation lines indented past the
+ * parent are folded in: a line break becomes a space, blank lines become
+ * newlines.
+ */
+static int parse_plain_block(YamlParser *p, long parent_indent) {
+    size_t s, e;
+    plain_span(p, 0, &s, &e);
+    if (p->col < p->len && p->line[p->col] == ':') {
+        return parser_fail(p, "mapping values are not allowed here") == EV_SCALAR;
+    }
+    int comment = p->col < p->len && p->line[p->col] == '#';
+    p->scratch_len = 0;
+    scratch_put(p, p->line + s, e - s);
+    if (comment) {
+        set_scalar(p, p->scratch, p->scratch_len, STYLE_PLAIN);
+        return 1;
+    }
+
+    int blank_lines = 0;
+    for (;;) {
+        if (!read_line(p)) break;
+        size_t ind = line_indent(p);
+        if (ind >= p->len) {
+            blank_lines++;
+            continue;
+        }
+        if ((long)ind <= parent_indent || p->line[ind] == '#' || at_doc_marker(p) ||
+            (p->line[ind] == '-' && (ind + 1 == p->len || is_blank_char(p->line[ind + 1])) &&
+             (long)ind <= parent_indent + 0)) {
+            break;
+        }
+        p->col = ind;
+        p->fresh = 0;
+        plain_span(p, 0, &s, &e);
+        if (p->col < p->len && p->line[p->col] == ':') {
+            return parser_fail(p, "mapping values are not allowed here") == EV_SCALAR;
+        }
+        if (blank_lines) {
+            for (int i = 0; i < blank_lines; i++) scratch_char(p, '\n');
+        } else {
+            scratch_char(p, ' ');
+        }
+        blank_lines = 0;
+        scratch_put(p, p->line + s, e - s);
+        if (p->col < p->len) {
+            // A comment ends the scalar
+            p->fresh = 0;
+            break;
+        }
+    }
+    // The line that ended the scalar (if any) has not been started
+    set_scalar(p, p->scratch, p->scratch_len, STYLE_PLAIN);
+    return 1;
+}
+
+/* Literal (|) or folded (>) block scalar; the cursor is on the indicator */
+static int parse_block_scalar(YamlParser *p, long parent_indent) {
+    int folded = p->line[p->col++] == '>';
+    int chomp = 0;              /* -1 strip, 0 clip, +1 keep */
+    long explicit_indent = 0;
+    for (int i = 0; i < 2 && p->col < p->len; i++) {
+        char c = p->line[p->col];
+        if (c == '-' || c == '+') {
+            chomp = c == '-' ? -1 : 1;
+            p->col++;
+        } else if (c >= '1' && c <= '9') {
+            explicit_indent = c - '0';
+            p->col++;
+        }
+    }
+    if (!at_line_end(p)) return parser_fail(p, "invalid block scalar header") == EV_SCALAR;
+
+    long base = parent_indent < 0 ? 0 : parent_indent;
+    long indent = explicit_indent ? base + explicit_indent : -1;
+    p->scratch_len = 0;
+    size_t trailing = 0;        /* Line breaks not yet written */
+    int prev_more_indented = 0, any = 0;
+
+    for (;;) {
+        if (!read_line(p)) break;
+        size_t ind = line_indent(p);
+        if (ind >= p->len) {
+            trailing++;
+            continue;
+        }
+        if (indent < 0) {
+            if ((long)ind <= parent_indent) break;
+            indent = (long)ind;
+        }
+        if ((long)ind < indent || (indent == 0 && at_doc_marker(p))) break;
+        p->fresh = 0;
+
+        const char *text = p->line + indent;
+        size_t n = p->len - (size_t)indent;
+        int more_indented = is_blank_char(*text);
+        if (any) {
+            if (folded && trailing == 0 && !more_indented && !prev_more_indented) {
+                scratch_char(p, ' ');
+            } else {
+                size_t breaks = folded && !more_indented && !prev_more_indented ? trailing : trailing + 1;
+                for (size_t i = 0; i < breaks; i++) scratch_char(p, '\n');
+            }
         } else {
-            v->data.str_val = strdup(trimmed);
+            for (size_t i = 0; i < trailing; i++) scratch_char(p, '\n');
         }
+        scratch_put(p, text, n);
+        trailing = 0;
+        prev_more_indented = more_indented;
+        any = 1;
+    }
+
+    if (any && chomp >= 0) scratch_char(p, '\n');
+    if (chomp > 0) {
+        for (size_t i = 0; i < trailing; i++) scratch_char(p, '\n');
     }
+    set_scalar(p, p->scratch, p->scratch_len, folded ? STYLE_FOLDED : STYLE_LITERAL);
+    return 1;
+}
 
-    free(trimmed);
-    return v;
+static int parse_alias(YamlParser *p) {
+    size_t start = ++p->col;
+    while (p->col < p->len && !is_blank_char(p->line[p->col]) && !strchr(",[]{}", p->line[p->col])) {
+        p->col++;
+    }
+    if (p->col == start) return parser_fail(p, "alias without a name");
+    p->ev.type = EV_ALIAS;
+    p->ev.value = p->line + start;
+    p->ev.len = p->col - start;
+    return EV_ALIAS;
 }
 
-// Simple YAML parser (handles basic structures)
-YamlValue* parse_yaml(const char *yaml) {
-    char *yaml_copy = strdup(yaml);
-    char *lines[10000];
-    int line_count = 0;
+static int is_seq_entry(const YamlParser *p, size_t at) {
+    return at < p->len && p->line[at] == '-' && (at + 1 == p->len || is_blank_char(p->line[at + 1]));
+}
 
-    // Split into lines
-    char *line = strtok(yaml_copy, "\n");
-    while (line && line_count < 10000) {
-        lines[line_count++] = line;
-        line = strtok(NULL, "\n");
+/* A block node at the cursor; parent_indent is the indentation it must exceed */
+static int parse_block_node(YamlParser *p, long parent_indent, int ctx) {
+    p->fresh = 0;
+    parse_properties(p);
+    if (at_line_end(p)) {
+        p->fresh = 0;
+        // The node, if there is one, starts on a following line
+        if (!next_content_line(p) || at_doc_marker(p)) {
+            set_scalar(p, "", 0, STYLE_PLAIN);
+            return EV_SCALAR;
+        }
+        long ind = (long)p->col;
+        int same_level_seq = ctx == CTX_MAP_VALUE && ind == parent_indent && is_seq_entry(p, p->col);
+        if (ind <= parent_indent && !same_level_seq) {
+            set_scalar(p, "", 0, STYLE_PLAIN);
+            return EV_SCALAR;
+        }
+        p->fresh = 0;
+        parse_properties(p);
     }
 
-    if (line_count == 0) {
-        free(yaml_copy);
-        return create_value(YAML_NULL);
+    size_t col = p->col;
+    char c = p->line[col];
+    if (is_seq_entry(p, col)) {
+        if (!push_frame(p, F_BLOCK_SEQ, (long)col, S_KEY_AT)) return emit(p, EV_ERROR);
+        return emit(p, EV_SEQ_START);
+    }
+    if (c == '[' || c == '{') {
+        p->col++;
+        if (!push_frame(p, c == '[' ? F_FLOW_SEQ : F_FLOW_MAP, (long)col, S_ITEM)) return emit(p, EV_ERROR);
+        return emit(p, c == '[' ? EV_SEQ_START : EV_MAP_START);
+    }
+    if (c == '|' || c == '>') {
+        return parse_block_scalar(p, parent_indent) ? EV_SCALAR : EV_ERROR;
+    }
+    if (c == '*') return parse_alias(p);
+    if (c == '?' && (col + 1 == p->len || is_blank_char(p->line[col + 1]))) {
+        if (!push_frame(p, F_BLOCK_MAP, (long)col, S_KEY_AT)) return emit(p, EV_ERROR);
+        return emit(p, EV_MAP_START);
+    }
+    if (c == '"' || c == '\'') {
+        size_t line = p->lineno;
+        if (!parse_quoted(p)) return EV_ERROR;
+        skip_blanks(p);
+        if (p->lineno == line && p->col < p->len && p->line[p->col] == ':' &&
+            (p->col + 1 == p->len || is_blank_char(p->line[p->col + 1]))) {
+            // It was the first key of a mapping: parse it again as a key
+            p->col = col;
+            if (!push_frame(p, F_BLOCK_MAP, (long)col, S_KEY_AT)) return emit(p, EV_ERROR);
+            return emit(p, EV_MAP_START);
+        }
+        return EV_SCALAR;
+    }
+    if (line_has_key(p, col)) {
+        if (!push_frame(p, F_BLOCK_MAP, (long)col, S_KEY_AT)) return emit(p, EV_ERROR);
+        return emit(p, EV_MAP_START);
     }
+    return parse_plain_block(p, parent_indent) ? EV_SCALAR : EV_ERROR;
+}
 
-    // Determine root type
-    YamlValue *root = NULL;
-    int base_indent = get_indent(lines[0]);
+/* Block mapping key at the cursor, followed by ':' */
+static int parse_block_key(YamlParser *p) {
+    p->fresh = 0;
+    char c = p->line[p->col];
+    if (is_seq_entry(p, p->col)) return parser_fail(p, "sequence entry is not allowed in a mapping here");
+    if (c == '?' && (p->col + 1 == p->len || is_blank_char(p->line[p->col + 1]))) {
+        // "? key" with its ": value" on the next line; only scalar keys
+        p->col++;
+        skip_blanks(p);
+        c = p->line[p->col];
+        if (c == '"' || c == '\'') {
+            if (!parse_quoted(p)) return EV_ERROR;
+        } else {
+            size_t s, e;
+            plain_span(p, 0, &s, &e);
+            if (p->col < p->len && p->line[p->col] == ':') return parser_fail(p, "only scalar '?' keys are supported");
+            set_scalar(p, p->line + s, e - s, STYLE_PLAIN);
+        }
+        p->stack[p->depth - 1].state = S_COLON;
+        return EV_SCALAR;
+    }
+    if (c == '"' || c == '\'') {
+        if (!parse_quoted(p)) return EV_ERROR;
+        skip_blanks(p);
+    } else {
+        size_t s, e;
+        plain_span(p, 0, &s, &e);
+        set_scalar(p, p->line + s, e - s, STYLE_PLAIN);
+    }
+    if (p->col >= p->len || p->line[p->col] != ':') return parser_fail(p, "expected ':' after a mapping key");
+    p->col++;
+    return EV_SCALAR;
+}
 
-    for (int i = 0; i < line_count; i++) {
-        const char *l = lines[i];
-        int indent = get_indent(l);
-        l += indent;
+/* Skip whitespace, comments and line breaks inside a flow collection */
+static int flow_skip(YamlParser *p) {
+    for (;;) {
+        skip_blanks(p);
+        if (p->col < p->len && p->line[p->col] != '#') {
+            p->fresh = 0;
+            return 1;
+        }
+        if (!read_line(p)) return parser_fail(p, "unterminated flow collection") == EV_SCALAR;
+    }
+}
 
-        if (*l == '\0' || *l == '#') continue;
+/* Plain scalar in a flow collection, folded across line breaks */
+static void parse_plain_flow(YamlParser *p) {
+    size_t s, e;
+    plain_span(p, 1, &s, &e);
+    if (p->col < p->len) {
+        set_scalar(p, p->line + s, e - s, STYLE_PLAIN);
+        return;
+    }
+    p->scratch_len = 0;
+    scratch_put(p, p->line + s, e - s);
+    int blank_lines = 0;
+    while (read_line(p)) {
+        p->fresh = 0;
+        skip_blanks(p);
+        if (p->col >= p->len) {
+            blank_lines++;
+            continue;
+        }
+        if (strchr(",[]{}#:", p->line[p->col])) break;
+        plain_span(p, 1, &s, &e);
+        if (blank_lines) {
+            for (int i = 0; i < blank_lines; i++) scratch_char(p, '\n');
+        } else {
+            scratch_char(p, ' ');
+        }
+        blank_lines = 0;
+        scratch_put(p, p->line + s, e - s);
+        if (p->col < p->len) break;
+    }
+    set_scalar(p, p->scratch, p->scratch_len, STYLE_PLAIN);
+}
+
+static int parse_flow_node(YamlParser *p) {
+    parse_properties(p);
+    if (!flow_skip(p)) return EV_ERROR;
+    char c = p->line[p->col];
+    if (c == '[' || c == '{') {
+        p->col++;
+        if (!push_frame(p, c == '[' ? F_FLOW_SEQ : F_FLOW_MAP, (long)p->col, S_ITEM)) return emit(p, EV_ERROR);
+        return emit(p, c == '[' ? EV_SEQ_START : EV_MAP_START);
+    }
+    if (c == '*') return parse_alias(p);
+    if (c == '"' || c == '\'') return parse_quoted(p) ? EV_SCALAR : EV_ERROR;
+    parse_plain_flow(p);
+    return EV_SCALAR;
+}
+
+/* Advance to the next event in p->ev */
+static int parser_next(YamlParser *p) {
+    for (;;) {
+        memset(&p->ev, 0, sizeof(p->ev));
+        p->ev.line = p->lineno;
+        if (p->oom) return parser_fail(p, "out of memory");
+
+        if (!p->doc_open) {
+            // Skip directives and document end markers between documents
+            for (;;) {
+                if (!next_content_line(p)) return emit(p, EV_STREAM_END);
+                if (p->col == 0 && p->line[0] == '%') {
+                    p->fresh = 0;
+                    continue;
+                }
+                if (at_doc_marker(p) && p->line[0] == '.') {
+                    p->fresh = 0;
+                    continue;
+                }
+                break;
+            }
+            if (at_doc_marker(p)) p->col = 3;
+            p->doc_open = 1;
+            if (!push_frame(p, F_ROOT, -1, S_NODE)) return emit(p, EV_ERROR);
+            p->ev.line = p->lineno;
+            return emit(p, EV_DOC_START);
+        }
+
+        ParseFrame *f = &p->stack[p->depth - 1];
+        switch (f->kind) {
+        case F_ROOT:
+            if (f->state == S_NODE) {
+                f->state = S_DONE;
+                return parse_block_node(p, -1, CTX_ROOT);
+            }
+            if (!finish_line(p)) return parser_fail(p, "unexpected content after the document");
+            if (next_content_line(p) && !at_doc_marker(p)) {
+                return parser_fail(p, "unexpected content after the document");
+            }
+            if (p->have_line && p->line[0] == '.') p->fresh = 0;
+            p->depth--;
+            p->doc_open = 0;
+            return emit(p, EV_DOC_END);
 
-        // Array item
-        if (*l == '-') {
-            if (!root) {
-                root = create_value(YAML_ARRAY);
+        case F_BLOCK_MAP:
+        case F_BLOCK_SEQ: {
+            int is_map = f->kind == F_BLOCK_MAP;
+            if (f->state == S_VALUE) {
+                f->state = S_NEXT;
+                return parse_block_node(p, f->indent, is_map ? CTX_MAP_VALUE : CTX_SEQ_ITEM);
             }
-            if (root->type == YAML_ARRAY) {
-                l++;
-                while (*l && isspace((unsigned char)*l)) l++;
-
-                YamlValue *item = parse_scalar(l);
-                root->data.array.count++;
-                root->data.array.items = (YamlValue **)realloc(
-                    root->data.array.items,
-                    root->data.array.count * sizeof(YamlValue *)
-                );
-                root->data.array.items[root->data.array.count - 1] = item;
+            if (f->state == S_COLON) {
+                // After an explicit key: ": value" at the mapping's indentation, or no value
+                f->state = S_NEXT;
+                if (!finish_line(p)) return parser_fail(p, "unexpected content after a key");
+                if (next_content_line(p) && !at_doc_marker(p) && (long)p->col == f->indent &&
+                    p->line[p->col] == ':' && (p->col + 1 == p->len || is_blank_char(p->line[p->col + 1]))) {
+                    p->fresh = 0;
+                    p->col++;
+                    return parse_block_node(p, f->indent, CTX_MAP_VALUE);
+                }
+                set_scalar(p, "", 0, STYLE_PLAIN);
+                return EV_SCALAR;
+            }
+            if (f->state == S_NEXT) {
+                if (!finish_line(p)) return parser_fail(p, "unexpected content after a value");
+                if (!next_content_line(p) || at_doc_marker(p) || (long)p->col < f->indent ||
+                    (!is_map && (long)p->col == f->indent && !is_seq_entry(p, p->col))) {
+                    p->depth--;
+                    return emit(p, is_map ? EV_MAP_END : EV_SEQ_END);
+                }
+                if ((long)p->col > f->indent) {
+                    return parser_fail(p, is_map ? "bad indentation of a mapping entry"
+                                                 : "bad indentation of a sequence entry");
+                }
             }
+            // S_KEY_AT: the cursor is on this entry's key or '-'
+            f->state = S_VALUE;
+            if (is_map) return parse_block_key(p);
+            p->fresh = 0;
+            p->col++;
+            f->state = S_NEXT;
+            return parse_block_node(p, f->indent, CTX_SEQ_ITEM);
         }
-        // Key-value pair
-        else {
-            char *colon = strchr(l, ':');
-            if (colon) {
-                if (!root) {
-                    root = create_value(YAML_OBJECT);
+
+        case F_FLOW_SEQ:
+            if (!flow_skip(p)) return EV_ERROR;
+            if (p->line[p->col] == ']') {
+                p->col++;
+                p->depth--;
+                return emit(p, EV_SEQ_END);
+            }
+            if (f->state == S_SEP) {
+                if (p->line[p->col] != ',') return parser_fail(p, "expected ',' or ']' in a flow sequence");
+                p->col++;
+                f->state = S_ITEM;
+                continue;
+            }
+            f->state = S_SEP;
+            return parse_flow_node(p);
+
+        case F_FLOW_MAP:
+            if (!flow_skip(p)) return EV_ERROR;
+            if (f->state == S_COLON) {
+                f->state = S_SEP;
+                if (p->line[p->col] != ':') {
+                    // A key without a value
+                    set_scalar(p, "", 0, STYLE_PLAIN);
+                    return EV_SCALAR;
                 }
-                if (root->type == YAML_OBJECT) {
-                    *colon = '\0';
-                    const char *key = l;
-                    const char *val = colon + 1;
-
-                    while (*val && isspace((unsigned char)*val)) val++;
-
-                    YamlValue *item = parse_scalar(val);
-                    item->key = strdup(key);
-
-                    root->data.object.count++;
-                    root->data.object.items = (YamlValue **)realloc(
-                        root->data.object.items,
-                        root->data.object.count * sizeof(YamlValue *)
-                    );
-                    root->data.object.items[root->data.object.count - 1] = item;
+                p->col++;
+                if (!flow_skip(p)) return EV_ERROR;
+                if (p->line[p->col] == ',' || p->line[p->col] == '}') {
+                    set_scalar(p, "", 0, STYLE_PLAIN);
+                    return EV_SCALAR;
                 }
+                return parse_flow_node(p);
+            }
+            if (p->line[p->col] == '}') {
+                p->col++;
+                p->depth--;
+                return emit(p, EV_MAP_END);
+            }
+            if (f->state == S_SEP) {
+                if (p->line[p->col] != ',') return parser_fail(p, "expected ',' or '}' in a flow mapping");
+                p->col++;
+                f->state = S_ITEM;
+                continue;
+            }
+            f->state = S_COLON;
+            if (p->line[p->col] == '?' && (p->col + 1 == p->len || is_blank_char(p->line[p->col + 1]))) {
+                // Explicit key marker, allowed for single-line flow keys
+                p->col++;
+                if (!flow_skip(p)) return EV_ERROR;
+            }
+            if (p->line[p->col] == '"' || p->line[p->col] == '\'') {
+                return parse_quoted(p) ? EV_SCALAR : EV_ERROR;
             }
+            {
+                size_t s, e;
+                plain_span(p, 1, &s, &e);
+                set_scalar(p, p->line + s, e - s, STYLE_PLAIN);
+            }
+            return EV_SCALAR;
         }
     }
+}
+
+/* ---- Anchors: record anchored nodes, replay them at aliases ---- */
+
+typedef struct EventBlock {
+    struct EventBlock *next;
+    size_t used;
+    char data[64 * 1024];
+} EventBlock;
+
+typedef struct {
+    char *name;
+    YamlEvent *events;
+    size_t count, cap;
+    long depth;             /* Nesting left to record; -1 once complete */
+} Anchor;
+
+typedef struct {
+    YamlParser *parser;
+    Anchor *anchors;
+    size_t anchor_count, anchor_cap;
+    EventBlock *strings;    /* Copies of recorded strings */
+    const Anchor *replay;   /* Alias being expanded */
+    size_t replay_pos;
+    const Anchor *replay_stack[64];
+    size_t replay_pos_stack[64];
+    int replay_depth;
+    YamlEvent ev;
+    int oom;
+} EventSource;
 
-    free(yaml_copy);
-    return root ? root : create_value(YAML_NULL);
+static const char *source_copy(EventSource *s, const char *str, size_t len) {
+    if (!str || len == 0) return str;
+    if (len > sizeof(s->strings->data)) {
+        EventBlock *b = (EventBlock *)malloc(sizeof(EventBlock) + len);
+        if (!b) return NULL;
+        b->next = s->strings ? s->strings->next : NULL;
+        if (s->strings) s->strings->next = b;
+        else s->strings = b;
+        memcpy(b->data, str, len);
+        return b->data;
+    }
+    if (!s->strings || s->strings->used + len > sizeof(s->strings->data)) {
+        EventBlock *b = (EventBlock *)malloc(sizeof(EventBlock));
+        if (!b) return NULL;
+        b->next = s->strings;
+        b->used = 0;
+        s->strings = b;
+    }
+    char *p = s->strings->data + s->strings->used;
+    memcpy(p, str, len);
+    s->strings->used += len;
+    return p;
 }
 
-void free_yaml(YamlValue *v) {
-    if (!v) return;
+static void source_reset(EventSource *s) {
+    for (size_t i = 0; i < s->anchor_count; i++) {
+        free(s->anchors[i].name);
+        free(s->anchors[i].events);
+    }
+    s->anchor_count = 0;
+    while (s->strings) {
+        EventBlock *next = s->strings->next;
+        free(s->strings);
+        s->strings = next;
+    }
+}
 
-    free(v->key);
+static void source_free(EventSource *s) {
+    source_reset(s);
+    free(s->anchors);
+}
 
-    if (v->type == YAML_STRING) {
-        free(v->data.str_val);
-    } else if (v->type == YAML_ARRAY) {
-        for (int i = 0; i < v->data.array.count; i++) {
-            free_yaml(v->data.array.items[i]);
+static void source_record(EventSource *s, const YamlEvent *ev) {
+    for (size_t i = 0; i < s->anchor_count; i++) {
+        Anchor *a = &s->anchors[i];
+        if (a->depth < 0) continue;
+        if (a->count == a->cap) {
+            size_t cap = a->cap ? a->cap * 2 : 16;
+            YamlEvent *tmp = (YamlEvent *)realloc(a->events, cap * sizeof(YamlEvent));
+            if (!tmp) {
+                s->oom = 1;
+                return;
+            }
+            a->events = tmp;
+            a->cap = cap;
         }
-        free(v->data.array.items);
-    } else if (v->type == YAML_OBJECT) {
-        for (int i = 0; i < v->data.object.count; i++) {
-            free_yaml(v->data.object.items[i]);
+        YamlEvent copy = *ev;
+        copy.anchor = NULL;
+        copy.anchor_len = 0;
+        copy.value = source_copy(s, ev->value, ev->len);
+        copy.tag = source_copy(s, ev->tag, ev->tag_len);
+        if ((ev->len && !copy.value) || (ev->tag_len && !copy.tag)) s->oom = 1;
+        a->events[a->count++] = copy;
+        if (ev->type == EV_MAP_START || ev->type == EV_SEQ_START) a->depth++;
+        else if (ev->type == EV_MAP_END || ev->type == EV_SEQ_END) a->depth--;
+        if (a->depth == 0) a->depth = -1;
+    }
+}
+
+static void source_define(EventSource *s, const YamlEvent *ev) {
+    // A redefined anchor replaces the earlier one from here on
+    for (size_t i = 0; i < s->anchor_count; i++) {
+        if (strlen(s->anchors[i].name) == ev->anchor_len &&
+            memcmp(s->anchors[i].name, ev->anchor, ev->anchor_len) == 0) {
+            s->anchors[i].name[0] = '\0';
         }
-        free(v->data.object.items);
     }
+    if (s->anchor_count == s->anchor_cap) {
+        size_t cap = s->anchor_cap ? s->anchor_cap * 2 : 8;
+        Anchor *tmp = (Anchor *)realloc(s->anchors, cap * sizeof(Anchor));
+        if (!tmp) {
+            s->oom = 1;
+            return;
+        }
+        s->anchors = tmp;
+        s->anchor_cap = cap;
+    }
+    Anchor *a = &s->anchors[s->anchor_count];
+    memset(a, 0, sizeof(*a));
+    a->name = (char *)malloc(ev->anchor_len + 1);
+    if (!a->name) {
+        s->oom = 1;
+        return;
+    }
+    memcpy(a->name, ev->anchor, ev->anchor_len);
+    a->name[ev->anchor_len] = '\0';
+    a->depth = 0;
+    s->anchor_count++;
+}
+
+/* Next event with aliases expanded */
+static int source_next(EventSource *s) {
+    for (;;) {
+        if (s->replay) {
+            if (s->replay_pos < s->replay->count) {
+                s->ev = s->replay->events[s->replay_pos++];
+                source_record(s, &s->ev);
+                return s->ev.type;
+            }
+            s->replay = s->replay_depth ? s->replay_stack[s->replay_depth - 1] : NULL;
+            if (s->replay_depth) s->replay_pos = s->replay_pos_stack[--s->replay_depth];
+            continue;
+        }
 
-    free(v);
+        int type = parser_next(s->parser);
+        s->ev = s->parser->ev;
+        if (type == EV_ALIAS) {
+            const Anchor *found = NULL;
+            for (size_t i = s->anchor_count; i-- > 0;) {
+                const Anchor *a = &s->anchors[i];
+                if (strlen(a->name) == s->ev.len && memcmp(a->name, s->ev.value, s->ev.len) == 0) {
+                    found = a;
+                    break;
+                }
+            }
+            if (!found || found->depth >= 0) {
+                snprintf(s->parser->error, sizeof(s->parser->error), "unknown anchor '%.*s'",
+                         (int)s->ev.len, s->ev.value);
+                s->parser->error_line = s->ev.line;
+                return s->ev.type = EV_ERROR;
+            }
+            s->replay = found;
+            s->replay_pos = 0;
+            continue;
+        }
+        if (type == EV_DOC_END) source_reset(s);
+        if ((type == EV_MAP_START || type == EV_SEQ_START || type == EV_SCALAR) && s->ev.anchor) {
+            source_define(s, &s->ev);
+        }
+        source_record(s, &s->ev);
+        if (s->oom) {
+            snprintf(s->parser->error, sizeof(s->parser->error), "out of memory");
+            return s->ev.type = EV_ERROR;
+        }
+        return type;
+    }
 }
 
-void print_yaml(YamlValue *v, int indent);
+/* ---- Scalars ---- */
+
+enum { VAL_NULL, VAL_BOOL, VAL_INT, VAL_FLOAT, VAL_STRING };
 
-void print_indent(int n) {
-    for (int i = 0; i < n; i++) printf("  ");
+static int text_is(const char *s, size_t n, const char *word) {
+    return strlen(word) == n && memcmp(s, word, n) == 0;
 }
 
-void print_yaml(YamlValue *v, int indent) {
-    if (!v) {
-        printf("null\n");
-        return;
+static int is_decimal_number(const char *s, size_t n, int *is_int) {
+    size_t i = 0;
+    if (i < n && (s[i] == '-' || s[i] == '+')) i++;
+    size_t digits = 0;
+    while (i < n && s[i] >= '0' && s[i] <= '9') { i++; digits++; }
+    *is_int = 1;
+    if (i < n && s[i] == '.') {
+        *is_int = 0;
+        i++;
+        while (i < n && s[i] >= '0' && s[i] <= '9') { i++; digits++; }
+    }
+    if (digits == 0) return 0;
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        *is_int = 0;
+        i++;
+        if (i < n && (s[i] == '-' || s[i] == '+')) i++;
+        size_t exp = 0;
+        while (i < n && s[i] >= '0' && s[i] <= '9') { i++; exp++; }
+        if (exp == 0) return 0;
     }
+    return i == n;
+}
 
-    switch (v->type) {
-        case YAML_NULL:
-            printf("null\n");
-            break;
-        case YAML_BOOL:
-            printf("%s\n", v->data.bool_val ? "true" : "false");
-            break;
-        case YAML_NUMBER:
-            if (v->data.num_val == (int)v->data.num_val) {
-                printf("%d\n", (int)v->data.num_val);
-            } else {
-                printf("%g\n", v->data.num_val);
+/* YAML 1.2 core schema resolution of a scalar */
+static int scalar_type(const YamlEvent *ev) {
+    if (ev->tag_len) {
+        // Core schema tags (!!str and so on) override the resolution
+        if (text_is(ev->tag, ev->tag_len, "!str")) return VAL_STRING;
+        if (text_is(ev->tag, ev->tag_len, "!null")) return VAL_NULL;
+        int number = text_is(ev->tag, ev->tag_len, "!int") || text_is(ev->tag, ev->tag_len, "!float");
+        if (number || text_is(ev->tag, ev->tag_len, "!bool")) {
+            YamlEvent plain = *ev;
+            plain.style = STYLE_PLAIN;
+            plain.tag_len = 0;
+            int type = scalar_type(&plain);
+            if (number && (type == VAL_INT || type == VAL_FLOAT)) return type;
+            if (!number && type == VAL_BOOL) return type;
+            return VAL_STRING;
+        }
+    }
+    if (ev->style != STYLE_PLAIN) return VAL_STRING;
+    const char *s = ev->value;
+    size_t n = ev->len;
+    if (n == 0 || text_is(s, n, "~") || text_is(s, n, "null") || text_is(s, n, "Null") || text_is(s, n, "NULL")) {
+        return VAL_NULL;
+    }
+    if (text_is(s, n, "true") || text_is(s, n, "True") || text_is(s, n, "TRUE") ||
+        text_is(s, n, "false") || text_is(s, n, "False") || text_is(s, n, "FALSE")) {
+        return VAL_BOOL;
+    }
+    int is_int;
+    if (is_decimal_number(s, n, &is_int)) return is_int ? VAL_INT : VAL_FLOAT;
+    if (n > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'o')) {
+        size_t i = 2;
+        while (i < n && (s[1] == 'x' ? hex_value(s[i]) >= 0 : (s[i] >= '0' && s[i] <= '7'))) i++;
+        if (i == n) return VAL_INT;
+    }
+    const char *t = s + (n > 0 && (s[0] == '-' || s[0] == '+'));
+    size_t tn = n - (size_t)(t - s);
+    if (text_is(t, tn, ".inf") || text_is(t, tn, ".Inf") || text_is(t, tn, ".INF") ||
+        text_is(s, n, ".nan") || text_is(s, n, ".NaN") || text_is(s, n, ".NAN")) {
+        return VAL_FLOAT;
+    }
+    return VAL_STRING;
+}
+
+/* ---- Output ---- */
+
+/*
+ * Output is collected per document and written to stdout only once the
+ * whole document has parsed, so an error never leaves a partial document
+ * behind. Memory is bounded by the largest document's output.
+ */
+static char *doc_buf;
+static size_t doc_len, doc_cap;
+static int doc_oom;
+
+static void doc_write(const char *s, size_t n) {
+    if (doc_cap - doc_len < n) {
+        if (doc_oom) return;
+        size_t cap = doc_cap ? doc_cap : 4096;
+        while (cap - doc_len < n) cap *= 2;
+        char *tmp = (char *)realloc(doc_buf, cap);
+        if (!tmp) {
+            doc_oom = 1;
+            return;
+        }
+        doc_buf = tmp;
+        doc_cap = cap;
+    }
+    memcpy(doc_buf + doc_len, s, n);
+    doc_len += n;
+}
+
+static void doc_char(char c) {
+    if (doc_len < doc_cap) doc_buf[doc_len++] = c;
+    else doc_write(&c, 1);
+}
+
+static void doc_str(const char *s) {
+    doc_write(s, strlen(s));
+}
+
+/* The current document parsed: hand its output to stdout */
+static void doc_emit(void) {
+    out_write(doc_buf, doc_len);
+    doc_len = 0;
+}
+
+static void write_json_string(const char *s, size_t n) {
+    doc_char('"');
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            doc_char('\\');
+            doc_char((char)c);
+        } else if (c == '\n') {
+            doc_str("\\n");
+        } else if (c == '\t') {
+            doc_str("\\t");
+        } else if (c == '\r') {
+            doc_str("\\r");
+        } else if (c < 0x20) {
+            doc_str("\\u00");
+            doc_char(out_hex_digits[c >> 4]);
+            doc_char(out_hex_digits[c & 15]);
+        } else {
+            doc_char((char)c);
+        }
+    }
+    doc_char('"');
+}
+
+static void write_json_scalar(const YamlEvent *ev, int raw) {
+    const char *s = ev->value;
+    size_t n = ev->len;
+    switch (scalar_type(ev)) {
+    case VAL_NULL:
+        doc_str("null");
+        return;
+    case VAL_BOOL:
+        doc_str(s[0] == 't' || s[0] == 'T' ? "true" : "false");
+        return;
+    case VAL_INT:
+        if (n > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'o')) {
+            char buf[32];
+            unsigned long long v = strtoull(s + 2, NULL, s[1] == 'x' ? 16 : 8);
+            snprintf(buf, sizeof(buf), "%llu", v);
+            doc_str(buf);
+            return;
+        }
+        if (s[0] == '+') { s++; n--; }
+        if (s[0] == '-') {
+            doc_char('-');
+            s++;
+            n--;
+        }
+        // JSON forbids leading zeros
+        while (n > 1 && s[0] == '0') { s++; n--; }
+        doc_write(s, n);
+        return;
+    case VAL_FLOAT: {
+        if (memchr(s, 'n', n) || memchr(s, 'N', n)) {
+            int inf = memchr(s, 'i', n) || memchr(s, 'I', n);
+            if (!inf) {
+                doc_str("null");
+                return;
             }
-            break;
-        case YAML_STRING:
-            printf("%s\n", v->data.str_val);
-            break;
-        case YAML_ARRAY:
-            printf("\n");
-            for (int i = 0; i < v->data.array.count; i++) {
-                print_indent(indent);
-                printf("- ");
-                print_yaml(v->data.array.items[i], indent + 1);
+            doc_str(s[0] == '-' ? "-1.7976931348623157e+308" : "1.7976931348623157e+308");
+            return;
+        }
+        char buf[64];
+        size_t k = n < sizeof(buf) - 1 ? n : sizeof(buf) - 1;
+        memcpy(buf, s, k);
+        buf[k] = '\0';
+        double v = strtod(buf, NULL);
+        snprintf(buf, sizeof(buf), "%.17g", v);
+        // Prefer the shortest form that reads back the same
+        for (int prec = 1; prec <= 17; prec++) {
+            char tmp[64];
+            snprintf(tmp, sizeof(tmp), "%.*g", prec, v);
+            if (strtod(tmp, NULL) == v) {
+                memcpy(buf, tmp, sizeof(tmp));
+                break;
             }
-            break;
-        case YAML_OBJECT:
-            if (indent > 0) printf("\n");
-            for (int i = 0; i < v->data.object.count; i++) {
-                YamlValue *item = v->data.object.items[i];
-                print_indent(indent);
-                printf("%s: ", item->key ? item->key : "");
-                print_yaml(item, indent + 1);
+        }
+        doc_str(buf);
+        return;
+    }
+    default:
+        if (raw) doc_write(s, n);
+        else write_json_string(s, n);
+    }
+}
+
+/* Can s be written as a plain YAML scalar and read back as the same string? */
+static int plain_safe(const YamlEvent *ev) {
+    const char *s = ev->value;
+    size_t n = ev->len;
+    if (n == 0 || is_blank_char(s[0]) || is_blank_char(s[n - 1])) return 0;
+    if (strchr("-?:,[]{}#&*!|>'\"%@`", s[0])) {
+        if (!((s[0] == '-' || s[0] == '?' || s[0] == ':') && n > 1 && !is_blank_char(s[1]))) return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x20 || c == 0x7f) return 0;
+        if (c == ':' && (i + 1 == n || s[i + 1] == ' ')) return 0;
+        if (c == '#' && i > 0 && s[i - 1] == ' ') return 0;
+    }
+    if (n >= 3 && (memcmp(s, "---", 3) == 0 || memcmp(s, "...", 3) == 0)) return 0;
+    // YAML 1.1 readers take these as booleans
+    static const char *const legacy[] = {"y", "Y", "yes", "Yes", "YES", "n", "N", "no", "No", "NO",
+                                         "on", "On", "ON", "off", "Off", "OFF"};
+    for (size_t i = 0; i < sizeof(legacy) / sizeof(legacy[0]); i++) {
+        if (text_is(s, n, legacy[i])) return 0;
+    }
+    YamlEvent plain = *ev;
+    plain.style = STYLE_PLAIN;
+    plain.tag_len = 0;
+    return scalar_type(&plain) == VAL_STRING;
+}
+
+static void write_double_quoted(const char *s, size_t n) {
+    write_json_string(s, n);
+}
+
+/*
+ * Block YAML writer. Collections are opened lazily: nothing is printed
+ * until the first entry arrives, so an empty one can still come out as
+ * {} or [] on its key's line, and the first entry of a sequence item
+ * shares the "- " line.
+ */
+typedef struct {
+    int is_map;
+    size_t indent;          /* Column of this collection's entries */
+    size_t count;
+    int compact;            /* First entry continues the current line */
+    int expect_key;
+} WriteFrame;
+
+typedef struct {
+    int json;
+    int raw;                /* Top-level strings without quotes */
+    int compact;            /* One line per JSON result */
+    WriteFrame *stack;
+    size_t depth, cap;
+    int line_open;          /* Something is printed on the current line */
+    int pending_value;      /* "key:" or "- " awaits its value */
+    int oom;
+} Writer;
+
+static void w_newline(Writer *w) {
+    if (w->line_open) doc_char('\n');
+    w->line_open = 0;
+}
+
+static void w_indent(size_t n) {
+    for (size_t i = 0; i < n; i++) doc_char(' ');
+}
+
+static int w_push(Writer *w, int is_map, size_t indent, int compact) {
+    if (w->depth == w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 32;
+        WriteFrame *tmp = (WriteFrame *)realloc(w->stack, cap * sizeof(WriteFrame));
+        if (!tmp) {
+            w->oom = 1;
+            return 0;
+        }
+        w->stack = tmp;
+        w->cap = cap;
+    }
+    WriteFrame *f = &w->stack[w->depth++];
+    f->is_map = is_map;
+    f->indent = indent;
+    f->count = 0;
+    f->compact = compact;
+    f->expect_key = 1;
+    return 1;
+}
+
+static void yaml_scalar_text(const YamlEvent *ev, size_t indent, int top) {
+    if (top && ev->style != STYLE_PLAIN) {
+        doc_write(ev->value, ev->len);
+        return;
+    }
+    if (ev->style == STYLE_PLAIN || plain_safe(ev) || scalar_type(ev) != VAL_STRING) {
+        doc_write(ev->value, ev->len);
+        return;
+    }
+    const char *s = ev->value;
+    size_t n = ev->len;
+    int multiline = memchr(s, '\n', n) != NULL;
+    int ok_block = multiline;
+    for (size_t i = 0; i < n && ok_block; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if ((c < 0x20 && c != '\n') || c == 0x7f) ok_block = 0;
+    }
+    // Readers take the indentation from the first non-empty line, so no
+    // line may start with whitespace, and there must be one
+    int has_text = 0;
+    for (size_t i = 0; i < n && ok_block; i++) {
+        if ((i == 0 || s[i - 1] == '\n') && is_blank_char(s[i])) ok_block = 0;
+        if (s[i] != '\n') has_text = 1;
+    }
+    if (!has_text) ok_block = 0;
+    if (ok_block) {
+        size_t trailing = 0;
+        while (trailing < n && s[n - 1 - trailing] == '\n') trailing++;
+        doc_str(trailing == 0 ? "|-" : trailing == 1 ? "|" : "|+");
+        size_t i = 0;
+        while (i < n) {
+            const char *nl = (const char *)memchr(s + i, '\n', n - i);
+            size_t end = nl ? (size_t)(nl - s) : n;
+            doc_char('\n');
+            if (end > i) {
+                w_indent(indent);
+                doc_write(s + i, end - i);
             }
-            break;
+            i = end + 1;
+            if (!nl) break;
+            if (i == n) break;
+        }
+        return;
     }
+    write_double_quoted(s, n);
 }
 
-// Apply filter
-YamlValue* apply_filter(YamlValue *v, const char *filter) {
-    if (!v || strcmp(filter, ".") == 0) return v;
+/* Start an entry of the innermost collection */
+static void yaml_begin_entry(Writer *w, WriteFrame *f) {
+    if (f->count == 0 && f->compact) {
+        // Continue the "- " line
+    } else {
+        w_newline(w);
+        w_indent(f->indent);
+    }
+    f->count++;
+    w->line_open = 1;
+}
+
+static void writer_event(Writer *w, const YamlEvent *ev);
 
-    if (filter[0] == '.' && filter[1] != '[') {
-        const char *key = filter + 1;
-        if (v->type == YAML_OBJECT) {
-            for (int i = 0; i < v->data.object.count; i++) {
-                if (v->data.object.items[i]->key &&
-                    strcmp(v->data.object.items[i]->key, key) == 0) {
-                    return v->data.object.items[i];
+static void json_begin_value(Writer *w) {
+    if (w->depth == 0) return;
+    WriteFrame *f = &w->stack[w->depth - 1];
+    if (f->is_map && !f->expect_key) {
+        f->expect_key = 1;
+        return;
+    }
+    if (f->count++) doc_char(',');
+    if (!w->compact) {
+        doc_char('\n');
+        w_indent(f->indent);
+    }
+    if (f->is_map) f->expect_key = 0;
+}
+
+static void json_event(Writer *w, const YamlEvent *ev) {
+    switch (ev->type) {
+    case EV_MAP_START:
+    case EV_SEQ_START:
+        json_begin_value(w);
+        doc_char(ev->type == EV_MAP_START ? '{' : '[');
+        w_push(w, ev->type == EV_MAP_START, w->depth ? w->stack[w->depth - 1].indent + 2 : 2, 0);
+        break;
+    case EV_MAP_END:
+    case EV_SEQ_END: {
+        WriteFrame *f = &w->stack[--w->depth];
+        if (f->count && !w->compact) {
+            doc_char('\n');
+            w_indent(f->indent - 2);
+        }
+        doc_char(ev->type == EV_MAP_END ? '}' : ']');
+        break;
+    }
+    case EV_SCALAR: {
+        WriteFrame *f = w->depth ? &w->stack[w->depth - 1] : NULL;
+        int is_key = f && f->is_map && f->expect_key;
+        json_begin_value(w);
+        if (is_key) {
+            write_json_string(ev->value, ev->len);
+            doc_str(w->compact ? ":" : ": ");
+        } else {
+            write_json_scalar(ev, w->raw && w->depth == 0);
+        }
+        break;
+    }
+    }
+}
+
+static void yaml_event(Writer *w, const YamlEvent *ev) {
+    WriteFrame *f = w->depth ? &w->stack[w->depth - 1] : NULL;
+    switch (ev->type) {
+    case EV_MAP_START:
+    case EV_SEQ_START: {
+        int is_map = ev->type == EV_MAP_START;
+        size_t indent = 0;
+        int compact = 1;
+        if (f && f->is_map) {
+            // Value of "key:"; mapping entries go below, indented
+            indent = f->indent + 2;
+            compact = 0;
+            f->expect_key = 1;
+        } else if (f) {
+            yaml_begin_entry(w, f);
+            doc_str("- ");
+            indent = f->indent + 2;
+        }
+        w_push(w, is_map, indent, compact);
+        break;
+    }
+    case EV_MAP_END:
+    case EV_SEQ_END: {
+        WriteFrame *done = &w->stack[--w->depth];
+        if (done->count == 0) {
+            WriteFrame *parent = w->depth ? &w->stack[w->depth - 1] : NULL;
+            if (parent && parent->is_map) doc_char(' ');
+            doc_str(ev->type == EV_MAP_END ? "{}" : "[]");
+            w->line_open = 1;
+        }
+        break;
+    }
+    case EV_SCALAR:
+        if (!f) {
+            yaml_scalar_text(ev, 0, 1);
+            w->line_open = 1;
+        } else if (f->is_map && f->expect_key) {
+            yaml_begin_entry(w, f);
+            yaml_scalar_text(ev, f->indent, 0);
+            doc_char(':');
+            f->expect_key = 0;
+        } else if (f->is_map) {
+            if (ev->len || ev->style != STYLE_PLAIN) {
+                doc_char(' ');
+                yaml_scalar_text(ev, f->indent + 2, 0);
+            }
+            f->expect_key = 1;
+        } else {
+            yaml_begin_entry(w, f);
+            doc_str("- ");
+            yaml_scalar_text(ev, f->indent + 2, 0);
+        }
+        break;
+    }
+}
+
+static void writer_event(Writer *w, const YamlEvent *ev) {
+    if (w->json) json_event(w, ev);
+    else yaml_event(w, ev);
+}
+
+static void writer_end_result(Writer *w) {
+    if (w->json) doc_char('\n');
+    else {
+        if (w->line_open) doc_char('\n');
+        w->line_open = 0;
+    }
+}
+
+/* ---- Filter ---- */
+
+enum { STEP_KEY, STEP_INDEX, STEP_ITER };
+
+typedef struct {
+    int kind;
+    const char *key;
+    size_t key_len;
+    long index;
+} Step;
+
+#define MAX_STEPS 64
+
+static Step steps[MAX_STEPS];
+static int step_count;
+static char *key_storage;
+
+/* .a.b[3], .items[].name, ."quoted key", .["key"]; '?' suffixes are ignored */
+static int compile_filter(const char *f) {
+    size_t n = strlen(f);
+    key_storage = (char *)malloc(n + 1);
+    if (!key_storage) return 0;
+    char *keys = key_storage;
+    const char *p = f;
+    while (*p == ' ') p++;
+    if (*p != '.') return 0;
+    int first = 1;
+    while (*p) {
+        if (step_count == MAX_STEPS) return 0;
+        Step *s = &steps[step_count];
+        if (*p == '.') {
+            p++;
+            if (*p == '\0' && first) break;
+            if (*p == '"') {
+                p++;
+                s->kind = STEP_KEY;
+                s->key = keys;
+                while (*p && *p != '"') {
+                    if (*p == '\\' && p[1]) p++;
+                    *keys++ = *p++;
+                }
+                if (*p != '"') return 0;
+                p++;
+                s->key_len = (size_t)(keys - s->key);
+                step_count++;
+            } else if (*p != '[') {
+                const char *k = p;
+                while (*p && *p != '.' && *p != '[' && *p != '?' && *p != ' ') p++;
+                if (p == k) return 0;
+                s->kind = STEP_KEY;
+                s->key = k;
+                s->key_len = (size_t)(p - k);
+                step_count++;
+            }
+        } else if (*p == '[') {
+            p++;
+            if (*p == ']') {
+                s->kind = STEP_ITER;
+                p++;
+            } else if (*p == '"' || *p == '\'') {
+                char q = *p++;
+                s->kind = STEP_KEY;
+                s->key = keys;
+                while (*p && *p != q) {
+                    if (*p == '\\' && p[1]) p++;
+                    *keys++ = *p++;
                 }
+                if (*p != q || p[1] != ']') return 0;
+                p += 2;
+                s->key_len = (size_t)(keys - s->key);
+            } else {
+                char *end;
+                long idx = strtol(p, &end, 10);
+                if (end == p || *end != ']' || idx < 0) return 0;
+                s->kind = STEP_INDEX;
+                s->index = idx;
+                p = end + 1;
             }
+            step_count++;
+        } else if (*p == '?' || *p == ' ') {
+            p++;
+        } else {
+            return 0;
+        }
+        first = 0;
+    }
+    return 1;
+}
+
+/*
+ * Filter state per open collection on the path: which step applies to
+ * its children, how many children it has seen, and whether a key or
+ * index step found its target (a miss yields null, as in jq).
+ */
+typedef struct {
+    int is_map;
+    int step;
+    long index;
+    int expect_key;
+    int next_step;          /* Step for the value after the current key */
+    int matched;
+} EvalFrame;
+
+typedef struct {
+    Writer *w;
+    EvalFrame *stack;
+    size_t depth, cap;
+    long skip_depth;        /* Nesting inside a subtree off the path */
+    long out_depth;         /* Nesting inside a result being written */
+    size_t results;         /* Results in the current document */
+    size_t docs_with_results;
+    int oom;
+    char error[128];
+} Evaluator;
+
+/* YAML output separates the results of each document with "---" */
+static void begin_result(Evaluator *e) {
+    if (e->results++ == 0 && e->docs_with_results++ > 0 && !e->w->json) doc_str("---\n");
+}
+
+/* The path from step on applied to null: null, or nothing once it iterates */
+static void null_result(Evaluator *e, int step) {
+    for (int i = step; i < step_count; i++) {
+        if (steps[i].kind == STEP_ITER) return;
+    }
+    YamlEvent ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = EV_SCALAR;
+    ev.value = "null";
+    ev.len = 4;
+    begin_result(e);
+    writer_event(e->w, &ev);
+    writer_end_result(e->w);
+}
+
+static int eval_push(Evaluator *e, int is_map, int step) {
+    if (e->depth == e->cap) {
+        size_t cap = e->cap ? e->cap * 2 : 32;
+        EvalFrame *tmp = (EvalFrame *)realloc(e->stack, cap * sizeof(EvalFrame));
+        if (!tmp) {
+            e->oom = 1;
+            return 0;
         }
+        e->stack = tmp;
+        e->cap = cap;
+    }
+    EvalFrame *f = &e->stack[e->depth++];
+    memset(f, 0, sizeof(*f));
+    f->is_map = is_map;
+    f->step = step;
+    f->expect_key = 1;
+    return 1;
+}
+
+/* Step index for the next child node of the innermost frame */
+static int child_step(Evaluator *e) {
+    if (e->depth == 0) return 0;
+    EvalFrame *f = &e->stack[e->depth - 1];
+    if (f->is_map) return f->next_step;
+    const Step *s = &steps[f->step];
+    long i = f->index++;
+    if (s->kind == STEP_ITER) return f->step + 1;
+    if (s->kind == STEP_INDEX && i == s->index) {
+        f->matched = 1;
+        return f->step + 1;
+    }
+    return -1;
+}
+
+static int type_error(Evaluator *e, const Step *s, const char *what) {
+    if (s->kind == STEP_KEY) {
+        snprintf(e->error, sizeof(e->error), "cannot index %s with \"%.*s\"", what, (int)s->key_len, s->key);
+    } else if (s->kind == STEP_INDEX) {
+        snprintf(e->error, sizeof(e->error), "cannot index %s with number", what);
+    } else {
+        snprintf(e->error, sizeof(e->error), "cannot iterate over %s", what);
+    }
+    return 0;
+}
+
+/* Feed one event; returns 0 on a filter error */
+static int eval_event(Evaluator *e, const YamlEvent *ev) {
+    int opens = ev->type == EV_MAP_START || ev->type == EV_SEQ_START;
+    int closes = ev->type == EV_MAP_END || ev->type == EV_SEQ_END;
+
+    if (e->out_depth > 0) {
+        writer_event(e->w, ev);
+        if (opens) e->out_depth++;
+        if (closes && --e->out_depth == 0) writer_end_result(e->w);
+        return 1;
+    }
+    if (e->skip_depth > 0) {
+        if (opens) e->skip_depth++;
+        if (closes) e->skip_depth--;
+        return 1;
+    }
+
+    if (closes) {
+        EvalFrame *f = &e->stack[--e->depth];
+        if (steps[f->step].kind != STEP_ITER && !f->matched) null_result(e, f->step + 1);
+        return 1;
     }
 
-    if (filter[0] == '.' && filter[1] == '[') {
-        int idx = atoi(filter + 2);
-        if (v->type == YAML_ARRAY && idx >= 0 && idx < v->data.array.count) {
-            return v->data.array.items[idx];
+    // A key of a mapping on the path decides where its value goes
+    if (ev->type == EV_SCALAR && e->depth && e->stack[e->depth - 1].is_map && e->stack[e->depth - 1].expect_key) {
+        EvalFrame *f = &e->stack[e->depth - 1];
+        const Step *s = &steps[f->step];
+        f->expect_key = 0;
+        f->next_step = -1;
+        if (s->kind == STEP_ITER) {
+            f->next_step = f->step + 1;
+        } else if (s->kind == STEP_KEY && !f->matched && ev->len == s->key_len &&
+                   memcmp(ev->value, s->key, ev->len) == 0) {
+            f->next_step = f->step + 1;
+            f->matched = 1;
         }
+        return 1;
     }
+    if (e->depth && e->stack[e->depth - 1].is_map) e->stack[e->depth - 1].expect_key = 1;
 
-    return NULL;
+    int step = child_step(e);
+    if (step < 0) {
+        if (opens) e->skip_depth = 1;
+        return 1;
+    }
+    if (step == step_count) {
+        begin_result(e);
+        writer_event(e->w, ev);
+        if (opens) e->out_depth = 1;
+        else writer_end_result(e->w);
+        return 1;
+    }
+    if (opens) {
+        int is_map = ev->type == EV_MAP_START;
+        const Step *s = &steps[step];
+        if (is_map && s->kind == STEP_INDEX) return type_error(e, s, "object");
+        if (!is_map && s->kind == STEP_KEY) return type_error(e, s, "array");
+        return eval_push(e, is_map, step);
+    }
+    // A scalar where the path needs a collection
+    if (scalar_type(ev) == VAL_NULL) {
+        null_result(e, step);
+        return 1;
+    }
+    return type_error(e, &steps[step], scalar_type(ev) == VAL_NULL ? "null" : "a scalar");
+}
+
+/* ---- Main ---- */
+
+static void usage(void) {
+    fprintf(stderr, "Usage: yq [-o yaml|json] [-r] [-c] <filter> <yaml>\n");
+    fprintf(stderr, "Filters:\n");
+    fprintf(stderr, "  .           Identity\n");
+    fprintf(stderr, "  .key        Object key access (also .\"key\" and .[\"key\"])\n");
+    fprintf(stderr, "  .[n]        Array index\n");
+    fprintf(stderr, "  .[]         Every element or value\n");
+    fprintf(stderr, "  .a.b[0].c   Paths combine\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -o, --output FMT   yaml (default) or json\n");
+    fprintf(stderr, "  -r, --raw          Print JSON strings without quotes\n");
+    fprintf(stderr, "  -c, --compact      One line per JSON result\n");
+    fprintf(stderr, "Or pipe yaml via stdin.\n");
 }
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: yq <filter> <yaml>\n");
-        fprintf(stderr, "Filters:\n");
-        fprintf(stderr, "  .           Identity\n");
-        fprintf(stderr, "  .key        Object key access\n");
-        fprintf(stderr, "  .[n]        Array index\n");
-        fprintf(stderr, "Or pipe yaml via stdin.\n");
+    const char *filter = NULL;
+    const char *yaml = NULL;
+    Writer writer;
+    memset(&writer, 0, sizeof(writer));
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && i + 1 < argc) {
+            const char *fmt = argv[++i];
+            if (strcmp(fmt, "json") == 0 || strcmp(fmt, "j") == 0) {
+                writer.json = 1;
+            } else if (strcmp(fmt, "yaml") != 0 && strcmp(fmt, "y") != 0) {
+                fprintf(stderr, "Error: Unknown output format '%s' (use yaml or json)\n", fmt);
+                return 1;
+            }
+        } else if (strcmp(arg, "-oj") == 0 || strcmp(arg, "-ojson") == 0) {
+            writer.json = 1;
+        } else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--raw") == 0) {
+            writer.raw = 1;
+        } else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--compact") == 0) {
+            writer.compact = 1;
+        } else if ((strcmp(arg, "--expression") == 0 || strcmp(arg, "--filter") == 0) && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(arg, "--input") == 0 && i + 1 < argc) {
+            yaml = argv[++i];
+        } else if (!filter) {
+            filter = arg;
+        } else {
+            yaml = arg;
+        }
+    }
+
+    if (!filter) {
+        usage();
+        return 1;
+    }
+    if (!compile_filter(filter)) {
+        fprintf(stderr, "Error: Unsupported filter '%s'\n", filter);
+        usage();
+        free(key_storage);
         return 1;
     }
 
-    const char *filter = argv[1];
-    const char *yaml = (argc >= 3) ? argv[2] : NULL;
-    char *stdin_buf = NULL;
-    if (!yaml) {
-        stdin_buf = read_all_stdin();
-        if (!stdin_buf) {
+    LineReader in;
+    if (yaml) {
+        line_reader_init_string(&in, yaml);
+    } else {
+        line_reader_init_stdin(&in);
+        if (line_reader_is_empty(&in)) {
             fprintf(stderr, "Usage: yq <filter> <yaml>\nOr pipe yaml via stdin.\n");
+            line_reader_free(&in);
+            free(key_storage);
             return 1;
         }
-        yaml = stdin_buf;
     }
 
-    YamlValue *root = parse_yaml(yaml);
-    YamlValue *result = apply_filter(root, filter);
+    YamlParser parser;
+    parser_init(&parser, &in);
+    EventSource source;
+    memset(&source, 0, sizeof(source));
+    source.parser = &parser;
+    Evaluator eval;
+    memset(&eval, 0, sizeof(eval));
+    eval.w = &writer;
 
-    print_yaml(result, 0);
+    int status = 0;
+    for (;;) {
+        int type = source_next(&source);
+        if (type == EV_STREAM_END) {
+            doc_emit();
+            break;
+        }
+        if (type == EV_ERROR) {
+            out_flush();
+            fprintf(stderr, "Error: line %zu: %s\n", parser.error_line, parser.error);
+            status = 1;
+            break;
+        }
+        if (type == EV_DOC_START || type == EV_DOC_END) {
+            if (type == EV_DOC_END) doc_emit();
+            eval.results = 0;
+            continue;
+        }
+        if (!eval_event(&eval, &source.ev) || eval.oom || writer.oom || doc_oom) {
+            out_flush();
+            fprintf(stderr, "Error: %s\n", eval.oom || writer.oom || doc_oom ? "Out of memory" : eval.error);
+            status = 1;
+            break;
+        }
+    }
 
-    free_yaml(root);
-    free(stdin_buf);
-    return 0;
+    source_free(&source);
+    parser_free(&parser);
+    line_reader_free(&in);
+    free(eval.stack);
+    free(writer.stack);
+    free(key_storage);
+    free(doc_buf);
+    out_flush();
+    return status;
 }